@@ -0,0 +1,135 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+
+#include <thalia-codegen/jit.hpp>
+#include <thalia-codegen/native.hpp>
+#include <thalia-codegen/tiering.hpp>
+#include <thalia-vm/compiler.hpp>
+#include <thalia-vm/fusion.hpp>
+#include <thalia-vm/machine.hpp>
+#include <thalia-test/frontend.hpp>
+
+
+namespace {
+  struct workload {
+    char const* name;
+    char const* code;
+  };
+
+  // The workloads of the interpreter benchmark, at the same sizes, and the
+  // example program scaled up.
+  constexpr workload workloads[] = {
+    {
+      "example",
+      "def MIN: i32 = 4i32, MAX: i32 = 3000000i32;\n"
+      "def mut i: i32 = MIN, mut s: i32 = 0i32;\n"
+      "while i <= MAX { s += i; i += 1i32; }\n"
+    },
+    {
+      "sum",
+      "def MIN: i32 = 0i32, MAX: i32 = 3000000i32;\n"
+      "def mut i: i32 = MIN, mut s: i32 = 0i32;\n"
+      "while i <= MAX { s += i; i += 1i32; }\n"
+    },
+    {
+      "nested",
+      "def mut i: i64 = 0, mut j: i64 = 0, mut acc: i64 = 0;\n"
+      "while i < 1200 {\n"
+      "  j = 0;\n"
+      "  while j < 1200 { acc += (i * j) % 7; j += 1; }\n"
+      "  i += 1;\n"
+      "}\n"
+    },
+    {
+      "collatz",
+      "def mut n: i32 = 1i32, mut steps: i32 = 0i32, mut x: i32 = 0i32;\n"
+      "while n < 30000i32 {\n"
+      "  x = n;\n"
+      "  while x != 1i32 {\n"
+      "    if x & 1i32 { x = 3i32 * x + 1i32; } else { x >>= 1i32; }\n"
+      "    steps += 1i32;\n"
+      "  }\n"
+      "  n += 1i32;\n"
+      "}\n"
+    }
+  };
+
+  template <typename Fn>
+  auto measure(Fn&& fn) -> double {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::milli>(elapsed).count();
+  }
+}
+
+extern auto main() -> int {
+  using namespace thalia;
+  auto status = EXIT_SUCCESS;
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "workload   fused vm (ms)   tiered (ms)   speedup"
+    "   jit compile (ms)   jit run (ms)   speedup\n";
+  for (auto const& load: workloads) {
+    auto source = test::analyzed { load.code };
+    auto globals = vm::globals_of(source.types, source.names, source.typing);
+
+    auto bytecode = vm::compiler { source.types, source.names, source.typing, source.values };
+    auto chunk = bytecode.compile(source.ast);
+    vm::fuse(chunk);
+    auto interpreter = vm::machine { chunk };
+    auto vm_time = measure([&] { interpreter.run(); });
+
+    // Every run of a tiered machine compiles its hot loops again.
+    auto compiler = codegen::native_compiler { source.types, source.names, source.typing, source.values };
+    auto tiered = vm::machine { chunk };
+    auto tiered_time = measure([&] {
+      auto tier = codegen::jit_tier { compiler, bytecode.loops(), chunk };
+      tiered.attach(tier);
+      tiered.run();
+    });
+
+    auto jit = std::optional<codegen::jit_machine> {};
+    auto compile_time = measure([&] {
+      jit.emplace(compiler.compile_function(source.ast), source.names.symbols().size());
+    });
+    auto run_time = measure([&] { jit->run(); });
+
+    for (auto const& global: globals) {
+      auto expected = interpreter.slots()[global.slot];
+      auto actual = jit->slots()[global.slot];
+      auto tiered_value = tiered.slots()[global.slot];
+      if (actual != expected || tiered_value != expected) {
+        std::cout << load.name << ": " << global.name << " = " << tiered_value << ", "
+          << actual << ", expected " << expected << '\n';
+        status = EXIT_FAILURE;
+      }
+    }
+    std::cout << std::left << std::setw(11) << load.name << std::right
+      << std::setw(13) << vm_time << std::setw(14) << tiered_time
+      << std::setw(9) << vm_time / tiered_time << 'x' << std::setw(18) << compile_time
+      << std::setw(15) << run_time << std::setw(9) << vm_time / (compile_time + run_time) << "x\n";
+  }
+  return status;
+}
@@ -0,0 +1,272 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+
+#include <thalia-codegen/c_source.hpp>
+#include <thalia-codegen/elf.hpp>
+#include <thalia-codegen/encoder.hpp>
+#include <thalia-codegen/lowering.hpp>
+#include <thalia-codegen/native.hpp>
+#include <thalia-ir/builder.hpp>
+#include <thalia-ir/pipeline.hpp>
+#include <thalia-test/frontend.hpp>
+
+namespace {
+  struct workload {
+    char const* name;
+    char const* code;
+    char const* c_code;
+  };
+
+  // The loops of the interpreter benchmark, scaled up, and element-wise and
+  // reduction loops over arrays, next to the same programs written in C with
+  // explicit wrapping.
+  constexpr workload workloads[] = {
+    {
+      "sum",
+      "def MIN: i32 = 0i32, MAX: i32 = 2000000000i32;\n"
+      "def mut i: i32 = MIN, mut s: i32 = 0i32;\n"
+      "while i <= MAX { s += i; i += 1i32; }\n",
+      "#include <stdint.h>\n#include <stdio.h>\n"
+      "int main(void) {\n"
+      "  int32_t i = 0, s = 0;\n"
+      "  while (i <= 2000000000) { s = (int32_t)((uint32_t)s + (uint32_t)i); i += 1; }\n"
+      "  printf(\"i = %d\\ns = %d\\n\", i, s);\n"
+      "  return 0;\n"
+      "}\n"
+    },
+    {
+      "nested",
+      "def mut i: i64 = 0, mut j: i64 = 0, mut acc: i64 = 0;\n"
+      "while i < 6000 {\n"
+      "  j = 0;\n"
+      "  while j < 6000 { acc += (i * j) % 7; j += 1; }\n"
+      "  i += 1;\n"
+      "}\n",
+      "#include <stdint.h>\n#include <stdio.h>\n"
+      "int main(void) {\n"
+      "  int64_t i = 0, j = 0, acc = 0;\n"
+      "  while (i < 6000) {\n"
+      "    j = 0;\n"
+      "    while (j < 6000) { acc += (i * j) % 7; j += 1; }\n"
+      "    i += 1;\n"
+      "  }\n"
+      "  printf(\"i = %lld\\nj = %lld\\nacc = %lld\\n\", (long long)i, (long long)j, (long long)acc);\n"
+      "  return 0;\n"
+      "}\n"
+    },
+    {
+      "collatz",
+      "def mut n: i64 = 1, mut steps: i64 = 0, mut x: i64 = 0;\n"
+      "while n < 1000000 {\n"
+      "  x = n;\n"
+      "  while x != 1 {\n"
+      "    if x & 1 { x = 3 * x + 1; } else { x >>= 1; }\n"
+      "    steps += 1;\n"
+      "  }\n"
+      "  n += 1;\n"
+      "}\n",
+      "#include <stdint.h>\n#include <stdio.h>\n"
+      "int main(void) {\n"
+      "  int64_t n = 1, steps = 0, x = 0;\n"
+      "  while (n < 1000000) {\n"
+      "    x = n;\n"
+      "    while (x != 1) {\n"
+      "      if (x & 1) x = 3 * x + 1; else x >>= 1;\n"
+      "      steps += 1;\n"
+      "    }\n"
+      "    n += 1;\n"
+      "  }\n"
+      "  printf(\"n = %lld\\nsteps = %lld\\nx = %lld\\n\", (long long)n, (long long)steps, (long long)x);\n"
+      "  return 0;\n"
+      "}\n"
+    },
+    {
+      "flags",
+      "def mut debug: i64 = 0, mut scale: i64 = 3, mut i: i64 = 0, mut s: i64 = 0;\n"
+      "while i < 500000000 {\n"
+      "  if debug != 0 { s = s / debug; scale += 1; }\n"
+      "  s += i * (1 << scale);\n"
+      "  i += 1;\n"
+      "}\n",
+      "#include <stdint.h>\n#include <stdio.h>\n"
+      "int main(void) {\n"
+      "  int64_t debug = 0, scale = 3, i = 0, s = 0;\n"
+      "  while (i < 500000000) {\n"
+      "    if (debug != 0) { s = s / debug; scale += 1; }\n"
+      "    s = (int64_t)((uint64_t)s + (uint64_t)(i * (1 << scale)));\n"
+      "    i += 1;\n"
+      "  }\n"
+      "  printf(\"debug = %lld\\nscale = %lld\\ni = %lld\\ns = %lld\\n\",\n"
+      "    (long long)debug, (long long)scale, (long long)i, (long long)s);\n"
+      "  return 0;\n"
+      "}\n"
+    },
+    {
+      "invariant",
+      "def mut i: i64 = 0, mut j: i64 = 0, mut s: i64 = 0;\n"
+      "while i < 12000 {\n"
+      "  j = 0;\n"
+      "  while j < 12000 {\n"
+      "    s += (j ^ (i * i * 7 + (i << 5) - (i >> 2))) & (i * 3 | 255);\n"
+      "    j += 1;\n"
+      "  }\n"
+      "  i += 1;\n"
+      "}\n",
+      "#include <stdint.h>\n#include <stdio.h>\n"
+      "int main(void) {\n"
+      "  int64_t i = 0, j = 0, s = 0;\n"
+      "  while (i < 12000) {\n"
+      "    j = 0;\n"
+      "    while (j < 12000) {\n"
+      "      s += (j ^ (i * i * 7 + (i << 5) - (i >> 2))) & (i * 3 | 255);\n"
+      "      j += 1;\n"
+      "    }\n"
+      "    i += 1;\n"
+      "  }\n"
+      "  printf(\"i = %lld\\nj = %lld\\ns = %lld\\n\", (long long)i, (long long)j, (long long)s);\n"
+      "  return 0;\n"
+      "}\n"
+    },
+    {
+      "arrays",
+      "def mut a: [65536]i32, mut b: [65536]i32, mut c: [65536]i32;\n"
+      "def mut i: i32 = 0i32, mut j: i32 = 0i32, mut k: i32 = 3i32, mut s: i32 = 0i32;\n"
+      "while j < 65536i32 { a[j] = j; b[j] = j ^ 1234i32; j += 1i32; }\n"
+      "while i < 5000i32 {\n"
+      "  j = 0i32;\n"
+      "  while j < 65536i32 { c[j] = a[j] * k + b[j]; j += 1i32; }\n"
+      "  j = 0i32;\n"
+      "  while j < 65536i32 { s += c[j] ^ i; j += 1i32; }\n"
+      "  i += 1i32;\n"
+      "}\n",
+      "#include <stdint.h>\n#include <stdio.h>\n"
+      "static int32_t a[65536], b[65536], c[65536];\n"
+      "int main(void) {\n"
+      "  int32_t i = 0, j = 0, k = 3, s = 0;\n"
+      "  while (j < 65536) { a[j] = j; b[j] = j ^ 1234; j += 1; }\n"
+      "  while (i < 5000) {\n"
+      "    j = 0;\n"
+      "    while (j < 65536) { c[j] = (int32_t)((uint32_t)a[j] * (uint32_t)k + (uint32_t)b[j]); j += 1; }\n"
+      "    j = 0;\n"
+      "    while (j < 65536) { s = (int32_t)((uint32_t)s + (uint32_t)(c[j] ^ i)); j += 1; }\n"
+      "    i += 1;\n"
+      "  }\n"
+      "  printf(\"i = %d\\nj = %d\\nk = %d\\ns = %d\\n\", i, j, k, s);\n"
+      "  return 0;\n"
+      "}\n"
+    }
+  };
+
+  auto shell(std::string const& command)
+    -> bool {
+    return std::system(command.c_str()) == 0;
+  }
+
+  // Runs an executable and returns its output and the elapsed time.
+  auto time_run(std::filesystem::path const& path, std::string& output)
+    -> double {
+    auto start = std::chrono::steady_clock::now();
+    auto* pipe = popen(path.c_str(), "r");
+    if (!pipe)
+      return 0;
+    char buffer[256];
+    while (auto read = std::fread(buffer, 1, sizeof(buffer), pipe))
+      output.append(buffer, read);
+    pclose(pipe);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::milli>(elapsed).count();
+  }
+}
+
+extern auto main() -> int {
+  using namespace thalia;
+  if (!shell("cc --version > /dev/null 2>&1")) {
+    std::cout << "cc not found\n";
+    return EXIT_FAILURE;
+  }
+
+  auto status = EXIT_SUCCESS;
+  auto dir = std::filesystem::temp_directory_path();
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "workload    thalia (ms)  thalia -O (ms)  via C -O3 (ms)   c -O1 (ms)    ratio\n";
+  for (auto const& load: workloads) {
+    auto source = test::analyzed { load.code };
+    auto compiler = codegen::native_compiler { source.types, source.names, source.typing, source.values };
+    auto translator = codegen::c_compiler { source.types, source.names, source.typing, source.values };
+    auto function = ir::builder { source.types, source.names, source.typing }.build(source.ast);
+    ir::optimize(function);
+    auto thalia_exe = dir / (std::string { "thalia-bench-" } + load.name);
+    auto optimized_exe = dir / (std::string { "thalia-bench-O-" } + load.name);
+    auto via_exe = dir / (std::string { "thalia-bench-via-" } + load.name);
+    auto c_exe = dir / (std::string { "thalia-bench-c-" } + load.name);
+    {
+      for (auto [path, target]: {
+        std::pair { thalia_exe, compiler.compile(source.ast) },
+        std::pair { optimized_exe, codegen::ir_compiler { function }.compile() }
+      }) {
+        auto start = codegen::add_start(target);
+        auto out = std::ofstream { path, std::ios::binary };
+        codegen::write_executable(out, codegen::x86::encode(target), start);
+      }
+      std::ofstream { std::filesystem::path { via_exe }.concat(".c") } << translator.compile(source.ast);
+      std::ofstream { std::filesystem::path { c_exe }.concat(".c") } << load.c_code;
+    }
+    for (auto const& path: { thalia_exe, optimized_exe })
+      std::filesystem::permissions(path, std::filesystem::perms::owner_exec, std::filesystem::perm_options::add);
+    if (!shell("cc -std=c11 -O3 -o '" + via_exe.string() + "' '" + via_exe.string() + ".c'")
+        || !shell("cc -O1 -o '" + c_exe.string() + "' '" + c_exe.string() + ".c'")) {
+      std::cout << load.name << ": build failed\n";
+      status = EXIT_FAILURE;
+      continue;
+    }
+
+    auto thalia_output = std::string {};
+    auto optimized_output = std::string {};
+    auto via_output = std::string {};
+    auto c_output = std::string {};
+    auto thalia_time = time_run(thalia_exe, thalia_output);
+    auto optimized_time = time_run(optimized_exe, optimized_output);
+    auto via_time = time_run(via_exe, via_output);
+    auto c_time = time_run(c_exe, c_output);
+    if (thalia_output != c_output || optimized_output != c_output || via_output != c_output) {
+      std::cout << load.name << ": outputs differ\n" << thalia_output << "---\n"
+        << optimized_output << "---\n" << via_output << "---\n" << c_output;
+      status = EXIT_FAILURE;
+    }
+    std::cout << std::left << std::setw(12) << load.name << std::right
+      << std::setw(11) << thalia_time << std::setw(16) << optimized_time << std::setw(16) << via_time
+      << std::setw(13) << c_time << std::setw(8) << optimized_time / c_time << "x\n";
+
+    for (auto const& path: { thalia_exe, optimized_exe, via_exe, c_exe })
+      std::filesystem::remove(path);
+    std::filesystem::remove(std::filesystem::path { via_exe }.concat(".c"));
+    std::filesystem::remove(std::filesystem::path { c_exe }.concat(".c"));
+  }
+  return status;
+}
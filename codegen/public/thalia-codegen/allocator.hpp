@@ -0,0 +1,126 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_CODEGEN_ALLOCATOR_
+#define _THALIA_CODEGEN_ALLOCATOR_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <thalia-ir/function.hpp>
+
+#include "x86.hpp"
+
+namespace thalia::codegen {
+  /**
+   * @brief Where a value lives from a position on, until the next range of
+   *   it starts: a register, or its slot in the frame.
+   */
+  struct live_range {
+    std::uint32_t start;
+    /** The register, or `std::nullopt` for the slot. */
+    std::optional<x86::reg> where;
+  };
+
+  /**
+   * @brief How well an allocation did.
+   */
+  struct allocation_stats {
+    /** The values that were given a place. */
+    std::size_t values = 0;
+    /** The values that never leave a register. */
+    std::size_t in_registers = 0;
+    /** The values that spend some of their life in their slot. */
+    std::size_t spilled = 0;
+    /** The times a value moves between a register and its slot. */
+    std::size_t splits = 0;
+  };
+
+  /**
+   * @brief Where the values of a function live, position by position.
+   *
+   * Positions number the code in layout order, two apart: a block starts at
+   * an even position, where its phis are defined, and its instructions
+   * follow it. An instruction reads its operands at its own position and
+   * defines its result at the next one, so a result can take the register
+   * of an operand that dies there. The edges out of a block happen at the
+   * position of its terminator.
+   */
+  struct allocation {
+    /** The position of every instruction, and of the block of every phi. */
+    std::vector<std::uint32_t> positions;
+    /** The position every block starts at, or `ir::none` off the layout. */
+    std::vector<std::uint32_t> starts;
+    /** The position of the terminator of every block. */
+    std::vector<std::uint32_t> ends;
+    /** The ranges of every value by start; none for values without a place. */
+    std::vector<std::vector<live_range>> ranges;
+    /** The values live into every block, other than its phis. */
+    std::vector<std::vector<ir::value_id>> live_in;
+    /**
+     * Whether a value spends some of its life in its slot, which it is then
+     * stored to wherever it is defined.
+     */
+    std::vector<bool> spilled;
+    /** The registers given to any value, in order of preference. */
+    std::vector<x86::reg> used;
+    allocation_stats stats;
+
+    /**
+     * @brief Finds where a value lives.
+     * @param value The value, which must have a place.
+     * @param position The position.
+     * @return Its register there, or `std::nullopt` when it is in its slot.
+     */
+    auto where(ir::value_id value, std::uint32_t position) const
+      -> std::optional<x86::reg>;
+  };
+
+  /**
+   * @brief Places the values of a function in registers by linear scan.
+   * @param target The function.
+   * @param order The blocks in the order they are laid out.
+   * @param fused The compares emitted by the branch after them, which read
+   *   their operands there and have no place of their own.
+   * @param registers The registers to use, in order of preference.
+   * @return Where every value computed at run time lives.
+   *
+   * The life of a value is made of the stretches of positions it is live
+   * at, found from the blocks it is live into; a register is free over the
+   * holes between them. Values are placed in order of where they start,
+   * each taking the register its phis or its first operand have if it is
+   * free, so that the copies between them disappear. When
+   * none is, the value among the live ones and the new one with the least
+   * spill weight goes to its slot: its uses, weighted ten times per loop
+   * they are in, over the length of what is left of its life. A value
+   * sent to its slot comes back to a register at its next use if it is
+   * used more than once after it.
+   */
+  extern auto allocate(
+    ir::function const& target,
+    std::span<ir::block_id const> order,
+    std::vector<bool> const& fused,
+    std::span<x86::reg const> registers
+  ) -> allocation;
+}
+
+#endif // _THALIA_CODEGEN_ALLOCATOR_
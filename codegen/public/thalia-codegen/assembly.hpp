@@ -0,0 +1,41 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_CODEGEN_ASSEMBLY_
+#define _THALIA_CODEGEN_ASSEMBLY_
+
+#include <ostream>
+
+#include "x86.hpp"
+
+namespace thalia::codegen {
+  /**
+   * @brief Prints a program as GNU assembler source in Intel syntax.
+   * @param os The output stream.
+   * @param target The program to print.
+   * @return The output stream.
+   *
+   * The output assembles and links with the system C compiler driver, e.g.
+   * `cc -o foo foo.s`.
+   */
+  extern auto print_assembly(std::ostream& os, x86::program const& target)
+    -> std::ostream&;
+}
+
+#endif // _THALIA_CODEGEN_ASSEMBLY_
@@ -0,0 +1,90 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_CODEGEN_C_SOURCE_
+#define _THALIA_CODEGEN_C_SOURCE_
+
+#include <memory>
+#include <span>
+#include <string>
+
+#include <thalia-syntax/stmts.hpp>
+#include <thalia-sema/checker.hpp>
+#include <thalia-sema/consteval.hpp>
+#include <thalia-sema/resolver.hpp>
+#include <thalia-sema/types.hpp>
+
+namespace thalia::codegen {
+  /**
+   * @brief Translates an analyzed syntax tree into a portable C11 program.
+   *
+   * The program behaves like `thalia run`: it prints every top-level `mut`
+   * variable when it ends, a top-level `return` sets the exit status, and a
+   * division by zero prints the error with its line and exits with status 1.
+   *
+   * Variables keep the `<stdint.h>` type of their width and blocks, `if`s and
+   * `while`s map to the same C statements. Operations that may overflow are
+   * done on unsigned operands and converted back, so they wrap instead of
+   * being undefined. Operands that assign are evaluated into temporaries,
+   * in order, since C leaves the order of such operands unspecified.
+   * Functions become `static` functions returning an `int64_t`, with the
+   * line of the call as their first parameter: past a depth of 65536
+   * calls, a call prints a stack overflow on that line and exits with
+   * status 1. Their arrays live in their own frames. A function returning
+   * a call to itself assigns the arguments to its parameters and jumps
+   * back to its start, so such a recursion runs at any depth; other calls
+   * count, returned or not.
+   * The program must be free of semantic errors.
+   */
+  class c_compiler {
+    public:
+      /**
+       * @brief Constructs a translator for an analyzed program.
+       * @param types The table the program's types were interned in.
+       * @param names The resolution of the program.
+       * @param typing The types of the program.
+       * @param values The compile-time values of the program.
+       */
+      c_compiler(
+        sema::type_table const& types,
+        sema::resolution const& names,
+        sema::typing const& typing,
+        sema::constants const& values
+      ) : _types { types }
+        , _names { names }
+        , _typing { typing }
+        , _values { values } {}
+
+      /**
+       * @brief Translates all top-level statements of a program.
+       * @param ast The top-level statements of the program.
+       * @return The source of a C translation unit defining `main`.
+       */
+      auto compile(std::span<std::shared_ptr<syntax::statement> const> ast)
+        -> std::string;
+
+    private:
+      sema::type_table const& _types;
+      sema::resolution const& _names;
+      sema::typing const& _typing;
+      sema::constants const& _values;
+  };
+}
+
+#endif // _THALIA_CODEGEN_C_SOURCE_
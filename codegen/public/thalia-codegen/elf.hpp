@@ -0,0 +1,69 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_CODEGEN_ELF_
+#define _THALIA_CODEGEN_ELF_
+
+#include <ostream>
+
+#include "encoder.hpp"
+#include "x86.hpp"
+
+namespace thalia::codegen {
+  /**
+   * @brief Adds the process entry point of a static executable.
+   * @param target The program; its entry returns the exit status.
+   * @return The label of `_start`, which calls the entry and exits with the
+   *   status it returns.
+   */
+  extern auto add_start(x86::program& target) -> x86::label;
+
+  /**
+   * @brief Writes an ELF64 relocatable object for x86-64 Linux.
+   * @param os The output stream, opened in binary mode.
+   * @param source The program the code was encoded from, for its symbols.
+   * @param code The encoded program, not linked.
+   * @return The output stream.
+   *
+   * Named labels become global functions; the object links with the system
+   * C compiler driver like the output of the assembler.
+   */
+  extern auto write_object(
+    std::ostream& os,
+    x86::program const& source,
+    x86::machine_code const& code
+  ) -> std::ostream&;
+
+  /**
+   * @brief Writes a static ELF64 executable for x86-64 Linux.
+   * @param os The output stream, opened in binary mode.
+   * @param code The encoded program, not linked.
+   * @param entry The label execution starts at (see `add_start`).
+   * @return The output stream.
+   *
+   * The code is mapped read-only and executable, the data read-only.
+   */
+  extern auto write_executable(
+    std::ostream& os,
+    x86::machine_code code,
+    x86::label entry
+  ) -> std::ostream&;
+}
+
+#endif // _THALIA_CODEGEN_ELF_
@@ -0,0 +1,74 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_CODEGEN_ENCODER_
+#define _THALIA_CODEGEN_ENCODER_
+
+#include <cstdint>
+#include <vector>
+
+#include "x86.hpp"
+
+namespace thalia::codegen::x86 {
+  /**
+   * @brief A rip-relative reference from the code to the data.
+   */
+  struct relocation {
+    /** The position of the 32-bit displacement in the code. */
+    std::uint32_t offset;
+    /** The referenced data. */
+    label target;
+    /** Added to the distance from the displacement to the target. */
+    std::int32_t addend;
+  };
+
+  /**
+   * @brief The machine code and data of a program.
+   */
+  struct machine_code {
+    /** The encoded instructions. */
+    std::vector<std::uint8_t> text;
+    /** The read-only data. */
+    std::vector<std::uint8_t> data;
+    /** The offset of every label in the code, or in the data for data labels. */
+    std::vector<std::uint32_t> offsets;
+    /** The references to the data, left to `link`. */
+    std::vector<relocation> relocations;
+  };
+
+  /**
+   * @brief Encodes a program into machine code.
+   * @param source The program.
+   * @return The code, with branches to labels resolved.
+   *
+   * Encodings match the ones the GNU assembler picks for the same source.
+   * Jumps start short and are widened until every displacement fits.
+   */
+  extern auto encode(program const& source) -> machine_code;
+
+  /**
+   * @brief Resolves the references to the data for a given placement.
+   * @param code The machine code.
+   * @param text The address the code is loaded at.
+   * @param data The address the data is loaded at, within 2 GiB of the code.
+   */
+  extern auto link(machine_code& code, std::uint64_t text, std::uint64_t data) -> void;
+}
+
+#endif // _THALIA_CODEGEN_ENCODER_
@@ -0,0 +1,107 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_CODEGEN_JIT_
+#define _THALIA_CODEGEN_JIT_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <thalia-vm/machine.hpp>
+
+#include "native.hpp"
+#include "x86.hpp"
+
+namespace thalia::codegen {
+  /**
+   * @brief Whether machine code can be run in process on this platform.
+   */
+#if defined(__x86_64__) && defined(__linux__)
+  inline constexpr bool jit_supported = true;
+#else
+  inline constexpr bool jit_supported = false;
+#endif
+
+  /**
+   * @brief Runs a function compiled by `native_compiler::compile_function`
+   *   in process.
+   *
+   * The code and its data are encoded into an anonymous mapping that is
+   * writable while they are copied and linked, then switched to read-only
+   * and executable before the first call; it is never both writable and
+   * executable. Nothing is written to disk and no other tool is involved.
+   *
+   * Throws `std::system_error` if the memory cannot be mapped, and always
+   * where `jit_supported` is false.
+   */
+  class jit_machine {
+    public:
+      /**
+       * @brief Loads a compiled function.
+       * @param program The function.
+       * @param slots The number of slots of the frame to run on, or 0 if the
+       *   function only runs on frames passed to it.
+       */
+      jit_machine(x86::program const& program, std::size_t slots);
+      jit_machine(jit_machine const&) = delete;
+      auto operator=(jit_machine const&) -> jit_machine& = delete;
+      ~jit_machine();
+
+      /**
+       * @brief Runs the function with all slots zeroed.
+       * @return How the run ended.
+       */
+      auto run() -> vm::outcome;
+
+      /**
+       * @brief Runs the function on an existing frame, in place.
+       * @param frame The values of all slots of the program.
+       * @return How the run ended.
+       */
+      auto run(std::span<std::int64_t> frame) -> vm::outcome;
+
+      /**
+       * @brief Gets the frame of the last run.
+       * @return The values of all slots.
+       */
+      auto slots() -> std::span<std::int64_t>
+        { return _slots; }
+
+      /**
+       * @brief Gets the size of the machine code and its data.
+       * @return The number of bytes in use, before rounding to pages.
+       */
+      auto code_size() const -> std::size_t
+        { return _used; }
+
+    private:
+      using entry_type = native_result (*)(std::int64_t*);
+
+    private:
+      void* _memory = nullptr;
+      std::size_t _size = 0;
+      std::size_t _used = 0;
+      entry_type _entry = nullptr;
+      std::vector<std::int64_t> _slots;
+  };
+}
+
+#endif // _THALIA_CODEGEN_JIT_
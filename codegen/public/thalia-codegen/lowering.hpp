@@ -0,0 +1,114 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_CODEGEN_LOWERING_
+#define _THALIA_CODEGEN_LOWERING_
+
+#include <span>
+#include <string>
+#include <vector>
+
+#include <thalia-ir/function.hpp>
+
+#include "allocator.hpp"
+#include "x86.hpp"
+
+namespace thalia::codegen {
+  /**
+   * @brief How the values of one compiled function were placed.
+   */
+  struct function_stats {
+    /** The name of the function. */
+    std::string name;
+    /** How its allocation did. */
+    allocation_stats stats;
+  };
+
+  /**
+   * @brief Compiles a function in SSA form into an x86-64 program.
+   *
+   * The programs behave like those of `native_compiler`, but start from the
+   * IR, so they contain only what the passes left: folded values become
+   * immediates, pruned branches and erased blocks produce no code. Blocks
+   * are laid out in reverse postorder so most jumps fall through, values
+   * are kept in the registers `allocate` gives them and in frame slots
+   * when it runs out, a compare only used by the branch after it is fused
+   * with it, and phis become copies on the edges into their block, along
+   * with the moves of values that live in different places on both ends.
+   * Arrays live in the frame, with their elements packed.
+   * The loops `ir::find_vector_loops` finds are entered through a copy of
+   * their body on SSE2 registers, which runs four iterations at a time
+   * until fewer are left and leaves the rest to the loop itself.
+   * The functions `main` can call are compiled after it, each with its own
+   * frame above the arguments pushed for it. They keep every register they
+   * use, so values stay in their registers across calls, and `r15` keeps
+   * the frame of the entry, where the traps go back to and the limit of
+   * the stack is.
+   */
+  class ir_compiler {
+    public:
+      /**
+       * @brief Constructs a compiler for a function.
+       * @param target The function, which must verify.
+       */
+      explicit ir_compiler(ir::function const& target)
+        : _target { target } {}
+
+      /**
+       * @brief Constructs a compiler for a module.
+       * @param target The module, which must verify.
+       */
+      explicit ir_compiler(ir::module const& target)
+        : _target { target.main }
+        , _functions { target.functions } {}
+
+      /**
+       * @brief Compiles the function as the program's `main`.
+       * @return The program, with `main` as entry. It prints the outputs of
+       *   the function when it returns, and returns its status.
+       */
+      auto compile() -> x86::program;
+
+      /**
+       * @brief Compiles the function to be called in process.
+       * @return The program, with `thalia_entry` as entry.
+       *
+       * The entry has the signature of the one `native_compiler` compiles
+       * statements into: it stores the outputs of the function into their
+       * slots of the array it is passed, and returns a `native_result`.
+       */
+      auto compile_function() -> x86::program;
+
+      /**
+       * @brief Tells how the values of every function were placed the last
+       *   time the program was compiled.
+       * @return One entry per compiled function, the entry first and then
+       *   the functions it calls, in the order of the module.
+       */
+      auto stats() const -> std::span<function_stats const>
+        { return _stats; }
+
+    private:
+      ir::function const& _target;
+      std::span<ir::function const> _functions;
+      std::vector<function_stats> _stats;
+  };
+}
+
+#endif // _THALIA_CODEGEN_LOWERING_
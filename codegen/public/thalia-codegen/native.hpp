@@ -0,0 +1,107 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_CODEGEN_NATIVE_
+#define _THALIA_CODEGEN_NATIVE_
+
+#include <memory>
+#include <span>
+
+#include <thalia-syntax/stmts.hpp>
+#include <thalia-sema/checker.hpp>
+#include <thalia-sema/consteval.hpp>
+#include <thalia-sema/resolver.hpp>
+#include <thalia-sema/types.hpp>
+
+#include "x86.hpp"
+
+namespace thalia::codegen {
+  /**
+   * @brief What a function compiled by `compile_function` returns, in `rax`
+   *   and `rdx`.
+   */
+  struct native_result {
+    /** The returned value, or the line of the trap. */
+    std::int64_t value;
+    /** How the run ended, as a `vm::status`. */
+    std::int64_t state;
+  };
+
+  /**
+   * @brief Compiles an analyzed syntax tree into an x86-64 program.
+   *
+   * The program is a System V `main` with the same observable behaviour as
+   * `thalia run`: it prints every top-level `mut` variable when it ends, a
+   * top-level `return` sets the exit status, and a division by zero prints
+   * the error with its line and exits with status 1. Output goes through the
+   * `write` system call, so the code needs nothing from the C library.
+   *
+   * Every slot lives in the frame of `main`, sign-extended to 64 bits, and
+   * every operation is done on 64-bit registers and wrapped back to the width
+   * of its type. Conditions compile to compare-and-branch sequences.
+   * The program must be free of semantic errors.
+   */
+  class native_compiler {
+    public:
+      /**
+       * @brief Constructs a compiler for an analyzed program.
+       * @param types The table the program's types were interned in.
+       * @param names The resolution of the program.
+       * @param typing The types of the program.
+       * @param values The compile-time values of the program.
+       */
+      native_compiler(
+        sema::type_table const& types,
+        sema::resolution const& names,
+        sema::typing const& typing,
+        sema::constants const& values
+      ) : _types { types }
+        , _names { names }
+        , _typing { typing }
+        , _values { values } {}
+
+      /**
+       * @brief Compiles all top-level statements of a program.
+       * @param ast The top-level statements of the program.
+       * @return The program, with `main` as entry.
+       */
+      auto compile(std::span<std::shared_ptr<syntax::statement> const> ast)
+        -> x86::program;
+
+      /**
+       * @brief Compiles statements into a function called in process.
+       * @param ast The statements, resolved as part of this compiler's program.
+       * @return The program, with `thalia_entry` as entry.
+       *
+       * The entry follows the System V ABI: it takes a pointer to an array
+       * of all the program's slots, which it reads and writes in place, and
+       * returns a `native_result`. Nothing is printed.
+       */
+      auto compile_function(std::span<std::shared_ptr<syntax::statement> const> ast)
+        -> x86::program;
+
+    private:
+      sema::type_table const& _types;
+      sema::resolution const& _names;
+      sema::typing const& _typing;
+      sema::constants const& _values;
+  };
+}
+
+#endif // _THALIA_CODEGEN_NATIVE_
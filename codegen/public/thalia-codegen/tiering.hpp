@@ -0,0 +1,104 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_CODEGEN_TIERING_
+#define _THALIA_CODEGEN_TIERING_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <vector>
+
+#include <thalia-syntax/stmts.hpp>
+#include <thalia-vm/chunk.hpp>
+#include <thalia-vm/machine.hpp>
+
+#include "jit.hpp"
+#include "native.hpp"
+
+namespace thalia::codegen {
+  /**
+   * @brief Configures when and how loudly loops are tiered up.
+   */
+  struct tiering_options {
+    /** How many iterations in the interpreter make a loop hot. */
+    std::uint64_t threshold = 1000;
+    /** Where to log every tier-up, if anywhere. */
+    std::ostream* trace = nullptr;
+  };
+
+  /**
+   * @brief Compiles hot loops to machine code and runs them in process.
+   *
+   * A loop is compiled the first time the interpreter offers it, with
+   * `native_compiler::compile_function` on the `while` statement alone, and
+   * the code is kept for every later entry. It works on the frame of the
+   * interpreter directly, so the live slots need no copying in either
+   * direction: the interpreter resumes after the loop with the values the
+   * compiled code left.
+   */
+  class jit_tier: public vm::tier {
+    public:
+      /**
+       * @brief Constructs a tier for a compiled program.
+       * @param compiler The native compiler of the same program.
+       * @param loops The `while` statements, indexed like the loops of the
+       *   chunk (see `vm::compiler::loops`).
+       * @param program The chunk the interpreter runs.
+       * @param options The threshold and the trace.
+       */
+      jit_tier(
+        native_compiler& compiler,
+        std::span<std::shared_ptr<syntax::statement> const> loops,
+        vm::chunk const& program,
+        tiering_options options = {}
+      ) : _compiler { compiler }
+        , _loops { loops }
+        , _program { program }
+        , _options { options }
+        , _compiled(loops.size())
+        , _entries(loops.size()) {}
+
+      auto threshold() const -> std::uint64_t override
+        { return _options.threshold; }
+
+      auto enter(std::size_t loop, std::span<std::int64_t> slots)
+        -> std::optional<vm::outcome> override;
+
+      /**
+       * @brief Gets how many times every loop ran as machine code.
+       * @return The counts, indexed like the loops of the chunk.
+       */
+      auto entries() const -> std::span<std::uint64_t const>
+        { return _entries; }
+
+    private:
+      native_compiler& _compiler;
+      std::span<std::shared_ptr<syntax::statement> const> _loops;
+      vm::chunk const& _program;
+      tiering_options _options;
+      std::vector<std::unique_ptr<jit_machine>> _compiled;
+      std::vector<std::uint64_t> _entries;
+  };
+}
+
+#endif // _THALIA_CODEGEN_TIERING_
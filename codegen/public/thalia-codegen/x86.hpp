@@ -0,0 +1,169 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_CODEGEN_X86_
+#define _THALIA_CODEGEN_X86_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace thalia::codegen::x86 {
+  /**
+   * @brief The general-purpose registers, in hardware encoding order.
+   */
+  enum class reg: std::uint8_t {
+    Rax, Rcx, Rdx, Rbx, Rsp, Rbp, Rsi, Rdi,
+    R8, R9, R10, R11, R12, R13, R14, R15
+  };
+
+  /**
+   * @brief A register accessed with a given size.
+   */
+  struct gpr {
+    reg id;
+    /** The size of the access in bytes (1, 2, 4 or 8). */
+    std::uint8_t size = 8;
+
+    auto operator==(gpr const&) const -> bool = default;
+  };
+
+  /**
+   * @brief An SSE register, `xmm0` to `xmm15`.
+   */
+  struct xmm {
+    std::uint8_t id;
+
+    auto operator==(xmm const&) const -> bool = default;
+  };
+
+  /**
+   * @brief A location in the code or data of a program.
+   */
+  struct label {
+    std::uint32_t id;
+
+    auto operator==(label const&) const -> bool = default;
+  };
+
+  /**
+   * @brief A memory operand `[base + index * scale + disp]`.
+   */
+  struct mem {
+    reg base;
+    std::int32_t disp = 0;
+    /** The size of the access in bytes (1, 2, 4, 8, or 16 for SSE). */
+    std::uint8_t size = 8;
+    /** The index register; `rsp`, which cannot be one, stands for none. */
+    reg index = reg::Rsp;
+    /** The factor of the index (1, 2, 4 or 8). */
+    std::uint8_t scale = 1;
+  };
+
+  /**
+   * @brief A memory operand addressing a label relative to `rip`.
+   */
+  struct rip_rel {
+    label target;
+  };
+
+  /**
+   * @brief An operand: a register, an immediate, memory or a jump target.
+   */
+  using operand = std::variant<std::monostate, gpr, std::int64_t, mem, rip_rel, label, xmm>;
+
+  /**
+   * @brief The conditions of conditional jumps and `set` instructions.
+   */
+  enum class cond: std::uint8_t {
+    E, Ne, L, Le, G, Ge, S, Ns, B, Ae
+  };
+
+  /**
+   * @brief Gets the condition that holds exactly when another does not.
+   * @param value The condition.
+   * @return Its negation.
+   */
+  extern auto negate(cond value) -> cond;
+
+  /**
+   * @brief The subset of instructions the code generator emits.
+   *
+   * `Label` is not an instruction: it binds its operand to the position
+   * where it appears. `RepStos` is `rep stosq`, which stores `rax` to `rcx`
+   * quadwords from `rdi` on. The SSE2 instructions work on four 32-bit
+   * lanes; `Pshufd` takes its order as a third operand, and the shifts
+   * take an immediate.
+   */
+  enum class opcode: std::uint8_t {
+    Label,
+    Mov, Movsx, Movsxd, Movzx, Lea,
+    Add, Sub, Imul, Neg, Not, And, Or, Xor, Shl, Sar, Dec,
+    Cmp, Test, Set,
+    Cqo, Idiv, Div,
+    Jmp, Jcc, Call, Ret,
+    Push, Pop, Leave, Syscall, RepStos,
+    Movd, Movdqu, Movdqa, Pshufd, Punpckldq,
+    Paddd, Psubd, Pmuludq, Pand, Por, Pxor, Pcmpeqd, Pslld, Psrad, Psrlq
+  };
+
+  /**
+   * @brief An instruction with up to three operands, destination first.
+   */
+  struct instruction {
+    opcode op;
+    /** The condition of `Jcc` and `Set`. */
+    cond cc = cond::E;
+    std::array<operand, 3> args {};
+  };
+
+  /**
+   * @brief Read-only bytes of a program.
+   */
+  struct datum {
+    label name;
+    std::string bytes;
+  };
+
+  /**
+   * @brief A whole program: code and read-only data.
+   */
+  struct program {
+    /** The instructions and label definitions, in order. */
+    std::vector<instruction> text;
+    /** The read-only data. */
+    std::vector<datum> data;
+    /** The symbol name of every label; local labels have an empty name. */
+    std::vector<std::string> symbols;
+    /** The label of the entry function, `main`. */
+    label entry { 0 };
+
+    /**
+     * @brief Creates a new label.
+     * @param symbol The name of the symbol, or empty for a local label.
+     * @return The label.
+     */
+    auto make_label(std::string symbol = {}) -> label;
+  };
+}
+
+#endif // _THALIA_CODEGEN_X86_
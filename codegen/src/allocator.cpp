@@ -0,0 +1,453 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <queue>
+
+#include <thalia-ir/dominators.hpp>
+#include <thalia-ir/loops.hpp>
+
+#include "thalia-codegen/allocator.hpp"
+
+namespace thalia::codegen {
+  namespace {
+    using ir::block_id;
+    using ir::value_id;
+
+    // A stretch of positions a value is live at, both ends included.
+    struct segment {
+      std::uint32_t start;
+      std::uint32_t end;
+    };
+
+    // What is left of the life of a value to place: the parts of its
+    // segments from `start` on.
+    struct interval {
+      value_id value;
+      std::uint32_t start;
+      std::uint32_t end;
+
+      auto operator>(interval const& other) const -> bool {
+        return start != other.start ? start > other.start : value > other.value;
+      }
+    };
+
+    struct use {
+      std::uint32_t position;
+      block_id block;
+      double weight;
+    };
+
+    struct active {
+      interval life;
+      x86::reg where;
+    };
+
+    struct scan {
+      ir::function const& target;
+      std::vector<bool> const& fused;
+      allocation& result;
+      // The uses of every value, in order.
+      std::vector<std::vector<use>> uses;
+      // Where every value is live, in order.
+      std::vector<std::vector<segment>> lives;
+      // The phis every value flows into.
+      std::vector<std::vector<value_id>> merges;
+      // The weight of the code of every block, ten times per loop it is in.
+      std::vector<double> weights;
+      std::priority_queue<interval, std::vector<interval>, std::greater<>> unhandled;
+      // The intervals holding their register at the current position, and
+      // those holding it over a later part of their life.
+      std::vector<active> live;
+      std::vector<active> waiting;
+    };
+
+    auto placed(scan const& ctx, block_id block)
+      -> bool {
+      return ctx.result.starts[block] != ir::none;
+    }
+
+    auto needs_place(scan const& ctx, value_id value)
+      -> bool {
+      auto const& current = ctx.target.at(value);
+      return current.parent != ir::none && placed(ctx, current.parent)
+        && current.kind != ir::type::Void && current.op != ir::opcode::Const
+        && current.op != ir::opcode::Array && current.op != ir::opcode::Function
+        && !ctx.fused[value];
+    }
+
+    auto defined_at(scan const& ctx, value_id value)
+      -> std::uint32_t {
+      auto position = ctx.result.positions[value];
+      return ctx.target.at(value).op == ir::opcode::Phi ? position : position + 1;
+    }
+
+    auto number(scan& ctx, std::span<block_id const> order)
+      -> void {
+      auto position = std::uint32_t { 0 };
+      for (auto block: order) {
+        ctx.result.starts[block] = position;
+        for (auto phi: ctx.target.block(block).phis)
+          ctx.result.positions[phi] = position;
+        for (auto value: ctx.target.block(block).code) {
+          position += 2;
+          ctx.result.positions[value] = position;
+        }
+        ctx.result.ends[block] = position;
+        position += 2;
+      }
+    }
+
+    auto weigh_blocks(scan& ctx)
+      -> void {
+      auto depth = std::vector<int>(ctx.target.block_count(), 0);
+      auto tree = ir::dominator_tree { ctx.target };
+      for (auto const& loop: ir::find_loops(ctx.target, tree)) {
+        for (auto block: loop.blocks)
+          ++depth[block];
+      }
+      for (auto block = block_id { 0 }; block < ctx.target.block_count(); ++block)
+        ctx.weights[block] = std::pow(10.0, std::min(depth[block], 6));
+    }
+
+    // A phi reads its operands at the end of the blocks they come from, and
+    // a fused compare at the branch after it.
+    auto collect_uses(scan& ctx, std::span<block_id const> order)
+      -> void {
+      auto const& target = ctx.target;
+      auto add = [&](value_id value, std::uint32_t position, block_id block) {
+        if (needs_place(ctx, value))
+          ctx.uses[value].push_back(use { position, block, ctx.weights[block] });
+      };
+      for (auto block: order) {
+        auto const& current = target.block(block);
+        for (auto phi: current.phis) {
+          auto args = target.operands(phi);
+          for (auto i = std::size_t { 0 }; i < args.size(); ++i) {
+            if (!placed(ctx, current.preds[i]))
+              continue;
+            add(args[i], ctx.result.ends[current.preds[i]], current.preds[i]);
+            if (needs_place(ctx, args[i]))
+              ctx.merges[args[i]].push_back(phi);
+          }
+        }
+        for (auto value: current.code) {
+          auto at = ctx.fused[value] ? ctx.result.ends[block] : ctx.result.positions[value];
+          for (auto arg: target.operands(value))
+            add(arg, at, block);
+        }
+      }
+      for (auto& list: ctx.uses) {
+        std::sort(list.begin(), list.end(), [](use const& lhs, use const& rhs) {
+          return lhs.position < rhs.position;
+        });
+      }
+    }
+
+    // Walks up from the uses of every value to its definition, marking the
+    // blocks it is live into. In each of those and in its own block, it is
+    // live until its last use there, or to the end when it is live out.
+    auto compute_lives(scan& ctx)
+      -> void {
+      auto const& target = ctx.target;
+      auto mark = std::vector<value_id>(target.block_count(), ir::none);
+      auto used = std::vector<value_id>(target.block_count(), ir::none);
+      auto last = std::vector<std::uint32_t>(target.block_count(), 0);
+      auto stack = std::vector<block_id> {};
+      auto blocks = std::vector<block_id> {};
+      for (auto value = value_id { 0 }; value < target.size(); ++value) {
+        if (!needs_place(ctx, value))
+          continue;
+        auto home = target.at(value).parent;
+        for (auto const& current: ctx.uses[value]) {
+          last[current.block] = used[current.block] == value
+            ? std::max(last[current.block], current.position)
+            : current.position;
+          used[current.block] = value;
+          if (current.block != home)
+            stack.push_back(current.block);
+        }
+        blocks.assign(1, home);
+        while (!stack.empty()) {
+          auto block = stack.back();
+          stack.pop_back();
+          if (mark[block] == value)
+            continue;
+          mark[block] = value;
+          blocks.push_back(block);
+          ctx.result.live_in[block].push_back(value);
+          for (auto pred: target.block(block).preds) {
+            if (placed(ctx, pred) && pred != home && mark[pred] != value)
+              stack.push_back(pred);
+          }
+        }
+
+        auto& lives = ctx.lives[value];
+        for (auto block: blocks) {
+          auto start = block == home ? defined_at(ctx, value) : ctx.result.starts[block];
+          auto end = used[block] == value ? std::max(start, last[block]) : start;
+          auto const& succs = target.block(block).succs;
+          if (std::any_of(succs.begin(), succs.end(), [&](block_id succ) { return mark[succ] == value; }))
+            end = ctx.result.ends[block];
+          lives.push_back(segment { start, end });
+        }
+        std::sort(lives.begin(), lives.end(), [](segment const& lhs, segment const& rhs) {
+          return lhs.start < rhs.start;
+        });
+        // Nothing happens between a terminator and the next block.
+        auto merged = std::size_t { 0 };
+        for (auto i = std::size_t { 1 }; i < lives.size(); ++i) {
+          if (lives[i].start <= lives[merged].end + 2)
+            lives[merged].end = std::max(lives[merged].end, lives[i].end);
+          else lives[++merged] = lives[i];
+        }
+        lives.resize(merged + 1);
+        ctx.unhandled.push(interval { value, defined_at(ctx, value), lives.back().end });
+      }
+    }
+
+    // Whether an interval is live at a position rather than in a hole.
+    auto covers(scan const& ctx, interval const& life, std::uint32_t position)
+      -> bool {
+      if (position < life.start || position > life.end)
+        return false;
+      auto const& lives = ctx.lives[life.value];
+      auto after = std::upper_bound(lives.begin(), lives.end(), position, [](std::uint32_t at, segment const& current) {
+        return at < current.start;
+      });
+      return after != lives.begin() && std::prev(after)->end >= position;
+    }
+
+    auto intersects(scan const& ctx, interval const& lhs, interval const& rhs)
+      -> bool {
+      auto const& left = ctx.lives[lhs.value];
+      auto const& right = ctx.lives[rhs.value];
+      auto i = std::size_t { 0 };
+      auto j = std::size_t { 0 };
+      while (i < left.size() && j < right.size()) {
+        auto start = std::max({ left[i].start, right[j].start, lhs.start, rhs.start });
+        auto end = std::min({ left[i].end, right[j].end, lhs.end, rhs.end });
+        if (start <= end)
+          return true;
+        if (left[i].end < right[j].end)
+          ++i;
+        else ++j;
+      }
+      return false;
+    }
+
+    auto add_range(scan& ctx, value_id value, std::uint32_t start, std::optional<x86::reg> where)
+      -> void {
+      auto& ranges = ctx.result.ranges[value];
+      // A register given up where it was taken was never used.
+      if (!ranges.empty() && ranges.back().start == start)
+        ranges.pop_back();
+      if (!where && !ranges.empty() && !ranges.back().where)
+        return;
+      ranges.push_back(live_range { start, where });
+    }
+
+    // The cost of keeping the rest of a life out of registers, per position.
+    auto spill_weight(scan const& ctx, interval const& life)
+      -> double {
+      auto total = 0.0;
+      if (life.start == defined_at(ctx, life.value))
+        total += ctx.weights[ctx.target.at(life.value).parent];
+      for (auto const& current: ctx.uses[life.value]) {
+        if (current.position >= life.start && current.position <= life.end)
+          total += current.weight;
+      }
+      return total / static_cast<double>(life.end - life.start + 1);
+    }
+
+    // Sends what is left of a life to the slot, and has it come back to a
+    // register at its next use when it is used more than once after it.
+    auto spill(scan& ctx, interval const& life)
+      -> void {
+      add_range(ctx, life.value, life.start, std::nullopt);
+      auto const& uses = ctx.uses[life.value];
+      auto next = std::find_if(uses.begin(), uses.end(), [&](use const& current) {
+        return current.position > life.start;
+      });
+      if (std::distance(next, uses.end()) >= 2)
+        ctx.unhandled.push(interval { life.value, next->position, life.end });
+    }
+
+    // The registers of the values a value is best placed with: those of
+    // the phis it merges, or that merge it, and of its first operand.
+    auto hints_of(scan const& ctx, value_id value)
+      -> std::vector<std::optional<x86::reg>> {
+      auto const& target = ctx.target;
+      auto const& current = target.at(value);
+      auto result = std::vector<std::optional<x86::reg>> {};
+      auto add = [&](value_id other, std::uint32_t position) {
+        if (needs_place(ctx, other) && !ctx.result.ranges[other].empty())
+          result.push_back(ctx.result.where(other, position));
+      };
+      if (current.op == ir::opcode::Phi) {
+        auto const& preds = target.block(current.parent).preds;
+        auto args = target.operands(value);
+        for (auto i = std::size_t { 0 }; i < args.size(); ++i) {
+          if (placed(ctx, preds[i]))
+            add(args[i], ctx.result.ends[preds[i]]);
+        }
+      }
+      for (auto phi: ctx.merges[value])
+        add(phi, ctx.result.positions[phi]);
+      if (current.op != ir::opcode::Phi && !target.operands(value).empty())
+        add(target.operands(value)[0], ctx.result.positions[value]);
+      return result;
+    }
+
+    auto run_scan(scan& ctx, std::span<x86::reg const> registers)
+      -> void {
+      auto index = [](x86::reg id) { return static_cast<std::size_t>(id); };
+      while (!ctx.unhandled.empty()) {
+        auto life = ctx.unhandled.top();
+        ctx.unhandled.pop();
+        auto position = life.start;
+        auto moved = std::vector<active> {};
+        std::erase_if(ctx.live, [&](active const& other) {
+          if (other.life.end >= position && !covers(ctx, other.life, position))
+            moved.push_back(other);
+          return !covers(ctx, other.life, position);
+        });
+        std::erase_if(ctx.waiting, [&](active const& other) {
+          if (covers(ctx, other.life, position))
+            ctx.live.push_back(other);
+          return other.life.end < position || covers(ctx, other.life, position);
+        });
+        ctx.waiting.insert(ctx.waiting.end(), moved.begin(), moved.end());
+
+        // A register is taken by an interval live here, and blocked by one
+        // in a hole here that is live again somewhere along this one.
+        auto taken = std::array<bool, 16> {};
+        auto blocked = std::array<bool, 16> {};
+        for (auto const& other: ctx.live)
+          taken[index(other.where)] = true;
+        for (auto const& other: ctx.waiting) {
+          if (!blocked[index(other.where)] && intersects(ctx, other.life, life))
+            blocked[index(other.where)] = true;
+        }
+        auto usable = [&](x86::reg id) {
+          return std::find(registers.begin(), registers.end(), id) != registers.end()
+            && !taken[index(id)] && !blocked[index(id)];
+        };
+
+        auto chosen = std::optional<x86::reg> {};
+        if (life.start == defined_at(ctx, life.value)) {
+          for (auto hint: hints_of(ctx, life.value)) {
+            if (hint && usable(*hint)) {
+              chosen = hint;
+              break;
+            }
+          }
+        }
+        for (auto i = std::size_t { 0 }; !chosen && i < registers.size(); ++i) {
+          if (usable(registers[i]))
+            chosen = registers[i];
+        }
+
+        if (!chosen) {
+          auto cheapest = ctx.live.end();
+          auto least = spill_weight(ctx, life);
+          for (auto other = ctx.live.begin(); other != ctx.live.end(); ++other) {
+            if (blocked[index(other->where)])
+              continue;
+            auto weight = spill_weight(ctx, interval { other->life.value, position, other->life.end });
+            if (weight < least) {
+              least = weight;
+              cheapest = other;
+            }
+          }
+          if (cheapest == ctx.live.end()) {
+            spill(ctx, life);
+            continue;
+          }
+          chosen = cheapest->where;
+          auto rest = interval { cheapest->life.value, position, cheapest->life.end };
+          ctx.live.erase(cheapest);
+          spill(ctx, rest);
+        }
+        ctx.live.push_back(active { life, *chosen });
+        add_range(ctx, life.value, life.start, chosen);
+      }
+    }
+  }
+
+  extern auto allocation::where(ir::value_id value, std::uint32_t position) const
+    -> std::optional<x86::reg> {
+    auto const& list = ranges[value];
+    auto after = std::upper_bound(list.begin(), list.end(), position, [](std::uint32_t at, live_range const& range) {
+      return at < range.start;
+    });
+    return after == list.begin() ? list.front().where : std::prev(after)->where;
+  }
+
+  extern auto allocate(
+    ir::function const& target,
+    std::span<ir::block_id const> order,
+    std::vector<bool> const& fused,
+    std::span<x86::reg const> registers
+  ) -> allocation {
+    auto result = allocation {};
+    result.positions.assign(target.size(), ir::none);
+    result.starts.assign(target.block_count(), ir::none);
+    result.ends.assign(target.block_count(), ir::none);
+    result.ranges.resize(target.size());
+    result.live_in.resize(target.block_count());
+    result.spilled.assign(target.size(), false);
+
+    auto ctx = scan {
+      target, fused, result, std::vector<std::vector<use>>(target.size()),
+      std::vector<std::vector<segment>>(target.size()), std::vector<std::vector<value_id>>(target.size()),
+      std::vector<double>(target.block_count(), 1.0), {}, {}, {}
+    };
+    number(ctx, order);
+    weigh_blocks(ctx);
+    collect_uses(ctx, order);
+    compute_lives(ctx);
+    run_scan(ctx, registers);
+
+    auto used = std::array<bool, 16> {};
+    for (auto value = value_id { 0 }; value < target.size(); ++value) {
+      auto const& ranges = result.ranges[value];
+      if (ranges.empty())
+        continue;
+      ++result.stats.values;
+      result.stats.splits += ranges.size() - 1;
+      for (auto const& range: ranges) {
+        if (!range.where)
+          result.spilled[value] = true;
+        else used[static_cast<std::size_t>(*range.where)] = true;
+      }
+      if (result.spilled[value])
+        ++result.stats.spilled;
+      else ++result.stats.in_registers;
+    }
+    for (auto id: registers) {
+      if (used[static_cast<std::size_t>(id)])
+        result.used.push_back(id);
+    }
+    return result;
+  }
+}
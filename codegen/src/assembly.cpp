@@ -0,0 +1,152 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <bit>
+#include <string_view>
+
+#include "thalia-codegen/assembly.hpp"
+
+namespace thalia::codegen {
+  namespace {
+    constexpr std::string_view names[4][16] = {
+      { "al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+        "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b" },
+      { "ax", "cx", "dx", "bx", "sp", "bp", "si", "di",
+        "r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w" },
+      { "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+        "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d" },
+      { "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+        "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15" }
+    };
+
+    constexpr std::string_view mnemonics[] = {
+      "", "mov", "movsx", "movsxd", "movzx", "lea",
+      "add", "sub", "imul", "neg", "not", "and", "or", "xor", "shl", "sar", "dec",
+      "cmp", "test", "set", "cqo", "idiv", "div",
+      "jmp", "j", "call", "ret", "push", "pop", "leave", "syscall", "rep stosq",
+      "movd", "movdqu", "movdqa", "pshufd", "punpckldq",
+      "paddd", "psubd", "pmuludq", "pand", "por", "pxor", "pcmpeqd", "pslld", "psrad", "psrlq"
+    };
+
+    constexpr std::string_view size_names[] = {
+      "BYTE", "WORD", "DWORD", "QWORD", "XMMWORD"
+    };
+
+    constexpr std::string_view conditions[] = {
+      "e", "ne", "l", "le", "g", "ge", "s", "ns", "b", "ae"
+    };
+
+    auto name_of(x86::gpr value)
+      -> std::string_view {
+      auto size = value.size == 1 ? 0 : value.size == 2 ? 1 : value.size == 4 ? 2 : 3;
+      return names[size][static_cast<std::size_t>(value.id)];
+    }
+
+    auto print_label(std::ostream& os, x86::program const& target, x86::label value)
+      -> void {
+      auto const& symbol = target.symbols[value.id];
+      if (symbol.empty())
+        os << ".L" << value.id;
+      else os << symbol;
+    }
+
+    auto print_operand(
+      std::ostream& os,
+      x86::program const& target,
+      x86::operand const& value,
+      bool sized
+    ) -> void {
+      if (auto const* reg = std::get_if<x86::gpr>(&value)) {
+        os << name_of(*reg);
+      } else if (auto const* vector = std::get_if<x86::xmm>(&value)) {
+        os << "xmm" << static_cast<int>(vector->id);
+      } else if (auto const* imm = std::get_if<std::int64_t>(&value)) {
+        os << *imm;
+      } else if (auto const* memory = std::get_if<x86::mem>(&value)) {
+        if (sized)
+          os << size_names[std::countr_zero(memory->size)] << " PTR ";
+        os << '[' << name_of(x86::gpr { memory->base });
+        if (memory->index != x86::reg::Rsp)
+          os << '+' << name_of(x86::gpr { memory->index }) << '*' << static_cast<int>(memory->scale);
+        if (memory->disp > 0)
+          os << '+' << memory->disp;
+        else if (memory->disp < 0)
+          os << memory->disp;
+        os << ']';
+      } else if (auto const* relative = std::get_if<x86::rip_rel>(&value)) {
+        os << "[rip+";
+        print_label(os, target, relative->target);
+        os << ']';
+      } else if (auto const* location = std::get_if<x86::label>(&value)) {
+        print_label(os, target, *location);
+      }
+    }
+
+    auto print_bytes(std::ostream& os, std::string_view bytes)
+      -> void {
+      os << "\t.ascii \"";
+      for (auto c: bytes) {
+        if (c == '\n')
+          os << "\\n";
+        else if (c == '"' || c == '\\')
+          os << '\\' << c;
+        else os << c;
+      }
+      os << "\"\n";
+    }
+  }
+
+  extern auto print_assembly(std::ostream& os, x86::program const& target)
+    -> std::ostream& {
+    os << "\t.intel_syntax noprefix\n\t.text\n\t.globl ";
+    print_label(os, target, target.entry);
+    os << "\n\t.type ";
+    print_label(os, target, target.entry);
+    os << ", @function\n";
+
+    for (auto const& current: target.text) {
+      if (current.op == x86::opcode::Label) {
+        print_label(os, target, std::get<x86::label>(current.args[0]));
+        os << ":\n";
+        continue;
+      }
+
+      os << '\t' << mnemonics[static_cast<std::size_t>(current.op)];
+      if (current.op == x86::opcode::Jcc || current.op == x86::opcode::Set)
+        os << conditions[static_cast<std::size_t>(current.cc)];
+      auto sized = current.op != x86::opcode::Lea;
+      for (auto i = std::size_t { 0 }; i < current.args.size(); ++i) {
+        if (std::holds_alternative<std::monostate>(current.args[i]))
+          break;
+        os << (i == 0 ? " " : ", ");
+        print_operand(os, target, current.args[i], sized);
+      }
+      os << '\n';
+    }
+
+    os << "\t.section .rodata\n";
+    for (auto const& entry: target.data) {
+      print_label(os, target, entry.name);
+      os << ":\n";
+      print_bytes(os, entry.bytes);
+    }
+    os << "\t.section .note.GNU-stack,\"\",@progbits\n";
+    return os;
+  }
+}
@@ -0,0 +1,687 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <thalia-sema/arith.hpp>
+#include <thalia-sema/tail_calls.hpp>
+
+#include "thalia-codegen/c_source.hpp"
+
+namespace thalia::codegen {
+  namespace {
+    constexpr auto prelude =
+      "#include <inttypes.h>\n"
+      "#include <stdint.h>\n"
+      "#include <stdio.h>\n"
+      "#include <stdlib.h>\n"
+      "#include <string.h>\n"
+      "\n"
+      "static _Noreturn void thalia_trap(int line) {\n"
+      "  printf(\"[ERROR]: Division by zero\\n    ---> on line %d.\\n\", line);\n"
+      "  exit(1);\n"
+      "}\n"
+      "\n"
+      "static inline int64_t thalia_div(int64_t lhs, int64_t rhs, int line) {\n"
+      "  if (rhs == 0)\n"
+      "    thalia_trap(line);\n"
+      "  return rhs == -1 ? (int64_t)-(uint64_t)lhs : lhs / rhs;\n"
+      "}\n"
+      "\n"
+      "static inline int64_t thalia_mod(int64_t lhs, int64_t rhs, int line) {\n"
+      "  if (rhs == 0)\n"
+      "    thalia_trap(line);\n"
+      "  return rhs == -1 ? 0 : lhs % rhs;\n"
+      "}\n"
+      "\n"
+      "static inline int64_t thalia_index(int64_t index, int64_t length, int line) {\n"
+      "  if ((uint64_t)index >= (uint64_t)length) {\n"
+      "    printf(\"[ERROR]: Index out of range\\n    ---> on line %d.\\n\", line);\n"
+      "    exit(1);\n"
+      "  }\n"
+      "  return index;\n"
+      "}\n"
+      "\n"
+      "static int64_t thalia_depth;\n"
+      "\n"
+      "static inline void thalia_enter(int line) {\n"
+      "  if (++thalia_depth > 65536) {\n"
+      "    printf(\"[ERROR]: Stack overflow\\n    ---> on line %d.\\n\", line);\n"
+      "    exit(1);\n"
+      "  }\n"
+      "}\n"
+      "\n"
+      "static inline int64_t thalia_leave(int64_t value) {\n"
+      "  --thalia_depth;\n"
+      "  return value;\n"
+      "}\n"
+      "\n";
+
+    struct context {
+      sema::type_table const& types;
+      sema::resolution const& names;
+      sema::typing const& typing;
+      sema::constants const& values;
+      std::ostringstream out;
+      std::size_t depth;
+      std::size_t temps;
+      bool returns;
+      // The function being translated, or `npos` for `main`.
+      std::size_t function;
+      // Whether the function returns a call to itself, which jumps back to
+      // its start.
+      bool recurs;
+    };
+
+    auto signed_type(std::size_t width)
+      -> std::string {
+      return std::string { "int" }.append(std::to_string(width)).append("_t");
+    }
+
+    // The unsigned type operations of a width are done in; narrower operands
+    // would be promoted to `int`, which can overflow.
+    auto unsigned_type(std::size_t width)
+      -> std::string {
+      return width == 64 ? "uint64_t" : "uint32_t";
+    }
+
+    auto literal(std::int64_t value)
+      -> std::string {
+      if (value == std::numeric_limits<std::int64_t>::min())
+        return "INT64_MIN";
+      return std::to_string(value);
+    }
+
+    auto unwrap(std::shared_ptr<syntax::expression> node)
+      -> std::shared_ptr<syntax::expression> {
+      while (node && node->is(syntax::expr_type::Paren))
+        node = std::static_pointer_cast<syntax::expr_paren>(node)->value();
+      return node;
+    }
+
+    auto width_of(context& ctx, std::shared_ptr<syntax::expression> const& node)
+      -> std::size_t {
+      return ctx.types.get(ctx.typing.type_of(*node)).width;
+    }
+
+    auto name_of(context& ctx, std::size_t slot)
+      -> std::string {
+      auto const& symbol = ctx.names.symbols()[slot];
+      return std::string { symbol.declaration->id.value() }
+        .append("_").append(std::to_string(slot));
+    }
+
+    auto function_name(context& ctx, std::size_t function)
+      -> std::string {
+      auto const& declared = *ctx.names.functions()[function].declaration;
+      return std::string { declared.id().value() }.append("_f").append(std::to_string(function));
+    }
+
+    auto indent(context& ctx)
+      -> std::ostringstream& {
+      ctx.out << std::string(2 * ctx.depth, ' ');
+      return ctx.out;
+    }
+
+    // Whether evaluating a node writes a variable.
+    auto assigns(std::shared_ptr<syntax::expression> const& node)
+      -> bool {
+      if (!node)
+        return false;
+      switch (node->type()) {
+        case syntax::expr_type::Assign:
+          return true;
+        case syntax::expr_type::Binary: {
+          auto root = std::static_pointer_cast<syntax::expr_binary>(node);
+          return assigns(root->lhs()) || assigns(root->rhs());
+        }
+        case syntax::expr_type::Unary:
+          return assigns(std::static_pointer_cast<syntax::expr_unary>(node)->value());
+        case syntax::expr_type::Paren:
+          return assigns(std::static_pointer_cast<syntax::expr_paren>(node)->value());
+        case syntax::expr_type::Index:
+          return assigns(std::static_pointer_cast<syntax::expr_index>(node)->index());
+        case syntax::expr_type::Call: {
+          auto args = std::static_pointer_cast<syntax::expr_call>(node)->args();
+          return std::any_of(args.begin(), args.end(), [](auto const& arg) { return assigns(arg); });
+        }
+        default:
+          return false;
+      }
+    }
+
+    // Whether a node is evaluated without any effect, including a trap.
+    auto is_pure(context& ctx, std::shared_ptr<syntax::expression> const& node)
+      -> bool {
+      auto inner = unwrap(node);
+      return !inner || ctx.values.value(*inner) || inner->is(syntax::expr_type::Id);
+    }
+
+    // Applies an arithmetic, bitwise or comparison operator to two operands.
+    auto gen_arith(
+      syntax::token const& operation,
+      syntax::token_type type,
+      std::string const& lhs,
+      std::string const& rhs,
+      std::size_t width
+    ) -> std::string {
+      auto result = signed_type(width);
+      auto wide = unsigned_type(width);
+      auto line = std::to_string(operation.line());
+      auto mask = std::to_string(width - 1);
+      switch (type) {
+        case syntax::token_type::Plus:
+          return "(" + result + ")((" + wide + ")(" + lhs + ") + (" + wide + ")(" + rhs + "))";
+        case syntax::token_type::Minus:
+          return "(" + result + ")((" + wide + ")(" + lhs + ") - (" + wide + ")(" + rhs + "))";
+        case syntax::token_type::Mul:
+          return "(" + result + ")((" + wide + ")(" + lhs + ") * (" + wide + ")(" + rhs + "))";
+        case syntax::token_type::Div:
+          return "(" + result + ")(" + wide + ")thalia_div(" + lhs + ", " + rhs + ", " + line + ")";
+        case syntax::token_type::Mod:
+          return "(" + result + ")thalia_mod(" + lhs + ", " + rhs + ", " + line + ")";
+        case syntax::token_type::LShift:
+          return "(" + result + ")((" + wide + ")(" + lhs + ") << ((" + rhs + ") & " + mask + "))";
+        case syntax::token_type::RShift:
+          return "((" + result + ")(" + lhs + ") >> ((" + rhs + ") & " + mask + "))";
+        case syntax::token_type::BitAnd:
+          return "((" + lhs + ") & (" + rhs + "))";
+        case syntax::token_type::BitOr:
+          return "((" + lhs + ") | (" + rhs + "))";
+        case syntax::token_type::Xor:
+          return "((" + lhs + ") ^ (" + rhs + "))";
+        case syntax::token_type::Less:
+          return "((" + lhs + ") < (" + rhs + "))";
+        case syntax::token_type::LessEqual:
+          return "((" + lhs + ") <= (" + rhs + "))";
+        case syntax::token_type::Grt:
+          return "((" + lhs + ") > (" + rhs + "))";
+        case syntax::token_type::GrtEqual:
+          return "((" + lhs + ") >= (" + rhs + "))";
+        case syntax::token_type::Equal:
+          return "((" + lhs + ") == (" + rhs + "))";
+        default:
+          return "((" + lhs + ") != (" + rhs + "))";
+      }
+    }
+
+    class expr_translator
+      : public syntax::expr_visitor<context&, std::string> {
+      public:
+        expr_translator(std::shared_ptr<syntax::expression> const& node)
+          : syntax::expr_visitor<context&, std::string> { node } {}
+
+        auto translate(context& ctx) -> std::string;
+
+        /**
+         * @brief Translates an assignment without enclosing parentheses.
+         */
+        auto assignment(context& ctx) -> std::string;
+
+      protected:
+        auto visit_expr_assign(context& ctx) -> std::string override
+          { return std::string { "(" }.append(assignment(ctx)).append(")"); }
+        auto visit_expr_binary(context& ctx) -> std::string override;
+        auto visit_expr_unary(context& ctx) -> std::string override;
+        auto visit_expr_paren(context& ctx) -> std::string override;
+        auto visit_expr_base_lit(context& ctx) -> std::string override;
+        auto visit_expr_id(context& ctx) -> std::string override;
+        auto visit_expr_index(context& ctx) -> std::string override;
+        auto visit_expr_call(context& ctx) -> std::string override;
+        auto visit_expr_data_type(context&) -> std::string override
+          { return "0"; }
+        auto visit_expr_array_type(context&) -> std::string override
+          { return "0"; }
+
+      private:
+        auto element_assignment(context& ctx) -> std::string;
+    };
+
+    class stmt_translator
+      : public syntax::stmt_visitor<context&, void> {
+      public:
+        stmt_translator(std::shared_ptr<syntax::statement> const& node)
+          : syntax::stmt_visitor<context&, void> { node } {}
+
+        auto translate(context& ctx) -> void
+          { if (_node) visit_stmt(ctx); }
+
+        /**
+         * @brief Translates the body of an `if` or a `while` as a block.
+         */
+        auto body(context& ctx) -> void;
+
+      protected:
+        auto visit_stmt_block(context& ctx) -> void override;
+        auto visit_stmt_return(context& ctx) -> void override;
+        auto visit_stmt_expr(context& ctx) -> void override;
+        auto visit_stmt_if(context& ctx) -> void override;
+        auto visit_stmt_while(context& ctx) -> void override;
+        auto visit_stmt_local(context& ctx) -> void override;
+        auto visit_stmt_function(context&) -> void override
+          {}
+    };
+
+    auto gen_expr(context& ctx, std::shared_ptr<syntax::expression> const& node)
+      -> std::string {
+      return expr_translator { node }.translate(ctx);
+    }
+
+    auto make_temp(context& ctx)
+      -> std::string {
+      return std::string { "t" }.append(std::to_string(ctx.temps++));
+    }
+
+    extern auto expr_translator::translate(context& ctx)
+      -> std::string {
+      if (!_node)
+        return "0";
+      if (auto folded = ctx.values.value(*_node))
+        return literal(*folded);
+      return visit_expr(ctx);
+    }
+
+    // The array an index selects from, its length and the checked index.
+    auto element_of(context& ctx, syntax::expr_index const& node, std::string const& index)
+      -> std::string {
+      auto variable = std::static_pointer_cast<syntax::expr_id>(unwrap(node.target()));
+      auto slot = ctx.names.slot(*variable);
+      auto length = ctx.types.get(ctx.typing.slot_type(slot)).length;
+      return name_of(ctx, slot) + "[thalia_index(" + index + ", " + std::to_string(length)
+        + ", " + std::to_string(node.bracket().line()) + ")]";
+    }
+
+    // The index is evaluated first and checked when the element is accessed:
+    // after the value for a plain assignment, before it for an update.
+    // Temporaries keep that order whenever the value has an effect.
+    extern auto expr_translator::element_assignment(context& ctx)
+      -> std::string {
+      auto root = std::static_pointer_cast<syntax::expr_assign>(_node);
+      auto target = std::static_pointer_cast<syntax::expr_index>(unwrap(root->target()));
+      auto index = gen_expr(ctx, target->index());
+      auto value = gen_expr(ctx, root->value());
+
+      auto operation = sema::binary_of(root->operation().type());
+      if (operation == syntax::token_type::Assign) {
+        if (is_pure(ctx, root->value()))
+          return element_of(ctx, *target, index) + " = " + value;
+        auto at = make_temp(ctx);
+        auto rhs = make_temp(ctx);
+        return at + " = " + index + ", " + rhs + " = " + value + ", "
+          + element_of(ctx, *target, at) + " = " + rhs;
+      }
+
+      auto at = make_temp(ctx);
+      auto old = make_temp(ctx);
+      auto rhs = make_temp(ctx);
+      auto element = element_of(ctx, *target, at);
+      return at + " = " + index + ", " + old + " = " + element + ", " + rhs + " = " + value + ", "
+        + element + " = " + gen_arith(root->operation(), operation, old, rhs, width_of(ctx, target));
+    }
+
+    extern auto expr_translator::assignment(context& ctx)
+      -> std::string {
+      auto root = std::static_pointer_cast<syntax::expr_assign>(_node);
+      if (unwrap(root->target())->is(syntax::expr_type::Index))
+        return element_assignment(ctx);
+      auto variable = std::static_pointer_cast<syntax::expr_id>(unwrap(root->target()));
+      auto target = name_of(ctx, ctx.names.slot(*variable));
+      auto value = gen_expr(ctx, root->value());
+
+      auto operation = sema::binary_of(root->operation().type());
+      if (operation == syntax::token_type::Assign)
+        return target + " = " + value;
+
+      // The old value is read before the right-hand side runs.
+      auto width = width_of(ctx, variable);
+      if (!assigns(root->value()))
+        return target + " = " + gen_arith(root->operation(), operation, target, value, width);
+      auto old = make_temp(ctx);
+      auto rhs = make_temp(ctx);
+      return old + " = " + target + ", " + rhs + " = " + value + ", "
+        + target + " = " + gen_arith(root->operation(), operation, old, rhs, width);
+    }
+
+    extern auto expr_translator::visit_expr_binary(context& ctx)
+      -> std::string {
+      auto root = std::static_pointer_cast<syntax::expr_binary>(_node);
+      auto operation = root->operation();
+      auto lhs = gen_expr(ctx, root->lhs());
+      auto rhs = gen_expr(ctx, root->rhs());
+      switch (operation.type()) {
+        case syntax::token_type::LogAnd:
+          return "((" + lhs + ") && (" + rhs + "))";
+        case syntax::token_type::LogOr:
+          return "((" + lhs + ") || (" + rhs + "))";
+        default:
+          break;
+      }
+
+      auto width = width_of(ctx, root->lhs());
+      if (!assigns(root->lhs()) && !assigns(root->rhs()))
+        return gen_arith(operation, operation.type(), lhs, rhs, width);
+      auto first = make_temp(ctx);
+      auto second = make_temp(ctx);
+      return "(" + first + " = " + lhs + ", " + second + " = " + rhs + ", "
+        + gen_arith(operation, operation.type(), first, second, width) + ")";
+    }
+
+    extern auto expr_translator::visit_expr_unary(context& ctx)
+      -> std::string {
+      auto root = std::static_pointer_cast<syntax::expr_unary>(_node);
+      auto value = gen_expr(ctx, root->value());
+      auto width = width_of(ctx, _node);
+      switch (root->operation().type()) {
+        case syntax::token_type::Minus:
+          return std::string { "(" }.append(signed_type(width)).append(")-(")
+            .append(unsigned_type(width)).append(")(").append(value).append(")");
+        case syntax::token_type::BitNot:
+          return std::string { "(" }.append(signed_type(width))
+            .append(")~(").append(value).append(")");
+        case syntax::token_type::LogNot:
+          return "!(" + value + ")";
+        default:
+          return value;
+      }
+    }
+
+    extern auto expr_translator::visit_expr_paren(context& ctx)
+      -> std::string {
+      auto root = std::static_pointer_cast<syntax::expr_paren>(_node);
+      return gen_expr(ctx, root->value());
+    }
+
+    extern auto expr_translator::visit_expr_base_lit(context& ctx)
+      -> std::string {
+      // Checked literals are always folded already.
+      auto root = std::static_pointer_cast<syntax::expr_base_lit>(_node);
+      return literal(sema::parse_literal(root->target().value(), width_of(ctx, _node)).value);
+    }
+
+    extern auto expr_translator::visit_expr_id(context& ctx)
+      -> std::string {
+      auto root = std::static_pointer_cast<syntax::expr_id>(_node);
+      return name_of(ctx, ctx.names.slot(*root));
+    }
+
+    extern auto expr_translator::visit_expr_index(context& ctx)
+      -> std::string {
+      auto root = std::static_pointer_cast<syntax::expr_index>(_node);
+      return element_of(ctx, *root, gen_expr(ctx, root->index()));
+    }
+
+    // Calls pass the line they are on first, for the stack overflow they
+    // may report. Arguments that assign are evaluated into temporaries
+    // first, in order.
+    extern auto expr_translator::visit_expr_call(context& ctx)
+      -> std::string {
+      auto root = std::static_pointer_cast<syntax::expr_call>(_node);
+      auto args = root->args();
+      auto ordered = std::any_of(args.begin(), args.end(), [](auto const& arg) { return assigns(arg); });
+      auto prefix = std::string {};
+      auto call = function_name(ctx, ctx.names.callee(*root)) + "(" + std::to_string(root->callee().line());
+      for (auto const& arg: args) {
+        auto value = gen_expr(ctx, arg);
+        if (ordered) {
+          auto temp = make_temp(ctx);
+          prefix.append(temp).append(" = ").append(value).append(", ");
+          value = temp;
+        }
+        call.append(", ").append(value);
+      }
+      call.append(")");
+      if (ctx.types.get(ctx.typing.type_of(*_node)).kind != sema::type_kind::Void)
+        call = std::string { "(" }.append(signed_type(width_of(ctx, _node))).append(")").append(call);
+      return prefix.empty() ? call : std::string { "(" }.append(prefix).append(call).append(")");
+    }
+
+    extern auto stmt_translator::body(context& ctx)
+      -> void {
+      if (_node && _node->is(syntax::stmt_type::Block)) {
+        visit_stmt(ctx);
+        return;
+      }
+      ctx.out << "{\n";
+      ++ctx.depth;
+      translate(ctx);
+      --ctx.depth;
+      indent(ctx) << "}\n";
+    }
+
+    extern auto stmt_translator::visit_stmt_block(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_block>(_node);
+      ctx.out << "{\n";
+      ++ctx.depth;
+      for (auto const& node: root->content()) {
+        if (!node)
+          continue;
+        // Nested blocks start on their own line.
+        if (node->is(syntax::stmt_type::Block))
+          indent(ctx);
+        stmt_translator { node }.translate(ctx);
+      }
+      --ctx.depth;
+      indent(ctx) << "}\n";
+    }
+
+    extern auto stmt_translator::visit_stmt_return(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_return>(_node);
+      auto tail = sema::tail_call_of(*root);
+      if (tail && ctx.function != sema::resolution::npos && ctx.names.callee(*tail) == ctx.function) {
+        // Every argument is evaluated before any parameter changes.
+        auto first = ctx.names.functions()[ctx.function].first;
+        auto args = tail->args();
+        auto temps = std::vector<std::string> {};
+        for (auto const& arg: args) {
+          temps.push_back(make_temp(ctx));
+          indent(ctx) << temps.back() << " = " << gen_expr(ctx, arg) << ";\n";
+        }
+        for (auto i = std::size_t { 0 }; i < args.size(); ++i) {
+          auto slot = first + i;
+          indent(ctx) << name_of(ctx, slot) << " = ("
+            << signed_type(ctx.types.get(ctx.typing.slot_type(slot)).width) << ")" << temps[i] << ";\n";
+        }
+        indent(ctx) << "goto recur;\n";
+        ctx.recurs = true;
+        return;
+      }
+      if (ctx.function != sema::resolution::npos) {
+        indent(ctx) << "return thalia_leave(" << gen_expr(ctx, root->value()) << ");\n";
+        return;
+      }
+      ctx.returns = true;
+      indent(ctx) << "status = " << gen_expr(ctx, root->value()) << ";\n";
+      indent(ctx) << "goto finish;\n";
+    }
+
+    extern auto stmt_translator::visit_stmt_expr(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_expr>(_node);
+      auto value = unwrap(root->value());
+      if (!value || ctx.values.value(*value))
+        return;
+      if (value->is(syntax::expr_type::Assign)) {
+        indent(ctx) << expr_translator { value }.assignment(ctx) << ";\n";
+        return;
+      }
+      indent(ctx) << "(void)" << gen_expr(ctx, value) << ";\n";
+    }
+
+    extern auto stmt_translator::visit_stmt_if(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_if>(_node);
+      indent(ctx) << "if (" << gen_expr(ctx, root->condition()) << ") ";
+      stmt_translator { root->main_body() }.body(ctx);
+      if (!root->else_body())
+        return;
+      indent(ctx) << "else ";
+      stmt_translator { root->else_body() }.body(ctx);
+    }
+
+    extern auto stmt_translator::visit_stmt_while(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_while>(_node);
+      indent(ctx) << "while (" << gen_expr(ctx, root->condition()) << ") ";
+      stmt_translator { root->body() }.body(ctx);
+    }
+
+    extern auto stmt_translator::visit_stmt_local(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_local>(_node);
+      for (auto const& variable: root->content()) {
+        // Constants are folded into every use.
+        auto slot = ctx.names.slot(variable);
+        if (ctx.values.slot_value(slot))
+          continue;
+        // Arrays are static, as they may not fit the stack, but in
+        // functions, whose every call has its own, and cleared whenever
+        // their declaration runs.
+        auto const& declared = ctx.types.get(ctx.typing.slot_type(slot));
+        if (declared.kind == sema::type_kind::Array) {
+          if (ctx.function != sema::resolution::npos) {
+            indent(ctx) << signed_type(declared.width) << ' ' << name_of(ctx, slot)
+              << '[' << declared.length << "];\n";
+          } else if (ctx.names.symbols()[slot].depth != 0) {
+            indent(ctx) << "static " << signed_type(declared.width) << ' ' << name_of(ctx, slot)
+              << '[' << declared.length << "];\n";
+          }
+          indent(ctx) << "memset(" << name_of(ctx, slot) << ", 0, sizeof " << name_of(ctx, slot) << ");\n";
+          continue;
+        }
+
+        auto value = gen_expr(ctx, variable.value);
+        // Top-level variables are declared ahead, so `finish` sees them.
+        if (ctx.names.symbols()[slot].depth == 0) {
+          indent(ctx) << name_of(ctx, slot) << " = " << value << ";\n";
+          continue;
+        }
+        auto width = ctx.types.get(ctx.typing.slot_type(slot)).width;
+        indent(ctx) << signed_type(width) << ' ' << name_of(ctx, slot)
+          << " = " << value << ";\n";
+      }
+    }
+
+    // Every function returns an `int64_t`, zero when it has no result, and
+    // takes the line of the call first.
+    auto signature_of(context& ctx, std::size_t function)
+      -> std::string {
+      auto const& definition = *ctx.names.functions()[function].definition;
+      auto result = "static int64_t " + function_name(ctx, function) + "(int line";
+      for (auto const& param: definition.params()) {
+        auto slot = ctx.names.slot(param);
+        result.append(", ").append(signed_type(ctx.types.get(ctx.typing.slot_type(slot)).width))
+          .append(" ").append(name_of(ctx, slot));
+      }
+      return result.append(")");
+    }
+
+    auto translate_function(context& top, std::size_t function)
+      -> std::string {
+      auto ctx = context { top.types, top.names, top.typing, top.values, {}, 1, 0, false, function, false };
+      auto body = std::static_pointer_cast<syntax::stmt_block>(top.names.functions()[function].definition->body());
+      for (auto const& node: body->content()) {
+        if (node && node->is(syntax::stmt_type::Block))
+          indent(ctx);
+        stmt_translator { node }.translate(ctx);
+      }
+
+      auto out = std::ostringstream {};
+      out << signature_of(ctx, function) << " {\n";
+      if (ctx.temps != 0) {
+        out << "  int64_t t0";
+        for (auto temp = std::size_t { 1 }; temp < ctx.temps; ++temp)
+          out << ", t" << temp;
+        out << ";\n";
+      }
+      out << "  thalia_enter(line);\n";
+      if (ctx.recurs)
+        out << "recur:\n";
+      out << ctx.out.str() << "  return thalia_leave(0);\n}\n";
+      return out.str();
+    }
+  }
+
+  extern auto c_compiler::compile(
+    std::span<std::shared_ptr<syntax::statement> const> ast
+  ) -> std::string {
+    auto ctx = context { _types, _names, _typing, _values, {}, 1, 0, false, sema::resolution::npos, false };
+    for (auto const& node: ast) {
+      if (node && node->is(syntax::stmt_type::Block))
+        indent(ctx);
+      stmt_translator { node }.translate(ctx);
+    }
+
+    auto out = std::ostringstream {};
+    out << prelude;
+    auto functions = _names.functions();
+    for (auto index = std::size_t { 0 }; index < functions.size(); ++index) {
+      if (functions[index].definition)
+        out << signature_of(ctx, index) << ";\n";
+    }
+    if (!functions.empty())
+      out << '\n';
+    for (auto index = std::size_t { 0 }; index < functions.size(); ++index) {
+      if (functions[index].definition)
+        out << translate_function(ctx, index) << '\n';
+    }
+    out << "int main(void) {\n";
+    auto symbols = _names.symbols();
+    for (auto slot = std::size_t { 0 }; slot < symbols.size(); ++slot) {
+      if (symbols[slot].depth != 0 || symbols[slot].external || _values.slot_value(slot))
+        continue;
+      auto const& declared = _types.get(_typing.slot_type(slot));
+      if (declared.kind == sema::type_kind::Array) {
+        out << "  static " << signed_type(declared.width) << ' ' << name_of(ctx, slot)
+          << '[' << declared.length << "];\n";
+        continue;
+      }
+      out << "  " << signed_type(declared.width) << ' ' << name_of(ctx, slot) << " = 0;\n";
+    }
+    if (ctx.returns)
+      out << "  int64_t status = 0;\n";
+    if (ctx.temps != 0) {
+      out << "  int64_t t0";
+      for (auto temp = std::size_t { 1 }; temp < ctx.temps; ++temp)
+        out << ", t" << temp;
+      out << ";\n";
+    }
+    out << ctx.out.str();
+
+    if (ctx.returns)
+      out << "finish:\n";
+    for (auto slot = std::size_t { 0 }; slot < symbols.size(); ++slot) {
+      auto const& symbol = symbols[slot];
+      if (symbol.depth != 0 || symbol.external || !symbol.declaration->mut)
+        continue;
+      if (_types.is_array(_typing.slot_type(slot)))
+        continue;
+      out << "  printf(\"" << symbol.declaration->id.value() << " = %\" PRId64 \"\\n\", (int64_t)"
+        << name_of(ctx, slot) << ");\n";
+    }
+    out << (ctx.returns ? "  return (int)status;\n" : "  return 0;\n") << "}\n";
+    return out.str();
+  }
+}
@@ -0,0 +1,301 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "thalia-codegen/elf.hpp"
+
+namespace thalia::codegen {
+  namespace {
+    constexpr auto header_size = std::uint64_t { 64 };
+    constexpr auto segment_size = std::uint64_t { 56 };
+    constexpr auto section_size = std::uint64_t { 64 };
+    constexpr auto symbol_size = std::uint64_t { 24 };
+    constexpr auto rela_size = std::uint64_t { 24 };
+    constexpr auto page = std::uint64_t { 0x1000 };
+    constexpr auto base_address = std::uint64_t { 0x400000 };
+
+    enum : std::uint16_t { ET_REL = 1, ET_EXEC = 2, EM_X86_64 = 62 };
+    enum : std::uint32_t {
+      SHT_PROGBITS = 1, SHT_SYMTAB = 2, SHT_STRTAB = 3, SHT_RELA = 4,
+      PT_LOAD = 1, PT_GNU_STACK = 0x6474e551,
+      PF_X = 1, PF_W = 2, PF_R = 4,
+      R_X86_64_PC32 = 2
+    };
+    enum : std::uint64_t { SHF_ALLOC = 2, SHF_EXECINSTR = 4, SHF_INFO_LINK = 0x40 };
+    enum : std::uint8_t { STB_GLOBAL = 1, STT_FUNC = 2, STT_SECTION = 3 };
+
+    // A little-endian file image.
+    class image {
+      public:
+        std::vector<std::uint8_t> bytes;
+
+      public:
+        auto put(std::uint64_t value, std::size_t size) -> void {
+          for (auto i = std::size_t { 0 }; i < size; ++i)
+            bytes.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+        }
+
+        auto put(std::vector<std::uint8_t> const& data) -> void
+          { bytes.insert(bytes.end(), data.begin(), data.end()); }
+
+        auto put(std::string_view data) -> void
+          { bytes.insert(bytes.end(), data.begin(), data.end()); }
+
+        auto align(std::size_t alignment) -> std::uint64_t {
+          while (bytes.size() % alignment != 0)
+            bytes.push_back(0);
+          return bytes.size();
+        }
+
+        auto size() const -> std::uint64_t
+          { return bytes.size(); }
+    };
+
+    struct header {
+      std::uint16_t type;
+      std::uint64_t entry;
+      std::uint64_t segments;
+      std::uint64_t segment_count;
+      std::uint64_t sections;
+      std::uint64_t section_count;
+      std::uint64_t names;
+    };
+
+    auto put_header(image& out, header const& value)
+      -> void {
+      out.put("\x7f" "ELF");
+      out.put(2, 1); // 64-bit
+      out.put(1, 1); // little-endian
+      out.put(1, 1); // version
+      out.put(0, 9); // System V ABI, padding
+      out.put(value.type, 2);
+      out.put(EM_X86_64, 2);
+      out.put(1, 4);
+      out.put(value.entry, 8);
+      out.put(value.segments, 8);
+      out.put(value.sections, 8);
+      out.put(0, 4);
+      out.put(header_size, 2);
+      out.put(segment_size, 2);
+      out.put(value.segment_count, 2);
+      out.put(section_size, 2);
+      out.put(value.section_count, 2);
+      out.put(value.names, 2);
+    }
+
+    struct segment {
+      std::uint32_t type;
+      std::uint32_t flags;
+      std::uint64_t offset;
+      std::uint64_t address;
+      std::uint64_t size;
+    };
+
+    auto put_segment(image& out, segment const& value)
+      -> void {
+      out.put(value.type, 4);
+      out.put(value.flags, 4);
+      out.put(value.offset, 8);
+      out.put(value.address, 8);
+      out.put(value.address, 8);
+      out.put(value.size, 8);
+      out.put(value.size, 8);
+      out.put(value.type == PT_LOAD ? page : 16, 8);
+    }
+
+    struct section {
+      std::uint32_t name;
+      std::uint32_t type;
+      std::uint64_t flags;
+      std::uint64_t offset;
+      std::uint64_t size;
+      std::uint32_t link;
+      std::uint32_t info;
+      std::uint64_t alignment;
+      std::uint64_t entry_size;
+    };
+
+    auto put_section(image& out, section const& value)
+      -> void {
+      out.put(value.name, 4);
+      out.put(value.type, 4);
+      out.put(value.flags, 8);
+      out.put(0, 8);
+      out.put(value.offset, 8);
+      out.put(value.size, 8);
+      out.put(value.link, 4);
+      out.put(value.info, 4);
+      out.put(value.alignment, 8);
+      out.put(value.entry_size, 8);
+    }
+
+    auto add_string(std::string& table, std::string_view value)
+      -> std::uint32_t {
+      auto offset = static_cast<std::uint32_t>(table.size());
+      table.append(value).push_back('\0');
+      return offset;
+    }
+
+    auto emit(std::ostream& os, image const& out)
+      -> std::ostream& {
+      return os.write(reinterpret_cast<char const*>(out.bytes.data()),
+        static_cast<std::streamsize>(out.bytes.size()));
+    }
+  }
+
+  extern auto add_start(x86::program& target)
+    -> x86::label {
+    constexpr auto sys_exit = std::int64_t { 60 };
+    auto start = target.make_label("_start");
+    auto push = [&](x86::opcode op, x86::operand lhs = {}, x86::operand rhs = {}) {
+      target.text.push_back(x86::instruction { op, x86::cond::E, { lhs, rhs } });
+    };
+    push(x86::opcode::Label, start);
+    push(x86::opcode::Call, target.entry);
+    push(x86::opcode::Mov, x86::gpr { x86::reg::Rdi, 4 }, x86::gpr { x86::reg::Rax, 4 });
+    push(x86::opcode::Mov, x86::gpr { x86::reg::Rax, 4 }, sys_exit);
+    push(x86::opcode::Syscall);
+    return start;
+  }
+
+  extern auto write_object(
+    std::ostream& os,
+    x86::program const& source,
+    x86::machine_code const& code
+  ) -> std::ostream& {
+    enum : std::uint32_t { Text = 1, Rodata, Rela, Symtab, Strtab, Shstrtab, Stack, Count };
+
+    auto names = std::string(1, '\0');
+    auto text_name = add_string(names, ".text");
+    auto rodata_name = add_string(names, ".rodata");
+    auto rela_name = add_string(names, ".rela.text");
+    auto symtab_name = add_string(names, ".symtab");
+    auto strtab_name = add_string(names, ".strtab");
+    auto shstrtab_name = add_string(names, ".shstrtab");
+    auto stack_name = add_string(names, ".note.GNU-stack");
+
+    // The null symbol, the two section symbols, then the named labels.
+    constexpr auto rodata_symbol = std::uint64_t { 2 };
+    constexpr auto locals = std::uint32_t { 3 };
+    auto strings = std::string(1, '\0');
+    auto symbols = image {};
+    symbols.put(0, symbol_size);
+    for (auto index: { Text, Rodata }) {
+      symbols.put(0, 4);
+      symbols.put(STT_SECTION, 1);
+      symbols.put(0, 1);
+      symbols.put(index, 2);
+      symbols.put(0, 16);
+    }
+    for (auto id = std::size_t { 0 }; id < source.symbols.size(); ++id) {
+      if (source.symbols[id].empty())
+        continue;
+      symbols.put(add_string(strings, source.symbols[id]), 4);
+      symbols.put(STB_GLOBAL << 4 | STT_FUNC, 1);
+      symbols.put(0, 1);
+      symbols.put(Text, 2);
+      symbols.put(code.offsets[id], 8);
+      symbols.put(0, 8);
+    }
+
+    auto relocations = image {};
+    for (auto const& entry: code.relocations) {
+      relocations.put(entry.offset, 8);
+      relocations.put(rodata_symbol << 32 | R_X86_64_PC32, 8);
+      relocations.put(static_cast<std::uint64_t>(std::int64_t { code.offsets[entry.target.id] } + entry.addend), 8);
+    }
+
+    auto out = image {};
+    out.put(0, header_size);
+    auto text = out.align(16);
+    out.put(code.text);
+    auto rodata = out.size();
+    out.put(code.data);
+    auto rela = out.align(8);
+    out.put(relocations.bytes);
+    auto symtab = out.align(8);
+    out.put(symbols.bytes);
+    auto strtab = out.size();
+    out.put(strings);
+    auto shstrtab = out.size();
+    out.put(names);
+    auto sections = out.align(8);
+
+    put_section(out, section {});
+    put_section(out, section {
+      text_name, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, text, code.text.size(), 0, 0, 16, 0
+    });
+    put_section(out, section {
+      rodata_name, SHT_PROGBITS, SHF_ALLOC, rodata, code.data.size(), 0, 0, 1, 0
+    });
+    put_section(out, section {
+      rela_name, SHT_RELA, SHF_INFO_LINK, rela, relocations.size(), Symtab, Text, 8, rela_size
+    });
+    put_section(out, section {
+      symtab_name, SHT_SYMTAB, 0, symtab, symbols.size(), Strtab, locals, 8, symbol_size
+    });
+    put_section(out, section {
+      strtab_name, SHT_STRTAB, 0, strtab, strings.size(), 0, 0, 1, 0
+    });
+    put_section(out, section {
+      shstrtab_name, SHT_STRTAB, 0, shstrtab, names.size(), 0, 0, 1, 0
+    });
+    put_section(out, section {
+      stack_name, SHT_PROGBITS, 0, sections, 0, 0, 0, 1, 0
+    });
+
+    auto file = image {};
+    put_header(file, header { ET_REL, 0, 0, 0, sections, Count, Shstrtab });
+    std::copy(file.bytes.begin(), file.bytes.end(), out.bytes.begin());
+    return emit(os, out);
+  }
+
+  extern auto write_executable(
+    std::ostream& os,
+    x86::machine_code code,
+    x86::label entry
+  ) -> std::ostream& {
+    // The headers and the code share the first segment; the data gets its
+    // own, on a later page at the same offset within the page as in the file.
+    auto segments = std::uint64_t { code.data.empty() ? 2u : 3u };
+    auto text = (header_size + segments * segment_size + 15) / 16 * 16;
+    auto text_end = text + code.text.size();
+    auto data = text_end;
+    auto data_address = (base_address + text_end + page - 1) / page * page + data % page;
+    link(code, base_address + text, data_address);
+
+    auto out = image {};
+    put_header(out, header {
+      ET_EXEC, base_address + text + code.offsets[entry.id], header_size, segments, 0, 0, 0
+    });
+    put_segment(out, segment { PT_LOAD, PF_R | PF_X, 0, base_address, text_end });
+    if (!code.data.empty())
+      put_segment(out, segment { PT_LOAD, PF_R, data, data_address, code.data.size() });
+    put_segment(out, segment { PT_GNU_STACK, PF_R | PF_W, 0, 0, 0 });
+    out.align(16);
+    out.put(code.text);
+    out.put(code.data);
+    return emit(os, out);
+  }
+}
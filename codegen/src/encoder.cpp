@@ -0,0 +1,489 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <limits>
+#include <stdexcept>
+
+#include "thalia-codegen/encoder.hpp"
+
+namespace thalia::codegen::x86 {
+  namespace {
+    // The low nibble of `jcc` and `setcc` for each condition.
+    constexpr std::uint8_t condition_codes[] = {
+      0x4, 0x5, 0xc, 0xe, 0xf, 0xd, 0x8, 0x9, 0x2, 0x3
+    };
+
+    auto number(reg value)
+      -> std::uint8_t {
+      return static_cast<std::uint8_t>(value);
+    }
+
+    auto fits8(std::int64_t value)
+      -> bool {
+      return value >= std::numeric_limits<std::int8_t>::min()
+        && value <= std::numeric_limits<std::int8_t>::max();
+    }
+
+    auto fits32(std::int64_t value)
+      -> bool {
+      return value >= std::numeric_limits<std::int32_t>::min()
+        && value <= std::numeric_limits<std::int32_t>::max();
+    }
+
+    auto unsupported()
+      -> std::invalid_argument {
+      return std::invalid_argument { "x86: unsupported operands" };
+    }
+
+    class writer {
+      public:
+        std::vector<std::uint8_t> bytes;
+        std::vector<relocation> relocations;
+
+      public:
+        auto byte(std::uint8_t value) -> void
+          { bytes.push_back(value); }
+
+        auto imm(std::int64_t value, std::size_t size) -> void;
+
+        /**
+         * @brief Emits an instruction with a ModRM operand.
+         * @param opcode The opcode bytes.
+         * @param field The register or opcode extension of the ModRM byte.
+         * @param rm The register or memory operand.
+         * @param size The operand size, 8 for a REX.W prefix.
+         * @param trailing The size of the immediate following the operand.
+         */
+        auto modrm(
+          std::initializer_list<std::uint8_t> opcode,
+          std::uint8_t field,
+          operand const& rm,
+          std::size_t size,
+          std::size_t trailing = 0
+        ) -> void;
+
+        auto rel32(std::uint32_t from, std::uint32_t to) -> void
+          { imm(static_cast<std::int64_t>(to) - from, 4); }
+    };
+
+    extern auto writer::imm(std::int64_t value, std::size_t size)
+      -> void {
+      for (auto i = std::size_t { 0 }; i < size; ++i)
+        byte(static_cast<std::uint8_t>(static_cast<std::uint64_t>(value) >> (8 * i)));
+    }
+
+    extern auto writer::modrm(
+      std::initializer_list<std::uint8_t> opcode,
+      std::uint8_t field,
+      operand const& rm,
+      std::size_t size,
+      std::size_t trailing
+    ) -> void {
+      auto rex = std::uint8_t { 0 };
+      if (size == 8)
+        rex |= 0x08;
+      if (field >= 8)
+        rex |= 0x04;
+      if (auto const* vector = std::get_if<xmm>(&rm)) {
+        if (vector->id >= 8)
+          rex |= 0x01;
+      } else if (auto const* value = std::get_if<gpr>(&rm)) {
+        if (number(value->id) >= 8)
+          rex |= 0x01;
+        // `spl`, `bpl`, `sil` and `dil` need a REX prefix to be told apart
+        // from `ah`, `ch`, `dh` and `bh`.
+        if (value->size == 1 && number(value->id) >= 4)
+          rex |= 0x40;
+      } else if (auto const* memory = std::get_if<mem>(&rm)) {
+        if (number(memory->base) >= 8)
+          rex |= 0x01;
+        if (number(memory->index) >= 8)
+          rex |= 0x02;
+      }
+      // The same holds for a byte register in the field; with an opcode
+      // extension there, the prefix changes nothing.
+      if (size == 1 && field >= 4)
+        rex |= 0x40;
+      if (size == 2)
+        byte(0x66);
+      if (rex != 0)
+        byte(0x40 | rex);
+      for (auto code: opcode)
+        byte(code);
+
+      auto reg_bits = static_cast<std::uint8_t>((field & 7) << 3);
+      if (auto const* vector = std::get_if<xmm>(&rm)) {
+        byte(0xc0 | reg_bits | (vector->id & 7));
+      } else if (auto const* value = std::get_if<gpr>(&rm)) {
+        byte(0xc0 | reg_bits | (number(value->id) & 7));
+      } else if (auto const* memory = std::get_if<mem>(&rm)) {
+        auto base = static_cast<std::uint8_t>(number(memory->base) & 7);
+        auto indexed = memory->index != reg::Rsp;
+        // `rbp` and `r13` as a base always take a displacement.
+        auto mode = memory->disp == 0 && base != 5 ? 0x00
+          : fits8(memory->disp) ? 0x40 : 0x80;
+        byte(static_cast<std::uint8_t>(mode | reg_bits | (indexed ? 4 : base)));
+        // An index, or `rsp` and `r12` as a base, need a SIB byte.
+        if (indexed) {
+          auto scale = memory->scale == 8 ? 3 : memory->scale == 4 ? 2 : memory->scale == 2 ? 1 : 0;
+          byte(static_cast<std::uint8_t>((scale << 6) | ((number(memory->index) & 7) << 3) | base));
+        } else if (base == 4) {
+          byte(0x24);
+        }
+        if (mode == 0x40)
+          imm(memory->disp, 1);
+        else if (mode == 0x80)
+          imm(memory->disp, 4);
+      } else if (auto const* relative = std::get_if<rip_rel>(&rm)) {
+        byte(0x05 | reg_bits);
+        relocations.push_back(relocation {
+          static_cast<std::uint32_t>(bytes.size()),
+          relative->target,
+          -static_cast<std::int32_t>(4 + trailing)
+        });
+        imm(0, 4);
+      } else {
+        throw unsupported();
+      }
+    }
+
+    auto size_of(operand const& value)
+      -> std::size_t {
+      if (auto const* reg = std::get_if<gpr>(&value))
+        return reg->size;
+      if (auto const* memory = std::get_if<mem>(&value))
+        return memory->size;
+      return 8;
+    }
+
+    auto field_of(operand const& value)
+      -> std::uint8_t {
+      if (auto const* reg = std::get_if<gpr>(&value))
+        return number(reg->id);
+      if (auto const* vector = std::get_if<xmm>(&value))
+        return vector->id;
+      throw unsupported();
+    }
+
+    // An SSE instruction: its mandatory prefix, then `0f` and the opcode.
+    auto sse(
+      writer& out,
+      std::uint8_t prefix,
+      std::uint8_t code,
+      std::uint8_t field,
+      operand const& rm,
+      std::size_t trailing = 0
+    ) -> void {
+      out.byte(prefix);
+      out.modrm({ 0x0f, code }, field, rm, 4, trailing);
+    }
+
+    // The SSE shifts by an immediate, by their opcode and extension.
+    auto sse_shift(writer& out, std::uint8_t code, std::uint8_t extension, operand const& dst, operand const& src)
+      -> void {
+      sse(out, 0x66, code, extension, dst, 1);
+      out.imm(std::get<std::int64_t>(src), 1);
+    }
+
+    // `add`, `or`, `and`, `sub`, `xor` and `cmp`, by their opcode extension.
+    auto arith(writer& out, std::uint8_t extension, operand const& dst, operand const& src)
+      -> void {
+      auto size = size_of(dst);
+      auto base = static_cast<std::uint8_t>(extension * 8);
+      auto wide = static_cast<std::uint8_t>(size == 1 ? 0 : 1);
+      if (auto const* value = std::get_if<std::int64_t>(&src)) {
+        if (size == 1) {
+          out.modrm({ 0x80 }, extension, dst, size, 1);
+          out.imm(*value, 1);
+        } else if (fits8(*value)) {
+          out.modrm({ 0x83 }, extension, dst, size, 1);
+          out.imm(*value, 1);
+        } else if (std::holds_alternative<gpr>(dst) && std::get<gpr>(dst).id == reg::Rax) {
+          if (size == 8)
+            out.byte(0x48);
+          out.byte(base + 5);
+          out.imm(*value, 4);
+        } else {
+          out.modrm({ 0x81 }, extension, dst, size, 4);
+          out.imm(*value, 4);
+        }
+        return;
+      }
+      if (std::holds_alternative<gpr>(src)) {
+        out.modrm({ static_cast<std::uint8_t>(base + wide) }, field_of(src), dst, size);
+        return;
+      }
+      out.modrm({ static_cast<std::uint8_t>(base + 2 + wide) }, field_of(dst), src, size);
+    }
+
+    auto mov(writer& out, operand const& dst, operand const& src)
+      -> void {
+      auto size = size_of(dst);
+      auto wide = static_cast<std::uint8_t>(size == 1 ? 0 : 1);
+      if (auto const* value = std::get_if<std::int64_t>(&src)) {
+        auto const* target = std::get_if<gpr>(&dst);
+        if (target && size != 8) {
+          auto id = number(target->id);
+          if (id >= 8 || (size == 1 && id >= 4))
+            out.byte(id >= 8 ? 0x41 : 0x40);
+          out.byte(static_cast<std::uint8_t>((size == 1 ? 0xb0 : 0xb8) + (id & 7)));
+          out.imm(*value, size);
+        } else if (size == 1) {
+          out.modrm({ 0xc6 }, 0, dst, size, 1);
+          out.imm(*value, 1);
+        } else if (fits32(*value)) {
+          out.modrm({ 0xc7 }, 0, dst, size, 4);
+          out.imm(*value, 4);
+        } else {
+          if (!target)
+            throw unsupported();
+          out.byte(number(target->id) >= 8 ? 0x49 : 0x48);
+          out.byte(static_cast<std::uint8_t>(0xb8 + (number(target->id) & 7)));
+          out.imm(*value, 8);
+        }
+        return;
+      }
+      if (std::holds_alternative<gpr>(src)) {
+        out.modrm({ static_cast<std::uint8_t>(0x88 + wide) }, field_of(src), dst, size);
+        return;
+      }
+      out.modrm({ static_cast<std::uint8_t>(0x8a + wide) }, field_of(dst), src, size);
+    }
+
+    // `shl` and `sar`, by their opcode extension.
+    auto shift(writer& out, std::uint8_t extension, operand const& dst, operand const& src)
+      -> void {
+      auto size = size_of(dst);
+      if (auto const* value = std::get_if<std::int64_t>(&src)) {
+        if (*value == 1) {
+          out.modrm({ 0xd1 }, extension, dst, size);
+        } else {
+          out.modrm({ 0xc1 }, extension, dst, size, 1);
+          out.imm(*value, 1);
+        }
+        return;
+      }
+      out.modrm({ 0xd3 }, extension, dst, size);
+    }
+
+    auto is_branch(instruction const& current)
+      -> bool {
+      return current.op == opcode::Jmp || current.op == opcode::Jcc;
+    }
+
+    auto near_size(instruction const& current)
+      -> std::uint32_t {
+      return current.op == opcode::Jmp ? 5 : 6;
+    }
+
+    // Encodes one instruction at the end of `out`; `far` selects the rel32
+    // form of a branch.
+    auto encode_one(
+      writer& out,
+      instruction const& current,
+      std::vector<std::uint32_t> const& offsets,
+      bool far
+    ) -> void {
+      auto const& [dst, src, extra] = current.args;
+      auto here = static_cast<std::uint32_t>(out.bytes.size());
+      switch (current.op) {
+        case opcode::Label:
+          return;
+        case opcode::Mov:
+          return mov(out, dst, src);
+        case opcode::Movsx:
+          return out.modrm({ 0x0f, static_cast<std::uint8_t>(size_of(src) == 1 ? 0xbe : 0xbf) },
+            field_of(dst), src, size_of(dst));
+        case opcode::Movsxd:
+          return out.modrm({ 0x63 }, field_of(dst), src, size_of(dst));
+        case opcode::Movzx:
+          return out.modrm({ 0x0f, static_cast<std::uint8_t>(size_of(src) == 1 ? 0xb6 : 0xb7) },
+            field_of(dst), src, size_of(dst));
+        case opcode::Lea:
+          return out.modrm({ 0x8d }, field_of(dst), src, size_of(dst));
+        case opcode::Add: return arith(out, 0, dst, src);
+        case opcode::Or: return arith(out, 1, dst, src);
+        case opcode::And: return arith(out, 4, dst, src);
+        case opcode::Sub: return arith(out, 5, dst, src);
+        case opcode::Xor: return arith(out, 6, dst, src);
+        case opcode::Cmp: return arith(out, 7, dst, src);
+        case opcode::Test:
+          return out.modrm({ static_cast<std::uint8_t>(size_of(dst) == 1 ? 0x84 : 0x85) },
+            field_of(src), dst, size_of(dst));
+        case opcode::Imul:
+          return out.modrm({ 0x0f, 0xaf }, field_of(dst), src, size_of(dst));
+        case opcode::Not: return out.modrm({ 0xf7 }, 2, dst, size_of(dst));
+        case opcode::Neg: return out.modrm({ 0xf7 }, 3, dst, size_of(dst));
+        case opcode::Div: return out.modrm({ 0xf7 }, 6, dst, size_of(dst));
+        case opcode::Idiv: return out.modrm({ 0xf7 }, 7, dst, size_of(dst));
+        case opcode::Dec: return out.modrm({ 0xff }, 1, dst, size_of(dst));
+        case opcode::Shl: return shift(out, 4, dst, src);
+        case opcode::Sar: return shift(out, 7, dst, src);
+        case opcode::Set:
+          return out.modrm({ 0x0f, static_cast<std::uint8_t>(
+            0x90 | condition_codes[static_cast<std::size_t>(current.cc)]) }, 0, dst, 1);
+        case opcode::Cqo:
+          out.byte(0x48);
+          out.byte(0x99);
+          return;
+        case opcode::Jmp:
+        case opcode::Jcc: {
+          auto target = offsets[std::get<label>(dst).id];
+          auto code = condition_codes[static_cast<std::size_t>(current.cc)];
+          if (!far) {
+            out.byte(current.op == opcode::Jmp ? 0xeb : static_cast<std::uint8_t>(0x70 | code));
+            out.imm(static_cast<std::int64_t>(target) - (here + 2), 1);
+            return;
+          }
+          if (current.op == opcode::Jmp) {
+            out.byte(0xe9);
+          } else {
+            out.byte(0x0f);
+            out.byte(static_cast<std::uint8_t>(0x80 | code));
+          }
+          out.rel32(here + near_size(current), target);
+          return;
+        }
+        case opcode::Call:
+          out.byte(0xe8);
+          out.rel32(here + 5, offsets[std::get<label>(dst).id]);
+          return;
+        case opcode::Ret:
+          // `ret imm16` drops the arguments of a callee-pops call.
+          if (std::holds_alternative<std::int64_t>(dst)) {
+            out.byte(0xc2);
+            out.imm(std::get<std::int64_t>(dst), 2);
+            return;
+          }
+          out.byte(0xc3);
+          return;
+        case opcode::Push:
+        case opcode::Pop: {
+          auto id = field_of(dst);
+          if (id >= 8)
+            out.byte(0x41);
+          out.byte(static_cast<std::uint8_t>((current.op == opcode::Push ? 0x50 : 0x58) + (id & 7)));
+          return;
+        }
+        case opcode::Leave:
+          out.byte(0xc9);
+          return;
+        case opcode::Syscall:
+          out.byte(0x0f);
+          out.byte(0x05);
+          return;
+        case opcode::RepStos:
+          out.byte(0xf3);
+          out.byte(0x48);
+          out.byte(0xab);
+          return;
+        case opcode::Movd:
+          if (std::holds_alternative<xmm>(dst))
+            return sse(out, 0x66, 0x6e, field_of(dst), src);
+          return sse(out, 0x66, 0x7e, field_of(src), dst);
+        case opcode::Movdqu:
+          if (std::holds_alternative<xmm>(dst))
+            return sse(out, 0xf3, 0x6f, field_of(dst), src);
+          return sse(out, 0xf3, 0x7f, field_of(src), dst);
+        case opcode::Movdqa: return sse(out, 0x66, 0x6f, field_of(dst), src);
+        case opcode::Pshufd:
+          sse(out, 0x66, 0x70, field_of(dst), src, 1);
+          out.imm(std::get<std::int64_t>(extra), 1);
+          return;
+        case opcode::Punpckldq: return sse(out, 0x66, 0x62, field_of(dst), src);
+        case opcode::Paddd: return sse(out, 0x66, 0xfe, field_of(dst), src);
+        case opcode::Psubd: return sse(out, 0x66, 0xfa, field_of(dst), src);
+        case opcode::Pmuludq: return sse(out, 0x66, 0xf4, field_of(dst), src);
+        case opcode::Pand: return sse(out, 0x66, 0xdb, field_of(dst), src);
+        case opcode::Por: return sse(out, 0x66, 0xeb, field_of(dst), src);
+        case opcode::Pxor: return sse(out, 0x66, 0xef, field_of(dst), src);
+        case opcode::Pcmpeqd: return sse(out, 0x66, 0x76, field_of(dst), src);
+        case opcode::Pslld: return sse_shift(out, 0x72, 6, dst, src);
+        case opcode::Psrad: return sse_shift(out, 0x72, 4, dst, src);
+        case opcode::Psrlq: return sse_shift(out, 0x73, 2, dst, src);
+      }
+    }
+  }
+
+  extern auto encode(program const& source)
+    -> machine_code {
+    auto result = machine_code {};
+    result.offsets.assign(source.symbols.size(), 0);
+    for (auto const& entry: source.data) {
+      result.offsets[entry.name.id] = static_cast<std::uint32_t>(result.data.size());
+      result.data.insert(result.data.end(), entry.bytes.begin(), entry.bytes.end());
+    }
+
+    // Only branches change size with the layout; everything else is sized
+    // once.
+    auto const& text = source.text;
+    auto sizes = std::vector<std::uint32_t>(text.size());
+    auto far = std::vector<bool>(text.size(), false);
+    auto scratch = writer {};
+    for (auto i = std::size_t { 0 }; i < text.size(); ++i) {
+      if (is_branch(text[i])) {
+        sizes[i] = 2;
+        continue;
+      }
+      scratch.bytes.clear();
+      encode_one(scratch, text[i], result.offsets, false);
+      sizes[i] = static_cast<std::uint32_t>(scratch.bytes.size());
+    }
+
+    // Widening a branch only moves code apart, so this reaches a fixed point.
+    for (auto changed = true; changed;) {
+      auto position = std::uint32_t { 0 };
+      for (auto i = std::size_t { 0 }; i < text.size(); ++i) {
+        if (text[i].op == opcode::Label)
+          result.offsets[std::get<label>(text[i].args[0]).id] = position;
+        position += sizes[i];
+      }
+
+      changed = false;
+      position = 0;
+      for (auto i = std::size_t { 0 }; i < text.size(); ++i) {
+        position += sizes[i];
+        if (!is_branch(text[i]) || far[i])
+          continue;
+        auto target = result.offsets[std::get<label>(text[i].args[0]).id];
+        if (!fits8(static_cast<std::int64_t>(target) - position)) {
+          far[i] = true;
+          sizes[i] = near_size(text[i]);
+          changed = true;
+        }
+      }
+    }
+
+    auto out = writer {};
+    for (auto i = std::size_t { 0 }; i < text.size(); ++i)
+      encode_one(out, text[i], result.offsets, far[i]);
+    result.text = std::move(out.bytes);
+    result.relocations = std::move(out.relocations);
+    return result;
+  }
+
+  extern auto link(machine_code& code, std::uint64_t text, std::uint64_t data)
+    -> void {
+    for (auto const& entry: code.relocations) {
+      auto value = data + code.offsets[entry.target.id] + entry.addend - (text + entry.offset);
+      for (auto i = std::size_t { 0 }; i < 4; ++i)
+        code.text[entry.offset + i] = static_cast<std::uint8_t>(value >> (8 * i));
+    }
+  }
+}
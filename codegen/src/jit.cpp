@@ -0,0 +1,94 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "thalia-codegen/encoder.hpp"
+#include "thalia-codegen/jit.hpp"
+
+namespace thalia::codegen {
+  namespace {
+    auto fail(char const* what) -> void
+      { throw std::system_error(errno, std::generic_category(), what); }
+  }
+
+#if defined(__x86_64__) && defined(__linux__)
+  jit_machine::jit_machine(x86::program const& program, std::size_t slots)
+    : _slots(slots) {
+    auto code = x86::encode(program);
+    auto data = (code.text.size() + 15) / 16 * 16;
+    auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    _used = data + code.data.size();
+    _size = (_used + page - 1) / page * page;
+
+    auto memory = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+      fail("mmap");
+    _memory = memory;
+
+    auto base = static_cast<std::uint8_t*>(_memory);
+    auto address = reinterpret_cast<std::uint64_t>(base);
+    x86::link(code, address, address + data);
+    std::memcpy(base, code.text.data(), code.text.size());
+    if (!code.data.empty())
+      std::memcpy(base + data, code.data.data(), code.data.size());
+    if (::mprotect(_memory, _size, PROT_READ | PROT_EXEC) != 0) {
+      ::munmap(_memory, _size);
+      fail("mprotect");
+    }
+    _entry = reinterpret_cast<entry_type>(base + code.offsets[program.entry.id]);
+  }
+
+  jit_machine::~jit_machine()
+    { ::munmap(_memory, _size); }
+#else
+  // Without a way to map executable memory, loading always fails; callers
+  // check `jit_supported` first.
+  jit_machine::jit_machine(x86::program const&, std::size_t slots)
+    : _slots(slots)
+    { throw std::system_error(std::make_error_code(std::errc::function_not_supported), "jit"); }
+
+  jit_machine::~jit_machine() = default;
+#endif
+
+  extern auto jit_machine::run()
+    -> vm::outcome {
+    std::fill(_slots.begin(), _slots.end(), 0);
+    return run(_slots);
+  }
+
+  extern auto jit_machine::run(std::span<std::int64_t> frame)
+    -> vm::outcome {
+    auto result = _entry(frame.data());
+    auto state = static_cast<vm::status>(result.state);
+    if (state == vm::status::DivByZero || state == vm::status::IndexOutOfRange
+        || state == vm::status::StackOverflow)
+      return vm::outcome { state, 0, static_cast<std::size_t>(result.value) };
+    return vm::outcome { state, result.value, 0 };
+  }
+}
@@ -0,0 +1,1313 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <thalia-ir/vectorize.hpp>
+#include <thalia-vm/machine.hpp>
+
+#include "thalia-codegen/allocator.hpp"
+#include "thalia-codegen/lowering.hpp"
+#include "runtime.hpp"
+
+namespace thalia::codegen {
+  namespace {
+    using ir::block_id;
+    using ir::value_id;
+    using x86::cond;
+    using x86::opcode;
+    using x86::reg;
+
+    constexpr auto rax = x86::gpr { reg::Rax };
+    constexpr auto eax = x86::gpr { reg::Rax, 4 };
+    constexpr auto al = x86::gpr { reg::Rax, 1 };
+    constexpr auto rcx = x86::gpr { reg::Rcx };
+    constexpr auto ecx = x86::gpr { reg::Rcx, 4 };
+    constexpr auto cl = x86::gpr { reg::Rcx, 1 };
+    constexpr auto rdx = x86::gpr { reg::Rdx };
+    constexpr auto edx = x86::gpr { reg::Rdx, 4 };
+    constexpr auto rbx = x86::gpr { reg::Rbx };
+    constexpr auto rdi = x86::gpr { reg::Rdi };
+    constexpr auto rbp = x86::gpr { reg::Rbp };
+    constexpr auto rsp = x86::gpr { reg::Rsp };
+    constexpr auto r12 = x86::gpr { reg::R12 };
+    constexpr auto r13 = x86::gpr { reg::R13 };
+    constexpr auto r14 = x86::gpr { reg::R14 };
+    constexpr auto r15 = x86::gpr { reg::R15 };
+    // Scratch registers of vector loops, which keep their values in the
+    // others.
+    constexpr auto scratch = x86::xmm { 14 };
+    constexpr auto spare = x86::xmm { 15 };
+
+    // The registers values are kept in, those the caller saves first. `rax`,
+    // `rcx`, `rdx` and `rdi` are left for the code to work in, and `rbx`,
+    // last, holds the outputs of functions called in process.
+    constexpr reg registers[] = {
+      reg::Rsi, reg::R8, reg::R9, reg::R10, reg::R11,
+      reg::R12, reg::R13, reg::R14, reg::R15, reg::Rbx
+    };
+
+    // An edge whose phi copies are emitted out of line.
+    struct stub {
+      x86::label at;
+      block_id from;
+      block_id to;
+    };
+
+    struct context {
+      ir::function const& target;
+      x86::program& out;
+      std::vector<x86::label> labels;
+      // The frame offset of every value that lives in a slot.
+      std::vector<std::int32_t> offsets;
+      // The frame offset of the first element of every array.
+      std::vector<std::int32_t> arrays;
+      // Compares emitted by the branch after them instead of on their own.
+      std::vector<bool> fused;
+      // Where every value lives, position by position.
+      allocation regs;
+      // The position of the instruction being emitted.
+      std::uint32_t at;
+      // The values brought back from their slots before the instruction at
+      // a position.
+      std::map<std::uint32_t, std::vector<std::pair<value_id, reg>>> reloads;
+      // The registers to give back to the caller, and where they are kept.
+      std::vector<std::pair<reg, x86::mem>> saved;
+      // Where the outputs are stored when the function returns.
+      std::vector<x86::mem> outputs;
+      // The block laid out after the current one.
+      block_id next;
+      std::map<std::size_t, x86::label> traps;
+      std::map<std::size_t, x86::label> bounds;
+      std::vector<stub> stubs;
+      // The loops that run several iterations at once, by header.
+      std::map<block_id, ir::vector_loop> vectorized;
+      x86::label finish;
+      // The entries of the functions of the module and the sizes of their
+      // frames.
+      std::span<x86::label const> functions = {};
+      std::span<std::int32_t const> frames = {};
+      std::map<std::size_t, x86::label> overflows = {};
+      // The lowest address the stack may reach, relative to `r15`.
+      x86::mem limit = {};
+      // Whether this is a function of the module, whose returned calls
+      // become jumps.
+      bool callee = false;
+    };
+
+    auto emit(context& ctx, opcode op, x86::operand lhs = {}, x86::operand rhs = {}, x86::operand extra = {})
+      -> void {
+      ctx.out.text.push_back(x86::instruction { op, cond::E, { lhs, rhs, extra } });
+    }
+
+    auto emit_cc(context& ctx, opcode op, cond cc, x86::operand target)
+      -> void {
+      ctx.out.text.push_back(x86::instruction { op, cc, { target, {} } });
+    }
+
+    auto bind(context& ctx, x86::label target)
+      -> void {
+      emit(ctx, opcode::Label, target);
+    }
+
+    auto fits_imm32(std::int64_t value)
+      -> bool {
+      return value >= std::numeric_limits<std::int32_t>::min()
+        && value <= std::numeric_limits<std::int32_t>::max();
+    }
+
+    auto slot_of(context& ctx, value_id value)
+      -> x86::mem {
+      return x86::mem { reg::Rbp, ctx.offsets[value] };
+    }
+
+    auto location_at(context& ctx, value_id value, std::uint32_t position)
+      -> x86::operand {
+      if (auto where = ctx.regs.where(value, position))
+        return x86::gpr { *where };
+      return slot_of(ctx, value);
+    }
+
+    // Where the instruction being emitted reads a value from.
+    auto location_of(context& ctx, value_id value)
+      -> x86::operand {
+      return location_at(ctx, value, ctx.at);
+    }
+
+    // Whether two locations are the same register or slot.
+    auto same(x86::operand const& lhs, x86::operand const& rhs)
+      -> bool {
+      if (auto const* left = std::get_if<x86::gpr>(&lhs)) {
+        auto const* right = std::get_if<x86::gpr>(&rhs);
+        return right && right->id == left->id;
+      }
+      auto const* left = std::get_if<x86::mem>(&lhs);
+      auto const* right = std::get_if<x86::mem>(&rhs);
+      return left && right && left->base == right->base && left->disp == right->disp
+        && left->index == right->index;
+    }
+
+    auto constant_of(context& ctx, value_id value)
+      -> std::optional<std::int64_t> {
+      auto const& current = ctx.target.at(value);
+      if (current.op != ir::opcode::Const)
+        return std::nullopt;
+      return current.imm;
+    }
+
+    // Loads a value into a register.
+    auto load(context& ctx, x86::gpr target, value_id value)
+      -> void {
+      if (auto constant = constant_of(ctx, value)) {
+        if (*constant == 0)
+          emit(ctx, opcode::Xor, x86::gpr { target.id, 4 }, x86::gpr { target.id, 4 });
+        else emit(ctx, opcode::Mov, target, *constant);
+        return;
+      }
+      auto source = location_of(ctx, value);
+      if (!same(source, target))
+        emit(ctx, opcode::Mov, target, source);
+    }
+
+    // Where the right operand of an operation can be read from in place;
+    // constants that do not fit an immediate go through `rcx`.
+    auto source_of(context& ctx, value_id value)
+      -> x86::operand {
+      if (auto constant = constant_of(ctx, value)) {
+        if (fits_imm32(*constant))
+          return *constant;
+        emit(ctx, opcode::Mov, rcx, *constant);
+        return rcx;
+      }
+      return location_of(ctx, value);
+    }
+
+    // Stores a value to memory.
+    auto copy(context& ctx, x86::mem target, value_id value)
+      -> void {
+      auto constant = constant_of(ctx, value);
+      if (constant && fits_imm32(*constant)) {
+        emit(ctx, opcode::Mov, target, *constant);
+        return;
+      }
+      auto source = constant ? x86::operand {} : location_of(ctx, value);
+      if (auto const* where = std::get_if<x86::gpr>(&source)) {
+        emit(ctx, opcode::Mov, target, *where);
+        return;
+      }
+      load(ctx, rax, value);
+      emit(ctx, opcode::Mov, target, rax);
+    }
+
+    // Gives a value computed in a register at a position its place there,
+    // and stores it to its slot when it spends any time in it.
+    auto define(context& ctx, value_id value, std::uint32_t position, x86::gpr source)
+      -> void {
+      auto target = location_at(ctx, value, position);
+      if (!same(target, source))
+        emit(ctx, opcode::Mov, target, source);
+      if (ctx.regs.spilled[value] && std::holds_alternative<x86::gpr>(target))
+        emit(ctx, opcode::Mov, slot_of(ctx, value), source);
+    }
+
+    // The register to compute a value in: its own one, unless it has none
+    // or `later` is read from it after it is written, and `rax` otherwise.
+    auto work_of(context& ctx, value_id value, value_id later)
+      -> x86::gpr {
+      auto target = location_at(ctx, value, ctx.at + 1);
+      auto const* where = std::get_if<x86::gpr>(&target);
+      if (!where)
+        return rax;
+      if (later != ir::none && !constant_of(ctx, later) && same(location_of(ctx, later), target))
+        return rax;
+      return *where;
+    }
+
+    // Sign-extends the low `width` bits of a register.
+    auto wrap(context& ctx, x86::gpr target, std::size_t width)
+      -> void {
+      switch (width) {
+        case 8: emit(ctx, opcode::Movsx, target, x86::gpr { target.id, 1 }); break;
+        case 16: emit(ctx, opcode::Movsx, target, x86::gpr { target.id, 2 }); break;
+        case 32: emit(ctx, opcode::Movsxd, target, x86::gpr { target.id, 4 }); break;
+        default: break;
+      }
+    }
+
+    auto trap_at(context& ctx, std::map<std::size_t, x86::label>& traps, std::size_t line)
+      -> x86::label {
+      auto [found, inserted] = traps.try_emplace(line, x86::label { 0 });
+      if (inserted)
+        found->second = ctx.out.make_label();
+      return found->second;
+    }
+
+    auto compare_of(ir::opcode op)
+      -> cond {
+      switch (op) {
+        case ir::opcode::Eq: return cond::E;
+        case ir::opcode::Ne: return cond::Ne;
+        case ir::opcode::Lt: return cond::L;
+        case ir::opcode::Le: return cond::Le;
+        case ir::opcode::Gt: return cond::G;
+        default: return cond::Ge;
+      }
+    }
+
+    // A copy on an edge, from a register, a slot or an immediate.
+    struct move {
+      x86::operand target;
+      x86::operand source;
+    };
+
+    auto gen_move(context& ctx, move const& current)
+      -> void {
+      if (auto const* constant = std::get_if<std::int64_t>(&current.source)) {
+        if (auto const* target = std::get_if<x86::gpr>(&current.target)) {
+          if (*constant == 0)
+            emit(ctx, opcode::Xor, x86::gpr { target->id, 4 }, x86::gpr { target->id, 4 });
+          else emit(ctx, opcode::Mov, *target, *constant);
+          return;
+        }
+        if (fits_imm32(*constant)) {
+          emit(ctx, opcode::Mov, current.target, *constant);
+          return;
+        }
+        emit(ctx, opcode::Mov, rcx, *constant);
+        emit(ctx, opcode::Mov, current.target, rcx);
+        return;
+      }
+      if (std::holds_alternative<x86::mem>(current.target) && std::holds_alternative<x86::mem>(current.source)) {
+        emit(ctx, opcode::Mov, rcx, current.source);
+        emit(ctx, opcode::Mov, current.target, rcx);
+        return;
+      }
+      emit(ctx, opcode::Mov, current.target, current.source);
+    }
+
+    // Whether an edge has phis to copy to, or values live across it that
+    // are somewhere else at its end; those in their slot there already are
+    // in it.
+    auto has_moves(context& ctx, block_id from, block_id to)
+      -> bool {
+      if (!ctx.target.block(to).phis.empty())
+        return true;
+      auto const& live = ctx.regs.live_in[to];
+      return std::any_of(live.begin(), live.end(), [&](value_id value) {
+        auto target = location_at(ctx, value, ctx.regs.starts[to]);
+        return std::holds_alternative<x86::gpr>(target)
+          && !same(target, location_at(ctx, value, ctx.regs.ends[from]));
+      });
+    }
+
+    // Makes phis take the values they merge from `from` when control goes
+    // to `to`, and the values live into `to` move to where they are there.
+    // The moves happen at once: a location read by one is read before
+    // another one writes it, and `rax` keeps a value to break cycles.
+    auto gen_copies(context& ctx, block_id from, block_id to)
+      -> void {
+      auto const& target = ctx.target;
+      auto leave = ctx.regs.ends[from];
+      auto enter = ctx.regs.starts[to];
+      auto source = [&](value_id value) {
+        auto constant = constant_of(ctx, value);
+        return constant ? x86::operand { *constant } : location_at(ctx, value, leave);
+      };
+
+      auto moves = std::vector<move> {};
+      auto const& preds = target.block(to).preds;
+      auto index = static_cast<std::size_t>(std::find(preds.begin(), preds.end(), from) - preds.begin());
+      for (auto phi: target.block(to).phis) {
+        auto value = target.operands(phi)[index];
+        auto place = location_at(ctx, phi, enter);
+        moves.push_back(move { place, source(value) });
+        if (ctx.regs.spilled[phi] && std::holds_alternative<x86::gpr>(place))
+          moves.push_back(move { slot_of(ctx, phi), source(value) });
+      }
+      for (auto value: ctx.regs.live_in[to]) {
+        auto place = location_at(ctx, value, enter);
+        if (std::holds_alternative<x86::gpr>(place))
+          moves.push_back(move { place, source(value) });
+      }
+      std::erase_if(moves, [](move const& current) { return same(current.target, current.source); });
+
+      while (!moves.empty()) {
+        auto ready = std::find_if(moves.begin(), moves.end(), [&](move const& current) {
+          return std::none_of(moves.begin(), moves.end(), [&](move const& other) {
+            return &other != &current && same(other.source, current.target);
+          });
+        });
+        if (ready != moves.end()) {
+          gen_move(ctx, *ready);
+          moves.erase(ready);
+          continue;
+        }
+        auto kept = moves.front().target;
+        emit(ctx, opcode::Mov, rax, kept);
+        for (auto& current: moves) {
+          if (same(current.source, kept))
+            current.source = rax;
+        }
+      }
+    }
+
+    // The label to branch to for an edge: the block itself, or code doing
+    // the moves of the edge first.
+    auto edge_label(context& ctx, block_id from, block_id to)
+      -> x86::label {
+      if (!has_moves(ctx, from, to))
+        return ctx.labels[to];
+      auto at = ctx.out.make_label();
+      ctx.stubs.push_back(stub { at, from, to });
+      return at;
+    }
+
+    auto gen_vector_loop(context& ctx, ir::vector_loop const& plan)
+      -> void;
+
+    auto gen_edge(context& ctx, block_id from, block_id to)
+      -> void {
+      gen_copies(ctx, from, to);
+      // A vector loop runs first on the way into the loop, which then
+      // goes on from where it stopped.
+      auto vector = ctx.vectorized.find(to);
+      if (vector != ctx.vectorized.end() && vector->second.preheader == from)
+        gen_vector_loop(ctx, vector->second);
+      if (to != ctx.next)
+        emit(ctx, opcode::Jmp, ctx.labels[to]);
+    }
+
+    auto gen_division(context& ctx, value_id value, std::size_t width)
+      -> void {
+      auto const& current = ctx.target.at(value);
+      auto args = ctx.target.operands(value);
+      auto is_div = current.op == ir::opcode::Div;
+      auto divisor = constant_of(ctx, args[1]);
+      auto safe = divisor && *divisor != 0 && *divisor != -1;
+
+      load(ctx, rax, args[0]);
+      load(ctx, rcx, args[1]);
+      if (!safe) {
+        emit(ctx, opcode::Test, rcx, rcx);
+        emit_cc(ctx, opcode::Jcc, cond::E, trap_at(ctx, ctx.traps, static_cast<std::size_t>(current.imm)));
+      }
+      // The only quotient that overflows 64-bit `idiv` is MIN / -1.
+      auto negation = !safe && width == 64;
+      auto divide = ctx.out.make_label();
+      auto done = ctx.out.make_label();
+      if (negation) {
+        emit(ctx, opcode::Cmp, rcx, std::int64_t { -1 });
+        emit_cc(ctx, opcode::Jcc, cond::Ne, divide);
+        if (is_div)
+          emit(ctx, opcode::Neg, rax);
+        else emit(ctx, opcode::Xor, eax, eax);
+        emit(ctx, opcode::Jmp, done);
+        bind(ctx, divide);
+      }
+      emit(ctx, opcode::Cqo);
+      emit(ctx, opcode::Idiv, rcx);
+      if (!is_div)
+        emit(ctx, opcode::Mov, rax, rdx);
+      if (negation)
+        bind(ctx, done);
+      if (is_div)
+        wrap(ctx, rax, width);
+    }
+
+    auto array_of(context& ctx, value_id array)
+      -> std::size_t {
+      return static_cast<std::size_t>(ctx.target.at(array).imm);
+    }
+
+    auto bytes_of(ir::type kind)
+      -> std::uint8_t {
+      return static_cast<std::uint8_t>(ir::width_of(kind) / 8);
+    }
+
+    // The element an access reads or writes, with its index checked unless
+    // it is a constant in range.
+    auto element_of(context& ctx, value_id value)
+      -> x86::mem {
+      auto args = ctx.target.operands(value);
+      auto index = array_of(ctx, args[0]);
+      auto const& array = ctx.target.arrays()[index];
+      auto size = bytes_of(array.kind);
+      auto element = x86::mem { reg::Rbp, ctx.arrays[index], size };
+      if (!ir::may_trap(ctx.target, value)) {
+        element.disp += static_cast<std::int32_t>(*constant_of(ctx, args[1])) * size;
+        return element;
+      }
+      auto line = static_cast<std::size_t>(ctx.target.at(value).imm);
+      load(ctx, rcx, args[1]);
+      emit(ctx, opcode::Cmp, rcx, static_cast<std::int64_t>(array.length));
+      emit_cc(ctx, opcode::Jcc, cond::Ae, trap_at(ctx, ctx.bounds, line));
+      element.index = reg::Rcx;
+      element.scale = size;
+      return element;
+    }
+
+    auto gen_load(context& ctx, value_id value)
+      -> void {
+      auto element = element_of(ctx, value);
+      auto work = work_of(ctx, value, ir::none);
+      switch (element.size) {
+        case 8: emit(ctx, opcode::Mov, work, element); break;
+        case 4: emit(ctx, opcode::Movsxd, work, element); break;
+        default: emit(ctx, opcode::Movsx, work, element); break;
+      }
+      define(ctx, value, ctx.at + 1, work);
+    }
+
+    auto gen_store(context& ctx, value_id value)
+      -> void {
+      auto element = element_of(ctx, value);
+      auto stored = ctx.target.operands(value)[2];
+      auto source = constant_of(ctx, stored) ? x86::operand {} : location_of(ctx, stored);
+      auto work = rax;
+      if (auto const* where = std::get_if<x86::gpr>(&source))
+        work = *where;
+      else load(ctx, rax, stored);
+      emit(ctx, opcode::Mov, element, x86::gpr { work.id, element.size });
+    }
+
+    auto gen_clear(context& ctx, value_id value)
+      -> void {
+      auto index = array_of(ctx, ctx.target.operands(value)[0]);
+      auto const& array = ctx.target.arrays()[index];
+      auto quadwords = (array.length * bytes_of(array.kind) + 7) / 8;
+      emit(ctx, opcode::Lea, rdi, x86::mem { reg::Rbp, ctx.arrays[index] });
+      emit(ctx, opcode::Mov, ecx, static_cast<std::int64_t>(quadwords));
+      emit(ctx, opcode::Xor, eax, eax);
+      emit(ctx, opcode::RepStos);
+    }
+
+    auto lanes_of(ir::opcode op)
+      -> opcode {
+      switch (op) {
+        case ir::opcode::Add: return opcode::Paddd;
+        case ir::opcode::Sub: return opcode::Psubd;
+        case ir::opcode::And: return opcode::Pand;
+        case ir::opcode::Or: return opcode::Por;
+        default: return opcode::Pxor;
+      }
+    }
+
+    // SSE2 only multiplies the even lanes, into quadwords, so the odd ones
+    // are shifted down and multiplied apart, and the low halves of all the
+    // products are interleaved back.
+    auto gen_lane_mul(context& ctx, x86::xmm target, x86::xmm rhs)
+      -> void {
+      emit(ctx, opcode::Movdqa, scratch, target);
+      emit(ctx, opcode::Psrlq, scratch, std::int64_t { 32 });
+      emit(ctx, opcode::Movdqa, spare, rhs);
+      emit(ctx, opcode::Psrlq, spare, std::int64_t { 32 });
+      emit(ctx, opcode::Pmuludq, scratch, spare);
+      emit(ctx, opcode::Pmuludq, target, rhs);
+      emit(ctx, opcode::Pshufd, target, target, std::int64_t { 0x08 });
+      emit(ctx, opcode::Pshufd, scratch, scratch, std::int64_t { 0x08 });
+      emit(ctx, opcode::Punpckldq, target, scratch);
+    }
+
+    // Runs the body of a loop on `vector_width` consecutive elements at a
+    // time, with the counter in `rax`, for as long as all of them are in
+    // range: from a counter of at least zero up to the least of the bound
+    // and the lengths. The counter and the reductions are then written
+    // back to their phis for the loop to go on with.
+    auto gen_vector_loop(context& ctx, ir::vector_loop const& plan)
+      -> void {
+      auto const& target = ctx.target;
+      ctx.at = ctx.regs.starts[plan.header];
+      auto registers = std::map<value_id, x86::xmm> {};
+      auto next = std::uint8_t { 0 };
+      auto give = [&](value_id value) { return registers[value] = x86::xmm { next++ }; };
+      auto width = static_cast<std::int64_t>(ir::vector_width);
+      auto skip = ctx.out.make_label();
+      auto loop = ctx.out.make_label();
+
+      auto length = std::numeric_limits<std::int64_t>::max();
+      for (auto array: plan.arrays)
+        length = std::min(length, static_cast<std::int64_t>(target.arrays()[array_of(ctx, array)].length));
+      load(ctx, rax, plan.counter);
+      if (auto bound = constant_of(ctx, plan.bound)) {
+        emit(ctx, opcode::Mov, rdx, std::min(*bound, length) - width);
+      } else {
+        auto shorter = ctx.out.make_label();
+        load(ctx, rdx, plan.bound);
+        emit(ctx, opcode::Cmp, rdx, length);
+        emit_cc(ctx, opcode::Jcc, cond::Le, shorter);
+        emit(ctx, opcode::Mov, edx, length);
+        bind(ctx, shorter);
+        emit(ctx, opcode::Sub, rdx, width);
+      }
+      emit(ctx, opcode::Test, rax, rax);
+      emit_cc(ctx, opcode::Jcc, cond::S, skip);
+      emit(ctx, opcode::Cmp, rax, rdx);
+      emit_cc(ctx, opcode::Jcc, cond::G, skip);
+
+      for (auto value: plan.invariants) {
+        auto lanes = give(value);
+        load(ctx, rcx, value);
+        emit(ctx, opcode::Movd, lanes, ecx);
+        emit(ctx, opcode::Pshufd, lanes, lanes, std::int64_t { 0 });
+      }
+      // A reduction starts with its value in the first lane and zeros in
+      // the others, or in all of them for `and` and `or`.
+      for (auto const& reduction: plan.reductions) {
+        auto lanes = give(reduction.phi);
+        registers[reduction.update] = lanes;
+        load(ctx, rcx, reduction.phi);
+        emit(ctx, opcode::Movd, lanes, ecx);
+        auto op = target.at(reduction.update).op;
+        if (op == ir::opcode::And || op == ir::opcode::Or)
+          emit(ctx, opcode::Pshufd, lanes, lanes, std::int64_t { 0 });
+      }
+
+      bind(ctx, loop);
+      auto const& code = target.block(plan.body).code;
+      for (auto i = std::size_t { 0 }; i + 1 < code.size(); ++i) {
+        auto value = code[i];
+        auto const& current = target.at(value);
+        auto args = target.operands(value);
+        auto steps = current.op == ir::opcode::Add && (args[0] == plan.counter || args[1] == plan.counter);
+        if (steps || current.op == ir::opcode::Const)
+          continue;
+        auto element = [&](value_id array) {
+          auto index = array_of(ctx, array);
+          return x86::mem { reg::Rbp, ctx.arrays[index], 16, reg::Rax, 4 };
+        };
+        switch (current.op) {
+          case ir::opcode::Load:
+            emit(ctx, opcode::Movdqu, give(value), element(args[0]));
+            break;
+          case ir::opcode::Store:
+            emit(ctx, opcode::Movdqu, element(args[0]), registers.at(args[2]));
+            break;
+          case ir::opcode::Shl:
+          case ir::opcode::Shr: {
+            auto lanes = give(value);
+            auto amount = *constant_of(ctx, args[1]) & 31;
+            emit(ctx, opcode::Movdqa, lanes, registers.at(args[0]));
+            emit(ctx, current.op == ir::opcode::Shl ? opcode::Pslld : opcode::Psrad, lanes, amount);
+            break;
+          }
+          case ir::opcode::Neg:
+          case ir::opcode::Not: {
+            auto lanes = give(value);
+            if (current.op == ir::opcode::Neg) {
+              emit(ctx, opcode::Pxor, lanes, lanes);
+              emit(ctx, opcode::Psubd, lanes, registers.at(args[0]));
+            } else {
+              emit(ctx, opcode::Pcmpeqd, lanes, lanes);
+              emit(ctx, opcode::Pxor, lanes, registers.at(args[0]));
+            }
+            break;
+          }
+          default: {
+            if (auto found = registers.find(value); found != registers.end()) {
+              // A reduction folds the other operand into its lanes.
+              auto rhs = target.at(args[0]).op == ir::opcode::Phi && target.at(args[0]).parent == plan.header
+                ? args[1] : args[0];
+              emit(ctx, lanes_of(current.op), found->second, registers.at(rhs));
+              break;
+            }
+            auto lanes = give(value);
+            emit(ctx, opcode::Movdqa, lanes, registers.at(args[0]));
+            if (current.op == ir::opcode::Mul)
+              gen_lane_mul(ctx, lanes, registers.at(args[1]));
+            else emit(ctx, lanes_of(current.op), lanes, registers.at(args[1]));
+            break;
+          }
+        }
+      }
+      emit(ctx, opcode::Add, rax, width);
+      emit(ctx, opcode::Cmp, rax, rdx);
+      emit_cc(ctx, opcode::Jcc, cond::Le, loop);
+
+      define(ctx, plan.counter, ctx.at, rax);
+      for (auto const& reduction: plan.reductions) {
+        auto lanes = registers.at(reduction.phi);
+        auto op = target.at(reduction.update).op;
+        auto fold = lanes_of(op == ir::opcode::Sub ? ir::opcode::Add : op);
+        emit(ctx, opcode::Pshufd, scratch, lanes, std::int64_t { 0x4e });
+        emit(ctx, fold, lanes, scratch);
+        emit(ctx, opcode::Pshufd, scratch, lanes, std::int64_t { 0xb1 });
+        emit(ctx, fold, lanes, scratch);
+        emit(ctx, opcode::Movd, ecx, lanes);
+        emit(ctx, opcode::Movsxd, rcx, ecx);
+        define(ctx, reduction.phi, ctx.at, rcx);
+      }
+      bind(ctx, skip);
+    }
+
+    // Computes an operation in the register of its result when it has one.
+    auto gen_arithmetic(context& ctx, value_id value, std::size_t width)
+      -> void {
+      auto op = ctx.target.at(value).op;
+      auto args = ctx.target.operands(value);
+      auto work = work_of(ctx, value, args.size() > 1 ? args[1] : ir::none);
+      load(ctx, work, args[0]);
+      switch (op) {
+        case ir::opcode::Neg:
+          emit(ctx, opcode::Neg, work);
+          wrap(ctx, work, width);
+          break;
+        case ir::opcode::Not:
+          emit(ctx, opcode::Not, work);
+          break;
+        case ir::opcode::Mul: {
+          auto rhs = source_of(ctx, args[1]);
+          if (std::holds_alternative<std::int64_t>(rhs)) {
+            emit(ctx, opcode::Mov, rcx, rhs);
+            rhs = rcx;
+          }
+          emit(ctx, opcode::Imul, work, rhs);
+          wrap(ctx, work, width);
+          break;
+        }
+        case ir::opcode::Add:
+        case ir::opcode::Sub:
+          emit(ctx, op == ir::opcode::Add ? opcode::Add : opcode::Sub, work, source_of(ctx, args[1]));
+          wrap(ctx, work, width);
+          break;
+        case ir::opcode::And: emit(ctx, opcode::And, work, source_of(ctx, args[1])); break;
+        case ir::opcode::Or: emit(ctx, opcode::Or, work, source_of(ctx, args[1])); break;
+        default: emit(ctx, opcode::Xor, work, source_of(ctx, args[1])); break;
+      }
+      define(ctx, value, ctx.at + 1, work);
+    }
+
+    auto gen_shift(context& ctx, value_id value, std::size_t width)
+      -> void {
+      auto args = ctx.target.operands(value);
+      auto op = ctx.target.at(value).op == ir::opcode::Shl ? opcode::Shl : opcode::Sar;
+      auto mask = static_cast<std::int64_t>(width - 1);
+      auto work = work_of(ctx, value, args[1]);
+      load(ctx, work, args[0]);
+      if (auto amount = constant_of(ctx, args[1])) {
+        emit(ctx, op, work, *amount & mask);
+      } else {
+        load(ctx, rcx, args[1]);
+        emit(ctx, opcode::And, ecx, mask);
+        emit(ctx, op, work, cl);
+      }
+      if (op == opcode::Shl)
+        wrap(ctx, work, width);
+      define(ctx, value, ctx.at + 1, work);
+    }
+
+    // Compares two values, reading the left one in place from a register.
+    auto gen_compare(context& ctx, value_id lhs, value_id rhs)
+      -> void {
+      auto left = constant_of(ctx, lhs) ? x86::operand {} : location_of(ctx, lhs);
+      if (!std::holds_alternative<x86::gpr>(left)) {
+        load(ctx, rax, lhs);
+        left = rax;
+      }
+      emit(ctx, opcode::Cmp, left, source_of(ctx, rhs));
+    }
+
+    auto gen_branch(context& ctx, value_id value)
+      -> void {
+      auto block = ctx.target.at(value).parent;
+      auto condition = ctx.target.operands(value)[0];
+      auto cc = cond::Ne;
+      if (ctx.fused[condition]) {
+        auto args = ctx.target.operands(condition);
+        gen_compare(ctx, args[0], args[1]);
+        cc = compare_of(ctx.target.at(condition).op);
+      } else if (constant_of(ctx, condition)) {
+        load(ctx, rax, condition);
+        emit(ctx, opcode::Test, rax, rax);
+      } else {
+        emit(ctx, opcode::Cmp, location_of(ctx, condition), std::int64_t { 0 });
+      }
+
+      auto const& succs = ctx.target.block(block).succs;
+      if (succs[0] == ctx.next && !has_moves(ctx, block, succs[0])) {
+        emit_cc(ctx, opcode::Jcc, x86::negate(cc), edge_label(ctx, block, succs[1]));
+        return;
+      }
+      emit_cc(ctx, opcode::Jcc, cc, edge_label(ctx, block, succs[0]));
+      gen_edge(ctx, block, succs[1]);
+    }
+
+    auto gen_return(context& ctx, value_id value)
+      -> void {
+      auto args = ctx.target.operands(value);
+      for (auto i = std::size_t { 0 }; i < ctx.outputs.size(); ++i)
+        copy(ctx, ctx.outputs[i], args[i + 1]);
+      if (ctx.target.result() != ir::type::Void)
+        load(ctx, rax, args[0]);
+      if (ctx.next != ir::none)
+        emit(ctx, opcode::Jmp, ctx.finish);
+    }
+
+    auto gen_saves(context& ctx)
+      -> void {
+      for (auto const& [id, slot]: ctx.saved)
+        emit(ctx, opcode::Mov, slot, x86::gpr { id });
+    }
+
+    auto gen_restores(context& ctx)
+      -> void {
+      for (auto const& [id, slot]: ctx.saved)
+        emit(ctx, opcode::Mov, x86::gpr { id }, slot);
+    }
+
+    // A return marked as a tail call, in a function of the module, right
+    // after the call whose result it returns.
+    auto is_tail_return(context& ctx, value_id value)
+      -> bool {
+      auto const& current = ctx.target.at(value);
+      if (!ctx.callee || current.op != ir::opcode::Return || current.imm == 0)
+        return false;
+      auto const& code = ctx.target.block(current.parent).code;
+      if (code.size() < 2)
+        return false;
+      auto call = code[code.size() - 2];
+      auto args = ctx.target.operands(value);
+      return ctx.target.at(call).op == ir::opcode::Call && (args.empty() || args[0] == call);
+    }
+
+    // A tail call moves its arguments over those of the function, below the
+    // same return address, and jumps to the callee once the registers are
+    // given back. The arguments only ever move up, so copying them from the
+    // first (the highest) is safe even when both places overlap.
+    auto gen_tail_call(context& ctx, std::size_t callee, std::int32_t pushed)
+      -> void {
+      auto params = static_cast<std::int32_t>(ctx.target.params().size());
+      emit(ctx, opcode::Mov, rcx, x86::mem { reg::Rbp, 8 });
+      emit(ctx, opcode::Mov, rdx, x86::mem { reg::Rbp });
+      gen_restores(ctx);
+      for (auto i = 0; i < pushed; ++i) {
+        emit(ctx, opcode::Mov, rax, x86::mem { reg::Rsp, 8 * (pushed - 1 - i) });
+        emit(ctx, opcode::Mov, x86::mem { reg::Rbp, 8 * (params - i + 1) }, rax);
+      }
+      emit(ctx, opcode::Mov, x86::mem { reg::Rbp, 8 * (params - pushed + 1) }, rcx);
+      emit(ctx, opcode::Lea, rsp, x86::mem { reg::Rbp, 8 * (params - pushed + 1) });
+      emit(ctx, opcode::Mov, rbp, rdx);
+      emit(ctx, opcode::Jmp, ctx.functions[callee]);
+    }
+
+    // The arguments are pushed first to last, after checking the stack has
+    // room for them and the frame of the callee, which pops them. The callee
+    // keeps every register it uses, so the values live across the call stay
+    // in theirs.
+    auto gen_call(context& ctx, value_id value)
+      -> void {
+      auto const& current = ctx.target.at(value);
+      auto args = ctx.target.operands(value);
+      auto callee = static_cast<std::size_t>(ctx.target.at(args[0]).imm);
+      auto pushed = static_cast<std::int32_t>(args.size() - 1);
+      auto need = 8 * (pushed + 2) + ctx.frames[callee];
+      emit(ctx, opcode::Lea, rax, x86::mem { reg::Rsp, -need });
+      emit(ctx, opcode::Cmp, rax, ctx.limit);
+      emit_cc(ctx, opcode::Jcc, cond::B, trap_at(ctx, ctx.overflows, static_cast<std::size_t>(current.imm)));
+      for (auto arg: args.subspan(1)) {
+        auto source = constant_of(ctx, arg) ? x86::operand {} : location_of(ctx, arg);
+        if (auto const* where = std::get_if<x86::gpr>(&source)) {
+          emit(ctx, opcode::Push, *where);
+          continue;
+        }
+        load(ctx, rax, arg);
+        emit(ctx, opcode::Push, rax);
+      }
+      if (is_tail_return(ctx, ctx.target.terminator(current.parent))) {
+        gen_tail_call(ctx, callee, pushed);
+        return;
+      }
+      emit(ctx, opcode::Call, ctx.functions[callee]);
+      if (current.kind != ir::type::Void)
+        define(ctx, value, ctx.at + 1, rax);
+    }
+
+    auto gen_instruction(context& ctx, value_id value)
+      -> void {
+      auto const& current = ctx.target.at(value);
+      auto args = ctx.target.operands(value);
+      auto width = ir::width_of(current.kind);
+      switch (current.op) {
+        case ir::opcode::Const:
+        case ir::opcode::Phi:
+          return;
+        case ir::opcode::Add:
+        case ir::opcode::Sub:
+        case ir::opcode::Mul:
+        case ir::opcode::And:
+        case ir::opcode::Or:
+        case ir::opcode::Xor:
+        case ir::opcode::Neg:
+        case ir::opcode::Not:
+          gen_arithmetic(ctx, value, width);
+          return;
+        case ir::opcode::Div:
+        case ir::opcode::Mod:
+          gen_division(ctx, value, width);
+          break;
+        case ir::opcode::Shl:
+        case ir::opcode::Shr:
+          gen_shift(ctx, value, width);
+          return;
+        case ir::opcode::Eq:
+        case ir::opcode::Ne:
+        case ir::opcode::Lt:
+        case ir::opcode::Le:
+        case ir::opcode::Gt:
+        case ir::opcode::Ge:
+          if (ctx.fused[value])
+            return;
+          gen_compare(ctx, args[0], args[1]);
+          emit_cc(ctx, opcode::Set, compare_of(current.op), al);
+          emit(ctx, opcode::Movzx, eax, al);
+          break;
+        case ir::opcode::Param: {
+          // The arguments are above the return address, the last one first.
+          auto count = static_cast<std::int32_t>(ctx.target.params().size());
+          auto work = work_of(ctx, value, ir::none);
+          emit(ctx, opcode::Mov, work, x86::mem { reg::Rbp, 16 + 8 * (count - 1 - static_cast<std::int32_t>(current.imm)) });
+          define(ctx, value, ctx.at + 1, work);
+          return;
+        }
+        case ir::opcode::Array:
+        case ir::opcode::Function:
+          return;
+        case ir::opcode::Call:
+          gen_call(ctx, value);
+          return;
+        case ir::opcode::Load:
+          gen_load(ctx, value);
+          return;
+        case ir::opcode::Store:
+          gen_store(ctx, value);
+          return;
+        case ir::opcode::Clear:
+          gen_clear(ctx, value);
+          return;
+        case ir::opcode::Jump:
+          gen_edge(ctx, current.parent, ctx.target.block(current.parent).succs[0]);
+          return;
+        case ir::opcode::Branch:
+          gen_branch(ctx, value);
+          return;
+        case ir::opcode::Return:
+          if (!is_tail_return(ctx, value))
+            gen_return(ctx, value);
+          return;
+      }
+      define(ctx, value, ctx.at + 1, rax);
+    }
+
+    // Reverse postorder, visiting the first successor of every block last so
+    // that it is laid out right after the block: the body of a loop follows
+    // its header and the `then` side of an `if` its condition.
+    auto layout_of(ir::function const& target)
+      -> std::vector<block_id> {
+      auto result = std::vector<block_id> {};
+      auto visited = std::vector<bool>(target.block_count(), false);
+      auto stack = std::vector<std::pair<block_id, std::size_t>> { { 0, target.block(0).succs.size() } };
+      visited[0] = true;
+      while (!stack.empty()) {
+        auto& [block, left] = stack.back();
+        if (left == 0) {
+          result.push_back(block);
+          stack.pop_back();
+          continue;
+        }
+        auto succ = target.block(block).succs[--left];
+        if (!visited[succ]) {
+          visited[succ] = true;
+          stack.emplace_back(succ, target.block(succ).succs.size());
+        }
+      }
+      std::reverse(result.begin(), result.end());
+      return result;
+    }
+
+    auto callee_saved(reg id)
+      -> bool {
+      return id == reg::Rbx || id >= reg::R12;
+    }
+
+    // Places the values computed at run time in `pool`, with a slot for
+    // those that need one and for the registers to give back to the
+    // caller, every one it uses for a function of the module, then places
+    // the arrays, and returns the size of the frame with `extra` more
+    // slots at its bottom.
+    auto lay_out(
+      context& ctx,
+      std::span<block_id const> order,
+      std::span<reg const> pool,
+      std::size_t extra,
+      bool called = false
+    ) -> std::int32_t {
+      auto const& target = ctx.target;
+      auto uses = std::vector<std::uint32_t>(target.size(), 0);
+      for (auto block: order) {
+        for (auto value: target.block(block).phis) {
+          for (auto arg: target.operands(value))
+            ++uses[arg];
+        }
+        for (auto value: target.block(block).code) {
+          for (auto arg: target.operands(value))
+            ++uses[arg];
+        }
+      }
+
+      for (auto block: order) {
+        auto last = target.terminator(block);
+        if (target.at(last).op != ir::opcode::Branch)
+          continue;
+        auto condition = target.operands(last)[0];
+        auto const& tested = target.at(condition);
+        ctx.fused[condition] = tested.parent == block && ir::is_compare(tested.op) && uses[condition] == 1;
+      }
+
+      ctx.regs = allocate(target, order, ctx.fused, pool);
+      auto count = std::int32_t { 0 };
+      for (auto value = value_id { 0 }; value < target.size(); ++value) {
+        auto const& ranges = ctx.regs.ranges[value];
+        if (ctx.regs.spilled[value])
+          ctx.offsets[value] = -8 * ++count;
+        for (auto i = std::size_t { 1 }; i < ranges.size(); ++i) {
+          if (ranges[i].where && !ranges[i - 1].where)
+            ctx.reloads[ranges[i].start].emplace_back(value, *ranges[i].where);
+        }
+      }
+      for (auto id: ctx.regs.used) {
+        if (called || callee_saved(id))
+          ctx.saved.emplace_back(id, x86::mem { reg::Rbp, -8 * ++count });
+      }
+      // Arrays take whole quadwords, which `rep stosq` clears.
+      auto bytes = 8 * count;
+      for (auto const& array: target.arrays()) {
+        bytes += static_cast<std::int32_t>((array.length * bytes_of(array.kind) + 7) / 8 * 8);
+        ctx.arrays.push_back(-bytes);
+      }
+      bytes += 8 * static_cast<std::int32_t>(extra);
+      return (bytes + 15) / 16 * 16;
+    }
+
+    auto gen_body(context& ctx, std::span<block_id const> order)
+      -> void {
+      for (auto i = std::size_t { 0 }; i < order.size(); ++i) {
+        ctx.next = i + 1 < order.size() ? order[i + 1] : ir::none;
+        bind(ctx, ctx.labels[order[i]]);
+        for (auto value: ctx.target.block(order[i]).code) {
+          ctx.at = ctx.regs.positions[value];
+          if (auto reloads = ctx.reloads.find(ctx.at); reloads != ctx.reloads.end()) {
+            for (auto [reloaded, where]: reloads->second)
+              emit(ctx, opcode::Mov, x86::gpr { where }, slot_of(ctx, reloaded));
+          }
+          gen_instruction(ctx, value);
+        }
+      }
+    }
+
+    auto gen_stubs(context& ctx)
+      -> void {
+      ctx.next = ir::none;
+      // Edges out of stubs always jump, so no stub adds another.
+      for (auto const& edge: ctx.stubs) {
+        bind(ctx, edge.at);
+        gen_edge(ctx, edge.from, edge.to);
+      }
+    }
+
+    auto make_context(ir::function const& target, x86::program& out)
+      -> context {
+      auto result = context {
+        target, out, {}, std::vector<std::int32_t>(target.size(), 0), {},
+        std::vector<bool>(target.size(), false), {}, 0, {}, {}, {}, ir::none, {}, {}, {}, {}, out.make_label()
+      };
+      for (auto id = block_id { 0 }; id < target.block_count(); ++id)
+        result.labels.push_back(out.make_label());
+      for (auto& loop: ir::find_vector_loops(target))
+        result.vectorized.emplace(loop.header, std::move(loop));
+      return result;
+    }
+
+    // The registers values are kept in, but `r15` when there are calls and
+    // `rbx` when it holds the outputs.
+    auto pool_of(bool calls, bool hosted)
+      -> std::vector<reg> {
+      auto result = std::vector<reg> {};
+      for (auto id: registers) {
+        if (!(calls && id == reg::R15) && !(hosted && id == reg::Rbx))
+          result.push_back(id);
+      }
+      return result;
+    }
+
+    // The functions `main` calls, directly or not.
+    auto reached_from(ir::function const& main, std::span<ir::function const> functions)
+      -> std::vector<bool> {
+      auto result = std::vector<bool>(functions.size(), false);
+      auto stack = std::vector<ir::function const*> { &main };
+      while (!stack.empty()) {
+        auto const& current = *stack.back();
+        stack.pop_back();
+        for (auto id = block_id { 0 }; id < current.block_count(); ++id) {
+          for (auto value: current.block(id).code) {
+            if (current.at(value).op != ir::opcode::Call)
+              continue;
+            auto callee = static_cast<std::size_t>(current.at(current.operands(value)[0]).imm);
+            if (!result[callee]) {
+              result[callee] = true;
+              stack.push_back(&functions[callee]);
+            }
+          }
+        }
+      }
+      return result;
+    }
+
+    struct callee {
+      context ctx;
+      std::vector<block_id> order;
+      std::int32_t frame;
+      x86::label entry;
+    };
+
+    // The functions of a module compiled along with its entry.
+    struct callees {
+      std::vector<x86::label> entries;
+      std::vector<std::int32_t> frames;
+      std::vector<callee> reached;
+    };
+
+    // Lays out the functions `main` reaches, so that their calls know the
+    // size of their frames.
+    auto lay_out_callees(x86::program& out, ir::function const& main, std::span<ir::function const> functions)
+      -> callees {
+      auto result = callees { {}, std::vector<std::int32_t>(functions.size(), 0), {} };
+      auto reached = reached_from(main, functions);
+      auto pool = pool_of(true, false);
+      for (auto index = std::size_t { 0 }; index < functions.size(); ++index) {
+        result.entries.push_back(out.make_label());
+        if (!reached[index])
+          continue;
+        auto order = layout_of(functions[index]);
+        auto& current = result.reached.emplace_back(callee {
+          make_context(functions[index], out), std::move(order), 0, result.entries.back()
+        });
+        current.ctx.callee = true;
+        current.frame = lay_out(current.ctx, current.order, pool, 0, true);
+        result.frames[index] = current.frame;
+      }
+      return result;
+    }
+
+    // How the values of the entry and of every function it reaches were
+    // placed, in the order they were laid out.
+    auto stats_of(context const& entry, callees const& module)
+      -> std::vector<function_stats> {
+      auto result = std::vector<function_stats> {};
+      result.push_back(function_stats { std::string { entry.target.name() }, entry.regs.stats });
+      for (auto const& current: module.reached)
+        result.push_back(function_stats { std::string { current.ctx.target.name() }, current.ctx.regs.stats });
+      return result;
+    }
+
+    auto link(context& ctx, callees const& module, x86::mem limit)
+      -> void {
+      ctx.functions = module.entries;
+      ctx.frames = module.frames;
+      ctx.limit = limit;
+    }
+
+    // Emits a function of the module. Its traps go back to the frame of the
+    // entry first, then on to those of `top`, which report them.
+    auto gen_callee(callee& current, context& top)
+      -> void {
+      auto& ctx = current.ctx;
+      bind(ctx, current.entry);
+      emit(ctx, opcode::Push, rbp);
+      emit(ctx, opcode::Mov, rbp, rsp);
+      if (current.frame != 0)
+        emit(ctx, opcode::Sub, rsp, std::int64_t { current.frame });
+      gen_saves(ctx);
+      gen_body(ctx, current.order);
+      bind(ctx, ctx.finish);
+      gen_restores(ctx);
+      emit(ctx, opcode::Leave);
+      if (auto params = ctx.target.params().size(); params != 0)
+        emit(ctx, opcode::Ret, static_cast<std::int64_t>(8 * params));
+      else
+        emit(ctx, opcode::Ret);
+      gen_stubs(ctx);
+
+      auto unwind = [&](std::map<std::size_t, x86::label> const& traps, std::map<std::size_t, x86::label>& to) {
+        for (auto const& [line, trap]: traps) {
+          bind(ctx, trap);
+          emit(ctx, opcode::Mov, rbp, r15);
+          emit(ctx, opcode::Jmp, trap_at(top, to, line));
+        }
+      };
+      unwind(ctx.traps, top.traps);
+      unwind(ctx.bounds, top.bounds);
+      unwind(ctx.overflows, top.overflows);
+    }
+  }
+
+  extern auto ir_compiler::compile()
+    -> x86::program {
+    auto result = x86::program {};
+    result.entry = result.make_label("main");
+    auto module = lay_out_callees(result, _target, _functions);
+    auto calls = !module.reached.empty();
+    auto ctx = make_context(_target, result);
+    auto print = result.make_label();
+    auto order = layout_of(_target);
+
+    // The frame holds the values, then the outputs and the exit status.
+    // With calls, `r15` keeps it for the traps, and it also holds the
+    // caller's `r15` and the limit of the stack.
+    auto outputs = _target.outputs();
+    auto frame = lay_out(ctx, order, pool_of(calls, false), outputs.size() + (calls ? 3 : 1));
+    auto first = -frame;
+    for (auto i = std::size_t { 0 }; i < outputs.size(); ++i)
+      ctx.outputs.push_back(x86::mem { reg::Rbp, first + 8 * static_cast<std::int32_t>(i) });
+    auto status = x86::mem { reg::Rbp, first + 8 * static_cast<std::int32_t>(outputs.size()) };
+    auto saved = x86::mem { reg::Rbp, status.disp + 8 };
+    auto limit = x86::mem { reg::R15, status.disp + 16 };
+    link(ctx, module, limit);
+    for (auto& current: module.reached)
+      link(current.ctx, module, limit);
+
+    bind(ctx, result.entry);
+    emit(ctx, opcode::Push, rbp);
+    emit(ctx, opcode::Mov, rbp, rsp);
+    emit(ctx, opcode::Sub, rsp, std::int64_t { frame });
+    gen_saves(ctx);
+    if (calls) {
+      emit(ctx, opcode::Mov, saved, r15);
+      emit(ctx, opcode::Mov, r15, rbp);
+      emit(ctx, opcode::Lea, rax, x86::mem { reg::Rsp, -static_cast<std::int32_t>(stack_budget) });
+      emit(ctx, opcode::Mov, limit, rax);
+    }
+    gen_body(ctx, order);
+
+    // Prints the outputs and returns the status in `rax`.
+    bind(ctx, ctx.finish);
+    emit(ctx, opcode::Mov, status, rax);
+    for (auto i = std::size_t { 0 }; i < outputs.size(); ++i)
+      gen_output(result, print, outputs[i].name, ctx.outputs[i]);
+    emit(ctx, opcode::Mov, rax, status);
+    gen_restores(ctx);
+    if (calls)
+      emit(ctx, opcode::Mov, r15, saved);
+    emit(ctx, opcode::Leave);
+    emit(ctx, opcode::Ret);
+
+    gen_stubs(ctx);
+    for (auto& current: module.reached)
+      gen_callee(current, ctx);
+    // Traps return from `main` themselves, with the registers given back.
+    auto gen_traps = [&](std::map<std::size_t, x86::label> const& traps, auto gen_trap) {
+      for (auto const& [line, trap]: traps) {
+        bind(ctx, trap);
+        gen_restores(ctx);
+        if (calls)
+          emit(ctx, opcode::Mov, r15, saved);
+        gen_trap(result, result.make_label(), line);
+      }
+    };
+    gen_traps(ctx.traps, gen_division_trap);
+    gen_traps(ctx.bounds, gen_index_trap);
+    gen_traps(ctx.overflows, gen_stack_trap);
+    gen_print(result, print);
+    _stats = stats_of(ctx, module);
+    return result;
+  }
+
+  extern auto ir_compiler::compile_function()
+    -> x86::program {
+    auto result = x86::program {};
+    result.entry = result.make_label("thalia_entry");
+    auto module = lay_out_callees(result, _target, _functions);
+    auto calls = !module.reached.empty();
+    auto ctx = make_context(_target, result);
+    auto done = result.make_label();
+    auto order = layout_of(_target);
+    auto state = [](vm::status value) { return static_cast<std::int64_t>(value); };
+
+    for (auto const& output: _target.outputs())
+      ctx.outputs.push_back(x86::mem { reg::Rbx, 8 * static_cast<std::int32_t>(output.slot) });
+    // `rbx` holds the outputs, so it is the one register values do without.
+    // With calls, `r15` keeps the frame, which holds the limit of the stack.
+    auto frame = lay_out(ctx, order, pool_of(calls, true), calls ? 1 : 0);
+    auto limit = x86::mem { reg::R15, -frame };
+    link(ctx, module, limit);
+    for (auto& current: module.reached)
+      link(current.ctx, module, limit);
+
+    // A trap in a function leaves without its restores, so with calls the
+    // entry keeps every register its caller relies on.
+    auto kept = calls
+      ? std::vector<x86::gpr> { rbx, r12, r13, r14, r15 }
+      : std::vector<x86::gpr> { rbx };
+    bind(ctx, result.entry);
+    for (auto id: kept)
+      emit(ctx, opcode::Push, id);
+    emit(ctx, opcode::Push, rbp);
+    emit(ctx, opcode::Mov, rbp, rsp);
+    emit(ctx, opcode::Sub, rsp, std::int64_t { frame });
+    gen_saves(ctx);
+    emit(ctx, opcode::Mov, rbx, rdi);
+    if (calls) {
+      emit(ctx, opcode::Mov, r15, rbp);
+      emit(ctx, opcode::Lea, rax, x86::mem { reg::Rsp, -static_cast<std::int32_t>(stack_budget) });
+      emit(ctx, opcode::Mov, limit, rax);
+    }
+    gen_body(ctx, order);
+
+    bind(ctx, ctx.finish);
+    emit(ctx, opcode::Mov, edx, state(vm::status::Returned));
+    bind(ctx, done);
+    gen_restores(ctx);
+    emit(ctx, opcode::Leave);
+    for (auto id = kept.rbegin(); id != kept.rend(); ++id)
+      emit(ctx, opcode::Pop, *id);
+    emit(ctx, opcode::Ret);
+
+    gen_stubs(ctx);
+    for (auto& current: module.reached)
+      gen_callee(current, ctx);
+    auto gen_traps = [&](std::map<std::size_t, x86::label> const& traps, vm::status status) {
+      for (auto const& [line, trap]: traps) {
+        bind(ctx, trap);
+        emit(ctx, opcode::Mov, eax, static_cast<std::int64_t>(line));
+        emit(ctx, opcode::Mov, edx, state(status));
+        emit(ctx, opcode::Jmp, done);
+      }
+    };
+    gen_traps(ctx.traps, vm::status::DivByZero);
+    gen_traps(ctx.bounds, vm::status::IndexOutOfRange);
+    gen_traps(ctx.overflows, vm::status::StackOverflow);
+    _stats = stats_of(ctx, module);
+    return result;
+  }
+}
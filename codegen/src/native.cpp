@@ -0,0 +1,872 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <limits>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <thalia-sema/arith.hpp>
+#include <thalia-sema/tail_calls.hpp>
+#include <thalia-vm/compiler.hpp>
+#include <thalia-vm/machine.hpp>
+
+#include "thalia-codegen/native.hpp"
+#include "runtime.hpp"
+
+namespace thalia::codegen {
+  namespace {
+    using x86::cond;
+    using x86::opcode;
+    using x86::reg;
+
+    constexpr auto rax = x86::gpr { reg::Rax };
+    constexpr auto eax = x86::gpr { reg::Rax, 4 };
+    constexpr auto al = x86::gpr { reg::Rax, 1 };
+    constexpr auto rcx = x86::gpr { reg::Rcx };
+    constexpr auto ecx = x86::gpr { reg::Rcx, 4 };
+    constexpr auto cl = x86::gpr { reg::Rcx, 1 };
+    constexpr auto rdx = x86::gpr { reg::Rdx };
+    constexpr auto edx = x86::gpr { reg::Rdx, 4 };
+    constexpr auto rdi = x86::gpr { reg::Rdi };
+    constexpr auto rbp = x86::gpr { reg::Rbp };
+    constexpr auto rsp = x86::gpr { reg::Rsp };
+    constexpr auto r15 = x86::gpr { reg::R15 };
+
+    struct context {
+      sema::type_table const& types;
+      sema::resolution const& names;
+      sema::typing const& typing;
+      sema::constants const& values;
+      vm::frame_layout frame;
+      x86::program& out;
+      x86::label finish;
+      x86::label print;
+      std::map<std::size_t, x86::label> traps;
+      std::map<std::size_t, x86::label> bounds;
+      bool hosted;
+      /** The entry of every function. */
+      std::vector<x86::label> functions;
+      /** The slots of the frame of every function. */
+      std::vector<std::size_t> frames;
+      std::map<std::size_t, x86::label> overflows;
+      /** The lowest address the stack may reach, relative to `r15`. */
+      x86::mem limit;
+      /** The function being compiled, or `vm::top_level`. */
+      std::size_t function;
+      std::size_t params;
+      /** Where the function being compiled returns from. */
+      x86::label leave;
+    };
+
+    auto emit(context& ctx, opcode op, x86::operand lhs = {}, x86::operand rhs = {})
+      -> void {
+      ctx.out.text.push_back(x86::instruction { op, cond::E, { lhs, rhs } });
+    }
+
+    auto emit_cc(context& ctx, opcode op, cond cc, x86::operand target)
+      -> void {
+      ctx.out.text.push_back(x86::instruction { op, cc, { target, {} } });
+    }
+
+    auto bind(context& ctx, x86::label target)
+      -> void {
+      emit(ctx, opcode::Label, target);
+    }
+
+    // Where the slot of a frame lives: the parameters of a function above
+    // its return address, first to last, the rest below its `rbp`.
+    auto local_of(context& ctx, std::size_t index)
+      -> x86::mem {
+      if (index < ctx.params)
+        return x86::mem { reg::Rbp, 8 * static_cast<std::int32_t>(ctx.params - index + 1) };
+      return x86::mem { reg::Rbp, -8 * static_cast<std::int32_t>(index - ctx.params + 1) };
+    }
+
+    // Where a slot lives: in the frame of `main` or of its function, or in
+    // the host's array `rbx` points to.
+    auto slot_of(context& ctx, std::size_t slot)
+      -> x86::mem {
+      if (ctx.hosted && ctx.function == vm::top_level)
+        return x86::mem { reg::Rbx, 8 * static_cast<std::int32_t>(slot) };
+      return local_of(ctx, slot - ctx.frame.base);
+    }
+
+    // Where the elements of an array start. Frames grow down, so there the
+    // first element takes the last of the array's slots.
+    auto elements_of(context& ctx, std::size_t slot, std::size_t length)
+      -> x86::mem {
+      auto base = ctx.frame.elements[slot];
+      if (ctx.hosted && ctx.function == vm::top_level)
+        return x86::mem { reg::Rbx, 8 * static_cast<std::int32_t>(base) };
+      return local_of(ctx, base + length - 1);
+    }
+
+    auto width_of(context& ctx, std::shared_ptr<syntax::expression> const& node)
+      -> std::size_t {
+      return ctx.types.get(ctx.typing.type_of(*node)).width;
+    }
+
+    auto unwrap(std::shared_ptr<syntax::expression> node)
+      -> std::shared_ptr<syntax::expression> {
+      while (node && node->is(syntax::expr_type::Paren))
+        node = std::static_pointer_cast<syntax::expr_paren>(node)->value();
+      return node;
+    }
+
+    auto fits_imm32(std::int64_t value)
+      -> bool {
+      return value >= std::numeric_limits<std::int32_t>::min()
+        && value <= std::numeric_limits<std::int32_t>::max();
+    }
+
+    // Sign-extends the low `width` bits of `rax`.
+    auto wrap(context& ctx, std::size_t width)
+      -> void {
+      switch (width) {
+        case 8: emit(ctx, opcode::Movsx, rax, al); break;
+        case 16: emit(ctx, opcode::Movsx, rax, x86::gpr { reg::Rax, 2 }); break;
+        case 32: emit(ctx, opcode::Movsxd, rax, eax); break;
+        default: break;
+      }
+    }
+
+    // The label of the code reporting a division by zero on a line.
+    auto trap_at(context& ctx, std::size_t line)
+      -> x86::label {
+      auto [found, inserted] = ctx.traps.try_emplace(line, x86::label { 0 });
+      if (inserted)
+        found->second = ctx.out.make_label();
+      return found->second;
+    }
+
+    // The label of the code reporting an index out of range on a line.
+    auto bounds_at(context& ctx, std::size_t line)
+      -> x86::label {
+      auto [found, inserted] = ctx.bounds.try_emplace(line, x86::label { 0 });
+      if (inserted)
+        found->second = ctx.out.make_label();
+      return found->second;
+    }
+
+    // The label of the code reporting a stack overflow by a call on a line.
+    auto overflow_at(context& ctx, std::size_t line)
+      -> x86::label {
+      auto [found, inserted] = ctx.overflows.try_emplace(line, x86::label { 0 });
+      if (inserted)
+        found->second = ctx.out.make_label();
+      return found->second;
+    }
+
+    // Checks the index in `rcx` against its array and returns the element
+    // it selects.
+    auto gen_element(context& ctx, syntax::expr_index const& node)
+      -> x86::mem {
+      auto target = std::static_pointer_cast<syntax::expr_id>(unwrap(node.target()));
+      auto slot = ctx.names.slot(*target);
+      auto length = ctx.types.get(ctx.typing.slot_type(slot)).length;
+      emit(ctx, opcode::Cmp, rcx, static_cast<std::int64_t>(length));
+      emit_cc(ctx, opcode::Jcc, cond::Ae, bounds_at(ctx, node.bracket().line()));
+      auto element = elements_of(ctx, slot, length);
+      element.index = reg::Rcx;
+      element.scale = 8;
+      return element;
+    }
+
+    auto compare_of(syntax::token_type type)
+      -> std::optional<cond> {
+      switch (type) {
+        case syntax::token_type::Less: return cond::L;
+        case syntax::token_type::LessEqual: return cond::Le;
+        case syntax::token_type::Grt: return cond::G;
+        case syntax::token_type::GrtEqual: return cond::Ge;
+        case syntax::token_type::Equal: return cond::E;
+        case syntax::token_type::NotEqual: return cond::Ne;
+        default: return std::nullopt;
+      }
+    }
+
+    auto gen_expr(context& ctx, std::shared_ptr<syntax::expression> const& node) -> void;
+    auto gen_branch(context& ctx, std::shared_ptr<syntax::expression> node, x86::label target, bool when)
+      -> void;
+
+    // An operand that can be used in place without evaluating it: a variable
+    // or a constant that fits an immediate.
+    auto leaf(context& ctx, std::shared_ptr<syntax::expression> const& node)
+      -> std::optional<x86::operand> {
+      auto inner = unwrap(node);
+      if (auto folded = ctx.values.value(*inner))
+        return fits_imm32(*folded) ? std::optional<x86::operand> { *folded } : std::nullopt;
+      if (inner->is(syntax::expr_type::Id)) {
+        auto slot = ctx.names.slot(*std::static_pointer_cast<syntax::expr_id>(inner));
+        return x86::operand { slot_of(ctx, slot) };
+      }
+      return std::nullopt;
+    }
+
+    // Evaluates the right operand of an operation whose left operand is in
+    // `rax`, and returns where it is; `rax` is left unchanged.
+    auto right(context& ctx, std::shared_ptr<syntax::expression> const& node)
+      -> x86::operand {
+      if (auto operand = leaf(ctx, node))
+        return *operand;
+      emit(ctx, opcode::Push, rax);
+      gen_expr(ctx, node);
+      emit(ctx, opcode::Mov, rcx, rax);
+      emit(ctx, opcode::Pop, rax);
+      return rcx;
+    }
+
+    // Applies an arithmetic or bitwise operator to `rax` and an operand.
+    auto gen_arith(
+      context& ctx,
+      syntax::token const& operation,
+      syntax::token_type type,
+      x86::operand rhs,
+      std::size_t width
+    ) -> void {
+      auto const* imm = std::get_if<std::int64_t>(&rhs);
+      switch (type) {
+        case syntax::token_type::Plus:
+          emit(ctx, opcode::Add, rax, rhs);
+          wrap(ctx, width);
+          return;
+        case syntax::token_type::Minus:
+          emit(ctx, opcode::Sub, rax, rhs);
+          wrap(ctx, width);
+          return;
+        case syntax::token_type::Mul:
+          if (imm) {
+            emit(ctx, opcode::Mov, rcx, rhs);
+            rhs = rcx;
+          }
+          emit(ctx, opcode::Imul, rax, rhs);
+          wrap(ctx, width);
+          return;
+        case syntax::token_type::Div:
+        case syntax::token_type::Mod: {
+          auto is_div = type == syntax::token_type::Div;
+          auto safe = imm && *imm != 0 && *imm != -1;
+          if (!std::holds_alternative<x86::gpr>(rhs))
+            emit(ctx, opcode::Mov, rcx, rhs);
+          if (!safe) {
+            emit(ctx, opcode::Test, rcx, rcx);
+            emit_cc(ctx, opcode::Jcc, cond::E, trap_at(ctx, operation.line()));
+          }
+          // The only quotient that overflows 64-bit `idiv` is MIN / -1.
+          auto negation = !safe && width == 64;
+          auto divide = ctx.out.make_label();
+          auto done = ctx.out.make_label();
+          if (negation) {
+            emit(ctx, opcode::Cmp, rcx, std::int64_t { -1 });
+            emit_cc(ctx, opcode::Jcc, cond::Ne, divide);
+            if (is_div)
+              emit(ctx, opcode::Neg, rax);
+            else emit(ctx, opcode::Xor, eax, eax);
+            emit(ctx, opcode::Jmp, done);
+            bind(ctx, divide);
+          }
+          emit(ctx, opcode::Cqo);
+          emit(ctx, opcode::Idiv, rcx);
+          if (!is_div)
+            emit(ctx, opcode::Mov, rax, rdx);
+          if (negation)
+            bind(ctx, done);
+          if (is_div)
+            wrap(ctx, width);
+          return;
+        }
+        case syntax::token_type::LShift:
+        case syntax::token_type::RShift: {
+          auto op = type == syntax::token_type::LShift ? opcode::Shl : opcode::Sar;
+          auto mask = static_cast<std::int64_t>(width - 1);
+          if (imm) {
+            emit(ctx, op, rax, *imm & mask);
+          } else {
+            if (!std::holds_alternative<x86::gpr>(rhs))
+              emit(ctx, opcode::Mov, rcx, rhs);
+            emit(ctx, opcode::And, ecx, mask);
+            emit(ctx, op, rax, cl);
+          }
+          if (op == opcode::Shl)
+            wrap(ctx, width);
+          return;
+        }
+        case syntax::token_type::BitAnd:
+          emit(ctx, opcode::And, rax, rhs);
+          return;
+        case syntax::token_type::BitOr:
+          emit(ctx, opcode::Or, rax, rhs);
+          return;
+        default:
+          emit(ctx, opcode::Xor, rax, rhs);
+          return;
+      }
+    }
+
+    class expr_generator
+      : public syntax::expr_visitor<context&, void> {
+      public:
+        expr_generator(std::shared_ptr<syntax::expression> const& node)
+          : syntax::expr_visitor<context&, void> { node } {}
+
+        auto generate(context& ctx) -> void;
+
+      protected:
+        auto visit_expr_assign(context& ctx) -> void override;
+        auto visit_expr_binary(context& ctx) -> void override;
+        auto visit_expr_unary(context& ctx) -> void override;
+        auto visit_expr_paren(context& ctx) -> void override;
+        auto visit_expr_base_lit(context& ctx) -> void override;
+        auto visit_expr_id(context& ctx) -> void override;
+        auto visit_expr_index(context& ctx) -> void override;
+        auto visit_expr_call(context& ctx) -> void override;
+        auto visit_expr_data_type(context&) -> void override {}
+        auto visit_expr_array_type(context&) -> void override {}
+
+      private:
+        auto gen_element_assign(context& ctx) -> void;
+    };
+
+    class stmt_generator
+      : public syntax::stmt_visitor<context&, void> {
+      public:
+        stmt_generator(std::shared_ptr<syntax::statement> const& node)
+          : syntax::stmt_visitor<context&, void> { node } {}
+
+        auto generate(context& ctx) -> void
+          { if (_node) visit_stmt(ctx); }
+
+      protected:
+        auto visit_stmt_block(context& ctx) -> void override;
+        auto visit_stmt_return(context& ctx) -> void override;
+        auto visit_stmt_expr(context& ctx) -> void override;
+        auto visit_stmt_if(context& ctx) -> void override;
+        auto visit_stmt_while(context& ctx) -> void override;
+        auto visit_stmt_local(context& ctx) -> void override;
+        auto visit_stmt_function(context&) -> void override {}
+    };
+
+    auto gen_expr(context& ctx, std::shared_ptr<syntax::expression> const& node)
+      -> void {
+      expr_generator { node }.generate(ctx);
+    }
+
+    // Jumps to `target` if the truth of `node` is `when`, else falls through.
+    auto gen_branch(context& ctx, std::shared_ptr<syntax::expression> node, x86::label target, bool when)
+      -> void {
+      node = unwrap(node);
+      if (auto folded = ctx.values.value(*node)) {
+        if ((*folded != 0) == when)
+          emit(ctx, opcode::Jmp, target);
+        return;
+      }
+
+      if (node->is(syntax::expr_type::Unary)) {
+        auto root = std::static_pointer_cast<syntax::expr_unary>(node);
+        if (root->operation().is(syntax::token_type::LogNot))
+          return gen_branch(ctx, root->value(), target, !when);
+      }
+
+      if (node->is(syntax::expr_type::Binary)) {
+        auto root = std::static_pointer_cast<syntax::expr_binary>(node);
+        auto type = root->operation().type();
+        if (type == syntax::token_type::LogAnd || type == syntax::token_type::LogOr) {
+          // `a && b` is true when both are, `a || b` is false when both are.
+          auto both = type == syntax::token_type::LogAnd ? when : !when;
+          if (both) {
+            auto skip = ctx.out.make_label();
+            gen_branch(ctx, root->lhs(), skip, !when);
+            gen_branch(ctx, root->rhs(), target, when);
+            bind(ctx, skip);
+          } else {
+            gen_branch(ctx, root->lhs(), target, when);
+            gen_branch(ctx, root->rhs(), target, when);
+          }
+          return;
+        }
+        if (auto compare = compare_of(type)) {
+          gen_expr(ctx, root->lhs());
+          auto rhs = right(ctx, root->rhs());
+          emit(ctx, opcode::Cmp, rax, rhs);
+          emit_cc(ctx, opcode::Jcc, when ? *compare : x86::negate(*compare), target);
+          return;
+        }
+      }
+
+      gen_expr(ctx, node);
+      emit(ctx, opcode::Test, rax, rax);
+      emit_cc(ctx, opcode::Jcc, when ? cond::Ne : cond::E, target);
+    }
+
+    extern auto expr_generator::generate(context& ctx)
+      -> void {
+      if (!_node) {
+        emit(ctx, opcode::Xor, eax, eax);
+        return;
+      }
+      if (auto folded = ctx.values.value(*_node)) {
+        if (*folded == 0)
+          emit(ctx, opcode::Xor, eax, eax);
+        else emit(ctx, opcode::Mov, rax, *folded);
+        return;
+      }
+      visit_expr(ctx);
+    }
+
+    extern auto expr_generator::visit_expr_assign(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_assign>(_node);
+      if (unwrap(root->target())->is(syntax::expr_type::Index))
+        return gen_element_assign(ctx);
+      auto variable = std::static_pointer_cast<syntax::expr_id>(unwrap(root->target()));
+      auto target = slot_of(ctx, ctx.names.slot(*variable));
+
+      auto operation = sema::binary_of(root->operation().type());
+      if (operation == syntax::token_type::Assign) {
+        gen_expr(ctx, root->value());
+      } else {
+        // The old value is read before the right-hand side runs.
+        emit(ctx, opcode::Mov, rax, target);
+        auto rhs = right(ctx, root->value());
+        gen_arith(ctx, root->operation(), operation, rhs, width_of(ctx, variable));
+      }
+      emit(ctx, opcode::Mov, target, rax);
+    }
+
+    // The index is evaluated first and checked when the element is accessed:
+    // after the value for a plain assignment, before it for an update. It
+    // waits on the stack while the value is evaluated.
+    extern auto expr_generator::gen_element_assign(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_assign>(_node);
+      auto target = std::static_pointer_cast<syntax::expr_index>(unwrap(root->target()));
+      gen_expr(ctx, target->index());
+
+      auto operation = sema::binary_of(root->operation().type());
+      if (operation == syntax::token_type::Assign) {
+        emit(ctx, opcode::Push, rax);
+        gen_expr(ctx, root->value());
+        emit(ctx, opcode::Pop, rcx);
+        emit(ctx, opcode::Mov, gen_element(ctx, *target), rax);
+        return;
+      }
+
+      emit(ctx, opcode::Mov, rcx, rax);
+      auto element = gen_element(ctx, *target);
+      emit(ctx, opcode::Mov, rax, element);
+      emit(ctx, opcode::Push, rcx);
+      auto rhs = right(ctx, root->value());
+      gen_arith(ctx, root->operation(), operation, rhs, width_of(ctx, target));
+      emit(ctx, opcode::Pop, rcx);
+      emit(ctx, opcode::Mov, element, rax);
+    }
+
+    extern auto expr_generator::visit_expr_binary(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_binary>(_node);
+      auto operation = root->operation();
+      auto type = operation.type();
+      if (type == syntax::token_type::LogAnd || type == syntax::token_type::LogOr) {
+        auto is_false = ctx.out.make_label();
+        auto done = ctx.out.make_label();
+        gen_branch(ctx, _node, is_false, false);
+        emit(ctx, opcode::Mov, eax, std::int64_t { 1 });
+        emit(ctx, opcode::Jmp, done);
+        bind(ctx, is_false);
+        emit(ctx, opcode::Xor, eax, eax);
+        bind(ctx, done);
+        return;
+      }
+
+      gen_expr(ctx, root->lhs());
+      auto rhs = right(ctx, root->rhs());
+      if (auto compare = compare_of(type)) {
+        emit(ctx, opcode::Cmp, rax, rhs);
+        emit_cc(ctx, opcode::Set, *compare, al);
+        emit(ctx, opcode::Movzx, eax, al);
+        return;
+      }
+      gen_arith(ctx, operation, type, rhs, width_of(ctx, root->lhs()));
+    }
+
+    extern auto expr_generator::visit_expr_unary(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_unary>(_node);
+      gen_expr(ctx, root->value());
+      switch (root->operation().type()) {
+        case syntax::token_type::Minus:
+          emit(ctx, opcode::Neg, rax);
+          wrap(ctx, width_of(ctx, _node));
+          break;
+        case syntax::token_type::BitNot:
+          emit(ctx, opcode::Not, rax);
+          break;
+        case syntax::token_type::LogNot:
+          emit(ctx, opcode::Test, rax, rax);
+          emit_cc(ctx, opcode::Set, cond::E, al);
+          emit(ctx, opcode::Movzx, eax, al);
+          break;
+        default:
+          break;
+      }
+    }
+
+    extern auto expr_generator::visit_expr_paren(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_paren>(_node);
+      gen_expr(ctx, root->value());
+    }
+
+    extern auto expr_generator::visit_expr_base_lit(context& ctx)
+      -> void {
+      // Checked literals are always folded already.
+      auto root = std::static_pointer_cast<syntax::expr_base_lit>(_node);
+      emit(ctx, opcode::Mov, rax, sema::parse_literal(root->target().value(), width_of(ctx, _node)).value);
+    }
+
+    extern auto expr_generator::visit_expr_id(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_id>(_node);
+      emit(ctx, opcode::Mov, rax, slot_of(ctx, ctx.names.slot(*root)));
+    }
+
+    extern auto expr_generator::visit_expr_index(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_index>(_node);
+      gen_expr(ctx, root->index());
+      emit(ctx, opcode::Mov, rcx, rax);
+      emit(ctx, opcode::Mov, rax, gen_element(ctx, *root));
+    }
+
+    // The arguments are pushed first to last, after checking the stack has
+    // room for them and the frame of the callee.
+    auto gen_args(context& ctx, syntax::expr_call const& node)
+      -> std::size_t {
+      auto callee = ctx.names.callee(node);
+      auto args = node.args();
+      auto need = 8 * (args.size() + 2 + ctx.frames[callee]);
+      emit(ctx, opcode::Lea, rax, x86::mem { reg::Rsp, -static_cast<std::int32_t>(need) });
+      emit(ctx, opcode::Cmp, rax, ctx.limit);
+      emit_cc(ctx, opcode::Jcc, cond::B, overflow_at(ctx, node.callee().line()));
+      for (auto const& arg: args) {
+        gen_expr(ctx, arg);
+        emit(ctx, opcode::Push, rax);
+      }
+      return callee;
+    }
+
+    // A tail call moves its arguments over those of the function, below the
+    // same return address, and jumps to the callee, which pops them. The
+    // arguments only ever move up, so copying them from the first (the
+    // highest) is safe even when both places overlap.
+    auto gen_tail_call(context& ctx, syntax::expr_call const& node)
+      -> void {
+      auto callee = gen_args(ctx, node);
+      auto args = static_cast<std::int32_t>(node.args().size());
+      auto params = static_cast<std::int32_t>(ctx.params);
+      emit(ctx, opcode::Mov, rcx, x86::mem { reg::Rbp, 8 });
+      emit(ctx, opcode::Mov, rdx, x86::mem { reg::Rbp });
+      for (auto i = 0; i < args; ++i) {
+        emit(ctx, opcode::Mov, rax, x86::mem { reg::Rsp, 8 * (args - 1 - i) });
+        emit(ctx, opcode::Mov, x86::mem { reg::Rbp, 8 * (params - i + 1) }, rax);
+      }
+      emit(ctx, opcode::Mov, x86::mem { reg::Rbp, 8 * (params - args + 1) }, rcx);
+      emit(ctx, opcode::Lea, rsp, x86::mem { reg::Rbp, 8 * (params - args + 1) });
+      emit(ctx, opcode::Mov, rbp, rdx);
+      emit(ctx, opcode::Jmp, ctx.functions[callee]);
+    }
+
+    // Functions pop their own arguments.
+    extern auto expr_generator::visit_expr_call(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_call>(_node);
+      emit(ctx, opcode::Call, ctx.functions[gen_args(ctx, *root)]);
+    }
+
+    extern auto stmt_generator::visit_stmt_block(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_block>(_node);
+      for (auto const& node: root->content())
+        stmt_generator { node }.generate(ctx);
+    }
+
+    extern auto stmt_generator::visit_stmt_return(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_return>(_node);
+      auto tail = sema::tail_call_of(*root);
+      if (tail && ctx.function != vm::top_level) {
+        gen_tail_call(ctx, *tail);
+        return;
+      }
+      gen_expr(ctx, root->value());
+      emit(ctx, opcode::Jmp, ctx.function == vm::top_level ? ctx.finish : ctx.leave);
+    }
+
+    extern auto stmt_generator::visit_stmt_expr(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_expr>(_node);
+      gen_expr(ctx, root->value());
+    }
+
+    extern auto stmt_generator::visit_stmt_if(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_if>(_node);
+      if (auto folded = ctx.values.value(*root->condition())) {
+        stmt_generator { *folded ? root->main_body() : root->else_body() }.generate(ctx);
+        return;
+      }
+
+      auto to_else = ctx.out.make_label();
+      gen_branch(ctx, root->condition(), to_else, false);
+      stmt_generator { root->main_body() }.generate(ctx);
+      if (!root->else_body()) {
+        bind(ctx, to_else);
+        return;
+      }
+
+      auto to_end = ctx.out.make_label();
+      emit(ctx, opcode::Jmp, to_end);
+      bind(ctx, to_else);
+      stmt_generator { root->else_body() }.generate(ctx);
+      bind(ctx, to_end);
+    }
+
+    extern auto stmt_generator::visit_stmt_while(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_while>(_node);
+      auto folded = ctx.values.value(*root->condition());
+      if (folded && !*folded)
+        return;
+
+      auto body = ctx.out.make_label();
+      if (folded) {
+        bind(ctx, body);
+        stmt_generator { root->body() }.generate(ctx);
+        emit(ctx, opcode::Jmp, body);
+        return;
+      }
+
+      // The condition is tested at the bottom, so every iteration takes a
+      // single branch.
+      auto test = ctx.out.make_label();
+      emit(ctx, opcode::Jmp, test);
+      bind(ctx, body);
+      stmt_generator { root->body() }.generate(ctx);
+      bind(ctx, test);
+      gen_branch(ctx, root->condition(), body, true);
+    }
+
+    extern auto stmt_generator::visit_stmt_local(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_local>(_node);
+      for (auto const& variable: root->content()) {
+        auto slot = ctx.names.slot(variable);
+        auto const& declared = ctx.types.get(ctx.typing.slot_type(slot));
+        if (declared.kind == sema::type_kind::Array) {
+          emit(ctx, opcode::Lea, rdi, elements_of(ctx, slot, declared.length));
+          emit(ctx, opcode::Mov, ecx, static_cast<std::int64_t>(declared.length));
+          emit(ctx, opcode::Xor, eax, eax);
+          emit(ctx, opcode::RepStos);
+          continue;
+        }
+        gen_expr(ctx, variable.value);
+        emit(ctx, opcode::Mov, slot_of(ctx, slot), rax);
+      }
+    }
+
+    auto make_context(
+      sema::type_table const& types,
+      sema::resolution const& names,
+      sema::typing const& typing,
+      sema::constants const& values,
+      x86::program& out,
+      bool hosted
+    ) -> context {
+      auto result = context {
+        types, names, typing, values, vm::frame_of(types, names, typing), out,
+        out.make_label(), out.make_label(), {}, {}, hosted,
+        {}, {}, {}, x86::mem { reg::R15 }, vm::top_level, 0, x86::label { 0 }
+      };
+      for (auto function = std::size_t { 0 }; function < names.functions().size(); ++function) {
+        result.functions.push_back(out.make_label());
+        result.frames.push_back(vm::frame_of(types, names, typing, function).slots);
+      }
+      return result;
+    }
+
+    // Emits every function after the code of the top level. A function
+    // that falls off its end returns 0, and pops its arguments on return.
+    auto gen_functions(context& ctx)
+      -> void {
+      auto functions = ctx.names.functions();
+      for (auto function = std::size_t { 0 }; function < functions.size(); ++function) {
+        auto const& definition = *functions[function].definition;
+        ctx.frame = vm::frame_of(ctx.types, ctx.names, ctx.typing, function);
+        ctx.function = function;
+        ctx.params = definition.params().size();
+        ctx.leave = ctx.out.make_label();
+
+        bind(ctx, ctx.functions[function]);
+        emit(ctx, opcode::Push, rbp);
+        emit(ctx, opcode::Mov, rbp, rsp);
+        if (auto locals = ctx.frame.slots - ctx.params)
+          emit(ctx, opcode::Sub, rsp, static_cast<std::int64_t>(8 * locals));
+        stmt_generator { definition.body() }.generate(ctx);
+        emit(ctx, opcode::Xor, eax, eax);
+        bind(ctx, ctx.leave);
+        emit(ctx, opcode::Leave);
+        if (ctx.params != 0)
+          emit(ctx, opcode::Ret, static_cast<std::int64_t>(8 * ctx.params));
+        else
+          emit(ctx, opcode::Ret);
+      }
+    }
+  }
+
+  extern auto native_compiler::compile(
+    std::span<std::shared_ptr<syntax::statement> const> ast
+  ) -> x86::program {
+    auto result = x86::program {};
+    result.entry = result.make_label("main");
+    auto ctx = make_context(_types, _names, _typing, _values, result, false);
+    auto calls = !ctx.functions.empty();
+
+    // The frame holds the slots, then the exit status, 16-byte aligned.
+    // With functions, `r15` keeps it for the traps, and the frame also
+    // holds the caller's `r15` and the limit of the stack.
+    auto slots = ctx.frame.slots;
+    auto status = slot_of(ctx, slots);
+    auto saved = slot_of(ctx, slots + 1);
+    ctx.limit = slot_of(ctx, slots + 2);
+    ctx.limit.base = reg::R15;
+    auto frame = static_cast<std::int64_t>((slots + (calls ? 4 : 2)) / 2 * 16);
+
+    bind(ctx, result.entry);
+    emit(ctx, opcode::Push, rbp);
+    emit(ctx, opcode::Mov, rbp, rsp);
+    emit(ctx, opcode::Sub, rsp, frame);
+    if (calls) {
+      emit(ctx, opcode::Mov, saved, r15);
+      emit(ctx, opcode::Mov, r15, rbp);
+      emit(ctx, opcode::Lea, rax, x86::mem { reg::Rsp, -static_cast<std::int32_t>(stack_budget) });
+      emit(ctx, opcode::Mov, ctx.limit, rax);
+    }
+    for (auto const& node: ast)
+      stmt_generator { node }.generate(ctx);
+    emit(ctx, opcode::Xor, eax, eax);
+
+    // Prints the top-level `mut` variables and returns the status in `rax`.
+    bind(ctx, ctx.finish);
+    emit(ctx, opcode::Mov, status, rax);
+    auto symbols = _names.symbols();
+    for (auto slot = std::size_t { 0 }; slot < symbols.size(); ++slot) {
+      auto const& symbol = symbols[slot];
+      if (symbol.depth != 0 || symbol.external || !symbol.declaration->mut)
+        continue;
+      if (_types.is_array(_typing.slot_type(slot)))
+        continue;
+      gen_output(result, ctx.print, symbol.declaration->id.value(), slot_of(ctx, slot));
+    }
+    if (calls)
+      emit(ctx, opcode::Mov, r15, saved);
+    emit(ctx, opcode::Mov, rax, status);
+    emit(ctx, opcode::Leave);
+    emit(ctx, opcode::Ret);
+    gen_functions(ctx);
+
+    // A trap in a function first goes back to the frame of `main`.
+    auto unwind = [&](x86::label trap) {
+      if (!calls)
+        return trap;
+      bind(ctx, trap);
+      emit(ctx, opcode::Mov, rbp, r15);
+      emit(ctx, opcode::Mov, r15, saved);
+      return result.make_label();
+    };
+    for (auto const& [line, trap]: ctx.traps)
+      gen_division_trap(result, unwind(trap), line);
+    for (auto const& [line, trap]: ctx.bounds)
+      gen_index_trap(result, unwind(trap), line);
+    for (auto const& [line, trap]: ctx.overflows)
+      gen_stack_trap(result, unwind(trap), line);
+    gen_print(result, ctx.print);
+    return result;
+  }
+
+  extern auto native_compiler::compile_function(
+    std::span<std::shared_ptr<syntax::statement> const> ast
+  ) -> x86::program {
+    auto result = x86::program {};
+    result.entry = result.make_label("thalia_entry");
+    auto ctx = make_context(_types, _names, _typing, _values, result, true);
+    auto calls = !ctx.functions.empty();
+    auto done = result.make_label();
+    auto state = [](vm::status value) { return static_cast<std::int64_t>(value); };
+
+    // The frame is only there for traps, which can leave operands pushed.
+    // With functions, it holds the limit of the stack and `r15` keeps it.
+    bind(ctx, result.entry);
+    emit(ctx, opcode::Push, x86::gpr { reg::Rbx });
+    if (calls)
+      emit(ctx, opcode::Push, r15);
+    emit(ctx, opcode::Push, rbp);
+    emit(ctx, opcode::Mov, rbp, rsp);
+    emit(ctx, opcode::Mov, x86::gpr { reg::Rbx }, rdi);
+    if (calls) {
+      emit(ctx, opcode::Lea, rax, x86::mem { reg::Rsp, -static_cast<std::int32_t>(stack_budget) });
+      emit(ctx, opcode::Push, rax);
+      emit(ctx, opcode::Mov, r15, rbp);
+      ctx.limit.disp = -8;
+    }
+    for (auto const& node: ast)
+      stmt_generator { node }.generate(ctx);
+    emit(ctx, opcode::Xor, eax, eax);
+    emit(ctx, opcode::Mov, edx, state(vm::status::Halted));
+    emit(ctx, opcode::Jmp, done);
+
+    bind(ctx, ctx.finish);
+    emit(ctx, opcode::Mov, edx, state(vm::status::Returned));
+    bind(ctx, done);
+    emit(ctx, opcode::Leave);
+    if (calls)
+      emit(ctx, opcode::Pop, r15);
+    emit(ctx, opcode::Pop, x86::gpr { reg::Rbx });
+    emit(ctx, opcode::Ret);
+    gen_functions(ctx);
+
+    // A trap in a function first goes back to the frame of the entry.
+    auto trap_to = [&](x86::label trap, std::size_t line, vm::status why) {
+      bind(ctx, trap);
+      if (calls)
+        emit(ctx, opcode::Mov, rbp, r15);
+      emit(ctx, opcode::Mov, eax, static_cast<std::int64_t>(line));
+      emit(ctx, opcode::Mov, edx, state(why));
+      emit(ctx, opcode::Jmp, done);
+    };
+    for (auto const& [line, trap]: ctx.traps)
+      trap_to(trap, line, vm::status::DivByZero);
+    for (auto const& [line, trap]: ctx.bounds)
+      trap_to(trap, line, vm::status::IndexOutOfRange);
+    for (auto const& [line, trap]: ctx.overflows)
+      trap_to(trap, line, vm::status::StackOverflow);
+    return result;
+  }
+}
@@ -0,0 +1,152 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "runtime.hpp"
+
+namespace thalia::codegen {
+  namespace {
+    using x86::cond;
+    using x86::opcode;
+    using x86::reg;
+
+    constexpr auto rax = x86::gpr { reg::Rax };
+    constexpr auto eax = x86::gpr { reg::Rax, 4 };
+    constexpr auto ecx = x86::gpr { reg::Rcx, 4 };
+    constexpr auto rcx = x86::gpr { reg::Rcx };
+    constexpr auto rdx = x86::gpr { reg::Rdx };
+    constexpr auto edx = x86::gpr { reg::Rdx, 4 };
+    constexpr auto dl = x86::gpr { reg::Rdx, 1 };
+    constexpr auto rsi = x86::gpr { reg::Rsi };
+    constexpr auto edi = x86::gpr { reg::Rdi, 4 };
+    constexpr auto rdi = x86::gpr { reg::Rdi };
+    constexpr auto rsp = x86::gpr { reg::Rsp };
+    constexpr auto r8 = x86::gpr { reg::R8 };
+
+    constexpr auto sys_write = std::int64_t { 1 };
+    constexpr auto stdout_fd = std::int64_t { 1 };
+
+    auto emit(x86::program& out, opcode op, x86::operand lhs = {}, x86::operand rhs = {})
+      -> void {
+      out.text.push_back(x86::instruction { op, cond::E, { lhs, rhs } });
+    }
+
+    auto emit_cc(x86::program& out, opcode op, cond cc, x86::operand target)
+      -> void {
+      out.text.push_back(x86::instruction { op, cc, { target, {} } });
+    }
+
+    // write(1, rsi, rdx)
+    auto gen_write(x86::program& out)
+      -> void {
+      emit(out, opcode::Mov, eax, sys_write);
+      emit(out, opcode::Mov, edi, stdout_fd);
+      emit(out, opcode::Syscall);
+    }
+
+    // Prints an error and returns the exit status 1 from `main`.
+    auto gen_error(x86::program& out, x86::label at, std::string message)
+      -> void {
+      auto size = static_cast<std::int64_t>(message.size());
+      auto text = add_data(out, std::move(message));
+      emit(out, opcode::Label, at);
+      emit(out, opcode::Lea, rsi, x86::rip_rel { text });
+      emit(out, opcode::Mov, edx, size);
+      gen_write(out);
+      emit(out, opcode::Mov, eax, std::int64_t { 1 });
+      emit(out, opcode::Leave);
+      emit(out, opcode::Ret);
+    }
+  }
+
+  extern auto add_data(x86::program& out, std::string bytes)
+    -> x86::label {
+    auto name = out.make_label();
+    out.data.push_back(x86::datum { name, std::move(bytes) });
+    return name;
+  }
+
+  extern auto gen_print(x86::program& out, x86::label entry)
+    -> void {
+    auto positive = out.make_label();
+    auto digit = out.make_label();
+    auto unsigned_ = out.make_label();
+    constexpr auto buffer = std::int64_t { 32 };
+
+    emit(out, opcode::Label, entry);
+    emit(out, opcode::Mov, r8, rdi);
+    gen_write(out);
+    emit(out, opcode::Sub, rsp, buffer);
+    emit(out, opcode::Lea, rsi, x86::mem { reg::Rsp, buffer });
+    emit(out, opcode::Dec, rsi);
+    emit(out, opcode::Mov, x86::mem { reg::Rsi, 0, 1 }, std::int64_t { '\n' });
+    emit(out, opcode::Mov, rax, r8);
+    emit(out, opcode::Test, rax, rax);
+    emit_cc(out, opcode::Jcc, cond::Ns, positive);
+    emit(out, opcode::Neg, rax);
+    emit(out, opcode::Label, positive);
+    emit(out, opcode::Mov, ecx, std::int64_t { 10 });
+    emit(out, opcode::Label, digit);
+    emit(out, opcode::Xor, edx, edx);
+    emit(out, opcode::Div, rcx);
+    emit(out, opcode::Add, edx, std::int64_t { '0' });
+    emit(out, opcode::Dec, rsi);
+    emit(out, opcode::Mov, x86::mem { reg::Rsi, 0, 1 }, dl);
+    emit(out, opcode::Test, rax, rax);
+    emit_cc(out, opcode::Jcc, cond::Ne, digit);
+    emit(out, opcode::Test, r8, r8);
+    emit_cc(out, opcode::Jcc, cond::Ns, unsigned_);
+    emit(out, opcode::Dec, rsi);
+    emit(out, opcode::Mov, x86::mem { reg::Rsi, 0, 1 }, std::int64_t { '-' });
+    emit(out, opcode::Label, unsigned_);
+    emit(out, opcode::Lea, rdx, x86::mem { reg::Rsp, buffer });
+    emit(out, opcode::Sub, rdx, rsi);
+    gen_write(out);
+    emit(out, opcode::Add, rsp, buffer);
+    emit(out, opcode::Ret);
+  }
+
+  extern auto gen_output(x86::program& out, x86::label print, std::string_view name, x86::operand value)
+    -> void {
+    auto prefix = std::string { name }.append(" = ");
+    auto size = static_cast<std::int64_t>(prefix.size());
+    auto text = add_data(out, std::move(prefix));
+    emit(out, opcode::Mov, rdi, value);
+    emit(out, opcode::Lea, rsi, x86::rip_rel { text });
+    emit(out, opcode::Mov, edx, size);
+    emit(out, opcode::Call, print);
+  }
+
+  extern auto gen_division_trap(x86::program& out, x86::label at, std::size_t line)
+    -> void {
+    gen_error(out, at, std::string { "[ERROR]: Division by zero\n    ---> on line " }
+      .append(std::to_string(line)).append(".\n"));
+  }
+
+  extern auto gen_index_trap(x86::program& out, x86::label at, std::size_t line)
+    -> void {
+    gen_error(out, at, std::string { "[ERROR]: Index out of range\n    ---> on line " }
+      .append(std::to_string(line)).append(".\n"));
+  }
+
+  extern auto gen_stack_trap(x86::program& out, x86::label at, std::size_t line)
+    -> void {
+    gen_error(out, at, std::string { "[ERROR]: Stack overflow\n    ---> on line " }
+      .append(std::to_string(line)).append(".\n"));
+  }
+}
@@ -0,0 +1,96 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_CODEGEN_RUNTIME_
+#define _THALIA_CODEGEN_RUNTIME_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <thalia-codegen/x86.hpp>
+
+namespace thalia::codegen {
+  /**
+   * @brief How far below the entry of a program the stack of its calls may
+   *   grow before a call reports a stack overflow.
+   */
+  inline constexpr auto stack_budget = std::int64_t { 1 } << 22;
+
+  /**
+   * @brief Adds bytes to the data of a program.
+   * @param out The program.
+   * @param bytes The bytes.
+   * @return The label of the bytes.
+   */
+  extern auto add_data(x86::program& out, std::string bytes)
+    -> x86::label;
+
+  /**
+   * @brief Emits the routine printing the prefix at `rsi` of length `rdx`,
+   *   then `rdi` in decimal and a new line, through the `write` system call.
+   * @param out The program.
+   * @param entry The label to call the routine by.
+   */
+  extern auto gen_print(x86::program& out, x86::label entry)
+    -> void;
+
+  /**
+   * @brief Emits the call printing a variable as `name = value`.
+   * @param out The program.
+   * @param print The label of the routine emitted by `gen_print`.
+   * @param name The name of the variable.
+   * @param value Where its value is.
+   */
+  extern auto gen_output(x86::program& out, x86::label print, std::string_view name, x86::operand value)
+    -> void;
+
+  /**
+   * @brief Emits the code reporting a division by zero from a `main` with a
+   *   `rbp` frame, which returns the exit status 1.
+   * @param out The program.
+   * @param at The label of the code.
+   * @param line The line of the division.
+   */
+  extern auto gen_division_trap(x86::program& out, x86::label at, std::size_t line)
+    -> void;
+
+  /**
+   * @brief Emits the code reporting an index out of the range of its array
+   *   from a `main` with a `rbp` frame, which returns the exit status 1.
+   * @param out The program.
+   * @param at The label of the code.
+   * @param line The line of the index.
+   */
+  extern auto gen_index_trap(x86::program& out, x86::label at, std::size_t line)
+    -> void;
+
+  /**
+   * @brief Emits the code reporting a call the stack has no room for from a
+   *   `main` with a `rbp` frame, which returns the exit status 1.
+   * @param out The program.
+   * @param at The label of the code.
+   * @param line The line of the call.
+   */
+  extern auto gen_stack_trap(x86::program& out, x86::label at, std::size_t line)
+    -> void;
+}
+
+#endif // _THALIA_CODEGEN_RUNTIME_
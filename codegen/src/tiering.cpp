@@ -0,0 +1,45 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <chrono>
+
+#include "thalia-codegen/tiering.hpp"
+
+namespace thalia::codegen {
+  extern auto jit_tier::enter(std::size_t loop, std::span<std::int64_t> slots)
+    -> std::optional<vm::outcome> {
+    if (!_compiled[loop]) {
+      auto start = std::chrono::steady_clock::now();
+      _compiled[loop] = std::make_unique<jit_machine>(
+        _compiler.compile_function(std::span { &_loops[loop], 1 }), 0
+      );
+      if (_options.trace) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start
+        );
+        *_options.trace << "[tiering] loop " << loop << " (line " << _program.loops[loop].line
+          << ") is hot after " << _options.threshold << " iterations: compiled "
+          << _compiled[loop]->code_size() << " bytes in " << elapsed.count()
+          << " us, entering at its test\n";
+      }
+    }
+    ++_entries[loop];
+    return _compiled[loop]->run(slots);
+  }
+}
@@ -0,0 +1,47 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <utility>
+
+#include "thalia-codegen/x86.hpp"
+
+namespace thalia::codegen::x86 {
+  extern auto negate(cond value)
+    -> cond {
+    switch (value) {
+      case cond::E: return cond::Ne;
+      case cond::Ne: return cond::E;
+      case cond::L: return cond::Ge;
+      case cond::Le: return cond::G;
+      case cond::G: return cond::Le;
+      case cond::Ge: return cond::L;
+      case cond::S: return cond::Ns;
+      case cond::Ns: return cond::S;
+      case cond::B: return cond::Ae;
+      case cond::Ae: return cond::B;
+    }
+    return value;
+  }
+
+  extern auto program::make_label(std::string symbol)
+    -> label {
+    symbols.push_back(std::move(symbol));
+    return label { static_cast<std::uint32_t>(symbols.size() - 1) };
+  }
+}
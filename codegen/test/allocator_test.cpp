@@ -0,0 +1,147 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-ir/builder.hpp>
+#include <thalia-ir/loops.hpp>
+#include <thalia-test/frontend.hpp>
+
+#include "thalia-codegen/allocator.hpp"
+
+using namespace thalia;
+using codegen::x86::reg;
+
+namespace {
+  constexpr reg registers[] = { reg::Rsi, reg::R8, reg::R9, reg::R10, reg::R11, reg::R12 };
+
+  struct placed {
+    ir::function function;
+    codegen::allocation result;
+  };
+
+  // Builds a program and places its values in its first registers, with
+  // its blocks laid out in reverse postorder.
+  auto place(test::analyzed const& source, std::size_t count)
+    -> placed {
+    auto function = ir::builder { source.types, source.names, source.typing }.build(source.ast);
+    auto tree = ir::dominator_tree { function };
+    auto order = std::vector<ir::block_id>(tree.order().begin(), tree.order().end());
+    auto fused = std::vector<bool>(function.size(), false);
+    auto result = codegen::allocate(function, order, fused, std::span { registers }.first(count));
+    return placed { std::move(function), std::move(result) };
+  }
+
+  // Checks that the operands of every instruction, which are all live at
+  // it, are never in the same register.
+  auto check_operands(placed const& current)
+    -> void {
+    auto const& function = current.function;
+    for (auto block = ir::block_id { 0 }; block < function.block_count(); ++block) {
+      for (auto value: function.block(block).code) {
+        auto seen = std::vector<std::pair<ir::value_id, reg>> {};
+        for (auto arg: function.operands(value)) {
+          if (current.result.ranges[arg].empty())
+            continue;
+          auto where = current.result.where(arg, current.result.positions[value]);
+          if (!where)
+            continue;
+          for (auto const& [other, taken]: seen)
+            CHECK((other == arg || taken != *where));
+          seen.emplace_back(arg, *where);
+        }
+      }
+    }
+  }
+
+  constexpr auto pressure =
+    "def mut a: i64 = 1, mut b: i64 = 2, mut c: i64 = 3, mut d: i64 = 4, mut e: i64 = 5;\n"
+    "def mut f: i64 = 6, mut g: i64 = 7, mut h: i64 = 8, mut i: i64 = 0;\n"
+    "while i < 100 {\n"
+    "  a += b * c; b ^= c + d; c -= d * e; d += e ^ f;\n"
+    "  e += f - g; f ^= g * h; g += h + a; h -= a ^ b;\n"
+    "  i += 1;\n"
+    "}\n";
+}
+
+TEST_CASE("allocator: keeps a small loop in registers") {
+  auto source = test::analyzed {
+    "def mut i: i64 = 0, mut s: i64 = 1, mut x: i64 = 0;\n"
+    "while i < 1000 { s = s * 31 + i; x ^= s; i += 1; }\n"
+  };
+  auto current = place(source, std::size(registers));
+  auto const& stats = current.result.stats;
+  CHECK(stats.values > 0);
+  CHECK(stats.spilled == 0);
+  CHECK(stats.splits == 0);
+  CHECK(stats.in_registers == stats.values);
+  check_operands(current);
+
+  // The phis of the loop take the registers of the values they merge, so
+  // the back edge needs no copies.
+  auto const& function = current.function;
+  auto tree = ir::dominator_tree { function };
+  auto loops = ir::find_loops(function, tree);
+  REQUIRE(loops.size() == 1);
+  auto const& header = function.block(loops[0].header);
+  auto latch = loops[0].latches[0];
+  auto edge = static_cast<std::size_t>(std::find(header.preds.begin(), header.preds.end(), latch) - header.preds.begin());
+  for (auto phi: header.phis) {
+    auto incoming = function.operands(phi)[edge];
+    CHECK(current.result.where(phi, current.result.positions[phi])
+      == current.result.where(incoming, current.result.ends[latch]));
+  }
+}
+
+TEST_CASE("allocator: spills what the loops use least") {
+  auto source = test::analyzed { pressure };
+  auto current = place(source, 4);
+  auto const& stats = current.result.stats;
+  CHECK(stats.spilled > 0);
+  CHECK(stats.splits > 0);
+  CHECK(stats.in_registers + stats.spilled == stats.values);
+  CHECK(current.result.used.size() == 4);
+  check_operands(current);
+
+  // The induction variable is used on every iteration and never leaves its
+  // register.
+  auto const& function = current.function;
+  auto tree = ir::dominator_tree { function };
+  auto loops = ir::find_loops(function, tree);
+  REQUIRE(loops.size() == 1);
+  auto in_registers = std::size_t { 0 };
+  for (auto phi: function.block(loops[0].header).phis)
+    in_registers += !current.result.spilled[phi];
+  CHECK(in_registers > 0);
+}
+
+TEST_CASE("allocator: places everything in the frame without registers") {
+  auto source = test::analyzed { pressure };
+  auto current = place(source, 0);
+  auto const& stats = current.result.stats;
+  CHECK(stats.in_registers == 0);
+  CHECK(stats.spilled == stats.values);
+  CHECK(current.result.used.empty());
+}
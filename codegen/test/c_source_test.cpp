@@ -0,0 +1,226 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+#include <sys/wait.h>
+
+#include <thalia-vm/compiler.hpp>
+#include <thalia-vm/machine.hpp>
+#include <thalia-test/frontend.hpp>
+
+#include "thalia-codegen/c_source.hpp"
+
+using namespace thalia;
+
+namespace {
+  struct execution {
+    int status;
+    std::string output;
+  };
+
+  auto source_of(test::analyzed const& source)
+    -> std::string {
+    auto compiler = codegen::c_compiler { source.types, source.names, source.typing, source.values };
+    return compiler.compile(source.ast);
+  }
+
+  // What the stack machine prints and exits with, as the reference.
+  auto interpret(test::analyzed const& source)
+    -> execution {
+    auto compiler = vm::compiler { source.types, source.names, source.typing, source.values };
+    auto chunk = compiler.compile(source.ast);
+    auto machine = vm::machine { chunk };
+    auto result = machine.run();
+    auto output = std::string {};
+    for (auto const& global: chunk.globals)
+      output.append(global.name).append(" = ").append(std::to_string(machine.slots()[global.slot])).append("\n");
+    auto status = result.state == vm::status::Returned ? static_cast<int>(result.value) : 0;
+    return execution { status & 0xff, output };
+  }
+
+  auto has_compiler()
+    -> bool {
+    return std::system("cc --version > /dev/null 2>&1") == 0;
+  }
+
+  // Compiles the translation with the system compiler in strict C11 mode and
+  // runs it.
+  auto execute(test::analyzed const& source, std::string const& level = "-O2")
+    -> execution {
+    auto base = std::filesystem::temp_directory_path() / "thalia-c-test";
+    auto path = std::filesystem::path { base }.concat(".c");
+    std::ofstream { path } << source_of(source);
+
+    auto build = std::string { "cc -std=c11 -pedantic-errors " }
+      .append(level).append(" -o '").append(base.string()).append("' '").append(path.string()).append("'");
+    REQUIRE(std::system(build.c_str()) == 0);
+
+    auto result = execution { 0, {} };
+    auto* pipe = popen(base.c_str(), "r");
+    REQUIRE(pipe != nullptr);
+    char buffer[256];
+    while (auto read = std::fread(buffer, 1, sizeof(buffer), pipe))
+      result.output.append(buffer, read);
+    result.status = WEXITSTATUS(pclose(pipe));
+    std::filesystem::remove(path);
+    std::filesystem::remove(base);
+    return result;
+  }
+}
+
+TEST_CASE("c: keeps the block structure and wraps through unsigned types") {
+  auto text = source_of(test::analyzed {
+    "def MIN: i32 = 4i32, MAX: i32 = 6i32;\n"
+    "def mut i: i32 = MIN, mut s: i32 = 0i32;\n"
+    "while i <= MAX {\n"
+    "  def mut step: i32 = 1i32;\n"
+    "  if s > 100i32 { s = 0i32; } else { s += i; }\n"
+    "  i += step;\n"
+    "}\n"
+  });
+  CHECK(text.find("  int32_t i_2 = 0;\n") != std::string::npos);
+  CHECK(text.find("  i_2 = 4;\n") != std::string::npos);
+  CHECK(text.find("  while (((i_2) <= (6))) {\n    int32_t step_4 = 1;\n") != std::string::npos);
+  CHECK(text.find("    if (((s_3) > (100))) {\n      s_3 = 0;\n    }\n    else {\n") != std::string::npos);
+  CHECK(text.find("s_3 = (int32_t)((uint32_t)(s_3) + (uint32_t)(i_2));") != std::string::npos);
+  CHECK(text.find("printf(\"i = %\" PRId64 \"\\n\", (int64_t)i_2);") != std::string::npos);
+  CHECK(text.find("MIN_0") == std::string::npos);
+  CHECK(text.find("goto") == std::string::npos);
+}
+
+TEST_CASE("c: runs like the interpreter") {
+  if (!has_compiler())
+    return;
+
+  auto widths = execute(test::analyzed {
+    "def mut a: i8 = 127i8, mut b: i16 = 300i16, mut c: i32 = 1i32;\n"
+    "def mut d: i64 = 9223372036854775807, mut e: i8 = -128i8;\n"
+    "a += 1i8;\n"
+    "b *= b;\n"
+    "c <<= 35i8;\n"
+    "d += 1;\n"
+    "e = -e;\n"
+    "def mut f: i16 = -16i16;\n"
+    "f >>= 2i16;\n"
+    "def mut q: i64 = -9223372036854775807 - 1, mut r: i32 = -7i32, mut m: i8 = -128i8;\n"
+    "q /= -1;\n"
+    "r %= 2i32;\n"
+    "m /= -1i8;\n"
+  });
+  CHECK(widths.status == 0);
+  CHECK(widths.output ==
+    "a = -128\nb = 24464\nc = 8\nd = -9223372036854775808\ne = -128\n"
+    "f = -4\nq = -9223372036854775808\nr = -1\nm = -128\n");
+
+  auto logic = execute(test::analyzed {
+    "def mut calls: i64 = 0, mut x: i64 = 0, mut y: i64 = 0;\n"
+    "0 && (calls = 1);\n"
+    "x = 2 && 3;\n"
+    "y = 0 || (calls += 10) > 5;\n"
+    "def mut n: i32 = 0i32, mut evens: i32 = 0i32;\n"
+    "while n < 10i32 && !(n == 9i32) {\n"
+    "  if n % 2i32 == 0i32 { evens += 1i32; }\n"
+    "  n += 1i32;\n"
+    "  if n == 100i32 { return 1i32; }\n"
+    "}\n"
+    "return 42i32;\n"
+  });
+  CHECK(logic.status == 42);
+  CHECK(logic.output == "calls = 10\nx = 1\ny = 1\nn = 9\nevens = 5\n");
+
+  // Operands that assign run left to right, as on the virtual machines.
+  auto order = execute(test::analyzed {
+    "def mut x: i32 = 5i32, mut y: i32 = 0i32, mut z: i32 = 0i32;\n"
+    "x += (x = 3i32);\n"
+    "y = (z = 2i32) * z + (z = 10i32);\n"
+  });
+  CHECK(order.output == "x = 8\ny = 14\nz = 10\n");
+
+  auto trap = execute(test::analyzed {
+    "def mut q: i32 = 7i32, mut zero: i32 = 0i32;\n"
+    "\n"
+    "q = q / zero;\n"
+  });
+  CHECK(trap.status == 1);
+  CHECK(trap.output == "[ERROR]: Division by zero\n    ---> on line 3.\n");
+
+  // The index is computed, then the value, then the index is checked.
+  auto arrays = execute(test::analyzed {
+    "def mut a: [4]i16, mut i: i16 = 0i16, mut s: i16 = 0i16;\n"
+    "while i < 4i16 { a[i] = i; i += 1i16; }\n"
+    "a[i -= 1i16] += a[i] * 100i16;\n"
+    "s = a[3] - a[2];\n"
+  });
+  CHECK(arrays.output == "i = 3\ns = 301\n");
+  auto bounds = execute(test::analyzed {
+    "def mut a: [4]i16, mut i: i32 = 0i32, mut s: i16 = 0i16;\n"
+    "a[i = 9i32] = (s = 1i16);\n"
+  });
+  CHECK(bounds.status == 1);
+  CHECK(bounds.output == "[ERROR]: Index out of range\n    ---> on line 2.\n");
+
+  // Functions see their parameters and their own locals, and run out of
+  // stack where the virtual machines do.
+  auto calls = execute(test::analyzed {
+    "use fib(n: i64): i64;\n"
+    "global fib(n: i64): i64 { if n < 2 { return n; } return fib(n - 1) + fib(n - 2); }\n"
+    "global wrap(k: i8): i8 { def mut a: [3]i8; a[1] = k; a[2] = k * k; return a[1] + a[2]; }\n"
+    "def mut x: i64 = fib(15), mut y: i8 = wrap(12i8);\n"
+  });
+  CHECK(calls.output == "x = 610\ny = -100\n");
+  auto deep = execute(test::analyzed {
+    "global down(n: i64): i64 { return down(n + 1) + 1; }\n"
+    "def mut x: i64 = down(0);\n"
+  });
+  CHECK(deep.status == 1);
+  CHECK(deep.output == "[ERROR]: Stack overflow\n    ---> on line 1.\n");
+
+  // A function returning a call to itself loops instead.
+  auto tail = test::analyzed {
+    "global sum(n: i64, k: i8, s: i64): i64 { if n == 0 { return s; } return sum(n - 1, k + 1i8, s + n); }\n"
+    "def mut x: i64 = sum(3000000, 0i8, 0);\n"
+  };
+  CHECK(source_of(tail).find("goto recur;") != std::string::npos);
+  auto looped = execute(tail);
+  CHECK(looped.status == 0);
+  CHECK(looped.output == "x = 4500001500000\n");
+}
+
+TEST_CASE("c: shifts the results of comparisons and logic at their own width") {
+  if (!has_compiler())
+    return;
+
+  // The operators yield an `int` in C, which shifts by 32 or more would
+  // overflow without the cast to the type of the operation. Without
+  // optimizations the shifts run as the hardware does them.
+  auto source = test::analyzed {
+    "def mut a: i64 = 1, mut n: i64 = 32;\n"
+    "def mut r: i64 = (a || a) >> n, mut s: i64 = (a < 2) >> (n + 1), mut t: i64 = (a && a) << n;\n"
+    "def mut u: i64 = -(a == 1) >> (n + 31);\n"
+  };
+  auto expected = interpret(source);
+  CHECK(expected.output == "a = 1\nn = 32\nr = 0\ns = 0\nt = 4294967296\nu = -1\n");
+  auto result = execute(source, "-O0");
+  CHECK(result.status == expected.status);
+  CHECK(result.output == expected.output);
+}
@@ -0,0 +1,176 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <sys/wait.h>
+
+#include <thalia-test/frontend.hpp>
+
+#include "thalia-codegen/elf.hpp"
+#include "thalia-codegen/encoder.hpp"
+#include "thalia-codegen/native.hpp"
+
+using namespace thalia;
+using namespace thalia::codegen::x86;
+
+namespace {
+  struct execution {
+    int status;
+    std::string output;
+  };
+
+  auto compile(test::analyzed const& source)
+    -> program {
+    auto compiler = codegen::native_compiler { source.types, source.names, source.typing, source.values };
+    return compiler.compile(source.ast);
+  }
+
+  auto run(std::filesystem::path const& path)
+    -> execution {
+    auto result = execution { 0, {} };
+    auto* pipe = popen(path.c_str(), "r");
+    REQUIRE(pipe != nullptr);
+    char buffer[256];
+    while (auto read = std::fread(buffer, 1, sizeof(buffer), pipe))
+      result.output.append(buffer, read);
+    result.status = WEXITSTATUS(pclose(pipe));
+    return result;
+  }
+
+  auto encode_one(instruction const& current)
+    -> std::vector<std::uint8_t> {
+    auto source = program {};
+    source.text.push_back(current);
+    return encode(source).text;
+  }
+
+  constexpr auto rax = gpr { reg::Rax };
+  constexpr auto rcx = gpr { reg::Rcx };
+  constexpr auto r8 = gpr { reg::R8 };
+
+  constexpr auto example =
+    "def MIN: i32 = 4i32, MAX: i32 = 6i32;\n"
+    "def mut i: i32 = MIN, mut s: i32 = 0i32;\n"
+    "while i <= MAX { s += i; i += 1i32; }\n"
+    "return s;\n";
+}
+
+TEST_CASE("encoder: picks the assembler's encodings") {
+  using bytes = std::vector<std::uint8_t>;
+  CHECK(encode_one({ opcode::Mov, cond::E, { rcx, rax } }) == bytes { 0x48, 0x89, 0xc1 });
+  CHECK(encode_one({ opcode::Mov, cond::E, { gpr { reg::Rdi }, r8 } }) == bytes { 0x4c, 0x89, 0xc7 });
+  CHECK(encode_one({ opcode::Mov, cond::E, { rax, mem { reg::Rbp, -8 } } }) == bytes { 0x48, 0x8b, 0x45, 0xf8 });
+  CHECK(encode_one({ opcode::Mov, cond::E, { rax, std::int64_t { -5 } } })
+    == bytes { 0x48, 0xc7, 0xc0, 0xfb, 0xff, 0xff, 0xff });
+  CHECK(encode_one({ opcode::Mov, cond::E, { rax, std::int64_t { 5000000000 } } })
+    == bytes { 0x48, 0xb8, 0x00, 0xf2, 0x05, 0x2a, 0x01, 0x00, 0x00, 0x00 });
+  CHECK(encode_one({ opcode::Lea, cond::E, { gpr { reg::Rsi }, mem { reg::Rsp, 32 } } })
+    == bytes { 0x48, 0x8d, 0x74, 0x24, 0x20 });
+  CHECK(encode_one({ opcode::Add, cond::E, { rax, std::int64_t { 1000 } } })
+    == bytes { 0x48, 0x05, 0xe8, 0x03, 0x00, 0x00 });
+  CHECK(encode_one({ opcode::Cmp, cond::E, { rcx, std::int64_t { -1 } } }) == bytes { 0x48, 0x83, 0xf9, 0xff });
+  CHECK(encode_one({ opcode::Shl, cond::E, { rax, std::int64_t { 1 } } }) == bytes { 0x48, 0xd1, 0xe0 });
+  CHECK(encode_one({ opcode::Set, cond::Le, { gpr { reg::Rax, 1 } } }) == bytes { 0x0f, 0x9e, 0xc0 });
+  CHECK(encode_one({ opcode::Mov, cond::E, { mem { reg::Rbp, -8, 1 }, gpr { reg::Rsi, 1 } } })
+    == bytes { 0x40, 0x88, 0x75, 0xf8 });
+  CHECK(encode_one({ opcode::Push, cond::E, { r8 } }) == bytes { 0x41, 0x50 });
+  CHECK(encode_one({ opcode::Ret, cond::E, {} }) == bytes { 0xc3 });
+  CHECK(encode_one({ opcode::Ret, cond::E, { std::int64_t { 16 } } }) == bytes { 0xc2, 0x10, 0x00 });
+}
+
+TEST_CASE("encoder: picks the assembler's SSE encodings") {
+  using bytes = std::vector<std::uint8_t>;
+  auto element = mem { reg::Rbp, -256, 16, reg::Rax, 4 };
+  CHECK(encode_one({ opcode::Movdqu, cond::E, { xmm { 0 }, element } })
+    == bytes { 0xf3, 0x0f, 0x6f, 0x84, 0x85, 0x00, 0xff, 0xff, 0xff });
+  CHECK(encode_one({ opcode::Movdqu, cond::E, { mem { reg::Rbp, -16, 16, reg::Rax, 4 }, xmm { 9 } } })
+    == bytes { 0xf3, 0x44, 0x0f, 0x7f, 0x4c, 0x85, 0xf0 });
+  CHECK(encode_one({ opcode::Paddd, cond::E, { xmm { 8 }, xmm { 1 } } }) == bytes { 0x66, 0x44, 0x0f, 0xfe, 0xc1 });
+  CHECK(encode_one({ opcode::Pshufd, cond::E, { xmm { 2 }, xmm { 14 }, std::int64_t { 0x4e } } })
+    == bytes { 0x66, 0x41, 0x0f, 0x70, 0xd6, 0x4e });
+  CHECK(encode_one({ opcode::Movd, cond::E, { xmm { 3 }, gpr { reg::Rcx, 4 } } }) == bytes { 0x66, 0x0f, 0x6e, 0xd9 });
+  CHECK(encode_one({ opcode::Movd, cond::E, { gpr { reg::Rcx, 4 }, xmm { 10 } } })
+    == bytes { 0x66, 0x44, 0x0f, 0x7e, 0xd1 });
+  CHECK(encode_one({ opcode::Psrlq, cond::E, { xmm { 15 }, std::int64_t { 32 } } })
+    == bytes { 0x66, 0x41, 0x0f, 0x73, 0xd7, 0x20 });
+  CHECK(encode_one({ opcode::Pmuludq, cond::E, { xmm { 1 }, xmm { 15 } } }) == bytes { 0x66, 0x41, 0x0f, 0xf4, 0xcf });
+}
+
+TEST_CASE("encoder: widens branches that do not fit a byte") {
+  auto source = program {};
+  auto far = source.make_label();
+  auto near = source.make_label();
+  source.text.push_back({ opcode::Jcc, cond::Ne, { far } });
+  source.text.push_back({ opcode::Jmp, cond::E, { near } });
+  source.text.push_back({ opcode::Label, cond::E, { near } });
+  for (auto i = 0; i < 40; ++i)
+    source.text.push_back({ opcode::Mov, cond::E, { rax, mem { reg::Rbp, -8 } } });
+  source.text.push_back({ opcode::Label, cond::E, { far } });
+
+  auto code = encode(source);
+  REQUIRE(code.text.size() == 6 + 2 + 40 * 4);
+  CHECK(code.text[0] == 0x0f);
+  CHECK(code.text[1] == 0x85);
+  CHECK(code.text[2] == 162);
+  CHECK(code.text[6] == 0xeb);
+  CHECK(code.text[7] == 0);
+  CHECK(code.offsets[far.id] == 168);
+}
+
+TEST_CASE("elf: static executables run without any other tool") {
+#if defined(__x86_64__) && defined(__linux__)
+  auto path = std::filesystem::temp_directory_path() / "thalia-elf-test";
+  auto target = compile(test::analyzed { example });
+  auto start = codegen::add_start(target);
+  {
+    auto out = std::ofstream { path, std::ios::binary };
+    codegen::write_executable(out, encode(target), start);
+  }
+  std::filesystem::permissions(path, std::filesystem::perms::owner_exec, std::filesystem::perm_options::add);
+  auto result = run(path);
+  std::filesystem::remove(path);
+  CHECK(result.status == 15);
+  CHECK(result.output == "i = 7\ns = 15\n");
+#endif
+}
+
+TEST_CASE("elf: relocatable objects link with the system tools") {
+  if (std::system("cc --version > /dev/null 2>&1") != 0)
+    return;
+  auto base = std::filesystem::temp_directory_path() / "thalia-elf-object-test";
+  auto object = std::filesystem::path { base }.concat(".o");
+  auto target = compile(test::analyzed { example });
+  {
+    auto out = std::ofstream { object, std::ios::binary };
+    codegen::write_object(out, target, encode(target));
+  }
+  auto command = std::string { "cc -o '" }.append(base.string())
+    .append("' '").append(object.string()).append("'");
+  REQUIRE(std::system(command.c_str()) == 0);
+  auto result = run(base);
+  std::filesystem::remove(object);
+  std::filesystem::remove(base);
+  CHECK(result.status == 15);
+  CHECK(result.output == "i = 7\ns = 15\n");
+}
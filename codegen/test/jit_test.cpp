@@ -0,0 +1,166 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-vm/compiler.hpp>
+#include <thalia-vm/machine.hpp>
+#include <thalia-test/frontend.hpp>
+
+#include "thalia-codegen/jit.hpp"
+#include "thalia-codegen/native.hpp"
+
+#if defined(__x86_64__) && defined(__linux__)
+
+using namespace thalia;
+
+namespace {
+  struct execution {
+    vm::outcome result;
+    std::vector<std::int64_t> globals;
+  };
+
+  auto globals_of(test::analyzed const& source, std::span<std::int64_t const> slots)
+    -> std::vector<std::int64_t> {
+    auto values = std::vector<std::int64_t> {};
+    for (auto const& global: vm::globals_of(source.types, source.names, source.typing))
+      values.push_back(slots[global.slot]);
+    return values;
+  }
+
+  auto jit(test::analyzed const& source)
+    -> execution {
+    auto compiler = codegen::native_compiler { source.types, source.names, source.typing, source.values };
+    auto machine = codegen::jit_machine {
+      compiler.compile_function(source.ast), source.names.symbols().size()
+    };
+    auto result = machine.run();
+    return execution { result, globals_of(source, machine.slots()) };
+  }
+
+  auto interpret(test::analyzed const& source)
+    -> execution {
+    auto compiler = vm::compiler { source.types, source.names, source.typing, source.values };
+    auto chunk = compiler.compile(source.ast);
+    auto machine = vm::machine { chunk };
+    auto result = machine.run();
+    return execution { result, globals_of(source, machine.slots()) };
+  }
+
+  auto same(execution const& lhs, execution const& rhs)
+    -> bool {
+    return lhs.result.state == rhs.result.state
+      && lhs.result.value == rhs.result.value
+      && lhs.result.line == rhs.result.line
+      && lhs.globals == rhs.globals;
+  }
+}
+
+TEST_CASE("jit: runs the example") {
+  auto source = test::analyzed {
+    "def MIN: i32 = 4i32, MAX: i32 = 6i32;\n"
+    "def mut i: i32 = MIN, mut s: i32 = 0i32;\n"
+    "while i <= MAX { s += i; i += 1i32; }\n"
+  };
+  auto run = jit(source);
+  CHECK(run.result.state == vm::status::Halted);
+  CHECK(run.globals == std::vector<std::int64_t> { 7, 15 });
+  CHECK(same(run, interpret(source)));
+}
+
+TEST_CASE("jit: wraps at every width") {
+  auto source = test::analyzed {
+    "def mut a: i8 = 127i8, mut b: i16 = 300i16, mut c: i32 = 1i32;\n"
+    "def mut d: i64 = 9223372036854775807, mut e: i8 = -128i8;\n"
+    "a += 1i8;\n"
+    "b *= b;\n"
+    "c <<= 35i8;\n"
+    "d += 1;\n"
+    "e = -e;\n"
+    "def mut q: i64 = -9223372036854775807 - 1, mut r: i32 = -7i32, mut m: i8 = -128i8;\n"
+    "q /= -1;\n"
+    "r %= 2i32;\n"
+    "m /= -1i8;\n"
+  };
+  auto run = jit(source);
+  CHECK(run.globals == std::vector<std::int64_t> {
+    -128, 24464, 8, INT64_MIN, -128, INT64_MIN, -1, -128
+  });
+  CHECK(same(run, interpret(source)));
+}
+
+TEST_CASE("jit: returns and traps like the interpreter") {
+  auto logic = test::analyzed {
+    "def mut calls: i64 = 0, mut x: i64 = 0, mut y: i64 = 0;\n"
+    "0 && (calls = 1);\n"
+    "x = 2 && 3;\n"
+    "y = 0 || (calls += 10) > 5;\n"
+    "def mut n: i32 = 0i32, mut evens: i32 = 0i32;\n"
+    "while n < 10i32 && !(n == 9i32) {\n"
+    "  if n % 2i32 == 0i32 { evens += 1i32; }\n"
+    "  n += 1i32;\n"
+    "}\n"
+    "return 42i32;\n"
+  };
+  auto returned = jit(logic);
+  CHECK(returned.result.state == vm::status::Returned);
+  CHECK(returned.result.value == 42);
+  CHECK(same(returned, interpret(logic)));
+
+  auto trap = test::analyzed {
+    "def mut q: i32 = 7i32, mut zero: i32 = 0i32;\n"
+    "\n"
+    "q = q / zero;\n"
+  };
+  auto trapped = jit(trap);
+  CHECK(trapped.result.state == vm::status::DivByZero);
+  CHECK(trapped.result.line == 3);
+  CHECK(same(trapped, interpret(trap)));
+
+  // The trap leaves the left operand of `+` pushed.
+  auto nested = test::analyzed {
+    "def mut q: i32 = 7i32, mut zero: i32 = 0i32;\n"
+    "q = q + (q + q / zero);\n"
+  };
+  auto unwound = jit(nested);
+  CHECK(unwound.result.state == vm::status::DivByZero);
+  CHECK(same(unwound, interpret(nested)));
+}
+
+TEST_CASE("jit: runs again from zeroed slots") {
+  auto source = test::analyzed {
+    "def mut n: i64 = 0, mut total: i64 = 0;\n"
+    "while n < 1000 { total += n * n; n += 1; }\n"
+  };
+  auto compiler = codegen::native_compiler { source.types, source.names, source.typing, source.values };
+  auto machine = codegen::jit_machine {
+    compiler.compile_function(source.ast), source.names.symbols().size()
+  };
+  CHECK(machine.code_size() > 0);
+  machine.run();
+  auto first = globals_of(source, machine.slots());
+  machine.run();
+  CHECK(globals_of(source, machine.slots()) == first);
+  CHECK(first == std::vector<std::int64_t> { 1000, 332833500 });
+}
+
+#endif
@@ -0,0 +1,359 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <sys/wait.h>
+
+#include <thalia-ir/builder.hpp>
+#include <thalia-ir/pipeline.hpp>
+#include <thalia-vm/compiler.hpp>
+#include <thalia-vm/machine.hpp>
+#include <thalia-test/frontend.hpp>
+
+#include "thalia-codegen/assembly.hpp"
+#include "thalia-codegen/elf.hpp"
+#include "thalia-codegen/encoder.hpp"
+#include "thalia-codegen/jit.hpp"
+#include "thalia-codegen/lowering.hpp"
+
+using namespace thalia;
+
+namespace {
+  struct execution {
+    int status;
+    std::string output;
+  };
+
+  auto build(test::analyzed const& source, bool optimized)
+    -> ir::module {
+    auto result = ir::builder { source.types, source.names, source.typing }.build_module(source.ast);
+    if (optimized)
+      ir::optimize(result);
+    return result;
+  }
+
+  auto assembly_of(ir::module const& target)
+    -> std::string {
+    auto out = std::ostringstream {};
+    codegen::print_assembly(out, codegen::ir_compiler { target }.compile());
+    return out.str();
+  }
+
+  // What the stack machine prints and exits with, as the reference.
+  auto interpret(test::analyzed const& source)
+    -> execution {
+    auto compiler = vm::compiler { source.types, source.names, source.typing, source.values };
+    auto chunk = compiler.compile(source.ast);
+    auto machine = vm::machine { chunk };
+    auto result = machine.run();
+    if (result.state == vm::status::DivByZero || result.state == vm::status::IndexOutOfRange
+        || result.state == vm::status::StackOverflow) {
+      auto message = result.state == vm::status::DivByZero ? "Division by zero"
+        : result.state == vm::status::IndexOutOfRange ? "Index out of range" : "Stack overflow";
+      return execution { 1, std::string { "[ERROR]: " }.append(message).append("\n    ---> on line ")
+        .append(std::to_string(result.line)).append(".\n") };
+    }
+    auto output = std::string {};
+    for (auto const& global: chunk.globals)
+      output.append(global.name).append(" = ").append(std::to_string(machine.slots()[global.slot])).append("\n");
+    auto status = result.state == vm::status::Returned ? static_cast<int>(result.value) : 0;
+    return execution { status & 0xff, output };
+  }
+
+  auto execute(ir::module const& target)
+    -> execution {
+    auto path = std::filesystem::temp_directory_path() / "thalia-lowering-test";
+    auto program = codegen::ir_compiler { target }.compile();
+    auto start = codegen::add_start(program);
+    {
+      auto out = std::ofstream { path, std::ios::binary };
+      codegen::write_executable(out, codegen::x86::encode(program), start);
+    }
+    std::filesystem::permissions(path, std::filesystem::perms::owner_exec, std::filesystem::perm_options::add);
+
+    auto result = execution { 0, {} };
+    auto* pipe = popen(path.c_str(), "r");
+    REQUIRE(pipe != nullptr);
+    char buffer[256];
+    while (auto read = std::fread(buffer, 1, sizeof(buffer), pipe))
+      result.output.append(buffer, read);
+    result.status = WEXITSTATUS(pclose(pipe));
+    std::filesystem::remove(path);
+    return result;
+  }
+
+  constexpr char const* programs[] = {
+    "def MIN: i32 = 4i32, MAX: i32 = 6i32;\n"
+    "def mut i: i32 = MIN, mut s: i32 = 0i32;\n"
+    "while i <= MAX { s += i; i += 1i32; }\n",
+
+    "def mut a: i8 = 127i8, mut b: i16 = 300i16, mut c: i32 = 1i32;\n"
+    "def mut d: i64 = 9223372036854775807, mut e: i8 = -128i8;\n"
+    "a += 1i8;\n"
+    "b *= b;\n"
+    "c <<= 35i8;\n"
+    "d += 1;\n"
+    "e = -e;\n"
+    "def mut f: i16 = -16i16;\n"
+    "f >>= 2i16;\n"
+    "def mut q: i64 = -9223372036854775807 - 1, mut r: i32 = -7i32, mut m: i8 = -128i8;\n"
+    "q /= -1;\n"
+    "r %= 2i32;\n"
+    "m /= -1i8;\n",
+
+    "def mut calls: i64 = 0, mut x: i64 = 0, mut y: i64 = 0;\n"
+    "0 && (calls = 1);\n"
+    "x = 2 && 3;\n"
+    "y = 0 || (calls += 10) > 5;\n"
+    "def mut n: i32 = 0i32, mut evens: i32 = 0i32;\n"
+    "while n < 10i32 && !(n == 9i32) {\n"
+    "  if n % 2i32 == 0i32 { evens += 1i32; }\n"
+    "  n += 1i32;\n"
+    "}\n"
+    "return 42i32;\n",
+
+    // The phis of the loop read each other on the back edge.
+    "def mut a: i64 = 1, mut b: i64 = 2, mut k: i64 = 0, mut big: i64 = 0;\n"
+    "while k < 5 { def t: i64 = a; a = b; b = t; k += 1; }\n"
+    "big = k * 4294967296 + ~a;\n",
+
+    "def mut q: i32 = 7i32, mut zero: i32 = 0i32;\n"
+    "if q > 0i32 {\n"
+    "  q = q / zero;\n"
+    "}\n",
+
+    // Vector loops leave the last iterations and any trap to the loop.
+    "def mut a: [103]i32, mut b: [103]i32, mut i: i32 = 0i32, mut s: i32 = 7i32, mut k: i32 = -3i32;\n"
+    "while i < 103i32 { b[i] = i * 1000003i32; i += 1i32; }\n"
+    "i = 1i32;\n"
+    "while i < 103i32 { a[i] = (b[i] * b[i] ^ k) - (b[i] >> 3i32); s -= ~a[i]; i += 1i32; }\n"
+    "def mut n: i32 = 90i32, mut m: i32 = -1i32, mut c: [4]i16;\n"
+    "while n > i { m &= a[i] << 1i32; i += 1i32; }\n"
+    "c[2] = 700i16;\n"
+    "while i < 200i32 { s += b[i]; i += 1i32; }\n",
+
+    // More values are live in the loop than there are registers.
+    "def mut a: i64 = 1, mut b: i64 = 2, mut c: i64 = 3, mut d: i64 = 4, mut e: i64 = 5;\n"
+    "def mut f: i64 = 6, mut g: i64 = 7, mut h: i64 = 8, mut i: i64 = 0;\n"
+    "def mut t: i8 = 3i8, mut u: i16 = 9i16, mut k: [16]i8;\n"
+    "while i < 100 {\n"
+    "  a += b * c; b ^= c + d; c -= d * e; d += e ^ f;\n"
+    "  e += f - g; f ^= g * h; g += h + a; h -= a ^ b;\n"
+    "  t = t * 3i8 + 1i8; u -= u >> 1i16;\n"
+    "  k[i & 15] = t; k[(i + 1) & 15] += t ^ 5i8;\n"
+    "  i += 1;\n"
+    "}\n"
+    "t += k[7];\n",
+
+    // Calls keep their caller's registers and nest past the inlining budget.
+    "use fib(n: i64): i64;\n"
+    "global sq(x: i64): i64 { return x * x; }\n"
+    "global clamp(x: i64, top: i64): i64 { if x > top { return top; } return x; }\n"
+    "global fib(n: i64): i64 { if n < 2 { return n; } return fib(n - 1) + fib(n - 2); }\n"
+    "global sum(k: i32): i32 {\n"
+    "  def mut a: [8]i32, mut i: i32 = 0i32, mut s: i32 = 0i32;\n"
+    "  while i < 8i32 { a[i] = k * i; i += 1i32; }\n"
+    "  while i > 0i32 { i -= 1i32; s += a[i]; }\n"
+    "  return s;\n"
+    "}\n"
+    "global skip(x: i64): void { if x > 3 { return; } return skip(x + 1); }\n"
+    "def mut s: i64 = 0, mut i: i64 = 0;\n"
+    "while i < 100 { s += clamp(sq(i), 5000); i += 1; }\n"
+    "def mut f: i64 = fib(20), mut g: i32 = sum(3i32) + sum(-1i32);\n"
+    "skip(0);\n",
+
+    "global down(n: i64): i64 { return down(n + 1) + 1; }\n"
+    "def mut x: i64 = 0;\n"
+    "x = down(x);\n",
+
+    // Returned calls reuse the frame, whatever the arguments they pass.
+    "use pair(a: i64, b: i64): i64;\n"
+    "global spread(a: i64, b: i64, c: i64): i64 { if a == 0 { return b ^ c; } return pair(a - 1, b + c); }\n"
+    "global pair(a: i64, b: i64): i64 { return spread(a, b, a & 7); }\n"
+    "def mut p: i64 = spread(1000000, 1, 2);\n",
+  };
+}
+
+TEST_CASE("lowering: compares fuse with the branches using them") {
+  auto source = test::analyzed { programs[0] };
+  auto text = assembly_of(build(source, false));
+  CHECK(text.find("main:\n") != std::string::npos);
+  CHECK(text.find("\tset") == std::string::npos);
+  CHECK(text.find("\tjg .L") != std::string::npos);
+}
+
+TEST_CASE("lowering: constant propagation leaves less code") {
+  auto source = test::analyzed {
+    "def mut debug: i64 = 0, mut i: i64 = 0, mut s: i64 = 0;\n"
+    "while i < 100 {\n"
+    "  if debug != 0 { s = s / debug; s -= 1; }\n"
+    "  s += i * (1 << 4);\n"
+    "  i += 1;\n"
+    "}\n"
+  };
+  auto plain = codegen::ir_compiler { build(source, false) }.compile();
+  auto optimized = codegen::ir_compiler { build(source, true) }.compile();
+  CHECK(optimized.text.size() < plain.text.size());
+  CHECK(assembly_of(build(source, true)).find("idiv") == std::string::npos);
+}
+
+TEST_CASE("lowering: loops over arrays run in vector registers") {
+  auto source = test::analyzed { programs[5] };
+  auto text = assembly_of(build(source, true));
+  CHECK(text.find("\tmovdqu xmm") != std::string::npos);
+  CHECK(text.find("\tpmuludq ") != std::string::npos);
+  CHECK(text.find("\tpshufd ") != std::string::npos);
+}
+
+TEST_CASE("lowering: loops keep their values in registers") {
+  auto source = test::analyzed {
+    "def mut i: i64 = 0, mut s: i64 = 1, mut x: i64 = 0;\n"
+    "while i < 1000 { s = s * 31 + i; x ^= s; i += 1; }\n"
+  };
+  auto function = build(source, true);
+  auto compiler = codegen::ir_compiler { function };
+  auto out = std::ostringstream {};
+  codegen::print_assembly(out, compiler.compile());
+  auto text = out.str();
+  // The loop runs from its test to the jump back to it.
+  auto start = text.find("\tcmp ");
+  auto end = text.find("\tjmp ", start);
+  REQUIRE(end != std::string::npos);
+  CHECK(text.substr(start, end - start).find("[rbp") == std::string::npos);
+  REQUIRE(compiler.stats().size() == 1);
+  CHECK(compiler.stats()[0].stats.spilled == 0);
+
+  auto crowded = test::analyzed { programs[6] };
+  auto busy = build(crowded, true);
+  auto spilling = codegen::ir_compiler { busy };
+  spilling.compile();
+  CHECK(spilling.stats()[0].stats.spilled > 0);
+  CHECK(spilling.stats()[0].stats.in_registers > 0);
+
+  // Every function compiled out of line reports its own allocation.
+  auto calls = test::analyzed { programs[7] };
+  auto module = build(calls, false);
+  auto callers = codegen::ir_compiler { module };
+  callers.compile();
+  auto names = std::vector<std::string> {};
+  for (auto const& entry: callers.stats())
+    names.push_back(entry.name);
+  CHECK(names.size() == module.functions.size() + 1);
+  CHECK(std::find(names.begin(), names.end(), "fib") != names.end());
+}
+
+TEST_CASE("lowering: runs like the interpreter") {
+#if defined(__x86_64__) && defined(__linux__)
+  for (auto code: programs) {
+    auto source = test::analyzed { code };
+    auto expected = interpret(source);
+    for (auto optimized: { false, true }) {
+      INFO(code << (optimized ? "optimized" : ""));
+      auto run = execute(build(source, optimized));
+      CHECK(run.status == expected.status);
+      CHECK(run.output == expected.output);
+    }
+  }
+#endif
+}
+
+TEST_CASE("lowering: runs in process") {
+#if defined(__x86_64__) && defined(__linux__)
+  auto source = test::analyzed { programs[3] };
+  auto function = build(source, true);
+  auto machine = codegen::jit_machine {
+    codegen::ir_compiler { function }.compile_function(), source.names.symbols().size()
+  };
+  auto result = machine.run();
+  CHECK(result.state == vm::status::Returned);
+  CHECK(result.value == 0);
+  auto slots = machine.slots();
+  CHECK(slots[0] == 2);
+  CHECK(slots[1] == 1);
+  CHECK(slots[3] == 5 * 4294967296 - 3);
+
+  auto trap = test::analyzed { programs[4] };
+  auto trapping = codegen::jit_machine {
+    codegen::ir_compiler { build(trap, true) }.compile_function(), trap.names.symbols().size()
+  };
+  auto trapped = trapping.run();
+  CHECK(trapped.state == vm::status::DivByZero);
+  CHECK(trapped.line == 3);
+#endif
+}
+
+TEST_CASE("lowering: functions out of line are called") {
+  auto source = test::analyzed { programs[7] };
+  auto text = assembly_of(build(source, true));
+  CHECK(text.find("\tcall ") != std::string::npos);
+  CHECK(text.find("\tret") != std::string::npos);
+
+#if defined(__x86_64__) && defined(__linux__)
+  auto deep = test::analyzed { programs[8] };
+  auto machine = codegen::jit_machine {
+    codegen::ir_compiler { build(deep, true) }.compile_function(), deep.names.symbols().size()
+  };
+  auto result = machine.run();
+  CHECK(result.state == vm::status::StackOverflow);
+  CHECK(result.line == 1);
+
+  // A trap deep in the calls gives the host back the registers it keeps.
+  auto busy = test::analyzed {
+    "global step(n: i64, q: i16): i16 {\n"
+    "  def mut k: i64 = 0;\n"
+    "  while k < 4 && (~n != 1) == (n * n & 3 != 0) { k += 1; }\n"
+    "  while k < 8 { (q || q) / (q % q); k += 1; }\n"
+    "  return step(n - 1, -3i16 << 7i16) ^ 3i16;\n"
+    "}\n"
+    "def mut g: i16 = step(4, 3i16);\n"
+  };
+  auto program = codegen::ir_compiler { build(busy, true) }.compile_function();
+  auto out = std::ostringstream {};
+  codegen::print_assembly(out, program);
+  CHECK(out.str().find("\tpush r12\n") < out.str().find("\tcall "));
+  auto trapping = codegen::jit_machine { program, busy.names.symbols().size() };
+  auto trapped = trapping.run();
+  CHECK(trapped.state == vm::status::DivByZero);
+  CHECK(trapped.line == 4);
+#endif
+}
+
+TEST_CASE("lowering: returned calls jump to the callee") {
+  auto source = test::analyzed { programs[9] };
+  auto text = assembly_of(build(source, false));
+  CHECK(text.find("\tret 24\n") != std::string::npos);
+  CHECK(text.find("\tret 16\n") != std::string::npos);
+
+#if defined(__x86_64__) && defined(__linux__)
+  for (auto optimized: { false, true }) {
+    auto machine = codegen::jit_machine {
+      codegen::ir_compiler { build(source, optimized) }.compile_function(), source.names.symbols().size()
+    };
+    CHECK(machine.run().state == vm::status::Returned);
+  }
+#endif
+}
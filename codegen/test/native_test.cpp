@@ -0,0 +1,167 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+#include <sys/wait.h>
+
+#include <thalia-test/frontend.hpp>
+
+#include "thalia-codegen/assembly.hpp"
+#include "thalia-codegen/native.hpp"
+
+using namespace thalia;
+
+namespace {
+  struct execution {
+    int status;
+    std::string output;
+  };
+
+  auto assembly_of(test::analyzed const& source)
+    -> std::string {
+    auto compiler = codegen::native_compiler { source.types, source.names, source.typing, source.values };
+    auto out = std::ostringstream {};
+    codegen::print_assembly(out, compiler.compile(source.ast));
+    return out.str();
+  }
+
+  auto has_compiler()
+    -> bool {
+    return std::system("cc --version > /dev/null 2>&1") == 0;
+  }
+
+  // Assembles, links and runs a program with the system tools.
+  auto execute(test::analyzed const& source)
+    -> execution {
+    auto base = std::filesystem::temp_directory_path() / "thalia-native-test";
+    auto assembly = std::filesystem::path { base }.concat(".s");
+    std::ofstream { assembly } << assembly_of(source);
+
+    auto build = std::string { "cc -o '" }.append(base.string())
+      .append("' '").append(assembly.string()).append("'");
+    REQUIRE(std::system(build.c_str()) == 0);
+
+    auto result = execution { 0, {} };
+    auto* pipe = popen(base.c_str(), "r");
+    REQUIRE(pipe != nullptr);
+    char buffer[256];
+    while (auto read = std::fread(buffer, 1, sizeof(buffer), pipe))
+      result.output.append(buffer, read);
+    result.status = WEXITSTATUS(pclose(pipe));
+    std::filesystem::remove(assembly);
+    std::filesystem::remove(base);
+    return result;
+  }
+}
+
+TEST_CASE("native: conditions compile to direct branches") {
+  auto text = assembly_of(test::analyzed {
+    "def MIN: i32 = 4i32, MAX: i32 = 6i32;\n"
+    "def mut i: i32 = MIN, mut s: i32 = 0i32;\n"
+    "while i <= MAX { s += i; i += 1i32; }\n"
+  });
+  CHECK(text.find("\tmain:") == std::string::npos);
+  CHECK(text.find("main:\n") != std::string::npos);
+  CHECK(text.find("\tcmp rax, 6\n\tjle .L") != std::string::npos);
+  CHECK(text.find("\tadd rax, QWORD PTR [rbp-24]\n\tmovsxd rax, eax\n") != std::string::npos);
+  CHECK(text.find("\tset") == std::string::npos);
+}
+
+TEST_CASE("native: runs like the interpreter") {
+  if (!has_compiler())
+    return;
+
+  auto example = execute(test::analyzed {
+    "def MIN: i32 = 4i32, MAX: i32 = 6i32;\n"
+    "def mut i: i32 = MIN, mut s: i32 = 0i32;\n"
+    "while i <= MAX { s += i; i += 1i32; }\n"
+  });
+  CHECK(example.status == 0);
+  CHECK(example.output == "i = 7\ns = 15\n");
+
+  auto widths = execute(test::analyzed {
+    "def mut a: i8 = 127i8, mut b: i16 = 300i16, mut c: i32 = 1i32;\n"
+    "def mut d: i64 = 9223372036854775807, mut e: i8 = -128i8;\n"
+    "a += 1i8;\n"
+    "b *= b;\n"
+    "c <<= 35i8;\n"
+    "d += 1;\n"
+    "e = -e;\n"
+    "def mut f: i16 = -16i16;\n"
+    "f >>= 2i16;\n"
+    "def mut q: i64 = -9223372036854775807 - 1, mut r: i32 = -7i32, mut m: i8 = -128i8;\n"
+    "q /= -1;\n"
+    "r %= 2i32;\n"
+    "m /= -1i8;\n"
+  });
+  CHECK(widths.output ==
+    "a = -128\nb = 24464\nc = 8\nd = -9223372036854775808\ne = -128\n"
+    "f = -4\nq = -9223372036854775808\nr = -1\nm = -128\n");
+
+  auto logic = execute(test::analyzed {
+    "def mut calls: i64 = 0, mut x: i64 = 0, mut y: i64 = 0;\n"
+    "0 && (calls = 1);\n"
+    "x = 2 && 3;\n"
+    "y = 0 || (calls += 10) > 5;\n"
+    "def mut n: i32 = 0i32, mut evens: i32 = 0i32;\n"
+    "while n < 10i32 && !(n == 9i32) {\n"
+    "  if n % 2i32 == 0i32 { evens += 1i32; }\n"
+    "  n += 1i32;\n"
+    "}\n"
+    "return 42i32;\n"
+  });
+  CHECK(logic.status == 42);
+  CHECK(logic.output == "calls = 10\nx = 1\ny = 1\nn = 9\nevens = 5\n");
+
+  auto trap = execute(test::analyzed {
+    "def mut q: i32 = 7i32, mut zero: i32 = 0i32;\n"
+    "\n"
+    "q = q / zero;\n"
+  });
+  CHECK(trap.status == 1);
+  CHECK(trap.output == "[ERROR]: Division by zero\n    ---> on line 3.\n");
+
+  auto calls = execute(test::analyzed {
+    "use fib(n: i64): i64;\n"
+    "global fib(n: i64): i64 { if n < 2 { return n; } return fib(n - 1) + fib(n - 2); }\n"
+    "global wrap(k: i8): i8 { def mut a: [3]i8; a[1] = k; a[2] = k * k; return a[1] + a[2]; }\n"
+    "def mut x: i64 = fib(15), mut y: i8 = wrap(12i8);\n"
+  });
+  CHECK(calls.output == "x = 610\ny = -100\n");
+  auto deep = execute(test::analyzed {
+    "global down(n: i64): i64 { return down(n + 1) + 1; }\n"
+    "def mut x: i64 = down(0);\n"
+  });
+  CHECK(deep.status == 1);
+  CHECK(deep.output == "[ERROR]: Stack overflow\n    ---> on line 1.\n");
+  auto tails = execute(test::analyzed {
+    "use pair(a: i64, b: i64): i64;\n"
+    "global spread(a: i64, b: i64, c: i64): i64 { if a == 0 { return b ^ c; } return pair(a - 1, b + c); }\n"
+    "global pair(a: i64, b: i64): i64 { return spread(a, b, a & 7); }\n"
+    "def mut p: i64 = spread(1000000, 1, 2);\n"
+  });
+  CHECK(tails.status == 0);
+  CHECK(tails.output == "p = 3500003\n");
+}
@@ -0,0 +1,128 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-vm/compiler.hpp>
+#include <thalia-vm/fusion.hpp>
+#include <thalia-vm/machine.hpp>
+#include <thalia-test/frontend.hpp>
+
+#include "thalia-codegen/tiering.hpp"
+
+#if defined(__x86_64__) && defined(__linux__)
+
+using namespace thalia;
+
+namespace {
+  struct execution {
+    vm::outcome result;
+    std::vector<std::int64_t> slots;
+    std::vector<std::uint64_t> entries;
+  };
+
+  // Runs a program on the fused stack machine, tiering up after `threshold`
+  // iterations if it is not zero.
+  auto execute(test::analyzed const& source, std::uint64_t threshold, std::ostream* trace = nullptr)
+    -> execution {
+    auto compiler = vm::compiler { source.types, source.names, source.typing, source.values };
+    auto chunk = compiler.compile(source.ast);
+    vm::fuse(chunk);
+    auto native = codegen::native_compiler { source.types, source.names, source.typing, source.values };
+    auto tier = codegen::jit_tier { native, compiler.loops(), chunk, { threshold, trace } };
+    auto machine = vm::machine { chunk };
+    if (threshold != 0)
+      machine.attach(tier);
+    auto result = machine.run();
+    auto slots = std::vector<std::int64_t> { machine.slots().begin(), machine.slots().end() };
+    auto entries = std::vector<std::uint64_t> { tier.entries().begin(), tier.entries().end() };
+    return execution { result, slots, entries };
+  }
+
+  auto same(execution const& lhs, execution const& rhs)
+    -> bool {
+    return lhs.result.state == rhs.result.state
+      && lhs.result.value == rhs.result.value
+      && lhs.result.line == rhs.result.line
+      && lhs.slots == rhs.slots;
+  }
+}
+
+TEST_CASE("tiering: loops continue as machine code mid-run") {
+  auto source = test::analyzed {
+    "def mut i: i64 = 0, mut j: i64 = 0, mut acc: i64 = 0;\n"
+    "while i < 300 {\n"
+    "  j = 0;\n"
+    "  while j < 200 { acc += (i * j) % 7; j += 1; }\n"
+    "  i += 1;\n"
+    "}\n"
+    "def mut b: i8 = 0i8, mut n: i32 = 0i32;\n"
+    "while n < 1000i32 { b += 3i8; n += 1i32; }\n"
+  };
+  auto interpreted = execute(source, 0);
+  for (auto threshold: { 1u, 2u, 50u, 1000u }) {
+    auto tiered = execute(source, threshold);
+    CHECK(same(tiered, interpreted));
+  }
+
+  auto tiered = execute(source, 50);
+  CHECK(tiered.entries == std::vector<std::uint64_t> { 1, 49, 1 });
+}
+
+TEST_CASE("tiering: returns and traps leave from compiled loops") {
+  auto returns = test::analyzed {
+    "def mut n: i64 = 0;\n"
+    "while 1 { n += 1; if n == 500 { return 5i32; } }\n"
+  };
+  auto returned = execute(returns, 10);
+  CHECK(returned.result.state == vm::status::Returned);
+  CHECK(returned.result.value == 5);
+  CHECK(same(returned, execute(returns, 0)));
+  CHECK(returned.entries == std::vector<std::uint64_t> { 1 });
+
+  auto traps = test::analyzed {
+    "def mut q: i32 = 7i32, mut k: i32 = 0i32;\n"
+    "while k < 50i32 {\n"
+    "  k += 1i32;\n"
+    "  if k == 40i32 { q = q / (k - 40i32); }\n"
+    "}\n"
+  };
+  auto trapped = execute(traps, 10);
+  CHECK(trapped.result.state == vm::status::DivByZero);
+  CHECK(trapped.result.line == 4);
+  CHECK(same(trapped, execute(traps, 0)));
+}
+
+TEST_CASE("tiering: logs every tier-up") {
+  auto source = test::analyzed {
+    "def mut n: i64 = 0;\n"
+    "while n < 100 { n += 1; }\n"
+  };
+  auto log = std::ostringstream {};
+  execute(source, 10, &log);
+  auto text = log.str();
+  CHECK(text.starts_with("[tiering] loop 0 (line 2) is hot after 10 iterations: compiled "));
+  CHECK(text.find('\n') == text.size() - 1);
+}
+
+#endif
@@ -0,0 +1,118 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-test/frontend.hpp>
+
+#include "thalia-ir/builder.hpp"
+#include "thalia-ir/dead_code.hpp"
+#include "thalia-ir/function.hpp"
+#include "thalia-ir/gvn.hpp"
+#include "thalia-ir/sccp.hpp"
+
+using namespace thalia;
+
+// Every generator is timed at a base size and at `growth` times that size.
+// A linear pass keeps the per-value cost roughly constant, a quadratic one
+// multiplies it by `growth`, so `slack` sits well between the two.
+static constexpr std::size_t growth = 16;
+static constexpr double slack = 4.0;
+static constexpr int samples = 3;
+
+using pass = std::function<void(ir::function&)>;
+
+// The best time per value of a pass, each sample on a fresh copy.
+static auto time_pass(pass const& run, std::string code)
+  -> double {
+  auto source = test::analyzed { std::move(code) };
+  auto built = ir::builder { source.types, source.names, source.typing }.build(source.ast);
+  ir::remove_dead_code(built);
+
+  auto best = std::chrono::nanoseconds::max();
+  for (int i = 0; i < samples; ++i) {
+    auto target = built;
+    auto start = std::chrono::steady_clock::now();
+    run(target);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    best = std::min(best, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed));
+  }
+  return static_cast<double>(best.count()) / static_cast<double>(built.size());
+}
+
+static auto check_linear(
+  pass const& run,
+  std::function<std::string(std::size_t)> const& generate,
+  std::size_t base
+) -> void {
+  auto small_cost = time_pass(run, generate(base));
+  auto large_cost = time_pass(run, generate(base * growth));
+
+  INFO("statements: " << base << " -> " << base * growth);
+  INFO("ns/value: " << small_cost << " -> " << large_cost);
+  CHECK(large_cost <= small_cost * slack);
+}
+
+// One block of statements that all compute the same sums.
+static auto repeated_sums(std::size_t count)
+  -> std::string {
+  auto code = std::string { "def mut a: i64 = 1, mut x: i64 = 0;\n" };
+  for (std::size_t i = 0; i < count; ++i)
+    code += "x += (a + 1) * (a + 1);\n";
+  return code;
+}
+
+// One join whose phis merge different values, each of them twice.
+static auto repeated_phis(std::size_t count)
+  -> std::string {
+  auto code = std::string { "def mut c: i64 = 1;\n" };
+  for (std::size_t i = 0; i < count; ++i)
+    code += "def mut v" + std::to_string(i) + ": i64 = 0, mut w" + std::to_string(i) + ": i64 = 0;\n";
+  code += "if c { c = 0;";
+  for (std::size_t i = 0; i < count; ++i)
+    code += " v" + std::to_string(i) + " = " + std::to_string(i) + "; w" + std::to_string(i) + " = " + std::to_string(i) + ";";
+  return code + " }\n";
+}
+
+TEST_CASE("complexity: gvn over redundant expressions") {
+  check_linear(ir::eliminate_redundancies, repeated_sums, 256);
+}
+
+TEST_CASE("complexity: gvn over redundant phis") {
+  check_linear(ir::eliminate_redundancies, repeated_phis, 64);
+}
+
+// One join whose constant phis are all used by the code after it. Moving
+// a phi among the code only shifts that code, which is cheap, so the sizes
+// are large enough for the shifts to show.
+static auto constant_phis(std::size_t count)
+  -> std::string {
+  auto code = repeated_phis(count);
+  for (std::size_t i = 0; i < count; ++i)
+    code += "c += v" + std::to_string(i) + " * w" + std::to_string(i) + ";\n";
+  return code;
+}
+
+TEST_CASE("complexity: sccp over constant phis") {
+  check_linear(ir::propagate_constants, constant_phis, 2048);
+}
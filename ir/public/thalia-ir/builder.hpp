@@ -0,0 +1,131 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_IR_BUILDER_
+#define _THALIA_IR_BUILDER_
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <thalia-syntax/stmts.hpp>
+#include <thalia-sema/checker.hpp>
+#include <thalia-sema/resolver.hpp>
+#include <thalia-sema/types.hpp>
+
+#include "function.hpp"
+
+namespace thalia::ir {
+  /**
+   * @brief The value an expression of the syntax tree was built into.
+   */
+  struct origin {
+    syntax::expression const* node;
+    value_id value;
+    /**
+     * The divisions and array accesses evaluated with the expression, which
+     * may trap: they are `builder::traps()` from `first_trap` up to
+     * `last_trap`.
+     */
+    std::uint32_t first_trap;
+    std::uint32_t last_trap;
+  };
+
+  /**
+   * @brief Builds SSA form straight from an analyzed syntax tree.
+   *
+   * Variables never reach the IR: every read is answered with the value
+   * last written on the way to it, and phis are placed on the fly, as in
+   * "Simple and Efficient Construction of Static Single Assignment Form"
+   * (Braun et al., 2013). A block is sealed once all of its predecessors
+   * are known; reads in a loop header before that create incomplete phis
+   * that are completed when the back edge is added. Phis that turn out to
+   * merge a single value are removed, so the result is minimal on the
+   * reducible graphs Thalia's control flow produces.
+   *
+   * Nothing is folded: constants and non-`mut` variables become ordinary
+   * values for the passes to work on. Arrays stay in memory, accessed by
+   * `Load` and `Store` in the order the program does. The program must be free of semantic
+   * errors. A function reads its parameters from `Param` and keeps the
+   * variables of its own frame the same way.
+   */
+  class builder {
+    public:
+      /**
+       * @brief Constructs a builder for an analyzed program.
+       * @param types The table the program's types were interned in.
+       * @param names The resolution of the program.
+       * @param typing The types of the program.
+       */
+      builder(
+        sema::type_table const& types,
+        sema::resolution const& names,
+        sema::typing const& typing
+      ) : _types { types }
+        , _names { names }
+        , _typing { typing } {}
+
+      /**
+       * @brief Builds the top-level statements of a program as `main`.
+       * @param ast The top-level statements of the program.
+       * @return The function. Its outputs are the top-level `mut`
+       *   variables, and it returns the exit status as an `i32`.
+       */
+      auto build(std::span<std::shared_ptr<syntax::statement> const> ast)
+        -> function;
+
+      /**
+       * @brief Builds a program along with every function it defines.
+       * @param ast The top-level statements of the program.
+       * @return `main`, as `build` builds it, and the functions, which
+       *   have no outputs. `origins` and `traps` are those of `main`.
+       */
+      auto build_module(std::span<std::shared_ptr<syntax::statement> const> ast)
+        -> module;
+
+      /**
+       * @brief Gets the values the expressions without assignments in them
+       *   were built into by the last call to `build`.
+       *
+       * What the passes prove about these values holds for the expressions
+       * themselves, which is how the backends that work on the syntax tree
+       * benefit from them, as long as nothing in them can trap.
+       */
+      auto origins() const -> std::span<origin const>
+        { return _origins; }
+
+      /**
+       * @brief Gets the divisions and array accesses built by the last call
+       *   to `build`, in the order the expressions containing them were
+       *   built.
+       */
+      auto traps() const -> std::span<value_id const>
+        { return _traps; }
+
+    private:
+      sema::type_table const& _types;
+      sema::resolution const& _names;
+      sema::typing const& _typing;
+      std::vector<origin> _origins;
+      std::vector<value_id> _traps;
+  };
+}
+
+#endif // _THALIA_IR_BUILDER_
@@ -0,0 +1,61 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_IR_DEAD_CODE_
+#define _THALIA_IR_DEAD_CODE_
+
+#include "function.hpp"
+
+namespace thalia::ir {
+  /**
+   * @brief Erases the blocks that cannot be reached from the entry, such as
+   *   the code after a `return`.
+   * @param target The function.
+   * @return Whether anything changed.
+   *
+   * Phis left with a single incoming value are replaced by it.
+   */
+  extern auto remove_unreachable(function& target) -> bool;
+
+  /**
+   * @brief Removes the instructions whose values are never used.
+   * @param target The function.
+   * @return Whether anything changed.
+   *
+   * Only terminators, stores to arrays and the instructions that may trap
+   * are needed for their own sake; everything else is kept only if a needed instruction uses it,
+   * through any number of phis. An assignment whose value is overwritten
+   * or goes out of scope before it is read, or an expression statement
+   * without effects, leaves nothing behind.
+   */
+  extern auto remove_dead_code(function& target) -> bool;
+
+  /**
+   * @brief Simplifies straight-line control flow.
+   * @param target The function.
+   * @return Whether anything changed.
+   *
+   * Blocks that only jump on to a block without phis are bypassed, and a
+   * block is merged into its predecessor when it is that predecessor's only
+   * successor and has no other predecessor.
+   */
+  extern auto merge_blocks(function& target) -> bool;
+}
+
+#endif // _THALIA_IR_DEAD_CODE_
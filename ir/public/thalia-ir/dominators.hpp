@@ -0,0 +1,97 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_IR_DOMINATORS_
+#define _THALIA_IR_DOMINATORS_
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include "function.hpp"
+
+namespace thalia::ir {
+  /**
+   * @brief The dominator tree of the blocks reachable from the entry.
+   *
+   * Computed with the iterative algorithm of Cooper, Harvey and Kennedy over
+   * a reverse postorder, which converges in a couple of passes on the
+   * reducible graphs structured control flow produces. The tree is a
+   * snapshot: it must be computed again once the edges change.
+   */
+  class dominator_tree {
+    public:
+      /**
+       * @brief Computes the dominators of a function.
+       * @param target The function.
+       */
+      explicit dominator_tree(function const& target);
+
+      /**
+       * @brief Gets the reachable blocks in reverse postorder.
+       * @return The blocks, starting with the entry.
+       */
+      auto order() const -> std::span<block_id const>
+        { return _order; }
+
+      /**
+       * @brief Checks whether a block can be reached from the entry.
+       * @param id The block.
+       * @return True if it is reachable.
+       */
+      auto reachable(block_id id) const -> bool
+        { return _rank[id] != none; }
+
+      /**
+       * @brief Gets the immediate dominator of a block.
+       * @param id A reachable block.
+       * @return The immediate dominator, or `none` for the entry.
+       */
+      auto idom(block_id id) const -> block_id
+        { return _idom[id]; }
+
+      /**
+       * @brief Gets the blocks a block immediately dominates.
+       * @param id A reachable block.
+       * @return The children of the block in the tree, in reverse postorder.
+       */
+      auto children(block_id id) const -> std::span<block_id const>
+        { return _children[id]; }
+
+      /**
+       * @brief Checks whether every path from the entry to a block goes
+       *   through another.
+       * @param dominator The block that may dominate.
+       * @param id The block that may be dominated.
+       * @return True if `dominator` dominates `id`; every block dominates
+       *   itself.
+       */
+      auto dominates(block_id dominator, block_id id) const -> bool;
+
+    private:
+      std::vector<block_id> _order;
+      std::vector<std::uint32_t> _rank;
+      std::vector<block_id> _idom;
+      std::vector<std::vector<block_id>> _children;
+      std::vector<std::uint32_t> _enter;
+      std::vector<std::uint32_t> _leave;
+  };
+}
+
+#endif // _THALIA_IR_DOMINATORS_
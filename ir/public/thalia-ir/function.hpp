@@ -0,0 +1,502 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_IR_FUNCTION_
+#define _THALIA_IR_FUNCTION_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Lists every instruction with the name it is printed with.
+ *
+ * Arithmetic wraps to the width of its type. `Div` and `Mod` truncate toward
+ * zero and end the program with a division-by-zero error, on the line held
+ * as their immediate, if the divisor is zero. Shifts take the amount modulo
+ * the width; the amount may be of any type. Comparisons produce 0 or 1 in
+ * the type of their operands.
+ *
+ * `Param` is the argument its immediate indexes, at the top of the entry.
+ * `Array` stands for the array of the function its immediate indexes, as
+ * the first operand of the instructions that access it. `Load` reads the
+ * element at its second operand and `Store` writes its third operand there;
+ * both end the program with an index-out-of-range error, on the line held
+ * as their immediate, if the index is not below the length. `Clear` sets
+ * every element to zero. `Function` likewise stands for the function of
+ * the module its immediate indexes, as the first operand of a `Call`,
+ * which passes the others as arguments; a call ends the program with a
+ * stack overflow, on the line held as its immediate, if its frame does not
+ * fit. The last three instructions are terminators.
+ */
+#define THALIA_IR_OPCODES(X) \
+  X(Const, "const")          \
+  X(Phi, "phi")              \
+  X(Param, "param")          \
+  X(Add, "add")              \
+  X(Sub, "sub")              \
+  X(Mul, "mul")              \
+  X(Div, "div")              \
+  X(Mod, "mod")              \
+  X(Shl, "shl")              \
+  X(Shr, "shr")              \
+  X(And, "and")              \
+  X(Or, "or")                \
+  X(Xor, "xor")              \
+  X(Eq, "eq")                \
+  X(Ne, "ne")                \
+  X(Lt, "lt")                \
+  X(Le, "le")                \
+  X(Gt, "gt")                \
+  X(Ge, "ge")                \
+  X(Neg, "neg")              \
+  X(Not, "not")              \
+  X(Array, "array")          \
+  X(Load, "load")            \
+  X(Store, "store")          \
+  X(Clear, "clear")          \
+  X(Function, "function")    \
+  X(Call, "call")            \
+  X(Jump, "jump")            \
+  X(Branch, "branch")        \
+  X(Return, "return")
+
+namespace thalia::ir {
+  /**
+   * @brief The types of values: the signed integers, or no value at all.
+   */
+  enum class type: std::uint8_t {
+    Void, I8, I16, I32, I64
+  };
+
+  /**
+   * @brief Gets the width of a type.
+   * @param kind The type.
+   * @return The width in bits, or 0 for `Void`.
+   */
+  extern auto width_of(type kind) -> std::size_t;
+
+  /**
+   * @brief Gets the integer type of a width.
+   * @param width The width in bits (8, 16, 32 or 64).
+   * @return The type.
+   */
+  extern auto int_type(std::size_t width) -> type;
+
+  /**
+   * @brief Gets the name of a type (e.g. `i32`).
+   * @param kind The type.
+   * @return The name.
+   */
+  extern auto name_of(type kind) -> std::string_view;
+
+  /**
+   * @brief The instructions of the IR.
+   */
+  enum class opcode: std::uint8_t {
+#define THALIA_IR_ENUM(name, spelling) name,
+    THALIA_IR_OPCODES(THALIA_IR_ENUM)
+#undef THALIA_IR_ENUM
+  };
+
+  /**
+   * @brief Gets the name an instruction is printed with.
+   * @param op The instruction.
+   * @return The name, in lower case.
+   */
+  extern auto name_of(opcode op) -> std::string_view;
+
+  /**
+   * @brief Checks whether an instruction ends a block.
+   * @param op The instruction.
+   * @return True for `Jump`, `Branch` and `Return`.
+   */
+  constexpr auto is_terminator(opcode op) -> bool
+    { return op >= opcode::Jump; }
+
+  /**
+   * @brief Checks whether an instruction takes two operands of its own type.
+   * @param op The instruction.
+   * @return True for arithmetic, bitwise, shift and comparison instructions.
+   */
+  constexpr auto is_binary(opcode op) -> bool
+    { return op >= opcode::Add && op <= opcode::Ge; }
+
+  /**
+   * @brief Checks whether an instruction compares its operands.
+   * @param op The instruction.
+   * @return True for `Eq`, `Ne`, `Lt`, `Le`, `Gt` and `Ge`.
+   */
+  constexpr auto is_compare(opcode op) -> bool
+    { return op >= opcode::Eq && op <= opcode::Ge; }
+
+  /**
+   * @brief Checks whether an instruction reads or writes the elements of
+   *   an array.
+   * @param op The instruction.
+   * @return True for `Load`, `Store` and `Clear`.
+   */
+  constexpr auto is_memory(opcode op) -> bool
+    { return op >= opcode::Load && op <= opcode::Clear; }
+
+  /**
+   * @brief Checks whether an instruction can end the program with an error.
+   * @param op The instruction.
+   * @return True for `Div`, `Mod`, `Load`, `Store` and `Call`.
+   */
+  constexpr auto may_trap(opcode op) -> bool {
+    return op == opcode::Div || op == opcode::Mod || op == opcode::Load || op == opcode::Store
+      || op == opcode::Call;
+  }
+
+  /**
+   * @brief The index of an instruction, which names the value it produces.
+   */
+  using value_id = std::uint32_t;
+
+  /**
+   * @brief The index of a basic block.
+   */
+  using block_id = std::uint32_t;
+
+  /**
+   * @brief The index used for no value and no block.
+   */
+  inline constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+  /**
+   * @brief An instruction and the value it defines.
+   *
+   * The operands are a range of the operand pool of the function.
+   */
+  struct instruction {
+    opcode op;
+    /** The type of the value, or `Void` for terminators. */
+    type kind;
+    /** The block the instruction is in, or `none` once it is removed. */
+    block_id parent;
+    std::uint32_t first;
+    std::uint32_t count;
+    /**
+     * The value of a constant, the index of a parameter, an array or a
+     * function, the line a trapping instruction reports, or the line of
+     * the condition a branch tests.
+     */
+    std::int64_t imm;
+  };
+
+  /**
+   * @brief A basic block: phis, then straight-line code ending in a
+   *   terminator.
+   *
+   * The operands of a phi are in the order of the predecessors of its
+   * block. A `Branch` goes to its first successor when its operand is not
+   * zero and to the second one otherwise.
+   */
+  struct basic_block {
+    std::vector<value_id> phis;
+    std::vector<value_id> code;
+    std::vector<block_id> preds;
+    std::vector<block_id> succs;
+    /** Whether the block was erased; its index stays valid. */
+    bool removed = false;
+  };
+
+  /**
+   * @brief A variable whose final value a function reports when it returns.
+   */
+  struct output {
+    std::string name;
+    type kind;
+    /** The slot of the variable in the resolution of the program. */
+    std::size_t slot;
+  };
+
+  /**
+   * @brief An array of a function, which lives as long as the function
+   *   runs.
+   */
+  struct array {
+    std::string name;
+    /** The type of the elements. */
+    type kind;
+    std::size_t length;
+  };
+
+  /**
+   * @brief A function in SSA form.
+   *
+   * Instructions and operands live in two flat arrays owned by the function
+   * and are named by their index, so building a function takes time and
+   * memory linear in its size and values can be used as indices into side
+   * tables. Removed instructions keep their index. Block 0 is the entry.
+   *
+   * `Return` takes the result of the function unless it is `Void`, then
+   * the final value of every output, in order. The result of `main` is its
+   * status, as an `i32`. A `Return` whose immediate is 1 was written as a
+   * tail call: when it still follows the `Call` whose result it returns,
+   * the backends turn the call into a jump.
+   */
+  class function {
+    public:
+      /**
+       * @brief Constructs a function with no blocks.
+       * @param name The name of the function.
+       * @param result The type of its result.
+       */
+      explicit function(std::string name, type result = type::I32)
+        : _name { std::move(name) }
+        , _result { result } {}
+
+      /**
+       * @brief Gets the name of the function.
+       * @return The name.
+       */
+      auto name() const -> std::string_view
+        { return _name; }
+
+      /**
+       * @brief Gets the type of the result of the function.
+       * @return The type, or `Void` if it returns nothing.
+       */
+      auto result() const -> type
+        { return _result; }
+
+      /**
+       * @brief Gets the types of the parameters `Param` instructions read.
+       * @return The types, in order.
+       */
+      auto params() const -> std::span<type const>
+        { return _params; }
+
+      /**
+       * @brief Adds a parameter to the function.
+       * @param kind Its type.
+       * @return The index of the parameter.
+       */
+      auto add_param(type kind) -> std::size_t
+        { _params.push_back(kind); return _params.size() - 1; }
+
+      /**
+       * @brief Gets the variables reported by every `Return`.
+       * @return The outputs, in order.
+       */
+      auto outputs() const -> std::span<output const>
+        { return _outputs; }
+
+      /**
+       * @brief Adds a variable reported by every `Return`.
+       * @param name The name of the variable.
+       * @param kind Its type.
+       * @param slot Its slot in the resolution of the program.
+       */
+      auto add_output(std::string name, type kind, std::size_t slot) -> void
+        { _outputs.push_back(output { std::move(name), kind, slot }); }
+
+      /**
+       * @brief Gets the arrays `Array` instructions stand for.
+       * @return The arrays, by index.
+       */
+      auto arrays() const -> std::span<array const>
+        { return _arrays; }
+
+      /**
+       * @brief Adds an array to the function.
+       * @param name The name of the array.
+       * @param kind The type of its elements.
+       * @param length The number of elements.
+       * @return The index of the array.
+       */
+      auto add_array(std::string name, type kind, std::size_t length) -> std::size_t
+        { _arrays.push_back(array { std::move(name), kind, length }); return _arrays.size() - 1; }
+
+      /**
+       * @brief Adds an empty block.
+       * @return The new block.
+       */
+      auto add_block() -> block_id;
+
+      /**
+       * @brief Gets the number of blocks ever added.
+       * @return The number of blocks.
+       */
+      auto block_count() const -> std::size_t
+        { return _blocks.size(); }
+
+      auto block(block_id id) -> basic_block&
+        { return _blocks[id]; }
+      auto block(block_id id) const -> basic_block const&
+        { return _blocks[id]; }
+
+      /**
+       * @brief Gets the number of instructions ever added.
+       * @return One past the largest value.
+       */
+      auto size() const -> std::size_t
+        { return _values.size(); }
+
+      auto at(value_id id) -> instruction&
+        { return _values[id]; }
+      auto at(value_id id) const -> instruction const&
+        { return _values[id]; }
+
+      /**
+       * @brief Gets the operands of an instruction.
+       * @param id The instruction.
+       * @return The operands, which may be changed in place.
+       */
+      auto operands(value_id id) -> std::span<value_id>
+        { return { _operands.data() + _values[id].first, _values[id].count }; }
+      auto operands(value_id id) const -> std::span<value_id const>
+        { return { _operands.data() + _values[id].first, _values[id].count }; }
+
+      /**
+       * @brief Creates an instruction that is not in any block yet.
+       * @param op The instruction.
+       * @param kind The type of its value.
+       * @param args The operands.
+       * @param imm The constant or line of the instruction.
+       * @return The new value.
+       */
+      auto make(opcode op, type kind, std::span<value_id const> args, std::int64_t imm = 0)
+        -> value_id;
+
+      /**
+       * @brief Appends an instruction to the code of a block.
+       * @param target The block.
+       * @param op The instruction.
+       * @param kind The type of its value.
+       * @param args The operands.
+       * @param imm The constant or line of the instruction.
+       * @return The new value.
+       */
+      auto append(
+        block_id target,
+        opcode op,
+        type kind,
+        std::span<value_id const> args,
+        std::int64_t imm = 0
+      ) -> value_id;
+
+      /**
+       * @brief Adds a phi with no operands to a block.
+       * @param target The block.
+       * @param kind The type of the phi.
+       * @return The new phi.
+       */
+      auto add_phi(block_id target, type kind) -> value_id;
+
+      /**
+       * @brief Replaces the operands of an instruction.
+       * @param id The instruction.
+       * @param args The new operands, of any number.
+       */
+      auto set_operands(value_id id, std::span<value_id const> args) -> void;
+
+      /**
+       * @brief Adds a control-flow edge, as the last successor of `from` and
+       *   the last predecessor of `to`.
+       * @param from The source block.
+       * @param to The target block.
+       */
+      auto add_edge(block_id from, block_id to) -> void;
+
+      /**
+       * @brief Removes one edge between two blocks, with the operands its
+       *   target's phis take along it.
+       * @param from The source block.
+       * @param to The target block.
+       */
+      auto remove_edge(block_id from, block_id to) -> void;
+
+      /**
+       * @brief Erases a block with its instructions and all of its edges.
+       * @param id The block, which must not be the entry.
+       *
+       * The terminators of its predecessors are left as they are, so they
+       * must be rewritten as well.
+       */
+      auto erase_block(block_id id) -> void;
+
+      /**
+       * @brief Gets the terminator of a block.
+       * @param id The block.
+       * @return The terminator, or `none` if the block has none yet.
+       */
+      auto terminator(block_id id) const -> value_id;
+
+      /**
+       * @brief Takes an instruction out of its block; its index stays valid.
+       * @param id The instruction.
+       */
+      auto remove(value_id id) -> void;
+
+      /**
+       * @brief Rewrites every operand through a forwarding table.
+       * @param forward For every value, the value replacing it, or `none`
+       *   (or itself) to keep it. Chains are followed to their end.
+       */
+      auto replace_uses(std::span<value_id> forward) -> void;
+
+    private:
+      std::string _name;
+      type _result;
+      std::vector<type> _params;
+      std::vector<output> _outputs;
+      std::vector<array> _arrays;
+      std::vector<instruction> _values;
+      std::vector<value_id> _operands;
+      std::vector<basic_block> _blocks;
+  };
+
+  /**
+   * @brief A whole program: `main` and the functions it defines, which
+   *   `Function` instructions index in the order the resolution numbers
+   *   them.
+   */
+  struct module {
+    function main;
+    std::vector<function> functions;
+  };
+
+  /**
+   * @brief Follows a forwarding table to the value that finally replaces
+   *   another, shortening the chain on the way.
+   * @param forward For every value, its replacement or `none`.
+   * @param id The value.
+   * @return The last value of the chain.
+   */
+  extern auto resolve(std::span<value_id> forward, value_id id) -> value_id;
+
+  /**
+   * @brief Checks whether an instruction can trap with the operands it has:
+   *   a division by anything but a constant other than zero, an access at
+   *   anything but a constant index within the array, or any call.
+   * @param target The function.
+   * @param id The instruction.
+   * @return False if it never traps.
+   */
+  extern auto may_trap(function const& target, value_id id) -> bool;
+}
+
+#endif // _THALIA_IR_FUNCTION_
@@ -0,0 +1,46 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef _THALIA_IR_GVN_
+#define _THALIA_IR_GVN_
+
+#include "function.hpp"
+
+namespace thalia::ir {
+  /**
+   * @brief Replaces every computation of a value that is already known on
+   *   all paths to it by the earlier one.
+   * @param target The function.
+   * @return Whether anything changed.
+   *
+   * The blocks are visited down the dominator tree with a table of the
+   * expressions computed in the blocks above, hashed by their operation,
+   * type and operands, so an expression is found again in any block it
+   * dominates: later in the same block, after an `if`, or in a loop.
+   * Operands are put in order for `+`, `*`, `&`, `|`, `^`, `==` and `!=`,
+   * and `>` and `>=` are looked up as `<` and `<=` with their operands
+   * swapped. A division is redundant as well, since the one before it
+   * would have stopped the program already. Phis of the same block that
+   * merge the same values are one, but accesses to arrays are always kept.
+   */
+  extern auto eliminate_redundancies(function& target) -> bool;
+}
+
+#endif // _THALIA_IR_GVN_
@@ -0,0 +1,60 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_IR_INDUCTION_
+#define _THALIA_IR_INDUCTION_
+
+#include <vector>
+
+#include "function.hpp"
+#include "remark.hpp"
+
+namespace thalia::ir {
+  /**
+   * @brief Replaces the loops whose trip count is known by the values they
+   *   leave behind.
+   * @param target The function.
+   * @param log Where to note every loop replaced.
+   * @return Whether anything changed.
+   *
+   * In the spirit of scalar evolution, every value a loop carries is
+   * described as a recurrence over the number of iterations: an induction
+   * variable grows by a constant, an accumulator by an induction variable
+   * or by a value defined before the loop, and a value reset on every
+   * iteration takes what the last one gave it. When the loop only leaves
+   * from its header, on a comparison of an induction variable with a
+   * constant that it reaches without wrapping, the number of iterations is
+   * known, and if nothing in the loop can trap and all of its values are
+   * described, the loop is replaced by the closed forms of its values.
+   * Inner loops go first, so whole nests can fold away.
+   */
+  extern auto eliminate_loops(function& target, std::vector<remark>* log = nullptr) -> bool;
+
+  /**
+   * @brief Replaces multiplications of an induction variable by a value
+   *   that does not change in the loop with a variable of its own, which
+   *   grows by an addition on every iteration.
+   * @param target The function.
+   * @param log Where to note every loop with multiplications replaced.
+   * @return Whether anything changed.
+   */
+  extern auto reduce_strength(function& target, std::vector<remark>* log = nullptr) -> bool;
+}
+
+#endif // _THALIA_IR_INDUCTION_
@@ -0,0 +1,85 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_IR_INLINER_
+#define _THALIA_IR_INLINER_
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "function.hpp"
+#include "remark.hpp"
+
+namespace thalia::ir {
+  /**
+   * @brief The size up to which a callee is inlined at any call: about as
+   *   much work as the call itself does.
+   */
+  inline constexpr std::size_t inline_threshold = 12;
+
+  /**
+   * @brief The size up to which a callee is inlined at its only call,
+   *   where inlining copies nothing.
+   */
+  inline constexpr std::size_t inline_single_limit = 400;
+
+  /**
+   * @brief The size past which nothing more is inlined into a function.
+   */
+  inline constexpr std::size_t inline_growth_limit = 8000;
+
+  /**
+   * @brief Gets the size of a function as the inliner weighs it.
+   * @param target The function.
+   * @return The number of instructions that do work: everything but
+   *   constants, parameters, arrays, functions, phis, jumps and returns.
+   */
+  extern auto inline_cost(function const& target) -> std::size_t;
+
+  /**
+   * @brief Replaces calls to small functions with their bodies, callees
+   *   first.
+   * @param target The module, which must verify. It still does afterwards.
+   * @param log Where the calls inlined are noted, if anywhere.
+   * @param simplify What to run on every function once the calls in it
+   *   are inlined, before it is weighed as a callee itself.
+   * @return Whether anything changed.
+   *
+   * The strongly connected components of the call graph are visited in
+   * reverse topological order, so a function is inlined with the calls in
+   * it already inlined and simplified. Calls within a component, which
+   * recurse, are never inlined, and neither are the calls an inlined body
+   * brings along. A call is inlined when its callee's cost is within a
+   * budget: `inline_threshold`, plus as much again for every argument that
+   * is a constant, since it folds into the body, doubled for every loop
+   * around the call, up to three. A callee with no other call is inlined
+   * up to `inline_single_limit`, since its body then moves rather than
+   * being copied, and no callee is inlined into a function already past
+   * `inline_growth_limit`. Every array of the callee becomes an array of
+   * the caller, and every return a jump to the code after the call.
+   */
+  extern auto inline_calls(
+    module& target,
+    std::vector<remark>* log = nullptr,
+    std::function<void(function&)> const& simplify = {}
+  ) -> bool;
+}
+
+#endif // _THALIA_IR_INLINER_
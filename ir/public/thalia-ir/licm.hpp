@@ -0,0 +1,46 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_IR_LICM_
+#define _THALIA_IR_LICM_
+
+#include "function.hpp"
+
+namespace thalia::ir {
+  /**
+   * @brief Hoists the computations that give the same value on every
+   *   iteration of a loop into its preheader.
+   * @param target The function.
+   * @return Whether anything changed.
+   *
+   * Every loop first gets a preheader. Inner loops are handled before the
+   * loops around them, so a value can move out of several levels at once.
+   * Pure instructions are hoisted as soon as their operands are defined
+   * outside the loop, even from code that only runs on some iterations:
+   * computing them once more costs nothing. A division that may trap is
+   * only hoisted when it is certain to run before the loop can be left,
+   * that is when its block dominates every latch and every block the loop
+   * is left from, and no other division can trap before it. Otherwise,
+   * hoisting it would report an error for a loop that never ran. Accesses
+   * to arrays stay where they are.
+   */
+  extern auto hoist_invariants(function& target) -> bool;
+}
+
+#endif // _THALIA_IR_LICM_
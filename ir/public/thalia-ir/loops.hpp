@@ -0,0 +1,70 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_IR_LOOPS_
+#define _THALIA_IR_LOOPS_
+
+#include <vector>
+
+#include "dominators.hpp"
+#include "function.hpp"
+
+namespace thalia::ir {
+  /**
+   * @brief A natural loop: a header and the blocks that can reach one of the
+   *   edges back to it without leaving it.
+   */
+  struct natural_loop {
+    block_id header;
+    /** The blocks of the loop in reverse postorder, the header first. */
+    std::vector<block_id> blocks;
+    /** The blocks that jump back to the header. */
+    std::vector<block_id> latches;
+    /** The block the loop is always entered from, or `none`. */
+    block_id preheader;
+  };
+
+  /**
+   * @brief Finds the natural loops of a function.
+   * @param target The function.
+   * @param tree The dominators of the function.
+   * @return The loops, every one before the loops that contain it.
+   *
+   * An edge is a back edge when its target dominates its source, so only
+   * reducible loops, which are all structured control flow makes, are
+   * found. Back edges to the same header make up a single loop. A loop has
+   * a preheader when it is only entered from one block, which does nothing
+   * but jump to it.
+   */
+  extern auto find_loops(function const& target, dominator_tree const& tree)
+    -> std::vector<natural_loop>;
+
+  /**
+   * @brief Gives every loop a preheader.
+   * @param target The function.
+   * @return Whether any block was added.
+   *
+   * The edges entering a loop without one are moved to a new block that
+   * jumps to its header; the values they bring to its phis are merged
+   * there first when they differ.
+   */
+  extern auto insert_preheaders(function& target) -> bool;
+}
+
+#endif // _THALIA_IR_LOOPS_
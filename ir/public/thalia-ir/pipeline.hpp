@@ -0,0 +1,45 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_IR_PIPELINE_
+#define _THALIA_IR_PIPELINE_
+
+#include <vector>
+
+#include "function.hpp"
+#include "remark.hpp"
+
+namespace thalia::ir {
+  /**
+   * @brief Runs the optimization passes on a function, in order.
+   * @param target The function, which must verify. It still does afterwards.
+   * @param log Where the passes note what they did, if anywhere.
+   */
+  extern auto optimize(function& target, std::vector<remark>* log = nullptr) -> void;
+
+  /**
+   * @brief Inlines the calls worth it in a module and runs the passes on
+   *   every function, callees first.
+   * @param target The module, which must verify. It still does afterwards.
+   * @param log Where the passes note what they did, if anywhere.
+   */
+  extern auto optimize(module& target, std::vector<remark>* log = nullptr) -> void;
+}
+
+#endif // _THALIA_IR_PIPELINE_
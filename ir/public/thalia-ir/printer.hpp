@@ -0,0 +1,55 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_IR_PRINTER_
+#define _THALIA_IR_PRINTER_
+
+#include <ostream>
+
+#include "function.hpp"
+
+namespace thalia::ir {
+  /**
+   * @brief Prints a function as text, one instruction per line.
+   * @param os The output stream.
+   * @param target The function to print.
+   * @return The output stream.
+   *
+   * Values are numbered `%0`, `%1`, ... in the order they are printed and
+   * blocks keep their index (`b0` is the entry). Every block lists its
+   * predecessors, every phi pairs its operands with the blocks they come
+   * from and every `return` lists the outputs it reports after its result.
+   * A function with parameters or a result other than an `i32` status
+   * prints its signature.
+   */
+  extern auto print(std::ostream& os, function const& target)
+    -> std::ostream&;
+
+  /**
+   * @brief Prints `main`, then every function of a module, with calls
+   *   naming their callees.
+   * @param os The output stream.
+   * @param target The module to print.
+   * @return The output stream.
+   */
+  extern auto print(std::ostream& os, module const& target)
+    -> std::ostream&;
+}
+
+#endif // _THALIA_IR_PRINTER_
@@ -0,0 +1,37 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_IR_REMARK_
+#define _THALIA_IR_REMARK_
+
+#include <cstdint>
+#include <string>
+
+namespace thalia::ir {
+  /**
+   * @brief A note on a change a pass made, for `--opt-report`.
+   */
+  struct remark {
+    /** The line of the loop or statement it is about, or 0 if unknown. */
+    std::int64_t line;
+    std::string message;
+  };
+}
+
+#endif // _THALIA_IR_REMARK_
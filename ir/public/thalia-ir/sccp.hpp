@@ -0,0 +1,113 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_IR_SCCP_
+#define _THALIA_IR_SCCP_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <thalia-sema/consteval.hpp>
+
+#include "builder.hpp"
+#include "function.hpp"
+
+namespace thalia::ir {
+  /**
+   * @brief What sparse conditional constant propagation proves about a
+   *   function.
+   *
+   * Values and edges start out unknown and are only lowered, to constant
+   * and then to varying, as in "Constant Propagation with Conditional
+   * Branches" (Wegman and Zadeck, 1991). A branch on a constant only makes
+   * one of its edges executable, and phis only merge the values that come
+   * in along executable edges, so a constant that holds on every path that
+   * can run is found even across loops. Operations fold with the exact
+   * two's complement semantics of their width; divisions by zero are left
+   * to trap at run time.
+   */
+  class constant_facts {
+    public:
+      /**
+       * @brief Solves the facts of a function.
+       * @param target The function.
+       */
+      explicit constant_facts(function const& target);
+
+      /**
+       * @brief Gets the value an instruction always produces.
+       * @param id The instruction.
+       * @return The value, or nothing if it varies or never runs.
+       */
+      auto value(value_id id) const -> std::optional<std::int64_t>
+        { return _values[id]; }
+
+      /**
+       * @brief Checks whether a block can run.
+       * @param id The block.
+       */
+      auto executable(block_id id) const -> bool
+        { return _executable[id]; }
+
+      /**
+       * @brief Checks whether an edge out of a block can be taken.
+       * @param from The block.
+       * @param index The index of the edge among its successors.
+       */
+      auto taken(block_id from, std::size_t index) const -> bool
+        { return (_taken[from] >> index & 1) != 0; }
+
+    private:
+      std::vector<std::optional<std::int64_t>> _values;
+      std::vector<bool> _executable;
+      std::vector<std::uint8_t> _taken;
+  };
+
+  /**
+   * @brief Rewrites a function with the facts constant propagation proves.
+   * @param target The function.
+   * @return Whether anything changed.
+   *
+   * Constant instructions become `const`, branches with a single executable
+   * edge become jumps, blocks that cannot run are erased and phis left with
+   * a single incoming value are replaced by it.
+   */
+  extern auto propagate_constants(function& target) -> bool;
+
+  /**
+   * @brief Records the expressions proven constant in the table of values
+   *   known at compile time.
+   * @param facts The facts of the function the expressions were built into.
+   * @param built The builder of the function.
+   * @param values The table to fill.
+   * @return The number of expressions recorded.
+   *
+   * An expression whose value is constant may still trap on the way, as in
+   * `x / 0 && 0`; it is only recorded if every division in it is folded.
+   */
+  extern auto export_constants(
+    constant_facts const& facts,
+    builder const& built,
+    sema::constants& values
+  ) -> std::size_t;
+}
+
+#endif // _THALIA_IR_SCCP_
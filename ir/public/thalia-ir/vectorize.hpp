@@ -0,0 +1,91 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_IR_VECTORIZE_
+#define _THALIA_IR_VECTORIZE_
+
+#include <cstddef>
+#include <vector>
+
+#include "function.hpp"
+
+namespace thalia::ir {
+  /**
+   * @brief The number of iterations a vector loop runs at once: four
+   *   32-bit lanes.
+   */
+  inline constexpr std::size_t vector_width = 4;
+
+  /**
+   * @brief The number of values a vector loop may keep in vector registers,
+   *   two fewer than there are, for scratch.
+   */
+  inline constexpr std::size_t vector_values = 14;
+
+  /**
+   * @brief A phi of a vector loop that only folds one value into itself on
+   *   every iteration.
+   */
+  struct reduction {
+    value_id phi;
+    /** The folding instruction: `Add`, `Sub`, `And`, `Or` or `Xor`. */
+    value_id update;
+  };
+
+  /**
+   * @brief A loop that does the same to consecutive elements on every
+   *   iteration, so that several iterations can run at once.
+   */
+  struct vector_loop {
+    block_id header;
+    block_id body;
+    block_id preheader;
+    /** A phi of the header that starts anywhere and steps by one. */
+    value_id counter;
+    /** What the counter is compared with; the loop runs while below it. */
+    value_id bound;
+    std::vector<reduction> reductions;
+    /** The `Array` values of the arrays accessed. */
+    std::vector<value_id> arrays;
+    /** The values defined before the loop that the body uses in lanes. */
+    std::vector<value_id> invariants;
+  };
+
+  /**
+   * @brief Finds the loops that can run several iterations at once.
+   * @param target The function.
+   * @return The loops, which leave the function unchanged.
+   *
+   * A loop qualifies when it is a header testing `counter < bound` and a
+   * single body block, and the body only loads and stores `i32` elements
+   * at the counter, computes on them with additions, subtractions,
+   * multiplications, bitwise operations, negations and shifts by
+   * constants, and folds them into reductions. Nothing else may depend on
+   * the counter, so iterations only meet in the reductions, which are
+   * associative. The bound must not change in the loop.
+   *
+   * Lowered, the loop runs `vector_width` iterations at a time for as long
+   * as all of them are in range of every array and below the bound, then
+   * goes on one at a time from where it stopped: that scalar epilogue
+   * takes the last iterations and reports the errors, in the same order.
+   */
+  extern auto find_vector_loops(function const& target) -> std::vector<vector_loop>;
+}
+
+#endif // _THALIA_IR_VECTORIZE_
@@ -0,0 +1,70 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_IR_VERIFIER_
+#define _THALIA_IR_VERIFIER_
+
+#include <optional>
+#include <string>
+
+#include "function.hpp"
+
+namespace thalia::ir {
+  /**
+   * @brief Why a function is not well formed.
+   */
+  struct verify_error {
+    /** The block of the problem. */
+    block_id block;
+    /** The offending instruction, or `none` for a problem with the block. */
+    value_id value;
+    /** What is wrong. */
+    std::string reason;
+    /** In a module, the index of the function, or `none` for `main`. */
+    std::uint32_t function = none;
+  };
+
+  /**
+   * @brief Proves that a function is well formed SSA.
+   * @param target The function.
+   * @return The first problem found, or nothing if the function is well
+   *   formed.
+   *
+   * In a well-formed function the entry has no predecessors; every block
+   * ends in its only terminator, which has as many successors as it needs,
+   * and the edges agree with the predecessor lists. Every phi has one
+   * operand per predecessor. Operands are placed instructions of the types
+   * their instructions require, and every `return` reports the result and
+   * every output.
+   * In the blocks reachable from the entry, every definition dominates its
+   * uses; a phi operand only needs to dominate the end of its predecessor.
+   */
+  extern auto verify(function const& target) -> std::optional<verify_error>;
+
+  /**
+   * @brief Proves that every function of a module is well formed SSA, and
+   *   that every call passes its callee the arguments it takes.
+   * @param target The module.
+   * @return The first problem found, or nothing if the module is well
+   *   formed.
+   */
+  extern auto verify(module const& target) -> std::optional<verify_error>;
+}
+
+#endif // _THALIA_IR_VERIFIER_
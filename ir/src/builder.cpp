@@ -0,0 +1,674 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <thalia-sema/arith.hpp>
+#include <thalia-sema/locate.hpp>
+#include <thalia-sema/tail_calls.hpp>
+
+#include "thalia-ir/builder.hpp"
+
+namespace thalia::ir {
+  namespace {
+    struct context {
+      sema::type_table const& types;
+      sema::resolution const& names;
+      sema::typing const& typing;
+      function& out;
+      block_id current;
+      std::vector<bool> sealed;
+      // The value of a variable at the end of a block, keyed by block and slot.
+      std::unordered_map<std::uint64_t, value_id> defs;
+      std::vector<std::vector<std::pair<std::size_t, value_id>>> incomplete;
+      // Where every removed phi went.
+      std::vector<value_id> forward;
+      std::array<value_id, 5> zeros;
+      std::vector<std::size_t> outputs;
+      // The `Array` standing for every variable that is an array.
+      std::unordered_map<std::size_t, value_id> arrays;
+      // The `Function` standing for every function called.
+      std::unordered_map<std::size_t, value_id> callees;
+      std::vector<origin>& origins;
+      std::vector<value_id>& traps;
+      // The number of assignments built so far.
+      std::size_t writes;
+      // Whether a returned call is a tail call, as in the body of a function.
+      bool tails;
+    };
+
+    auto type_of(context& ctx, syntax::expression const& node)
+      -> type {
+      return int_type(ctx.types.get(ctx.typing.type_of(node)).width);
+    }
+
+    auto slot_type(context& ctx, std::size_t slot)
+      -> type {
+      return int_type(ctx.types.get(ctx.typing.slot_type(slot)).width);
+    }
+
+    auto forwarding(context& ctx)
+      -> std::span<value_id> {
+      ctx.forward.resize(ctx.out.size(), none);
+      return ctx.forward;
+    }
+
+    auto new_block(context& ctx, bool sealed)
+      -> block_id {
+      ctx.sealed.push_back(sealed);
+      ctx.incomplete.emplace_back();
+      return ctx.out.add_block();
+    }
+
+    auto emit(
+      context& ctx,
+      opcode op,
+      type kind,
+      std::initializer_list<value_id> args,
+      std::int64_t imm = 0
+    ) -> value_id {
+      return ctx.out.append(ctx.current, op, kind, std::span { args.begin(), args.size() }, imm);
+    }
+
+    auto constant(context& ctx, type kind, std::int64_t value)
+      -> value_id {
+      return emit(ctx, opcode::Const, kind, {}, sema::wrap(static_cast<std::uint64_t>(value), width_of(kind)));
+    }
+
+    auto jump(context& ctx, block_id target)
+      -> void {
+      emit(ctx, opcode::Jump, type::Void, {});
+      ctx.out.add_edge(ctx.current, target);
+    }
+
+    auto branch(
+      context& ctx,
+      value_id condition,
+      block_id then,
+      block_id otherwise,
+      std::size_t line = 0
+    ) -> void {
+      emit(ctx, opcode::Branch, type::Void, { condition }, static_cast<std::int64_t>(line));
+      ctx.out.add_edge(ctx.current, then);
+      ctx.out.add_edge(ctx.current, otherwise);
+    }
+
+    // Puts an instruction at the top of the entry, where it is available
+    // to the whole function.
+    auto hoisted(context& ctx, opcode op, type kind, std::int64_t imm)
+      -> value_id {
+      auto result = ctx.out.make(op, kind, {}, imm);
+      ctx.out.at(result).parent = 0;
+      auto& code = ctx.out.block(0).code;
+      code.insert(code.begin(), result);
+      return result;
+    }
+
+    auto callee_of(context& ctx, std::size_t function)
+      -> value_id {
+      auto [found, inserted] = ctx.callees.try_emplace(function, none);
+      if (inserted)
+        found->second = hoisted(ctx, opcode::Function, type::I64, static_cast<std::int64_t>(function));
+      return found->second;
+    }
+
+    auto result_of(sema::type_table const& types, sema::typing const& typing, std::size_t function)
+      -> type {
+      auto const& declared = types.get(typing.signature_of(function).result);
+      return declared.kind == sema::type_kind::Void ? type::Void : int_type(declared.width);
+    }
+
+    // The value of a variable read where it was never written, which only
+    // happens on paths that did not run its declaration: zero, as in a
+    // fresh frame. There is one per type, at the top of the entry.
+    auto zero(context& ctx, type kind)
+      -> value_id {
+      auto& cached = ctx.zeros[static_cast<std::size_t>(kind)];
+      if (cached == none)
+        cached = hoisted(ctx, opcode::Const, kind, 0);
+      return cached;
+    }
+
+    auto key_of(block_id block, std::size_t slot)
+      -> std::uint64_t {
+      return static_cast<std::uint64_t>(block) << 32 | slot;
+    }
+
+    auto write(context& ctx, std::size_t slot, block_id block, value_id value)
+      -> void {
+      ctx.defs[key_of(block, slot)] = value;
+    }
+
+    auto read(context& ctx, std::size_t slot, block_id block) -> value_id;
+
+    // Replaces a phi whose operands are all the same value, or itself, by
+    // that value.
+    auto try_remove_trivial(context& ctx, value_id phi)
+      -> value_id {
+      auto forward = forwarding(ctx);
+      auto same = none;
+      for (auto operand: ctx.out.operands(phi)) {
+        operand = resolve(forward, operand);
+        if (operand == same || operand == phi)
+          continue;
+        if (same != none)
+          return phi;
+        same = operand;
+      }
+      if (same == none)
+        same = zero(ctx, ctx.out.at(phi).kind);
+      forwarding(ctx)[phi] = same;
+      ctx.out.remove(phi);
+      return same;
+    }
+
+    auto add_operands(context& ctx, std::size_t slot, value_id phi)
+      -> value_id {
+      auto args = std::vector<value_id> {};
+      for (auto pred: ctx.out.block(ctx.out.at(phi).parent).preds)
+        args.push_back(read(ctx, slot, pred));
+      ctx.out.set_operands(phi, args);
+      return try_remove_trivial(ctx, phi);
+    }
+
+    auto read_recursive(context& ctx, std::size_t slot, block_id block)
+      -> value_id {
+      auto const& preds = ctx.out.block(block).preds;
+      auto result = none;
+      if (!ctx.sealed[block]) {
+        result = ctx.out.add_phi(block, slot_type(ctx, slot));
+        ctx.incomplete[block].emplace_back(slot, result);
+      } else if (preds.empty()) {
+        result = zero(ctx, slot_type(ctx, slot));
+      } else if (preds.size() == 1) {
+        result = read(ctx, slot, preds.front());
+      } else {
+        // The phi is written first, so reads along a cycle find it.
+        auto phi = ctx.out.add_phi(block, slot_type(ctx, slot));
+        write(ctx, slot, block, phi);
+        result = add_operands(ctx, slot, phi);
+      }
+      write(ctx, slot, block, result);
+      return result;
+    }
+
+    extern auto read(context& ctx, std::size_t slot, block_id block)
+      -> value_id {
+      auto found = ctx.defs.find(key_of(block, slot));
+      if (found != ctx.defs.end())
+        return resolve(forwarding(ctx), found->second);
+      return read_recursive(ctx, slot, block);
+    }
+
+    auto seal(context& ctx, block_id block)
+      -> void {
+      auto pending = std::move(ctx.incomplete[block]);
+      for (auto [slot, phi]: pending)
+        add_operands(ctx, slot, phi);
+      ctx.sealed[block] = true;
+    }
+
+    // Removing a trivial phi can make the phis using it trivial in turn;
+    // they are found by sweeping until nothing changes, then every use is
+    // rewritten once.
+    auto finish(context& ctx)
+      -> void {
+      for (auto changed = true; changed;) {
+        changed = false;
+        for (auto block = block_id { 0 }; block < ctx.out.block_count(); ++block) {
+          auto phis = ctx.out.block(block).phis;
+          for (auto phi: phis)
+            changed |= try_remove_trivial(ctx, phi) != phi;
+        }
+      }
+      ctx.out.replace_uses(forwarding(ctx));
+    }
+
+    auto unwrap(std::shared_ptr<syntax::expression> node)
+      -> std::shared_ptr<syntax::expression> {
+      while (node && node->is(syntax::expr_type::Paren))
+        node = std::static_pointer_cast<syntax::expr_paren>(node)->value();
+      return node;
+    }
+
+    auto opcode_of(syntax::token_type type)
+      -> opcode {
+      switch (type) {
+        case syntax::token_type::Plus: return opcode::Add;
+        case syntax::token_type::Minus: return opcode::Sub;
+        case syntax::token_type::Mul: return opcode::Mul;
+        case syntax::token_type::Div: return opcode::Div;
+        case syntax::token_type::Mod: return opcode::Mod;
+        case syntax::token_type::LShift: return opcode::Shl;
+        case syntax::token_type::RShift: return opcode::Shr;
+        case syntax::token_type::BitAnd: return opcode::And;
+        case syntax::token_type::BitOr: return opcode::Or;
+        case syntax::token_type::Xor: return opcode::Xor;
+        case syntax::token_type::Less: return opcode::Lt;
+        case syntax::token_type::LessEqual: return opcode::Le;
+        case syntax::token_type::Grt: return opcode::Gt;
+        case syntax::token_type::GrtEqual: return opcode::Ge;
+        case syntax::token_type::Equal: return opcode::Eq;
+        default: return opcode::Ne;
+      }
+    }
+
+    auto binary(context& ctx, syntax::token const& operation, syntax::token_type type, value_id lhs, value_id rhs)
+      -> value_id {
+      auto op = opcode_of(type);
+      if (!may_trap(op))
+        return emit(ctx, op, ctx.out.at(lhs).kind, { lhs, rhs });
+      auto result = emit(ctx, op, ctx.out.at(lhs).kind, { lhs, rhs }, static_cast<std::int64_t>(operation.line()));
+      ctx.traps.push_back(result);
+      return result;
+    }
+
+    auto array_of(context& ctx, syntax::expr_index const& node)
+      -> value_id {
+      auto variable = std::static_pointer_cast<syntax::expr_id>(unwrap(node.target()));
+      return ctx.arrays.at(ctx.names.slot(*variable));
+    }
+
+    // Reads or writes an element, which traps on the line of the bracket if
+    // the index is out of range.
+    auto access(
+      context& ctx,
+      opcode op,
+      type kind,
+      std::initializer_list<value_id> args,
+      syntax::expr_index const& node
+    ) -> value_id {
+      auto result = emit(ctx, op, kind, args, static_cast<std::int64_t>(node.bracket().line()));
+      ctx.traps.push_back(result);
+      return result;
+    }
+
+    class expr_builder
+      : public syntax::expr_visitor<context&, value_id> {
+      public:
+        expr_builder(std::shared_ptr<syntax::expression> const& node)
+          : syntax::expr_visitor<context&, value_id> { node } {}
+
+        auto build(context& ctx) -> value_id;
+
+      protected:
+        auto visit_expr_assign(context& ctx) -> value_id override;
+        auto visit_expr_binary(context& ctx) -> value_id override;
+        auto visit_expr_unary(context& ctx) -> value_id override;
+        auto visit_expr_paren(context& ctx) -> value_id override;
+        auto visit_expr_base_lit(context& ctx) -> value_id override;
+        auto visit_expr_id(context& ctx) -> value_id override;
+        auto visit_expr_index(context& ctx) -> value_id override;
+        auto visit_expr_call(context& ctx) -> value_id override;
+        auto visit_expr_data_type(context&) -> value_id override
+          { return none; }
+        auto visit_expr_array_type(context&) -> value_id override
+          { return none; }
+
+      private:
+        auto element_assign(context& ctx) -> value_id;
+    };
+
+    class stmt_builder
+      : public syntax::stmt_visitor<context&, void> {
+      public:
+        stmt_builder(std::shared_ptr<syntax::statement> const& node)
+          : syntax::stmt_visitor<context&, void> { node } {}
+
+        auto build(context& ctx) -> void
+          { if (_node) visit_stmt(ctx); }
+
+      protected:
+        auto visit_stmt_block(context& ctx) -> void override;
+        auto visit_stmt_return(context& ctx) -> void override;
+        auto visit_stmt_expr(context& ctx) -> void override;
+        auto visit_stmt_if(context& ctx) -> void override;
+        auto visit_stmt_while(context& ctx) -> void override;
+        auto visit_stmt_local(context& ctx) -> void override;
+        auto visit_stmt_function(context&) -> void override {}
+    };
+
+    extern auto expr_builder::build(context& ctx)
+      -> value_id {
+      auto writes = ctx.writes;
+      auto first = static_cast<std::uint32_t>(ctx.traps.size());
+      auto result = visit_expr(ctx);
+      if (result != none && ctx.writes == writes) {
+        auto last = static_cast<std::uint32_t>(ctx.traps.size());
+        ctx.origins.push_back(origin { _node.get(), result, first, last });
+      }
+      return result;
+    }
+
+    // The index is evaluated before the value, and the old element is read
+    // before the right-hand side runs.
+    extern auto expr_builder::element_assign(context& ctx)
+      -> value_id {
+      auto root = std::static_pointer_cast<syntax::expr_assign>(_node);
+      auto target = std::static_pointer_cast<syntax::expr_index>(unwrap(root->target()));
+      auto array = array_of(ctx, *target);
+      auto index = expr_builder { target->index() }.build(ctx);
+
+      auto operation = sema::binary_of(root->operation().type());
+      auto result = none;
+      if (operation == syntax::token_type::Assign) {
+        result = expr_builder { root->value() }.build(ctx);
+      } else {
+        auto kind = ctx.out.arrays()[static_cast<std::size_t>(ctx.out.at(array).imm)].kind;
+        auto lhs = access(ctx, opcode::Load, kind, { array, index }, *target);
+        auto rhs = expr_builder { root->value() }.build(ctx);
+        result = binary(ctx, root->operation(), operation, lhs, rhs);
+      }
+      access(ctx, opcode::Store, type::Void, { array, index, result }, *target);
+      return result;
+    }
+
+    extern auto expr_builder::visit_expr_assign(context& ctx)
+      -> value_id {
+      auto root = std::static_pointer_cast<syntax::expr_assign>(_node);
+      ++ctx.writes;
+      if (unwrap(root->target())->is(syntax::expr_type::Index))
+        return element_assign(ctx);
+      auto variable = std::static_pointer_cast<syntax::expr_id>(unwrap(root->target()));
+      auto slot = ctx.names.slot(*variable);
+
+      auto operation = sema::binary_of(root->operation().type());
+      auto result = none;
+      if (operation == syntax::token_type::Assign) {
+        result = expr_builder { root->value() }.build(ctx);
+      } else {
+        // The old value is read before the right-hand side runs.
+        auto lhs = read(ctx, slot, ctx.current);
+        auto rhs = expr_builder { root->value() }.build(ctx);
+        result = binary(ctx, root->operation(), operation, lhs, rhs);
+      }
+      write(ctx, slot, ctx.current, result);
+      return result;
+    }
+
+    extern auto expr_builder::visit_expr_binary(context& ctx)
+      -> value_id {
+      auto root = std::static_pointer_cast<syntax::expr_binary>(_node);
+      auto type = root->operation().type();
+      auto lhs = expr_builder { root->lhs() }.build(ctx);
+      if (type != syntax::token_type::LogAnd && type != syntax::token_type::LogOr) {
+        auto rhs = expr_builder { root->rhs() }.build(ctx);
+        return binary(ctx, root->operation(), type, lhs, rhs);
+      }
+
+      // `a && b` is 0 without evaluating `b` if `a` is, `a || b` is 1 if `a`
+      // is not 0; otherwise both are whether `b` is not 0.
+      auto kind = type_of(ctx, *_node);
+      auto is_and = type == syntax::token_type::LogAnd;
+      auto shortcut = constant(ctx, kind, is_and ? 0 : 1);
+      auto from = ctx.current;
+      auto rest = new_block(ctx, true);
+      auto join = new_block(ctx, false);
+      if (is_and)
+        branch(ctx, lhs, rest, join);
+      else branch(ctx, lhs, join, rest);
+
+      ctx.current = rest;
+      auto rhs = expr_builder { root->rhs() }.build(ctx);
+      auto truth = emit(ctx, opcode::Ne, kind, { rhs, constant(ctx, kind, 0) });
+      jump(ctx, join);
+      seal(ctx, join);
+
+      ctx.current = join;
+      auto result = ctx.out.add_phi(join, kind);
+      auto args = std::vector<value_id> {};
+      for (auto pred: ctx.out.block(join).preds)
+        args.push_back(pred == from ? shortcut : truth);
+      ctx.out.set_operands(result, args);
+      return result;
+    }
+
+    extern auto expr_builder::visit_expr_unary(context& ctx)
+      -> value_id {
+      auto root = std::static_pointer_cast<syntax::expr_unary>(_node);
+      auto value = expr_builder { root->value() }.build(ctx);
+      auto kind = ctx.out.at(value).kind;
+      switch (root->operation().type()) {
+        case syntax::token_type::Minus:
+          return emit(ctx, opcode::Neg, kind, { value });
+        case syntax::token_type::BitNot:
+          return emit(ctx, opcode::Not, kind, { value });
+        case syntax::token_type::LogNot:
+          return emit(ctx, opcode::Eq, kind, { value, constant(ctx, kind, 0) });
+        default:
+          return value;
+      }
+    }
+
+    extern auto expr_builder::visit_expr_paren(context& ctx)
+      -> value_id {
+      auto root = std::static_pointer_cast<syntax::expr_paren>(_node);
+      return expr_builder { root->value() }.build(ctx);
+    }
+
+    extern auto expr_builder::visit_expr_base_lit(context& ctx)
+      -> value_id {
+      auto root = std::static_pointer_cast<syntax::expr_base_lit>(_node);
+      auto kind = type_of(ctx, *_node);
+      return constant(ctx, kind, sema::parse_literal(root->target().value(), width_of(kind)).value);
+    }
+
+    extern auto expr_builder::visit_expr_id(context& ctx)
+      -> value_id {
+      auto root = std::static_pointer_cast<syntax::expr_id>(_node);
+      return read(ctx, ctx.names.slot(*root), ctx.current);
+    }
+
+    extern auto expr_builder::visit_expr_index(context& ctx)
+      -> value_id {
+      auto root = std::static_pointer_cast<syntax::expr_index>(_node);
+      auto array = array_of(ctx, *root);
+      auto index = expr_builder { root->index() }.build(ctx);
+      return access(ctx, opcode::Load, type_of(ctx, *_node), { array, index }, *root);
+    }
+
+    // A call traps on the line of its callee's name if the stack has no
+    // room for its frame.
+    extern auto expr_builder::visit_expr_call(context& ctx)
+      -> value_id {
+      auto root = std::static_pointer_cast<syntax::expr_call>(_node);
+      auto function = ctx.names.callee(*root);
+      auto args = std::vector<value_id> { callee_of(ctx, function) };
+      for (auto const& arg: root->args())
+        args.push_back(expr_builder { arg }.build(ctx));
+      auto result = ctx.out.append(
+        ctx.current, opcode::Call, result_of(ctx.types, ctx.typing, function), args, static_cast<std::int64_t>(root->callee().line())
+      );
+      ctx.traps.push_back(result);
+      return result;
+    }
+
+    extern auto stmt_builder::visit_stmt_block(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_block>(_node);
+      for (auto const& node: root->content())
+        stmt_builder { node }.build(ctx);
+    }
+
+    auto ret(context& ctx, value_id result, bool tail = false)
+      -> void {
+      auto args = std::vector<value_id> {};
+      if (ctx.out.result() != type::Void)
+        args.push_back(result);
+      for (auto slot: ctx.outputs)
+        args.push_back(read(ctx, slot, ctx.current));
+      ctx.out.append(ctx.current, opcode::Return, type::Void, args, tail ? 1 : 0);
+    }
+
+    extern auto stmt_builder::visit_stmt_return(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_return>(_node);
+      auto tail = ctx.tails && sema::tail_call_of(*root) != nullptr;
+      ret(ctx, root->value() ? expr_builder { root->value() }.build(ctx) : none, tail);
+      // Whatever follows is unreachable, and is built into a block of its own.
+      ctx.current = new_block(ctx, true);
+    }
+
+    extern auto stmt_builder::visit_stmt_expr(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_expr>(_node);
+      expr_builder { root->value() }.build(ctx);
+    }
+
+    extern auto stmt_builder::visit_stmt_if(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_if>(_node);
+      auto condition = expr_builder { root->condition() }.build(ctx);
+      auto then = new_block(ctx, true);
+      auto join = new_block(ctx, false);
+      auto otherwise = root->else_body() ? new_block(ctx, true) : join;
+      branch(ctx, condition, then, otherwise, sema::locate(root->condition()).line());
+
+      ctx.current = then;
+      stmt_builder { root->main_body() }.build(ctx);
+      jump(ctx, join);
+      if (root->else_body()) {
+        ctx.current = otherwise;
+        stmt_builder { root->else_body() }.build(ctx);
+        jump(ctx, join);
+      }
+      seal(ctx, join);
+      ctx.current = join;
+    }
+
+    extern auto stmt_builder::visit_stmt_while(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_while>(_node);
+      auto header = new_block(ctx, false);
+      jump(ctx, header);
+
+      ctx.current = header;
+      auto condition = expr_builder { root->condition() }.build(ctx);
+      auto body = new_block(ctx, true);
+      auto exit = new_block(ctx, true);
+      branch(ctx, condition, body, exit, sema::locate(root->condition()).line());
+
+      ctx.current = body;
+      stmt_builder { root->body() }.build(ctx);
+      jump(ctx, header);
+      seal(ctx, header);
+      ctx.current = exit;
+    }
+
+    extern auto stmt_builder::visit_stmt_local(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_local>(_node);
+      for (auto const& variable: root->content()) {
+        auto slot = ctx.names.slot(variable);
+        // Arrays start out zeroed every time their declaration runs.
+        if (auto found = ctx.arrays.find(slot); found != ctx.arrays.end()) {
+          emit(ctx, opcode::Clear, type::Void, { found->second });
+          continue;
+        }
+        auto value = variable.value
+          ? expr_builder { variable.value }.build(ctx)
+          : constant(ctx, slot_type(ctx, slot), 0);
+        write(ctx, slot, ctx.current, value);
+      }
+    }
+  }
+
+  extern auto builder::build(std::span<std::shared_ptr<syntax::statement> const> ast)
+    -> function {
+    auto result = function { "main" };
+    _origins.clear();
+    _traps.clear();
+    auto ctx = context {
+      _types, _names, _typing, result, 0,
+      {}, {}, {}, {}, { none, none, none, none, none }, {}, {}, {}, _origins, _traps, 0, false
+    };
+    ctx.current = new_block(ctx, true);
+
+    auto symbols = _names.symbols();
+    for (auto slot = std::size_t { 0 }; slot < symbols.size(); ++slot) {
+      auto const& symbol = symbols[slot];
+      if (symbol.owner != sema::resolution::npos)
+        continue;
+      auto const& declared = _types.get(_typing.slot_type(slot));
+      if (declared.kind == sema::type_kind::Array) {
+        auto index = result.add_array(std::string { symbol.declaration->id.value() }, int_type(declared.width), declared.length);
+        ctx.arrays.emplace(slot, emit(ctx, opcode::Array, type::I64, {}, static_cast<std::int64_t>(index)));
+        continue;
+      }
+      if (symbol.depth != 0 || symbol.external || !symbol.declaration->mut)
+        continue;
+      ctx.outputs.push_back(slot);
+      result.add_output(std::string { symbol.declaration->id.value() }, slot_type(ctx, slot), slot);
+    }
+
+    for (auto const& node: ast)
+      stmt_builder { node }.build(ctx);
+    ret(ctx, constant(ctx, type::I32, 0));
+    finish(ctx);
+    for (auto& entry: _origins)
+      entry.value = resolve(forwarding(ctx), entry.value);
+    return result;
+  }
+
+  extern auto builder::build_module(std::span<std::shared_ptr<syntax::statement> const> ast)
+    -> module {
+    auto functions = std::vector<function> {};
+    auto defined = _names.functions();
+    for (auto index = std::size_t { 0 }; index < defined.size(); ++index) {
+      auto const& definition = *defined[index].definition;
+      auto origins = std::vector<origin> {};
+      auto traps = std::vector<value_id> {};
+      auto& result = functions.emplace_back(
+        std::string { definition.id().value() }, result_of(_types, _typing, index)
+      );
+      auto ctx = context {
+        _types, _names, _typing, result, 0,
+        {}, {}, {}, {}, { none, none, none, none, none }, {}, {}, {}, origins, traps, 0, true
+      };
+      ctx.current = new_block(ctx, true);
+
+      // The parameters are the first slots of the function, and its
+      // arrays are among the others.
+      auto first = defined[index].first;
+      for (auto i = std::size_t { 0 }; i < definition.params().size(); ++i) {
+        auto param = emit(ctx, opcode::Param, slot_type(ctx, first + i), {}, static_cast<std::int64_t>(i));
+        result.add_param(slot_type(ctx, first + i));
+        write(ctx, first + i, ctx.current, param);
+      }
+      auto symbols = _names.symbols();
+      for (auto slot = first; slot < first + defined[index].count; ++slot) {
+        auto const& declared = _types.get(_typing.slot_type(slot));
+        if (declared.kind != sema::type_kind::Array)
+          continue;
+        auto array = result.add_array(std::string { symbols[slot].declaration->id.value() }, int_type(declared.width), declared.length);
+        ctx.arrays.emplace(slot, emit(ctx, opcode::Array, type::I64, {}, static_cast<std::int64_t>(array)));
+      }
+
+      stmt_builder { definition.body() }.build(ctx);
+      ret(ctx, result.result() == type::Void ? none : constant(ctx, result.result(), 0));
+      finish(ctx);
+    }
+    return module { build(ast), std::move(functions) };
+  }
+}
@@ -0,0 +1,206 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <vector>
+
+#include "thalia-ir/dead_code.hpp"
+
+namespace thalia::ir {
+  namespace {
+    // The only value a phi merges besides itself, or `none` if there are
+    // several.
+    auto single_value(function const& target, std::span<value_id> forward, value_id phi)
+      -> value_id {
+      auto same = none;
+      for (auto arg: target.operands(phi)) {
+        arg = resolve(forward, arg);
+        if (arg == same || arg == phi)
+          continue;
+        if (same != none)
+          return none;
+        same = arg;
+      }
+      return same;
+    }
+
+    // Replacing a phi by its single value can leave another phi with a
+    // single value, so this goes on until none is left.
+    auto forward_single_phis(function& target)
+      -> bool {
+      auto forward = std::vector<value_id>(target.size(), none);
+      auto changed = false;
+      for (auto again = true; again;) {
+        again = false;
+        for (auto id = block_id { 0 }; id < target.block_count(); ++id) {
+          auto single = [&](value_id phi) {
+            auto same = single_value(target, forward, phi);
+            if (same == none)
+              return false;
+            forward[phi] = same;
+            target.at(phi).parent = none;
+            return again = changed = true;
+          };
+          std::erase_if(target.block(id).phis, single);
+        }
+      }
+      if (changed)
+        target.replace_uses(forward);
+      return changed;
+    }
+
+    auto retarget(std::vector<block_id>& edges, block_id from, block_id to)
+      -> void {
+      std::replace(edges.begin(), edges.end(), from, to);
+    }
+
+    // Whether a block does nothing but jump to another block that merges no
+    // values, so that its predecessors can jump there directly.
+    auto is_bypassable(function const& target, block_id id)
+      -> bool {
+      auto const& current = target.block(id);
+      if (id == 0 || current.removed || !current.phis.empty() || current.code.size() != 1)
+        return false;
+      if (target.at(current.code.back()).op != opcode::Jump)
+        return false;
+      auto next = current.succs.front();
+      return next != id && target.block(next).phis.empty();
+    }
+  }
+
+  extern auto remove_unreachable(function& target)
+    -> bool {
+    auto reached = std::vector<bool>(target.block_count(), false);
+    auto work = std::vector<block_id> { 0 };
+    reached[0] = true;
+    while (!work.empty()) {
+      auto id = work.back();
+      work.pop_back();
+      for (auto succ: target.block(id).succs) {
+        if (!reached[succ]) {
+          reached[succ] = true;
+          work.push_back(succ);
+        }
+      }
+    }
+
+    auto changed = false;
+    for (auto id = block_id { 1 }; id < target.block_count(); ++id) {
+      if (!reached[id] && !target.block(id).removed) {
+        target.erase_block(id);
+        changed = true;
+      }
+    }
+    return forward_single_phis(target) || changed;
+  }
+
+  extern auto remove_dead_code(function& target)
+    -> bool {
+    auto live = std::vector<bool>(target.size(), false);
+    auto work = std::vector<value_id> {};
+    auto mark = [&](value_id id) {
+      if (!live[id]) {
+        live[id] = true;
+        work.push_back(id);
+      }
+    };
+
+    for (auto id = block_id { 0 }; id < target.block_count(); ++id) {
+      for (auto value: target.block(id).code) {
+        auto op = target.at(value).op;
+        if (is_terminator(op) || op == opcode::Store || op == opcode::Clear || may_trap(target, value))
+          mark(value);
+      }
+    }
+    while (!work.empty()) {
+      auto id = work.back();
+      work.pop_back();
+      for (auto arg: target.operands(id))
+        mark(arg);
+    }
+
+    auto changed = false;
+    for (auto id = block_id { 0 }; id < target.block_count(); ++id) {
+      auto& current = target.block(id);
+      auto dead = [&](value_id value) {
+        if (live[value])
+          return false;
+        target.at(value).parent = none;
+        return changed = true;
+      };
+      std::erase_if(current.phis, dead);
+      std::erase_if(current.code, dead);
+    }
+    return changed;
+  }
+
+  extern auto merge_blocks(function& target)
+    -> bool {
+    auto changed = false;
+    for (auto id = block_id { 1 }; id < target.block_count(); ++id) {
+      if (!is_bypassable(target, id))
+        continue;
+      auto next = target.block(id).succs.front();
+      for (auto pred: target.block(id).preds) {
+        retarget(target.block(pred).succs, id, next);
+        target.block(next).preds.push_back(pred);
+      }
+      target.block(id).preds.clear();
+      target.erase_block(id);
+      changed = true;
+    }
+
+    auto forward = std::vector<value_id>(target.size(), none);
+    for (auto id = block_id { 0 }; id < target.block_count(); ++id) {
+      while (!target.block(id).removed) {
+        auto last = target.terminator(id);
+        if (last == none || target.at(last).op != opcode::Jump)
+          break;
+        auto next = target.block(id).succs.front();
+        if (next == id || next == 0 || target.block(next).preds.size() != 1)
+          break;
+
+        // With a single predecessor, every phi has a single value.
+        auto& merged = target.block(next);
+        for (auto phi: merged.phis) {
+          forward[phi] = target.operands(phi).front();
+          target.at(phi).parent = none;
+        }
+        // The jump is the last instruction, so it goes without a search.
+        target.block(id).code.pop_back();
+        target.at(last).parent = none;
+        for (auto value: merged.code) {
+          target.at(value).parent = id;
+          target.block(id).code.push_back(value);
+        }
+        for (auto succ: merged.succs)
+          retarget(target.block(succ).preds, next, id);
+        target.block(id).succs = std::move(merged.succs);
+        merged.phis.clear();
+        merged.code.clear();
+        merged.preds.clear();
+        merged.succs.clear();
+        target.erase_block(next);
+        changed = true;
+      }
+    }
+    target.replace_uses(forward);
+    return changed;
+  }
+}
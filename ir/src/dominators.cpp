@@ -0,0 +1,113 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <utility>
+
+#include "thalia-ir/dominators.hpp"
+
+namespace thalia::ir {
+  dominator_tree::dominator_tree(function const& target)
+    : _rank(target.block_count(), none)
+    , _idom(target.block_count(), none)
+    , _children(target.block_count())
+    , _enter(target.block_count(), 0)
+    , _leave(target.block_count(), 0) {
+    if (target.block_count() == 0)
+      return;
+
+    // Postorder, without recursion: a block is finished once all of its
+    // successors are.
+    auto visited = std::vector<bool>(target.block_count(), false);
+    auto stack = std::vector<std::pair<block_id, std::size_t>> { { 0, 0 } };
+    visited[0] = true;
+    while (!stack.empty()) {
+      auto& [id, next] = stack.back();
+      auto const& succs = target.block(id).succs;
+      if (next < succs.size()) {
+        auto succ = succs[next++];
+        if (!visited[succ]) {
+          visited[succ] = true;
+          stack.emplace_back(succ, 0);
+        }
+        continue;
+      }
+      _order.push_back(id);
+      stack.pop_back();
+    }
+    std::reverse(_order.begin(), _order.end());
+    for (auto i = std::size_t { 0 }; i < _order.size(); ++i)
+      _rank[_order[i]] = static_cast<std::uint32_t>(i);
+
+    auto intersect = [&](block_id lhs, block_id rhs) {
+      while (lhs != rhs) {
+        while (_rank[lhs] > _rank[rhs])
+          lhs = _idom[lhs];
+        while (_rank[rhs] > _rank[lhs])
+          rhs = _idom[rhs];
+      }
+      return lhs;
+    };
+
+    _idom[0] = 0;
+    for (auto changed = true; changed;) {
+      changed = false;
+      for (auto id: std::span { _order }.subspan(1)) {
+        auto dominator = none;
+        for (auto pred: target.block(id).preds) {
+          if (_rank[pred] == none || _idom[pred] == none)
+            continue;
+          dominator = dominator == none ? pred : intersect(pred, dominator);
+        }
+        if (dominator != _idom[id]) {
+          _idom[id] = dominator;
+          changed = true;
+        }
+      }
+    }
+    _idom[0] = none;
+
+    for (auto id: std::span { _order }.subspan(1))
+      _children[_idom[id]].push_back(id);
+
+    // Numbers the tree in depth-first order, so dominance is an interval
+    // check.
+    auto counter = std::uint32_t { 0 };
+    auto walk = std::vector<std::pair<block_id, std::size_t>> { { 0, 0 } };
+    _enter[0] = counter++;
+    while (!walk.empty()) {
+      auto& [id, next] = walk.back();
+      if (next < _children[id].size()) {
+        auto child = _children[id][next++];
+        _enter[child] = counter++;
+        walk.emplace_back(child, 0);
+        continue;
+      }
+      _leave[id] = counter++;
+      walk.pop_back();
+    }
+  }
+
+  extern auto dominator_tree::dominates(block_id dominator, block_id id) const
+    -> bool {
+    if (!reachable(dominator) || !reachable(id))
+      return false;
+    return _enter[dominator] <= _enter[id] && _leave[id] <= _leave[dominator];
+  }
+}
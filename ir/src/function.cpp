@@ -0,0 +1,209 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+
+#include "thalia-ir/function.hpp"
+
+namespace thalia::ir {
+  extern auto width_of(type kind)
+    -> std::size_t {
+    switch (kind) {
+      case type::I8: return 8;
+      case type::I16: return 16;
+      case type::I32: return 32;
+      case type::I64: return 64;
+      default: return 0;
+    }
+  }
+
+  extern auto int_type(std::size_t width)
+    -> type {
+    switch (width) {
+      case 8: return type::I8;
+      case 16: return type::I16;
+      case 32: return type::I32;
+      default: return type::I64;
+    }
+  }
+
+  extern auto name_of(type kind)
+    -> std::string_view {
+    static constexpr std::string_view names[] = { "void", "i8", "i16", "i32", "i64" };
+    return names[static_cast<std::uint8_t>(kind)];
+  }
+
+  extern auto name_of(opcode op)
+    -> std::string_view {
+    static constexpr std::string_view names[] = {
+#define THALIA_IR_NAME(name, spelling) spelling,
+      THALIA_IR_OPCODES(THALIA_IR_NAME)
+#undef THALIA_IR_NAME
+    };
+    return names[static_cast<std::uint8_t>(op)];
+  }
+
+  extern auto resolve(std::span<value_id> forward, value_id id)
+    -> value_id {
+    auto last = id;
+    while (forward[last] != none && forward[last] != last)
+      last = forward[last];
+    while (id != last) {
+      auto next = forward[id];
+      forward[id] = last;
+      id = next;
+    }
+    return last;
+  }
+
+  extern auto may_trap(function const& target, value_id id)
+    -> bool {
+    auto const& current = target.at(id);
+    if (!may_trap(current.op))
+      return false;
+    if (current.op == opcode::Call)
+      return true;
+    auto args = target.operands(id);
+    auto const& operand = target.at(args[1]);
+    if (operand.op != opcode::Const)
+      return true;
+    if (current.op == opcode::Div || current.op == opcode::Mod)
+      return operand.imm == 0;
+    auto length = target.arrays()[static_cast<std::size_t>(target.at(args[0]).imm)].length;
+    return operand.imm < 0 || static_cast<std::uint64_t>(operand.imm) >= length;
+  }
+
+  extern auto function::add_block()
+    -> block_id {
+    _blocks.emplace_back();
+    return static_cast<block_id>(_blocks.size() - 1);
+  }
+
+  extern auto function::make(opcode op, type kind, std::span<value_id const> args, std::int64_t imm)
+    -> value_id {
+    auto first = static_cast<std::uint32_t>(_operands.size());
+    _operands.insert(_operands.end(), args.begin(), args.end());
+    _values.push_back(instruction {
+      op, kind, none, first, static_cast<std::uint32_t>(args.size()), imm
+    });
+    return static_cast<value_id>(_values.size() - 1);
+  }
+
+  extern auto function::append(
+    block_id target,
+    opcode op,
+    type kind,
+    std::span<value_id const> args,
+    std::int64_t imm
+  ) -> value_id {
+    auto id = make(op, kind, args, imm);
+    _values[id].parent = target;
+    _blocks[target].code.push_back(id);
+    return id;
+  }
+
+  extern auto function::add_phi(block_id target, type kind)
+    -> value_id {
+    auto id = make(opcode::Phi, kind, {});
+    _values[id].parent = target;
+    _blocks[target].phis.push_back(id);
+    return id;
+  }
+
+  extern auto function::set_operands(value_id id, std::span<value_id const> args)
+    -> void {
+    auto& target = _values[id];
+    if (args.size() <= target.count) {
+      std::copy(args.begin(), args.end(), _operands.begin() + target.first);
+    } else {
+      // The old range is abandoned; the pool only ever grows.
+      target.first = static_cast<std::uint32_t>(_operands.size());
+      _operands.insert(_operands.end(), args.begin(), args.end());
+    }
+    target.count = static_cast<std::uint32_t>(args.size());
+  }
+
+  extern auto function::add_edge(block_id from, block_id to)
+    -> void {
+    _blocks[from].succs.push_back(to);
+    _blocks[to].preds.push_back(from);
+  }
+
+  extern auto function::remove_edge(block_id from, block_id to)
+    -> void {
+    auto& succs = _blocks[from].succs;
+    succs.erase(std::find(succs.begin(), succs.end(), to));
+
+    auto& preds = _blocks[to].preds;
+    auto found = std::find(preds.begin(), preds.end(), from);
+    auto index = static_cast<std::size_t>(found - preds.begin());
+    preds.erase(found);
+    for (auto phi: _blocks[to].phis) {
+      auto& target = _values[phi];
+      if (index >= target.count)
+        continue;
+      auto args = _operands.begin() + target.first;
+      std::copy(args + index + 1, args + target.count, args + index);
+      --target.count;
+    }
+  }
+
+  extern auto function::erase_block(block_id id)
+    -> void {
+    while (!_blocks[id].succs.empty())
+      remove_edge(id, _blocks[id].succs.back());
+    while (!_blocks[id].preds.empty())
+      remove_edge(_blocks[id].preds.back(), id);
+    for (auto value: _blocks[id].phis)
+      _values[value].parent = none;
+    for (auto value: _blocks[id].code)
+      _values[value].parent = none;
+    _blocks[id].phis.clear();
+    _blocks[id].code.clear();
+    _blocks[id].removed = true;
+  }
+
+  extern auto function::terminator(block_id id) const
+    -> value_id {
+    auto const& code = _blocks[id].code;
+    if (code.empty() || !is_terminator(_values[code.back()].op))
+      return none;
+    return code.back();
+  }
+
+  extern auto function::remove(value_id id)
+    -> void {
+    auto& target = _values[id];
+    if (target.parent == none)
+      return;
+    auto& list = target.op == opcode::Phi
+      ? _blocks[target.parent].phis
+      : _blocks[target.parent].code;
+    list.erase(std::find(list.begin(), list.end(), id));
+    target.parent = none;
+  }
+
+  extern auto function::replace_uses(std::span<value_id> forward)
+    -> void {
+    for (auto& operand: _operands) {
+      if (operand != none)
+        operand = resolve(forward, operand);
+    }
+  }
+}
@@ -0,0 +1,191 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "thalia-ir/dominators.hpp"
+#include "thalia-ir/gvn.hpp"
+
+namespace thalia::ir {
+  namespace {
+    // What a pure instruction computes, in a canonical form.
+    struct expression {
+      opcode op;
+      type kind;
+      std::int64_t imm;
+      value_id lhs;
+      value_id rhs;
+
+      auto operator==(expression const& other) const -> bool = default;
+    };
+
+    struct expression_hash {
+      auto operator()(expression const& key) const -> std::size_t {
+        auto result = static_cast<std::uint64_t>(key.op) << 8 | static_cast<std::uint64_t>(key.kind);
+        for (auto part: { static_cast<std::uint64_t>(key.imm), std::uint64_t { key.lhs }, std::uint64_t { key.rhs } })
+          result = (result ^ part) * 0x100000001b3;
+        return static_cast<std::size_t>(result);
+      }
+    };
+
+    // What a phi merges: its block, type and forwarded operands.
+    struct merge {
+      block_id block;
+      type kind;
+      std::vector<value_id> args;
+
+      auto operator==(merge const& other) const -> bool = default;
+    };
+
+    struct merge_hash {
+      auto operator()(merge const& key) const -> std::size_t {
+        auto result = std::uint64_t { key.block } << 8 | static_cast<std::uint64_t>(key.kind);
+        for (auto arg: key.args)
+          result = (result ^ std::uint64_t { arg }) * 0x100000001b3;
+        return static_cast<std::size_t>(result);
+      }
+    };
+
+    struct context {
+      function& target;
+      dominator_tree const& tree;
+      std::vector<value_id> forward;
+      std::unordered_map<expression, value_id, expression_hash> known;
+      std::unordered_map<merge, value_id, merge_hash> merges;
+    };
+
+    auto is_commutative(opcode op)
+      -> bool {
+      switch (op) {
+        case opcode::Add:
+        case opcode::Mul:
+        case opcode::And:
+        case opcode::Or:
+        case opcode::Xor:
+        case opcode::Eq:
+        case opcode::Ne:
+          return true;
+        default:
+          return false;
+      }
+    }
+
+    // The expression of an instruction, or nothing for those whose value
+    // depends on more than their operands.
+    auto expression_of(context& ctx, value_id id)
+      -> std::optional<expression> {
+      auto const& current = ctx.target.at(id);
+      if (is_terminator(current.op) || is_memory(current.op) || current.op == opcode::Phi
+        || current.op == opcode::Call)
+        return std::nullopt;
+      auto args = ctx.target.operands(id);
+      auto key = expression { current.op, current.kind, 0, none, none };
+      // The immediate of a division is only the line it reports.
+      if (current.op == opcode::Const || current.op == opcode::Array || current.op == opcode::Param
+        || current.op == opcode::Function)
+        key.imm = current.imm;
+      if (args.size() > 0)
+        key.lhs = resolve(ctx.forward, args[0]);
+      if (args.size() > 1)
+        key.rhs = resolve(ctx.forward, args[1]);
+      if (current.op == opcode::Gt || current.op == opcode::Ge) {
+        key.op = current.op == opcode::Gt ? opcode::Lt : opcode::Le;
+        std::swap(key.lhs, key.rhs);
+      } else if (is_commutative(current.op) && key.rhs < key.lhs) {
+        std::swap(key.lhs, key.rhs);
+      }
+      return key;
+    }
+
+    // Numbers the values of a block, and notes the expressions it adds to
+    // the table, which only hold in the blocks it dominates.
+    auto number_block(context& ctx, block_id block, std::vector<expression>& added)
+      -> bool {
+      auto& target = ctx.target;
+      auto& current = target.block(block);
+      for (auto phi: current.phis) {
+        auto key = merge { block, target.at(phi).kind, {} };
+        for (auto arg: target.operands(phi))
+          key.args.push_back(resolve(ctx.forward, arg));
+        auto [found, inserted] = ctx.merges.emplace(std::move(key), phi);
+        if (!inserted)
+          ctx.forward[phi] = found->second;
+      }
+
+      for (auto value: current.code) {
+        auto key = expression_of(ctx, value);
+        if (!key)
+          continue;
+        auto [found, inserted] = ctx.known.emplace(*key, value);
+        if (inserted) {
+          added.push_back(*key);
+          continue;
+        }
+        ctx.forward[value] = found->second;
+      }
+
+      // The redundant values are dropped in one pass over each list.
+      auto redundant = [&](value_id value) {
+        if (ctx.forward[value] == none)
+          return false;
+        target.at(value).parent = none;
+        return true;
+      };
+      auto removed = std::erase_if(current.phis, redundant) + std::erase_if(current.code, redundant);
+      return removed != 0;
+    }
+  }
+
+  extern auto eliminate_redundancies(function& target)
+    -> bool {
+    auto tree = dominator_tree { target };
+    auto ctx = context { target, tree, std::vector<value_id>(target.size(), none), {}, {} };
+
+    // Down the tree and back up, without recursion: a block is entered
+    // when it is first popped and left when it is popped again.
+    auto stack = std::vector<std::pair<block_id, bool>> { { 0, false } };
+    auto scopes = std::vector<std::vector<expression>> {};
+    auto changed = false;
+    while (!stack.empty()) {
+      auto [block, done] = stack.back();
+      stack.pop_back();
+      if (done) {
+        for (auto const& key: scopes.back())
+          ctx.known.erase(key);
+        scopes.pop_back();
+        continue;
+      }
+      stack.emplace_back(block, true);
+      scopes.emplace_back();
+      changed = number_block(ctx, block, scopes.back()) || changed;
+      auto children = tree.children(block);
+      for (auto child = children.rbegin(); child != children.rend(); ++child)
+        stack.emplace_back(*child, false);
+    }
+    if (changed)
+      target.replace_uses(ctx.forward);
+    return changed;
+  }
+}
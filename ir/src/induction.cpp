@@ -0,0 +1,597 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include <thalia-sema/arith.hpp>
+
+#include "thalia-ir/dead_code.hpp"
+#include "thalia-ir/dominators.hpp"
+#include "thalia-ir/induction.hpp"
+#include "thalia-ir/loops.hpp"
+
+namespace thalia::ir {
+  namespace {
+    // `scale * symbol + offset + step * k` on iteration `k`, in the modular
+    // arithmetic of the width of the value. The symbol is a value defined
+    // before the loop, or `none`.
+    struct affine {
+      value_id symbol = none;
+      std::uint64_t scale = 0;
+      std::uint64_t offset = 0;
+      std::uint64_t step = 0;
+    };
+
+    // A value in terms of the phi being described: `self` times the phi,
+    // plus an affine rest.
+    struct term {
+      std::uint64_t self = 0;
+      affine rest;
+    };
+
+    // How a phi of the header evolves: it starts as `init`, then either
+    // adds `rest` on every iteration or is reset to it.
+    struct recurrence {
+      value_id init;
+      affine rest;
+      bool reset;
+    };
+
+    struct analysis {
+      function& target;
+      natural_loop const& loop;
+      std::vector<bool> const& inside;
+      std::unordered_map<value_id, recurrence> phis;
+      std::unordered_map<value_id, std::optional<term>> memo;
+      value_id self = none;
+    };
+
+    auto combine(term lhs, term rhs, std::uint64_t sign)
+      -> std::optional<term> {
+      auto& left = lhs.rest;
+      auto const& right = rhs.rest;
+      if (left.symbol != none && right.symbol != none && left.symbol != right.symbol)
+        return std::nullopt;
+      lhs.self += sign * rhs.self;
+      left.symbol = left.symbol != none ? left.symbol : right.symbol;
+      left.scale += sign * right.scale;
+      left.offset += sign * right.offset;
+      left.step += sign * right.step;
+      if (left.scale == 0)
+        left.symbol = none;
+      return lhs;
+    }
+
+    auto scale(term value, std::uint64_t factor)
+      -> term {
+      value.self *= factor;
+      value.rest.scale *= factor;
+      value.rest.offset *= factor;
+      value.rest.step *= factor;
+      if (value.rest.scale == 0)
+        value.rest.symbol = none;
+      return value;
+    }
+
+    auto constant_of(term const& value)
+      -> std::optional<std::uint64_t> {
+      if (value.self != 0 || value.rest.symbol != none || value.rest.step != 0)
+        return std::nullopt;
+      return value.rest.offset;
+    }
+
+    auto is_induction(recurrence const& value)
+      -> bool {
+      return !value.reset && value.rest.symbol == none && value.rest.step == 0;
+    }
+
+    auto expand(analysis& ctx, value_id id)
+      -> std::optional<term>;
+
+    auto expand_instruction(analysis& ctx, value_id id)
+      -> std::optional<term> {
+      auto const& current = ctx.target.at(id);
+      if (id == ctx.self)
+        return term { 1, {} };
+      if (current.op == opcode::Const)
+        return term { 0, { none, 0, static_cast<std::uint64_t>(current.imm), 0 } };
+      // A product replaced earlier is only forwarded to its phi at the end.
+      if (current.parent == none)
+        return std::nullopt;
+      if (!ctx.inside[current.parent])
+        return term { 0, { id, 1, 0, 0 } };
+
+      auto args = ctx.target.operands(id);
+      switch (current.op) {
+        case opcode::Phi: {
+          // Only induction variables are affine on every iteration.
+          auto found = ctx.phis.find(id);
+          if (found == ctx.phis.end() || !is_induction(found->second))
+            return std::nullopt;
+          auto start = expand(ctx, found->second.init);
+          auto step = term { 0, { none, 0, 0, found->second.rest.offset } };
+          return start ? combine(*start, step, 1) : std::nullopt;
+        }
+        case opcode::Add:
+        case opcode::Sub: {
+          auto lhs = expand(ctx, args[0]);
+          auto rhs = expand(ctx, args[1]);
+          if (!lhs || !rhs)
+            return std::nullopt;
+          return combine(*lhs, *rhs, current.op == opcode::Add ? 1 : ~std::uint64_t { 0 });
+        }
+        case opcode::Neg: {
+          auto value = expand(ctx, args[0]);
+          return value ? std::optional { scale(*value, ~std::uint64_t { 0 }) } : std::nullopt;
+        }
+        case opcode::Mul: {
+          auto lhs = expand(ctx, args[0]);
+          auto rhs = expand(ctx, args[1]);
+          if (!lhs || !rhs)
+            return std::nullopt;
+          if (auto factor = constant_of(*rhs))
+            return scale(*lhs, *factor);
+          if (auto factor = constant_of(*lhs))
+            return scale(*rhs, *factor);
+          return std::nullopt;
+        }
+        case opcode::Shl: {
+          auto lhs = expand(ctx, args[0]);
+          auto rhs = expand(ctx, args[1]);
+          auto amount = rhs ? constant_of(*rhs) : std::nullopt;
+          if (!lhs || !amount)
+            return std::nullopt;
+          return scale(*lhs, std::uint64_t { 1 } << (*amount & (width_of(current.kind) - 1)));
+        }
+        default:
+          return std::nullopt;
+      }
+    }
+
+    auto expand(analysis& ctx, value_id id)
+      -> std::optional<term> {
+      auto found = ctx.memo.find(id);
+      if (found != ctx.memo.end())
+        return found->second;
+      auto result = expand_instruction(ctx, id);
+      ctx.memo.emplace(id, result);
+      return result;
+    }
+
+    // Describes the phis of the header that it can, induction variables
+    // first, since the others are described in terms of them.
+    auto describe(analysis& ctx)
+      -> bool {
+      auto const& header = ctx.target.block(ctx.loop.header);
+      auto back = static_cast<std::size_t>(
+        std::find(header.preds.begin(), header.preds.end(), ctx.loop.latches.front()) - header.preds.begin()
+      );
+      for (auto progress = true; progress;) {
+        progress = false;
+        for (auto phi: header.phis) {
+          if (ctx.phis.contains(phi))
+            continue;
+          ctx.self = phi;
+          ctx.memo.clear();
+          auto args = ctx.target.operands(phi);
+          auto next = expand(ctx, args[back]);
+          if (!next || (next->self != 0 && next->self != 1))
+            continue;
+          ctx.phis.emplace(phi, recurrence { args[1 - back], next->rest, next->self == 0 });
+          progress = true;
+        }
+      }
+      ctx.self = none;
+      ctx.memo.clear();
+      return ctx.phis.size() == header.phis.size();
+    }
+
+    auto flip(opcode op)
+      -> opcode {
+      switch (op) {
+        case opcode::Lt: return opcode::Gt;
+        case opcode::Le: return opcode::Ge;
+        case opcode::Gt: return opcode::Lt;
+        case opcode::Ge: return opcode::Le;
+        default: return op;
+      }
+    }
+
+    auto negate(opcode op)
+      -> opcode {
+      switch (op) {
+        case opcode::Eq: return opcode::Ne;
+        case opcode::Ne: return opcode::Eq;
+        case opcode::Lt: return opcode::Ge;
+        case opcode::Le: return opcode::Gt;
+        case opcode::Gt: return opcode::Le;
+        default: return opcode::Lt;
+      }
+    }
+
+    // The first iteration on which `start + step * k <op> bound` fails, if
+    // the counter gets there without wrapping. Distances are taken in
+    // unsigned arithmetic, where they are exact.
+    auto trips(opcode op, std::int64_t start, std::int64_t step, std::int64_t bound, std::size_t width)
+      -> std::optional<std::uint64_t> {
+      auto holds = [&](std::int64_t value) {
+        switch (op) {
+          case opcode::Eq: return value == bound;
+          case opcode::Ne: return value != bound;
+          case opcode::Lt: return value < bound;
+          case opcode::Le: return value <= bound;
+          case opcode::Gt: return value > bound;
+          default: return value >= bound;
+        }
+      };
+      if (!holds(start))
+        return 0;
+      if (step == 0)
+        return std::nullopt;
+
+      auto max = static_cast<std::int64_t>((std::uint64_t { 1 } << (width - 1)) - 1);
+      auto min = -max - 1;
+      auto up = step > 0;
+      auto stride = up ? static_cast<std::uint64_t>(step) : 0 - static_cast<std::uint64_t>(step);
+      auto room = up
+        ? static_cast<std::uint64_t>(max) - static_cast<std::uint64_t>(start)
+        : static_cast<std::uint64_t>(start) - static_cast<std::uint64_t>(min);
+      auto distance = up
+        ? static_cast<std::uint64_t>(bound) - static_cast<std::uint64_t>(start)
+        : static_cast<std::uint64_t>(start) - static_cast<std::uint64_t>(bound);
+
+      auto count = std::uint64_t { 0 };
+      switch (op) {
+        case opcode::Eq:
+          count = 1;
+          break;
+        case opcode::Ne:
+          if ((up ? start > bound : start < bound) || distance % stride != 0)
+            return std::nullopt;
+          count = distance / stride;
+          break;
+        case opcode::Lt:
+        case opcode::Gt:
+          if (up != (op == opcode::Lt))
+            return std::nullopt;
+          count = distance / stride + (distance % stride != 0);
+          break;
+        default:
+          if (up != (op == opcode::Le))
+            return std::nullopt;
+          count = distance / stride + 1;
+          break;
+      }
+      if (count > room / stride)
+        return std::nullopt;
+      return count;
+    }
+
+    // The number of iterations of a loop that only leaves from its header,
+    // on a comparison of an induction variable with a constant.
+    auto trip_count(analysis& ctx)
+      -> std::optional<std::uint64_t> {
+      auto const& target = ctx.target;
+      auto last = target.terminator(ctx.loop.header);
+      if (target.at(last).op != opcode::Branch)
+        return std::nullopt;
+      auto const& succs = target.block(ctx.loop.header).succs;
+      if (ctx.inside[succs[0]] == ctx.inside[succs[1]])
+        return std::nullopt;
+      auto condition = target.operands(last)[0];
+      auto op = target.at(condition).op;
+      if (!is_compare(op) || !ctx.inside[target.at(condition).parent])
+        return std::nullopt;
+
+      auto args = target.operands(condition);
+      auto lhs = expand(ctx, args[0]);
+      auto rhs = expand(ctx, args[1]);
+      if (!lhs || !rhs || lhs->rest.symbol != none || rhs->rest.symbol != none)
+        return std::nullopt;
+      if (lhs->rest.step == 0) {
+        std::swap(lhs, rhs);
+        op = flip(op);
+      }
+      if (rhs->rest.step != 0)
+        return std::nullopt;
+      if (!ctx.inside[succs[0]])
+        op = negate(op);
+
+      auto width = width_of(target.at(args[0]).kind);
+      return trips(
+        op,
+        sema::wrap(lhs->rest.offset, width),
+        sema::wrap(lhs->rest.step, width),
+        sema::wrap(rhs->rest.offset, width),
+        width
+      );
+    }
+
+    // Whether the loop does nothing but compute its values: it leaves from
+    // its header alone, nothing in it traps and it writes no arrays.
+    auto is_closed(analysis const& ctx)
+      -> bool {
+      auto const& target = ctx.target;
+      for (auto id: ctx.loop.blocks) {
+        if (id != ctx.loop.header) {
+          if (target.at(target.terminator(id)).op == opcode::Return)
+            return false;
+          for (auto succ: target.block(id).succs) {
+            if (!ctx.inside[succ])
+              return false;
+          }
+        }
+        for (auto value: target.block(id).code) {
+          if (is_memory(target.at(value).op) || may_trap(target, value))
+            return false;
+        }
+      }
+      return true;
+    }
+
+    // Emits code at the end of a block, before its terminator.
+    struct emitter {
+      function& target;
+      block_id block;
+      type kind;
+
+      auto emit(opcode op, std::span<value_id const> args, std::int64_t imm = 0)
+        -> value_id {
+        auto id = target.make(op, kind, args, imm);
+        target.at(id).parent = block;
+        auto& code = target.block(block).code;
+        code.insert(code.end() - 1, id);
+        return id;
+      }
+
+      auto constant(std::uint64_t value)
+        -> value_id {
+        return emit(opcode::Const, {}, sema::wrap(value, width_of(kind)));
+      }
+
+      // `value * factor`, or `none` when that is always zero.
+      auto scaled(value_id value, std::uint64_t factor)
+        -> value_id {
+        factor = static_cast<std::uint64_t>(sema::wrap(factor, width_of(kind)));
+        if (value == none || factor == 0)
+          return none;
+        if (factor == 1)
+          return value;
+        auto args = std::array { value, constant(factor) };
+        return emit(opcode::Mul, args);
+      }
+
+      // The sum of some values and a constant; constants among the values
+      // are folded into it.
+      auto sum(std::initializer_list<value_id> values, std::uint64_t offset)
+        -> value_id {
+        auto result = none;
+        auto add = [&](value_id value) {
+          auto args = std::array { result, value };
+          result = result == none ? value : emit(opcode::Add, args);
+        };
+        for (auto value: values) {
+          if (value != none && target.at(value).op == opcode::Const)
+            offset += static_cast<std::uint64_t>(target.at(value).imm);
+          else if (value != none)
+            add(value);
+        }
+        if (result == none || sema::wrap(offset, width_of(kind)) != 0)
+          add(constant(offset));
+        return result;
+      }
+    };
+
+    // `count * (count - 1) / 2`, modulo 2^64.
+    auto triangle(std::uint64_t count)
+      -> std::uint64_t {
+      if (count == 0)
+        return 0;
+      return count % 2 == 0 ? count / 2 * (count - 1) : (count - 1) / 2 * count;
+    }
+
+    auto line_of(function const& target, natural_loop const& loop)
+      -> std::int64_t {
+      auto last = target.terminator(loop.header);
+      return target.at(last).op == opcode::Branch ? target.at(last).imm : 0;
+    }
+
+    auto eliminate(analysis& ctx, std::vector<remark>* log)
+      -> bool {
+      if (!is_closed(ctx) || !describe(ctx))
+        return false;
+      auto count = trip_count(ctx);
+      if (!count)
+        return false;
+
+      auto& target = ctx.target;
+      auto header = ctx.loop.header;
+      auto finals = std::vector<std::pair<value_id, value_id>> {};
+      for (auto phi: target.block(header).phis) {
+        auto const& value = ctx.phis.at(phi);
+        auto const& rest = value.rest;
+        auto out = emitter { target, ctx.loop.preheader, target.at(phi).kind };
+        auto result = value.init;
+        if (value.reset && *count > 0)
+          result = out.sum({ out.scaled(rest.symbol, rest.scale) }, rest.offset + rest.step * (*count - 1));
+        else if (!value.reset)
+          result = out.sum(
+            { value.init, out.scaled(rest.symbol, rest.scale * *count) },
+            rest.offset * *count + rest.step * triangle(*count)
+          );
+        finals.emplace_back(phi, result);
+      }
+
+      auto forward = std::vector<value_id>(target.size(), none);
+      for (auto [phi, result]: finals) {
+        forward[phi] = result;
+        target.remove(phi);
+      }
+      target.replace_uses(forward);
+
+      // The test fails on the values the loop leaves behind, so it is left
+      // straight away.
+      auto last = target.terminator(header);
+      if (log) {
+        log->push_back(remark {
+          line_of(target, ctx.loop),
+          "loop runs " + std::to_string(*count) + " times; replaced by its final values"
+        });
+      }
+      auto const& succs = target.block(header).succs;
+      target.remove_edge(header, ctx.inside[succs[0]] ? succs[0] : succs[1]);
+      target.at(last).op = opcode::Jump;
+      target.set_operands(last, {});
+      return true;
+    }
+
+    auto reduce(analysis& ctx, std::vector<std::pair<value_id, value_id>>& replaced)
+      -> std::size_t {
+      auto& target = ctx.target;
+      auto const& loop = ctx.loop;
+      describe(ctx);
+      auto count = std::size_t { 0 };
+      auto invariant = [&](value_id id) {
+        auto parent = target.at(id).parent;
+        return target.at(id).op == opcode::Const || (parent != none && !ctx.inside[parent]);
+      };
+      for (auto id: loop.blocks) {
+        auto code = target.block(id).code;
+        for (auto value: code) {
+          if (target.at(value).op != opcode::Mul)
+            continue;
+          auto kind = target.at(value).kind;
+          auto width = width_of(kind);
+          auto args = target.operands(value);
+          auto factor = args[1];
+          auto counter = expand(ctx, args[0]);
+          if (!counter || sema::wrap(counter->rest.step, width) == 0 || !invariant(factor)) {
+            factor = args[0];
+            counter = expand(ctx, args[1]);
+          }
+          if (!counter || sema::wrap(counter->rest.step, width) == 0 || !invariant(factor))
+            continue;
+
+          // The product starts at the first value of the counter times the
+          // factor, and grows by its step times the factor.
+          auto const& rest = counter->rest;
+          auto before = emitter { target, loop.preheader, kind };
+          auto start = none;
+          auto step = none;
+          if (target.at(factor).op == opcode::Const) {
+            auto constant = static_cast<std::uint64_t>(target.at(factor).imm);
+            start = before.sum({ before.scaled(rest.symbol, rest.scale * constant) }, rest.offset * constant);
+            step = before.constant(rest.step * constant);
+          } else {
+            auto product = none;
+            if (rest.symbol != none) {
+              auto pair = std::array { rest.symbol, factor };
+              product = before.scaled(before.emit(opcode::Mul, pair), rest.scale);
+            }
+            start = before.sum({ product, before.scaled(factor, rest.offset) }, 0);
+            step = before.scaled(factor, rest.step);
+          }
+
+          auto phi = target.add_phi(loop.header, kind);
+          auto latch = emitter { target, loop.latches.front(), kind };
+          auto pair = std::array { phi, step };
+          auto next = latch.emit(opcode::Add, pair);
+          auto incoming = std::vector<value_id> {};
+          for (auto pred: target.block(loop.header).preds)
+            incoming.push_back(pred == loop.preheader ? start : next);
+          target.set_operands(phi, incoming);
+          target.remove(value);
+          replaced.emplace_back(value, phi);
+          ++count;
+        }
+      }
+      return count;
+    }
+  }
+
+  extern auto eliminate_loops(function& target, std::vector<remark>* log)
+    -> bool {
+    auto changed = insert_preheaders(target);
+    for (auto again = true; again;) {
+      again = false;
+      auto tree = dominator_tree { target };
+      auto loops = find_loops(target, tree);
+      auto inside = std::vector<bool>(target.block_count(), false);
+      // The blocks of the loops handled in this round: a loop around one of
+      // them waits for the next round, when it is either gone or known to
+      // stay, which keeps the loop around it too.
+      auto nested = std::vector<bool>(target.block_count(), false);
+      for (auto const& loop: loops) {
+        auto blocked = std::any_of(loop.blocks.begin(), loop.blocks.end(), [&](block_id id) {
+          return nested[id];
+        });
+        if (!blocked && loop.preheader != none && loop.latches.size() == 1) {
+          for (auto id: loop.blocks)
+            inside[id] = true;
+          auto ctx = analysis { target, loop, inside, {}, {}, none };
+          again = eliminate(ctx, log) || again;
+          for (auto id: loop.blocks)
+            inside[id] = false;
+        }
+        for (auto id: loop.blocks)
+          nested[id] = true;
+      }
+      if (again) {
+        remove_unreachable(target);
+        changed = true;
+      }
+    }
+    return changed;
+  }
+
+  extern auto reduce_strength(function& target, std::vector<remark>* log)
+    -> bool {
+    auto changed = insert_preheaders(target);
+    auto tree = dominator_tree { target };
+    auto loops = find_loops(target, tree);
+    auto inside = std::vector<bool>(target.block_count(), false);
+    auto replaced = std::vector<std::pair<value_id, value_id>> {};
+    for (auto const& loop: loops) {
+      if (loop.preheader == none || loop.latches.size() != 1)
+        continue;
+      for (auto id: loop.blocks)
+        inside[id] = true;
+      auto ctx = analysis { target, loop, inside, {}, {}, none };
+      if (auto count = reduce(ctx, replaced); count > 0 && log) {
+        log->push_back(remark {
+          line_of(target, loop),
+          std::to_string(count) + (count == 1 ? " multiplication" : " multiplications")
+            + " by an induction variable replaced by additions"
+        });
+      }
+      for (auto id: loop.blocks)
+        inside[id] = false;
+    }
+
+    auto forward = std::vector<value_id>(target.size(), none);
+    for (auto [value, phi]: replaced)
+      forward[value] = phi;
+    target.replace_uses(forward);
+    return changed || !replaced.empty();
+  }
+}
@@ -0,0 +1,288 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include "thalia-ir/dominators.hpp"
+#include "thalia-ir/inliner.hpp"
+#include "thalia-ir/loops.hpp"
+
+namespace thalia::ir {
+  namespace {
+    // Finds the strongly connected components of the call graph, where
+    // `main` is the node after the functions.
+    struct call_graph {
+      std::vector<std::vector<std::size_t>> callees;
+      std::vector<std::size_t> index;
+      std::vector<std::size_t> low;
+      std::vector<bool> on_stack;
+      std::vector<std::size_t> stack;
+      std::size_t next = 0;
+      // Every component after those it calls into.
+      std::vector<std::vector<std::size_t>> components;
+    };
+
+    auto callee_of(function const& target, value_id call)
+      -> std::size_t {
+      return static_cast<std::size_t>(target.at(target.operands(call)[0]).imm);
+    }
+
+    auto calls_of(function const& target)
+      -> std::vector<value_id> {
+      auto result = std::vector<value_id> {};
+      for (auto id = block_id { 0 }; id < target.block_count(); ++id) {
+        for (auto value: target.block(id).code) {
+          if (target.at(value).op == opcode::Call)
+            result.push_back(value);
+        }
+      }
+      return result;
+    }
+
+    auto connect(call_graph& graph, std::size_t node)
+      -> void {
+      graph.index[node] = graph.low[node] = graph.next++;
+      graph.stack.push_back(node);
+      graph.on_stack[node] = true;
+      for (auto callee: graph.callees[node]) {
+        if (graph.index[callee] == none) {
+          connect(graph, callee);
+          graph.low[node] = std::min(graph.low[node], graph.low[callee]);
+        } else if (graph.on_stack[callee]) {
+          graph.low[node] = std::min(graph.low[node], graph.index[callee]);
+        }
+      }
+      if (graph.low[node] != graph.index[node])
+        return;
+      auto& component = graph.components.emplace_back();
+      auto member = none;
+      do {
+        member = graph.stack.back();
+        graph.stack.pop_back();
+        graph.on_stack[member] = false;
+        component.push_back(member);
+      } while (member != node);
+    }
+
+    // How many loops every call of a function is in.
+    auto loop_depths(function const& target)
+      -> std::vector<std::size_t> {
+      auto tree = dominator_tree { target };
+      auto blocks = std::vector<std::size_t>(target.block_count(), 0);
+      for (auto const& loop: find_loops(target, tree)) {
+        for (auto id: loop.blocks)
+          ++blocks[id];
+      }
+      auto result = std::vector<std::size_t>(target.size(), 0);
+      for (auto call: calls_of(target))
+        result[call] = blocks[target.at(call).parent];
+      return result;
+    }
+
+    // Splits the block of a call after it and copies the body of the
+    // callee in between, with its parameters replaced by the arguments.
+    auto inline_call(function& caller, value_id call, function const& callee)
+      -> void {
+      auto block = caller.at(call).parent;
+      auto args = std::vector<value_id> {};
+      for (auto arg: caller.operands(call).subspan(1))
+        args.push_back(arg);
+
+      auto after = caller.add_block();
+      auto& code = caller.block(block).code;
+      auto position = std::find(code.begin(), code.end(), call) - code.begin();
+      caller.remove(call);
+      for (auto i = static_cast<std::size_t>(position); i < code.size(); ++i) {
+        caller.at(code[i]).parent = after;
+        caller.block(after).code.push_back(code[i]);
+      }
+      code.resize(static_cast<std::size_t>(position));
+      caller.block(after).succs = std::move(caller.block(block).succs);
+      caller.block(block).succs.clear();
+      for (auto succ: caller.block(after).succs)
+        std::replace(caller.block(succ).preds.begin(), caller.block(succ).preds.end(), block, after);
+
+      auto first = caller.arrays().size();
+      for (auto const& array: callee.arrays())
+        caller.add_array(std::string { callee.name() } + "." + array.name, array.kind, array.length);
+
+      auto blocks = std::vector<block_id>(callee.block_count(), none);
+      for (auto id = block_id { 0 }; id < callee.block_count(); ++id) {
+        if (!callee.block(id).removed)
+          blocks[id] = caller.add_block();
+      }
+      auto values = std::vector<value_id>(callee.size(), none);
+      auto copies = std::vector<std::pair<value_id, value_id>> {};
+      auto returns = std::vector<value_id> {};
+      for (auto id = block_id { 0 }; id < callee.block_count(); ++id) {
+        if (blocks[id] == none)
+          continue;
+        for (auto phi: callee.block(id).phis) {
+          values[phi] = caller.add_phi(blocks[id], callee.at(phi).kind);
+          copies.emplace_back(phi, values[phi]);
+        }
+        for (auto value: callee.block(id).code) {
+          auto const& current = callee.at(value);
+          if (current.op == opcode::Param) {
+            values[value] = args[static_cast<std::size_t>(current.imm)];
+          } else if (current.op == opcode::Return) {
+            caller.append(blocks[id], opcode::Jump, type::Void, {});
+            caller.block(blocks[id]).succs.push_back(after);
+            caller.block(after).preds.push_back(blocks[id]);
+            if (callee.result() != type::Void)
+              returns.push_back(callee.operands(value)[0]);
+          } else {
+            auto imm = current.op == opcode::Array
+              ? current.imm + static_cast<std::int64_t>(first)
+              : current.imm;
+            values[value] = caller.append(blocks[id], current.op, current.kind, callee.operands(value), imm);
+            copies.emplace_back(value, values[value]);
+          }
+        }
+        for (auto pred: callee.block(id).preds)
+          caller.block(blocks[id]).preds.push_back(blocks[pred]);
+        for (auto succ: callee.block(id).succs)
+          caller.block(blocks[id]).succs.push_back(blocks[succ]);
+      }
+      auto mapped = std::vector<value_id> {};
+      for (auto [original, copy]: copies) {
+        mapped.clear();
+        for (auto arg: callee.operands(original))
+          mapped.push_back(values[arg]);
+        caller.set_operands(copy, mapped);
+      }
+
+      caller.append(block, opcode::Jump, type::Void, {});
+      caller.add_edge(block, blocks[0]);
+      if (callee.result() == type::Void)
+        return;
+      auto result = none;
+      if (returns.size() == 1) {
+        result = values[returns[0]];
+      } else if (returns.empty()) {
+        // The callee never returns, so nothing after the call runs.
+        result = caller.make(opcode::Const, callee.result(), {}, 0);
+        caller.at(result).parent = after;
+        caller.block(after).code.insert(caller.block(after).code.begin(), result);
+      } else {
+        result = caller.add_phi(after, callee.result());
+        mapped.clear();
+        for (auto value: returns)
+          mapped.push_back(values[value]);
+        caller.set_operands(result, mapped);
+      }
+      auto forward = std::vector<value_id>(caller.size(), none);
+      forward[call] = result;
+      caller.replace_uses(forward);
+    }
+  }
+
+  extern auto inline_cost(function const& target)
+    -> std::size_t {
+    auto result = std::size_t { 0 };
+    for (auto id = block_id { 0 }; id < target.block_count(); ++id) {
+      for (auto value: target.block(id).code) {
+        switch (target.at(value).op) {
+          case opcode::Const:
+          case opcode::Param:
+          case opcode::Array:
+          case opcode::Function:
+          case opcode::Jump:
+          case opcode::Return:
+            break;
+          default:
+            ++result;
+        }
+      }
+    }
+    return result;
+  }
+
+  extern auto inline_calls(
+    module& target,
+    std::vector<remark>* log,
+    std::function<void(function&)> const& simplify
+  ) -> bool {
+    auto count = target.functions.size();
+    auto node = [&](std::size_t index) -> function&
+      { return index == count ? target.main : target.functions[index]; };
+
+    auto graph = call_graph {
+      std::vector<std::vector<std::size_t>>(count + 1),
+      std::vector<std::size_t>(count + 1, none),
+      std::vector<std::size_t>(count + 1, 0),
+      std::vector<bool>(count + 1, false),
+      {}, 0, {}
+    };
+    auto sites = std::vector<std::size_t>(count, 0);
+    for (auto index = std::size_t { 0 }; index <= count; ++index) {
+      for (auto call: calls_of(node(index))) {
+        auto callee = callee_of(node(index), call);
+        graph.callees[index].push_back(callee);
+        ++sites[callee];
+      }
+    }
+    for (auto index = std::size_t { 0 }; index <= count; ++index) {
+      if (graph.index[index] == none)
+        connect(graph, index);
+    }
+    auto component_of = std::vector<std::size_t>(count + 1, 0);
+    for (auto i = std::size_t { 0 }; i < graph.components.size(); ++i) {
+      for (auto member: graph.components[i])
+        component_of[member] = i;
+    }
+
+    auto changed = false;
+    for (auto const& component: graph.components) {
+      for (auto index: component) {
+        auto& caller = node(index);
+        auto depths = loop_depths(caller);
+        for (auto call: calls_of(caller)) {
+          auto callee_index = callee_of(caller, call);
+          if (component_of[callee_index] == component_of[index])
+            continue;
+          if (inline_cost(caller) > inline_growth_limit)
+            break;
+          auto const& callee = target.functions[callee_index];
+          auto constants = std::size_t { 0 };
+          for (auto arg: caller.operands(call).subspan(1))
+            constants += caller.at(arg).op == opcode::Const ? 1 : 0;
+          auto budget = (inline_threshold * (constants + 1)) << std::min<std::size_t>(depths[call], 3);
+          auto cost = inline_cost(callee);
+          if (cost > budget && (sites[callee_index] != 1 || cost > inline_single_limit))
+            continue;
+
+          for (auto nested: calls_of(callee))
+            ++sites[callee_of(callee, nested)];
+          --sites[callee_index];
+          auto line = caller.at(call).imm;
+          inline_call(caller, call, callee);
+          changed = true;
+          if (log)
+            log->push_back(remark { line, "call to " + std::string { callee.name() } + " inlined" });
+        }
+        if (simplify)
+          simplify(caller);
+      }
+    }
+    return changed;
+  }
+}
@@ -0,0 +1,140 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <optional>
+#include <vector>
+
+#include "thalia-ir/dominators.hpp"
+#include "thalia-ir/licm.hpp"
+#include "thalia-ir/loops.hpp"
+
+namespace thalia::ir {
+  namespace {
+    struct context {
+      function& target;
+      dominator_tree const& tree;
+      natural_loop const& loop;
+      std::vector<bool> const& inside;
+      // The headers of the loops handled before, among which those nested
+      // in this one.
+      std::vector<bool> const& nested;
+      // The blocks that are left from, by an edge or a return.
+      std::vector<block_id> exits;
+    };
+
+    auto is_invariant(context const& ctx, value_id id)
+      -> bool {
+      auto const& args = ctx.target.operands(id);
+      return std::all_of(args.begin(), args.end(), [&](value_id arg) {
+        return !ctx.inside[ctx.target.at(arg).parent];
+      });
+    }
+
+    // Whether a block runs on every iteration before the loop can be left,
+    // with nothing that may trap running before it.
+    auto is_guaranteed(context const& ctx, block_id block)
+      -> bool {
+      if (ctx.exits.empty())
+        return false;
+      auto dominated = [&](block_id id) { return ctx.tree.dominates(block, id); };
+      if (!std::all_of(ctx.loop.latches.begin(), ctx.loop.latches.end(), dominated))
+        return false;
+      if (!std::all_of(ctx.exits.begin(), ctx.exits.end(), dominated))
+        return false;
+
+      // The blocks it does not dominate run before it, and must neither
+      // trap nor loop on their own.
+      for (auto id: ctx.loop.blocks) {
+        if (dominated(id))
+          continue;
+        if (ctx.nested[id])
+          return false;
+        for (auto value: ctx.target.block(id).code) {
+          if (may_trap(ctx.target, value))
+            return false;
+        }
+      }
+      return true;
+    }
+
+    auto hoist_loop(context& ctx)
+      -> bool {
+      auto& target = ctx.target;
+      auto preheader = ctx.loop.preheader;
+      auto moved = std::vector<value_id> {};
+      for (auto id: ctx.loop.blocks) {
+        auto guaranteed = std::optional<bool> {};
+        auto trapped = false;
+        auto kept = std::vector<value_id> {};
+        for (auto value: target.block(id).code) {
+          auto op = target.at(value).op;
+          // Elements may change on any iteration, so accesses stay.
+          auto hoist = !is_terminator(op) && !is_memory(op) && is_invariant(ctx, value);
+          if (hoist && may_trap(target, value)) {
+            if (!guaranteed)
+              guaranteed = is_guaranteed(ctx, id);
+            hoist = *guaranteed && !trapped;
+          }
+          if (!hoist) {
+            trapped = trapped || may_trap(target, value);
+            kept.push_back(value);
+            continue;
+          }
+          target.at(value).parent = preheader;
+          moved.push_back(value);
+        }
+        target.block(id).code = std::move(kept);
+      }
+
+      auto& code = target.block(preheader).code;
+      code.insert(code.end() - 1, moved.begin(), moved.end());
+      return !moved.empty();
+    }
+  }
+
+  extern auto hoist_invariants(function& target)
+    -> bool {
+    auto changed = insert_preheaders(target);
+    auto tree = dominator_tree { target };
+    auto loops = find_loops(target, tree);
+    auto inside = std::vector<bool>(target.block_count(), false);
+    auto nested = std::vector<bool>(target.block_count(), false);
+    for (auto const& loop: loops) {
+      if (loop.preheader == none)
+        continue;
+      auto ctx = context { target, tree, loop, inside, nested, {} };
+      for (auto id: loop.blocks)
+        inside[id] = true;
+      for (auto id: loop.blocks) {
+        auto const& succs = target.block(id).succs;
+        auto leaves = std::any_of(succs.begin(), succs.end(), [&](block_id succ) {
+          return !inside[succ];
+        });
+        if (leaves || target.at(target.terminator(id)).op == opcode::Return)
+          ctx.exits.push_back(id);
+      }
+      changed = hoist_loop(ctx) || changed;
+      for (auto id: loop.blocks)
+        inside[id] = false;
+      nested[loop.header] = true;
+    }
+    return changed;
+  }
+}
@@ -0,0 +1,145 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+
+#include "thalia-ir/loops.hpp"
+
+namespace thalia::ir {
+  namespace {
+    auto is_back_edge(dominator_tree const& tree, block_id from, block_id to)
+      -> bool {
+      return tree.dominates(to, from);
+    }
+
+    // The block every entry into a loop comes from, if it only jumps there.
+    auto preheader_of(function const& target, dominator_tree const& tree, block_id header)
+      -> block_id {
+      auto result = none;
+      for (auto pred: target.block(header).preds) {
+        if (is_back_edge(tree, pred, header))
+          continue;
+        if (result != none && result != pred)
+          return none;
+        result = pred;
+      }
+      if (result == none || target.block(result).succs.size() != 1)
+        return none;
+      return result;
+    }
+
+    auto add_preheader(function& target, dominator_tree const& tree, block_id header)
+      -> void {
+      auto preheader = target.add_block();
+      auto preds = target.block(header).preds;
+      auto inside = std::vector<block_id> {};
+      for (auto pred: preds) {
+        if (is_back_edge(tree, pred, header)) {
+          inside.push_back(pred);
+          continue;
+        }
+        target.block(preheader).preds.push_back(pred);
+        auto& succs = target.block(pred).succs;
+        std::replace(succs.begin(), succs.end(), header, preheader);
+      }
+
+      // Each phi keeps its operands along back edges and takes one more
+      // from the preheader, which merges the others if it needs to.
+      auto phis = target.block(header).phis;
+      for (auto phi: phis) {
+        auto args = target.operands(phi);
+        auto kept = std::vector<value_id> {};
+        auto entering = std::vector<value_id> {};
+        for (auto i = std::size_t { 0 }; i < preds.size(); ++i)
+          (is_back_edge(tree, preds[i], header) ? kept : entering).push_back(args[i]);
+        auto value = entering.front();
+        if (std::any_of(entering.begin(), entering.end(), [&](value_id arg) { return arg != value; })) {
+          value = target.add_phi(preheader, target.at(phi).kind);
+          target.set_operands(value, entering);
+        }
+        kept.push_back(value);
+        target.set_operands(phi, kept);
+      }
+
+      target.block(header).preds = std::move(inside);
+      target.append(preheader, opcode::Jump, type::Void, {});
+      target.add_edge(preheader, header);
+    }
+  }
+
+  extern auto find_loops(function const& target, dominator_tree const& tree)
+    -> std::vector<natural_loop> {
+    auto result = std::vector<natural_loop> {};
+    auto member = std::vector<bool>(target.block_count(), false);
+    auto order = tree.order();
+    for (auto header: order) {
+      auto loop = natural_loop { header, {}, {}, none };
+      for (auto pred: target.block(header).preds) {
+        if (is_back_edge(tree, pred, header))
+          loop.latches.push_back(pred);
+      }
+      if (loop.latches.empty())
+        continue;
+
+      // Walks backwards from the latches; the header stops the walk, since
+      // it dominates every block of the loop.
+      std::fill(member.begin(), member.end(), false);
+      member[header] = true;
+      auto work = loop.latches;
+      while (!work.empty()) {
+        auto id = work.back();
+        work.pop_back();
+        if (member[id])
+          continue;
+        member[id] = true;
+        for (auto pred: target.block(id).preds) {
+          if (tree.reachable(pred) && !member[pred])
+            work.push_back(pred);
+        }
+      }
+      for (auto id: order) {
+        if (member[id])
+          loop.blocks.push_back(id);
+      }
+      loop.preheader = preheader_of(target, tree, header);
+      result.push_back(std::move(loop));
+    }
+
+    // An inner loop is strictly smaller than the loops containing it.
+    std::stable_sort(result.begin(), result.end(), [](auto const& lhs, auto const& rhs) {
+      return lhs.blocks.size() < rhs.blocks.size();
+    });
+    return result;
+  }
+
+  extern auto insert_preheaders(function& target)
+    -> bool {
+    auto tree = dominator_tree { target };
+    auto headers = std::vector<block_id> {};
+    for (auto const& loop: find_loops(target, tree)) {
+      if (loop.preheader == none)
+        headers.push_back(loop.header);
+    }
+    // Only the edges into these headers change, so the tree stays valid
+    // for the edges that are checked.
+    for (auto header: headers)
+      add_preheader(target, tree, header);
+    return !headers.empty();
+  }
+}
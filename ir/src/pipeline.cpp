@@ -0,0 +1,68 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <string>
+
+#include "thalia-ir/dead_code.hpp"
+#include "thalia-ir/gvn.hpp"
+#include "thalia-ir/induction.hpp"
+#include "thalia-ir/inliner.hpp"
+#include "thalia-ir/licm.hpp"
+#include "thalia-ir/pipeline.hpp"
+#include "thalia-ir/sccp.hpp"
+#include "thalia-ir/vectorize.hpp"
+
+namespace thalia::ir {
+  extern auto optimize(function& target, std::vector<remark>* log)
+    -> void {
+    remove_unreachable(target);
+    propagate_constants(target);
+    remove_dead_code(target);
+    merge_blocks(target);
+    // New preheaders merge back into the blocks that only jumped to them.
+    if (hoist_invariants(target))
+      merge_blocks(target);
+    // Hoisted values meet their copies from before the loops.
+    eliminate_redundancies(target);
+    // The values a replaced loop leaves behind are often constants.
+    if (eliminate_loops(target, log)) {
+      propagate_constants(target);
+      remove_dead_code(target);
+      merge_blocks(target);
+    }
+    if (reduce_strength(target, log)) {
+      remove_dead_code(target);
+      merge_blocks(target);
+    }
+    // Vector loops are left to the backend, which only needs to find them.
+    if (log) {
+      for (auto const& loop: find_vector_loops(target)) {
+        log->push_back(remark {
+          target.at(target.terminator(loop.header)).imm,
+          "loop runs " + std::to_string(vector_width) + " iterations at a time in vector registers"
+        });
+      }
+    }
+  }
+
+  extern auto optimize(module& target, std::vector<remark>* log)
+    -> void {
+    inline_calls(target, log, [&](function& current) { optimize(current, log); });
+  }
+}
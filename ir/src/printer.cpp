@@ -0,0 +1,182 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <span>
+#include <vector>
+
+#include "thalia-ir/printer.hpp"
+
+namespace thalia::ir {
+  namespace {
+    struct printer {
+      std::ostream& os;
+      function const& target;
+      std::vector<std::uint32_t> numbers;
+      // The functions `Function` instructions name, if known.
+      std::span<function const> callees;
+
+      auto value(value_id id) -> void {
+        if (id >= numbers.size() || numbers[id] == none)
+          os << "%?";
+        else os << '%' << numbers[id];
+      }
+
+      auto block(block_id id) -> void {
+        os << 'b' << id;
+      }
+
+      auto instruction(value_id id) -> void {
+        auto const& current = target.at(id);
+        auto args = target.operands(id);
+        os << "  ";
+        if (current.kind != type::Void) {
+          value(id);
+          os << " = ";
+        }
+        os << name_of(current.op);
+        if (current.kind != type::Void)
+          os << ' ' << name_of(current.kind);
+
+        auto const& parent = target.block(current.parent);
+        switch (current.op) {
+          case opcode::Const:
+          case opcode::Param:
+            os << ' ' << current.imm;
+            break;
+          case opcode::Function:
+            if (static_cast<std::size_t>(current.imm) < callees.size())
+              os << ' ' << callees[static_cast<std::size_t>(current.imm)].name();
+            else os << " @" << current.imm;
+            break;
+          case opcode::Array:
+            os << ' ' << target.arrays()[static_cast<std::size_t>(current.imm)].name;
+            break;
+          case opcode::Phi:
+            for (auto i = std::size_t { 0 }; i < args.size(); ++i) {
+              os << (i == 0 ? " [" : ", [");
+              value(args[i]);
+              os << ", ";
+              if (i < parent.preds.size())
+                block(parent.preds[i]);
+              else os << '?';
+              os << ']';
+            }
+            break;
+          case opcode::Jump:
+          case opcode::Branch:
+            for (auto i = std::size_t { 0 }; i < args.size(); ++i) {
+              os << ' ';
+              value(args[i]);
+              os << ',';
+            }
+            for (auto i = std::size_t { 0 }; i < parent.succs.size(); ++i) {
+              os << (i == 0 ? " " : ", ");
+              block(parent.succs[i]);
+            }
+            break;
+          case opcode::Return: {
+            auto first = target.result() == type::Void ? std::size_t { 0 } : std::size_t { 1 };
+            if (first != 0 && !args.empty()) {
+              os << ' ';
+              value(args.front());
+            }
+            auto outputs = target.outputs();
+            for (auto i = first; i < args.size(); ++i) {
+              os << (i == first ? " [" : ", ");
+              if (i - first < outputs.size())
+                os << outputs[i - first].name << ": ";
+              value(args[i]);
+            }
+            if (args.size() > first)
+              os << ']';
+            if (current.imm != 0)
+              os << " ; tail call";
+            break;
+          }
+          default:
+            for (auto i = std::size_t { 0 }; i < args.size(); ++i) {
+              os << (i == 0 ? " " : ", ");
+              value(args[i]);
+            }
+            if (may_trap(current.op))
+              os << " ; traps on line " << current.imm;
+            break;
+        }
+        os << '\n';
+      }
+    };
+
+    auto print_function(std::ostream& os, function const& target, std::span<function const> callees)
+      -> std::ostream& {
+      auto out = printer { os, target, std::vector<std::uint32_t>(target.size(), none), callees };
+      auto counter = std::uint32_t { 0 };
+      for (auto id = block_id { 0 }; id < target.block_count(); ++id) {
+        for (auto value: target.block(id).phis)
+          out.numbers[value] = counter++;
+        for (auto value: target.block(id).code) {
+          if (target.at(value).kind != type::Void)
+            out.numbers[value] = counter++;
+        }
+      }
+
+      os << "function " << target.name();
+      if (!target.params().empty() || target.result() != type::I32) {
+        auto params = target.params();
+        for (auto i = std::size_t { 0 }; i < params.size(); ++i)
+          os << (i == 0 ? "(" : ", ") << name_of(params[i]);
+        os << (params.empty() ? "(" : "") << "): " << name_of(target.result());
+      }
+      os << " {\n";
+      for (auto const& output: target.outputs())
+        os << "  output " << output.name << ": " << name_of(output.kind) << '\n';
+      for (auto const& array: target.arrays())
+        os << "  array " << array.name << ": [" << array.length << ']' << name_of(array.kind) << '\n';
+      for (auto id = block_id { 0 }; id < target.block_count(); ++id) {
+        auto const& current = target.block(id);
+        if (current.removed)
+          continue;
+        out.block(id);
+        os << ':';
+        for (auto i = std::size_t { 0 }; i < current.preds.size(); ++i) {
+          os << (i == 0 ? " ; preds " : ", ");
+          out.block(current.preds[i]);
+        }
+        os << '\n';
+        for (auto value: current.phis)
+          out.instruction(value);
+        for (auto value: current.code)
+          out.instruction(value);
+      }
+      return os << "}\n";
+    }
+  }
+
+  extern auto print(std::ostream& os, function const& target)
+    -> std::ostream& {
+    return print_function(os, target, {});
+  }
+
+  extern auto print(std::ostream& os, module const& target)
+    -> std::ostream& {
+    print_function(os, target.main, target.functions);
+    for (auto const& current: target.functions)
+      print_function(os << '\n', current, target.functions);
+    return os;
+  }
+}
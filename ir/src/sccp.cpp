@@ -0,0 +1,324 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <utility>
+
+#include <thalia-sema/arith.hpp>
+
+#include "thalia-ir/dead_code.hpp"
+#include "thalia-ir/sccp.hpp"
+
+namespace thalia::ir {
+  namespace {
+    enum class level : std::uint8_t {
+      Unknown,
+      Constant,
+      Varying
+    };
+
+    struct cell {
+      level state = level::Unknown;
+      std::int64_t value = 0;
+
+      auto operator==(cell const& other) const -> bool
+        { return state == other.state && (state != level::Constant || value == other.value); }
+    };
+
+    auto meet(cell lhs, cell rhs)
+      -> cell {
+      if (lhs.state == level::Unknown)
+        return rhs;
+      if (rhs.state == level::Unknown || lhs == rhs)
+        return lhs;
+      return cell { level::Varying, 0 };
+    }
+
+    auto token_of(opcode op)
+      -> syntax::token_type {
+      switch (op) {
+        case opcode::Add: return syntax::token_type::Plus;
+        case opcode::Sub: return syntax::token_type::Minus;
+        case opcode::Mul: return syntax::token_type::Mul;
+        case opcode::Div: return syntax::token_type::Div;
+        case opcode::Mod: return syntax::token_type::Mod;
+        case opcode::Shl: return syntax::token_type::LShift;
+        case opcode::Shr: return syntax::token_type::RShift;
+        case opcode::And: return syntax::token_type::BitAnd;
+        case opcode::Or: return syntax::token_type::BitOr;
+        case opcode::Xor: return syntax::token_type::Xor;
+        case opcode::Eq: return syntax::token_type::Equal;
+        case opcode::Ne: return syntax::token_type::NotEqual;
+        case opcode::Lt: return syntax::token_type::Less;
+        case opcode::Le: return syntax::token_type::LessEqual;
+        case opcode::Gt: return syntax::token_type::Grt;
+        case opcode::Ge: return syntax::token_type::GrtEqual;
+        case opcode::Neg: return syntax::token_type::Minus;
+        default: return syntax::token_type::BitNot;
+      }
+    }
+
+    struct solver {
+      function const& target;
+      std::vector<cell> cells;
+      std::vector<bool> executable;
+      std::vector<std::uint8_t> taken;
+      // The instructions using each value: those of `v` are
+      // `users[first[v]]` up to `users[first[v + 1]]`.
+      std::vector<std::uint32_t> first;
+      std::vector<value_id> users;
+      std::vector<std::pair<block_id, std::size_t>> edges;
+      std::vector<value_id> changed;
+
+      explicit solver(function const& target)
+        : target { target }
+        , cells(target.size())
+        , executable(target.block_count(), false)
+        , taken(target.block_count(), 0)
+        , first(target.size() + 1, 0) {
+        auto each = [&](auto&& action) {
+          for (auto id = block_id { 0 }; id < target.block_count(); ++id) {
+            for (auto value: target.block(id).phis)
+              action(value);
+            for (auto value: target.block(id).code)
+              action(value);
+          }
+        };
+        each([&](value_id user) {
+          for (auto arg: target.operands(user))
+            ++first[arg + 1];
+        });
+        for (auto i = std::size_t { 1 }; i < first.size(); ++i)
+          first[i] += first[i - 1];
+        users.resize(first.back());
+        auto next = std::vector<std::uint32_t>(first.begin(), first.end() - 1);
+        each([&](value_id user) {
+          for (auto arg: target.operands(user))
+            users[next[arg]++] = user;
+        });
+      }
+
+      auto lower(value_id id, cell next)
+        -> void {
+        if (cells[id] == next)
+          return;
+        cells[id] = next;
+        changed.push_back(id);
+      }
+
+      auto is_taken(block_id from, block_id to)
+        -> bool {
+        auto const& succs = target.block(from).succs;
+        for (auto i = std::size_t { 0 }; i < succs.size(); ++i) {
+          if (succs[i] == to && (taken[from] >> i & 1) != 0)
+            return true;
+        }
+        return false;
+      }
+
+      auto evaluate(value_id id)
+        -> cell {
+        auto const& current = target.at(id);
+        auto args = target.operands(id);
+        auto width = width_of(current.kind);
+        if (current.op == opcode::Const)
+          return cell { level::Constant, current.imm };
+        // Nothing is known about the elements of arrays, the arguments of
+        // the function or what calls return.
+        if (current.op == opcode::Array || is_memory(current.op) || current.op == opcode::Param
+          || current.op == opcode::Function || current.op == opcode::Call)
+          return cell { level::Varying, 0 };
+        if (current.op == opcode::Phi) {
+          auto result = cell {};
+          auto const& preds = target.block(current.parent).preds;
+          for (auto i = std::size_t { 0 }; i < args.size(); ++i) {
+            if (is_taken(preds[i], current.parent))
+              result = meet(result, cells[args[i]]);
+          }
+          return result;
+        }
+
+        auto state = level::Constant;
+        for (auto arg: args)
+          state = std::max(state, cells[arg].state);
+        if (state != level::Constant)
+          return cell { state == level::Unknown ? level::Unknown : level::Varying, 0 };
+        auto result = args.size() == 1
+          ? sema::eval_unary(token_of(current.op), cells[args[0]].value, width)
+          : sema::eval_binary(token_of(current.op), cells[args[0]].value, cells[args[1]].value, width);
+        // A division by zero stays in the code, to trap if it ever runs.
+        if (result.status == sema::arith_status::DivByZero)
+          return cell { level::Varying, 0 };
+        return cell { level::Constant, result.value };
+      }
+
+      auto visit(value_id id)
+        -> void {
+        auto const& current = target.at(id);
+        auto block = current.parent;
+        switch (current.op) {
+          case opcode::Jump:
+            edges.emplace_back(block, 0);
+            return;
+          case opcode::Branch: {
+            auto condition = cells[target.operands(id)[0]];
+            if (condition.state == level::Constant) {
+              edges.emplace_back(block, condition.value != 0 ? 0 : 1);
+            } else if (condition.state == level::Varying) {
+              edges.emplace_back(block, 0);
+              edges.emplace_back(block, 1);
+            }
+            return;
+          }
+          case opcode::Return:
+            return;
+          default:
+            lower(id, evaluate(id));
+            return;
+        }
+      }
+
+      auto take(block_id from, std::size_t index)
+        -> void {
+        if ((taken[from] >> index & 1) != 0)
+          return;
+        taken[from] |= static_cast<std::uint8_t>(1 << index);
+        auto to = target.block(from).succs[index];
+        for (auto phi: target.block(to).phis)
+          visit(phi);
+        if (executable[to])
+          return;
+        executable[to] = true;
+        for (auto value: target.block(to).code)
+          visit(value);
+      }
+
+      auto run()
+        -> void {
+        executable[0] = true;
+        for (auto value: target.block(0).code)
+          visit(value);
+        while (!edges.empty() || !changed.empty()) {
+          if (!edges.empty()) {
+            auto [from, index] = edges.back();
+            edges.pop_back();
+            take(from, index);
+            continue;
+          }
+          auto value = changed.back();
+          changed.pop_back();
+          for (auto i = first[value]; i < first[value + 1]; ++i) {
+            auto user = users[i];
+            if (executable[target.at(user).parent])
+              visit(user);
+          }
+        }
+      }
+    };
+
+    auto make_constant(function& target, value_id id, std::int64_t value)
+      -> void {
+      target.at(id).op = opcode::Const;
+      target.at(id).imm = value;
+      target.set_operands(id, {});
+    }
+  }
+
+  constant_facts::constant_facts(function const& target) {
+    auto state = solver { target };
+    state.run();
+    _values.resize(target.size());
+    for (auto id = value_id { 0 }; id < target.size(); ++id) {
+      if (state.cells[id].state == level::Constant)
+        _values[id] = state.cells[id].value;
+    }
+    _executable = std::move(state.executable);
+    _taken = std::move(state.taken);
+  }
+
+  extern auto propagate_constants(function& target)
+    -> bool {
+    auto facts = constant_facts { target };
+    auto changed = false;
+    for (auto id = block_id { 0 }; id < target.block_count(); ++id) {
+      if (!facts.executable(id))
+        continue;
+      // Constants live among the code, so the constant phis move to its
+      // top, all at once.
+      auto& block = target.block(id);
+      auto moved = std::stable_partition(block.phis.begin(), block.phis.end(),
+        [&](value_id phi) { return !facts.value(phi); });
+      auto count = static_cast<std::size_t>(block.phis.end() - moved);
+      block.code.insert(block.code.begin(), moved, block.phis.end());
+      block.phis.erase(moved, block.phis.end());
+      for (auto i = std::size_t { 0 }; i < count; ++i)
+        make_constant(target, block.code[i], *facts.value(block.code[i]));
+      changed |= count != 0;
+      for (auto value: target.block(id).code) {
+        auto const& current = target.at(value);
+        if (current.op == opcode::Const || is_terminator(current.op))
+          continue;
+        if (auto folded = facts.value(value)) {
+          make_constant(target, value, *folded);
+          changed = true;
+        }
+      }
+
+      auto last = target.terminator(id);
+      if (last == none || target.at(last).op != opcode::Branch)
+        continue;
+      auto const& succs = target.block(id).succs;
+      if (facts.taken(id, 0) == facts.taken(id, 1) || succs[0] == succs[1])
+        continue;
+      auto dropped = succs[facts.taken(id, 0) ? 1 : 0];
+      target.remove_edge(id, dropped);
+      target.at(last).op = opcode::Jump;
+      target.set_operands(last, {});
+      changed = true;
+    }
+
+    // Once the branches are rewritten, the blocks that cannot run are the
+    // ones left unreachable.
+    return remove_unreachable(target) || changed;
+  }
+
+  extern auto export_constants(
+    constant_facts const& facts,
+    builder const& built,
+    sema::constants& values
+  ) -> std::size_t {
+    auto traps = built.traps();
+    auto count = std::size_t { 0 };
+    for (auto const& entry: built.origins()) {
+      auto value = facts.value(entry.value);
+      if (!value || values.value(*entry.node))
+        continue;
+      auto safe = std::all_of(
+        traps.begin() + entry.first_trap,
+        traps.begin() + entry.last_trap,
+        [&](value_id trap) { return facts.value(trap).has_value(); }
+      );
+      if (!safe)
+        continue;
+      values.set(*entry.node, *value);
+      ++count;
+    }
+    return count;
+  }
+}
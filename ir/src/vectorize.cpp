@@ -0,0 +1,228 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <optional>
+
+#include "thalia-ir/dominators.hpp"
+#include "thalia-ir/loops.hpp"
+#include "thalia-ir/vectorize.hpp"
+
+namespace thalia::ir {
+  namespace {
+    struct context {
+      function const& target;
+      vector_loop& plan;
+      // Which values are computed in lanes, by value.
+      std::vector<bool> lanes;
+      // The number of uses of every value within the loop.
+      std::vector<std::uint32_t> uses;
+    };
+
+    auto is_inside(context const& ctx, value_id id)
+      -> bool {
+      auto parent = ctx.target.at(id).parent;
+      return parent == ctx.plan.header || parent == ctx.plan.body;
+    }
+
+    auto is_constant(function const& target, value_id id, std::int64_t value)
+      -> bool {
+      return target.at(id).op == opcode::Const && target.at(id).imm == value;
+    }
+
+    // Whether the body can use a value in lanes: one computed in lanes, a
+    // reduction, or an `i32` constant or defined before the loop, broadcast
+    // to all of them.
+    auto use(context& ctx, value_id id)
+      -> bool {
+      if (ctx.lanes[id])
+        return true;
+      auto const& current = ctx.target.at(id);
+      if (current.kind != type::I32 || (is_inside(ctx, id) && current.op != opcode::Const))
+        return false;
+      auto& invariants = ctx.plan.invariants;
+      if (std::find(invariants.begin(), invariants.end(), id) == invariants.end())
+        invariants.push_back(id);
+      return true;
+    }
+
+    auto is_lane_array(context& ctx, value_id array)
+      -> bool {
+      auto const& current = ctx.target.at(array);
+      if (ctx.target.arrays()[static_cast<std::size_t>(current.imm)].kind != type::I32)
+        return false;
+      auto& arrays = ctx.plan.arrays;
+      if (std::find(arrays.begin(), arrays.end(), array) == arrays.end())
+        arrays.push_back(array);
+      return true;
+    }
+
+    // Whether an instruction of the body can run in lanes.
+    auto fits(context& ctx, value_id id)
+      -> bool {
+      auto const& target = ctx.target;
+      auto const& current = target.at(id);
+      auto args = target.operands(id);
+      switch (current.op) {
+        case opcode::Const:
+          return true;
+        case opcode::Load:
+          return args[1] == ctx.plan.counter && is_lane_array(ctx, args[0]);
+        case opcode::Store:
+          return args[1] == ctx.plan.counter && is_lane_array(ctx, args[0]) && use(ctx, args[2]);
+        case opcode::Add:
+        case opcode::Sub:
+        case opcode::Mul:
+        case opcode::And:
+        case opcode::Or:
+        case opcode::Xor:
+          return current.kind == type::I32 && use(ctx, args[0]) && use(ctx, args[1]);
+        case opcode::Shl:
+        case opcode::Shr:
+          return current.kind == type::I32 && use(ctx, args[0]) && target.at(args[1]).op == opcode::Const;
+        case opcode::Neg:
+        case opcode::Not:
+          return current.kind == type::I32 && use(ctx, args[0]);
+        default:
+          return false;
+      }
+    }
+
+    // A phi of the header other than the counter must fold one value of
+    // the body into itself, and be used for nothing else in the loop.
+    auto find_reduction(context& ctx, value_id phi, std::size_t back)
+      -> bool {
+      auto const& target = ctx.target;
+      auto update = target.operands(phi)[back];
+      auto const& current = target.at(update);
+      if (target.at(phi).kind != type::I32 || current.parent != ctx.plan.body)
+        return false;
+      auto args = target.operands(update);
+      switch (current.op) {
+        case opcode::Add:
+        case opcode::And:
+        case opcode::Or:
+        case opcode::Xor:
+          if (args[0] != phi && args[1] != phi)
+            return false;
+          break;
+        case opcode::Sub:
+          if (args[0] != phi)
+            return false;
+          break;
+        default:
+          return false;
+      }
+      if (args[0] == args[1] || ctx.uses[phi] != 1 || ctx.uses[update] != 1)
+        return false;
+      ctx.lanes[phi] = true;
+      ctx.plan.reductions.push_back(reduction { phi, update });
+      return true;
+    }
+
+    auto analyze(function const& target, natural_loop const& loop)
+      -> std::optional<vector_loop> {
+      if (loop.preheader == none || loop.blocks.size() != 2 || loop.latches.size() != 1)
+        return std::nullopt;
+      auto header = loop.header;
+      auto body = loop.latches.front();
+      auto const& head = target.block(header);
+      if (head.code.size() != 2 || target.block(header).succs.front() != body)
+        return std::nullopt;
+      auto condition = head.code[0];
+      auto const& test = target.at(condition);
+      if (target.at(head.code[1]).op != opcode::Branch || target.operands(head.code[1])[0] != condition)
+        return std::nullopt;
+
+      auto args = target.operands(condition);
+      auto counter = test.op == opcode::Lt ? args[0] : test.op == opcode::Gt ? args[1] : none;
+      auto bound = test.op == opcode::Lt ? args[1] : args[0];
+      if (counter == none || target.at(counter).op != opcode::Phi || target.at(counter).parent != header)
+        return std::nullopt;
+
+      auto plan = vector_loop { header, body, loop.preheader, counter, bound, {}, {}, {} };
+      auto ctx = context {
+        target, plan,
+        std::vector<bool>(target.size(), false),
+        std::vector<std::uint32_t>(target.size(), 0)
+      };
+      if (is_inside(ctx, bound))
+        return std::nullopt;
+      for (auto block: loop.blocks) {
+        for (auto value: target.block(block).phis) {
+          for (auto arg: target.operands(value))
+            ++ctx.uses[arg];
+        }
+        for (auto value: target.block(block).code) {
+          for (auto arg: target.operands(value))
+            ++ctx.uses[arg];
+        }
+      }
+
+      auto back = static_cast<std::size_t>(
+        std::find(head.preds.begin(), head.preds.end(), body) - head.preds.begin()
+      );
+      auto step = target.operands(counter)[back];
+      auto step_args = target.operands(step);
+      auto steps = target.at(step).op == opcode::Add && target.at(step).parent == body
+        && ((step_args[0] == counter && is_constant(target, step_args[1], 1))
+          || (step_args[1] == counter && is_constant(target, step_args[0], 1)));
+      if (!steps || ctx.uses[step] != 1)
+        return std::nullopt;
+      for (auto phi: head.phis) {
+        if (phi != counter && !find_reduction(ctx, phi, back))
+          return std::nullopt;
+      }
+
+      auto accesses = false;
+      auto const& code = target.block(body).code;
+      if (target.at(code.back()).op != opcode::Jump)
+        return std::nullopt;
+      for (auto i = std::size_t { 0 }; i + 1 < code.size(); ++i) {
+        auto value = code[i];
+        if (value == step)
+          continue;
+        if (!fits(ctx, value))
+          return std::nullopt;
+        auto op = target.at(value).op;
+        accesses = accesses || is_memory(op);
+        ctx.lanes[value] = op != opcode::Const && op != opcode::Store;
+      }
+
+      // A reduction shares its register with its update.
+      auto values = plan.invariants.size();
+      for (auto i = std::size_t { 0 }; i + 1 < code.size(); ++i)
+        values += ctx.lanes[code[i]] ? 1 : 0;
+      if (!accesses || values > vector_values)
+        return std::nullopt;
+      return plan;
+    }
+  }
+
+  extern auto find_vector_loops(function const& target)
+    -> std::vector<vector_loop> {
+    auto tree = dominator_tree { target };
+    auto result = std::vector<vector_loop> {};
+    for (auto const& loop: find_loops(target, tree)) {
+      if (auto plan = analyze(target, loop))
+        result.push_back(std::move(*plan));
+    }
+    return result;
+  }
+}
@@ -0,0 +1,301 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <vector>
+
+#include <thalia-sema/arith.hpp>
+
+#include "thalia-ir/dominators.hpp"
+#include "thalia-ir/verifier.hpp"
+
+namespace thalia::ir {
+  namespace {
+    auto successors_of(opcode op)
+      -> std::size_t {
+      switch (op) {
+        case opcode::Jump: return 1;
+        case opcode::Branch: return 2;
+        default: return 0;
+      }
+    }
+
+    // Checks an instruction on its own: its operands, their types and its
+    // place.
+    auto check_instruction(function const& target, block_id block, value_id id)
+      -> std::optional<std::string> {
+      auto const& current = target.at(id);
+      if (current.parent != block)
+        return "instruction is not in its block";
+      auto args = target.operands(id);
+      for (auto arg: args) {
+        if (arg >= target.size() || target.at(arg).parent == none)
+          return "operand is not defined";
+        if (target.at(arg).kind == type::Void)
+          return "operand has no value";
+      }
+
+      auto kind_of = [&](std::size_t i) { return target.at(args[i]).kind; };
+      auto is_value = current.kind != type::Void;
+      switch (current.op) {
+        case opcode::Const:
+          if (!is_value || !args.empty())
+            return "malformed constant";
+          if (sema::wrap(static_cast<std::uint64_t>(current.imm), width_of(current.kind)) != current.imm)
+            return "constant out of range of its type";
+          return std::nullopt;
+        case opcode::Phi:
+          if (!is_value || args.size() != target.block(block).preds.size())
+            return "phi does not match the predecessors";
+          for (auto i = std::size_t { 0 }; i < args.size(); ++i) {
+            if (kind_of(i) != current.kind)
+              return "operand types do not match";
+          }
+          return std::nullopt;
+        case opcode::Neg:
+        case opcode::Not:
+          if (!is_value || args.size() != 1)
+            return "wrong number of operands";
+          if (kind_of(0) != current.kind)
+            return "operand types do not match";
+          return std::nullopt;
+        case opcode::Param:
+          if (!is_value || !args.empty())
+            return "malformed parameter";
+          if (current.imm < 0 || static_cast<std::size_t>(current.imm) >= target.params().size())
+            return "parameter out of range";
+          if (target.params()[static_cast<std::size_t>(current.imm)] != current.kind)
+            return "parameter type does not match";
+          return std::nullopt;
+        case opcode::Array:
+          if (current.kind != type::I64 || !args.empty())
+            return "malformed array";
+          if (current.imm < 0 || static_cast<std::size_t>(current.imm) >= target.arrays().size())
+            return "array out of range";
+          return std::nullopt;
+        case opcode::Function:
+          if (current.kind != type::I64 || !args.empty() || current.imm < 0)
+            return "malformed function";
+          return std::nullopt;
+        case opcode::Call:
+          if (args.empty())
+            return "wrong number of operands";
+          if (target.at(args[0]).op != opcode::Function)
+            return "call to something other than a function";
+          return std::nullopt;
+        case opcode::Load:
+        case opcode::Store:
+        case opcode::Clear: {
+          auto expected = std::size_t { current.op == opcode::Load ? 2u : current.op == opcode::Store ? 3u : 1u };
+          if (is_value != (current.op == opcode::Load) || args.size() != expected)
+            return "wrong number of operands";
+          if (target.at(args[0]).op != opcode::Array)
+            return "access to something other than an array";
+          auto kind = target.arrays()[static_cast<std::size_t>(target.at(args[0]).imm)].kind;
+          if ((is_value && current.kind != kind) || (args.size() == 3 && kind_of(2) != kind))
+            return "operand types do not match";
+          return std::nullopt;
+        }
+        case opcode::Jump:
+        case opcode::Branch:
+        case opcode::Return: {
+          if (is_value)
+            return "terminator with a value";
+          auto results = target.result() == type::Void ? 0 : 1;
+          auto expected = current.op == opcode::Jump ? 0
+            : current.op == opcode::Branch ? 1
+            : results + target.outputs().size();
+          if (args.size() != expected) {
+            return current.op == opcode::Return
+              ? "return does not report every output"
+              : "wrong number of operands";
+          }
+          if (current.op != opcode::Return)
+            return std::nullopt;
+          if (results != 0 && kind_of(0) != target.result())
+            return "operand types do not match";
+          auto outputs = target.outputs();
+          for (auto i = std::size_t { 0 }; i < outputs.size(); ++i) {
+            if (kind_of(i + results) != outputs[i].kind)
+              return "operand types do not match";
+          }
+          return std::nullopt;
+        }
+        default:
+          if (!is_value || args.size() != 2)
+            return "wrong number of operands";
+          if (kind_of(0) != current.kind)
+            return "operand types do not match";
+          if (current.op != opcode::Shl && current.op != opcode::Shr && kind_of(1) != current.kind)
+            return "operand types do not match";
+          return std::nullopt;
+      }
+    }
+
+    auto check_block(function const& target, block_id id)
+      -> std::optional<verify_error> {
+      auto const& current = target.block(id);
+      auto fail = [&](value_id value, std::string reason) {
+        return std::optional<verify_error> { verify_error { id, value, std::move(reason) } };
+      };
+
+      if (current.removed) {
+        auto empty = current.phis.empty() && current.code.empty()
+          && current.preds.empty() && current.succs.empty();
+        return empty ? std::nullopt : fail(none, "erased block is still in use");
+      }
+
+      for (auto phi: current.phis) {
+        if (target.at(phi).op != opcode::Phi)
+          return fail(phi, "instruction among the phis");
+        if (auto reason = check_instruction(target, id, phi))
+          return fail(phi, *reason);
+      }
+
+      if (current.code.empty())
+        return fail(none, "block does not end in a terminator");
+      for (auto i = std::size_t { 0 }; i < current.code.size(); ++i) {
+        auto value = current.code[i];
+        auto op = target.at(value).op;
+        if (op == opcode::Phi)
+          return fail(value, "phi after other instructions");
+        if (is_terminator(op) != (i + 1 == current.code.size())) {
+          return fail(value, is_terminator(op)
+            ? "terminator in the middle of a block"
+            : "block does not end in a terminator");
+        }
+        if (auto reason = check_instruction(target, id, value))
+          return fail(value, *reason);
+      }
+
+      auto last = current.code.back();
+      if (current.succs.size() != successors_of(target.at(last).op))
+        return fail(last, "successors do not match the terminator");
+      for (auto succ: current.succs) {
+        if (succ >= target.block_count())
+          return fail(last, "successor out of range");
+        auto const& preds = target.block(succ).preds;
+        auto forward = std::count(current.succs.begin(), current.succs.end(), succ);
+        if (std::count(preds.begin(), preds.end(), id) != forward)
+          return fail(last, "edges are inconsistent");
+      }
+      for (auto pred: current.preds) {
+        if (pred >= target.block_count())
+          return fail(none, "predecessor out of range");
+        auto const& succs = target.block(pred).succs;
+        if (std::find(succs.begin(), succs.end(), id) == succs.end())
+          return fail(none, "edges are inconsistent");
+      }
+      return std::nullopt;
+    }
+  }
+
+  extern auto verify(function const& target)
+    -> std::optional<verify_error> {
+    if (target.block_count() == 0)
+      return verify_error { none, none, "function has no blocks" };
+    if (!target.block(0).preds.empty())
+      return verify_error { 0, none, "entry block has predecessors" };
+    if (target.block(0).removed)
+      return verify_error { 0, none, "entry block is erased" };
+    for (auto id = block_id { 0 }; id < target.block_count(); ++id) {
+      if (auto error = check_block(target, id))
+        return error;
+    }
+
+    // Within a block, a definition must come before its uses.
+    auto position = std::vector<std::uint32_t>(target.size(), 0);
+    for (auto id = block_id { 0 }; id < target.block_count(); ++id) {
+      auto counter = std::uint32_t { 0 };
+      for (auto value: target.block(id).phis)
+        position[value] = counter++;
+      for (auto value: target.block(id).code)
+        position[value] = counter++;
+    }
+
+    auto tree = dominator_tree { target };
+    for (auto id: tree.order()) {
+      auto const& current = target.block(id);
+      auto fail = [&](value_id value) {
+        return verify_error { id, value, "operand does not dominate its use" };
+      };
+      for (auto phi: current.phis) {
+        auto args = target.operands(phi);
+        for (auto i = std::size_t { 0 }; i < args.size(); ++i) {
+          auto pred = current.preds[i];
+          if (tree.reachable(pred) && !tree.dominates(target.at(args[i]).parent, pred))
+            return fail(phi);
+        }
+      }
+      for (auto value: current.code) {
+        for (auto arg: target.operands(value)) {
+          auto home = target.at(arg).parent;
+          auto ordered = home == id
+            ? position[arg] < position[value]
+            : tree.dominates(home, id);
+          if (!ordered)
+            return fail(value);
+        }
+      }
+    }
+    return std::nullopt;
+  }
+
+  extern auto verify(module const& target)
+    -> std::optional<verify_error> {
+    auto check = [&](function const& current, std::uint32_t index) -> std::optional<verify_error> {
+      if (auto error = verify(current)) {
+        error->function = index;
+        return error;
+      }
+      for (auto id = block_id { 0 }; id < current.block_count(); ++id) {
+        for (auto value: current.block(id).code) {
+          auto const& call = current.at(value);
+          if (call.op != opcode::Call)
+            continue;
+          auto args = current.operands(value);
+          auto callee = static_cast<std::size_t>(current.at(args[0]).imm);
+          auto fail = [&](std::string reason) {
+            return std::optional<verify_error> { verify_error { id, value, std::move(reason), index } };
+          };
+          if (callee >= target.functions.size())
+            return fail("function out of range");
+          auto const& called = target.functions[callee];
+          if (args.size() != called.params().size() + 1)
+            return fail("wrong number of arguments");
+          for (auto i = std::size_t { 0 }; i < called.params().size(); ++i) {
+            if (current.at(args[i + 1]).kind != called.params()[i])
+              return fail("argument types do not match");
+          }
+          if (call.kind != called.result())
+            return fail("result type does not match");
+        }
+      }
+      return std::nullopt;
+    };
+
+    if (auto error = check(target.main, none))
+      return error;
+    for (auto index = std::size_t { 0 }; index < target.functions.size(); ++index) {
+      if (auto error = check(target.functions[index], static_cast<std::uint32_t>(index)))
+        return error;
+    }
+    return std::nullopt;
+  }
+}
@@ -0,0 +1,236 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-test/frontend.hpp>
+
+#include "thalia-ir/builder.hpp"
+#include "thalia-ir/printer.hpp"
+#include "thalia-ir/verifier.hpp"
+#include "interpret.hpp"
+
+using namespace thalia;
+
+namespace {
+  auto build(test::analyzed const& source)
+    -> ir::function {
+    auto result = ir::builder { source.types, source.names, source.typing }.build(source.ast);
+    auto error = ir::verify(result);
+    INFO((error ? error->reason : ""));
+    CHECK(!error);
+    return result;
+  }
+
+  auto text_of(ir::function const& target)
+    -> std::string {
+    auto out = std::ostringstream {};
+    ir::print(out, target);
+    return out.str();
+  }
+}
+
+TEST_CASE("builder: places phis only where values merge") {
+  auto source = test::analyzed {
+    "def MIN: i32 = 4i32,\n"
+    "    MAX: i32 = 6i32;\n"
+    "def mut i: i32 = MIN,\n"
+    "    mut s: i32 = 0i32;\n"
+    "while i <= MAX {\n"
+    "  s += i;\n"
+    "  i += 1i32;\n"
+    "}\n"
+  };
+  auto function = build(source);
+  CHECK(text_of(function) ==
+    "function main {\n"
+    "  output i: i32\n"
+    "  output s: i32\n"
+    "b0:\n"
+    "  %0 = const i32 4\n"
+    "  %1 = const i32 6\n"
+    "  %2 = const i32 0\n"
+    "  jump b1\n"
+    "b1: ; preds b0, b2\n"
+    "  %3 = phi i32 [%0, b0], [%8, b2]\n"
+    "  %4 = phi i32 [%2, b0], [%6, b2]\n"
+    "  %5 = le i32 %3, %1\n"
+    "  branch %5, b2, b3\n"
+    "b2: ; preds b1\n"
+    "  %6 = add i32 %4, %3\n"
+    "  %7 = const i32 1\n"
+    "  %8 = add i32 %3, %7\n"
+    "  jump b1\n"
+    "b3: ; preds b1\n"
+    "  %9 = const i32 0\n"
+    "  return %9 [i: %3, s: %4]\n"
+    "}\n");
+
+  auto result = test::interpret(function);
+  CHECK(result.status == 0);
+  CHECK(result.outputs == std::vector<std::int64_t> { 7, 15 });
+}
+
+TEST_CASE("builder: merges the branches of an if") {
+  auto source = test::analyzed {
+    "def mut a: i64 = 3, mut b: i64 = 0, mut c: i64 = 5;\n"
+    "if a > 2 { b = 1; } else { b = 2; c = 7; }\n"
+    "if a < 2 { a = 9; }\n"
+  };
+  auto function = build(source);
+  // `b` and `c` merge after the first if, `a` after the second one.
+  CHECK(test::count(function, ir::opcode::Phi) == 3);
+  CHECK(test::interpret(function).outputs == std::vector<std::int64_t> { 3, 1, 5 });
+}
+
+TEST_CASE("builder: reads in a loop header before the back edge is known") {
+  auto source = test::analyzed {
+    "def mut i: i64 = 0, mut j: i64 = 0, mut acc: i64 = 0, mut unused: i64 = 4;\n"
+    "while i < 10 {\n"
+    "  j = 0;\n"
+    "  while j < i { acc += j; j += 1; }\n"
+    "  i += 1;\n"
+    "}\n"
+  };
+  auto function = build(source);
+  // `unused` is only read when returning, so no header merges it.
+  CHECK(test::count(function, ir::opcode::Phi) == 5);
+  CHECK(test::interpret(function).outputs == std::vector<std::int64_t> { 10, 9, 120, 4 });
+}
+
+TEST_CASE("builder: logical operators only evaluate what they need") {
+  auto source = test::analyzed {
+    "def mut z: i64 = 0, mut r: i64 = 0, mut t: i64 = 0;\n"
+    "if z != 0 && 10 / z > 1 { r = 1; }\n"
+    "if z == 0 || 10 / z > 1 { t = 1; }\n"
+    "r += !z + (z || 1);\n"
+  };
+  auto function = build(source);
+  auto result = test::interpret(function);
+  CHECK(!result.trap);
+  CHECK(result.outputs == std::vector<std::int64_t> { 0, 2, 1 });
+}
+
+TEST_CASE("builder: code after a return is built but unreachable") {
+  auto source = test::analyzed {
+    "def mut x: i32 = 1i32;\n"
+    "while x < 100i32 {\n"
+    "  x *= 2i32;\n"
+    "  if x == 16i32 { return x; }\n"
+    "}\n"
+    "x = 5i32 / (x - x);\n"
+  };
+  auto function = build(source);
+  auto result = test::interpret(function);
+  CHECK(!result.trap);
+  CHECK(result.status == 16);
+  CHECK(result.outputs == std::vector<std::int64_t> { 16 });
+}
+
+TEST_CASE("builder: divisions keep the line they report") {
+  auto source = test::analyzed {
+    "def mut a: i16 = 7i16, mut b: i16 = 0i16;\n"
+    "a %= 4i16;\n"
+    "a = a / b;\n"
+  };
+  auto function = build(source);
+  CHECK(test::interpret(function).trap == 3);
+  CHECK(text_of(function).find("div i16 %3, %1 ; traps on line 3") != std::string::npos);
+}
+
+TEST_CASE("builder: arrays stay in memory") {
+  auto source = test::analyzed {
+    "def mut a: [3]i16, mut s: i16 = 0i16, mut i: i64 = 0;\n"
+    "while i < 3 { a[i] = a[i] + 5i16; s += a[i]; i += 1; }\n"
+    "if 1 { def mut b: [2]i16; b[1] += s; }\n"
+    "a[i] = 1i16;\n"
+  };
+  auto function = build(source);
+  REQUIRE(function.arrays().size() == 2);
+  CHECK(function.arrays()[0].length == 3);
+  CHECK(function.outputs().size() == 2);
+  CHECK(test::count(function, ir::opcode::Store) == 3);
+  CHECK(test::count(function, ir::opcode::Clear) == 2);
+  // No phi merges elements, only the counter and the sum.
+  CHECK(test::count(function, ir::opcode::Phi) == 2);
+  CHECK(test::interpret(function).trap == 4);
+  CHECK(text_of(function).find("  array a: [3]i16\n") != std::string::npos);
+}
+
+TEST_CASE("builder: builds long functions") {
+  auto code = std::string { "def mut x: i64 = 0, mut y: i64 = 1;\n" };
+  for (auto i = 0; i < 2000; ++i)
+    code.append("if x < 1000 { x += y; } else { y += 1; }\nwhile y > 3 { y -= 1; }\n");
+  auto function = build(test::analyzed { code });
+  CHECK(function.block_count() == 1 + 2000 * 6);
+  CHECK(test::interpret(function).outputs == std::vector<std::int64_t> { 1000, 3 });
+}
+
+TEST_CASE("builder: builds every function of a module") {
+  auto source = test::analyzed {
+    "use twice(x: i32): i32;\n"
+    "def mut a: i32 = twice(4i32);\n"
+    "global twice(x: i32): i32 { def mut b: [2]i32; b[1] = x; return b[1] + x; }\n"
+    "global noop(): void { return; }\n"
+    "noop();\n"
+  };
+  auto target = ir::builder { source.types, source.names, source.typing }.build_module(source.ast);
+  auto error = ir::verify(target);
+  INFO((error ? error->reason : ""));
+  CHECK(!error);
+  REQUIRE(target.functions.size() == 2);
+  CHECK(target.functions[0].params().size() == 1);
+  CHECK(target.functions[0].arrays().size() == 1);
+  CHECK(target.functions[1].result() == ir::type::Void);
+  CHECK(test::count(target.main, ir::opcode::Call) == 2);
+  CHECK(test::interpret(target).outputs == std::vector<std::int64_t> { 8 });
+
+  auto out = std::ostringstream {};
+  ir::print(out, target);
+  INFO(out.str());
+  CHECK(out.str().find("function twice(i32): i32") != std::string::npos);
+  CHECK(out.str().find("call i32 %") != std::string::npos);
+}
+
+TEST_CASE("builder: marks the calls functions return as tail calls") {
+  auto source = test::analyzed {
+    "global sum(n: i64, acc: i64): i64 {\n"
+    "  if n == 0 { return acc; }\n"
+    "  return (sum(n - 1, acc + n));\n"
+    "}\n"
+    "global twice(n: i32): i32 { return n * 2i32; }\n"
+    "global half(n: i32): i32 { return twice(n) / 4i32; }\n"
+    "def mut total: i64 = sum(100000, 0);\n"
+    "return half(2i32);\n"
+  };
+  auto target = ir::builder { source.types, source.names, source.typing }.build_module(source.ast);
+  REQUIRE(!ir::verify(target));
+  CHECK(text_of(target.functions[0]).find("; tail call") != std::string::npos);
+  CHECK(text_of(target.functions[2]).find("; tail call") == std::string::npos);
+  CHECK(text_of(target.main).find("; tail call") == std::string::npos);
+
+  // Tail calls run in place of their caller, so they never overflow.
+  auto result = test::interpret(target);
+  CHECK(!result.trap);
+  CHECK(result.outputs == std::vector<std::int64_t> { 5000050000 });
+  CHECK(result.status == 1);
+}
@@ -0,0 +1,94 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-test/frontend.hpp>
+
+#include "thalia-ir/dead_code.hpp"
+#include "thalia-ir/pipeline.hpp"
+#include "interpret.hpp"
+
+using namespace thalia;
+
+TEST_CASE("dead code: drops stores that are never read") {
+  auto source = test::analyzed {
+    "def mut x: i64 = 3, mut y: i64 = 0;\n"
+    "x = y * 7;\n"
+    "x = y + 1;\n"
+    "while y < 10 {\n"
+    "  def mut t: i64 = x << 2;\n"
+    "  t -= y;\n"
+    "  y += 1;\n"
+    "}\n"
+    "x ^ y;\n"
+  };
+  auto function = test::check_pass(test::build_function(source), ir::remove_dead_code).target;
+  CHECK(test::count(function, ir::opcode::Mul) == 0);
+  CHECK(test::count(function, ir::opcode::Shl) == 0);
+  CHECK(test::count(function, ir::opcode::Sub) == 0);
+  CHECK(test::count(function, ir::opcode::Xor) == 0);
+  // The counter of the loop and its output stay.
+  CHECK(test::count(function, ir::opcode::Add) == 2);
+}
+
+TEST_CASE("dead code: keeps divisions that may trap") {
+  auto source = test::analyzed {
+    "def mut r: i32 = 7i32, mut z: i32 = 0i32;\n"
+    "r % 2i32;\n"
+    "r / z;\n"
+    "r += 1i32;\n"
+  };
+  auto function = test::check_pass(test::build_function(source), ir::remove_dead_code).target;
+  CHECK(test::count(function, ir::opcode::Mod) == 0);
+  CHECK(test::count(function, ir::opcode::Div) == 1);
+  CHECK(test::interpret(function).trap == 3);
+}
+
+TEST_CASE("dead code: erases the code after a return") {
+  auto source = test::analyzed {
+    "def mut x: i32 = 1i32;\n"
+    "while x < 100i32 { x *= 2i32; }\n"
+    "return x;\n"
+    "x = 5i32 / (x - x);\n"
+    "while x > 0i32 { x -= 1i32; }\n"
+  };
+  auto function = test::check_pass(test::build_function(source), ir::remove_unreachable).target;
+  CHECK(test::count(function, ir::opcode::Div) == 0);
+  CHECK(test::count(function, ir::opcode::Sub) == 0);
+  CHECK(test::blocks(function) == 4);
+}
+
+TEST_CASE("dead code: merges straight-line blocks") {
+  auto source = test::analyzed {
+    "def mut a: i64 = 2, mut b: i64 = 0;\n"
+    "if a > 1 { a += 1; } else { a -= 1; }\n"
+    "while a < 0 { a += 1; }\n"
+    "{ def mut t: i64 = a; b = t * 3; }\n"
+    "if b > 1 { }\n"
+  };
+  auto optimize = [](ir::function& target) { ir::optimize(target); };
+  auto function = test::check_pass(test::build_function(source), optimize).target;
+  CHECK(test::blocks(function) == 1);
+  CHECK(test::count(function, ir::opcode::Phi) == 0);
+  CHECK(test::interpret(function).outputs == std::vector<std::int64_t> { 3, 9 });
+}
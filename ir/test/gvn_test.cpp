@@ -0,0 +1,92 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-test/frontend.hpp>
+
+#include "thalia-ir/dead_code.hpp"
+#include "thalia-ir/gvn.hpp"
+#include "thalia-ir/sccp.hpp"
+#include "interpret.hpp"
+
+using namespace thalia;
+
+namespace {
+  // Dead stores go first, so that what is counted is what numbering left.
+  auto number(test::analyzed const& source)
+    -> test::transformed<ir::function> {
+    auto function = test::build_function(source);
+    ir::remove_dead_code(function);
+    return test::check_pass(std::move(function), ir::eliminate_redundancies);
+  }
+}
+
+TEST_CASE("gvn: finds expressions again whatever order their operands are in") {
+  auto source = test::analyzed {
+    "def mut base: i64 = 7, mut i: i64 = 3, mut a: i64 = 0, mut b: i64 = 0, mut c: i64 = 0;\n"
+    "a = (i << 2) + base;\n"
+    "b = base + (i << 2);\n"
+    "c = (base * i) ^ (i * base) | (i & base) | (base & i);\n"
+    "def lt: i64 = a < b, gt: i64 = b > a;\n"
+    "c += lt - gt;\n"
+  };
+  auto function = number(source).target;
+  CHECK(test::count(function, ir::opcode::Shl) == 1);
+  CHECK(test::count(function, ir::opcode::Add) == 2);
+  CHECK(test::count(function, ir::opcode::Mul) == 1);
+  CHECK(test::count(function, ir::opcode::And) == 1);
+  CHECK(test::count(function, ir::opcode::Gt) + test::count(function, ir::opcode::Lt) == 1);
+}
+
+TEST_CASE("gvn: reuses values from the blocks that dominate") {
+  auto source = test::analyzed {
+    "def mut base: i64 = 5, mut i: i64 = 0, mut s: i64 = 0, mut t: i64 = 0, mut u: i64 = 0;\n"
+    "s = base * 3 - 1;\n"
+    "while i < 10 {\n"
+    "  if i % 2 == 0 { t += base * 3 - 1; } else { t -= (i << 2) + base; }\n"
+    "  u += (i << 2) + base;\n"
+    "  i += 1;\n"
+    "}\n"
+  };
+  auto result = number(source);
+  // Both branches of the `if` are separate, so only the multiplication
+  // before the loop and the sum after the `if` are found again.
+  CHECK(test::count(result.target, ir::opcode::Mul) == 1);
+  CHECK(test::count(result.target, ir::opcode::Shl) == 2);
+  CHECK(result.after.steps < result.before.steps);
+}
+
+TEST_CASE("gvn: keeps what may differ or trap first") {
+  auto source = test::analyzed {
+    "def mut a: [4]i64, mut d: i64 = 0, mut x: i64 = 0, mut y: i64 = 0;\n"
+    "x = a[1];\n"
+    "a[1] = 5;\n"
+    "y = a[1];\n"
+    "if x == 0 { x = 10 / d; }\n"
+    "y += 10 / d;\n"
+  };
+  auto result = number(source);
+  CHECK(test::count(result.target, ir::opcode::Load) == 2);
+  CHECK(test::count(result.target, ir::opcode::Div) == 2);
+  CHECK(result.after.trap == 5);
+}
@@ -0,0 +1,114 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-test/frontend.hpp>
+
+#include "thalia-ir/induction.hpp"
+#include "thalia-ir/pipeline.hpp"
+#include "interpret.hpp"
+
+using namespace thalia;
+
+TEST_CASE("induction: replaces a counting loop by its closed form") {
+  auto source = test::analyzed {
+    "def MIN: i32 = 0i32, MAX: i32 = 2000000000i32;\n"
+    "def mut i: i32 = MIN, mut s: i32 = 0i32;\n"
+    "while i <= MAX { s += i; i += 1i32; }\n"
+  };
+  auto function = test::build_function(source);
+  auto log = std::vector<ir::remark> {};
+  ir::optimize(function, &log);
+  CHECK(test::count(function, ir::opcode::Phi) == 0);
+  CHECK(test::count(function, ir::opcode::Branch) == 0);
+  // The sum wraps exactly as the loop would have.
+  auto result = test::interpret(function);
+  CHECK(result.outputs == std::vector<std::int64_t> { 2000000001, -1973237248 });
+  REQUIRE(log.size() == 1);
+  CHECK(log[0].line == 3);
+  CHECK(log[0].message == "loop runs 2000000001 times; replaced by its final values");
+}
+
+TEST_CASE("induction: folds nests, steps down and resets") {
+  auto source = test::analyzed {
+    "def mut i: i64 = 0, mut j: i64 = 0, mut s: i64 = 7, mut t: i16 = 0i16, mut k: i16 = 300i16;\n"
+    "while i < 50 {\n"
+    "  j = 0;\n"
+    "  while j < 40 { s += j * 3 - i; j += 1; }\n"
+    "  i += 1;\n"
+    "}\n"
+    "while k > 0i16 { k -= 7i16; t += k << 4i16; }\n"
+  };
+  auto result = test::check_pass(test::build_function(source), ir::eliminate_loops);
+  CHECK(test::count(result.target, ir::opcode::Branch) == 0);
+  CHECK(result.after.steps * 100 < result.before.steps);
+  CHECK(result.log.size() == 3);
+}
+
+TEST_CASE("induction: keeps loops it cannot count or that may trap") {
+  auto source = test::analyzed {
+    "def mut i: i8 = 0i8, mut x: i64 = 27, mut n: i64 = 0, mut z: i64 = 0, mut q: i64 = 0;\n"
+    // Only stops once the counter wraps around.
+    "while i >= 0i8 { i += 1i8; }\n"
+    "while x != 1 { if x & 1 { x = 3 * x + 1; } else { x >>= 1; } n += 1; }\n"
+    "while z < 3 { q += 5 / (z - 2); z += 1; }\n"
+  };
+  auto result = test::check_pass(test::build_function(source), ir::eliminate_loops);
+  CHECK(result.log.empty());
+  CHECK(result.after.trap == 4);
+}
+
+TEST_CASE("induction: replaces multiplications by additions") {
+  auto source = test::analyzed {
+    "def mut i: i32 = 0i32, mut j: i32 = 0i32, mut s: i32 = 0i32, mut f: i32 = 3i32;\n"
+    "while i < 300i32 {\n"
+    "  j = 0i32;\n"
+    "  while j < 300i32 { s ^= j * i + (j << 2i32) * 5i32; j += 1i32; }\n"
+    "  i += 1i32;\n"
+    "  f = f * 3i32 - i * f;\n"
+    "}\n"
+  };
+  auto result = test::check_pass(test::build_function(source), ir::reduce_strength);
+  // Only `i * f` is left, since `f` changes in the loop.
+  CHECK(test::count(result.target, ir::opcode::Mul) == 2);
+  CHECK(result.log.size() == 1);
+  CHECK(result.log[0].line == 4);
+}
+
+TEST_CASE("induction: leaves products of products it has replaced") {
+  auto source = test::analyzed {
+    "def mut i: i64 = 0, mut s: i64 = 0, mut f: i64 = 3;\n"
+    "while i < 50 { s += (s || f) * (i * 15); f ^= s; i += 1; }\n"
+  };
+  auto result = test::check_pass(test::build_function(source), ir::reduce_strength);
+  CHECK(test::count(result.target, ir::opcode::Mul) == 1);
+  CHECK(result.log.size() == 1);
+
+  auto chained = test::analyzed {
+    "def mut n: i64 = 0, mut i: i64 = 0, mut s: i64 = 0;\n"
+    "n = s + 1000;\n"
+    "while i < n { def x: i64 = i * 3; def y: i64 = x * 5; s += y * x; i += 1; }\n"
+  };
+  auto reduced = test::check_pass(test::build_function(chained), ir::reduce_strength);
+  CHECK(reduced.log.size() == 1);
+}
@@ -0,0 +1,95 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-test/frontend.hpp>
+
+#include "thalia-ir/inliner.hpp"
+#include "thalia-ir/pipeline.hpp"
+#include "interpret.hpp"
+
+using namespace thalia;
+
+namespace {
+  // Inlines alone, or as part of the whole pipeline.
+  auto inline_all(test::analyzed const& source, bool optimized = false)
+    -> test::transformed<ir::module> {
+    auto pass = [&](ir::module& target, std::vector<ir::remark>* log) {
+      if (optimized)
+        ir::optimize(target, log);
+      else ir::inline_calls(target, log);
+    };
+    return test::check_pass(test::build_module(source), pass);
+  }
+}
+
+TEST_CASE("inliner: makes small helpers in hot loops free") {
+  auto result = inline_all(test::analyzed {
+    "global sq(x: i64): i64 { return x * x; }\n"
+    "global clamp(x: i64, top: i64): i64 { if x > top { return top; } return x; }\n"
+    "def mut s: i64 = 0, mut i: i64 = 0;\n"
+    "while i < 100 { s += clamp(sq(i), 5000); i += 1; }\n"
+  }, true);
+  CHECK(test::count(result.target.main, ir::opcode::Call) == 0);
+  CHECK(result.after.outputs == std::vector<std::int64_t> { 261'795, 100 });
+  CHECK(result.after.steps < result.before.steps);
+  REQUIRE(result.log.size() >= 2);
+  CHECK(result.log[0].line == 4);
+  CHECK(result.log[0].message == "call to sq inlined");
+}
+
+TEST_CASE("inliner: goes bottom-up and leaves recursion alone") {
+  auto result = inline_all(test::analyzed {
+    "global fib(n: i64): i64 { if n < 2 { return n; } return fib(n - 1) + fib(n - 2); }\n"
+    "global add(a: i64, b: i64): i64 { return a + b; }\n"
+    "global both(a: i64): i64 { return add(a, fib(a)); }\n"
+    "def mut s: i64 = both(10);\n"
+  });
+  // `add` went into `both` before `both` went into `main`, and `fib`
+  // came along once, still calling itself.
+  CHECK(test::count(result.target.functions[2], ir::opcode::Call) == 2);
+  CHECK(test::count(result.target.functions[0], ir::opcode::Call) == 2);
+  CHECK(test::count(result.target.main, ir::opcode::Call) == 2);
+  CHECK(result.after.outputs == std::vector<std::int64_t> { 65 });
+}
+
+TEST_CASE("inliner: keeps large callees out of line and traps where they do") {
+  auto code = std::string { "global big(x: i64): i64 { def mut a: [4]i64, mut y: i64 = x; a[x] = 1;" };
+  for (auto i = 0; i < 40; ++i)
+    code.append(" y = y * 3 + " + std::to_string(i) + ";");
+  code.append(" return y; }\n"
+    "def mut s: i64 = big(1) + big(2);\n"
+    "def mut t: i64 = big(7);\n"
+  );
+  auto result = inline_all(test::analyzed { code });
+  CHECK(test::count(result.target.main, ir::opcode::Call) == 3);
+  CHECK(result.after.trap == 1);
+  CHECK(result.log.empty());
+
+  // Once it has a single call, it moves rather than being copied.
+  auto once = inline_all(test::analyzed {
+    code.substr(0, code.find("\ndef") + 1) + "def mut s: i64 = big(5);\n"
+  });
+  CHECK(test::count(once.target.main, ir::opcode::Call) == 0);
+  CHECK(once.after.trap == 1);
+}
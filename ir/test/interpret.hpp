@@ -0,0 +1,308 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_IR_TEST_INTERPRET_
+#define _THALIA_IR_TEST_INTERPRET_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-sema/arith.hpp>
+#include <thalia-ir/builder.hpp>
+#include <thalia-ir/function.hpp>
+#include <thalia-ir/remark.hpp>
+#include <thalia-ir/verifier.hpp>
+#include <thalia-test/frontend.hpp>
+
+namespace thalia::test {
+  /**
+   * @brief How a function ran: its status and outputs, or the line of the
+   *   division by zero or the access out of range that stopped it, and the
+   *   number of instructions it took.
+   */
+  struct run_result {
+    std::int64_t status = 0;
+    std::vector<std::int64_t> outputs;
+    std::optional<std::int64_t> trap;
+    std::uint64_t steps = 0;
+  };
+
+  namespace detail {
+    /**
+     * @brief The number of calls that may be active at once before the
+     *   interpreter reports a stack overflow.
+     */
+    inline constexpr std::size_t call_depth = 10'000;
+
+    // Whether a call is returned right away by a tail call, which then
+    // runs in place of the function instead of on top of it.
+    inline auto is_tail_call(ir::function const& target, ir::value_id call)
+      -> bool {
+      auto const& code = target.block(target.at(call).parent).code;
+      if (code.size() < 2 || code[code.size() - 2] != call)
+        return false;
+      auto last = code.back();
+      auto args = target.operands(last);
+      return target.at(last).op == ir::opcode::Return && target.at(last).imm != 0
+        && (args.empty() || args[0] == call);
+    }
+
+    inline auto run(
+      ir::module const* program,
+      ir::function const& entry,
+      std::span<std::int64_t const> arguments,
+      std::uint64_t budget,
+      std::uint64_t& steps,
+      std::size_t depth
+    ) -> run_result {
+      using ir::opcode;
+      auto const* function = &entry;
+      auto params = std::vector<std::int64_t>(arguments.begin(), arguments.end());
+    restart:
+      auto const& target = *function;
+      auto values = std::vector<std::int64_t>(target.size(), 0);
+      auto arrays = std::vector<std::vector<std::int64_t>> {};
+      for (auto const& array: target.arrays())
+        arrays.emplace_back(array.length, 0);
+      auto block = ir::block_id { 0 };
+      auto from = ir::none;
+      auto incoming = std::vector<std::int64_t> {};
+      while (true) {
+        auto const& current = target.block(block);
+        if (from != ir::none) {
+          // Phis read their operands before any of them is written.
+          auto edge = std::size_t { 0 };
+          while (current.preds[edge] != from)
+            ++edge;
+          incoming.clear();
+          for (auto phi: current.phis)
+            incoming.push_back(values[target.operands(phi)[edge]]);
+          for (auto i = std::size_t { 0 }; i < current.phis.size(); ++i)
+            values[current.phis[i]] = incoming[i];
+        }
+
+        for (auto id: current.code) {
+          if (steps++ == budget)
+            throw std::runtime_error { "the function does not terminate" };
+          auto const& inst = target.at(id);
+          auto args = target.operands(id);
+          auto width = ir::width_of(inst.kind);
+          auto lhs = args.size() > 0 ? values[args[0]] : 0;
+          auto rhs = args.size() > 1 ? values[args[1]] : 0;
+          auto wrap = [&](std::uint64_t value) { return sema::wrap(value, width); };
+          auto ul = static_cast<std::uint64_t>(lhs);
+          auto ur = static_cast<std::uint64_t>(rhs);
+          auto shift = static_cast<std::uint64_t>(rhs) & (width - 1);
+          switch (inst.op) {
+            case opcode::Const: values[id] = inst.imm; break;
+            case opcode::Add: values[id] = wrap(ul + ur); break;
+            case opcode::Sub: values[id] = wrap(ul - ur); break;
+            case opcode::Mul: values[id] = wrap(ul * ur); break;
+            case opcode::Div:
+            case opcode::Mod:
+              if (rhs == 0)
+                return run_result { 0, {}, inst.imm, steps };
+              if (rhs == -1)
+                values[id] = inst.op == opcode::Div ? wrap(0 - ul) : 0;
+              else values[id] = inst.op == opcode::Div ? lhs / rhs : lhs % rhs;
+              break;
+            case opcode::Shl: values[id] = wrap(ul << shift); break;
+            case opcode::Shr: values[id] = lhs >> shift; break;
+            case opcode::And: values[id] = lhs & rhs; break;
+            case opcode::Or: values[id] = lhs | rhs; break;
+            case opcode::Xor: values[id] = lhs ^ rhs; break;
+            case opcode::Eq: values[id] = lhs == rhs; break;
+            case opcode::Ne: values[id] = lhs != rhs; break;
+            case opcode::Lt: values[id] = lhs < rhs; break;
+            case opcode::Le: values[id] = lhs <= rhs; break;
+            case opcode::Gt: values[id] = lhs > rhs; break;
+            case opcode::Ge: values[id] = lhs >= rhs; break;
+            case opcode::Neg: values[id] = wrap(0 - ul); break;
+            case opcode::Not: values[id] = ~lhs; break;
+            case opcode::Phi: break;
+            case opcode::Param: values[id] = params[static_cast<std::size_t>(inst.imm)]; break;
+            case opcode::Array: values[id] = inst.imm; break;
+            case opcode::Function: values[id] = inst.imm; break;
+            case opcode::Call: {
+              if (depth + 1 == call_depth)
+                return run_result { 0, {}, inst.imm, steps };
+              auto passed = std::vector<std::int64_t> {};
+              for (auto arg: args.subspan(1))
+                passed.push_back(values[arg]);
+              auto const& callee = program->functions[static_cast<std::size_t>(lhs)];
+              if (is_tail_call(target, id)) {
+                function = &callee;
+                params = std::move(passed);
+                goto restart;
+              }
+              auto result = run(program, callee, passed, budget, steps, depth + 1);
+              if (result.trap)
+                return result;
+              values[id] = result.status;
+              break;
+            }
+            case opcode::Load:
+            case opcode::Store: {
+              auto& elements = arrays[static_cast<std::size_t>(lhs)];
+              if (ur >= elements.size())
+                return run_result { 0, {}, inst.imm, steps };
+              if (inst.op == opcode::Load)
+                values[id] = elements[ur];
+              else elements[ur] = values[args[2]];
+              break;
+            }
+            case opcode::Clear:
+              std::fill(arrays[static_cast<std::size_t>(lhs)].begin(), arrays[static_cast<std::size_t>(lhs)].end(), 0);
+              break;
+            case opcode::Jump:
+              from = block;
+              block = current.succs[0];
+              break;
+            case opcode::Branch:
+              from = block;
+              block = current.succs[lhs != 0 ? 0 : 1];
+              break;
+            case opcode::Return: {
+              auto has_result = target.result() != ir::type::Void;
+              auto result = run_result { has_result ? lhs : 0, {}, std::nullopt, steps };
+              for (auto arg: args.subspan(has_result ? 1 : 0))
+                result.outputs.push_back(values[arg]);
+              return result;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief Runs a function directly on its SSA form, as the reference the
+   *   passes are checked against.
+   * @param target The function, which calls nothing.
+   * @param budget The number of instructions after which to give up.
+   * @return How it ran.
+   */
+  inline auto interpret(ir::function const& target, std::uint64_t budget = 100'000'000)
+    -> run_result {
+    auto steps = std::uint64_t { 0 };
+    return detail::run(nullptr, target, {}, budget, steps, 0);
+  }
+
+  /**
+   * @brief Runs the `main` of a module, with every call it makes.
+   * @param target The module.
+   * @param budget The number of instructions after which to give up.
+   * @return How it ran; a stack overflow stops it on the line of the call.
+   */
+  inline auto interpret(ir::module const& target, std::uint64_t budget = 100'000'000)
+    -> run_result {
+    auto steps = std::uint64_t { 0 };
+    return detail::run(&target, target.main, {}, budget, steps, 0);
+  }
+
+  /**
+   * @brief Builds the `main` of a program.
+   */
+  inline auto build_function(analyzed const& source)
+    -> ir::function {
+    return ir::builder { source.types, source.names, source.typing }.build(source.ast);
+  }
+
+  /**
+   * @brief Builds a program with all its functions.
+   */
+  inline auto build_module(analyzed const& source)
+    -> ir::module {
+    return ir::builder { source.types, source.names, source.typing }.build_module(source.ast);
+  }
+
+  /**
+   * @brief A program after a pass, with the remarks of the pass and how the
+   *   program ran before and after it.
+   */
+  template <typename Target>
+  struct transformed {
+    Target target;
+    std::vector<ir::remark> log;
+    run_result before;
+    run_result after;
+  };
+
+  /**
+   * @brief Runs a pass over a function or a module and checks that the
+   *   result verifies and runs the same way.
+   * @param target The program.
+   * @param pass Changes the program in place, given the log too when it
+   *   takes one.
+   * @return The changed program and how it ran.
+   */
+  template <typename Target, typename Pass>
+  auto check_pass(Target target, Pass&& pass)
+    -> transformed<Target> {
+    auto before = interpret(target);
+    auto log = std::vector<ir::remark> {};
+    if constexpr (std::is_invocable_v<Pass&, Target&, std::vector<ir::remark>*>)
+      pass(target, &log);
+    else pass(target);
+    auto error = ir::verify(target);
+    INFO((error ? error->reason : ""));
+    CHECK(!error);
+    auto after = interpret(target);
+    CHECK(after.status == before.status);
+    CHECK(after.outputs == before.outputs);
+    CHECK(after.trap == before.trap);
+    return transformed<Target> { std::move(target), std::move(log), before, after };
+  }
+
+  /**
+   * @brief Counts the instructions of a kind, phis included.
+   */
+  inline auto count(ir::function const& target, ir::opcode op)
+    -> std::size_t {
+    auto result = std::size_t { 0 };
+    for (auto id = ir::block_id { 0 }; id < target.block_count(); ++id) {
+      for (auto value: target.block(id).phis)
+        result += target.at(value).op == op;
+      for (auto value: target.block(id).code)
+        result += target.at(value).op == op;
+    }
+    return result;
+  }
+
+  /**
+   * @brief Counts the blocks that have not been removed.
+   */
+  inline auto blocks(ir::function const& target)
+    -> std::size_t {
+    auto result = std::size_t { 0 };
+    for (auto id = ir::block_id { 0 }; id < target.block_count(); ++id)
+      result += !target.block(id).removed;
+    return result;
+  }
+}
+
+#endif // _THALIA_IR_TEST_INTERPRET_
@@ -0,0 +1,129 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-test/frontend.hpp>
+
+#include "thalia-ir/licm.hpp"
+#include "thalia-ir/loops.hpp"
+#include "interpret.hpp"
+
+using namespace thalia;
+
+namespace {
+  // How many loops the most deeply nested instruction of a kind is in.
+  auto depth_of(ir::function const& target, ir::opcode op)
+    -> std::size_t {
+    auto tree = ir::dominator_tree { target };
+    auto loops = ir::find_loops(target, tree);
+    auto result = std::size_t { 0 };
+    for (auto id = ir::block_id { 0 }; id < target.block_count(); ++id) {
+      for (auto value: target.block(id).code) {
+        if (target.at(value).op != op)
+          continue;
+        auto depth = std::size_t { 0 };
+        for (auto const& loop: loops)
+          depth += std::find(loop.blocks.begin(), loop.blocks.end(), id) != loop.blocks.end();
+        result = std::max(result, depth);
+      }
+    }
+    return result;
+  }
+}
+
+TEST_CASE("licm: finds loops and gives them preheaders") {
+  auto source = test::analyzed {
+    "def mut i: i64 = 0, mut j: i64 = 0, mut s: i64 = 0;\n"
+    "while i < 10 {\n"
+    "  j = 0;\n"
+    "  while j < i { s += j; j += 1; }\n"
+    "  i += 1;\n"
+    "}\n"
+  };
+  auto function = test::check_pass(test::build_function(source), ir::hoist_invariants).target;
+  auto tree = ir::dominator_tree { function };
+  auto loops = ir::find_loops(function, tree);
+  REQUIRE(loops.size() == 2);
+  CHECK(loops[0].blocks.size() < loops[1].blocks.size());
+  CHECK(std::find(loops[1].blocks.begin(), loops[1].blocks.end(), loops[0].header) != loops[1].blocks.end());
+  for (auto const& loop: loops) {
+    CHECK(loop.preheader != ir::none);
+    CHECK(loop.latches.size() == 1);
+    CHECK(loop.blocks.front() == loop.header);
+  }
+}
+
+TEST_CASE("licm: hoists invariant work out of every loop it is invariant in") {
+  auto source = test::analyzed {
+    "def mut lo: i64 = 3, mut hi: i64 = 50, mut i: i64 = 0, mut j: i64 = 0, mut s: i64 = 0;\n"
+    "while i < 100 {\n"
+    "  j = 0;\n"
+    "  while j < 100 {\n"
+    "    s += (hi - lo) * (hi << 2) + j * i;\n"
+    "    j += 1;\n"
+    "  }\n"
+    "  i += 1;\n"
+    "}\n"
+  };
+  auto result = test::check_pass(test::build_function(source), ir::hoist_invariants);
+  CHECK(depth_of(result.target, ir::opcode::Sub) == 0);
+  CHECK(depth_of(result.target, ir::opcode::Shl) == 0);
+  // `j * i` only stays in the inner loop.
+  CHECK(depth_of(result.target, ir::opcode::Mul) == 2);
+  CHECK(result.after.steps < result.before.steps * 3 / 4);
+}
+
+TEST_CASE("licm: does not hoist a division that may trap out of a loop that does not run") {
+  auto source = test::analyzed {
+    "def mut n: i32 = 0i32, mut z: i32 = 0i32, mut s: i32 = 0i32;\n"
+    "while n > 0i32 {\n"
+    "  s += 10i32 / z;\n"
+    "  n -= 1i32;\n"
+    "}\n"
+    "while s < 4i32 {\n"
+    "  if s == 9i32 { s = 100i32 % z; }\n"
+    "  s += 1i32;\n"
+    "}\n"
+  };
+  auto result = test::check_pass(test::build_function(source), ir::hoist_invariants);
+  CHECK(!result.after.trap);
+  CHECK(depth_of(result.target, ir::opcode::Div) == 1);
+  CHECK(depth_of(result.target, ir::opcode::Mod) == 1);
+}
+
+TEST_CASE("licm: hoists a division that runs before the loop can be left") {
+  auto source = test::analyzed {
+    "def mut n: i64 = 600, mut d: i64 = 3, mut i: i64 = 0, mut s: i64 = 0;\n"
+    "while i < n / d {\n"
+    "  s += n % 7;\n"
+    "  i += 1;\n"
+    "}\n"
+    "d = 0;\n"
+    "while i > n / d { i -= 1; }\n"
+  };
+  auto result = test::check_pass(test::build_function(source), ir::hoist_invariants);
+  CHECK(depth_of(result.target, ir::opcode::Div) == 0);
+  CHECK(depth_of(result.target, ir::opcode::Mod) == 0);
+  CHECK(result.after.trap == 7);
+}
@@ -0,0 +1,110 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-test/frontend.hpp>
+
+#include "thalia-ir/builder.hpp"
+#include "thalia-ir/sccp.hpp"
+#include "interpret.hpp"
+
+using namespace thalia;
+
+TEST_CASE("sccp: folds with the exact width of each operation") {
+  auto source = test::analyzed {
+    "def mut a: i8 = 100i8, mut b: i16 = 1i16, mut c: i32 = 0i32;\n"
+    "a += 100i8;\n"
+    "b <<= 17i16;\n"
+    "c -= 1i32;\n"
+  };
+  auto function = test::check_pass(test::build_function(source), ir::propagate_constants).target;
+  CHECK(test::count(function, ir::opcode::Add) == 0);
+  CHECK(test::count(function, ir::opcode::Shl) == 0);
+  CHECK(test::count(function, ir::opcode::Sub) == 0);
+  CHECK(test::interpret(function).outputs == std::vector<std::int64_t> { -56, 2, -1 });
+}
+
+TEST_CASE("sccp: resolves conditions and prunes the branches not taken") {
+  auto source = test::analyzed {
+    "def mut x: i64 = 4, mut y: i64 = 0;\n"
+    "if x > 3 { y = 1; } else { y = 2; }\n"
+    "while y > 5 { y -= 1; }\n"
+    "if !(x == 4 && y == 1) { return 9i32; }\n"
+  };
+  auto function = test::check_pass(test::build_function(source), ir::propagate_constants).target;
+  CHECK(test::count(function, ir::opcode::Branch) == 0);
+  CHECK(test::count(function, ir::opcode::Phi) == 0);
+  CHECK(test::interpret(function).outputs == std::vector<std::int64_t> { 4, 1 });
+}
+
+TEST_CASE("sccp: finds constants that hold around loops") {
+  auto source = test::analyzed {
+    "def mut i: i64 = 0, mut flag: i64 = 0, mut total: i64 = 0;\n"
+    "while i < 10 {\n"
+    "  if flag != 0 { total = 100; }\n"
+    "  flag = flag * 2;\n"
+    "  total += i;\n"
+    "  i += 1;\n"
+    "}\n"
+  };
+  auto function = test::check_pass(test::build_function(source), ir::propagate_constants).target;
+  // Only the loop condition is left to test; `flag` is 0 on every trip.
+  CHECK(test::count(function, ir::opcode::Branch) == 1);
+  CHECK(test::count(function, ir::opcode::Mul) == 0);
+  CHECK(test::blocks(function) == 5);
+}
+
+TEST_CASE("sccp: leaves divisions by zero to trap") {
+  auto source = test::analyzed {
+    "def mut a: i32 = 7i32, mut b: i32 = 0i32;\n"
+    "if a > 0i32 { a = a / b; }\n"
+  };
+  auto function = test::check_pass(test::build_function(source), ir::propagate_constants).target;
+  CHECK(test::count(function, ir::opcode::Div) == 1);
+  CHECK(test::interpret(function).trap == 2);
+}
+
+TEST_CASE("sccp: hands constant expressions back to the syntax tree") {
+  auto source = test::analyzed {
+    "def mut n: i64 = 3, mut m: i64 = 0;\n"
+    "if n * 2 == 6 { m = n + 1; }\n"
+    "while m < n { m += 1; }\n"
+    "n = (m = 2) + 1;\n"
+    "if n / (m - m) && 0 { m = 5; }\n"
+  };
+  auto build = ir::builder { source.types, source.names, source.typing };
+  auto function = build.build(source.ast);
+  auto facts = ir::constant_facts { function };
+  CHECK(ir::export_constants(facts, build, source.values) > 0);
+
+  auto const& branch = static_cast<syntax::stmt_if const&>(*source.ast[1]);
+  auto const& loop = static_cast<syntax::stmt_while const&>(*source.ast[2]);
+  auto const& last = static_cast<syntax::stmt_expr const&>(*source.ast[3]);
+  CHECK(source.values.value(*branch.condition()) == 1);
+  CHECK(source.values.value(*loop.condition()) == 0);
+  // The value of an assignment is known, but the assignment still has to run.
+  CHECK(!source.values.value(*last.value()));
+  // So is the division by zero of a condition that is always false.
+  auto const& trapping = static_cast<syntax::stmt_if const&>(*source.ast[4]);
+  CHECK(!source.values.value(*trapping.condition()));
+}
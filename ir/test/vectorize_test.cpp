@@ -0,0 +1,88 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdint>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-test/frontend.hpp>
+
+#include "thalia-ir/builder.hpp"
+#include "thalia-ir/pipeline.hpp"
+#include "thalia-ir/vectorize.hpp"
+#include "thalia-ir/verifier.hpp"
+#include "interpret.hpp"
+
+using namespace thalia;
+
+namespace {
+  auto optimized(test::analyzed const& source)
+    -> ir::function {
+    REQUIRE(source.errors.errors == 0);
+    auto function = ir::builder { source.types, source.names, source.typing }.build(source.ast);
+    ir::optimize(function);
+    REQUIRE(!ir::verify(function));
+    return function;
+  }
+}
+
+TEST_CASE("vectorize: finds element-wise and reduction loops") {
+  auto source = test::analyzed {
+    "def mut a: [64]i32, mut b: [64]i32, mut i: i32 = 0i32, mut s: i32 = 0i32, mut m: i32 = -1i32;\n"
+    "def mut k: i32 = 3i32, mut n: i32 = 60i32;\n"
+    "while i < 64i32 { b[i] = i; i += 1i32; }\n"
+    "i = 0i32;\n"
+    "while i < n { a[i] = b[i] * k - (b[i] << 2i32); s += a[i]; i += 1i32; }\n"
+    "i = 0i32;\n"
+    "while n > i { m &= ~a[i]; i += 1i32; }\n"
+  };
+  auto function = optimized(source);
+  auto loops = ir::find_vector_loops(function);
+  REQUIRE(loops.size() == 2);
+  CHECK(loops[0].reductions.size() == 1);
+  CHECK(loops[0].arrays.size() == 2);
+  // `k` is broadcast, and so are the constant it is combined with.
+  CHECK(!loops[0].invariants.empty());
+  CHECK(loops[1].reductions.size() == 1);
+  CHECK(loops[1].arrays.size() == 1);
+  for (auto const& loop: loops) {
+    CHECK(function.at(loop.counter).op == ir::opcode::Phi);
+    CHECK(function.at(loop.counter).parent == loop.header);
+  }
+}
+
+TEST_CASE("vectorize: leaves loops whose iterations depend on each other") {
+  auto source = test::analyzed {
+    "def mut a: [64]i32, mut c: [64]i64, mut i: i32 = 1i32, mut s: i32 = 0i32, mut q: i32 = 0i32;\n"
+    // Reads the element the previous iteration wrote.
+    "while i < 64i32 { a[i] = a[i - 1i32] + 1i32; i += 1i32; }\n"
+    "i = 0i32;\n"
+    // Accesses elements of another width, divides and leaves early.
+    "while i < 64i32 { c[i] = 1; i += 1i32; }\n"
+    "i = 0i32;\n"
+    "while i < 64i32 { s += a[i] / 3i32; i += 1i32; }\n"
+    "i = 0i32;\n"
+    "while i < 64i32 { if a[i] > 9i32 { return 1i32; } i += 1i32; }\n"
+    // Uses the accumulator for more than the reduction.
+    "i = 0i32;\n"
+    "while i < 64i32 { q += a[i]; a[i] = q; i += 1i32; }\n"
+  };
+  auto function = optimized(source);
+  CHECK(ir::find_vector_loops(function).empty());
+}
@@ -0,0 +1,141 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-test/frontend.hpp>
+
+#include "thalia-ir/builder.hpp"
+#include "thalia-ir/dominators.hpp"
+#include "thalia-ir/verifier.hpp"
+
+using namespace thalia;
+
+namespace {
+  auto reason_of(ir::function const& target)
+    -> std::string {
+    auto error = ir::verify(target);
+    return error ? error->reason : "";
+  }
+
+  // The example loop: b0 jumps to the header b1, which branches to the
+  // body b2 or the exit b3.
+  auto example()
+    -> ir::function {
+    auto source = test::analyzed {
+      "def mut i: i32 = 0i32, mut s: i32 = 0i32;\n"
+      "while i <= 6i32 { s += i; i += 1i32; }\n"
+    };
+    return ir::builder { source.types, source.names, source.typing }.build(source.ast);
+  }
+}
+
+TEST_CASE("dominators: follow the structure of the loop") {
+  auto function = example();
+  auto tree = ir::dominator_tree { function };
+  CHECK(tree.order().size() == 4);
+  CHECK(tree.idom(1) == 0);
+  CHECK(tree.idom(2) == 1);
+  CHECK(tree.idom(3) == 1);
+  CHECK(tree.dominates(1, 2));
+  CHECK(!tree.dominates(2, 3));
+  CHECK(tree.dominates(3, 3));
+}
+
+TEST_CASE("verify: rejects malformed functions") {
+  REQUIRE(reason_of(example()) == "");
+
+  auto bad = example();
+  bad.remove(bad.terminator(3));
+  CHECK(reason_of(bad) == "block does not end in a terminator");
+
+  bad = example();
+  bad.add_edge(2, 3);
+  CHECK(reason_of(bad) == "successors do not match the terminator");
+
+  bad = example();
+  auto phi = bad.block(1).phis.front();
+  auto args = bad.operands(phi);
+  auto twice = std::vector<ir::value_id> { args[0], args[0], args[1] };
+  bad.set_operands(phi, twice);
+  CHECK(reason_of(bad) == "phi does not match the predecessors");
+
+  // A value of the body used in the header, which the entry also reaches.
+  bad = example();
+  auto step = bad.block(2).code.front();
+  auto test = bad.block(1).code.front();
+  bad.operands(test)[1] = step;
+  CHECK(reason_of(bad) == "operand does not dominate its use");
+
+  bad = example();
+  auto wide = bad.append(0, ir::opcode::Const, ir::type::I64, {}, 1);
+  auto& code = bad.block(0).code;
+  std::swap(code[code.size() - 1], code[code.size() - 2]);
+  bad.operands(step)[1] = wide;
+  CHECK(reason_of(bad) == "operand types do not match");
+
+  bad = example();
+  auto ret = bad.terminator(3);
+  bad.set_operands(ret, std::vector<ir::value_id> { bad.operands(ret)[0] });
+  CHECK(reason_of(bad) == "return does not report every output");
+
+  bad = example();
+  bad.remove(step);
+  CHECK(reason_of(bad) == "operand is not defined");
+}
+
+TEST_CASE("verify: checks calls against their callees") {
+  auto source = test::analyzed {
+    "global add(a: i32, b: i64): i32 { return a + 1i32; }\n"
+    "def mut x: i32 = add(1i32, 2);\n"
+  };
+  auto good = ir::builder { source.types, source.names, source.typing }.build_module(source.ast);
+  REQUIRE(!ir::verify(good));
+
+  auto call = ir::none;
+  for (auto value: good.main.block(0).code) {
+    if (good.main.at(value).op == ir::opcode::Call)
+      call = value;
+  }
+  REQUIRE(call != ir::none);
+
+  auto bad = good;
+  auto args = bad.main.operands(call);
+  bad.main.set_operands(call, std::vector<ir::value_id> { args[0], args[1] });
+  CHECK(ir::verify(bad)->reason == "wrong number of arguments");
+
+  bad = good;
+  args = bad.main.operands(call);
+  bad.main.set_operands(call, std::vector<ir::value_id> { args[0], args[2], args[1] });
+  CHECK(ir::verify(bad)->reason == "argument types do not match");
+
+  bad = good;
+  bad.main.at(bad.main.operands(call)[0]).imm = 1;
+  CHECK(ir::verify(bad)->reason == "function out of range");
+
+  bad = good;
+  for (auto value: bad.functions[0].block(0).code) {
+    if (bad.functions[0].at(value).op == ir::opcode::Param)
+      bad.functions[0].at(value).imm = 2;
+  }
+  auto error = ir::verify(bad);
+  REQUIRE(error);
+  CHECK(error->function == 0);
+  CHECK(error->reason == "parameter out of range");
+}
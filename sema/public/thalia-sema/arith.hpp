@@ -0,0 +1,112 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THALIA_SEMA_ARITH_
+#define _THALIA_SEMA_ARITH_
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include <thalia-syntax/token.hpp>
+
+namespace thalia::sema {
+  /**
+   * @brief Reports how an integer operation went.
+   */
+  enum class arith_status {
+    Ok,
+    Overflow,
+    DivByZero
+  };
+
+  /**
+   * @brief The value and status of an integer operation.
+   *
+   * The value is always the two's complement result, wrapped to the width of
+   * the operation, even when the status reports an overflow.
+   */
+  struct arith_result {
+    std::int64_t value;
+    arith_status status;
+  };
+
+  /**
+   * @brief Wraps a value to a width, sign-extending its low bits.
+   * @param value The value to wrap.
+   * @param width The width in bits (8, 16, 32 or 64).
+   * @return The wrapped value.
+   */
+  constexpr auto wrap(std::uint64_t value, std::size_t width)
+    -> std::int64_t {
+    auto shift = 64 - width;
+    return static_cast<std::int64_t>(value << shift) >> shift;
+  }
+
+  /**
+   * @brief Parses the digits of an integer literal.
+   * @param digits The decimal digits of the literal.
+   * @param width The width of the literal's type in bits.
+   * @param negated Whether to parse the negated literal `-digits` instead,
+   *   which may reach the magnitude of the smallest value.
+   * @return The value, wrapped on overflow.
+   */
+  extern auto parse_literal(std::string_view digits, std::size_t width, bool negated = false)
+    -> arith_result;
+
+  /**
+   * @brief Evaluates a binary operator on two values of the same width.
+   * @param operation The operator (arithmetic, bitwise, shift, comparison or logical).
+   * @param lhs The left operand.
+   * @param rhs The right operand; shift amounts are taken modulo the width.
+   * @param width The width of the operation in bits.
+   * @return The result of the operation.
+   *
+   * Division truncates toward zero, right shifts are arithmetic, and comparison
+   * and logical operators produce 0 or 1.
+   */
+  extern auto eval_binary(
+    syntax::token_type operation,
+    std::int64_t lhs,
+    std::int64_t rhs,
+    std::size_t width
+  ) -> arith_result;
+
+  /**
+   * @brief Evaluates a unary operator.
+   * @param operation The operator (`-`, `+`, `~` or `!`).
+   * @param value The operand.
+   * @param width The width of the operation in bits.
+   * @return The result of the operation.
+   */
+  extern auto eval_unary(
+    syntax::token_type operation,
+    std::int64_t value,
+    std::size_t width
+  ) -> arith_result;
+
+  /**
+   * @brief Maps a compound assignment operator to its binary operator.
+   * @param operation The assignment operator (e.g. `+=`).
+   * @return The binary operator (e.g. `+`), or `Assign` for plain assignments.
+   */
+  extern auto binary_of(syntax::token_type operation)
+    -> syntax::token_type;
+}
+
+#endif // _THALIA_SEMA_ARITH_
@@ -0,0 +1,205 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THALIA_SEMA_CHECKER_
+#define _THALIA_SEMA_CHECKER_
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <thalia-syntax/errors.hpp>
+#include <thalia-syntax/exprs.hpp>
+#include <thalia-syntax/stmts.hpp>
+#include <thalia-syntax/token.hpp>
+
+#include "node_map.hpp"
+#include "resolver.hpp"
+#include "types.hpp"
+
+namespace thalia::sema {
+  /**
+   * @brief The types of the parameters and the result of a function.
+   */
+  struct signature {
+    std::vector<type_id> params;
+    type_id result;
+
+    auto operator==(signature const&) const -> bool = default;
+  };
+
+  /**
+   * @brief The result of type checking: the type of every expression and slot,
+   *   and the signature of every function.
+   */
+  class typing {
+    public:
+      /**
+       * @brief Constructs an empty table for a program.
+       * @param slots The number of variable slots of the program.
+       * @param functions The number of functions of the program.
+       */
+      typing(std::size_t slots, std::size_t functions = 0)
+        : _exprs {}, _slots(slots), _functions(functions) {}
+
+      /**
+       * @brief Records the type of an expression.
+       * @param node The expression.
+       * @param type The type of its value.
+       */
+      auto set(syntax::expression const& node, type_id type) -> void
+        { _exprs.insert(&node, type); }
+
+      /**
+       * @brief Records the type of a variable slot.
+       * @param slot The slot index.
+       * @param type The declared type of the variable.
+       */
+      auto set_slot(std::size_t slot, type_id type) -> void
+        { _slots[slot] = type; }
+
+      /**
+       * @brief Gets the type of an expression.
+       * @param node The expression.
+       * @return Its type, or the error type if it was not checked.
+       */
+      auto type_of(syntax::expression const& node) const -> type_id;
+
+      /**
+       * @brief Gets the type of a variable slot.
+       * @param slot The slot index.
+       * @return The declared type of the variable.
+       */
+      auto slot_type(std::size_t slot) const -> type_id
+        { return _slots[slot]; }
+
+      /**
+       * @brief Records the signature of a function.
+       * @param function The function index.
+       * @param value The types of its parameters and result.
+       */
+      auto set_signature(std::size_t function, signature value) -> void;
+
+      /**
+       * @brief Gets the signature of a function.
+       * @param function The function index.
+       * @return The types of its parameters and result.
+       */
+      auto signature_of(std::size_t function) const -> signature const&
+        { return _functions[function]; }
+
+    private:
+      node_map<type_id> _exprs;
+      std::vector<type_id> _slots;
+      std::vector<signature> _functions;
+  };
+
+  /**
+   * @brief Checks that values are used at the types they were declared with.
+   *
+   * Thalia has no implicit conversions: both sides of a binary operator, an
+   * assignment or an initializer must have the same type. Shift amounts are the
+   * only exception and may be of any integer type. Integer literals without a
+   * suffix are `i64`, and the top-level code returns an `i32` exit status.
+   * Arrays `[N]T` hold between 1 and 65536 integers, are declared `mut` without
+   * an initializer and can only be indexed, by a value of any integer type.
+   *
+   * Functions take integers and return an integer or `void`; every argument
+   * must have the type of its parameter, and all declarations of a function
+   * must agree. A call of a `void` function can only be a statement of its
+   * own or the value a `void` function returns.
+   */
+  class type_checker {
+    public:
+      /**
+       * @brief Describes the types of errors the type checker can emit.
+       */
+      enum class error_type {
+        MismatchedOperands,
+        MismatchedAssign,
+        MismatchedInit,
+        MismatchedReturn,
+        VoidVariable,
+        ArrayLength,
+        ArrayInit,
+        ArrayAsValue,
+        NotAnArray,
+        VoidValue,
+        ArrayInSignature,
+        MismatchedDeclaration,
+        ArgumentCount,
+        MismatchedArgument
+      };
+
+      /**
+       * @brief Alias for a type checker error.
+       */
+      using error = syntax::error<error_type, syntax::token>;
+
+      /**
+       * @brief Alias for the type checker's error queue interface.
+       */
+      using error_queue = syntax::error_queue<error_type, syntax::token>;
+
+    public:
+      /**
+       * @brief Constructs a type checker.
+       * @param equeue Reference to an error queue used for reporting.
+       * @param types The table used to intern types.
+       * @param names The resolution of the program being checked.
+       */
+      type_checker(
+        error_queue& equeue,
+        type_table& types,
+        resolution const& names
+      ) : _errors { equeue }
+        , _types { types }
+        , _names { names } {}
+
+      /**
+       * @brief Checks all statements of a program in a single traversal.
+       * @param ast The top-level statements of the program.
+       * @return The types of all expressions and slots.
+       */
+      auto check(std::span<std::shared_ptr<syntax::statement> const> ast)
+        -> typing;
+
+      /**
+       * @brief Checks statements whose external slots are already typed.
+       * @param ast The statements to check.
+       * @param initial The types known before the traversal, sized for every
+       *   slot of the resolution.
+       * @return The types of all expressions and slots.
+       *
+       * External functions get the signature of the declaration they were
+       * resolved to.
+       */
+      auto check(
+        std::span<std::shared_ptr<syntax::statement> const> ast,
+        typing initial
+      ) -> typing;
+
+    private:
+      error_queue& _errors;
+      type_table& _types;
+      resolution const& _names;
+  };
+}
+
+#endif // _THALIA_SEMA_CHECKER_
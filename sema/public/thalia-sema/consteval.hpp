@@ -0,0 +1,165 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THALIA_SEMA_CONSTEVAL_
+#define _THALIA_SEMA_CONSTEVAL_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <thalia-syntax/errors.hpp>
+#include <thalia-syntax/exprs.hpp>
+#include <thalia-syntax/stmts.hpp>
+#include <thalia-syntax/token.hpp>
+
+#include "checker.hpp"
+#include "node_map.hpp"
+#include "resolver.hpp"
+#include "types.hpp"
+
+namespace thalia::sema {
+  /**
+   * @brief The values known at compile time: folded expressions and constants.
+   */
+  class constants {
+    public:
+      /**
+       * @brief Constructs an empty table for a program.
+       * @param slots The number of variable slots of the program.
+       */
+      constants(std::size_t slots)
+        : _exprs {}, _slots(slots) {}
+
+      /**
+       * @brief Records the value of a constant expression.
+       * @param node The expression.
+       * @param value Its value, sign-extended from the width of its type.
+       */
+      auto set(syntax::expression const& node, std::int64_t value) -> void
+        { _exprs.insert(&node, value); }
+
+      /**
+       * @brief Records the value of a constant variable.
+       * @param slot The slot of the variable.
+       * @param value Its value.
+       */
+      auto set_slot(std::size_t slot, std::int64_t value) -> void
+        { _slots[slot] = value; }
+
+      /**
+       * @brief Gets the value of an expression, if it is known at compile time.
+       * @param node The expression.
+       * @return The folded value, or nothing.
+       */
+      auto value(syntax::expression const& node) const -> std::optional<std::int64_t>;
+
+      /**
+       * @brief Gets the value of a variable, if it is a folded constant.
+       * @param slot The slot of the variable.
+       * @return The folded value, or nothing.
+       */
+      auto slot_value(std::size_t slot) const -> std::optional<std::int64_t>
+        { return _slots[slot]; }
+
+    private:
+      node_map<std::int64_t> _exprs;
+      std::vector<std::optional<std::int64_t>> _slots;
+  };
+
+  /**
+   * @brief Folds expressions and non-`mut` definitions known at compile time.
+   *
+   * Literals and constants combined by pure operators are evaluated with the
+   * exact two's complement semantics of their width (see `eval_binary`).
+   * Overflows, out-of-range literals, divisions by zero and constant indices
+   * outside their array are reported.
+   * Assignments and `mut` variables are never folded.
+   */
+  class const_evaluator {
+    public:
+      /**
+       * @brief Describes the types of errors the evaluator can emit.
+       */
+      enum class error_type {
+        LiteralOverflow,
+        Overflow,
+        DivByZero,
+        IndexOutOfRange
+      };
+
+      /**
+       * @brief Alias for a constant evaluation error.
+       */
+      using error = syntax::error<error_type, syntax::token>;
+
+      /**
+       * @brief Alias for the evaluator's error queue interface.
+       */
+      using error_queue = syntax::error_queue<error_type, syntax::token>;
+
+    public:
+      /**
+       * @brief Constructs a constant evaluator.
+       * @param equeue Reference to an error queue used for reporting.
+       * @param types The table the program's types were interned in.
+       * @param names The resolution of the program.
+       * @param typing The types of the program.
+       */
+      const_evaluator(
+        error_queue& equeue,
+        type_table const& types,
+        resolution const& names,
+        typing const& typing
+      ) : _errors { equeue }
+        , _types { types }
+        , _names { names }
+        , _typing { typing } {}
+
+      /**
+       * @brief Folds all constant expressions and definitions of a program.
+       * @param ast The top-level statements of the program.
+       * @return The values known at compile time.
+       */
+      auto evaluate(std::span<std::shared_ptr<syntax::statement> const> ast)
+        -> constants;
+
+      /**
+       * @brief Folds statements whose external constants are already known.
+       * @param ast The statements to fold.
+       * @param initial The values known before the traversal, sized for every
+       *   slot of the resolution.
+       * @return The values known at compile time.
+       */
+      auto evaluate(
+        std::span<std::shared_ptr<syntax::statement> const> ast,
+        constants initial
+      ) -> constants;
+
+    private:
+      error_queue& _errors;
+      type_table const& _types;
+      resolution const& _names;
+      typing const& _typing;
+  };
+}
+
+#endif // _THALIA_SEMA_CONSTEVAL_
@@ -0,0 +1,321 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THALIA_SEMA_DATABASE_
+#define _THALIA_SEMA_DATABASE_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include <thalia-syntax/lexer.hpp>
+#include <thalia-syntax/parser.hpp>
+#include <thalia-syntax/stmts.hpp>
+#include <thalia-syntax/token.hpp>
+
+#include "checker.hpp"
+#include "consteval.hpp"
+#include "resolver.hpp"
+#include "types.hpp"
+
+namespace thalia::sema {
+  /**
+   * @brief An error reported by any stage of the front end.
+   */
+  using diagnostic = std::variant<
+    syntax::lexer::error,
+    syntax::parser::error,
+    resolver::error,
+    type_checker::error,
+    const_evaluator::error
+  >;
+
+  /**
+   * @brief Enumerates the memoized queries of a `database`.
+   */
+  enum class query_kind {
+    Source,
+    Tokens,
+    Blocks,
+    Check,
+    Lookup
+  };
+
+  /**
+   * @brief Identifies one query applied to one argument.
+   */
+  struct query_key {
+    query_kind kind;
+    std::uint32_t id;
+  };
+
+  /**
+   * @brief A demand-driven, incremental front end.
+   *
+   * Every stage is a memoized query: the tokens of a file, its top-level
+   * blocks (one per top-level statement or function, with its syntax tree),
+   * the analysis (names, types and constants) of a block, and the lookup of a
+   * variable or a function name before a block. A query records the queries
+   * it reads while it runs; the result is reused as long as none of them
+   * changed since it was last verified.
+   *
+   * Each edit starts a new revision. Blocks whose tokens are unchanged keep
+   * their syntax tree, even if they moved, and their analysis is only redone
+   * when one of the outer declarations they use changed. Lexing and splitting
+   * a file into blocks stay linear in its size; everything else after an edit
+   * costs time proportional to the blocks it touched.
+   *
+   * Nodes and diagnostics handed out stay valid until the next edit. Nodes of
+   * a reused block keep the positions they were parsed with, diagnostics are
+   * relocated to where the block currently is.
+   */
+  class database {
+    public:
+      /**
+       * @brief Identifies a file of the database.
+       */
+      using file_id = std::uint32_t;
+
+      /**
+       * @brief A global counter of edits.
+       */
+      using revision = std::uint64_t;
+
+    public:
+      database() = default;
+      database(database const&) = delete;
+      auto operator=(database const&) -> database& = delete;
+
+      /**
+       * @brief Adds a file to the database.
+       * @param text The source code of the file.
+       * @return The identifier of the new file.
+       */
+      auto add_file(std::string text) -> file_id;
+
+      /**
+       * @brief Replaces the source code of a file, starting a new revision.
+       * @param file The file to edit.
+       * @param text The new source code.
+       */
+      auto set_source(file_id file, std::string text) -> void;
+
+      /**
+       * @brief Gets the source code of a file.
+       * @param file The file.
+       * @return The current source code.
+       */
+      auto source(file_id file) const -> std::string_view
+        { return *_files[file].text; }
+
+      /**
+       * @brief Gets the current revision.
+       * @return The number of edits made so far.
+       */
+      auto current() const -> revision
+        { return _revision; }
+
+      /**
+       * @brief Gets the tokens of a file.
+       * @param file The file.
+       * @return All tokens of the file, ending with `Eof`.
+       */
+      auto tokens(file_id file) -> std::span<syntax::token const>;
+
+      /**
+       * @brief Gets the number of top-level blocks of a file.
+       * @param file The file.
+       * @return The number of blocks.
+       */
+      auto blocks(file_id file) -> std::size_t;
+
+      /**
+       * @brief Gets the syntax tree of a top-level block.
+       * @param file The file.
+       * @param index The position of the block in the file.
+       * @return The statements of the block.
+       */
+      auto ast(file_id file, std::size_t index)
+        -> std::span<std::shared_ptr<syntax::statement> const>;
+
+      /**
+       * @brief Gets the resolved names of a top-level block.
+       * @param file The file.
+       * @param index The position of the block in the file.
+       * @return The resolution of the block; outer declarations it uses own
+       *   external slots.
+       */
+      auto names(file_id file, std::size_t index) -> resolution const&;
+
+      /**
+       * @brief Gets the type of an expression of a file.
+       * @param file The file.
+       * @param node An expression of one of the file's current blocks.
+       * @return Its type, or the error type if it is unknown.
+       */
+      auto type_of(file_id file, std::shared_ptr<syntax::expression> const& node)
+        -> type_id;
+
+      /**
+       * @brief Gets the diagnostics of all stages for a file.
+       * @param file The file.
+       * @return The errors in source order of the blocks.
+       */
+      auto diagnostics(file_id file) -> std::vector<diagnostic>;
+
+      /**
+       * @brief Gets the table the types of all files are interned in.
+       * @return The type table.
+       */
+      auto types() const -> type_table const&
+        { return _types; }
+
+      /**
+       * @brief Counts how many times a query was computed (not reused).
+       * @param kind The query.
+       * @return The number of computations since the database was created.
+       */
+      auto executions(query_kind kind) const -> std::size_t
+        { return _executions[static_cast<std::size_t>(kind)]; }
+
+    private:
+      struct memo {
+        revision verified = 0;
+        revision changed = 0;
+        std::vector<query_key> deps;
+      };
+
+      struct analysis {
+        resolution names;
+        typing types;
+        constants values;
+        std::vector<diagnostic> errors;
+      };
+
+      struct block {
+        file_id file = 0;
+        std::size_t position = 0;
+        std::uint64_t fingerprint = 0;
+        std::string text;
+        std::vector<syntax::token> tokens;
+        std::vector<std::shared_ptr<syntax::statement>> ast;
+        std::vector<diagnostic> errors;
+        std::unordered_map<std::string_view, std::uint32_t> lookups;
+        std::unordered_map<std::string_view, std::uint32_t> calls;
+        std::unique_ptr<analysis> result;
+        memo check;
+        bool alive = false;
+      };
+
+      struct binding {
+        syntax::stmt_local::variable const* declaration;
+        type_id type;
+        std::optional<std::int64_t> value;
+
+        auto operator==(binding const&) const -> bool = default;
+      };
+
+      struct lookup {
+        std::uint32_t owner = 0;
+        std::string name;
+        bool function = false;
+        std::optional<binding> value;
+        syntax::stmt_function const* callee = nullptr;
+        memo state;
+      };
+
+      struct placement {
+        std::uint32_t block;
+        std::size_t line;
+        std::size_t col;
+
+        auto operator==(placement const&) const -> bool = default;
+      };
+
+      struct declaration {
+        std::size_t position;
+        std::uint32_t block;
+        syntax::stmt_local::variable const* variable;
+      };
+
+      struct function_declaration {
+        std::size_t position;
+        syntax::stmt_function const* function;
+      };
+
+      struct file {
+        std::shared_ptr<std::string const> text;
+        memo source;
+        std::shared_ptr<std::string const> lexed;
+        std::vector<syntax::token> tokens;
+        std::vector<diagnostic> errors;
+        memo scanned;
+        std::vector<placement> layout;
+        std::unordered_map<std::string_view, std::vector<declaration>> scope;
+        std::unordered_map<std::string_view, std::vector<function_declaration>> functions;
+        memo split;
+        std::size_t checked = 0;
+        revision checked_at = 0;
+      };
+
+    private:
+      auto memo_of(query_key key) -> memo&;
+      auto read(query_key key) -> void;
+      auto refresh(query_key key) -> void;
+      auto outdated(query_key key) -> bool;
+      auto execute(query_key key) -> void;
+
+      auto compute_tokens(file_id id) -> bool;
+      auto compute_blocks(file_id id) -> bool;
+      auto compute_check(std::uint32_t id) -> bool;
+      auto compute_lookup(std::uint32_t id) -> bool;
+
+      auto find(std::uint32_t owner, std::string_view name) -> std::optional<binding>;
+      auto find_function(std::uint32_t owner, std::string_view name)
+        -> syntax::stmt_function const*;
+      auto lookup_of(std::uint32_t owner, std::string_view name, bool function)
+        -> std::uint32_t;
+      auto analyze(file_id file, std::size_t index) -> analysis const&;
+      auto make_block(file_id file, std::span<syntax::token const> range) -> std::uint32_t;
+      auto free_block(std::uint32_t id) -> void;
+
+    private:
+      revision _revision = 1;
+      type_table _types;
+      std::deque<file> _files;
+      std::deque<block> _blocks;
+      std::deque<lookup> _lookups;
+      std::map<char const*, std::uint32_t> _texts;
+      std::vector<std::uint32_t> _free_blocks;
+      std::vector<std::uint32_t> _free_lookups;
+      std::vector<std::vector<query_key>> _active;
+      std::array<std::size_t, 5> _executions {};
+  };
+}
+
+#endif // _THALIA_SEMA_DATABASE_
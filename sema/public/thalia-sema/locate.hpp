@@ -0,0 +1,37 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THALIA_SEMA_LOCATE_
+#define _THALIA_SEMA_LOCATE_
+
+#include <memory>
+
+#include <thalia-syntax/exprs.hpp>
+#include <thalia-syntax/token.hpp>
+
+namespace thalia::sema {
+  /**
+   * @brief Finds the token that marks where an expression starts in the source.
+   * @param node The expression to locate.
+   * @return The leftmost token of the expression, or a default token for null nodes.
+   */
+  extern auto locate(std::shared_ptr<syntax::expression> const& node)
+    -> syntax::token;
+}
+
+#endif // _THALIA_SEMA_LOCATE_
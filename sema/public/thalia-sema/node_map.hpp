@@ -0,0 +1,141 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THALIA_SEMA_NODE_MAP_
+#define _THALIA_SEMA_NODE_MAP_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace thalia::sema {
+  /**
+   * @brief A flat open-addressing table keyed by syntax tree node addresses.
+   * @tparam Value The value stored for each node; it must be default-constructible.
+   *
+   * Semantic passes keep their results in side tables instead of the tree itself.
+   * The table does not own the nodes, so it must not outlive the syntax tree.
+   */
+  template <typename Value>
+  class node_map {
+    public:
+      /**
+       * @brief Constructs an empty table.
+       */
+      node_map()
+        : _buckets {}, _size { 0 } {}
+
+      /**
+       * @brief Inserts a value for a node, replacing any previous one.
+       * @param key The address of the node.
+       * @param value The value to store.
+       */
+      auto insert(void const* key, Value const& value) -> void;
+
+      /**
+       * @brief Looks up the value stored for a node.
+       * @param key The address of the node.
+       * @return A pointer to the value, or nullptr if there is none.
+       */
+      auto find(void const* key) const -> Value const*;
+
+      /**
+       * @brief Reserves room for the given number of nodes.
+       * @param count The expected number of nodes.
+       */
+      auto reserve(std::size_t count) -> void;
+
+      /**
+       * @brief Gets the number of nodes in the table.
+       * @return The number of stored values.
+       */
+      auto size() const -> std::size_t
+        { return _size; }
+
+    private:
+      struct bucket {
+        void const* key = nullptr;
+        Value value {};
+      };
+
+      auto index_of(void const* key) const -> std::size_t;
+      auto rehash(std::size_t capacity) -> void;
+
+    private:
+      std::vector<bucket> _buckets;
+      std::size_t _size;
+  };
+
+  template <typename Value>
+  extern auto node_map<Value>::insert(void const* key, Value const& value)
+    -> void {
+    if ((_size + 1) * 2 > _buckets.size())
+      rehash(_buckets.empty() ? 64 : _buckets.size() * 2);
+
+    auto& target = _buckets[index_of(key)];
+    if (target.key == nullptr) {
+      target.key = key;
+      ++_size;
+    }
+    target.value = value;
+  }
+
+  template <typename Value>
+  extern auto node_map<Value>::find(void const* key) const
+    -> Value const* {
+    if (_buckets.empty())
+      return nullptr;
+    auto const& target = _buckets[index_of(key)];
+    return target.key == key ? &target.value : nullptr;
+  }
+
+  template <typename Value>
+  extern auto node_map<Value>::reserve(std::size_t count)
+    -> void {
+    auto capacity = std::size_t { 64 };
+    while (capacity < count * 2)
+      capacity *= 2;
+    if (capacity > _buckets.size())
+      rehash(capacity);
+  }
+
+  template <typename Value>
+  extern auto node_map<Value>::index_of(void const* key) const
+    -> std::size_t {
+    auto mask = _buckets.size() - 1;
+    auto hash = reinterpret_cast<std::uintptr_t>(key) >> 3;
+    auto index = static_cast<std::size_t>(hash * 0x9E3779B97F4A7C15ull) & mask;
+    while (_buckets[index].key != nullptr && _buckets[index].key != key)
+      index = (index + 1) & mask;
+    return index;
+  }
+
+  template <typename Value>
+  extern auto node_map<Value>::rehash(std::size_t capacity)
+    -> void {
+    auto old = std::vector<bucket>(capacity);
+    old.swap(_buckets);
+    for (auto& entry: old) {
+      if (entry.key != nullptr)
+        _buckets[index_of(entry.key)] = std::move(entry);
+    }
+  }
+}
+
+#endif // _THALIA_SEMA_NODE_MAP_
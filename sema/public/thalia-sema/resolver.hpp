@@ -0,0 +1,304 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THALIA_SEMA_RESOLVER_
+#define _THALIA_SEMA_RESOLVER_
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <thalia-syntax/errors.hpp>
+#include <thalia-syntax/exprs.hpp>
+#include <thalia-syntax/stmts.hpp>
+#include <thalia-syntax/token.hpp>
+
+#include "node_map.hpp"
+#include "symbol_table.hpp"
+
+namespace thalia::sema {
+  /**
+   * @brief The result of name resolution over a syntax tree.
+   *
+   * Every declared variable owns a slot, numbered in declaration order, and
+   * every resolved identifier is bound to the slot of its declaration. Every
+   * function gets an index, shared by its declarations and its definition,
+   * and every resolved call is bound to the index of its callee. The
+   * parameters and locals of a function take consecutive slots, parameters
+   * first.
+   */
+  class resolution {
+    public:
+      /**
+       * @brief The slot returned for nodes that were not resolved.
+       */
+      static constexpr std::size_t npos = symbol_table::npos;
+
+      /**
+       * @brief Describes the variable that owns a slot.
+       */
+      struct symbol {
+        syntax::stmt_local::variable const* declaration;
+        std::size_t depth;
+        bool external;
+        /** The index of the function the variable belongs to, or `npos`
+            for the top level. */
+        std::size_t owner;
+      };
+
+      /**
+       * @brief Describes a function.
+       */
+      struct function {
+        /** The first declaration or definition of the function. */
+        syntax::stmt_function const* declaration;
+        /** The definition, or nullptr if the function is only declared. */
+        syntax::stmt_function const* definition;
+        /** The first slot of its parameters and locals. */
+        std::size_t first;
+        /** The number of slots of its parameters and locals. */
+        std::size_t count;
+        /** Whether it was declared outside of the resolved statements. */
+        bool external;
+      };
+
+    public:
+      /**
+       * @brief Gets the slot of a top-level declaration made outside of the
+       *   resolved statements, allocating it on first use.
+       * @param declaration The declared variable.
+       * @return The slot index.
+       */
+      auto declare_external(syntax::stmt_local::variable const& declaration) -> std::size_t;
+
+      /**
+       * @brief Allocates a slot for a declaration.
+       * @param declaration The declared variable.
+       * @param depth The scope depth of the declaration (zero for top-level).
+       * @return The new slot index.
+       */
+      auto declare(
+        syntax::stmt_local::variable const& declaration,
+        std::size_t depth,
+        std::size_t owner = npos
+      ) -> std::size_t;
+
+      /**
+       * @brief Gets the index of a function declared outside of the resolved
+       *   statements, allocating it on first use.
+       * @param declaration The declaration or definition of the function.
+       * @return The function index.
+       */
+      auto declare_external(syntax::stmt_function const& declaration) -> std::size_t;
+
+      /**
+       * @brief Allocates an index for a function at its first declaration.
+       * @param declaration The declaration or definition.
+       * @return The new function index.
+       */
+      auto declare(syntax::stmt_function const& declaration) -> std::size_t;
+
+      /**
+       * @brief Records another declaration of a known function.
+       * @param function The function index.
+       * @param declaration The declaration or definition.
+       */
+      auto redeclare(std::size_t function, syntax::stmt_function const& declaration) -> void
+        { _functions_of.insert(&declaration, function); }
+
+      /**
+       * @brief Records the definition of a function and the slots it owns.
+       * @param function The function index.
+       * @param definition The definition.
+       * @param first The first slot of its parameters and locals.
+       * @param count The number of slots of its parameters and locals.
+       */
+      auto define(
+        std::size_t function,
+        syntax::stmt_function const& definition,
+        std::size_t first,
+        std::size_t count
+      ) -> void;
+
+      /**
+       * @brief Binds an identifier to a slot.
+       * @param node The identifier expression.
+       * @param slot The slot of its declaration.
+       */
+      auto bind(syntax::expr_id const& node, std::size_t slot) -> void
+        { _uses.insert(&node, slot); }
+
+      /**
+       * @brief Binds a call to the function it calls.
+       * @param node The call expression.
+       * @param function The index of the callee.
+       */
+      auto bind(syntax::expr_call const& node, std::size_t function) -> void
+        { _calls.insert(&node, function); }
+
+      /**
+       * @brief Gets the slot an identifier refers to.
+       * @param node The identifier expression.
+       * @return The slot index, or `npos` if the identifier was not resolved.
+       */
+      auto slot(syntax::expr_id const& node) const -> std::size_t;
+
+      /**
+       * @brief Gets the slot owned by a declaration.
+       * @param declaration The declared variable.
+       * @return The slot index, or `npos` if the declaration was not visited.
+       */
+      auto slot(syntax::stmt_local::variable const& declaration) const -> std::size_t;
+
+      /**
+       * @brief Gets the function a call calls.
+       * @param node The call expression.
+       * @return The function index, or `npos` if the call was not resolved.
+       */
+      auto callee(syntax::expr_call const& node) const -> std::size_t;
+
+      /**
+       * @brief Gets the function a declaration or definition declares.
+       * @param declaration The declaration or definition.
+       * @return The function index, or `npos` if it was not visited.
+       */
+      auto function_of(syntax::stmt_function const& declaration) const -> std::size_t;
+
+      /**
+       * @brief Gets the symbols of all slots, indexed by slot.
+       * @return A span of symbols.
+       */
+      auto symbols() const -> std::span<symbol const>
+        { return _symbols; }
+
+      /**
+       * @brief Gets all functions, indexed by function index.
+       * @return A span of functions.
+       */
+      auto functions() const -> std::span<function const>
+        { return _functions; }
+
+    private:
+      std::vector<symbol> _symbols;
+      std::vector<function> _functions;
+      node_map<std::size_t> _uses;
+      node_map<std::size_t> _decls;
+      node_map<std::size_t> _calls;
+      node_map<std::size_t> _functions_of;
+  };
+
+  /**
+   * @brief Binds identifiers to the variables they refer to.
+   *
+   * The resolver walks the syntax tree once, opening a scope for every block,
+   * and reports undeclared names, duplicate declarations and writes to
+   * variables that were not declared `mut`.
+   *
+   * Functions live apart from variables: a call names a function declared
+   * (by `use`) or defined before it, the function itself included. The body
+   * of a function only sees its parameters and its own locals, which share
+   * the outermost scope of the body.
+   */
+  class resolver {
+    public:
+      /**
+       * @brief Describes the types of errors the resolver can emit.
+       */
+      enum class error_type {
+        UndeclaredId,
+        AlreadyDeclared,
+        AssignToConst,
+        InvalidAssignTarget,
+        UndefinedFunction
+      };
+
+      /**
+       * @brief Alias for a resolver-specific error.
+       */
+      using error = syntax::error<error_type, syntax::token>;
+
+      /**
+       * @brief Alias for the resolver's error queue interface.
+       */
+      using error_queue = syntax::error_queue<error_type, syntax::token>;
+
+      /**
+       * @brief Supplies the top-level declarations that precede the resolved
+       *   statements, e.g. those of the other blocks of a file.
+       */
+      class environment {
+        public:
+          virtual ~environment() = default;
+
+          /**
+           * @brief Looks up a preceding top-level declaration.
+           * @param name The declared name.
+           * @return The declaration, or nullptr if there is none.
+           */
+          virtual auto find(std::string_view name)
+            -> syntax::stmt_local::variable const* = 0;
+
+          /**
+           * @brief Looks up a preceding top-level function.
+           * @param name The name of the function.
+           * @return Its last declaration or definition, or nullptr if there
+           *   is none.
+           */
+          virtual auto find_function(std::string_view)
+            -> syntax::stmt_function const*
+            { return nullptr; }
+      };
+
+    public:
+      /**
+       * @brief Constructs a resolver.
+       * @param equeue Reference to an error queue used for reporting.
+       */
+      resolver(error_queue& equeue)
+        : _errors { equeue } {}
+
+      /**
+       * @brief Resolves all names of a program.
+       * @param ast The top-level statements of the program.
+       * @return The slots of all declarations and identifiers.
+       *
+       * Functions that are declared but never defined are reported.
+       */
+      auto resolve(std::span<std::shared_ptr<syntax::statement> const> ast)
+        -> resolution;
+
+      /**
+       * @brief Resolves statements that follow other top-level declarations.
+       * @param ast The statements to resolve.
+       * @param outer The declarations visible before the statements.
+       * @return The slots of all declarations and identifiers; declarations
+       *   found in `outer` get slots and indices marked as external.
+       */
+      auto resolve(
+        std::span<std::shared_ptr<syntax::statement> const> ast,
+        environment& outer
+      ) -> resolution;
+
+    private:
+      error_queue& _errors;
+  };
+}
+
+#endif // _THALIA_SEMA_RESOLVER_
@@ -0,0 +1,111 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THALIA_SEMA_SYMBOL_TABLE_
+#define _THALIA_SEMA_SYMBOL_TABLE_
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace thalia::sema {
+  /**
+   * @brief A scoped symbol table mapping names to variable slots.
+   *
+   * All scopes share a single flat open-addressing table holding the innermost
+   * binding of every name. Shadowed bindings are saved in an undo log that is
+   * replayed when their scope is left, so entering and leaving scopes never
+   * allocates and every operation runs in expected constant time.
+   */
+  class symbol_table {
+    public:
+      /**
+       * @brief The slot returned for names that are not bound.
+       */
+      static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    public:
+      /**
+       * @brief Constructs a table with only the outermost scope open.
+       */
+      symbol_table()
+        : _entries {}, _undo {}, _marks {}, _used { 0 } {}
+
+      /**
+       * @brief Opens a new innermost scope.
+       */
+      auto enter_scope() -> void
+        { _marks.push_back(_undo.size()); }
+
+      /**
+       * @brief Closes the innermost scope, restoring the bindings it shadowed.
+       */
+      auto leave_scope() -> void;
+
+      /**
+       * @brief Binds a name to a slot in the innermost scope.
+       * @param name The name being declared; it must outlive the table.
+       * @param slot The slot the name refers to.
+       * @return False if the name is already declared in the innermost scope.
+       */
+      auto declare(std::string_view name, std::size_t slot) -> bool;
+
+      /**
+       * @brief Looks up the innermost binding of a name.
+       * @param name The name to look up.
+       * @return The bound slot, or `npos` if the name is not visible.
+       */
+      auto lookup(std::string_view name) const -> std::size_t;
+
+      /**
+       * @brief Gets the nesting depth of the innermost scope.
+       * @return Zero for the outermost scope.
+       */
+      auto depth() const -> std::size_t
+        { return _marks.size(); }
+
+    private:
+      struct entry {
+        std::string_view name;
+        std::uint64_t hash = 0;
+        std::size_t slot = npos;
+        std::size_t depth = 0;
+        bool used = false;
+      };
+
+      struct change {
+        std::size_t index;
+        std::size_t slot;
+        std::size_t depth;
+      };
+
+      static auto hash_of(std::string_view name) -> std::uint64_t;
+
+      auto index_of(std::string_view name, std::uint64_t hash) const -> std::size_t;
+      auto rehash(std::size_t capacity) -> void;
+
+    private:
+      std::vector<entry> _entries;
+      std::vector<change> _undo;
+      std::vector<std::size_t> _marks;
+      std::size_t _used;
+  };
+}
+
+#endif // _THALIA_SEMA_SYMBOL_TABLE_
@@ -0,0 +1,82 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THALIA_SEMA_TAIL_CALLS_
+#define _THALIA_SEMA_TAIL_CALLS_
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <thalia-syntax/exprs.hpp>
+#include <thalia-syntax/stmts.hpp>
+
+namespace thalia::sema {
+  /**
+   * @brief Why a call is, or is not, a tail call.
+   */
+  enum class tail_reason: std::uint8_t {
+    Tail,
+    TopLevel,
+    Operand,
+    NotReturned
+  };
+
+  /**
+   * @brief A call in the program along with its tail position.
+   */
+  struct call_site {
+    std::shared_ptr<syntax::expr_call> call;
+    tail_reason reason;
+    /** The function the call is in, or null at the top level. */
+    std::shared_ptr<syntax::stmt_function> caller;
+  };
+
+  /**
+   * @brief Finds the call a return statement hands its value to.
+   *
+   * Every backend turns this call into a jump when the return is in a
+   * function body, so a recursion written as `return f(...)` runs in
+   * constant stack space.
+   *
+   * @param node The return statement.
+   * @return The returned call (through parentheses), or null if the value is not a call.
+   */
+  extern auto tail_call_of(syntax::stmt_return const& node)
+    -> std::shared_ptr<syntax::expr_call>;
+
+  /**
+   * @brief Lists every call of a program, in source order, with its tail position.
+   * @param ast The statements of the program.
+   * @return The calls found in the program.
+   */
+  extern auto find_calls(std::span<std::shared_ptr<syntax::statement> const> ast)
+    -> std::vector<call_site>;
+
+  /**
+   * @brief Explains why a call is not a tail call.
+   * @param reason The tail position of the call.
+   * @return A short reason, or an empty view for tail calls.
+   */
+  extern auto describe(tail_reason reason)
+    -> std::string_view;
+}
+
+#endif // _THALIA_SEMA_TAIL_CALLS_
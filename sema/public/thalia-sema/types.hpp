@@ -0,0 +1,193 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THALIA_SEMA_TYPES_
+#define _THALIA_SEMA_TYPES_
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include <thalia-syntax/token.hpp>
+
+namespace thalia::sema {
+  /**
+   * @brief Enumerates the kinds of types in the Thalia type system.
+   */
+  enum class type_kind {
+    Error,
+    Void,
+    Int,
+    Array
+  };
+
+  /**
+   * @brief The largest number of elements an array may hold, small enough
+   *   for arrays to live on the stack of native code.
+   */
+  constexpr std::size_t max_array_length = std::size_t { 1 } << 16;
+
+  /**
+   * @brief A handle to an interned type.
+   *
+   * Two handles obtained from the same table are equal if and only if they
+   * name the same type. The default handle names the error type.
+   */
+  class type_id {
+    public:
+      constexpr type_id()
+        : _index { 0 } {}
+      constexpr explicit type_id(std::uint32_t index)
+        : _index { index } {}
+
+      /**
+       * @brief Gets the position of the type in its table.
+       * @return The index of the type.
+       */
+      constexpr auto index() const -> std::uint32_t
+        { return _index; }
+
+      constexpr auto operator==(type_id const& other) const -> bool
+        { return _index == other._index; }
+
+    private:
+      std::uint32_t _index;
+  };
+
+  /**
+   * @brief Describes a type. Types are interned, so they are compared by handle.
+   */
+  struct type {
+    type_kind kind;
+    /** The width in bits of an integer, or of the elements of an array. */
+    std::size_t width;
+    /** The type of the elements of an array. */
+    type_id element {};
+    /** The number of elements of an array. */
+    std::size_t length = 0;
+  };
+
+  /**
+   * @brief Interns types and hands out handles to them.
+   *
+   * The error, void and integer types are interned up front, so looking them
+   * up never allocates; array types are interned as they are named.
+   */
+  class type_table {
+    public:
+      /**
+       * @brief Constructs a table holding the builtin types.
+       */
+      type_table();
+
+      /**
+       * @brief Interns a type.
+       * @param target The type to intern.
+       * @return The handle of the type.
+       */
+      auto intern(type const& target) -> type_id;
+
+      /**
+       * @brief Gets the type behind a handle.
+       * @param id The handle of the type.
+       * @return The interned type.
+       */
+      auto get(type_id id) const -> type const&
+        { return _types[id.index()]; }
+
+      /**
+       * @brief Gets the handle of the error type, which is compatible with any type.
+       * @return The error type.
+       */
+      auto error_type() const -> type_id
+        { return type_id { 0 }; }
+
+      /**
+       * @brief Gets the handle of the void type.
+       * @return The void type.
+       */
+      auto void_type() const -> type_id
+        { return type_id { 1 }; }
+
+      /**
+       * @brief Gets the handle of a signed integer type.
+       * @param width The width of the type in bits (8, 16, 32 or 64).
+       * @return The integer type.
+       */
+      auto int_type(std::size_t width) const -> type_id;
+
+      /**
+       * @brief Gets the handle of the type named by a data type token.
+       * @param type The token type (`Void`, `I8`, `I16`, `I32` or `I64`).
+       * @return The named type, or the error type.
+       */
+      auto from_token(syntax::token_type type) const -> type_id;
+
+      /**
+       * @brief Interns a fixed-size array type.
+       * @param element The type of the elements, an integer type.
+       * @param length The number of elements.
+       * @return The array type.
+       */
+      auto array_type(type_id element, std::size_t length) -> type_id;
+
+      /**
+       * @brief Checks whether a type is a signed integer type.
+       * @param id The handle of the type.
+       * @return True for `i8`, `i16`, `i32` and `i64`.
+       */
+      auto is_int(type_id id) const -> bool
+        { return get(id).kind == type_kind::Int; }
+
+      /**
+       * @brief Checks whether a type is an array type.
+       * @param id The handle of the type.
+       * @return True for `[N]T`.
+       */
+      auto is_array(type_id id) const -> bool
+        { return get(id).kind == type_kind::Array; }
+
+      /**
+       * @brief Checks whether two types may be used where the same type is required.
+       * @param lhs The first type.
+       * @param rhs The second type.
+       * @return True if the types are equal or one of them is the error type.
+       */
+      auto compatible(type_id lhs, type_id rhs) const -> bool
+        { return lhs == rhs || lhs == error_type() || rhs == error_type(); }
+
+      /**
+       * @brief Prints the name of a type.
+       * @param os Output stream.
+       * @param id The handle of the type.
+       * @return Reference to the output stream.
+       */
+      auto print(std::ostream& os, type_id id) const -> std::ostream&;
+
+    private:
+      static auto key_of(type const& target) -> std::uint64_t;
+
+    private:
+      std::vector<type> _types;
+      std::unordered_map<std::uint64_t, type_id> _index;
+  };
+}
+
+#endif // _THALIA_SEMA_TYPES_
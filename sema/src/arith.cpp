@@ -0,0 +1,168 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <limits>
+
+#include "thalia-sema/arith.hpp"
+
+namespace thalia::sema {
+  static auto max_of(std::size_t width)
+    -> std::int64_t {
+    return static_cast<std::int64_t>((std::uint64_t { 1 } << (width - 1)) - 1);
+  }
+
+  static auto min_of(std::size_t width)
+    -> std::int64_t {
+    return -max_of(width) - 1;
+  }
+
+  static auto checked(std::uint64_t raw, bool overflow, std::size_t width)
+    -> arith_result {
+    auto value = wrap(raw, width);
+    return arith_result { value, overflow ? arith_status::Overflow : arith_status::Ok };
+  }
+
+  static auto add(std::int64_t lhs, std::int64_t rhs, std::size_t width)
+    -> arith_result {
+    auto raw = static_cast<std::uint64_t>(lhs) + static_cast<std::uint64_t>(rhs);
+    auto exact = static_cast<std::int64_t>(raw);
+    auto overflow = width == 64
+      ? ((lhs ^ exact) & (rhs ^ exact)) < 0
+      : exact < min_of(width) || exact > max_of(width);
+    return checked(raw, overflow, width);
+  }
+
+  static auto sub(std::int64_t lhs, std::int64_t rhs, std::size_t width)
+    -> arith_result {
+    auto raw = static_cast<std::uint64_t>(lhs) - static_cast<std::uint64_t>(rhs);
+    auto exact = static_cast<std::int64_t>(raw);
+    auto overflow = width == 64
+      ? ((lhs ^ rhs) & (lhs ^ exact)) < 0
+      : exact < min_of(width) || exact > max_of(width);
+    return checked(raw, overflow, width);
+  }
+
+  static auto mul(std::int64_t lhs, std::int64_t rhs, std::size_t width)
+    -> arith_result {
+    auto raw = static_cast<std::uint64_t>(lhs) * static_cast<std::uint64_t>(rhs);
+    auto exact = static_cast<std::int64_t>(raw);
+    auto overflow = false;
+    if (width < 64)
+      overflow = exact < min_of(width) || exact > max_of(width);
+    else if (lhs == -1)
+      overflow = rhs == min_of(64);
+    else if (rhs == -1)
+      overflow = lhs == min_of(64);
+    else if (rhs != 0)
+      overflow = exact / rhs != lhs;
+    return checked(raw, overflow, width);
+  }
+
+  static auto div(std::int64_t lhs, std::int64_t rhs, std::size_t width, bool rem)
+    -> arith_result {
+    if (rhs == 0)
+      return arith_result { 0, arith_status::DivByZero };
+    // The only quotient that does not fit is MIN / -1, which wraps to MIN.
+    if (rhs == -1 && lhs == min_of(width)) {
+      return rem
+        ? arith_result { 0, arith_status::Ok }
+        : arith_result { lhs, arith_status::Overflow };
+    }
+    return arith_result { rem ? lhs % rhs : lhs / rhs, arith_status::Ok };
+  }
+
+  extern auto parse_literal(std::string_view digits, std::size_t width, bool negated)
+    -> arith_result {
+    auto limit = static_cast<std::uint64_t>(max_of(width)) + (negated ? 1 : 0);
+    auto value = std::uint64_t { 0 };
+    auto overflow = false;
+    for (auto c: digits) {
+      auto digit = static_cast<std::uint64_t>(c - '0');
+      if (value > (std::numeric_limits<std::uint64_t>::max() - digit) / 10)
+        overflow = true;
+      value = value * 10 + digit;
+    }
+    overflow = overflow || value > limit;
+    return checked(negated ? 0 - value : value, overflow, width);
+  }
+
+  extern auto eval_binary(
+    syntax::token_type operation,
+    std::int64_t lhs,
+    std::int64_t rhs,
+    std::size_t width
+  ) -> arith_result {
+    using t = syntax::token_type;
+    auto ulhs = static_cast<std::uint64_t>(lhs);
+    auto urhs = static_cast<std::uint64_t>(rhs);
+    auto amount = urhs & (width - 1);
+    switch (operation) {
+      case t::Plus: return add(lhs, rhs, width);
+      case t::Minus: return sub(lhs, rhs, width);
+      case t::Mul: return mul(lhs, rhs, width);
+      case t::Div: return div(lhs, rhs, width, false);
+      case t::Mod: return div(lhs, rhs, width, true);
+      case t::LShift: return checked(ulhs << amount, false, width);
+      case t::RShift: return checked(static_cast<std::uint64_t>(lhs >> amount), false, width);
+      case t::BitAnd: return checked(ulhs & urhs, false, width);
+      case t::BitOr: return checked(ulhs | urhs, false, width);
+      case t::Xor: return checked(ulhs ^ urhs, false, width);
+      case t::LogAnd: return arith_result { lhs && rhs, arith_status::Ok };
+      case t::LogOr: return arith_result { lhs || rhs, arith_status::Ok };
+      case t::Less: return arith_result { lhs < rhs, arith_status::Ok };
+      case t::LessEqual: return arith_result { lhs <= rhs, arith_status::Ok };
+      case t::Grt: return arith_result { lhs > rhs, arith_status::Ok };
+      case t::GrtEqual: return arith_result { lhs >= rhs, arith_status::Ok };
+      case t::Equal: return arith_result { lhs == rhs, arith_status::Ok };
+      case t::NotEqual: return arith_result { lhs != rhs, arith_status::Ok };
+      default: return arith_result { rhs, arith_status::Ok };
+    }
+  }
+
+  extern auto eval_unary(
+    syntax::token_type operation,
+    std::int64_t value,
+    std::size_t width
+  ) -> arith_result {
+    using t = syntax::token_type;
+    switch (operation) {
+      case t::Minus: return sub(0, value, width);
+      case t::BitNot: return checked(~static_cast<std::uint64_t>(value), false, width);
+      case t::LogNot: return arith_result { !value, arith_status::Ok };
+      default: return arith_result { value, arith_status::Ok };
+    }
+  }
+
+  extern auto binary_of(syntax::token_type operation)
+    -> syntax::token_type {
+    using t = syntax::token_type;
+    switch (operation) {
+      case t::PlusAssign: return t::Plus;
+      case t::MinusAssign: return t::Minus;
+      case t::MulAssign: return t::Mul;
+      case t::DivAssign: return t::Div;
+      case t::ModAssign: return t::Mod;
+      case t::AndAssign: return t::BitAnd;
+      case t::OrAssign: return t::BitOr;
+      case t::XorAssign: return t::Xor;
+      case t::LshAssign: return t::LShift;
+      case t::RshAssign: return t::RShift;
+      default: return t::Assign;
+    }
+  }
+}
@@ -0,0 +1,443 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <utility>
+
+#include "thalia-sema/arith.hpp"
+#include "thalia-sema/checker.hpp"
+#include "thalia-sema/locate.hpp"
+
+namespace thalia::sema {
+  namespace {
+    struct context {
+      type_checker::error_queue& errors;
+      type_table& types;
+      resolution const& names;
+      typing& result;
+      type_id return_type;
+    };
+
+    // Where a value is used: arrays are only used by indexing them, and
+    // the `void` result of a call only where it is dropped or returned.
+    enum class usage { Value, Indexed, Dropped };
+
+    class expr_checker
+      : public syntax::expr_visitor<context&, type_id> {
+      public:
+        expr_checker(std::shared_ptr<syntax::expression> const& node, usage use = usage::Value)
+          : syntax::expr_visitor<context&, type_id> { node }, _use { use } {}
+
+        auto check(context& ctx) -> type_id;
+
+      protected:
+        auto visit_expr_assign(context& ctx) -> type_id override;
+        auto visit_expr_binary(context& ctx) -> type_id override;
+        auto visit_expr_unary(context& ctx) -> type_id override;
+        auto visit_expr_paren(context& ctx) -> type_id override;
+        auto visit_expr_base_lit(context& ctx) -> type_id override;
+        auto visit_expr_id(context& ctx) -> type_id override;
+        auto visit_expr_index(context& ctx) -> type_id override;
+        auto visit_expr_call(context& ctx) -> type_id override;
+        auto visit_expr_data_type(context& ctx) -> type_id override;
+        auto visit_expr_array_type(context& ctx) -> type_id override;
+
+      private:
+        usage _use;
+    };
+
+    class stmt_checker
+      : public syntax::stmt_visitor<context&, void> {
+      public:
+        stmt_checker(std::shared_ptr<syntax::statement> const& node)
+          : syntax::stmt_visitor<context&, void> { node } {}
+
+        auto check(context& ctx) -> void
+          { if (_node) visit_stmt(ctx); }
+
+      protected:
+        auto visit_stmt_block(context& ctx) -> void override;
+        auto visit_stmt_return(context& ctx) -> void override;
+        auto visit_stmt_expr(context& ctx) -> void override;
+        auto visit_stmt_if(context& ctx) -> void override;
+        auto visit_stmt_while(context& ctx) -> void override;
+        auto visit_stmt_local(context& ctx) -> void override;
+        auto visit_stmt_function(context& ctx) -> void override;
+    };
+
+    static auto is_shift(syntax::token const& operation)
+      -> bool {
+      return operation.is({
+        syntax::token_type::LShift,
+        syntax::token_type::RShift,
+        syntax::token_type::LshAssign,
+        syntax::token_type::RshAssign
+      });
+    }
+
+    extern auto expr_checker::check(context& ctx)
+      -> type_id {
+      if (!_node)
+        return ctx.types.error_type();
+      auto type = visit_expr(ctx);
+      if (ctx.types.is_array(type) && _use != usage::Indexed && !_node->is(syntax::expr_type::ArrayType)) {
+        ctx.errors << type_checker::error {
+          type_checker::error_type::ArrayAsValue,
+          locate(_node)
+        };
+        type = ctx.types.error_type();
+      }
+      if (type == ctx.types.void_type() && _use != usage::Dropped && !_node->is(syntax::expr_type::DataType)) {
+        ctx.errors << type_checker::error {
+          type_checker::error_type::VoidValue,
+          locate(_node)
+        };
+        type = ctx.types.error_type();
+      }
+      ctx.result.set(*_node, type);
+      return type;
+    }
+
+    extern auto expr_checker::visit_expr_assign(context& ctx)
+      -> type_id {
+      auto root = std::static_pointer_cast<syntax::expr_assign>(_node);
+      auto target = expr_checker { root->target() }.check(ctx);
+      auto value = expr_checker { root->value() }.check(ctx);
+
+      auto valid = is_shift(root->operation())
+        ? value == ctx.types.error_type() || ctx.types.is_int(value)
+        : ctx.types.compatible(target, value);
+      if (!valid) {
+        ctx.errors << type_checker::error {
+          type_checker::error_type::MismatchedAssign,
+          root->operation()
+        };
+      }
+      return target;
+    }
+
+    extern auto expr_checker::visit_expr_binary(context& ctx)
+      -> type_id {
+      auto root = std::static_pointer_cast<syntax::expr_binary>(_node);
+      auto lhs = expr_checker { root->lhs() }.check(ctx);
+      auto rhs = expr_checker { root->rhs() }.check(ctx);
+
+      if (is_shift(root->operation()))
+        return lhs;
+      if (!ctx.types.compatible(lhs, rhs)) {
+        ctx.errors << type_checker::error {
+          type_checker::error_type::MismatchedOperands,
+          root->operation()
+        };
+        return ctx.types.error_type();
+      }
+      return lhs == ctx.types.error_type() ? rhs : lhs;
+    }
+
+    extern auto expr_checker::visit_expr_unary(context& ctx)
+      -> type_id {
+      auto root = std::static_pointer_cast<syntax::expr_unary>(_node);
+      return expr_checker { root->value() }.check(ctx);
+    }
+
+    extern auto expr_checker::visit_expr_paren(context& ctx)
+      -> type_id {
+      auto root = std::static_pointer_cast<syntax::expr_paren>(_node);
+      return expr_checker { root->value() }.check(ctx);
+    }
+
+    extern auto expr_checker::visit_expr_base_lit(context& ctx)
+      -> type_id {
+      auto root = std::static_pointer_cast<syntax::expr_base_lit>(_node);
+      if (!root->data_type())
+        return ctx.types.int_type(64);
+      return expr_checker { root->data_type() }.check(ctx);
+    }
+
+    extern auto expr_checker::visit_expr_id(context& ctx)
+      -> type_id {
+      auto root = std::static_pointer_cast<syntax::expr_id>(_node);
+      auto slot = ctx.names.slot(*root);
+      return slot == resolution::npos
+        ? ctx.types.error_type()
+        : ctx.result.slot_type(slot);
+    }
+
+    extern auto expr_checker::visit_expr_index(context& ctx)
+      -> type_id {
+      auto root = std::static_pointer_cast<syntax::expr_index>(_node);
+      auto target = expr_checker { root->target(), usage::Indexed }.check(ctx);
+      expr_checker { root->index() }.check(ctx);
+
+      if (target == ctx.types.error_type())
+        return target;
+      if (!ctx.types.is_array(target)) {
+        ctx.errors << type_checker::error {
+          type_checker::error_type::NotAnArray,
+          root->bracket()
+        };
+        return ctx.types.error_type();
+      }
+      return ctx.types.get(target).element;
+    }
+
+    extern auto expr_checker::visit_expr_call(context& ctx)
+      -> type_id {
+      auto root = std::static_pointer_cast<syntax::expr_call>(_node);
+      auto args = std::vector<type_id> {};
+      for (auto const& arg: root->args())
+        args.push_back(expr_checker { arg }.check(ctx));
+
+      auto function = ctx.names.callee(*root);
+      if (function == resolution::npos)
+        return ctx.types.error_type();
+      auto const& callee = ctx.result.signature_of(function);
+      if (args.size() != callee.params.size()) {
+        ctx.errors << type_checker::error {
+          type_checker::error_type::ArgumentCount,
+          root->callee()
+        };
+        return callee.result;
+      }
+      for (auto i = std::size_t { 0 }; i < args.size(); ++i) {
+        if (ctx.types.compatible(callee.params[i], args[i]))
+          continue;
+        ctx.errors << type_checker::error {
+          type_checker::error_type::MismatchedArgument,
+          locate(root->args()[i])
+        };
+      }
+      return callee.result;
+    }
+
+    extern auto expr_checker::visit_expr_data_type(context& ctx)
+      -> type_id {
+      auto root = std::static_pointer_cast<syntax::expr_data_type>(_node);
+      return ctx.types.from_token(root->target().type());
+    }
+
+    extern auto expr_checker::visit_expr_array_type(context& ctx)
+      -> type_id {
+      auto root = std::static_pointer_cast<syntax::expr_array_type>(_node);
+      auto element = expr_checker { root->element() }.check(ctx);
+      auto length = parse_literal(root->length().value(), 64);
+      auto valid = length.status == arith_status::Ok
+        && length.value >= 1 && static_cast<std::size_t>(length.value) <= max_array_length;
+      if (!valid || !ctx.types.is_int(element)) {
+        if (element != ctx.types.error_type()) {
+          ctx.errors << type_checker::error {
+            type_checker::error_type::ArrayLength,
+            root->length()
+          };
+        }
+        return ctx.types.error_type();
+      }
+      return ctx.types.array_type(element, static_cast<std::size_t>(length.value));
+    }
+
+    extern auto stmt_checker::visit_stmt_block(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_block>(_node);
+      for (auto const& node: root->content())
+        stmt_checker { node }.check(ctx);
+    }
+
+    extern auto stmt_checker::visit_stmt_return(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_return>(_node);
+      auto returns_void = ctx.return_type == ctx.types.void_type();
+      if (!root->value()) {
+        if (!returns_void) {
+          ctx.errors << type_checker::error {
+            type_checker::error_type::MismatchedReturn,
+            root->keyword()
+          };
+        }
+        return;
+      }
+
+      auto use = returns_void ? usage::Dropped : usage::Value;
+      auto value = expr_checker { root->value(), use }.check(ctx);
+      if (!ctx.types.compatible(value, ctx.return_type)) {
+        ctx.errors << type_checker::error {
+          type_checker::error_type::MismatchedReturn,
+          locate(root->value())
+        };
+      }
+    }
+
+    extern auto stmt_checker::visit_stmt_expr(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_expr>(_node);
+      expr_checker { root->value(), usage::Dropped }.check(ctx);
+    }
+
+    extern auto stmt_checker::visit_stmt_if(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_if>(_node);
+      expr_checker { root->condition() }.check(ctx);
+      stmt_checker { root->main_body() }.check(ctx);
+      stmt_checker { root->else_body() }.check(ctx);
+    }
+
+    extern auto stmt_checker::visit_stmt_while(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_while>(_node);
+      expr_checker { root->condition() }.check(ctx);
+      stmt_checker { root->body() }.check(ctx);
+    }
+
+    extern auto stmt_checker::visit_stmt_local(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_local>(_node);
+      for (auto const& variable: root->content()) {
+        auto declared = expr_checker { variable.data_type }.check(ctx);
+        if (declared == ctx.types.void_type()) {
+          ctx.errors << type_checker::error {
+            type_checker::error_type::VoidVariable,
+            variable.id
+          };
+          declared = ctx.types.error_type();
+        }
+        if (ctx.types.is_array(declared) && (!variable.mut || variable.value)) {
+          ctx.errors << type_checker::error {
+            type_checker::error_type::ArrayInit,
+            variable.id
+          };
+          declared = ctx.types.error_type();
+        }
+
+        auto slot = ctx.names.slot(variable);
+        if (slot != resolution::npos)
+          ctx.result.set_slot(slot, declared);
+
+        if (!variable.value)
+          continue;
+        auto value = expr_checker { variable.value }.check(ctx);
+        if (!ctx.types.compatible(declared, value)) {
+          ctx.errors << type_checker::error {
+            type_checker::error_type::MismatchedInit,
+            variable.id
+          };
+        }
+      }
+    }
+
+    // The types a declaration gives its parameters and result. Parameters
+    // are integers, results integers or `void`.
+    auto signature_of(context& ctx, syntax::stmt_function const& root, bool report)
+      -> signature {
+      auto result = signature {};
+      for (auto const& param: root.params()) {
+        auto declared = expr_checker { param.data_type }.check(ctx);
+        if (declared == ctx.types.void_type() || ctx.types.is_array(declared)) {
+          if (report) {
+            ctx.errors << type_checker::error {
+              declared == ctx.types.void_type()
+                ? type_checker::error_type::VoidVariable
+                : type_checker::error_type::ArrayInSignature,
+              param.id
+            };
+          }
+          declared = ctx.types.error_type();
+        }
+        result.params.push_back(declared);
+      }
+
+      result.result = expr_checker { root.data_type() }.check(ctx);
+      if (ctx.types.is_array(result.result)) {
+        if (report) {
+          ctx.errors << type_checker::error {
+            type_checker::error_type::ArrayInSignature,
+            root.id()
+          };
+        }
+        result.result = ctx.types.error_type();
+      }
+      return result;
+    }
+
+    extern auto stmt_checker::visit_stmt_function(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_function>(_node);
+      auto function = ctx.names.function_of(*root);
+      auto declared = signature_of(ctx, *root, true);
+      if (function == resolution::npos)
+        return;
+
+      auto const& known = ctx.names.functions()[function];
+      if (known.declaration == root.get()) {
+        ctx.result.set_signature(function, declared);
+      } else if (declared != ctx.result.signature_of(function)) {
+        ctx.errors << type_checker::error {
+          type_checker::error_type::MismatchedDeclaration,
+          root->id()
+        };
+      }
+
+      if (!root->body() || known.definition != root.get())
+        return;
+      auto params = root->params();
+      for (auto i = std::size_t { 0 }; i < params.size(); ++i) {
+        auto slot = ctx.names.slot(params[i]);
+        if (slot != resolution::npos)
+          ctx.result.set_slot(slot, declared.params[i]);
+      }
+
+      auto inner = context { ctx.errors, ctx.types, ctx.names, ctx.result, declared.result };
+      stmt_checker { root->body() }.check(inner);
+    }
+  }
+
+  extern auto typing::set_signature(std::size_t function, signature value)
+    -> void {
+    if (function >= _functions.size())
+      _functions.resize(function + 1);
+    _functions[function] = std::move(value);
+  }
+
+  extern auto typing::type_of(syntax::expression const& node) const
+    -> type_id {
+    auto const* result = _exprs.find(&node);
+    return result ? *result : type_id {};
+  }
+
+  extern auto type_checker::check(
+    std::span<std::shared_ptr<syntax::statement> const> ast
+  ) -> typing {
+    return check(ast, typing { _names.symbols().size(), _names.functions().size() });
+  }
+
+  extern auto type_checker::check(
+    std::span<std::shared_ptr<syntax::statement> const> ast,
+    typing initial
+  ) -> typing {
+    auto result = std::move(initial);
+    auto ctx = context {
+      _errors, _types, _names, result,
+      _types.int_type(32)
+    };
+    auto functions = _names.functions();
+    for (auto function = std::size_t { 0 }; function < functions.size(); ++function) {
+      if (functions[function].external)
+        result.set_signature(function, signature_of(ctx, *functions[function].declaration, false));
+    }
+    for (auto const& node: ast)
+      stmt_checker { node }.check(ctx);
+    return result;
+  }
+}
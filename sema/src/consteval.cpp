@@ -0,0 +1,306 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <utility>
+
+#include "thalia-sema/consteval.hpp"
+#include "thalia-sema/arith.hpp"
+
+namespace thalia::sema {
+  namespace {
+    using value_type = std::optional<std::int64_t>;
+
+    struct context {
+      const_evaluator::error_queue& errors;
+      type_table const& types;
+      resolution const& names;
+      typing const& expr_types;
+      constants& result;
+    };
+
+    class expr_evaluator
+      : public syntax::expr_visitor<context&, value_type> {
+      public:
+        expr_evaluator(std::shared_ptr<syntax::expression> const& node)
+          : syntax::expr_visitor<context&, value_type> { node } {}
+
+        auto evaluate(context& ctx) -> value_type;
+
+      protected:
+        auto visit_expr_assign(context& ctx) -> value_type override;
+        auto visit_expr_binary(context& ctx) -> value_type override;
+        auto visit_expr_unary(context& ctx) -> value_type override;
+        auto visit_expr_paren(context& ctx) -> value_type override;
+        auto visit_expr_base_lit(context& ctx) -> value_type override;
+        auto visit_expr_id(context& ctx) -> value_type override;
+        auto visit_expr_index(context& ctx) -> value_type override;
+        auto visit_expr_call(context& ctx) -> value_type override;
+        auto visit_expr_data_type(context&) -> value_type override
+          { return std::nullopt; }
+        auto visit_expr_array_type(context&) -> value_type override
+          { return std::nullopt; }
+
+      private:
+        auto width_of(context& ctx, std::shared_ptr<syntax::expression> const& node)
+          -> std::size_t;
+        auto report(context& ctx, arith_result result, syntax::token const& target)
+          -> value_type;
+    };
+
+    class stmt_evaluator
+      : public syntax::stmt_visitor<context&, void> {
+      public:
+        stmt_evaluator(std::shared_ptr<syntax::statement> const& node)
+          : syntax::stmt_visitor<context&, void> { node } {}
+
+        auto evaluate(context& ctx) -> void
+          { if (_node) visit_stmt(ctx); }
+
+      protected:
+        auto visit_stmt_block(context& ctx) -> void override;
+        auto visit_stmt_return(context& ctx) -> void override;
+        auto visit_stmt_expr(context& ctx) -> void override;
+        auto visit_stmt_if(context& ctx) -> void override;
+        auto visit_stmt_while(context& ctx) -> void override;
+        auto visit_stmt_local(context& ctx) -> void override;
+        auto visit_stmt_function(context& ctx) -> void override;
+    };
+
+    extern auto expr_evaluator::evaluate(context& ctx)
+      -> value_type {
+      if (!_node)
+        return std::nullopt;
+      auto value = visit_expr(ctx);
+      if (value)
+        ctx.result.set(*_node, *value);
+      return value;
+    }
+
+    extern auto expr_evaluator::width_of(
+      context& ctx,
+      std::shared_ptr<syntax::expression> const& node
+    ) -> std::size_t {
+      auto const& type = ctx.types.get(ctx.expr_types.type_of(*node));
+      return type.kind == type_kind::Int ? type.width : 0;
+    }
+
+    extern auto expr_evaluator::report(
+      context& ctx,
+      arith_result result,
+      syntax::token const& target
+    ) -> value_type {
+      switch (result.status) {
+        case arith_status::Ok:
+          break;
+        case arith_status::Overflow:
+          ctx.errors << const_evaluator::error {
+            const_evaluator::error_type::Overflow, target
+          };
+          break;
+        case arith_status::DivByZero:
+          ctx.errors << const_evaluator::error {
+            const_evaluator::error_type::DivByZero, target
+          };
+          return std::nullopt;
+      }
+      return result.value;
+    }
+
+    extern auto expr_evaluator::visit_expr_assign(context& ctx)
+      -> value_type {
+      auto root = std::static_pointer_cast<syntax::expr_assign>(_node);
+      expr_evaluator { root->target() }.evaluate(ctx);
+      expr_evaluator { root->value() }.evaluate(ctx);
+      return std::nullopt;
+    }
+
+    extern auto expr_evaluator::visit_expr_binary(context& ctx)
+      -> value_type {
+      auto root = std::static_pointer_cast<syntax::expr_binary>(_node);
+      auto lhs = expr_evaluator { root->lhs() }.evaluate(ctx);
+      auto rhs = expr_evaluator { root->rhs() }.evaluate(ctx);
+      auto width = width_of(ctx, root->lhs());
+      if (!lhs || !rhs || width == 0)
+        return std::nullopt;
+
+      auto operation = root->operation();
+      auto result = eval_binary(operation.type(), *lhs, *rhs, width);
+      return report(ctx, result, operation);
+    }
+
+    extern auto expr_evaluator::visit_expr_unary(context& ctx)
+      -> value_type {
+      auto root = std::static_pointer_cast<syntax::expr_unary>(_node);
+      auto operation = root->operation();
+      auto width = width_of(ctx, _node);
+      auto const& value = root->value();
+
+      // `-128i8` is a single literal rather than the negation of `128i8`.
+      if (operation.is(syntax::token_type::Minus)
+          && value && value->is(syntax::expr_type::BaseLit) && width != 0) {
+        auto literal = std::static_pointer_cast<syntax::expr_base_lit>(value);
+        auto result = parse_literal(literal->target().value(), width, true);
+        if (result.status != arith_status::Ok) {
+          ctx.errors << const_evaluator::error {
+            const_evaluator::error_type::LiteralOverflow,
+            literal->target()
+          };
+        }
+        return result.value;
+      }
+
+      auto operand = expr_evaluator { value }.evaluate(ctx);
+      if (!operand || width == 0)
+        return std::nullopt;
+      return report(ctx, eval_unary(operation.type(), *operand, width), operation);
+    }
+
+    extern auto expr_evaluator::visit_expr_paren(context& ctx)
+      -> value_type {
+      auto root = std::static_pointer_cast<syntax::expr_paren>(_node);
+      return expr_evaluator { root->value() }.evaluate(ctx);
+    }
+
+    extern auto expr_evaluator::visit_expr_base_lit(context& ctx)
+      -> value_type {
+      auto root = std::static_pointer_cast<syntax::expr_base_lit>(_node);
+      auto width = width_of(ctx, _node);
+      if (width == 0)
+        return std::nullopt;
+
+      auto result = parse_literal(root->target().value(), width);
+      if (result.status != arith_status::Ok) {
+        ctx.errors << const_evaluator::error {
+          const_evaluator::error_type::LiteralOverflow,
+          root->target()
+        };
+      }
+      return result.value;
+    }
+
+    extern auto expr_evaluator::visit_expr_id(context& ctx)
+      -> value_type {
+      auto root = std::static_pointer_cast<syntax::expr_id>(_node);
+      auto slot = ctx.names.slot(*root);
+      if (slot == resolution::npos)
+        return std::nullopt;
+      return ctx.result.slot_value(slot);
+    }
+
+    extern auto expr_evaluator::visit_expr_index(context& ctx)
+      -> value_type {
+      auto root = std::static_pointer_cast<syntax::expr_index>(_node);
+      expr_evaluator { root->target() }.evaluate(ctx);
+      auto index = expr_evaluator { root->index() }.evaluate(ctx);
+
+      // Elements are never constant, but a constant index can be checked.
+      auto const& array = ctx.types.get(ctx.expr_types.type_of(*root->target()));
+      if (index && array.kind == type_kind::Array
+        && (*index < 0 || static_cast<std::uint64_t>(*index) >= array.length)) {
+        ctx.errors << const_evaluator::error {
+          const_evaluator::error_type::IndexOutOfRange,
+          root->bracket()
+        };
+      }
+      return std::nullopt;
+    }
+
+    extern auto expr_evaluator::visit_expr_call(context& ctx)
+      -> value_type {
+      // Calls are never folded, even on constant arguments.
+      auto root = std::static_pointer_cast<syntax::expr_call>(_node);
+      for (auto const& arg: root->args())
+        expr_evaluator { arg }.evaluate(ctx);
+      return std::nullopt;
+    }
+
+    extern auto stmt_evaluator::visit_stmt_block(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_block>(_node);
+      for (auto const& node: root->content())
+        stmt_evaluator { node }.evaluate(ctx);
+    }
+
+    extern auto stmt_evaluator::visit_stmt_return(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_return>(_node);
+      expr_evaluator { root->value() }.evaluate(ctx);
+    }
+
+    extern auto stmt_evaluator::visit_stmt_expr(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_expr>(_node);
+      expr_evaluator { root->value() }.evaluate(ctx);
+    }
+
+    extern auto stmt_evaluator::visit_stmt_if(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_if>(_node);
+      expr_evaluator { root->condition() }.evaluate(ctx);
+      stmt_evaluator { root->main_body() }.evaluate(ctx);
+      stmt_evaluator { root->else_body() }.evaluate(ctx);
+    }
+
+    extern auto stmt_evaluator::visit_stmt_while(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_while>(_node);
+      expr_evaluator { root->condition() }.evaluate(ctx);
+      stmt_evaluator { root->body() }.evaluate(ctx);
+    }
+
+    extern auto stmt_evaluator::visit_stmt_local(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_local>(_node);
+      for (auto const& variable: root->content()) {
+        auto value = expr_evaluator { variable.value }.evaluate(ctx);
+        auto slot = ctx.names.slot(variable);
+        if (value && !variable.mut && slot != resolution::npos)
+          ctx.result.set_slot(slot, *value);
+      }
+    }
+
+    extern auto stmt_evaluator::visit_stmt_function(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_function>(_node);
+      stmt_evaluator { root->body() }.evaluate(ctx);
+    }
+  }
+
+  extern auto constants::value(syntax::expression const& node) const
+    -> std::optional<std::int64_t> {
+    auto const* result = _exprs.find(&node);
+    return result ? std::optional { *result } : std::nullopt;
+  }
+
+  extern auto const_evaluator::evaluate(
+    std::span<std::shared_ptr<syntax::statement> const> ast
+  ) -> constants {
+    return evaluate(ast, constants { _names.symbols().size() });
+  }
+
+  extern auto const_evaluator::evaluate(
+    std::span<std::shared_ptr<syntax::statement> const> ast,
+    constants initial
+  ) -> constants {
+    auto result = std::move(initial);
+    auto ctx = context { _errors, _types, _names, _typing, result };
+    for (auto const& node: ast)
+      stmt_evaluator { node }.evaluate(ctx);
+    return result;
+  }
+}
@@ -0,0 +1,581 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <iterator>
+#include <unordered_map>
+#include <utility>
+
+#include "thalia-sema/database.hpp"
+#include "thalia-sema/locate.hpp"
+
+namespace thalia::sema {
+  namespace {
+    class recorder
+      : public syntax::lexer::error_queue
+      , public syntax::parser::error_queue
+      , public resolver::error_queue
+      , public type_checker::error_queue
+      , public const_evaluator::error_queue {
+      public:
+        auto operator<<(syntax::lexer::error const& error) -> recorder& override
+          { errors.emplace_back(error); return *this; }
+        auto operator<<(syntax::parser::error const& error) -> recorder& override
+          { errors.emplace_back(error); return *this; }
+        auto operator<<(resolver::error const& error) -> recorder& override
+          { errors.emplace_back(error); return *this; }
+        auto operator<<(type_checker::error const& error) -> recorder& override
+          { errors.emplace_back(error); return *this; }
+        auto operator<<(const_evaluator::error const& error) -> recorder& override
+          { errors.emplace_back(error); return *this; }
+
+      public:
+        std::vector<diagnostic> errors;
+    };
+
+    class discard: public syntax::lexer::error_queue {
+      public:
+        auto operator<<(syntax::lexer::error const&) -> discard& override
+          { return *this; }
+    };
+
+    auto same_tokens(
+      std::span<syntax::token const> lhs,
+      std::span<syntax::token const> rhs
+    ) -> bool {
+      return std::equal(
+        lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+        [](auto const& a, auto const& b) {
+          return a.type() == b.type() && a.value() == b.value()
+            && a.line() == b.line() && a.col() == b.col();
+        }
+      );
+    }
+
+    // Positions are taken relative to the first token, so a block keeps its
+    // fingerprint when it moves but not when its layout changes.
+    auto relative(syntax::token const& origin, syntax::token const& target)
+      -> std::pair<std::size_t, std::size_t> {
+      auto line = target.line() - origin.line();
+      auto col = line == 0 ? target.col() - origin.col() : target.col();
+      return { line, col };
+    }
+
+    auto same_shape(
+      std::span<syntax::token const> lhs,
+      std::span<syntax::token const> rhs
+    ) -> bool {
+      return std::equal(
+        lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+        [&](auto const& a, auto const& b) {
+          return a.type() == b.type() && a.value() == b.value()
+            && relative(lhs.front(), a) == relative(rhs.front(), b);
+        }
+      );
+    }
+
+    auto fingerprint(std::span<syntax::token const> range)
+      -> std::uint64_t {
+      auto hash = std::uint64_t { 14695981039346656037ull };
+      auto mix = [&](std::uint64_t value) {
+        hash ^= value;
+        hash *= 1099511628211ull;
+      };
+      for (auto const& token: range) {
+        auto [line, col] = relative(range.front(), token);
+        mix(static_cast<std::uint64_t>(token.type()));
+        mix(line);
+        mix(col);
+        for (auto c: token.value())
+          mix(static_cast<unsigned char>(c));
+      }
+      return hash;
+    }
+
+    auto relocate(
+      diagnostic const& error,
+      syntax::token const& origin,
+      std::size_t line,
+      std::size_t col
+    ) -> diagnostic {
+      return std::visit([&](auto copy) -> diagnostic {
+        auto const& target = copy.target;
+        auto moved = target.line() == origin.line()
+          ? syntax::token { target.type(), target.value(), line, target.col() - origin.col() + col }
+          : syntax::token { target.type(), target.value(), target.line() - origin.line() + line, target.col() };
+        copy.target = moved;
+        return copy;
+      }, error);
+    }
+  }
+
+  extern auto database::add_file(std::string text)
+    -> file_id {
+    auto id = static_cast<file_id>(_files.size());
+    auto& target = _files.emplace_back();
+    target.text = std::make_shared<std::string const>(std::move(text));
+    target.source.verified = _revision;
+    target.source.changed = _revision;
+    return id;
+  }
+
+  extern auto database::set_source(file_id id, std::string text)
+    -> void {
+    auto& target = _files[id];
+    if (*target.text == text)
+      return;
+    ++_revision;
+    target.text = std::make_shared<std::string const>(std::move(text));
+    target.source.verified = _revision;
+    target.source.changed = _revision;
+  }
+
+  extern auto database::tokens(file_id id)
+    -> std::span<syntax::token const> {
+    read(query_key { query_kind::Tokens, id });
+    return _files[id].tokens;
+  }
+
+  extern auto database::blocks(file_id id)
+    -> std::size_t {
+    read(query_key { query_kind::Blocks, id });
+    return _files[id].layout.size();
+  }
+
+  extern auto database::ast(file_id id, std::size_t index)
+    -> std::span<std::shared_ptr<syntax::statement> const> {
+    read(query_key { query_kind::Blocks, id });
+    return _blocks[_files[id].layout[index].block].ast;
+  }
+
+  extern auto database::names(file_id id, std::size_t index)
+    -> resolution const& {
+    return analyze(id, index).names;
+  }
+
+  extern auto database::type_of(
+    file_id id,
+    std::shared_ptr<syntax::expression> const& node
+  ) -> type_id {
+    read(query_key { query_kind::Blocks, id });
+    auto start = locate(node).value().data();
+    auto owner = _texts.upper_bound(start);
+    if (!start || owner == _texts.begin())
+      return _types.error_type();
+
+    auto const& target = _blocks[std::prev(owner)->second];
+    auto end = target.text.data() + target.text.size();
+    if (!target.alive || target.file != id || start >= end)
+      return _types.error_type();
+    return analyze(id, target.position).types.type_of(*node);
+  }
+
+  extern auto database::diagnostics(file_id id)
+    -> std::vector<diagnostic> {
+    read(query_key { query_kind::Tokens, id });
+    read(query_key { query_kind::Blocks, id });
+    auto const& target = _files[id];
+    auto result = target.errors;
+    for (auto index = std::size_t { 0 }; index < target.layout.size(); ++index) {
+      auto const& where = target.layout[index];
+      auto const& result_of = analyze(id, index);
+      auto const& origin = _blocks[where.block].tokens.front();
+      for (auto const& error: _blocks[where.block].errors)
+        result.push_back(relocate(error, origin, where.line, where.col));
+      for (auto const& error: result_of.errors)
+        result.push_back(relocate(error, origin, where.line, where.col));
+    }
+    return result;
+  }
+
+  extern auto database::memo_of(query_key key)
+    -> memo& {
+    switch (key.kind) {
+      case query_kind::Source: return _files[key.id].source;
+      case query_kind::Tokens: return _files[key.id].scanned;
+      case query_kind::Blocks: return _files[key.id].split;
+      case query_kind::Check: return _blocks[key.id].check;
+      case query_kind::Lookup: return _lookups[key.id].state;
+    }
+    return _lookups[key.id].state;
+  }
+
+  extern auto database::read(query_key key)
+    -> void {
+    refresh(key);
+    if (!_active.empty())
+      _active.back().push_back(key);
+  }
+
+  extern auto database::refresh(query_key key)
+    -> void {
+    auto& state = memo_of(key);
+    if (state.verified == _revision)
+      return;
+    if (key.kind == query_kind::Source) {
+      state.verified = _revision;
+      return;
+    }
+    if (state.verified != 0 && !outdated(key)) {
+      memo_of(key).verified = _revision;
+      return;
+    }
+    execute(key);
+  }
+
+  extern auto database::outdated(query_key key)
+    -> bool {
+    // Dependencies are visited in the order they were read, so a query stops
+    // at the first change before it reaches inputs that may no longer exist.
+    auto deps = memo_of(key).deps;
+    auto verified = memo_of(key).verified;
+    for (auto dep: deps) {
+      refresh(dep);
+      if (memo_of(dep).changed > verified)
+        return true;
+    }
+    return false;
+  }
+
+  extern auto database::execute(query_key key)
+    -> void {
+    _active.emplace_back();
+    ++_executions[static_cast<std::size_t>(key.kind)];
+
+    auto changed = true;
+    switch (key.kind) {
+      case query_kind::Source: break;
+      case query_kind::Tokens: changed = compute_tokens(key.id); break;
+      case query_kind::Blocks: changed = compute_blocks(key.id); break;
+      case query_kind::Check: changed = compute_check(key.id); break;
+      case query_kind::Lookup: changed = compute_lookup(key.id); break;
+    }
+
+    auto& state = memo_of(key);
+    state.deps = std::move(_active.back());
+    _active.pop_back();
+    if (changed || state.verified == 0)
+      state.changed = _revision;
+    state.verified = _revision;
+  }
+
+  extern auto database::compute_tokens(file_id id)
+    -> bool {
+    read(query_key { query_kind::Source, id });
+    auto& target = _files[id];
+    auto errors = recorder {};
+    auto text = target.text;
+    auto tokens = syntax::lexer { errors, *text }.scan_all();
+    if (target.lexed && errors.errors.empty() && target.errors.empty()
+        && same_tokens(tokens, target.tokens))
+      return false;
+
+    target.lexed = std::move(text);
+    target.tokens = std::move(tokens);
+    target.errors = std::move(errors.errors);
+    return true;
+  }
+
+  extern auto database::compute_blocks(file_id id)
+    -> bool {
+    read(query_key { query_kind::Tokens, id });
+    auto& target = _files[id];
+
+    auto previous = std::unordered_multimap<std::uint64_t, std::uint32_t> {};
+    for (auto const& where: target.layout)
+      previous.emplace(_blocks[where.block].fingerprint, where.block);
+
+    // A block is one top-level statement: it ends at a `;` or a `}` outside
+    // of any braces, unless an `else` follows.
+    auto const& tokens = target.tokens;
+    auto size = tokens.size() - 1;
+    auto layout = std::vector<placement> {};
+    for (auto index = std::size_t { 0 }; index < size;) {
+      auto start = index;
+      auto depth = std::size_t { 0 };
+      for (; index < size; ++index) {
+        auto const& token = tokens[index];
+        if (token.is(syntax::token_type::LBrace)) {
+          ++depth;
+        } else if (token.is(syntax::token_type::RBrace)) {
+          if (depth > 0)
+            --depth;
+          if (depth == 0 && !tokens[index + 1].is(syntax::token_type::Else)) {
+            ++index;
+            break;
+          }
+        } else if (token.is(syntax::token_type::Semi) && depth == 0) {
+          ++index;
+          break;
+        }
+      }
+
+      auto range = std::span { tokens }.subspan(start, index - start);
+      auto hash = fingerprint(range);
+      auto block_id = std::uint32_t { 0 };
+      auto reused = false;
+      auto [first, last] = previous.equal_range(hash);
+      for (auto it = first; it != last; ++it) {
+        auto const& candidate = _blocks[it->second].tokens;
+        if (same_shape(std::span { candidate }.first(candidate.size() - 1), range)) {
+          block_id = it->second;
+          previous.erase(it);
+          reused = true;
+          break;
+        }
+      }
+      if (!reused)
+        block_id = make_block(id, range);
+
+      _blocks[block_id].position = layout.size();
+      layout.push_back(placement { block_id, range.front().line(), range.front().col() });
+    }
+
+    for (auto const& [hash, block_id]: previous)
+      free_block(block_id);
+
+    target.scope.clear();
+    target.functions.clear();
+    for (auto const& where: layout) {
+      auto const& source = _blocks[where.block];
+      for (auto const& node: source.ast) {
+        if (node && node->is(syntax::stmt_type::Function)) {
+          auto function = std::static_pointer_cast<syntax::stmt_function>(node);
+          target.functions[function->id().value()].push_back(
+            function_declaration { source.position, function.get() }
+          );
+        }
+        if (!node || !node->is(syntax::stmt_type::Local))
+          continue;
+        auto local = std::static_pointer_cast<syntax::stmt_local>(node);
+        for (auto const& variable: local->content()) {
+          target.scope[variable.id.value()].push_back(
+            declaration { source.position, where.block, &variable }
+          );
+        }
+      }
+    }
+
+    auto changed = layout != target.layout;
+    target.layout = std::move(layout);
+    return changed;
+  }
+
+  extern auto database::compute_check(std::uint32_t id)
+    -> bool {
+    class outer_scope: public resolver::environment {
+      public:
+        outer_scope(database& db, std::uint32_t owner)
+          : _db { db }, _owner { owner } {}
+
+        auto find(std::string_view name)
+          -> syntax::stmt_local::variable const* override {
+          auto found = _db.find(_owner, name);
+          return found ? found->declaration : nullptr;
+        }
+
+        auto find_function(std::string_view name)
+          -> syntax::stmt_function const* override {
+          return _db.find_function(_owner, name);
+        }
+
+      private:
+        database& _db;
+        std::uint32_t _owner;
+    };
+
+    auto& target = _blocks[id];
+    auto errors = recorder {};
+    auto outer = outer_scope { *this, id };
+    auto names = resolver { errors }.resolve(target.ast, outer);
+
+    auto slots = names.symbols().size();
+    auto types = typing { slots, names.functions().size() };
+    auto values = constants { slots };
+    for (auto slot = std::size_t { 0 }; slot < slots; ++slot) {
+      auto const& symbol = names.symbols()[slot];
+      if (!symbol.external)
+        continue;
+      auto found = find(id, symbol.declaration->id.value());
+      if (!found)
+        continue;
+      types.set_slot(slot, found->type);
+      if (found->value)
+        values.set_slot(slot, *found->value);
+    }
+
+    auto typed = type_checker { errors, _types, names }.check(target.ast, std::move(types));
+    auto folded = const_evaluator { errors, _types, names, typed }
+      .evaluate(target.ast, std::move(values));
+    target.result = std::make_unique<analysis>(analysis {
+      std::move(names), std::move(typed),
+      std::move(folded), std::move(errors.errors)
+    });
+    return true;
+  }
+
+  extern auto database::compute_lookup(std::uint32_t id)
+    -> bool {
+    auto& target = _lookups[id];
+    auto const& owner = _blocks[target.owner];
+    read(query_key { query_kind::Blocks, owner.file });
+
+    // A function is known by its syntax alone: its last declaration before
+    // the block, which is parsed again whenever its text changes.
+    if (target.function) {
+      auto const* callee = static_cast<syntax::stmt_function const*>(nullptr);
+      auto const& functions = _files[owner.file].functions;
+      auto found = functions.find(target.name);
+      if (found != functions.end()) {
+        auto const& candidates = found->second;
+        auto visible = std::partition_point(
+          candidates.begin(), candidates.end(),
+          [&](auto const& entry) { return entry.position < owner.position; }
+        );
+        if (visible != candidates.begin())
+          callee = std::prev(visible)->function;
+      }
+      auto changed = callee != target.callee;
+      target.callee = callee;
+      return changed;
+    }
+
+    auto value = std::optional<binding> {};
+    auto const& scope = _files[owner.file].scope;
+    auto found = scope.find(target.name);
+    if (found != scope.end()) {
+      auto const& candidates = found->second;
+      auto visible = std::partition_point(
+        candidates.begin(), candidates.end(),
+        [&](auto const& entry) { return entry.position < owner.position; }
+      );
+      if (visible != candidates.begin()) {
+        auto const& entry = *std::prev(visible);
+        read(query_key { query_kind::Check, entry.block });
+        auto const& source = *_blocks[entry.block].result;
+        auto slot = source.names.slot(*entry.variable);
+        value = binding {
+          entry.variable,
+          source.types.slot_type(slot),
+          entry.variable->mut ? std::nullopt : source.values.slot_value(slot)
+        };
+      }
+    }
+
+    auto changed = value != target.value;
+    target.value = value;
+    return changed;
+  }
+
+  extern auto database::find(std::uint32_t owner, std::string_view name)
+    -> std::optional<binding> {
+    auto id = lookup_of(owner, name, false);
+    read(query_key { query_kind::Lookup, id });
+    return _lookups[id].value;
+  }
+
+  extern auto database::find_function(std::uint32_t owner, std::string_view name)
+    -> syntax::stmt_function const* {
+    auto id = lookup_of(owner, name, true);
+    read(query_key { query_kind::Lookup, id });
+    return _lookups[id].callee;
+  }
+
+  extern auto database::lookup_of(std::uint32_t owner, std::string_view name, bool function)
+    -> std::uint32_t {
+    auto& source = _blocks[owner];
+    auto& known = function ? source.calls : source.lookups;
+    auto found = known.find(name);
+    if (found != known.end())
+      return found->second;
+
+    auto id = std::uint32_t { 0 };
+    if (_free_lookups.empty()) {
+      id = static_cast<std::uint32_t>(_lookups.size());
+      _lookups.emplace_back();
+    } else {
+      id = _free_lookups.back();
+      _free_lookups.pop_back();
+    }
+    auto& target = _lookups[id];
+    target.owner = owner;
+    target.name = name;
+    target.function = function;
+    known.emplace(target.name, id);
+    return id;
+  }
+
+  extern auto database::analyze(file_id id, std::size_t index)
+    -> analysis const& {
+    // Blocks are brought up to date in source order: every outer declaration
+    // a block uses is then already verified, which keeps recursion shallow.
+    read(query_key { query_kind::Blocks, id });
+    auto& target = _files[id];
+    if (target.checked_at != _revision) {
+      target.checked = 0;
+      target.checked_at = _revision;
+    }
+    for (; target.checked <= index; ++target.checked)
+      read(query_key { query_kind::Check, target.layout[target.checked].block });
+    return *_blocks[target.layout[index].block].result;
+  }
+
+  extern auto database::make_block(file_id file, std::span<syntax::token const> range)
+    -> std::uint32_t {
+    auto id = std::uint32_t { 0 };
+    if (_free_blocks.empty()) {
+      id = static_cast<std::uint32_t>(_blocks.size());
+      _blocks.emplace_back();
+    } else {
+      id = _free_blocks.back();
+      _free_blocks.pop_back();
+    }
+
+    // The block owns a copy of its text, lexed again with the positions of
+    // the file, so it does not keep the whole source alive.
+    auto& target = _blocks[id];
+    auto const& first = range.front();
+    auto const& last = range.back();
+    target.file = file;
+    target.fingerprint = fingerprint(range);
+    target.text.assign(first.value().data(), last.value().data() + last.value().size());
+    target.alive = true;
+
+    auto ignored = discard {};
+    target.tokens = syntax::lexer { ignored, target.text, first.line(), first.col() }.scan_all();
+    auto errors = recorder {};
+    target.ast = syntax::parser { errors, target.tokens }.parse();
+    target.errors = std::move(errors.errors);
+    _texts.emplace(target.text.data(), id);
+    return id;
+  }
+
+  extern auto database::free_block(std::uint32_t id)
+    -> void {
+    auto& target = _blocks[id];
+    for (auto const* known: { &target.lookups, &target.calls }) {
+      for (auto const& [name, lookup_id]: *known) {
+        _lookups[lookup_id] = lookup {};
+        _free_lookups.push_back(lookup_id);
+      }
+    }
+    _texts.erase(target.text.data());
+    target = block {};
+    _free_blocks.push_back(id);
+  }
+}
@@ -0,0 +1,77 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "thalia-sema/locate.hpp"
+
+namespace thalia::sema {
+  namespace {
+    class expr_locator
+      : public syntax::expr_visitor<int, syntax::token> {
+      public:
+        expr_locator(std::shared_ptr<syntax::expression> const& node)
+          : syntax::expr_visitor<int, syntax::token> { node } {}
+
+        auto locate() -> syntax::token
+          { return _node ? visit_expr(0) : syntax::token {}; }
+
+      protected:
+        auto visit_expr_assign(int) -> syntax::token override {
+          auto root = std::static_pointer_cast<syntax::expr_assign>(_node);
+          return expr_locator { root->target() }.locate();
+        }
+
+        auto visit_expr_binary(int) -> syntax::token override {
+          auto root = std::static_pointer_cast<syntax::expr_binary>(_node);
+          return expr_locator { root->lhs() }.locate();
+        }
+
+        auto visit_expr_unary(int) -> syntax::token override
+          { return std::static_pointer_cast<syntax::expr_unary>(_node)->operation(); }
+
+        auto visit_expr_paren(int) -> syntax::token override {
+          auto root = std::static_pointer_cast<syntax::expr_paren>(_node);
+          return expr_locator { root->value() }.locate();
+        }
+
+        auto visit_expr_base_lit(int) -> syntax::token override
+          { return std::static_pointer_cast<syntax::expr_base_lit>(_node)->target(); }
+
+        auto visit_expr_id(int) -> syntax::token override
+          { return std::static_pointer_cast<syntax::expr_id>(_node)->target(); }
+
+        auto visit_expr_index(int) -> syntax::token override {
+          auto root = std::static_pointer_cast<syntax::expr_index>(_node);
+          return expr_locator { root->target() }.locate();
+        }
+
+        auto visit_expr_call(int) -> syntax::token override
+          { return std::static_pointer_cast<syntax::expr_call>(_node)->callee(); }
+
+        auto visit_expr_data_type(int) -> syntax::token override
+          { return std::static_pointer_cast<syntax::expr_data_type>(_node)->target(); }
+
+        auto visit_expr_array_type(int) -> syntax::token override
+          { return std::static_pointer_cast<syntax::expr_array_type>(_node)->length(); }
+    };
+  }
+
+  extern auto locate(std::shared_ptr<syntax::expression> const& node)
+    -> syntax::token {
+    return expr_locator { node }.locate();
+  }
+}
@@ -0,0 +1,405 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string_view>
+#include <unordered_map>
+
+#include "thalia-sema/resolver.hpp"
+
+namespace thalia::sema {
+  namespace {
+    struct context {
+      resolver::error_queue& errors;
+      symbol_table& symbols;
+      resolution& result;
+      resolver::environment* outer;
+      std::unordered_map<std::string_view, std::size_t>& functions;
+      std::size_t owner;
+    };
+
+    class expr_resolver
+      : public syntax::expr_visitor<context&, void> {
+      public:
+        expr_resolver(std::shared_ptr<syntax::expression> const& node)
+          : syntax::expr_visitor<context&, void> { node } {}
+
+        auto resolve(context& ctx) -> void
+          { if (_node) visit_expr(ctx); }
+
+      protected:
+        auto visit_expr_assign(context& ctx) -> void override;
+        auto visit_expr_binary(context& ctx) -> void override;
+        auto visit_expr_unary(context& ctx) -> void override;
+        auto visit_expr_paren(context& ctx) -> void override;
+        auto visit_expr_base_lit(context&) -> void override {}
+        auto visit_expr_id(context& ctx) -> void override;
+        auto visit_expr_index(context& ctx) -> void override;
+        auto visit_expr_call(context& ctx) -> void override;
+        auto visit_expr_data_type(context&) -> void override {}
+        auto visit_expr_array_type(context&) -> void override {}
+    };
+
+    class stmt_resolver
+      : public syntax::stmt_visitor<context&, void> {
+      public:
+        stmt_resolver(std::shared_ptr<syntax::statement> const& node)
+          : syntax::stmt_visitor<context&, void> { node } {}
+
+        auto resolve(context& ctx) -> void
+          { if (_node) visit_stmt(ctx); }
+
+      protected:
+        auto visit_stmt_block(context& ctx) -> void override;
+        auto visit_stmt_return(context& ctx) -> void override;
+        auto visit_stmt_expr(context& ctx) -> void override;
+        auto visit_stmt_if(context& ctx) -> void override;
+        auto visit_stmt_while(context& ctx) -> void override;
+        auto visit_stmt_local(context& ctx) -> void override;
+        auto visit_stmt_function(context& ctx) -> void override;
+    };
+
+    extern auto expr_resolver::visit_expr_assign(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_assign>(_node);
+      expr_resolver { root->target() }.resolve(ctx);
+      expr_resolver { root->value() }.resolve(ctx);
+
+      auto target = root->target();
+      while (target && target->is(syntax::expr_type::Paren))
+        target = std::static_pointer_cast<syntax::expr_paren>(target)->value();
+      if (!target)
+        return;
+
+      // An element is assigned through its array, which must be mutable.
+      while (target && target->is(syntax::expr_type::Index))
+        target = std::static_pointer_cast<syntax::expr_index>(target)->target();
+      if (!target)
+        return;
+
+      if (!target->is(syntax::expr_type::Id)) {
+        ctx.errors << resolver::error {
+          resolver::error_type::InvalidAssignTarget,
+          root->operation()
+        };
+        return;
+      }
+
+      auto id = std::static_pointer_cast<syntax::expr_id>(target);
+      auto slot = ctx.result.slot(*id);
+      if (slot == resolution::npos)
+        return;
+      if (!ctx.result.symbols()[slot].declaration->mut) {
+        ctx.errors << resolver::error {
+          resolver::error_type::AssignToConst,
+          id->target()
+        };
+      }
+    }
+
+    extern auto expr_resolver::visit_expr_binary(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_binary>(_node);
+      expr_resolver { root->lhs() }.resolve(ctx);
+      expr_resolver { root->rhs() }.resolve(ctx);
+    }
+
+    extern auto expr_resolver::visit_expr_unary(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_unary>(_node);
+      expr_resolver { root->value() }.resolve(ctx);
+    }
+
+    extern auto expr_resolver::visit_expr_paren(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_paren>(_node);
+      expr_resolver { root->value() }.resolve(ctx);
+    }
+
+    extern auto expr_resolver::visit_expr_id(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_id>(_node);
+      auto slot = ctx.symbols.lookup(root->target().value());
+      if (slot == symbol_table::npos && ctx.outer && ctx.owner == resolution::npos) {
+        auto const* declaration = ctx.outer->find(root->target().value());
+        if (declaration)
+          slot = ctx.result.declare_external(*declaration);
+      }
+      if (slot == symbol_table::npos) {
+        ctx.errors << resolver::error {
+          resolver::error_type::UndeclaredId,
+          root->target()
+        };
+        return;
+      }
+      ctx.result.bind(*root, slot);
+    }
+
+    extern auto expr_resolver::visit_expr_index(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_index>(_node);
+      expr_resolver { root->target() }.resolve(ctx);
+      expr_resolver { root->index() }.resolve(ctx);
+    }
+
+    extern auto expr_resolver::visit_expr_call(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_call>(_node);
+      for (auto const& arg: root->args())
+        expr_resolver { arg }.resolve(ctx);
+
+      auto name = root->callee().value();
+      auto found = ctx.functions.find(name);
+      if (found == ctx.functions.end() && ctx.outer) {
+        auto const* declaration = ctx.outer->find_function(name);
+        if (declaration)
+          found = ctx.functions.emplace(name, ctx.result.declare_external(*declaration)).first;
+      }
+      if (found == ctx.functions.end()) {
+        ctx.errors << resolver::error {
+          resolver::error_type::UndeclaredId,
+          root->callee()
+        };
+        return;
+      }
+      ctx.result.bind(*root, found->second);
+    }
+
+    extern auto stmt_resolver::visit_stmt_block(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_block>(_node);
+      ctx.symbols.enter_scope();
+      for (auto const& node: root->content())
+        stmt_resolver { node }.resolve(ctx);
+      ctx.symbols.leave_scope();
+    }
+
+    extern auto stmt_resolver::visit_stmt_return(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_return>(_node);
+      expr_resolver { root->value() }.resolve(ctx);
+    }
+
+    extern auto stmt_resolver::visit_stmt_expr(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_expr>(_node);
+      expr_resolver { root->value() }.resolve(ctx);
+    }
+
+    extern auto stmt_resolver::visit_stmt_if(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_if>(_node);
+      expr_resolver { root->condition() }.resolve(ctx);
+      stmt_resolver { root->main_body() }.resolve(ctx);
+      stmt_resolver { root->else_body() }.resolve(ctx);
+    }
+
+    extern auto stmt_resolver::visit_stmt_while(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_while>(_node);
+      expr_resolver { root->condition() }.resolve(ctx);
+      stmt_resolver { root->body() }.resolve(ctx);
+    }
+
+    extern auto stmt_resolver::visit_stmt_local(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_local>(_node);
+      for (auto const& variable: root->content()) {
+        // The initializer is resolved first: a declaration is not visible
+        // inside its own initializer.
+        expr_resolver { variable.value }.resolve(ctx);
+
+        auto depth = ctx.symbols.depth();
+        auto slot = ctx.result.declare(variable, depth, ctx.owner);
+        auto shadows = depth == 0 && ctx.outer
+          && ctx.outer->find(variable.id.value());
+        if (!ctx.symbols.declare(variable.id.value(), slot) || shadows) {
+          ctx.errors << resolver::error {
+            resolver::error_type::AlreadyDeclared,
+            variable.id
+          };
+        }
+      }
+    }
+
+    extern auto stmt_resolver::visit_stmt_function(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_function>(_node);
+      auto name = root->id().value();
+      auto found = ctx.functions.find(name);
+      auto function = resolution::npos;
+      if (found == ctx.functions.end()) {
+        function = ctx.result.declare(*root);
+        ctx.functions.emplace(name, function);
+      } else {
+        function = found->second;
+        ctx.result.redeclare(function, *root);
+      }
+
+      auto body = std::static_pointer_cast<syntax::stmt_block>(root->body());
+      if (!body)
+        return;
+      auto defined = ctx.result.functions()[function].definition != nullptr;
+      if (defined || ctx.result.functions()[function].external) {
+        ctx.errors << resolver::error {
+          resolver::error_type::AlreadyDeclared,
+          root->id()
+        };
+      }
+
+      // The body starts from an empty table: the variables of the top level
+      // are out of its reach, and its outermost scope holds the parameters.
+      auto symbols = symbol_table {};
+      auto inner = context { ctx.errors, symbols, ctx.result, ctx.outer, ctx.functions, function };
+      auto first = ctx.result.symbols().size();
+      symbols.enter_scope();
+      for (auto const& param: root->params()) {
+        auto slot = ctx.result.declare(param, symbols.depth(), function);
+        if (!symbols.declare(param.id.value(), slot)) {
+          ctx.errors << resolver::error {
+            resolver::error_type::AlreadyDeclared,
+            param.id
+          };
+        }
+      }
+      for (auto const& node: body->content())
+        stmt_resolver { node }.resolve(inner);
+      symbols.leave_scope();
+
+      if (!defined)
+        ctx.result.define(function, *root, first, ctx.result.symbols().size() - first);
+    }
+
+    auto resolve_all(
+      resolver::error_queue& errors,
+      std::span<std::shared_ptr<syntax::statement> const> ast,
+      resolver::environment* outer
+    ) -> resolution {
+      auto result = resolution {};
+      auto symbols = symbol_table {};
+      auto functions = std::unordered_map<std::string_view, std::size_t> {};
+      auto ctx = context { errors, symbols, result, outer, functions, resolution::npos };
+      for (auto const& node: ast)
+        stmt_resolver { node }.resolve(ctx);
+      return result;
+    }
+  }
+
+  extern auto resolution::declare_external(
+    syntax::stmt_local::variable const& declaration
+  ) -> std::size_t {
+    auto const* known = _decls.find(&declaration);
+    if (known)
+      return *known;
+
+    auto slot = _symbols.size();
+    _symbols.push_back(symbol { &declaration, 0, true, npos });
+    _decls.insert(&declaration, slot);
+    return slot;
+  }
+
+  extern auto resolution::declare(
+    syntax::stmt_local::variable const& declaration,
+    std::size_t depth,
+    std::size_t owner
+  ) -> std::size_t {
+    auto slot = _symbols.size();
+    _symbols.push_back(symbol { &declaration, depth, false, owner });
+    _decls.insert(&declaration, slot);
+    return slot;
+  }
+
+  extern auto resolution::declare_external(
+    syntax::stmt_function const& declaration
+  ) -> std::size_t {
+    auto const* known = _functions_of.find(&declaration);
+    if (known)
+      return *known;
+
+    auto function = _functions.size();
+    _functions.push_back(resolution::function { &declaration, nullptr, 0, 0, true });
+    _functions_of.insert(&declaration, function);
+    return function;
+  }
+
+  extern auto resolution::declare(
+    syntax::stmt_function const& declaration
+  ) -> std::size_t {
+    auto function = _functions.size();
+    _functions.push_back(resolution::function { &declaration, nullptr, 0, 0, false });
+    _functions_of.insert(&declaration, function);
+    return function;
+  }
+
+  extern auto resolution::define(
+    std::size_t function,
+    syntax::stmt_function const& definition,
+    std::size_t first,
+    std::size_t count
+  ) -> void {
+    auto& target = _functions[function];
+    target.definition = &definition;
+    target.first = first;
+    target.count = count;
+  }
+
+  extern auto resolution::slot(syntax::expr_id const& node) const
+    -> std::size_t {
+    auto const* result = _uses.find(&node);
+    return result ? *result : npos;
+  }
+
+  extern auto resolution::slot(syntax::stmt_local::variable const& declaration) const
+    -> std::size_t {
+    auto const* result = _decls.find(&declaration);
+    return result ? *result : npos;
+  }
+
+  extern auto resolution::callee(syntax::expr_call const& node) const
+    -> std::size_t {
+    auto const* result = _calls.find(&node);
+    return result ? *result : npos;
+  }
+
+  extern auto resolution::function_of(syntax::stmt_function const& declaration) const
+    -> std::size_t {
+    auto const* result = _functions_of.find(&declaration);
+    return result ? *result : npos;
+  }
+
+  extern auto resolver::resolve(
+    std::span<std::shared_ptr<syntax::statement> const> ast
+  ) -> resolution {
+    auto result = resolve_all(_errors, ast, nullptr);
+    for (auto const& function: result.functions()) {
+      if (function.definition)
+        continue;
+      _errors << error {
+        error_type::UndefinedFunction,
+        function.declaration->id()
+      };
+    }
+    return result;
+  }
+
+  extern auto resolver::resolve(
+    std::span<std::shared_ptr<syntax::statement> const> ast,
+    environment& outer
+  ) -> resolution {
+    return resolve_all(_errors, ast, &outer);
+  }
+}
@@ -0,0 +1,103 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "thalia-sema/symbol_table.hpp"
+
+namespace thalia::sema {
+  extern auto symbol_table::leave_scope()
+    -> void {
+    auto mark = _marks.back();
+    _marks.pop_back();
+    while (_undo.size() > mark) {
+      auto const& change = _undo.back();
+      _entries[change.index].slot = change.slot;
+      _entries[change.index].depth = change.depth;
+      _undo.pop_back();
+    }
+  }
+
+  extern auto symbol_table::declare(std::string_view name, std::size_t slot)
+    -> bool {
+    if ((_used + 1) * 2 > _entries.size())
+      rehash(_entries.empty() ? 64 : _entries.size() * 2);
+
+    auto hash = hash_of(name);
+    auto index = index_of(name, hash);
+    auto& target = _entries[index];
+    if (!target.used) {
+      target.used = true;
+      target.name = name;
+      target.hash = hash;
+      ++_used;
+    } else if (target.slot != npos && target.depth == depth()) {
+      return false;
+    }
+
+    _undo.push_back(change { index, target.slot, target.depth });
+    target.slot = slot;
+    target.depth = depth();
+    return true;
+  }
+
+  extern auto symbol_table::lookup(std::string_view name) const
+    -> std::size_t {
+    if (_entries.empty())
+      return npos;
+    auto const& target = _entries[index_of(name, hash_of(name))];
+    return target.used ? target.slot : npos;
+  }
+
+  extern auto symbol_table::hash_of(std::string_view name)
+    -> std::uint64_t {
+    // FNV-1a
+    auto hash = std::uint64_t { 0xCBF29CE484222325ull };
+    for (auto c: name) {
+      hash ^= static_cast<unsigned char>(c);
+      hash *= 0x100000001B3ull;
+    }
+    return hash;
+  }
+
+  extern auto symbol_table::index_of(std::string_view name, std::uint64_t hash) const
+    -> std::size_t {
+    auto mask = _entries.size() - 1;
+    auto index = static_cast<std::size_t>(hash) & mask;
+    while (_entries[index].used
+        && (_entries[index].hash != hash || _entries[index].name != name))
+      index = (index + 1) & mask;
+    return index;
+  }
+
+  extern auto symbol_table::rehash(std::size_t capacity)
+    -> void {
+    auto old = std::vector<entry>(capacity);
+    old.swap(_entries);
+
+    // The undo log refers to entries by index, so it is remapped as well.
+    auto moved = std::vector<std::size_t>(old.size());
+    for (std::size_t i = 0; i < old.size(); ++i) {
+      if (!old[i].used)
+        continue;
+      moved[i] = index_of(old[i].name, old[i].hash);
+      _entries[moved[i]] = old[i];
+    }
+
+    for (auto& change: _undo)
+      change.index = moved[change.index];
+  }
+}
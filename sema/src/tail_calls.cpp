@@ -0,0 +1,170 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "thalia-sema/tail_calls.hpp"
+
+namespace thalia::sema {
+  namespace {
+    struct context {
+      std::vector<call_site>& sites;
+      tail_reason reason;
+      std::shared_ptr<syntax::stmt_function> caller;
+    };
+
+    // Every call below the root of an expression is an operand of the
+    // expression around it; only the root call inherits the reason of its
+    // statement.
+    class expr_finder
+      : public syntax::expr_visitor<context, void> {
+      public:
+        expr_finder(std::shared_ptr<syntax::expression> const& node)
+          : syntax::expr_visitor<context, void> { node } {}
+
+        auto find(context ctx) -> void
+          { if (_node) visit_expr(ctx); }
+
+      protected:
+        auto visit_expr_assign(context ctx) -> void override {
+          auto root = std::static_pointer_cast<syntax::expr_assign>(_node);
+          ctx.reason = tail_reason::Operand;
+          expr_finder { root->target() }.find(ctx);
+          expr_finder { root->value() }.find(ctx);
+        }
+
+        auto visit_expr_binary(context ctx) -> void override {
+          auto root = std::static_pointer_cast<syntax::expr_binary>(_node);
+          ctx.reason = tail_reason::Operand;
+          expr_finder { root->lhs() }.find(ctx);
+          expr_finder { root->rhs() }.find(ctx);
+        }
+
+        auto visit_expr_unary(context ctx) -> void override {
+          auto root = std::static_pointer_cast<syntax::expr_unary>(_node);
+          ctx.reason = tail_reason::Operand;
+          expr_finder { root->value() }.find(ctx);
+        }
+
+        auto visit_expr_paren(context ctx) -> void override
+          { expr_finder { std::static_pointer_cast<syntax::expr_paren>(_node)->value() }.find(ctx); }
+
+        auto visit_expr_base_lit(context) -> void override {}
+        auto visit_expr_id(context) -> void override {}
+
+        auto visit_expr_index(context ctx) -> void override {
+          auto root = std::static_pointer_cast<syntax::expr_index>(_node);
+          ctx.reason = tail_reason::Operand;
+          expr_finder { root->target() }.find(ctx);
+          expr_finder { root->index() }.find(ctx);
+        }
+
+        auto visit_expr_call(context ctx) -> void override {
+          auto root = std::static_pointer_cast<syntax::expr_call>(_node);
+          ctx.sites.push_back(call_site { root, ctx.reason, ctx.caller });
+          ctx.reason = tail_reason::Operand;
+          for (auto const& arg: root->args())
+            expr_finder { arg }.find(ctx);
+        }
+
+        auto visit_expr_data_type(context) -> void override {}
+        auto visit_expr_array_type(context) -> void override {}
+    };
+
+    class stmt_finder
+      : public syntax::stmt_visitor<context, void> {
+      public:
+        stmt_finder(std::shared_ptr<syntax::statement> const& node)
+          : syntax::stmt_visitor<context, void> { node } {}
+
+        auto find(context ctx) -> void
+          { if (_node) visit_stmt(ctx); }
+
+      protected:
+        auto visit_stmt_block(context ctx) -> void override {
+          auto root = std::static_pointer_cast<syntax::stmt_block>(_node);
+          for (auto const& node: root->content())
+            stmt_finder { node }.find(ctx);
+        }
+
+        auto visit_stmt_return(context ctx) -> void override {
+          auto root = std::static_pointer_cast<syntax::stmt_return>(_node);
+          ctx.reason = ctx.caller ? tail_reason::Tail : tail_reason::TopLevel;
+          expr_finder { root->value() }.find(ctx);
+        }
+
+        auto visit_stmt_expr(context ctx) -> void override
+          { expr_finder { std::static_pointer_cast<syntax::stmt_expr>(_node)->value() }.find(ctx); }
+
+        auto visit_stmt_if(context ctx) -> void override {
+          auto root = std::static_pointer_cast<syntax::stmt_if>(_node);
+          expr_finder { root->condition() }.find(ctx);
+          stmt_finder { root->main_body() }.find(ctx);
+          stmt_finder { root->else_body() }.find(ctx);
+        }
+
+        auto visit_stmt_while(context ctx) -> void override {
+          auto root = std::static_pointer_cast<syntax::stmt_while>(_node);
+          expr_finder { root->condition() }.find(ctx);
+          stmt_finder { root->body() }.find(ctx);
+        }
+
+        auto visit_stmt_local(context ctx) -> void override {
+          auto root = std::static_pointer_cast<syntax::stmt_local>(_node);
+          for (auto const& variable: root->content())
+            expr_finder { variable.value }.find(ctx);
+        }
+
+        auto visit_stmt_function(context ctx) -> void override {
+          auto root = std::static_pointer_cast<syntax::stmt_function>(_node);
+          ctx.caller = root;
+          stmt_finder { root->body() }.find(ctx);
+        }
+    };
+  }
+
+  extern auto tail_call_of(syntax::stmt_return const& node)
+    -> std::shared_ptr<syntax::expr_call> {
+    auto value = node.value();
+    while (value && value->is(syntax::expr_type::Paren))
+      value = std::static_pointer_cast<syntax::expr_paren>(value)->value();
+    if (!value || !value->is(syntax::expr_type::Call))
+      return nullptr;
+    return std::static_pointer_cast<syntax::expr_call>(value);
+  }
+
+  extern auto find_calls(std::span<std::shared_ptr<syntax::statement> const> ast)
+    -> std::vector<call_site> {
+    auto sites = std::vector<call_site> {};
+    for (auto const& node: ast)
+      stmt_finder { node }.find(context { sites, tail_reason::NotReturned, nullptr });
+    return sites;
+  }
+
+  extern auto describe(tail_reason reason)
+    -> std::string_view {
+    switch (reason) {
+      case tail_reason::TopLevel:
+        return "the top level reports its variables after it returns";
+      case tail_reason::Operand:
+        return "its result is used by the expression around it";
+      case tail_reason::NotReturned:
+        return "its result is not returned";
+      default:
+        return {};
+    }
+  }
+}
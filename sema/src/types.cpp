@@ -0,0 +1,98 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "thalia-sema/types.hpp"
+
+namespace thalia::sema {
+  type_table::type_table()
+    : _types {}, _index {} {
+    intern(type { type_kind::Error, 0 });
+    intern(type { type_kind::Void, 0 });
+    intern(type { type_kind::Int, 8 });
+    intern(type { type_kind::Int, 16 });
+    intern(type { type_kind::Int, 32 });
+    intern(type { type_kind::Int, 64 });
+  }
+
+  extern auto type_table::intern(type const& target)
+    -> type_id {
+    auto key = key_of(target);
+    auto found = _index.find(key);
+    if (found != _index.end())
+      return found->second;
+
+    auto id = type_id { static_cast<std::uint32_t>(_types.size()) };
+    _types.push_back(target);
+    _index.emplace(key, id);
+    return id;
+  }
+
+  extern auto type_table::int_type(std::size_t width) const
+    -> type_id {
+    switch (width) {
+      case 8: return type_id { 2 };
+      case 16: return type_id { 3 };
+      case 32: return type_id { 4 };
+      case 64: return type_id { 5 };
+      default: return error_type();
+    }
+  }
+
+  extern auto type_table::from_token(syntax::token_type type) const
+    -> type_id {
+    switch (type) {
+      case syntax::token_type::Void: return void_type();
+      case syntax::token_type::I8: return int_type(8);
+      case syntax::token_type::I16: return int_type(16);
+      case syntax::token_type::I32: return int_type(32);
+      case syntax::token_type::I64: return int_type(64);
+      default: return error_type();
+    }
+  }
+
+  extern auto type_table::array_type(type_id element, std::size_t length)
+    -> type_id {
+    return intern(type { type_kind::Array, get(element).width, element, length });
+  }
+
+  extern auto type_table::print(std::ostream& os, type_id id) const
+    -> std::ostream& {
+    auto const& target = get(id);
+    switch (target.kind) {
+      case type_kind::Error:
+        return os << "<error>";
+      case type_kind::Void:
+        return os << "void";
+      case type_kind::Int:
+        return os << 'i' << target.width;
+      case type_kind::Array:
+        os << '[' << target.length << ']';
+        return print(os, target.element);
+    }
+    return os;
+  }
+
+  extern auto type_table::key_of(type const& target)
+    -> std::uint64_t {
+    // Lengths are far below 2^32 and element types are among the first few.
+    return static_cast<std::uint64_t>(target.kind)
+      | (static_cast<std::uint64_t>(target.width) << 8)
+      | (static_cast<std::uint64_t>(target.element.index() & 0xff) << 16)
+      | (static_cast<std::uint64_t>(target.length) << 24);
+  }
+}
@@ -0,0 +1,163 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <memory>
+#include <sstream>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-test/frontend.hpp>
+
+#include "thalia-sema/checker.hpp"
+#include "thalia-sema/resolver.hpp"
+#include "thalia-sema/types.hpp"
+
+using namespace thalia;
+using error_type = sema::type_checker::error_type;
+
+TEST_CASE("type_table: types are interned") {
+  auto types = sema::type_table {};
+  CHECK(types.intern(sema::type { sema::type_kind::Int, 32 }) == types.int_type(32));
+  CHECK(types.from_token(syntax::token_type::I16) == types.int_type(16));
+  CHECK_FALSE(types.int_type(8) == types.int_type(64));
+
+  auto os = std::ostringstream {};
+  types.print(os, types.int_type(64));
+  CHECK(os.str() == "i64");
+}
+
+TEST_CASE("type_checker: accepts well-typed programs") {
+  auto source = test::program {
+    "def MIN: i32 = 4i32, MAX: i32 = 6i32;\n"
+    "def mut i: i32 = MIN, mut s: i32 = 0i32, mut big: i64 = 1;\n"
+    "while i <= MAX { s += i; i += 1i32; big <<= 1i8; }\n"
+    "return s;\n"
+  };
+  REQUIRE(source.errors.syntax_errors == 0);
+
+  auto names = sema::resolver { source.errors }.resolve(source.ast);
+  auto types = sema::type_table {};
+  auto result = sema::type_checker { source.errors, types, names }.check(source.ast);
+  CHECK(source.errors.checker_errors.empty());
+  CHECK(result.slot_type(0) == types.int_type(32));
+  CHECK(result.slot_type(4) == types.int_type(64));
+
+  auto loop = std::static_pointer_cast<syntax::stmt_while>(source.ast[2]);
+  CHECK(result.type_of(*loop->condition()) == types.int_type(32));
+}
+
+TEST_CASE("type_checker: reports mismatches") {
+  auto source = test::program {
+    "def a: i32 = 1i64;\n"
+    "def mut b: i8 = 1i8;\n"
+    "b = 2i16;\n"
+    "b + 1i32;\n"
+    "def c: void = 0;\n"
+    "return b;\n"
+  };
+  REQUIRE(source.errors.syntax_errors == 0);
+
+  auto names = sema::resolver { source.errors }.resolve(source.ast);
+  auto types = sema::type_table {};
+  sema::type_checker { source.errors, types, names }.check(source.ast);
+  CHECK(source.errors.checker_errors == std::vector {
+    error_type::MismatchedInit,
+    error_type::MismatchedAssign,
+    error_type::MismatchedOperands,
+    error_type::VoidVariable,
+    error_type::MismatchedReturn
+  });
+}
+
+TEST_CASE("type_checker: arrays are only indexed") {
+  auto source = test::program {
+    "def mut a: [4]i16, mut i: i8 = 1i8;\n"
+    "a[i] = a[3] + 1i16;\n"
+    "def b: [4]i16 = 0;\n"
+    "def mut c: [0]i32, mut d: [65537]i32, mut e: [2]void;\n"
+    "a = a;\n"
+    "i[0];\n"
+  };
+  REQUIRE(source.errors.syntax_errors == 0);
+
+  auto names = sema::resolver { source.errors }.resolve(source.ast);
+  auto types = sema::type_table {};
+  auto result = sema::type_checker { source.errors, types, names }.check(source.ast);
+  CHECK(result.slot_type(0) == types.array_type(types.int_type(16), 4));
+  CHECK(source.errors.checker_errors == std::vector {
+    error_type::ArrayInit,
+    error_type::ArrayLength,
+    error_type::ArrayLength,
+    error_type::ArrayLength,
+    error_type::ArrayAsValue,
+    error_type::ArrayAsValue,
+    error_type::NotAnArray
+  });
+}
+
+TEST_CASE("type_checker: calls match the signature of their callee") {
+  auto source = test::program {
+    "use add(a: i32, b: i32): i32;\n"
+    "global add(a: i32, b: i32): i32 { return a + b; }\n"
+    "global log(a: i32): void { if a < 0i32 { return; } return log(a - 1i32); }\n"
+    "def mut s: i32 = add(1i32, 2i32);\n"
+    "log(s);\n"
+    "return add(s, s);\n"
+  };
+  REQUIRE(source.errors.syntax_errors == 0);
+
+  auto names = sema::resolver { source.errors }.resolve(source.ast);
+  auto types = sema::type_table {};
+  auto result = sema::type_checker { source.errors, types, names }.check(source.ast);
+  CHECK(source.errors.resolver_errors.empty());
+  CHECK(source.errors.checker_errors.empty());
+  CHECK(result.signature_of(0) == sema::signature {
+    { types.int_type(32), types.int_type(32) }, types.int_type(32)
+  });
+  CHECK(result.signature_of(1).result == types.void_type());
+  CHECK(result.slot_type(names.functions()[0].first) == types.int_type(32));
+}
+
+TEST_CASE("type_checker: reports invalid functions and calls") {
+  auto source = test::program {
+    "use f(a: i32): i32;\n"
+    "global f(a: i64): i32 { return; }\n"
+    "global g(a: void, b: [2]i32): [2]i32 { return 1; }\n"
+    "global h(): void { return 1; }\n"
+    "f(1i32, 2i32);\n"
+    "f(1i64);\n"
+    "def x: i64 = h();\n"
+    "h();\n"
+  };
+  REQUIRE(source.errors.syntax_errors == 0);
+
+  auto names = sema::resolver { source.errors }.resolve(source.ast);
+  auto types = sema::type_table {};
+  sema::type_checker { source.errors, types, names }.check(source.ast);
+  CHECK(source.errors.resolver_errors.empty());
+  CHECK(source.errors.checker_errors == std::vector {
+    error_type::MismatchedDeclaration,
+    error_type::MismatchedReturn,
+    error_type::VoidVariable,
+    error_type::ArrayInSignature,
+    error_type::ArrayInSignature,
+    error_type::MismatchedReturn,
+    error_type::ArgumentCount,
+    error_type::MismatchedArgument,
+    error_type::VoidValue
+  });
+}
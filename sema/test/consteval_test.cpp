@@ -0,0 +1,138 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-test/frontend.hpp>
+
+#include "thalia-sema/arith.hpp"
+#include "thalia-sema/checker.hpp"
+#include "thalia-sema/consteval.hpp"
+#include "thalia-sema/resolver.hpp"
+#include "thalia-sema/types.hpp"
+
+using namespace thalia;
+using error_type = sema::const_evaluator::error_type;
+using syntax::token_type;
+
+namespace {
+  struct folded {
+    test::program source;
+    sema::type_table types;
+    sema::resolution names;
+    sema::typing typing;
+    sema::constants values;
+
+    folded(std::string code)
+      : source { std::move(code) }
+      , types {}
+      , names { sema::resolver { source.errors }.resolve(source.ast) }
+      , typing { sema::type_checker { source.errors, types, names }.check(source.ast) }
+      , values {
+        sema::const_evaluator { source.errors, types, names, typing }
+          .evaluate(source.ast)
+      } {}
+  };
+}
+
+TEST_CASE("arith: operations wrap to their width") {
+  using sema::arith_status;
+  auto sum = sema::eval_binary(token_type::Plus, 127, 1, 8);
+  CHECK(sum.value == -128);
+  CHECK(sum.status == arith_status::Overflow);
+
+  auto min = std::numeric_limits<std::int64_t>::min();
+  auto quot = sema::eval_binary(token_type::Div, min, -1, 64);
+  CHECK(quot.value == min);
+  CHECK(quot.status == arith_status::Overflow);
+  CHECK(sema::eval_binary(token_type::Mod, min, -1, 64).value == 0);
+  CHECK(sema::eval_binary(token_type::Div, -7, 2, 32).value == -3);
+  CHECK(sema::eval_binary(token_type::Div, 1, 0, 32).status == arith_status::DivByZero);
+
+  CHECK(sema::eval_binary(token_type::LShift, 1, 33, 32).value == 2);
+  CHECK(sema::eval_binary(token_type::RShift, -16, 2, 16).value == -4);
+  CHECK(sema::eval_binary(token_type::LShift, 1, 7, 8).value == -128);
+  CHECK(sema::eval_unary(token_type::BitNot, 0, 16).value == -1);
+  CHECK(sema::eval_unary(token_type::Minus, -128, 8).status == arith_status::Overflow);
+
+  CHECK(sema::parse_literal("128", 8, true).value == -128);
+  CHECK(sema::parse_literal("128", 8).status == arith_status::Overflow);
+  CHECK(sema::parse_literal("99999999999999999999", 64).status == arith_status::Overflow);
+}
+
+TEST_CASE("const_evaluator: folds non-mut definitions") {
+  auto result = folded {
+    "def MIN: i32 = 4i32, MAX: i32 = 6i32;\n"
+    "def SPAN: i32 = (MAX - MIN) * 2i32;\n"
+    "def LOW: i8 = -128i8, MASK: i64 = ~0 >> 60;\n"
+    "def mut i: i32 = MIN;\n"
+    "def COPY: i32 = i;\n"
+  };
+  REQUIRE(result.source.errors.syntax_errors == 0);
+  CHECK(result.source.errors.consteval_errors.empty());
+
+  CHECK(result.values.slot_value(0) == 4);
+  CHECK(result.values.slot_value(1) == 6);
+  CHECK(result.values.slot_value(2) == 4);
+  CHECK(result.values.slot_value(3) == -128);
+  CHECK(result.values.slot_value(4) == -1);
+  CHECK(result.values.slot_value(5) == std::nullopt);
+  CHECK(result.values.slot_value(6) == std::nullopt);
+
+  auto decl = std::static_pointer_cast<syntax::stmt_local>(result.source.ast[3]);
+  CHECK(result.values.value(*decl->content()[0].value) == 4);
+}
+
+TEST_CASE("const_evaluator: reports overflow and division by zero") {
+  auto result = folded {
+    "def A: i8 = 100i8 + 100i8;\n"
+    "def B: i16 = 40000i16;\n"
+    "def C: i32 = 1i32 / (2i32 - 2i32);\n"
+    "def D: i32 = C + 1i32;\n"
+    "def mut x: i32 = 0i32;\n"
+    "x / 0i32;\n"
+  };
+  REQUIRE(result.source.errors.syntax_errors == 0);
+  CHECK(result.source.errors.consteval_errors == std::vector {
+    error_type::Overflow,
+    error_type::LiteralOverflow,
+    error_type::DivByZero
+  });
+  CHECK(result.values.slot_value(0) == -56);
+  CHECK(result.values.slot_value(2) == std::nullopt);
+  CHECK(result.values.slot_value(3) == std::nullopt);
+}
+
+TEST_CASE("const_evaluator: reports constant indices out of range") {
+  auto result = folded {
+    "def mut a: [4]i32;\n"
+    "def N: i64 = 2 + 2;\n"
+    "a[3] = a[N - 1];\n"
+    "a[N] = 1i32;\n"
+    "a[-1i8];\n"
+  };
+  REQUIRE(result.source.errors.syntax_errors == 0);
+  CHECK(result.source.errors.consteval_errors == std::vector {
+    error_type::IndexOutOfRange,
+    error_type::IndexOutOfRange
+  });
+}
@@ -0,0 +1,193 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <memory>
+#include <string>
+#include <variant>
+#include <catch2/catch_test_macros.hpp>
+
+#include "thalia-sema/database.hpp"
+
+using namespace thalia;
+using sema::query_kind;
+
+namespace {
+  auto lines_of(std::vector<sema::diagnostic> const& errors)
+    -> std::vector<std::size_t> {
+    auto result = std::vector<std::size_t> {};
+    for (auto const& error: errors)
+      std::visit([&](auto const& e) { result.push_back(e.target.line()); }, error);
+    return result;
+  }
+}
+
+TEST_CASE("database: analyzes a file on demand") {
+  auto db = sema::database {};
+  auto file = db.add_file(
+    "def MIN: i32 = 4i32, MAX: i32 = 6i32;\n"
+    "def mut i: i32 = MIN;\n"
+    "while i <= MAX { i += 1i32; }\n"
+  );
+  CHECK(db.diagnostics(file).empty());
+  REQUIRE(db.blocks(file) == 3);
+  CHECK(db.executions(query_kind::Check) == 3);
+
+  auto names = db.names(file, 1);
+  REQUIRE(names.symbols().size() == 2);
+  CHECK(names.symbols()[0].external);
+  CHECK_FALSE(names.symbols()[1].external);
+
+  auto loop = std::static_pointer_cast<syntax::stmt_while>(db.ast(file, 2)[0]);
+  CHECK(db.type_of(file, loop->condition()) == db.types().int_type(32));
+
+  // Nothing changed: every query is reused.
+  db.diagnostics(file);
+  CHECK(db.executions(query_kind::Check) == 3);
+  CHECK(db.executions(query_kind::Tokens) == 1);
+}
+
+TEST_CASE("database: recomputes only the edited blocks") {
+  auto db = sema::database {};
+  auto file = db.add_file(
+    "def A: i8 = 100i8;\n"
+    "def mut b: i64 = 0;\n"
+    "def C: i8 = A + A;\n"
+    "b += 1;\n"
+  );
+  CHECK(lines_of(db.diagnostics(file)) == std::vector<std::size_t> { 3 });
+  auto first = db.ast(file, 3)[0];
+  auto first_decl = db.ast(file, 0)[0];
+
+  // Editing a block nobody depends on only checks that block again.
+  auto checks = db.executions(query_kind::Check);
+  db.set_source(file,
+    "def A: i8 = 100i8;\n"
+    "def mut b: i64 = 0;\n"
+    "def C: i8 = A + A;\n"
+    "b += 2;\n"
+  );
+  CHECK(lines_of(db.diagnostics(file)) == std::vector<std::size_t> { 3 });
+  CHECK(db.executions(query_kind::Check) == checks + 1);
+  CHECK(db.ast(file, 3)[0] != first);
+  CHECK(db.ast(file, 0)[0] == first_decl);
+
+  // Changing a constant reaches the blocks that use it.
+  checks = db.executions(query_kind::Check);
+  db.set_source(file,
+    "def A: i8 = 10i8;\n"
+    "def mut b: i64 = 0;\n"
+    "def C: i8 = A + A;\n"
+    "b += 2;\n"
+  );
+  CHECK(db.diagnostics(file).empty());
+  CHECK(db.executions(query_kind::Check) == checks + 2);
+}
+
+TEST_CASE("database: moved blocks are reused and diagnostics follow them") {
+  auto db = sema::database {};
+  auto file = db.add_file(
+    "def x: i32 = 1i32;\n"
+    "x = 2i32;\n"
+  );
+  CHECK(lines_of(db.diagnostics(file)) == std::vector<std::size_t> { 2 });
+
+  auto checks = db.executions(query_kind::Check);
+  db.set_source(file,
+    "\n"
+    "\n"
+    "def x: i32 = 1i32;\n"
+    "x = 2i32;\n"
+  );
+  CHECK(lines_of(db.diagnostics(file)) == std::vector<std::size_t> { 4 });
+  CHECK(db.executions(query_kind::Check) == checks);
+
+  // A new declaration in front of the use changes what it refers to.
+  db.set_source(file,
+    "def mut x: i32 = 0i32;\n"
+    "x = 2i32;\n"
+  );
+  CHECK(db.diagnostics(file).empty());
+}
+
+TEST_CASE("database: reports the same errors as a full analysis") {
+  auto db = sema::database {};
+  auto file = db.add_file(
+    "def a: i32 = b;\n"
+    "def a: i64 = 1;\n"
+    "if a { def a: i8 = 1i8; } else { a = 2; }\n"
+    "return 0;\n"
+  );
+  auto errors = db.diagnostics(file);
+  REQUIRE(errors.size() == 4);
+  CHECK(std::get<sema::resolver::error>(errors[0]).type
+    == sema::resolver::error_type::UndeclaredId);
+  CHECK(std::get<sema::resolver::error>(errors[1]).type
+    == sema::resolver::error_type::AlreadyDeclared);
+  CHECK(std::get<sema::resolver::error>(errors[2]).type
+    == sema::resolver::error_type::AssignToConst);
+  CHECK(std::get<sema::type_checker::error>(errors[3]).type
+    == sema::type_checker::error_type::MismatchedReturn);
+}
+
+TEST_CASE("database: re-checking after a small edit does not redo the file") {
+  auto code = std::string {};
+  for (auto i = 0; i < 2000; ++i) {
+    auto name = std::string { "v" }.append(std::to_string(i));
+    code.append("def ").append(name).append(": i64 = ")
+      .append(i == 0 ? "1" : std::string { "v" }.append(std::to_string(i - 1)))
+      .append(" + 1;\n");
+  }
+
+  auto db = sema::database {};
+  auto file = db.add_file(code);
+  CHECK(db.diagnostics(file).empty());
+  auto checks = db.executions(query_kind::Check);
+
+  code.append("def last: i64 = v1999 * 2;\n");
+  db.set_source(file, code);
+  CHECK(db.diagnostics(file).empty());
+  CHECK(db.executions(query_kind::Check) == checks + 1);
+}
+
+TEST_CASE("database: calls find functions of earlier blocks") {
+  auto db = sema::database {};
+  auto file = db.add_file(
+    "def n: i64 = 3;\n"
+    "global square(x: i64): i64 { return x * x; }\n"
+    "def m: i64 = square(n);\n"
+    "def k: i32 = square(n);\n"
+  );
+  auto errors = db.diagnostics(file);
+  REQUIRE(errors.size() == 1);
+  CHECK(std::get<sema::type_checker::error>(errors[0]).type
+    == sema::type_checker::error_type::MismatchedInit);
+  CHECK(db.names(file, 2).functions()[0].external);
+  auto checks = db.executions(query_kind::Check);
+
+  // A new signature is seen by the callers.
+  db.set_source(file,
+    "def n: i64 = 3;\n"
+    "global square(x: i64): i32 { return 1i32; }\n"
+    "def m: i64 = square(n);\n"
+    "def k: i32 = square(n);\n"
+  );
+  errors = db.diagnostics(file);
+  REQUIRE(errors.size() == 1);
+  CHECK(lines_of(errors) == std::vector<std::size_t> { 3 });
+  CHECK(db.executions(query_kind::Check) == checks + 3);
+}
@@ -0,0 +1,57 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstddef>
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-syntax/parser.hpp>
+#include <thalia-test/frontend.hpp>
+
+#include "thalia-sema/checker.hpp"
+#include "thalia-sema/consteval.hpp"
+#include "thalia-sema/resolver.hpp"
+#include "thalia-sema/types.hpp"
+
+using namespace thalia;
+
+namespace {
+  auto sum_of(std::size_t terms)
+    -> std::string {
+    auto code = std::string { "def mut a: i64 = 1;\na = a" };
+    for (auto i = std::size_t { 1 }; i < terms; ++i)
+      code += i % 2 ? " + a" : " * a";
+    return code + ";\n";
+  }
+}
+
+TEST_CASE("nesting: operator chains past the limit stop before the passes") {
+  // The passes walk the tree recursively, so the parser bounds its depth.
+  auto limit = syntax::parser::max_depth;
+  for (auto terms: { limit / 2, std::size_t { 30000 }, std::size_t { 100000 } }) {
+    auto source = test::program { sum_of(terms) };
+    CHECK(source.errors.syntax_errors == (terms > limit ? 1 : 0));
+    auto types = sema::type_table {};
+    auto names = sema::resolver { source.errors }.resolve(source.ast);
+    auto typing = sema::type_checker { source.errors, types, names }.check(source.ast);
+    sema::const_evaluator { source.errors, types, names, typing }.evaluate(source.ast);
+    CHECK(source.errors.resolver_errors.empty());
+    CHECK(source.errors.checker_errors.empty());
+    CHECK(source.errors.consteval_errors.empty());
+  }
+}
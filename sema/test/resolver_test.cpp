@@ -0,0 +1,186 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <memory>
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-test/frontend.hpp>
+
+#include "thalia-sema/resolver.hpp"
+#include "thalia-sema/symbol_table.hpp"
+
+using namespace thalia;
+using error_type = sema::resolver::error_type;
+
+TEST_CASE("symbol_table: scopes shadow and restore") {
+  auto table = sema::symbol_table {};
+  CHECK(table.declare("x", 0));
+  CHECK_FALSE(table.declare("x", 1));
+
+  table.enter_scope();
+  CHECK(table.lookup("x") == 0);
+  CHECK(table.declare("x", 2));
+  CHECK(table.lookup("x") == 2);
+  CHECK(table.declare("y", 3));
+  table.leave_scope();
+
+  CHECK(table.lookup("x") == 0);
+  CHECK(table.lookup("y") == sema::symbol_table::npos);
+}
+
+TEST_CASE("symbol_table: growth keeps the undo log valid") {
+  auto table = sema::symbol_table {};
+  auto names = std::vector<std::string> {};
+  for (int i = 0; i < 1000; ++i)
+    names.push_back(std::string { "v" }.append(std::to_string(i)));
+
+  for (std::size_t i = 0; i < names.size(); ++i)
+    table.declare(names[i], i);
+  table.enter_scope();
+  for (std::size_t i = 0; i < names.size(); ++i)
+    table.declare(names[i], i + names.size());
+  table.leave_scope();
+
+  for (std::size_t i = 0; i < names.size(); ++i)
+    CHECK(table.lookup(names[i]) == i);
+}
+
+TEST_CASE("resolver: binds identifiers to declaration slots") {
+  auto source = test::program {
+    "def MIN: i32 = 4i32;\n"
+    "def mut i: i32 = MIN;\n"
+    "while i <= MIN { def mut i: i32 = 0i32; i += MIN; }\n"
+    "i = 1i32;\n"
+  };
+  REQUIRE(source.errors.syntax_errors == 0);
+
+  auto names = sema::resolver { source.errors }.resolve(source.ast);
+  CHECK(source.errors.resolver_errors.empty());
+  REQUIRE(names.symbols().size() == 3);
+  CHECK(names.symbols()[0].depth == 0);
+  CHECK(names.symbols()[2].depth == 1);
+
+  auto loop = std::static_pointer_cast<syntax::stmt_while>(source.ast[2]);
+  auto condition = std::static_pointer_cast<syntax::expr_binary>(loop->condition());
+  auto outer = std::static_pointer_cast<syntax::expr_id>(condition->lhs());
+  CHECK(names.slot(*outer) == 1);
+
+  auto body = std::static_pointer_cast<syntax::stmt_block>(loop->body());
+  auto step = std::static_pointer_cast<syntax::stmt_expr>(body->content()[1]);
+  auto assign = std::static_pointer_cast<syntax::expr_assign>(step->value());
+  auto inner = std::static_pointer_cast<syntax::expr_id>(assign->target());
+  CHECK(names.slot(*inner) == 2);
+}
+
+TEST_CASE("resolver: reports invalid uses") {
+  auto source = test::program {
+    "def x: i32 = y;\n"
+    "def x: i32 = 1i32;\n"
+    "x = 2i32;\n"
+    "def z: i32 = z;\n"
+    "1i32 = 2i32;\n"
+  };
+  REQUIRE(source.errors.syntax_errors == 0);
+
+  sema::resolver { source.errors }.resolve(source.ast);
+  CHECK(source.errors.resolver_errors == std::vector {
+    error_type::UndeclaredId,
+    error_type::AlreadyDeclared,
+    error_type::AssignToConst,
+    error_type::UndeclaredId,
+    error_type::InvalidAssignTarget
+  });
+}
+
+TEST_CASE("resolver: handles 100k declarations") {
+  auto code = std::string {};
+  for (int i = 0; i < 100000; ++i) {
+    auto name = std::string { "v" }.append(std::to_string(i));
+    code += "def mut " + name + ": i32 = 0i32; " + name + " = " + name + ";\n";
+  }
+
+  auto source = test::program { code };
+  REQUIRE(source.errors.syntax_errors == 0);
+  auto names = sema::resolver { source.errors }.resolve(source.ast);
+  CHECK(source.errors.resolver_errors.empty());
+  CHECK(names.symbols().size() == 100000);
+}
+
+TEST_CASE("resolver: functions see their parameters and themselves") {
+  auto source = test::program {
+    "def mut x: i64 = 1;\n"
+    "use twice(n: i64): i64;\n"
+    "global fact(n: i64): i64 { if n < 2 { return 1; } return n * fact(n - 1); }\n"
+    "x = fact(twice(x));\n"
+    "local twice(n: i64): i64 { def r: i64 = n + n; return r; }\n"
+  };
+  REQUIRE(source.errors.syntax_errors == 0);
+
+  auto names = sema::resolver { source.errors }.resolve(source.ast);
+  CHECK(source.errors.resolver_errors.empty());
+  REQUIRE(names.functions().size() == 2);
+  auto const& twice = names.functions()[0];
+  CHECK(twice.declaration == source.ast[1].get());
+  CHECK(twice.definition == source.ast[4].get());
+  CHECK(twice.first == 2);
+  CHECK(twice.count == 2);
+  CHECK(names.symbols()[3].owner == 0);
+  CHECK(names.symbols()[3].depth == 1);
+  CHECK(names.symbols()[0].owner == sema::resolution::npos);
+
+  auto call = std::static_pointer_cast<syntax::stmt_expr>(source.ast[3]);
+  auto assign = std::static_pointer_cast<syntax::expr_assign>(call->value());
+  auto outer = std::static_pointer_cast<syntax::expr_call>(assign->value());
+  CHECK(names.callee(*outer) == 1);
+  auto inner = std::static_pointer_cast<syntax::expr_call>(outer->args()[0]);
+  CHECK(names.callee(*inner) == 0);
+}
+
+TEST_CASE("resolver: reports invalid functions") {
+  auto source = test::program {
+    "def x: i64 = 1;\n"
+    "global f(a: i64, a: i64): i64 { return x; }\n"
+    "global f(): void { a = 1; }\n"
+    "g();\n"
+    "use h(): void;\n"
+    "global k(n: i64): i64 { n = 2; return n; }\n"
+  };
+  REQUIRE(source.errors.syntax_errors == 0);
+
+  sema::resolver { source.errors }.resolve(source.ast);
+  CHECK(source.errors.resolver_errors == std::vector {
+    error_type::AlreadyDeclared,
+    error_type::UndeclaredId,
+    error_type::AlreadyDeclared,
+    error_type::UndeclaredId,
+    error_type::UndeclaredId,
+    error_type::AssignToConst,
+    error_type::UndefinedFunction
+  });
+}
+
+TEST_CASE("parser: functions are only declared at the top level") {
+  auto source = test::program {
+    "if 1 { global f(): void {} }\n"
+    "global g(a: i32): i32 { return; }\n"
+  };
+  CHECK(source.errors.syntax_errors == 1);
+  REQUIRE(source.ast.size() == 2);
+  CHECK(source.ast[1]->is(syntax::stmt_type::Function));
+}
@@ -0,0 +1,64 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <memory>
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-test/frontend.hpp>
+
+#include "thalia-sema/tail_calls.hpp"
+
+using namespace thalia;
+using sema::tail_reason;
+
+TEST_CASE("tail_calls: a returned call in a function is a tail call") {
+  auto source = test::program {
+    "global sum(n: i64, acc: i64): i64 {\n"
+    "  if n == 0 { return acc; }\n"
+    "  return (sum(n - 1, acc + n));\n"
+    "}\n"
+    "global fact(n: i64): i64 {\n"
+    "  if n == 0 { return 1; }\n"
+    "  def rest: i64 = fact(n - 1);\n"
+    "  return n * rest + sum(n, 0);\n"
+    "}\n"
+    "return sum(fact(3), 0);\n"
+  };
+  REQUIRE(source.errors.syntax_errors == 0);
+
+  auto sites = sema::find_calls(source.ast);
+  REQUIRE(sites.size() == 5);
+  CHECK(sites[0].call->callee().line() == 3);
+  CHECK(sites[0].reason == tail_reason::Tail);
+  CHECK(sites[0].caller == source.ast[0]);
+  CHECK(sites[1].reason == tail_reason::NotReturned);
+  CHECK(sites[2].reason == tail_reason::Operand);
+  CHECK(sites[3].call->callee().value() == "sum");
+  CHECK(sites[3].reason == tail_reason::TopLevel);
+  CHECK(sites[3].caller == nullptr);
+  CHECK(sites[4].call->callee().value() == "fact");
+  CHECK(sites[4].reason == tail_reason::Operand);
+  CHECK(sema::describe(tail_reason::Tail).empty());
+  CHECK_FALSE(sema::describe(tail_reason::Operand).empty());
+
+  auto body = std::static_pointer_cast<syntax::stmt_function>(source.ast[0])->body();
+  auto block = std::static_pointer_cast<syntax::stmt_block>(body);
+  auto tail = std::static_pointer_cast<syntax::stmt_return>(block->content()[1]);
+  CHECK(sema::tail_call_of(*tail) == sites[0].call);
+}
@@ -57,6 +57,10 @@ namespace thalia {
         _os << "Expected '(' before expression"; break;
       case t::ExpectedRParen:
         _os << "Expected ')' after expression"; break;
+      case t::ExpectedRBracket:
+        _os << "Expected ']' after an index or array length"; break;
+      case t::ExpectedArrayLength:
+        _os << "Expected the length of the array"; break;
       case t::ExpectedPrimary:
         _os << "Expected a primary expression"; break;
       case t::ExpectedSemi:
@@ -73,6 +77,10 @@ namespace thalia {
         _os << "Expected an identifier in the declaration"; break;
       case t::ExpectedLitType:
         _os << "Expected data type after the literal"; break;
+      case t::TooDeepNesting:
+        _os << "Too deeply nested block or expression"; break;
+      case t::MisplacedFunction:
+        _os << "Functions can only be declared at the top level"; break;
     }
 
     _os
@@ -88,5 +96,116 @@ namespace thalia {
 
     return *this;
   }
-}
 
+  extern auto error_queue::operator<<(
+    sema::resolver::error const& error
+  ) -> error_queue& {
+    using t = sema::resolver::error_type;
+    _os << "[ERROR]: ";
+    switch (error.type) {
+      case t::UndeclaredId:
+        _os << "Use of an undeclared identifier"; break;
+      case t::AlreadyDeclared:
+        _os << "Identifier is already declared in this scope"; break;
+      case t::AssignToConst:
+        _os << "Cannot assign to a variable that is not 'mut'"; break;
+      case t::InvalidAssignTarget:
+        _os << "Expected a variable on the left side of the assignment"; break;
+      case t::UndefinedFunction:
+        _os << "Function is declared with 'use' but never defined"; break;
+    }
+
+    _os
+      << "\n    ---> on value '" << error.target.value()
+      << "'\n    ---> on line " << error.target.line()
+      << ", column " << error.target.col() << ".\n";
+
+    ++_size;
+    if (_max_size != 0 && _size >= _max_size) {
+      _os << "[INFO]: Too many errors, stopping now.\n";
+      std::exit(EXIT_FAILURE);
+    }
+
+    return *this;
+  }
+
+  extern auto error_queue::operator<<(
+    sema::type_checker::error const& error
+  ) -> error_queue& {
+    using t = sema::type_checker::error_type;
+    _os << "[ERROR]: ";
+    switch (error.type) {
+      case t::MismatchedOperands:
+        _os << "Operands of the operator have different types"; break;
+      case t::MismatchedAssign:
+        _os << "Assigned value does not match the type of the variable"; break;
+      case t::MismatchedInit:
+        _os << "Initializer does not match the declared type"; break;
+      case t::MismatchedReturn:
+        _os << "Returned value does not match the return type"; break;
+      case t::VoidVariable:
+        _os << "Variables cannot be declared with type 'void'"; break;
+      case t::ArrayLength:
+        _os << "Arrays hold between 1 and 65536 integers"; break;
+      case t::ArrayInit:
+        _os << "Arrays must be 'mut' and cannot be initialized"; break;
+      case t::ArrayAsValue:
+        _os << "An array can only be indexed"; break;
+      case t::NotAnArray:
+        _os << "Only arrays can be indexed"; break;
+      case t::VoidValue:
+        _os << "A call of a 'void' function has no value"; break;
+      case t::ArrayInSignature:
+        _os << "Functions can only take and return integers"; break;
+      case t::MismatchedDeclaration:
+        _os << "Declaration does not match the earlier one of the function"; break;
+      case t::ArgumentCount:
+        _os << "Wrong number of arguments in the call"; break;
+      case t::MismatchedArgument:
+        _os << "Argument does not match the type of the parameter"; break;
+    }
+
+    _os
+      << "\n    ---> on value '" << error.target.value()
+      << "'\n    ---> on line " << error.target.line()
+      << ", column " << error.target.col() << ".\n";
+
+    ++_size;
+    if (_max_size != 0 && _size >= _max_size) {
+      _os << "[INFO]: Too many errors, stopping now.\n";
+      std::exit(EXIT_FAILURE);
+    }
+
+    return *this;
+  }
+
+  extern auto error_queue::operator<<(
+    sema::const_evaluator::error const& error
+  ) -> error_queue& {
+    using t = sema::const_evaluator::error_type;
+    _os << "[ERROR]: ";
+    switch (error.type) {
+      case t::LiteralOverflow:
+        _os << "Integer literal does not fit its type"; break;
+      case t::Overflow:
+        _os << "Constant expression overflows its type"; break;
+      case t::DivByZero:
+        _os << "Division by zero in a constant expression"; break;
+      case t::IndexOutOfRange:
+        _os << "Constant index is out of the range of the array"; break;
+    }
+
+    _os
+      << "\n    ---> on value '" << error.target.value()
+      << "'\n    ---> on line " << error.target.line()
+      << ", column " << error.target.col() << ".\n";
+
+    ++_size;
+    if (_max_size != 0 && _size >= _max_size) {
+      _os << "[INFO]: Too many errors, stopping now.\n";
+      std::exit(EXIT_FAILURE);
+    }
+
+    return *this;
+  }
+}
@@ -23,15 +23,24 @@
 
 #include <thalia-syntax/lexer.hpp>
 #include <thalia-syntax/parser.hpp>
+#include <thalia-sema/resolver.hpp>
+#include <thalia-sema/checker.hpp>
+#include <thalia-sema/consteval.hpp>
 
 namespace thalia {
   class error_queue
     : public syntax::lexer::error_queue
-    , public syntax::parser::error_queue {
+    , public syntax::parser::error_queue
+    , public sema::resolver::error_queue
+    , public sema::type_checker::error_queue
+    , public sema::const_evaluator::error_queue {
     public:
       error_queue(std::ostream& os, std::size_t max_size = 0)
         : syntax::lexer::error_queue {}
         , syntax::parser::error_queue {}
+        , sema::resolver::error_queue {}
+        , sema::type_checker::error_queue {}
+        , sema::const_evaluator::error_queue {}
         , _os { os }
         , _max_size { max_size }
         , _size { 0 } {}
@@ -45,6 +54,12 @@ namespace thalia {
         -> error_queue& override;
       auto operator<<(syntax::parser::error const& error)
         -> error_queue& override;
+      auto operator<<(sema::resolver::error const& error)
+        -> error_queue& override;
+      auto operator<<(sema::type_checker::error const& error)
+        -> error_queue& override;
+      auto operator<<(sema::const_evaluator::error const& error)
+        -> error_queue& override;
 
     private:
       std::ostream& _os;
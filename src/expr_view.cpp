@@ -89,11 +89,47 @@ namespace thalia {
       << _space << "ExprId { " << root->target() << " }";
   }
 
+  extern auto expr_view::visit_expr_index(std::ostream& os)
+    -> std::ostream& {
+    auto root = std::static_pointer_cast<syntax::expr_index>(_node);
+    auto target = expr_view { root->target(), _deep + 1 };
+    auto index = expr_view { root->index(), _deep + 1 };
+    return os
+      << _space << "ExprIndex {\n"
+      << target << ",\n"
+      << index << "\n"
+      << _space << "}";
+  }
+
+  extern auto expr_view::visit_expr_call(std::ostream& os)
+    -> std::ostream& {
+    auto root = std::static_pointer_cast<syntax::expr_call>(_node);
+    os
+      << _space << "ExprCall {\n  "
+      << _space << root->callee();
+    for (auto const& arg: root->args()) {
+      auto value = expr_view { arg, _deep + 1 };
+      os << ",\n" << value;
+    }
+    return os
+      << "\n" << _space << "}";
+  }
+
   extern auto expr_view::visit_expr_data_type(std::ostream& os)
     -> std::ostream& {
     auto root = std::static_pointer_cast<syntax::expr_data_type>(_node);
     return os
       << _space << "ExprDataType { " << root->target() << " }";
   }
-}
 
+  extern auto expr_view::visit_expr_array_type(std::ostream& os)
+    -> std::ostream& {
+    auto root = std::static_pointer_cast<syntax::expr_array_type>(_node);
+    auto element = expr_view { root->element(), _deep + 1 };
+    return os
+      << _space << "ExprArrayType {\n  "
+      << _space << root->length() << ",\n"
+      << element << "\n"
+      << _space << "}";
+  }
+}
@@ -45,7 +45,10 @@ namespace thalia {
       auto visit_expr_paren(std::ostream& os) -> std::ostream& override;
       auto visit_expr_base_lit(std::ostream& os) -> std::ostream& override;
       auto visit_expr_id(std::ostream& os) -> std::ostream& override;
+      auto visit_expr_index(std::ostream& os) -> std::ostream& override;
+      auto visit_expr_call(std::ostream& os) -> std::ostream& override;
       auto visit_expr_data_type(std::ostream& os) -> std::ostream& override;
+      auto visit_expr_array_type(std::ostream& os) -> std::ostream& override;
 
     private:
       std::size_t _deep;
@@ -0,0 +1,73 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include <thalia-syntax/lexer.hpp>
+#include <thalia-syntax/parser.hpp>
+
+#include "frontend.hpp"
+
+namespace thalia {
+  extern auto load(std::filesystem::path const& path)
+    -> std::optional<std::string> {
+    if (!std::filesystem::exists(path)) {
+      std::cout << "[ERROR]: File does not exists.\n";
+      return std::nullopt;
+    }
+
+    if (path.extension() != ".th") {
+      std::cout << "[ERROR]: Invalid file extension.\n";
+      return std::nullopt;
+    }
+
+    auto file = std::ifstream { path };
+    return std::string {
+      (std::istreambuf_iterator<char> { file }),
+      (std::istreambuf_iterator<char> {})
+    };
+  }
+
+  extern auto analyze(program& target, error_queue& equeue)
+    -> bool {
+    target.tokens = syntax::lexer { equeue, target.code }.scan_all();
+    if (!equeue.empty())
+      return false;
+
+    target.ast = syntax::parser { equeue, target.tokens }.parse();
+    if (!equeue.empty())
+      return false;
+
+    target.names = sema::resolver { equeue }.resolve(target.ast);
+    if (!equeue.empty())
+      return false;
+
+    auto checker = sema::type_checker { equeue, target.types, target.names };
+    target.typing = checker.check(target.ast);
+    if (!equeue.empty())
+      return false;
+
+    auto evaluator = sema::const_evaluator {
+      equeue, target.types, target.names, target.typing
+    };
+    target.values = evaluator.evaluate(target.ast);
+    return equeue.empty();
+  }
+}
@@ -0,0 +1,55 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THALIA_FRONTEND_
+#define _THALIA_FRONTEND_
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <thalia-syntax/stmts.hpp>
+#include <thalia-syntax/token.hpp>
+#include <thalia-sema/checker.hpp>
+#include <thalia-sema/consteval.hpp>
+#include <thalia-sema/resolver.hpp>
+#include <thalia-sema/types.hpp>
+
+#include "error_queue.hpp"
+
+namespace thalia {
+  struct program {
+    std::string code;
+    std::vector<syntax::token> tokens;
+    std::vector<std::shared_ptr<syntax::statement>> ast;
+    sema::type_table types;
+    sema::resolution names;
+    sema::typing typing { 0 };
+    sema::constants values { 0 };
+  };
+
+  extern auto load(std::filesystem::path const& path)
+    -> std::optional<std::string>;
+
+  extern auto analyze(program& target, error_queue& equeue)
+    -> bool;
+}
+
+#endif // _THALIA_FRONTEND_
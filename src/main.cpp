@@ -16,43 +16,58 @@
  * along with this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
-#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include <thalia-syntax/lexer.hpp>
 #include <thalia-syntax/parser.hpp>
+#include <thalia-sema/resolver.hpp>
+#include <thalia-sema/checker.hpp>
+#include <thalia-sema/consteval.hpp>
+#include <thalia-sema/tail_calls.hpp>
+#include <thalia-sema/types.hpp>
+#include <thalia-codegen/assembly.hpp>
+#include <thalia-codegen/c_source.hpp>
+#include <thalia-codegen/elf.hpp>
+#include <thalia-codegen/encoder.hpp>
+#include <thalia-codegen/jit.hpp>
+#include <thalia-codegen/lowering.hpp>
+#include <thalia-codegen/native.hpp>
+#include <thalia-codegen/tiering.hpp>
+#include <thalia-ir/builder.hpp>
+#include <thalia-ir/pipeline.hpp>
+#include <thalia-ir/printer.hpp>
+#include <thalia-ir/sccp.hpp>
+#include <thalia-vm/compiler.hpp>
+#include <thalia-vm/fusion.hpp>
+#include <thalia-vm/image.hpp>
+#include <thalia-vm/machine.hpp>
+#include <thalia-vm/reg_compiler.hpp>
+#include <thalia-vm/reg_machine.hpp>
 
 #include "stmt_view.hpp"
 #include "error_queue.hpp"
+#include "frontend.hpp"
 
-extern auto main(int argc, char** argv) -> int {
-  if (argc < 2) {
-    std::cout << "[ERROR]: Invalid number of args.\n";
-    return 1;
-  }
+using namespace thalia;
 
-  auto path = std::filesystem::absolute(argv[1]);
+static auto dump(std::filesystem::path const& path) -> int {
   std::cout << "FILE: " << path << '\n';
-  if (!std::filesystem::exists(path)) {
-    std::cout << "[ERROR]: File does not exists.\n";
-    return 1;
-  }
-
-  if (path.extension() != ".th") {
-    std::cout << "[ERROR]: Invalid file extension.\n";
+  auto code = load(path);
+  if (!code)
     return 1;
-  }
 
-  auto file = std::ifstream { path };
-  auto code = std::string {
-    (std::istreambuf_iterator<char> { file }),
-    (std::istreambuf_iterator<char> {})
-  };
-
-  using namespace thalia;
   auto equeue = error_queue { std::cout, 20 };
-  auto lexer = syntax::lexer { equeue, code };
+  auto lexer = syntax::lexer { equeue, *code };
 
   std::cout << "\n===   Lexemes   ===\n";
   auto tokens = lexer.scan_all();
@@ -71,6 +86,498 @@ extern auto main(int argc, char** argv) -> int {
     auto view = stmt_view { node };
     std::cout << view << '\n';
   }
+
+  auto resolver = sema::resolver { equeue };
+  auto names = resolver.resolve(ast);
+  if (!equeue.empty())
+    return 1;
+
+  auto types = sema::type_table {};
+  auto checker = sema::type_checker { equeue, types, names };
+  auto typing = checker.check(ast);
+  if (!equeue.empty())
+    return 1;
+
+  auto evaluator = sema::const_evaluator { equeue, types, names, typing };
+  evaluator.evaluate(ast);
+  if (!equeue.empty())
+    return 1;
   return 0;
 }
 
+struct run_options {
+  bool registers = false;
+  bool jit = false;
+  bool profile = false;
+  bool trace_tiering = false;
+  bool optimize = false;
+  bool report = false;
+  bool tails = false;
+};
+
+// Lists on the error stream every call that stays a call instead of
+// becoming a jump, and why. The C translation only turns the calls a
+// function returns to itself into jumps.
+static auto report_tail_calls(program const& source, bool self_only) -> void {
+  for (auto const& site: sema::find_calls(source.ast)) {
+    auto reason = sema::describe(site.reason);
+    if (site.reason == sema::tail_reason::Tail) {
+      if (!self_only || site.caller->id().value() == site.call->callee().value())
+        continue;
+      reason = "the C translation only turns calls of a function to itself into jumps";
+    }
+    std::cerr << "[tail] line " << site.call->callee().line() << ": call to "
+      << site.call->callee().value() << " stays a call: " << reason << '\n';
+  }
+}
+
+// Builds a program into SSA form and optimizes it. What constant
+// propagation proves about the top level is also handed back to the syntax
+// tree, so the backends working on it fold and prune the same code. With a
+// report, what the passes did is listed on the error stream.
+static auto optimize(program& source, bool report) -> ir::module {
+  auto builder = ir::builder { source.types, source.names, source.typing };
+  auto target = builder.build_module(source.ast);
+  ir::export_constants(ir::constant_facts { target.main }, builder, source.values);
+  auto log = std::vector<ir::remark> {};
+  ir::optimize(target, report ? &log : nullptr);
+  for (auto const& entry: log) {
+    std::cerr << "[opt] ";
+    if (entry.line != 0)
+      std::cerr << "line " << entry.line << ": ";
+    std::cerr << entry.message << '\n';
+  }
+  return target;
+}
+
+// Compiles an optimized program to machine code; with a report, how many
+// of the values of every compiled function the register allocator kept in
+// registers is listed too.
+static auto lower(
+  ir::module const& target,
+  bool report,
+  codegen::x86::program (codegen::ir_compiler::*compile)()
+) -> codegen::x86::program {
+  auto compiler = codegen::ir_compiler { target };
+  auto result = (compiler.*compile)();
+  if (report) {
+    for (auto const& [name, stats]: compiler.stats())
+      std::cerr << "[opt] function " << name << ": " << stats.in_registers
+        << " values in registers, " << stats.spilled << " spilled, " << stats.splits << " splits\n";
+  }
+  return result;
+}
+
+static auto finish(
+  vm::outcome result,
+  std::span<vm::global const> globals,
+  std::span<std::int64_t const> slots
+) -> int {
+  if (result.state == vm::status::DivByZero) {
+    std::cout << "[ERROR]: Division by zero\n    ---> on line " << result.line << ".\n";
+    return 1;
+  }
+  if (result.state == vm::status::IndexOutOfRange) {
+    std::cout << "[ERROR]: Index out of range\n    ---> on line " << result.line << ".\n";
+    return 1;
+  }
+  if (result.state == vm::status::StackOverflow) {
+    std::cout << "[ERROR]: Stack overflow\n    ---> on line " << result.line << ".\n";
+    return 1;
+  }
+  if (result.state == vm::status::Malformed) {
+    std::cout << "[ERROR]: Malformed bytecode\n    ---> at offset " << result.value << ".\n";
+    return 1;
+  }
+
+  for (auto const& global: globals)
+    std::cout << global.name << " = " << slots[global.slot] << '\n';
+  return result.state == vm::status::Returned
+    ? static_cast<int>(result.value)
+    : 0;
+}
+
+static auto run_stack(program const& source, run_options options) -> int {
+  auto compiler = vm::compiler { source.types, source.names, source.typing, source.values };
+  auto chunk = compiler.compile(source.ast);
+  auto fused = vm::fuse(chunk);
+  auto machine = vm::machine { chunk, options.profile };
+
+  // Profiles describe the interpreter alone, so they keep every loop in it.
+  auto native = codegen::native_compiler { source.types, source.names, source.typing, source.values };
+  auto tier = codegen::jit_tier {
+    native, compiler.loops(), chunk,
+    codegen::tiering_options { 1000, options.trace_tiering ? &std::cerr : nullptr }
+  };
+  if (codegen::jit_supported && !options.profile)
+    machine.attach(tier);
+
+  auto status = finish(machine.run(), chunk.globals, machine.slots());
+  if (options.trace_tiering) {
+    for (auto loop = std::size_t { 0 }; loop < chunk.loops.size(); ++loop)
+      std::cerr << "[tiering] loop " << loop << " (line " << chunk.loops[loop].line << "): "
+        << machine.iterations()[loop] << " tests reached in the interpreter, "
+        << tier.entries()[loop] << " runs as machine code\n";
+  }
+  if (options.profile) {
+    std::cout << "\n===    Profile    ===\n";
+    vm::print_profile(std::cout, fused, machine.executions());
+  }
+  return status;
+}
+
+static auto run_registers(program const& source) -> int {
+  auto compiler = vm::reg_compiler { source.types, source.names, source.typing, source.values };
+  auto chunk = compiler.compile(source.ast);
+  auto machine = vm::reg_machine { chunk };
+  return finish(machine.run(), chunk.globals, machine.slots());
+}
+
+static auto run_jit(program const& source, std::optional<ir::module> const& optimized, bool report) -> int {
+  if (!codegen::jit_supported) {
+    std::cout << "[ERROR]: '--jit' needs x86-64 Linux.\n";
+    return 1;
+  }
+  auto compiler = codegen::native_compiler { source.types, source.names, source.typing, source.values };
+  auto machine = codegen::jit_machine {
+    optimized
+      ? lower(*optimized, report, &codegen::ir_compiler::compile_function)
+      : compiler.compile_function(source.ast),
+    vm::frame_of(source.types, source.names, source.typing).slots
+  };
+  auto globals = vm::globals_of(source.types, source.names, source.typing);
+  return finish(machine.run(), globals, machine.slots());
+}
+
+// Runs a compiled image on the stack machine, straight from the mapping.
+static auto run_image(std::filesystem::path const& path, run_options options) -> int {
+  if (options.registers || options.jit || options.profile || options.trace_tiering) {
+    std::cout << "[ERROR]: Bytecode images only run on the stack machine, untiered.\n";
+    return 1;
+  }
+
+  try {
+    auto image = vm::mapped_image { path };
+    auto machine = vm::machine { image.view() };
+    return finish(machine.run(), image.globals(), machine.slots());
+  } catch (vm::image_error const& error) {
+    std::cout << "[ERROR]: " << error.what() << "\n    ---> in file " << path << ".\n";
+    return 1;
+  }
+}
+
+static auto run(std::filesystem::path const& path, run_options options) -> int {
+  if (path.extension() == ".thb")
+    return run_image(path, options);
+
+  auto source = program {};
+  auto code = load(path);
+  if (!code)
+    return 1;
+  source.code = std::move(*code);
+
+  auto equeue = error_queue { std::cout, 20 };
+  if (!analyze(source, equeue))
+    return 1;
+  if (options.tails)
+    report_tail_calls(source, false);
+
+  auto optimized = std::optional<ir::module> {};
+  if (options.optimize)
+    optimized = optimize(source, options.report);
+  if (options.jit)
+    return run_jit(source, optimized, options.report);
+  return options.registers
+    ? run_registers(source)
+    : run_stack(source, options);
+}
+
+struct arguments {
+  std::vector<std::string_view> flags;
+  std::optional<std::string_view> output;
+  std::vector<std::string_view> files;
+};
+
+static auto parse(int argc, char** argv) -> std::optional<arguments> {
+  auto result = arguments {};
+  for (auto i = 2; i < argc; ++i) {
+    auto arg = std::string_view { argv[i] };
+    if (arg == "-o") {
+      if (++i == argc)
+        return std::nullopt;
+      result.output = argv[i];
+    } else if (arg.starts_with("--") || arg == "-O") {
+      result.flags.push_back(arg);
+    } else {
+      result.files.push_back(arg);
+    }
+  }
+  return result;
+}
+
+static auto unknown(std::string_view option) -> int {
+  std::cout << "[ERROR]: Unknown option '" << option << "'.\n";
+  return 1;
+}
+
+// The report is of what the optimizer did, so it is refused without it.
+static auto report_without_optimizer() -> int {
+  std::cout << "[ERROR]: Option '--opt-report' requires '-O'.\n";
+  return 1;
+}
+
+static auto compile(
+  std::filesystem::path const& path,
+  std::filesystem::path const& output,
+  bool optimized,
+  bool report,
+  bool tails
+) -> int {
+  auto source = program {};
+  auto code = load(path);
+  if (!code)
+    return 1;
+  source.code = std::move(*code);
+
+  auto equeue = error_queue { std::cout, 20 };
+  if (!analyze(source, equeue))
+    return 1;
+  if (tails)
+    report_tail_calls(source, false);
+  if (optimized)
+    optimize(source, report);
+
+  auto compiler = vm::compiler { source.types, source.names, source.typing, source.values };
+  auto chunk = compiler.compile(source.ast);
+  vm::fuse(chunk);
+  auto out = std::ofstream { output, std::ios::binary };
+  vm::write_image(out, chunk);
+  out.close();
+  if (!out) {
+    std::cout << "[ERROR]: Cannot write to " << output << ".\n";
+    return 1;
+  }
+  return 0;
+}
+
+enum class emit_kind {
+  Executable,
+  Object,
+  Assembly,
+  C,
+  Ir
+};
+
+struct build_options {
+  emit_kind emit = emit_kind::Executable;
+  bool time = false;
+  bool optimize = false;
+  bool report = false;
+  bool tails = false;
+  std::filesystem::path output;
+};
+
+using clock_type = std::chrono::steady_clock;
+
+static auto milliseconds_since(clock_type::time_point& start) -> double {
+  auto now = clock_type::now();
+  auto elapsed = std::chrono::duration<double, std::milli>(now - start).count();
+  start = now;
+  return elapsed;
+}
+
+static auto write_c(program const& source, std::filesystem::path const& path) -> bool {
+  auto compiler = codegen::c_compiler { source.types, source.names, source.typing, source.values };
+  auto out = std::ofstream { path };
+  out << compiler.compile(source.ast);
+  return static_cast<bool>(out);
+}
+
+static auto write_ir(
+  program const& source,
+  std::optional<ir::module> const& optimized,
+  std::filesystem::path const& path
+) -> bool {
+  auto builder = ir::builder { source.types, source.names, source.typing };
+  auto out = std::ofstream { path };
+  ir::print(out, optimized ? *optimized : builder.build_module(source.ast));
+  return static_cast<bool>(out);
+}
+
+// Compiles to machine code and writes it; `clock` is advanced past every
+// stage it times.
+static auto write_native(
+  program const& source,
+  std::optional<ir::module> const& optimized,
+  build_options const& options,
+  clock_type::time_point& clock
+) -> bool {
+  auto compiler = codegen::native_compiler { source.types, source.names, source.typing, source.values };
+  auto target = optimized
+    ? lower(*optimized, options.report, &codegen::ir_compiler::compile)
+    : compiler.compile(source.ast);
+  auto start = options.emit == emit_kind::Executable
+    ? codegen::add_start(target)
+    : target.entry;
+  auto codegen_time = milliseconds_since(clock);
+
+  if (options.emit == emit_kind::Assembly) {
+    auto out = std::ofstream { options.output };
+    codegen::print_assembly(out, target);
+    return static_cast<bool>(out);
+  }
+
+  auto code = codegen::x86::encode(target);
+  auto encoding_time = milliseconds_since(clock);
+
+  auto out = std::ofstream { options.output, std::ios::binary };
+  if (options.emit == emit_kind::Object)
+    codegen::write_object(out, target, code);
+  else codegen::write_executable(out, std::move(code), start);
+  out.close();
+  auto writing_time = milliseconds_since(clock);
+
+  if (options.time) {
+    std::cout << "codegen     " << codegen_time << " ms\n"
+      << "encoding    " << encoding_time << " ms\n"
+      << "writing     " << writing_time << " ms\n";
+  }
+  return static_cast<bool>(out);
+}
+
+static auto build(std::filesystem::path const& path, build_options const& options) -> int {
+  auto clock = clock_type::now();
+  auto source = program {};
+  auto code = load(path);
+  if (!code)
+    return 1;
+  source.code = std::move(*code);
+
+  auto equeue = error_queue { std::cout, 20 };
+  if (!analyze(source, equeue))
+    return 1;
+  auto analysis_time = milliseconds_since(clock);
+  if (options.time) {
+    std::cout << std::fixed << std::setprecision(3) << "===    Timings    ===\n"
+      << "analysis    " << analysis_time << " ms\n";
+  }
+  if (options.tails)
+    report_tail_calls(source, options.emit == emit_kind::C);
+
+  auto optimized = std::optional<ir::module> {};
+  if (options.optimize) {
+    optimized = optimize(source, options.report);
+    if (options.time)
+      std::cout << "optimizer   " << milliseconds_since(clock) << " ms\n";
+  }
+
+  auto written = options.emit == emit_kind::C ? write_c(source, options.output)
+    : options.emit == emit_kind::Ir ? write_ir(source, optimized, options.output)
+    : write_native(source, optimized, options, clock);
+  if (!written) {
+    std::cout << "[ERROR]: Cannot write to " << options.output << ".\n";
+    return 1;
+  }
+
+  if (options.emit == emit_kind::Executable) {
+    using std::filesystem::perms;
+    std::filesystem::permissions(
+      options.output,
+      perms::owner_exec | perms::group_exec | perms::others_exec,
+      std::filesystem::perm_options::add
+    );
+  }
+  return 0;
+}
+
+extern auto main(int argc, char** argv) -> int {
+  if (argc < 2) {
+    std::cout << "[ERROR]: Invalid number of args.\n";
+    return 1;
+  }
+
+  auto command = std::string_view { argv[1] };
+  if (command != "run" && command != "build" && command != "compile")
+    return dump(std::filesystem::absolute(argv[1]));
+
+  auto args = parse(argc, argv);
+  if (!args || args->files.size() != 1) {
+    std::cout << "[ERROR]: Invalid number of args.\n";
+    return 1;
+  }
+  auto file = std::filesystem::absolute(args->files.front());
+
+  if (command == "run") {
+    auto options = run_options {};
+    for (auto flag: args->flags) {
+      if (flag == "--registers")
+        options.registers = true;
+      else if (flag == "--jit")
+        options.jit = true;
+      else if (flag == "--profile")
+        options.profile = true;
+      else if (flag == "--trace-tiering")
+        options.trace_tiering = true;
+      else if (flag == "-O")
+        options.optimize = true;
+      else if (flag == "--opt-report")
+        options.report = true;
+      else if (flag == "--tail-report")
+        options.tails = true;
+      else return unknown(flag);
+    }
+    if (options.report && !options.optimize)
+      return report_without_optimizer();
+    return run(file, options);
+  }
+
+  if (command == "compile") {
+    auto optimized = false;
+    auto report = false;
+    auto tails = false;
+    for (auto flag: args->flags) {
+      if (flag == "-O")
+        optimized = true;
+      else if (flag == "--opt-report")
+        report = true;
+      else if (flag == "--tail-report")
+        tails = true;
+      else return unknown(flag);
+    }
+    if (report && !optimized)
+      return report_without_optimizer();
+    auto output = args->output
+      ? std::filesystem::path { *args->output }
+      : std::filesystem::path { file }.replace_extension(".thb");
+    return compile(file, output, optimized, report, tails);
+  }
+
+  auto options = build_options {};
+  options.output = args->output
+    ? std::filesystem::path { *args->output }
+    : file.parent_path() / file.stem();
+  for (auto flag: args->flags) {
+    if (flag == "--emit=asm")
+      options.emit = emit_kind::Assembly;
+    else if (flag == "--emit=obj")
+      options.emit = emit_kind::Object;
+    else if (flag == "--emit=c")
+      options.emit = emit_kind::C;
+    else if (flag == "--emit=ir")
+      options.emit = emit_kind::Ir;
+    else if (flag == "--emit=exe")
+      options.emit = emit_kind::Executable;
+    else if (flag == "--time")
+      options.time = true;
+    else if (flag == "-O")
+      options.optimize = true;
+    else if (flag == "--opt-report")
+      options.report = true;
+    else if (flag == "--tail-report")
+      options.tails = true;
+    else return unknown(flag);
+  }
+  if (options.report && !options.optimize)
+    return report_without_optimizer();
+  return build(file, options);
+}
@@ -25,6 +25,8 @@ namespace thalia {
   extern auto stmt_view::visit_stmt_return(std::ostream& os)
     -> std::ostream& {
       auto root = std::static_pointer_cast<syntax::stmt_return>(_node);
+      if (!root->value())
+        return os << _space << "StmtReturn {}";
       auto value = expr_view { root->value(), _deep + 1 };
       return os
         << _space << "StmtReturn {\n"
@@ -111,5 +113,30 @@ namespace thalia {
       << body << "\n"
       << _space << "}";
   }
-}
 
+  extern auto stmt_view::visit_stmt_function(std::ostream& os)
+    -> std::ostream& {
+    auto root = std::static_pointer_cast<syntax::stmt_function>(_node);
+    auto data_type = expr_view { root->data_type(), _deep + 1 };
+
+    os
+      << _space << "StmtFunction {\n  "
+      << _space << root->keyword() << ",\n  "
+      << _space << root->id() << ",\n";
+    for (auto const& param: root->params()) {
+      auto param_type = expr_view { param.data_type, _deep + 2 };
+      os
+        << _space << "  Param {\n"
+        << _space << "    " << param.id << "\n"
+        << param_type << "\n"
+        << _space << "  }\n";
+    }
+    os << data_type << "\n";
+    if (root->body()) {
+      auto body = stmt_view { root->body(), _deep + 1 };
+      os << body << "\n";
+    }
+    return os
+      << _space << "}";
+  }
+}
@@ -45,6 +45,7 @@ namespace thalia {
       auto visit_stmt_local(std::ostream& os) -> std::ostream& override;
       auto visit_stmt_if(std::ostream& os) -> std::ostream& override;
       auto visit_stmt_while(std::ostream& os) -> std::ostream& override;
+      auto visit_stmt_function(std::ostream& os) -> std::ostream& override;
 
     private:
       std::size_t _deep;
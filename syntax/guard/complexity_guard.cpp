@@ -0,0 +1,189 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+
+#include "pipeline.hpp"
+
+using namespace thalia;
+
+// Every generator is timed at a base size and at `growth` times that size.
+// A linear pipeline keeps the per-byte cost roughly constant, a quadratic
+// one multiplies it by `growth`, so `slack` sits well between the two.
+static constexpr std::size_t growth = 16;
+static constexpr double slack = 4.0;
+static constexpr int samples = 3;
+
+static auto time_pipeline(std::string const& code)
+  -> double {
+  auto best = std::chrono::nanoseconds::max();
+  for (int i = 0; i < samples; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    syntax::guard::run_pipeline(code);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    best = std::min(best, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed));
+  }
+  return static_cast<double>(best.count());
+}
+
+static auto check_linear(
+  std::function<std::string(std::size_t)> const& generate,
+  std::size_t base
+) -> void {
+  auto small = generate(base);
+  auto large = generate(base * growth);
+
+  auto small_cost = time_pipeline(small) / static_cast<double>(small.size());
+  auto large_cost = time_pipeline(large) / static_cast<double>(large.size());
+
+  INFO("bytes: " << small.size() << " -> " << large.size());
+  INFO("ns/byte: " << small_cost << " -> " << large_cost);
+  CHECK(large_cost <= small_cost * slack);
+}
+
+static auto nested_parens(std::size_t depth)
+  -> std::string {
+  return "def x: i32 = "
+    + std::string(depth, '(') + "1i32" + std::string(depth, ')') + ";\n";
+}
+
+static auto nested_blocks(std::size_t depth)
+  -> std::string {
+  return std::string(depth, '{') + std::string(depth, '}');
+}
+
+// The linear-time checks scale the number of nested groups rather than
+// their depth, which stays at half the parser's limit, so they time the
+// recursive descent itself and not the cutoff past `max_depth`.
+static constexpr std::size_t group_depth = syntax::parser::max_depth / 2;
+
+static auto paren_groups(std::size_t count)
+  -> std::string {
+  auto group = std::string(group_depth, '(') + "1i32" + std::string(group_depth, ')');
+  auto code = std::string { "def mut x: i32 = 0i32;\n" };
+  for (std::size_t i = 0; i < count; ++i)
+    code += "x = " + group + ";\n";
+  return code;
+}
+
+static auto block_groups(std::size_t count)
+  -> std::string {
+  auto code = std::string {};
+  for (std::size_t i = 0; i < count; ++i)
+    code += std::string(group_depth, '{') + std::string(group_depth, '}');
+  return code;
+}
+
+static auto assign_chain(std::size_t length)
+  -> std::string {
+  auto code = std::string { "def mut a: i32 = 0i32;\n" };
+  for (std::size_t i = 0; i < length; ++i)
+    code += "a = ";
+  return code + "1i32;\n";
+}
+
+static auto sum_chain(std::size_t length)
+  -> std::string {
+  auto code = std::string { "def mut a: i32 = 0i32;\na = a" };
+  for (std::size_t i = 1; i < length; ++i)
+    code += " + a";
+  return code + ";\n";
+}
+
+static auto chain_groups(std::size_t count)
+  -> std::string {
+  auto code = std::string {};
+  for (std::size_t i = 0; i < count; ++i)
+    code += assign_chain(group_depth) + sum_chain(group_depth);
+  return code;
+}
+
+static auto error_storm(std::size_t count)
+  -> std::string {
+  auto code = std::string {};
+  for (std::size_t i = 0; i < count; ++i)
+    code += "def : ) } ; ";
+  return code;
+}
+
+static auto unknown_run(std::size_t length)
+  -> std::string {
+  auto code = std::string {};
+  for (std::size_t i = 0; i < length; ++i)
+    code += "@?`";
+  return code;
+}
+
+TEST_CASE("complexity: nested parentheses") {
+  check_linear(paren_groups, 16);
+  CHECK(syntax::guard::run_pipeline(paren_groups(16 * growth)).parser_errors == 0);
+}
+
+TEST_CASE("complexity: nested blocks") {
+  check_linear(block_groups, 16);
+  CHECK(syntax::guard::run_pipeline(block_groups(16 * growth)).parser_errors == 0);
+}
+
+TEST_CASE("complexity: operator chains") {
+  check_linear(chain_groups, 16);
+  CHECK(syntax::guard::run_pipeline(chain_groups(16 * growth)).parser_errors == 0);
+}
+
+TEST_CASE("complexity: error recovery") {
+  check_linear(error_storm, 512);
+}
+
+TEST_CASE("complexity: unknown characters") {
+  check_linear(unknown_run, 4096);
+}
+
+TEST_CASE("nesting beyond the limit is reported once") {
+  auto limit = syntax::parser::max_depth;
+
+  auto shallow = syntax::guard::run_pipeline(nested_parens(limit / 2));
+  CHECK(shallow.parser_errors == 0);
+
+  auto deep = syntax::guard::run_pipeline(nested_parens(limit * 4));
+  CHECK(deep.nesting_errors == 1);
+
+  auto blocks = syntax::guard::run_pipeline(nested_blocks(limit * 4));
+  CHECK(blocks.nesting_errors == 1);
+}
+
+TEST_CASE("operator chains beyond the limit are reported once") {
+  auto limit = syntax::parser::max_depth;
+  CHECK(syntax::guard::run_pipeline(assign_chain(limit / 2)).parser_errors == 0);
+  CHECK(syntax::guard::run_pipeline(sum_chain(limit / 2)).parser_errors == 0);
+
+  // Every operator of a chain is a level of the tree the passes walk.
+  auto assigns = syntax::guard::run_pipeline(assign_chain(100000));
+  CHECK(assigns.nesting_errors == 1);
+  auto sums = syntax::guard::run_pipeline(sum_chain(100000));
+  CHECK(sums.nesting_errors == 1);
+}
+
+TEST_CASE("stray closing tokens do not stall recovery") {
+  auto result = syntax::guard::run_pipeline(") } ) }");
+  CHECK(result.parser_errors > 0);
+  CHECK(result.parser_errors <= 8);
+}
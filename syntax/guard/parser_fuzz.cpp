@@ -0,0 +1,48 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+
+#include "pipeline.hpp"
+
+// A generous linear budget: a fixed allowance plus a per-byte one. Inputs that
+// blow through it point at superlinear behaviour, so they are reported as
+// crashes and kept by libFuzzer as reproducers.
+static constexpr auto base_budget = std::chrono::milliseconds { 50 };
+static constexpr auto byte_budget = std::chrono::microseconds { 5 };
+
+extern "C" auto LLVMFuzzerTestOneInput(std::uint8_t const* data, std::size_t size)
+  -> int {
+  auto code = std::string_view { reinterpret_cast<char const*>(data), size };
+
+  auto start = std::chrono::steady_clock::now();
+  thalia::syntax::guard::run_pipeline(code);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  auto budget = base_budget + byte_budget * static_cast<long>(size);
+  if (elapsed > budget) {
+    std::fprintf(stderr, "[FUZZ]: %zu bytes exceeded the time budget.\n", size);
+    std::abort();
+  }
+  return 0;
+}
@@ -0,0 +1,70 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THALIA_SYNTAX_GUARD_PIPELINE_
+#define _THALIA_SYNTAX_GUARD_PIPELINE_
+
+#include <cstddef>
+#include <string_view>
+
+#include "thalia-syntax/lexer.hpp"
+#include "thalia-syntax/parser.hpp"
+
+namespace thalia::syntax::guard {
+  /**
+   * @brief An error queue that only counts what it receives.
+   *
+   * Unlike the driver's queue it never stops early, so every error path of the
+   * lexer and parser is exercised on hostile inputs.
+   */
+  class counting_queue
+    : public lexer::error_queue
+    , public parser::error_queue {
+    public:
+      auto operator<<(lexer::error const&) -> counting_queue& override
+        { ++lexer_errors; return *this; }
+      auto operator<<(parser::error const& error) -> counting_queue& override {
+        ++parser_errors;
+        if (error.type == parser::error_type::TooDeepNesting)
+          ++nesting_errors;
+        return *this;
+      }
+
+    public:
+      std::size_t lexer_errors = 0;
+      std::size_t parser_errors = 0;
+      std::size_t nesting_errors = 0;
+  };
+
+  /**
+   * @brief Runs the lexer and the parser over a source string.
+   * @param code The source code.
+   * @return The errors reported along the way.
+   */
+  inline auto run_pipeline(std::string_view code)
+    -> counting_queue {
+    auto equeue = counting_queue {};
+    auto lexer = syntax::lexer { equeue, code };
+    auto tokens = lexer.scan_all();
+    auto parser = syntax::parser { equeue, tokens };
+    parser.parse();
+    return equeue;
+  }
+}
+
+#endif // _THALIA_SYNTAX_GUARD_PIPELINE_
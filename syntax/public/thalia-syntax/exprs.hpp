@@ -20,6 +20,8 @@
 #define _THALIA_SYNTAX_EXPRS_
 
 #include <memory>
+#include <span>
+#include <vector>
 
 #include "node.hpp"
 #include "token.hpp"
@@ -35,7 +37,10 @@ namespace thalia::syntax {
     Paren,
     BaseLit,
     Id,
-    DataType
+    Index,
+    Call,
+    DataType,
+    ArrayType
   };
 
   /**
@@ -256,6 +261,89 @@ namespace thalia::syntax {
       token _target;
   };
 
+  /**
+   * @brief Represents an element of an array (e.g., `a[i]`).
+   */
+  class expr_index: public expression {
+    public:
+      /**
+       * @brief Constructs an index expression.
+       * @param bracket The opening bracket token.
+       * @param target The indexed array.
+       * @param index The index of the element.
+       */
+      expr_index(
+        token const& bracket,
+        std::shared_ptr<expression> const& target,
+        std::shared_ptr<expression> const& index
+      ) : expression { expr_type::Index }
+        , _bracket { bracket }
+        , _target { target }
+        , _index { index } {}
+
+      /**
+       * @brief Gets the opening bracket, which locates the access.
+       * @return The bracket token.
+       */
+      auto bracket() const -> token
+        { return _bracket; }
+
+      /**
+       * @brief Gets the indexed array.
+       * @return The array expression.
+       */
+      auto target() const -> std::shared_ptr<expression>
+        { return _target; }
+
+      /**
+       * @brief Gets the index of the element.
+       * @return The index expression.
+       */
+      auto index() const -> std::shared_ptr<expression>
+        { return _index; }
+
+    private:
+      token _bracket;
+      std::shared_ptr<expression> _target;
+      std::shared_ptr<expression> _index;
+  };
+
+  /**
+   * @brief Represents a call of a function (e.g., `f(a, b)`).
+   */
+  class expr_call: public expression {
+    public:
+      /**
+       * @brief Constructs a call expression.
+       * @param callee The name of the called function.
+       * @param args The arguments, in order.
+       */
+      expr_call(
+        token const& callee,
+        std::vector<std::shared_ptr<expression>> const& args
+      ) : expression { expr_type::Call }
+        , _callee { callee }
+        , _args { args } {}
+
+      /**
+       * @brief Gets the name of the called function, which locates the call.
+       * @return The identifier token.
+       */
+      auto callee() const -> token
+        { return _callee; }
+
+      /**
+       * @brief Gets the arguments of the call.
+       * @return A span of argument expressions.
+       */
+      auto args() const -> std::span<std::shared_ptr<expression> const>
+        { return _args; }
+
+    private:
+      token _callee;
+      std::vector<std::shared_ptr<expression>> _args;
+  };
+
   /**
    * @brief Represents a type literal expression (e.g., `i32`, `void`).
    */
@@ -279,6 +367,42 @@ namespace thalia::syntax {
       token _target;
   };
 
+  /**
+   * @brief Represents a fixed-size array type (e.g., `[16]i32`).
+   */
+  class expr_array_type: public expression {
+    public:
+      /**
+       * @brief Constructs an array type expression.
+       * @param length The integer literal token giving the number of elements.
+       * @param element The type of the elements.
+       */
+      expr_array_type(
+        token const& length,
+        std::shared_ptr<expression> const& element
+      ) : expression { expr_type::ArrayType }
+        , _length { length }
+        , _element { element } {}
+
+      /**
+       * @brief Gets the token giving the number of elements.
+       * @return The length token.
+       */
+      auto length() const -> token
+        { return _length; }
+
+      /**
+       * @brief Gets the type of the elements.
+       * @return The element type expression.
+       */
+      auto element() const -> std::shared_ptr<expression>
+        { return _element; }
+
+    private:
+      token _length;
+      std::shared_ptr<expression> _element;
+  };
+
   /**
    * @brief Base class for implementing the visitor pattern for expressions.
    * @tparam Input The input parameter type passed to visitor methods.
@@ -314,7 +438,10 @@ namespace thalia::syntax {
       virtual auto visit_expr_paren(Input value) -> Output = 0;
       virtual auto visit_expr_base_lit(Input value) -> Output = 0;
       virtual auto visit_expr_id(Input value) -> Output = 0;
+      virtual auto visit_expr_index(Input value) -> Output = 0;
+      virtual auto visit_expr_call(Input value) -> Output = 0;
       virtual auto visit_expr_data_type(Input value) -> Output = 0;
+      virtual auto visit_expr_array_type(Input value) -> Output = 0;
 
     protected:
       std::shared_ptr<expression> _node;
@@ -336,8 +463,14 @@ namespace thalia::syntax {
         return visit_expr_base_lit(value);
       case expr_type::Id:
         return visit_expr_id(value);
+      case expr_type::Index:
+        return visit_expr_index(value);
+      case expr_type::Call:
+        return visit_expr_call(value);
       case expr_type::DataType:
         return visit_expr_data_type(value);
+      case expr_type::ArrayType:
+        return visit_expr_array_type(value);
     }
   }
 }
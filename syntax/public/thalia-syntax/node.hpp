@@ -56,7 +56,7 @@ namespace thalia::syntax {
        * @return True if the node's type is in the list.
        */
       auto is(std::initializer_list<Type> types) const -> bool
-        { return types.end() != std::find(types, _type); }
+        { return types.end() != std::find(types.begin(), types.end(), _type); }
 
       /**
        * @brief Gets the type of the node.
@@ -19,6 +19,7 @@
 #ifndef _THALIA_SYNTAX_PARSER_
 #define _THALIA_SYNTAX_PARSER_
 
+#include <cstddef>
 #include <initializer_list>
 #include <memory>
 #include <functional>
@@ -47,13 +48,17 @@ namespace thalia::syntax {
         ExpectedPrimary,
         ExpectedLParen,
         ExpectedRParen,
+        ExpectedRBracket,
+        ExpectedArrayLength,
         ExpectedSemi,
         ExpectedLBrace,
         ExpectedRBrace,
         ExpectedId,
         ExpectedColon,
         ExpectedConstValue,
-        ExpectedLitType
+        ExpectedLitType,
+        TooDeepNesting,
+        MisplacedFunction
       };
 
       /**
@@ -66,6 +71,17 @@ namespace thalia::syntax {
        */
       using error_queue = error_queue<error_type, token>;
 
+      /**
+       * @brief The deepest nesting of blocks and expressions the parser accepts.
+       *
+       * Statements and parenthesized expressions are parsed recursively, and
+       * every operator of a chain folded in a loop adds a level to the tree
+       * that later passes walk recursively, so both count. The limit keeps
+       * hostile inputs from exhausting the native stack anywhere in the
+       * front end.
+       */
+      static constexpr std::size_t max_depth = 256;
+
     public:
       /**
        * @brief Constructs a parser from a complete token vector.
@@ -90,7 +106,8 @@ namespace thalia::syntax {
         std::vector<token>::const_iterator end
       ) : _errors { equeue }
         , _end { end }
-        , _current { begin } {}
+        , _current { begin }
+        , _depth { 0 } {}
 
       auto eof() -> bool
         { return _current->is(token_type::Eof); }
@@ -105,6 +122,7 @@ namespace thalia::syntax {
         error_type error
       ) -> token const&;
       auto skip_until(std::initializer_list<token_type> types) -> void;
+      auto nest() -> void;
 
       auto parse_statement() -> std::shared_ptr<statement>;
       auto parse_expression() -> std::shared_ptr<expression>;
@@ -115,6 +133,7 @@ namespace thalia::syntax {
       auto parse_stmt_if() -> std::shared_ptr<statement>;
       auto parse_stmt_while() -> std::shared_ptr<statement>;
       auto parse_stmt_local() -> std::shared_ptr<statement>;
+      auto parse_stmt_function() -> std::shared_ptr<statement>;
 
       auto parse_expr_assign() -> std::shared_ptr<expression>;
       auto parse_expr_log_or() -> std::shared_ptr<expression>;
@@ -128,8 +147,10 @@ namespace thalia::syntax {
       auto parse_expr_add() -> std::shared_ptr<expression>;
       auto parse_expr_mul() -> std::shared_ptr<expression>;
       auto parse_expr_unary() -> std::shared_ptr<expression>;
+      auto parse_expr_postfix() -> std::shared_ptr<expression>;
       auto parse_expr_primary() -> std::shared_ptr<expression>;
       auto parse_expr_paren() -> std::shared_ptr<expression>;
+      auto parse_expr_call(token const& callee) -> std::shared_ptr<expression>;
       auto parse_expr_data_type() -> std::shared_ptr<expression>;
       auto parse_expr_binary(
         std::initializer_list<token_type> types,
@@ -140,6 +161,7 @@ namespace thalia::syntax {
       error_queue& _errors;
       std::vector<token>::const_iterator _end;
       std::vector<token>::const_iterator _current;
+      std::size_t _depth;
   };
 }
 
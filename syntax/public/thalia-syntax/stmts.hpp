@@ -37,7 +37,8 @@ namespace thalia::syntax {
     Return,
     If,
     While,
-    Local
+    Local,
+    Function
   };
 
   /**
@@ -102,21 +103,32 @@ namespace thalia::syntax {
     public:
       /**
        * @brief Constructs a return statement with an optional return value.
+       * @param keyword The `return` token, which locates the statement.
        * @param value The optional return value expression.
        */
       stmt_return(
+        token const& keyword,
         std::shared_ptr<expression> const& value
       ) : statement { stmt_type::Return }
+        , _keyword { keyword }
         , _value { value } {}
 
+      /**
+       * @brief Returns the `return` token.
+       * @return The keyword token.
+       */
+      auto keyword() const -> token
+        { return _keyword; }
+
       /**
        * @brief Returns the return value expression.
-       * @return A pointer to the return expression.
+       * @return A pointer to the return expression, or nullptr.
        */
       auto value() const -> std::shared_ptr<expression>
         { return _value; }
 
     private:
+      token _keyword;
       std::shared_ptr<expression> _value;
   };
 
@@ -256,6 +268,79 @@ namespace thalia::syntax {
       std::vector<variable> _content;
   };
 
+  /**
+   * @brief Represents a function declaration (`use`) or definition
+   *   (`global` or `local`).
+   *
+   * Parameters are immutable variables with no initializer. A declaration
+   * has no body; it lets calls come before the definition.
+   */
+  class stmt_function: public statement {
+    public:
+      /**
+       * @brief Constructs a function declaration or definition.
+       * @param keyword The `use`, `global` or `local` token.
+       * @param id The name of the function.
+       * @param params The parameters, in order.
+       * @param data_type The type of the returned value.
+       * @param body The body block, or nullptr for a declaration.
+       */
+      stmt_function(
+        token const& keyword,
+        token const& id,
+        std::vector<stmt_local::variable> const& params,
+        std::shared_ptr<expression> const& data_type,
+        std::shared_ptr<statement> const& body = nullptr
+      ) : statement { stmt_type::Function }
+        , _keyword { keyword }
+        , _id { id }
+        , _params { params }
+        , _data_type { data_type }
+        , _body { body } {}
+
+      /**
+       * @brief Returns the `use`, `global` or `local` token.
+       * @return The keyword token.
+       */
+      auto keyword() const -> token
+        { return _keyword; }
+
+      /**
+       * @brief Returns the name of the function.
+       * @return The identifier token.
+       */
+      auto id() const -> token
+        { return _id; }
+
+      /**
+       * @brief Returns the parameters of the function.
+       * @return A span of variable declarations.
+       */
+      auto params() const -> std::span<stmt_local::variable const>
+        { return _params; }
+
+      /**
+       * @brief Returns the type of the returned value.
+       * @return The type expression.
+       */
+      auto data_type() const -> std::shared_ptr<expression>
+        { return _data_type; }
+
+      /**
+       * @brief Returns the body of the function.
+       * @return A pointer to the body block, or nullptr for a declaration.
+       */
+      auto body() const -> std::shared_ptr<statement>
+        { return _body; }
+
+    private:
+      token _keyword;
+      token _id;
+      std::vector<stmt_local::variable> _params;
+      std::shared_ptr<expression> _data_type;
+      std::shared_ptr<statement> _body;
+  };
+
   /**
    * @brief Abstract visitor base class for statement traversal.
    * @tparam Input The input type passed to the visitor.
@@ -291,6 +376,7 @@ namespace thalia::syntax {
       virtual auto visit_stmt_if(Input value) -> Output = 0;
       virtual auto visit_stmt_while(Input value) -> Output = 0;
       virtual auto visit_stmt_local(Input value) -> Output = 0;
+      virtual auto visit_stmt_function(Input value) -> Output = 0;
 
     protected:
       std::shared_ptr<statement> _node;
@@ -312,6 +398,8 @@ namespace thalia::syntax {
         return visit_stmt_while(value);
       case stmt_type::Local:
         return visit_stmt_local(value);
+      case stmt_type::Function:
+        return visit_stmt_function(value);
     }
   }
 }
@@ -165,20 +165,23 @@ namespace thalia::syntax {
 
   extern auto lexer::scan_symbol(std::size_t max_size)
     -> token {
-    if (max_size > _target.size())
-      return scan_symbol(max_size - 1);
-
+    auto size = std::min(max_size, _target.size());
     auto type = find_in(
       std::begin(symbols), std::end(symbols),
-      _target.substr(0, max_size), token_type::Unknown
+      _target.substr(0, size), token_type::Unknown
     );
 
-    if (max_size > 1 && type == token_type::Unknown)
-      return scan_symbol(max_size - 1);
+    while (size > 1 && type == token_type::Unknown) {
+      --size;
+      type = find_in(
+        std::begin(symbols), std::end(symbols),
+        _target.substr(0, size), token_type::Unknown
+      );
+    }
 
     auto col = _col;
-    _col += max_size;
-    auto target = token { type, advance(max_size), _line, col };
+    _col += size;
+    auto target = token { type, advance(size), _line, col };
 
     if (type == token_type::Unknown)
       _errors << error { error_type::UnknownCharacter, target };
@@ -16,6 +16,9 @@
  * along with this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <utility>
+#include <vector>
+
 #include "thalia-syntax/parser.hpp"
 #include "thalia-syntax/exprs.hpp"
 #include "thalia-syntax/token.hpp"
@@ -23,8 +26,11 @@
 namespace thalia::syntax {
   extern auto parser::parse_expression()
     -> std::shared_ptr<expression> {
+    auto result = std::shared_ptr<expression> {};
+    auto depth = _depth;
     try {
-      return parse_expr_assign();
+      nest();
+      result = parse_expr_assign();
     } catch(error const& error) {
       _errors << error;
       skip_until({
@@ -33,14 +39,19 @@ namespace thalia::syntax {
         token_type::LBrace,
         token_type::RBrace
       });
-      return nullptr;
     }
+    // A chain that failed part-way leaves its levels counted.
+    _depth = depth;
+    return result;
   }
 
   extern auto parser::parse_expr_assign()
     -> std::shared_ptr<expression> {
-    auto target = parse_expr_log_or();
-    auto is_assign = match({
+    // Assignments are right-associative, so the chain is collected first
+    // and folded from the right instead of recursing once per operator.
+    auto chain = std::vector<std::pair<token, std::shared_ptr<expression>>> {};
+    auto value = parse_expr_log_or();
+    while (match({
       token_type::Assign,
       token_type::AndAssign,
       token_type::OrAssign,
@@ -52,14 +63,17 @@ namespace thalia::syntax {
       token_type::PlusAssign,
       token_type::MinusAssign,
       token_type::XorAssign
-    });
-
-    if (!is_assign)
-      return target;
+    })) {
+      auto operation = advance();
+      nest();
+      chain.emplace_back(operation, value);
+      value = parse_expr_log_or();
+    }
 
-    auto operation = advance();
-    auto value = parse_expression();
-    return std::make_shared<expr_assign>(operation, target, value);
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+      value = std::make_shared<expr_assign>(it->first, it->second, value);
+    _depth -= chain.size();
+    return value;
   }
 
   extern auto parser::parse_expr_log_or()
@@ -157,13 +171,29 @@ namespace thalia::syntax {
     });
 
     if (!is_unary)
-      return parse_expr_primary();
+      return parse_expr_postfix();
 
     auto operation = advance();
-    auto value = parse_expr_primary();
+    auto value = parse_expr_postfix();
     return std::make_shared<expr_unary>(operation, value);
   }
 
+  extern auto parser::parse_expr_postfix()
+    -> std::shared_ptr<expression> {
+    auto result = parse_expr_primary();
+    auto folds = std::size_t { 0 };
+    while (match(token_type::LBracket)) {
+      auto bracket = advance();
+      nest();
+      ++folds;
+      auto index = parse_expression();
+      consume({ token_type::RBracket }, error_type::ExpectedRBracket);
+      result = std::make_shared<expr_index>(bracket, result, index);
+    }
+    _depth -= folds;
+    return result;
+  }
+
   extern auto parser::parse_expr_primary()
     -> std::shared_ptr<expression> {
     auto types = { token_type::LParen, token_type::Id, token_type::Int };
@@ -172,7 +202,7 @@ namespace thalia::syntax {
     if (token.is(token_type::LParen))
       return parse_expr_paren();
     if (token.is(token_type::Id))
-      return std::make_shared<expr_id>(token);
+      return match(token_type::LParen) ? parse_expr_call(token) : std::make_shared<expr_id>(token);
 
     auto lit_types = {
       token_type::I8,
@@ -193,12 +223,26 @@ namespace thalia::syntax {
 
   extern auto parser::parse_expr_paren()
     -> std::shared_ptr<expression> {
-    advance();
     auto value = parse_expression();
     consume({ token_type::RParen }, error_type::ExpectedRParen);
     return std::make_shared<expr_paren>(value);
   }
 
+  extern auto parser::parse_expr_call(token const& callee)
+    -> std::shared_ptr<expression> {
+    advance();
+    auto args = std::vector<std::shared_ptr<expression>> {};
+    if (!match(token_type::RParen)) {
+      args.push_back(parse_expression());
+      while (match(token_type::Comma)) {
+        advance();
+        args.push_back(parse_expression());
+      }
+    }
+    consume({ token_type::RParen }, error_type::ExpectedRParen);
+    return std::make_shared<expr_call>(callee, args);
+  }
+
   extern auto parser::parse_expr_data_type()
     -> std::shared_ptr<expression> {
     auto types = {
@@ -209,8 +253,20 @@ namespace thalia::syntax {
       token_type::I64
     };
 
+    // Every `[N]` in front wraps the type after it in an array; they are
+    // collected first so nesting costs no recursion.
+    auto lengths = std::vector<token> {};
+    while (match(token_type::LBracket)) {
+      advance();
+      lengths.push_back(consume({ token_type::Int }, error_type::ExpectedArrayLength));
+      consume({ token_type::RBracket }, error_type::ExpectedRBracket);
+    }
+
     auto target = consume(types, error_type::ExpectedDataType);
-    return std::make_shared<expr_data_type>(target);
+    auto result = std::shared_ptr<expression> { std::make_shared<expr_data_type>(target) };
+    for (auto it = lengths.rbegin(); it != lengths.rend(); ++it)
+      result = std::make_shared<expr_array_type>(*it, result);
+    return result;
   }
 
   extern auto parser::parse_expr_binary(
@@ -218,11 +274,15 @@ namespace thalia::syntax {
     std::function<std::shared_ptr<expression>()> next_value
   ) -> std::shared_ptr<expression> {
     auto result = next_value();
+    auto folds = std::size_t { 0 };
     while (match(types)) {
       auto operation = advance();
+      nest();
+      ++folds;
       auto rhs = next_value();
       result = std::make_shared<expr_binary>(operation, result, rhs);
     }
+    _depth -= folds;
     return result;
   }
 }
@@ -50,5 +50,12 @@ namespace thalia::syntax {
     while (!eof() && !match(types))
       ++_current;
   }
+
+  // Counts one more level of the tree being built.
+  extern auto parser::nest()
+    -> void {
+    if (++_depth > max_depth)
+      throw error { error_type::TooDeepNesting, *_current };
+  }
 }
 
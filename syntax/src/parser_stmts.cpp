@@ -23,20 +23,36 @@
 namespace thalia::syntax {
   extern auto parser::parse_statement()
     -> std::shared_ptr<statement> {
+    auto start = _current;
+    auto result = std::shared_ptr<statement> {};
+    auto depth = _depth;
     try {
+      nest();
+
       switch (_current->type()) {
         case token_type::Return:
-          return parse_stmt_return();
+          result = parse_stmt_return(); break;
         case token_type::LBrace:
-          return parse_stmt_block();
+          result = parse_stmt_block(); break;
         case token_type::If:
-          return parse_stmt_if();
+          result = parse_stmt_if(); break;
         case token_type::While:
-          return parse_stmt_while();
+          result = parse_stmt_while(); break;
         case token_type::Def:
-          return parse_stmt_local();
+          result = parse_stmt_local(); break;
+        case token_type::Use:
+        case token_type::Global:
+        case token_type::Local:
+          // Functions are only declared at the top level. A nested one is
+          // still parsed, so the recovery does not start inside its body.
+          result = parse_stmt_function();
+          if (_depth > 1) {
+            _errors << error { error_type::MisplacedFunction, *start };
+            result = nullptr;
+          }
+          break;
         default:
-          return parse_stmt_expr();
+          result = parse_stmt_expr(); break;
       }
     } catch (error const& error) {
       _errors << error;
@@ -45,8 +61,14 @@ namespace thalia::syntax {
         token_type::RParen,
         token_type::RBrace
       });
-      return nullptr;
+
+      // A stray closing token stops the recovery right where the statement
+      // started, so step over it to guarantee progress.
+      if (_current == start && !eof())
+        ++_current;
     }
+    _depth = depth;
+    return result;
   }
 
   extern auto parser::parse_stmt_local()
@@ -61,7 +83,7 @@ namespace thalia::syntax {
       consume({ token_type::Colon }, error_type::ExpectedColon);
       auto data_type = parse_expr_data_type();
 
-      if (mut && !match(token_type::Assign))
+      if (!mut && !match(token_type::Assign))
         throw error { error_type::ExpectedConstValue, *_current };
 
       auto assign = match(token_type::Assign);
@@ -75,6 +97,37 @@ namespace thalia::syntax {
     return std::make_shared<stmt_local>(content);
   }
 
+  extern auto parser::parse_stmt_function()
+    -> std::shared_ptr<statement> {
+    auto keyword = advance();
+    auto id = consume({ token_type::Id }, error_type::ExpectedId);
+    consume({ token_type::LParen }, error_type::ExpectedLParen);
+
+    auto params = std::vector<stmt_local::variable> {};
+    auto parse_param = [&]() -> void {
+      auto param = consume({ token_type::Id }, error_type::ExpectedId);
+      consume({ token_type::Colon }, error_type::ExpectedColon);
+      params.push_back(stmt_local::variable { false, param, parse_expr_data_type() });
+    };
+    if (!match(token_type::RParen)) {
+      parse_param();
+      while (match(token_type::Comma)) {
+        advance();
+        parse_param();
+      }
+    }
+    consume({ token_type::RParen }, error_type::ExpectedRParen);
+    consume({ token_type::Colon }, error_type::ExpectedColon);
+    auto data_type = parse_expr_data_type();
+
+    if (keyword.is(token_type::Use)) {
+      consume({ token_type::Semi }, error_type::ExpectedSemi);
+      return std::make_shared<stmt_function>(keyword, id, params, data_type);
+    }
+    auto body = parse_stmt_block();
+    return std::make_shared<stmt_function>(keyword, id, params, data_type, body);
+  }
+
   extern auto parser::parse_stmt_if()
     -> std::shared_ptr<statement> {
     advance();
@@ -109,10 +162,10 @@ namespace thalia::syntax {
 
   extern auto parser::parse_stmt_return()
     -> std::shared_ptr<statement> {
-    advance();
-    auto value = parse_expression();
+    auto keyword = advance();
+    auto value = match(token_type::Semi) ? nullptr : parse_expression();
     consume({ token_type::Semi }, error_type::ExpectedSemi);
-    return std::make_shared<stmt_return>(value);
+    return std::make_shared<stmt_return>(keyword, value);
   }
 
   extern auto parser::parse_stmt_expr()
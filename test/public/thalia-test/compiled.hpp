@@ -0,0 +1,48 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THALIA_TEST_COMPILED_
+#define _THALIA_TEST_COMPILED_
+
+#include <string>
+#include <utility>
+
+#include <thalia-vm/chunk.hpp>
+#include <thalia-vm/compiler.hpp>
+#include <thalia-vm/reg_compiler.hpp>
+
+#include "frontend.hpp"
+
+namespace thalia::test {
+  /**
+   * @brief A program taken through the front end and compiled for both
+   *   machines.
+   */
+  struct compiled
+    : public analyzed {
+    vm::chunk program;
+    vm::reg_chunk registers;
+
+    compiled(std::string source)
+      : analyzed { std::move(source) }
+      , program { vm::compiler { types, names, typing, values }.compile(ast) }
+      , registers { vm::reg_compiler { types, names, typing, values }.compile(ast) } {}
+  };
+}
+
+#endif // _THALIA_TEST_COMPILED_
@@ -0,0 +1,135 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THALIA_TEST_FRONTEND_
+#define _THALIA_TEST_FRONTEND_
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <thalia-syntax/lexer.hpp>
+#include <thalia-syntax/parser.hpp>
+#include <thalia-syntax/stmts.hpp>
+#include <thalia-syntax/token.hpp>
+#include <thalia-sema/checker.hpp>
+#include <thalia-sema/consteval.hpp>
+#include <thalia-sema/resolver.hpp>
+#include <thalia-sema/types.hpp>
+
+namespace thalia::test {
+  /**
+   * @brief Counts the errors of every stage.
+   */
+  class counting_queue
+    : public syntax::lexer::error_queue
+    , public syntax::parser::error_queue
+    , public sema::resolver::error_queue
+    , public sema::type_checker::error_queue
+    , public sema::const_evaluator::error_queue {
+    public:
+      auto operator<<(syntax::lexer::error const&) -> counting_queue& override
+        { ++errors; return *this; }
+      auto operator<<(syntax::parser::error const&) -> counting_queue& override
+        { ++errors; return *this; }
+      auto operator<<(sema::resolver::error const&) -> counting_queue& override
+        { ++errors; return *this; }
+      auto operator<<(sema::type_checker::error const&) -> counting_queue& override
+        { ++errors; return *this; }
+      auto operator<<(sema::const_evaluator::error const&) -> counting_queue& override
+        { ++errors; return *this; }
+
+    public:
+      std::size_t errors = 0;
+  };
+
+  /**
+   * @brief Collects the errors of every stage by type.
+   */
+  class collecting_queue
+    : public syntax::lexer::error_queue
+    , public syntax::parser::error_queue
+    , public sema::resolver::error_queue
+    , public sema::type_checker::error_queue
+    , public sema::const_evaluator::error_queue {
+    public:
+      auto operator<<(syntax::lexer::error const&) -> collecting_queue& override
+        { ++syntax_errors; return *this; }
+      auto operator<<(syntax::parser::error const&) -> collecting_queue& override
+        { ++syntax_errors; return *this; }
+      auto operator<<(sema::resolver::error const& error) -> collecting_queue& override
+        { resolver_errors.push_back(error.type); return *this; }
+      auto operator<<(sema::type_checker::error const& error) -> collecting_queue& override
+        { checker_errors.push_back(error.type); return *this; }
+      auto operator<<(sema::const_evaluator::error const& error) -> collecting_queue& override
+        { consteval_errors.push_back(error.type); return *this; }
+
+    public:
+      std::size_t syntax_errors = 0;
+      std::vector<sema::resolver::error_type> resolver_errors;
+      std::vector<sema::type_checker::error_type> checker_errors;
+      std::vector<sema::const_evaluator::error_type> consteval_errors;
+  };
+
+  /**
+   * @brief A parsed program that keeps its source alive.
+   * @tparam Queue The queue the errors of every stage go to.
+   */
+  template <typename Queue>
+  struct parsed {
+    std::string code;
+    Queue errors;
+    std::vector<syntax::token> tokens;
+    std::vector<std::shared_ptr<syntax::statement>> ast;
+
+    parsed(std::string source)
+      : code { std::move(source) }
+      , tokens { syntax::lexer { errors, code }.scan_all() }
+      , ast { syntax::parser { errors, tokens }.parse() } {}
+  };
+
+  /**
+   * @brief A parsed program whose later stages the test runs itself.
+   */
+  using program = parsed<collecting_queue>;
+
+  /**
+   * @brief A program taken through the whole front end.
+   */
+  struct analyzed
+    : public parsed<counting_queue> {
+    sema::type_table types;
+    sema::resolution names;
+    sema::typing typing;
+    sema::constants values;
+
+    analyzed(std::string source)
+      : parsed { std::move(source) }
+      , names { sema::resolver { errors }.resolve(ast) }
+      , typing { sema::type_checker { errors, types, names }.check(ast) }
+      , values { sema::const_evaluator { errors, types, names, typing }.evaluate(ast) } {
+      if (errors.errors != 0)
+        throw std::invalid_argument { "program has semantic errors" };
+    }
+  };
+}
+
+#endif // _THALIA_TEST_FRONTEND_
@@ -0,0 +1,306 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THALIA_VM_BENCH_TREE_WALKER_
+#define _THALIA_VM_BENCH_TREE_WALKER_
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <thalia-syntax/exprs.hpp>
+#include <thalia-syntax/stmts.hpp>
+#include <thalia-sema/arith.hpp>
+#include <thalia-sema/checker.hpp>
+#include <thalia-sema/consteval.hpp>
+#include <thalia-sema/resolver.hpp>
+#include <thalia-sema/types.hpp>
+
+namespace thalia::vm::bench {
+  /**
+   * @brief The tree-walking interpreter the bytecode machines are measured
+   *   against.
+   *
+   * It is given the same head start as the compiler: the syntax tree is
+   * copied once into nodes that hold the resolver's slots, the folded
+   * values and the widths of their operations, so a run does no lookups
+   * and parses no literals. Variables live in one array indexed by slot; a
+   * call saves the slots of its callee and restores them on return.
+   */
+  class tree_walker {
+    public:
+      tree_walker(
+        std::span<std::shared_ptr<syntax::statement> const> ast,
+        sema::type_table const& types,
+        sema::resolution const& names,
+        sema::typing const& typing,
+        sema::constants const& values
+      ) : _types { types }, _names { names }, _typing { typing }, _values { values },
+          _functions(names.functions().size()), _slots(names.symbols().size(), 0) {
+        for (auto const& node: ast)
+          _program.push_back(lower(node));
+      }
+
+      auto run() -> std::optional<std::int64_t> {
+        std::fill(_slots.begin(), _slots.end(), 0);
+        _returned.reset();
+        for (auto const& node: _program) {
+          exec(node);
+          if (_returned)
+            break;
+        }
+        return _returned;
+      }
+
+      auto value(std::string const& name) const -> std::int64_t {
+        auto symbols = _names.symbols();
+        for (auto slot = std::size_t { 0 }; slot < symbols.size(); ++slot)
+          if (symbols[slot].depth == 0 && symbols[slot].declaration->id.value() == name)
+            return _slots[slot];
+        return 0;
+      }
+
+    private:
+      enum class expr_kind { Const, Load, Store, Binary, LogAnd, LogOr, Unary, Call };
+      enum class stmt_kind { Block, Expr, Return, If, While };
+
+      struct expr {
+        expr_kind kind;
+        syntax::token_type operation = syntax::token_type::Assign;
+        std::size_t width = 0;
+        /** The constant, the slot or the function, by kind. */
+        std::int64_t value = 0;
+        std::vector<expr> operands = {};
+      };
+
+      struct stmt {
+        stmt_kind kind;
+        std::vector<expr> values = {};
+        std::vector<stmt> body = {};
+      };
+
+      struct function {
+        std::size_t first;
+        std::size_t count;
+        stmt body;
+      };
+
+      auto width(syntax::expression const& node) const -> std::size_t
+        { return _types.get(_typing.type_of(node)).width; }
+
+      auto lower(std::shared_ptr<syntax::statement> const& node) -> stmt {
+        if (!node)
+          return stmt { stmt_kind::Block };
+        switch (node->type()) {
+          case syntax::stmt_type::Block: {
+            auto result = stmt { stmt_kind::Block };
+            for (auto const& child: std::static_pointer_cast<syntax::stmt_block>(node)->content())
+              result.body.push_back(lower(child));
+            return result;
+          }
+          case syntax::stmt_type::Expr:
+            return stmt { stmt_kind::Expr, { lower(std::static_pointer_cast<syntax::stmt_expr>(node)->value()) } };
+          case syntax::stmt_type::Return: {
+            auto value = std::static_pointer_cast<syntax::stmt_return>(node)->value();
+            return stmt { stmt_kind::Return, { value ? lower(value) : expr { expr_kind::Const } } };
+          }
+          case syntax::stmt_type::If: {
+            auto root = std::static_pointer_cast<syntax::stmt_if>(node);
+            return stmt {
+              stmt_kind::If, { lower(root->condition()) },
+              { lower(root->main_body()), lower(root->else_body()) }
+            };
+          }
+          case syntax::stmt_type::While: {
+            auto root = std::static_pointer_cast<syntax::stmt_while>(node);
+            return stmt { stmt_kind::While, { lower(root->condition()) }, { lower(root->body()) } };
+          }
+          case syntax::stmt_type::Local: {
+            auto result = stmt { stmt_kind::Block };
+            for (auto const& entry: std::static_pointer_cast<syntax::stmt_local>(node)->content()) {
+              auto value = entry.value ? lower(entry.value) : expr { expr_kind::Const };
+              result.values.push_back(expr {
+                expr_kind::Store, syntax::token_type::Assign, 0,
+                static_cast<std::int64_t>(_names.slot(entry)), { std::move(value) }
+              });
+            }
+            return result;
+          }
+          case syntax::stmt_type::Function: {
+            auto root = std::static_pointer_cast<syntax::stmt_function>(node);
+            if (root->body()) {
+              auto index = _names.function_of(*root);
+              auto const& target = _names.functions()[index];
+              _functions[index] = function { target.first, target.count, lower(root->body()) };
+            }
+            return stmt { stmt_kind::Block };
+          }
+        }
+        return stmt { stmt_kind::Block };
+      }
+
+      auto lower(std::shared_ptr<syntax::expression> const& node) -> expr {
+        if (auto folded = _values.value(*node))
+          return expr { expr_kind::Const, syntax::token_type::Assign, 0, *folded };
+        switch (node->type()) {
+          case syntax::expr_type::Assign: {
+            auto root = std::static_pointer_cast<syntax::expr_assign>(node);
+            auto target = root->target();
+            while (target->is(syntax::expr_type::Paren))
+              target = std::static_pointer_cast<syntax::expr_paren>(target)->value();
+            auto slot = _names.slot(*std::static_pointer_cast<syntax::expr_id>(target));
+            return expr {
+              expr_kind::Store, sema::binary_of(root->operation().type()), width(*target),
+              static_cast<std::int64_t>(slot), { lower(root->value()) }
+            };
+          }
+          case syntax::expr_type::Binary: {
+            auto root = std::static_pointer_cast<syntax::expr_binary>(node);
+            auto operation = root->operation().type();
+            auto kind = operation == syntax::token_type::LogAnd ? expr_kind::LogAnd
+              : operation == syntax::token_type::LogOr ? expr_kind::LogOr
+              : expr_kind::Binary;
+            return expr {
+              kind, operation, width(*root->lhs()), 0,
+              { lower(root->lhs()), lower(root->rhs()) }
+            };
+          }
+          case syntax::expr_type::Unary: {
+            auto root = std::static_pointer_cast<syntax::expr_unary>(node);
+            return expr {
+              expr_kind::Unary, root->operation().type(), width(*node), 0, { lower(root->value()) }
+            };
+          }
+          case syntax::expr_type::Paren:
+            return lower(std::static_pointer_cast<syntax::expr_paren>(node)->value());
+          case syntax::expr_type::BaseLit: {
+            auto root = std::static_pointer_cast<syntax::expr_base_lit>(node);
+            auto value = sema::parse_literal(root->target().value(), width(*node)).value;
+            return expr { expr_kind::Const, syntax::token_type::Assign, 0, value };
+          }
+          case syntax::expr_type::Id: {
+            auto slot = _names.slot(*std::static_pointer_cast<syntax::expr_id>(node));
+            return expr { expr_kind::Load, syntax::token_type::Assign, 0, static_cast<std::int64_t>(slot) };
+          }
+          case syntax::expr_type::Call: {
+            auto root = std::static_pointer_cast<syntax::expr_call>(node);
+            auto result = expr {
+              expr_kind::Call, syntax::token_type::Assign, 0,
+              static_cast<std::int64_t>(_names.callee(*root))
+            };
+            for (auto const& arg: root->args())
+              result.operands.push_back(lower(arg));
+            return result;
+          }
+          default:
+            return expr { expr_kind::Const };
+        }
+      }
+
+      auto exec(stmt const& node) -> void {
+        if (_returned)
+          return;
+        switch (node.kind) {
+          case stmt_kind::Block:
+            for (auto const& value: node.values)
+              eval(value);
+            for (auto const& child: node.body)
+              exec(child);
+            break;
+          case stmt_kind::Expr:
+            eval(node.values[0]);
+            break;
+          case stmt_kind::Return:
+            _returned = eval(node.values[0]);
+            break;
+          case stmt_kind::If:
+            exec(eval(node.values[0]) ? node.body[0] : node.body[1]);
+            break;
+          case stmt_kind::While:
+            while (!_returned && eval(node.values[0]))
+              exec(node.body[0]);
+            break;
+        }
+      }
+
+      // The callee's slots are saved, so every activation sees its own.
+      auto call(expr const& node) -> std::int64_t {
+        auto const& target = _functions[static_cast<std::size_t>(node.value)];
+        auto args = std::vector<std::int64_t> {};
+        for (auto const& arg: node.operands)
+          args.push_back(eval(arg));
+        auto frame = std::span { _slots }.subspan(target.first, target.count);
+        auto saved = std::vector<std::int64_t> { frame.begin(), frame.end() };
+        std::fill(frame.begin(), frame.end(), 0);
+        std::copy(args.begin(), args.end(), frame.begin());
+        exec(target.body);
+        auto result = _returned.value_or(0);
+        _returned.reset();
+        std::copy(saved.begin(), saved.end(), frame.begin());
+        return result;
+      }
+
+      auto eval(expr const& node) -> std::int64_t {
+        switch (node.kind) {
+          case expr_kind::Const:
+            return node.value;
+          case expr_kind::Load:
+            return _slots[static_cast<std::size_t>(node.value)];
+          case expr_kind::Store: {
+            auto value = eval(node.operands[0]);
+            auto& slot = _slots[static_cast<std::size_t>(node.value)];
+            slot = node.operation == syntax::token_type::Assign
+              ? value
+              : sema::eval_binary(node.operation, slot, value, node.width).value;
+            return slot;
+          }
+          case expr_kind::Binary: {
+            auto lhs = eval(node.operands[0]);
+            auto rhs = eval(node.operands[1]);
+            return sema::eval_binary(node.operation, lhs, rhs, node.width).value;
+          }
+          case expr_kind::LogAnd:
+            return eval(node.operands[0]) && eval(node.operands[1]);
+          case expr_kind::LogOr:
+            return eval(node.operands[0]) || eval(node.operands[1]);
+          case expr_kind::Unary:
+            return sema::eval_unary(node.operation, eval(node.operands[0]), node.width).value;
+          case expr_kind::Call:
+            return call(node);
+        }
+        return 0;
+      }
+
+    private:
+      sema::type_table const& _types;
+      sema::resolution const& _names;
+      sema::typing const& _typing;
+      sema::constants const& _values;
+      std::vector<function> _functions;
+      std::vector<stmt> _program;
+      std::vector<std::int64_t> _slots;
+      std::optional<std::int64_t> _returned;
+  };
+}
+
+#endif // _THALIA_VM_BENCH_TREE_WALKER_
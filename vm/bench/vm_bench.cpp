@@ -0,0 +1,135 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <thalia-vm/fusion.hpp>
+#include <thalia-vm/machine.hpp>
+#include <thalia-vm/reg_machine.hpp>
+#include <thalia-test/compiled.hpp>
+
+#include "tree_walker.hpp"
+
+namespace {
+  struct workload {
+    char const* name;
+    char const* code;
+    char const* result;
+  };
+
+  // Loop- and call-heavy programs in the style of examples/main.th.
+  constexpr workload workloads[] = {
+    {
+      "sum",
+      "def MIN: i32 = 0i32, MAX: i32 = 3000000i32;\n"
+      "def mut i: i32 = MIN, mut s: i32 = 0i32;\n"
+      "while i <= MAX { s += i; i += 1i32; }\n",
+      "s"
+    },
+    {
+      "nested",
+      "def mut i: i64 = 0, mut j: i64 = 0, mut acc: i64 = 0;\n"
+      "while i < 1200 {\n"
+      "  j = 0;\n"
+      "  while j < 1200 { acc += (i * j) % 7; j += 1; }\n"
+      "  i += 1;\n"
+      "}\n",
+      "acc"
+    },
+    {
+      "collatz",
+      "def mut n: i32 = 1i32, mut steps: i32 = 0i32, mut x: i32 = 0i32;\n"
+      "while n < 30000i32 {\n"
+      "  x = n;\n"
+      "  while x != 1i32 {\n"
+      "    if x & 1i32 { x = 3i32 * x + 1i32; } else { x >>= 1i32; }\n"
+      "    steps += 1i32;\n"
+      "  }\n"
+      "  n += 1i32;\n"
+      "}\n",
+      "steps"
+    },
+    {
+      "calls",
+      "use fib(n: i64): i64;\n"
+      "global fib(n: i64): i64 { if n < 2 { return n; } return fib(n - 1) + fib(n - 2); }\n"
+      "def mut f: i64 = fib(24);\n",
+      "f"
+    }
+  };
+
+  template <typename Fn>
+  auto measure(Fn&& fn) -> double {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::milli>(elapsed).count();
+  }
+}
+
+extern auto main() -> int {
+  using namespace thalia;
+  auto status = EXIT_SUCCESS;
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "workload    tree walk (ms)   stack vm (ms)   speedup"
+    "   fused vm (ms)   vs stack   register vm (ms)   vs stack\n";
+  for (auto const& load: workloads) {
+    auto source = test::compiled { load.code };
+
+    auto walker = vm::bench::tree_walker {
+      source.ast, source.types, source.names, source.typing, source.values
+    };
+    auto walk_time = measure([&] { walker.run(); });
+
+    auto machine = vm::machine { source.program };
+    auto vm_time = measure([&] { machine.run(); });
+
+    auto fused_program = source.program;
+    vm::fuse(fused_program);
+    auto fused = vm::machine { fused_program };
+    auto fused_time = measure([&] { fused.run(); });
+
+    auto registers = vm::reg_machine { source.registers };
+    auto reg_time = measure([&] { registers.run(); });
+
+    auto expected = walker.value(load.result);
+    for (auto const& entry: source.program.globals) {
+      if (entry.name != load.result)
+        continue;
+      auto stack_value = machine.slots()[entry.slot];
+      auto fused_value = fused.slots()[entry.slot];
+      auto reg_value = registers.slots()[entry.slot];
+      if (stack_value != expected || fused_value != expected || reg_value != expected) {
+        std::cout << load.name << ": results differ (" << expected << ", " << stack_value
+          << ", " << fused_value << ", " << reg_value << ")\n";
+        status = EXIT_FAILURE;
+      }
+    }
+
+    std::cout << std::left << std::setw(12) << load.name << std::right
+      << std::setw(14) << walk_time << std::setw(16) << vm_time
+      << std::setw(9) << walk_time / vm_time << 'x'
+      << std::setw(16) << fused_time << std::setw(10) << vm_time / fused_time << 'x'
+      << std::setw(19) << reg_time << std::setw(10) << vm_time / reg_time << "x\n";
+  }
+  return status;
+}
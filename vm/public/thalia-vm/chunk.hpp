@@ -0,0 +1,228 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THALIA_VM_CHUNK_
+#define _THALIA_VM_CHUNK_
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "opcode.hpp"
+
+namespace thalia::vm {
+  /**
+   * @brief Maps the offset of a trapping instruction to its source line.
+   */
+  struct line_entry {
+    std::size_t offset;
+    std::size_t line;
+  };
+
+  /**
+   * @brief A `while` loop of a chunk.
+   */
+  struct loop_entry {
+    /** The offset of the first instruction after the loop. */
+    std::size_t exit;
+    /** The source line of the loop. */
+    std::size_t line;
+  };
+
+  /**
+   * @brief Stands for the top-level code where a function is expected.
+   */
+  inline constexpr std::size_t top_level = static_cast<std::size_t>(-1);
+
+  /**
+   * @brief The number of values the frames and operand stacks of the
+   *   functions a run calls can take up, together; no single frame or
+   *   operand stack is larger.
+   */
+  inline constexpr std::size_t call_stack_size = std::size_t { 1 } << 20;
+
+  /**
+   * @brief A function of a chunk, compiled after the top-level code.
+   *
+   * Its code runs from `offset` to the next function or the end of the
+   * chunk, on a frame of its own whose first slots are the parameters.
+   */
+  struct function_entry {
+    /** The offset of the first instruction of the function. */
+    std::size_t offset;
+    /** The number of parameters, popped by `Call` into the first slots. */
+    std::size_t params;
+    /** The number of slots of the frame. */
+    std::size_t slots;
+    /** The largest number of values on the operand stack of the frame. */
+    std::size_t max_stack;
+    /** The source line of the definition. */
+    std::size_t line;
+  };
+
+  /**
+   * @brief A top-level `mut` variable whose value is observable after a run.
+   */
+  struct global {
+    std::string name;
+    std::size_t slot;
+    std::size_t width;
+  };
+
+  /**
+   * @brief The parts of a compiled program a machine runs, wherever they are
+   *   stored.
+   */
+  struct chunk_view {
+    /** The instructions, each an opcode followed by its operands. */
+    std::span<code_unit const> code;
+    /** The constant pool, indexed by the operand of `Const`. */
+    std::span<std::int64_t const> constants;
+    /** The number of slots of the top-level frame. */
+    std::size_t slots = 0;
+    /** The largest number of values on the operand stack of the top level. */
+    std::size_t max_stack = 0;
+    /** The lines of the instructions that can trap, by increasing offset. */
+    std::span<line_entry const> lines;
+    /** The `while` loops, indexed by the operand of their `Loop`. */
+    std::span<loop_entry const> loops;
+    /** The functions, indexed by the operand of `Call`. */
+    std::span<function_entry const> functions;
+
+    /**
+     * @brief Finds the source line of an instruction.
+     * @param offset The offset of the instruction.
+     * @return The line of the closest preceding entry, or 0.
+     */
+    auto line_at(std::size_t offset) const -> std::size_t;
+  };
+
+  /**
+   * @brief A compiled program: bytecode, constant pool and frame layout.
+   *
+   * The top-level code comes first and ends with `Halt`; the code of every
+   * function follows, in the order of the functions.
+   */
+  struct chunk {
+    /** The instructions, each an opcode followed by its operands. */
+    std::vector<code_unit> code;
+    /** The constant pool, indexed by the operand of `Const`. */
+    std::vector<std::int64_t> constants;
+    /** The number of slots of the top-level frame. */
+    std::size_t slots = 0;
+    /** The largest number of values on the operand stack of the top level. */
+    std::size_t max_stack = 0;
+    /** The lines of the instructions that can trap, by increasing offset. */
+    std::vector<line_entry> lines;
+    /** The `while` loops, indexed by the operand of their `Loop`. */
+    std::vector<loop_entry> loops;
+    /** The functions, indexed by the operand of `Call`. */
+    std::vector<function_entry> functions;
+    /** The top-level `mut` variables, in declaration order. */
+    std::vector<global> globals;
+
+    /**
+     * @brief Finds the source line of an instruction.
+     * @param offset The offset of the instruction.
+     * @return The line of the closest preceding entry, or 0.
+     */
+    auto line_at(std::size_t offset) const -> std::size_t;
+
+    /**
+     * @brief Views the chunk.
+     * @return A view valid as long as the chunk is not modified.
+     */
+    auto view() const -> chunk_view
+      { return chunk_view { code, constants, slots, max_stack, lines, loops, functions }; }
+  };
+
+  /**
+   * @brief A function of a register chunk, compiled after the top-level code.
+   *
+   * Its frame is laid out like the top-level one, with a constant pool of
+   * its own, and is filled when it is called.
+   */
+  struct reg_function_entry {
+    /** The offset of the first instruction of the function. */
+    std::size_t offset;
+    /** The number of parameters, the first slots of the frame. */
+    std::size_t params;
+    /** The number of slots of the frame. */
+    std::size_t slots;
+    /** The number of registers of the frame, slots and constants included. */
+    std::size_t registers;
+    /** The constant pool, loaded into the registers after the slots. */
+    std::vector<std::int64_t> constants;
+  };
+
+  /**
+   * @brief A program compiled for the register machine.
+   *
+   * The frame holds the variable slots first, then one register per constant
+   * of the pool (filled before the run), then the temporaries. The code of
+   * the functions follows the top-level code; the arguments of a call are
+   * moved into the registers right after the frame of the caller, where the
+   * frame of the callee starts.
+   */
+  struct reg_chunk {
+    /** The instructions, each an opcode followed by its operands. */
+    std::vector<code_unit> code;
+    /** The constant pool, loaded into the registers after the slots. */
+    std::vector<std::int64_t> constants;
+    /** The number of slots of the frame. */
+    std::size_t slots = 0;
+    /** The number of registers of the frame, slots and constants included. */
+    std::size_t registers = 0;
+    /** The lines of the instructions that can trap, by increasing offset. */
+    std::vector<line_entry> lines;
+    /** The functions, indexed by the operand of `Call`. */
+    std::vector<reg_function_entry> functions;
+    /** The top-level `mut` variables, in declaration order. */
+    std::vector<global> globals;
+
+    /**
+     * @brief Finds the source line of an instruction.
+     * @param offset The offset of the instruction.
+     * @return The line of the closest preceding entry, or 0.
+     */
+    auto line_at(std::size_t offset) const -> std::size_t;
+  };
+
+  /**
+   * @brief Prints the instructions of a chunk, one per line.
+   * @param os The output stream.
+   * @param target The chunk to print.
+   * @return The output stream.
+   */
+  extern auto disassemble(std::ostream& os, chunk const& target)
+    -> std::ostream&;
+
+  /**
+   * @brief Prints the instructions of a register chunk, one per line.
+   * @param os The output stream.
+   * @param target The chunk to print.
+   * @return The output stream.
+   */
+  extern auto disassemble(std::ostream& os, reg_chunk const& target)
+    -> std::ostream&;
+}
+
+#endif // _THALIA_VM_CHUNK_
@@ -0,0 +1,149 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THALIA_VM_COMPILER_
+#define _THALIA_VM_COMPILER_
+
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <thalia-syntax/stmts.hpp>
+#include <thalia-sema/checker.hpp>
+#include <thalia-sema/consteval.hpp>
+#include <thalia-sema/resolver.hpp>
+#include <thalia-sema/types.hpp>
+
+#include "chunk.hpp"
+
+namespace thalia::vm {
+  /**
+   * @brief Places the elements of the arrays of a program in its frame.
+   *
+   * Every variable keeps the slot the resolver gave it, less the base of
+   * its frame; the elements of the arrays follow all of them, one slot per
+   * element, in declaration order. The top-level frame has a slot for every
+   * variable of the program, those of functions unused; the frame of a
+   * function only has its own, parameters first.
+   */
+  struct frame_layout {
+    /** The first slot of the elements of every array, by variable slot. */
+    std::vector<std::size_t> elements;
+    /** The number of slots of the whole frame. */
+    std::size_t slots;
+    /** The variable slot the frame starts at: 0 for the top level. */
+    std::size_t base = 0;
+  };
+
+  /**
+   * @brief Lays out the top-level frame of a program.
+   * @param types The table the program's types were interned in.
+   * @param names The resolution of the program.
+   * @param typing The types of the program.
+   * @return Where the elements of every array live.
+   */
+  extern auto frame_of(
+    sema::type_table const& types,
+    sema::resolution const& names,
+    sema::typing const& typing
+  ) -> frame_layout;
+
+  /**
+   * @brief Lays out the frame of a function.
+   * @param types The table the program's types were interned in.
+   * @param names The resolution of the program.
+   * @param typing The types of the program.
+   * @param function The index of the function, which must be defined.
+   * @return Where the elements of every array of the function live.
+   */
+  extern auto frame_of(
+    sema::type_table const& types,
+    sema::resolution const& names,
+    sema::typing const& typing,
+    std::size_t function
+  ) -> frame_layout;
+
+  /**
+   * @brief Lists the top-level `mut` variables of a program.
+   * @param types The table the program's types were interned in.
+   * @param names The resolution of the program.
+   * @param typing The types of the program.
+   * @return The variables observable after a run, in declaration order.
+   */
+  extern auto globals_of(
+    sema::type_table const& types,
+    sema::resolution const& names,
+    sema::typing const& typing
+  ) -> std::vector<global>;
+
+  /**
+   * @brief Compiles an analyzed syntax tree into stack bytecode.
+   *
+   * Variables live in the frame slots assigned by the resolver and the
+   * elements of arrays in the slots that follow them (see `frame_of`).
+   * Folded expressions become constants, and the width of every operation
+   * comes from the types of its operands. Every defined function is
+   * compiled after the top-level code, on a frame of its own; its loops
+   * have no `Loop`, so only top-level loops are counted and tiered. The
+   * program must be free of semantic errors.
+   */
+  class compiler {
+    public:
+      /**
+       * @brief Constructs a compiler for an analyzed program.
+       * @param types The table the program's types were interned in.
+       * @param names The resolution of the program.
+       * @param typing The types of the program.
+       * @param values The compile-time values of the program.
+       */
+      compiler(
+        sema::type_table const& types,
+        sema::resolution const& names,
+        sema::typing const& typing,
+        sema::constants const& values
+      ) : _types { types }
+        , _names { names }
+        , _typing { typing }
+        , _values { values } {}
+
+      /**
+       * @brief Compiles all top-level statements of a program.
+       * @param ast The top-level statements of the program.
+       * @return The compiled program: the top-level code, ending with
+       *   `Halt`, then the functions.
+       */
+      auto compile(std::span<std::shared_ptr<syntax::statement> const> ast)
+        -> chunk;
+
+      /**
+       * @brief Gets the `while` loops of the last compiled program.
+       * @return The statements, indexed like the loops of its chunk.
+       */
+      auto loops() const -> std::span<std::shared_ptr<syntax::statement> const>
+        { return _loops; }
+
+    private:
+      sema::type_table const& _types;
+      sema::resolution const& _names;
+      sema::typing const& _typing;
+      sema::constants const& _values;
+      std::vector<std::shared_ptr<syntax::statement>> _loops;
+  };
+}
+
+#endif // _THALIA_VM_COMPILER_
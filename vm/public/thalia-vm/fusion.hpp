@@ -0,0 +1,72 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_VM_FUSION_
+#define _THALIA_VM_FUSION_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <span>
+
+#include "chunk.hpp"
+#include "opcode.hpp"
+
+namespace thalia::vm {
+  /**
+   * @brief Counts the sequences `fuse` replaced, by superinstruction.
+   */
+  struct fusion_report {
+    /** The number of sites of every opcode; zero for the plain ones. */
+    std::array<std::size_t, opcode_count> sites {};
+  };
+
+  /**
+   * @brief Fuses common instruction sequences into superinstructions.
+   * @param program The chunk to rewrite; jumps, lines, loops and functions are
+   *   relocated.
+   * @return The number of sequences replaced.
+   *
+   * Two sequences are fused, as long as no jump lands inside them:
+   *   - a compound assignment in a statement, `Load a` then `Load b` or
+   *     `Const k`, `Add` or `Sub`, and `Store a`, becomes `AddLocal`,
+   *     `AddConst`, `SubLocal` or `SubConst`;
+   *   - a comparison of a slot with another slot or a constant followed by a
+   *     conditional jump, as in every `while` or `if` condition of that shape,
+   *     becomes a single compare-and-branch such as `JumpLessEqualConst`.
+   *     A `JumpFalse` is fused into the branch on the opposite comparison.
+   */
+  extern auto fuse(chunk& program) -> fusion_report;
+
+  /**
+   * @brief Prints which superinstructions and specialized forms ran.
+   * @param os The output stream.
+   * @param fused The sites of the superinstructions.
+   * @param executions How many times every opcode ran, indexed by opcode.
+   * @return The output stream.
+   */
+  extern auto print_profile(
+    std::ostream& os,
+    fusion_report const& fused,
+    std::span<std::uint64_t const> executions
+  ) -> std::ostream&;
+}
+
+#endif // _THALIA_VM_FUSION_
@@ -0,0 +1,111 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_VM_IMAGE_
+#define _THALIA_VM_IMAGE_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "chunk.hpp"
+
+namespace thalia::vm {
+  /**
+   * @brief The version of the image format `write_image` produces.
+   */
+  inline constexpr std::uint16_t image_version = 4;
+
+  /**
+   * @brief Reports an image that cannot be loaded.
+   */
+  class image_error: public std::runtime_error {
+    public:
+      using std::runtime_error::runtime_error;
+  };
+
+  /**
+   * @brief Writes a chunk as a bytecode image (`.thb`).
+   * @param os The output stream, opened in binary mode.
+   * @param program The chunk to write.
+   * @return The output stream.
+   *
+   * The image is little-endian and position-independent: a 48-byte header
+   * (magic `\x7fTHB`, format version, number of opcodes, FNV-1a checksum of
+   * everything after it, total size, frame layout, section count) is
+   * followed by a table of sections, each at an 8-byte aligned offset from
+   * the start of the image: the code, the constant pool, the line table, the
+   * loops, the globals and the functions. Jumps hold offsets into the code, so nothing needs
+   * relocating when it is loaded.
+   */
+  extern auto write_image(std::ostream& os, chunk const& program)
+    -> std::ostream&;
+
+  /**
+   * @brief A bytecode image mapped from a file.
+   *
+   * The file is mapped read-only and checked: magic, versions, checksum and
+   * section bounds. The code, the constants, the lines, the loops and the
+   * functions are then used where they are mapped; only the globals are
+   * decoded. Where there is no `mmap`, the file is read into memory
+   * instead. Throws
+   * `image_error` if the file cannot be read or is not a valid image.
+   */
+  class mapped_image {
+    public:
+      /**
+       * @brief Maps and checks an image.
+       * @param path The path of the image.
+       */
+      explicit mapped_image(std::filesystem::path const& path);
+      mapped_image(mapped_image const&) = delete;
+      auto operator=(mapped_image const&) -> mapped_image& = delete;
+      ~mapped_image();
+
+      /**
+       * @brief Views the program of the image.
+       * @return A view valid as long as the image.
+       */
+      auto view() const -> chunk_view
+        { return _view; }
+
+      /**
+       * @brief Gets the top-level `mut` variables of the program.
+       * @return The variables, in declaration order.
+       */
+      auto globals() const -> std::span<global const>
+        { return _globals; }
+
+    private:
+      auto load(std::span<std::uint8_t const> bytes) -> void;
+
+    private:
+      void* _memory = nullptr;
+      std::size_t _size = 0;
+      std::vector<std::uint64_t> _buffer;
+      chunk_view _view;
+      std::vector<global> _globals;
+  };
+}
+
+#endif // _THALIA_VM_IMAGE_
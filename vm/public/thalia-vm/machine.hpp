@@ -0,0 +1,222 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THALIA_VM_MACHINE_
+#define _THALIA_VM_MACHINE_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "chunk.hpp"
+#include "verifier.hpp"
+
+namespace thalia::vm {
+  /**
+   * @brief Describes how a run ended.
+   */
+  enum class status {
+    Halted,
+    Returned,
+    DivByZero,
+    IndexOutOfRange,
+    StackOverflow,
+    Malformed
+  };
+
+  /**
+   * @brief The result of a run.
+   */
+  struct outcome {
+    /** How the run ended. */
+    status state;
+    /** The returned value, if the program returned, or the offset of the
+        instruction that was refused, if the code was malformed. */
+    std::int64_t value;
+    /** The source line of the trapping instruction, if the program trapped
+        on a division, an index or a call. */
+    std::size_t line;
+  };
+
+  /**
+   * @brief A faster way to run the hot loops of a chunk.
+   *
+   * A machine with a tier attached counts the iterations of every loop at
+   * its `Loop`. Once a loop reaches the threshold of the tier, every further
+   * iteration starts by offering the loop to the tier, which runs it from its
+   * test to its exit on the frame of the machine (on-stack replacement).
+   */
+  class tier {
+    public:
+      virtual ~tier() = default;
+
+      /**
+       * @brief Gets how many iterations make a loop hot.
+       * @return The count at which loops are first offered.
+       */
+      virtual auto threshold() const -> std::uint64_t = 0;
+
+      /**
+       * @brief Runs a hot loop from its test.
+       * @param loop The index of the loop in the chunk.
+       * @param slots The frame; the loop reads and updates it in place.
+       * @return How the loop ended, `Halted` if it exited normally; or
+       *   nothing to keep interpreting it.
+       */
+      virtual auto enter(std::size_t loop, std::span<std::int64_t> slots)
+        -> std::optional<outcome> = 0;
+  };
+
+  /**
+   * @brief A stack machine executing a compiled chunk.
+   *
+   * The loop dispatches with computed gotos where the compiler supports them
+   * and falls back to a `switch` otherwise. The operand stack is sized from
+   * the chunk, so instructions never check for overflow. Frames of
+   * functions are stacked above it, each with its slots and then its own
+   * operand stack, up to `call_stack_size` values; a `Call` whose frame
+   * does not fit ends the run as `StackOverflow`. The arguments of a call
+   * are where the frame starts, so they become its first slots in place.
+   *
+   * The chunk is verified when the machine is constructed. Code `verify`
+   * accepts runs on a fast path without any checks; other code runs on a
+   * checked path, which refuses an instruction that would leave the code,
+   * the frame, the constant pool or the operand stack and ends the run as
+   * `Malformed` instead. A top-level frame or operand stack larger than
+   * `call_stack_size` is never allocated, and such a chunk ends as
+   * `Malformed` before it starts.
+   *
+   * The machine runs its own copy of the code. The first time a generic
+   * `Add`, `Sub` or `Mul` (plain or fused) of width 32 or 64 runs, it is
+   * quickened: rewritten in place into the form specialized for its width,
+   * which later executions dispatch to directly.
+   */
+  class machine {
+    public:
+      /**
+       * @brief Constructs a machine for a chunk.
+       * @param program The chunk to execute; it must outlive the machine.
+       * @param profile Whether to count the executions of every opcode.
+       */
+      machine(chunk const& program, bool profile = false)
+        : machine { program.view(), profile } {}
+
+      /**
+       * @brief Constructs a machine for a chunk stored elsewhere, such as a
+       *   mapped image.
+       * @param program The chunk to execute; its storage must outlive the
+       *   machine.
+       * @param profile Whether to count the executions of every opcode.
+       */
+      machine(chunk_view program, bool profile = false)
+        : _program { program }
+        , _code { program.code.begin(), program.code.end() }
+        , _slots(std::min(program.slots, call_stack_size))
+        , _stack(std::min(program.max_stack, call_stack_size) + 1 + (program.functions.empty() ? 0 : call_stack_size))
+        , _iterations(program.loops.size())
+        , _rejection { verify(program) }
+        , _profile { profile } {}
+
+      /**
+       * @brief Lets the hot loops of later runs leave the interpreter.
+       * @param target The tier; it must outlive the machine.
+       */
+      auto attach(tier& target) -> void {
+        _tier = &target;
+        _threshold = target.threshold();
+      }
+
+      /**
+       * @brief Runs the program from the start with all slots zeroed.
+       * @return How the run ended.
+       */
+      auto run() -> outcome
+      {
+        if (_rejection) {
+          if (_program.slots > call_stack_size || _program.max_stack > call_stack_size)
+            return outcome { status::Malformed, 0, 0 };
+          return _profile ? execute<true, true>() : execute<false, true>();
+        }
+        return _profile ? execute<true, false>() : execute<false, false>();
+      }
+
+      /**
+       * @brief Gets why the chunk runs on the checked path.
+       * @return The problem `verify` found, or nothing if it runs unchecked.
+       */
+      auto rejection() const -> std::optional<verify_error> const&
+        { return _rejection; }
+
+      /**
+       * @brief Gets how many times every opcode ran, if profiling.
+       * @return The counts of all runs so far, indexed by opcode.
+       */
+      auto executions() const -> std::span<std::uint64_t const>
+        { return _executions; }
+
+      /**
+       * @brief Gets the frame of the last run.
+       * @return The values of all slots.
+       */
+      auto slots() const -> std::span<std::int64_t const>
+        { return _slots; }
+
+      /**
+       * @brief Gets how many times every loop reached its test in the
+       *   interpreter during the last run.
+       * @return The counts, indexed like the loops of the chunk.
+       */
+      auto iterations() const -> std::span<std::uint64_t const>
+        { return _iterations; }
+
+    private:
+      /**
+       * @brief What a `Return` restores: the frame of the caller and where
+       *   it continues.
+       */
+      struct activation {
+        code_unit* pc;
+        std::int64_t* slots;
+        std::int64_t* base;
+        std::size_t function;
+      };
+
+      template <bool Profile, bool Checked>
+      auto execute() -> outcome;
+
+    private:
+      chunk_view _program;
+      std::vector<code_unit> _code;
+      std::vector<std::int64_t> _slots;
+      std::vector<std::int64_t> _stack;
+      std::vector<activation> _calls;
+      std::vector<std::uint64_t> _iterations;
+      std::array<std::uint64_t, opcode_count> _executions {};
+      tier* _tier = nullptr;
+      std::uint64_t _threshold = std::numeric_limits<std::uint64_t>::max();
+      std::optional<verify_error> _rejection;
+      bool _profile;
+  };
+}
+
+#endif // _THALIA_VM_MACHINE_
@@ -0,0 +1,236 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THALIA_VM_OPCODE_
+#define _THALIA_VM_OPCODE_
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * @brief Lists every instruction with the number of operands that follow it.
+ *
+ * Arithmetic that can leave the range of its type takes the width of the
+ * operation (8, 16, 32 or 64) as operand; jumps take an absolute target.
+ * `Loop` precedes the test of every `while` loop and takes the index of the
+ * loop in the chunk, so the machine can count how often each loop iterates.
+ * The elements of an array take consecutive slots; the instructions on them
+ * take the first slot and the length, and check the index they pop against
+ * it. `StoreElem` pops the index and the value, `StoreElemKeep` pushes the
+ * value back.
+ *
+ * `Call` takes the index of a function. It pops the arguments into the
+ * first slots of a new frame, zeroes the others and runs the function;
+ * `Return` in a function drops its frame and pushes the value it pops onto
+ * the stack of the caller. `Return` at the top level ends the run.
+ * `TailCall`, only in functions, pops the arguments into the first slots
+ * of the frame of the function instead, which becomes that of the callee,
+ * and runs it: the callee returns straight to the caller of the function.
+ *
+ * The compiler only emits the instructions up to `Halt`. The ones after it
+ * are superinstructions, introduced by `fuse` for common sequences, and the
+ * width-specialized forms the machine rewrites generic arithmetic into once
+ * it has run. Superinstructions take the slot they update or test first; a
+ * constant operand is an index into the constant pool.
+ */
+#define THALIA_VM_OPCODES(X) \
+  X(Const, 1)              \
+  X(Load, 1)               \
+  X(Store, 1)              \
+  X(Dup, 0)                \
+  X(Pop, 0)                \
+  X(Add, 1)                \
+  X(Sub, 1)                \
+  X(Mul, 1)                \
+  X(Div, 1)                \
+  X(Mod, 1)                \
+  X(Shl, 1)                \
+  X(Shr, 1)                \
+  X(BitAnd, 0)             \
+  X(BitOr, 0)              \
+  X(Xor, 0)                \
+  X(Less, 0)               \
+  X(LessEqual, 0)          \
+  X(Grt, 0)                \
+  X(GrtEqual, 0)           \
+  X(Equal, 0)              \
+  X(NotEqual, 0)           \
+  X(Neg, 1)                \
+  X(BitNot, 0)             \
+  X(LogNot, 0)             \
+  X(Bool, 0)               \
+  X(Jump, 1)               \
+  X(JumpFalse, 1)          \
+  X(JumpTrue, 1)           \
+  X(AndJump, 1)            \
+  X(OrJump, 1)             \
+  X(Loop, 1)               \
+  X(LoadElem, 2)           \
+  X(StoreElem, 2)          \
+  X(StoreElemKeep, 2)      \
+  X(ClearElems, 2)         \
+  X(Call, 1)               \
+  X(Return, 0)             \
+  X(TailCall, 1)           \
+  X(Halt, 0)               \
+  X(Add32, 1)              \
+  X(Add64, 1)              \
+  X(Sub32, 1)              \
+  X(Sub64, 1)              \
+  X(Mul32, 1)              \
+  X(Mul64, 1)              \
+  X(AddLocal, 3)           \
+  X(SubLocal, 3)           \
+  X(AddConst, 3)           \
+  X(SubConst, 3)           \
+  X(AddLocal32, 3)         \
+  X(AddLocal64, 3)         \
+  X(SubLocal32, 3)         \
+  X(SubLocal64, 3)         \
+  X(AddConst32, 3)         \
+  X(AddConst64, 3)         \
+  X(SubConst32, 3)         \
+  X(SubConst64, 3)         \
+  X(JumpLessLocal, 3)      \
+  X(JumpLessEqualLocal, 3) \
+  X(JumpGrtLocal, 3)       \
+  X(JumpGrtEqualLocal, 3)  \
+  X(JumpEqualLocal, 3)     \
+  X(JumpNotEqualLocal, 3)  \
+  X(JumpLessConst, 3)      \
+  X(JumpLessEqualConst, 3) \
+  X(JumpGrtConst, 3)       \
+  X(JumpGrtEqualConst, 3)  \
+  X(JumpEqualConst, 3)     \
+  X(JumpNotEqualConst, 3)
+
+/**
+ * @brief Lists every register instruction with its number of operands and how
+ *   many of them, at the front, are registers.
+ *
+ * The first register of an instruction that produces a value is its
+ * destination. Arithmetic that can wrap ends with the width of the operation;
+ * jumps end with an absolute target. Element accesses take the value and the
+ * index, then the first slot and the length of the array. `Call` takes the
+ * register of its result and the index of the function, and `TailCall`
+ * only the index, since the callee returns for the function.
+ */
+#define THALIA_VM_REG_OPCODES(X) \
+  X(Move, 2, 2)       \
+  X(Add, 4, 3)        \
+  X(Sub, 4, 3)        \
+  X(Mul, 4, 3)        \
+  X(Div, 4, 3)        \
+  X(Mod, 4, 3)        \
+  X(Shl, 4, 3)        \
+  X(Shr, 4, 3)        \
+  X(BitAnd, 3, 3)     \
+  X(BitOr, 3, 3)      \
+  X(Xor, 3, 3)        \
+  X(Less, 3, 3)       \
+  X(LessEqual, 3, 3)  \
+  X(Grt, 3, 3)        \
+  X(GrtEqual, 3, 3)   \
+  X(Equal, 3, 3)      \
+  X(NotEqual, 3, 3)   \
+  X(Neg, 3, 2)        \
+  X(BitNot, 2, 2)     \
+  X(LogNot, 2, 2)     \
+  X(Bool, 2, 2)       \
+  X(Jump, 1, 0)       \
+  X(JumpFalse, 2, 1)  \
+  X(JumpTrue, 2, 1)   \
+  X(LoadElem, 4, 2)   \
+  X(StoreElem, 4, 2)  \
+  X(ClearElems, 2, 0) \
+  X(Call, 2, 1)       \
+  X(Return, 1, 1)     \
+  X(TailCall, 1, 0)   \
+  X(Halt, 0, 0)
+
+namespace thalia::vm {
+  /**
+   * @brief The unit bytecode is made of: an opcode or one of its operands.
+   */
+  using code_unit = std::uint32_t;
+
+  /**
+   * @brief Enumerates the instructions of the virtual machine.
+   */
+  enum class opcode: code_unit {
+#define THALIA_VM_ENUM(name, operands) name,
+    THALIA_VM_OPCODES(THALIA_VM_ENUM)
+#undef THALIA_VM_ENUM
+  };
+
+  /**
+   * @brief The number of distinct opcodes.
+   */
+  inline constexpr std::size_t opcode_count = 0
+#define THALIA_VM_COUNT(name, operands) + 1
+    THALIA_VM_OPCODES(THALIA_VM_COUNT)
+#undef THALIA_VM_COUNT
+    ;
+
+  /**
+   * @brief Gets the number of operands of an instruction.
+   * @param op The opcode.
+   * @return The number of code units following the opcode.
+   */
+  extern auto operand_count(opcode op) -> std::size_t;
+
+  /**
+   * @brief Gets the mnemonic of an instruction.
+   * @param op The opcode.
+   * @return Its name, as spelled in the opcode list.
+   */
+  extern auto name_of(opcode op) -> std::string_view;
+
+  /**
+   * @brief Enumerates the instructions of the register machine.
+   */
+  enum class reg_opcode: code_unit {
+#define THALIA_VM_REG_ENUM(name, operands, registers) name,
+    THALIA_VM_REG_OPCODES(THALIA_VM_REG_ENUM)
+#undef THALIA_VM_REG_ENUM
+  };
+
+  /**
+   * @brief Gets the number of operands of a register instruction.
+   * @param op The opcode.
+   * @return The number of code units following the opcode.
+   */
+  extern auto operand_count(reg_opcode op) -> std::size_t;
+
+  /**
+   * @brief Gets the number of register operands of a register instruction.
+   * @param op The opcode.
+   * @return The number of leading operands that name a register.
+   */
+  extern auto register_count(reg_opcode op) -> std::size_t;
+
+  /**
+   * @brief Gets the mnemonic of a register instruction.
+   * @param op The opcode.
+   * @return Its name, as spelled in the opcode list.
+   */
+  extern auto name_of(reg_opcode op) -> std::string_view;
+}
+
+#endif // _THALIA_VM_OPCODE_
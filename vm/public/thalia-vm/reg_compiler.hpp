@@ -0,0 +1,80 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_VM_REG_COMPILER_
+#define _THALIA_VM_REG_COMPILER_
+
+#include <memory>
+#include <span>
+
+#include <thalia-syntax/stmts.hpp>
+#include <thalia-sema/checker.hpp>
+#include <thalia-sema/consteval.hpp>
+#include <thalia-sema/resolver.hpp>
+#include <thalia-sema/types.hpp>
+
+#include "chunk.hpp"
+
+namespace thalia::vm {
+  /**
+   * @brief Compiles an analyzed syntax tree into three-address code.
+   *
+   * Operands name registers directly: variables are their frame slots and
+   * constants are preloaded registers, so `s += i` is a single `Add s, s, i`
+   * and an assignment computes its value straight into the target slot.
+   * Intermediate results go to virtual temporaries, which a linear scan over
+   * their live ranges then packs into as few frame registers as possible.
+   * The program must be free of semantic errors.
+   */
+  class reg_compiler {
+    public:
+      /**
+       * @brief Constructs a compiler for an analyzed program.
+       * @param types The table the program's types were interned in.
+       * @param names The resolution of the program.
+       * @param typing The types of the program.
+       * @param values The compile-time values of the program.
+       */
+      reg_compiler(
+        sema::type_table const& types,
+        sema::resolution const& names,
+        sema::typing const& typing,
+        sema::constants const& values
+      ) : _types { types }
+        , _names { names }
+        , _typing { typing }
+        , _values { values } {}
+
+      /**
+       * @brief Compiles all top-level statements of a program.
+       * @param ast The top-level statements of the program.
+       * @return The compiled program, ending with `Halt`.
+       */
+      auto compile(std::span<std::shared_ptr<syntax::statement> const> ast)
+        -> reg_chunk;
+
+    private:
+      sema::type_table const& _types;
+      sema::resolution const& _names;
+      sema::typing const& _typing;
+      sema::constants const& _values;
+  };
+}
+
+#endif // _THALIA_VM_REG_COMPILER_
@@ -0,0 +1,92 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_VM_REG_MACHINE_
+#define _THALIA_VM_REG_MACHINE_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "chunk.hpp"
+#include "machine.hpp"
+
+namespace thalia::vm {
+  /**
+   * @brief A register machine executing a compiled register chunk.
+   *
+   * Every instruction reads its operands from and writes its result to the
+   * frame directly, so there is no operand stack. Dispatch is the same as in
+   * the stack `machine`. The frames of called functions are stacked right
+   * after the top-level one, up to `call_stack_size` registers; a `Call`
+   * whose frame does not fit ends the run as `StackOverflow`. A `TailCall`
+   * moves its arguments to the start of the frame it runs in and hands the
+   * frame over to the callee.
+   */
+  class reg_machine {
+    public:
+      /**
+       * @brief Constructs a machine for a chunk.
+       * @param program The chunk to execute; it must outlive the machine.
+       */
+      reg_machine(reg_chunk const& program)
+        : _program { program }
+        , _frame(frame_size(program)) {}
+
+      /**
+       * @brief Runs the program from the start with all slots zeroed.
+       * @return How the run ended.
+       */
+      auto run() -> outcome;
+
+      /**
+       * @brief Gets the variable slots of the last run.
+       * @return The values of all slots.
+       */
+      auto slots() const -> std::span<std::int64_t const>
+        { return std::span { _frame }.first(_program.slots); }
+
+    private:
+      /**
+       * @brief What a `Return` restores: the frame of the caller and where
+       *   it continues, right after its `Call`.
+       */
+      struct activation {
+        code_unit const* pc;
+        std::int64_t* frame;
+        std::size_t registers;
+      };
+
+      /**
+       * @brief Gets the number of registers the frames take at most, with
+       *   room past the last one for the arguments of a call that does not fit.
+       * @param program The chunk to execute.
+       * @return The size of the frame of the top level and of the stack.
+       */
+      static auto frame_size(reg_chunk const& program) -> std::size_t;
+
+    private:
+      reg_chunk const& _program;
+      std::vector<std::int64_t> _frame;
+      std::vector<activation> _calls;
+  };
+}
+
+#endif // _THALIA_VM_REG_MACHINE_
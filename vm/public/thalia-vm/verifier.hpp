@@ -0,0 +1,78 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_VM_VERIFIER_
+#define _THALIA_VM_VERIFIER_
+
+#include <cstddef>
+#include <optional>
+#include <string>
+
+#include "chunk.hpp"
+
+namespace thalia::vm {
+  /**
+   * @brief Why a chunk is not well formed.
+   */
+  struct verify_error {
+    /** The offset of the offending instruction. */
+    std::size_t offset;
+    /** What is wrong with it. */
+    std::string reason;
+  };
+
+  /**
+   * @brief Proves that a chunk is well formed.
+   * @param program The chunk.
+   * @return The first problem found, or nothing if the chunk is well formed.
+   *
+   * A well-formed chunk has a top-level frame and operand stack of at most
+   * `call_stack_size` values each, and decodes into complete instructions
+   * with known opcodes; every slot, constant, loop and function operand is
+   * in range; every width is 8, 16, 32 or 64, and the width of a specialized
+   * form is its own; every jump and loop exit lands on an instruction
+   * boundary. The top level and every function are checked on their own code
+   * and frame: jumps stay within them, only the top level has loops, and
+   * following every path from their start, the operand stack never
+   * underflows or grows past their `max_stack`, has the same depth wherever
+   * paths join, and no path runs past their end. A machine can run such a
+   * chunk with no checks.
+   */
+  extern auto verify(chunk_view const& program) -> std::optional<verify_error>;
+
+  /**
+   * @brief Checks one instruction right before it runs, as a machine does
+   *   for code `verify` did not accept.
+   * @param program The chunk, viewing the code being run.
+   * @param function The function running, or `top_level`.
+   * @param offset The offset of the instruction.
+   * @param depth The number of values on the operand stack of the frame.
+   * @return Whether the instruction stays within the code, the frame, the
+   *   constant pool and the operand stack, and calls a function whose
+   *   entry can be trusted.
+   */
+  extern auto admissible(
+    chunk_view const& program,
+    std::size_t function,
+    std::size_t offset,
+    std::size_t depth
+  ) -> bool;
+}
+
+#endif // _THALIA_VM_VERIFIER_
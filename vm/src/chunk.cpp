@@ -0,0 +1,104 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <iterator>
+
+#include "thalia-vm/chunk.hpp"
+
+namespace thalia::vm {
+  namespace {
+    auto find_line(std::span<line_entry const> lines, std::size_t offset)
+      -> std::size_t {
+      auto found = std::upper_bound(
+        lines.begin(), lines.end(), offset,
+        [](std::size_t value, line_entry const& entry)
+          { return value < entry.offset; }
+      );
+      return found == lines.begin() ? 0 : std::prev(found)->line;
+    }
+  }
+
+  extern auto chunk_view::line_at(std::size_t offset) const
+    -> std::size_t {
+    return find_line(lines, offset);
+  }
+
+  extern auto chunk::line_at(std::size_t offset) const
+    -> std::size_t {
+    return find_line(lines, offset);
+  }
+
+  extern auto reg_chunk::line_at(std::size_t offset) const
+    -> std::size_t {
+    return find_line(lines, offset);
+  }
+
+  extern auto disassemble(std::ostream& os, chunk const& target)
+    -> std::ostream& {
+    auto function = std::size_t { 0 };
+    for (auto pc = std::size_t { 0 }; pc < target.code.size();) {
+      if (function < target.functions.size() && target.functions[function].offset == pc)
+        os << "function " << function++ << ":\n";
+      auto op = static_cast<opcode>(target.code[pc]);
+      os << std::setw(6) << pc << "  " << name_of(op);
+      auto operands = operand_count(op);
+      for (auto i = std::size_t { 1 }; i <= operands; ++i)
+        os << ' ' << target.code[pc + i];
+      if (op == opcode::Const)
+        os << "  ; " << target.constants[target.code[pc + 1]];
+      os << '\n';
+      pc += 1 + operands;
+    }
+    return os;
+  }
+
+  extern auto disassemble(std::ostream& os, reg_chunk const& target)
+    -> std::ostream& {
+    // Registers are named after the frame the code runs in.
+    auto slots = target.slots;
+    auto const* pool = &target.constants;
+    auto function = std::size_t { 0 };
+    for (auto pc = std::size_t { 0 }; pc < target.code.size();) {
+      if (function < target.functions.size() && target.functions[function].offset == pc) {
+        slots = target.functions[function].slots;
+        pool = &target.functions[function].constants;
+        os << "function " << function++ << ":\n";
+      }
+      auto constants = slots + pool->size();
+      auto op = static_cast<reg_opcode>(target.code[pc]);
+      os << std::setw(6) << pc << "  " << name_of(op);
+      auto operands = operand_count(op);
+      auto registers = register_count(op);
+      for (auto i = std::size_t { 1 }; i <= operands; ++i) {
+        auto value = target.code[pc + i];
+        if (i > registers)
+          os << ' ' << value;
+        else if (value < slots)
+          os << " s" << value;
+        else if (value < constants)
+          os << " k" << (*pool)[value - slots];
+        else os << " r" << value - constants;
+      }
+      os << '\n';
+      pc += 1 + operands;
+    }
+    return os;
+  }
+}
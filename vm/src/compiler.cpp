@@ -0,0 +1,612 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <initializer_list>
+#include <unordered_map>
+#include <utility>
+
+#include <thalia-sema/arith.hpp>
+#include <thalia-sema/tail_calls.hpp>
+
+#include "thalia-vm/compiler.hpp"
+
+namespace thalia::vm {
+  namespace {
+    struct context {
+      sema::type_table const& types;
+      sema::resolution const& names;
+      sema::typing const& typing;
+      sema::constants const& values;
+      frame_layout const& frame;
+      chunk& out;
+      std::vector<std::shared_ptr<syntax::statement>>& loops;
+      std::unordered_map<std::int64_t, code_unit>& pool;
+      std::size_t depth;
+      std::size_t max_stack;
+      /** The function being compiled, or `npos` at the top level. */
+      std::size_t function;
+    };
+
+    // Stack effect of every instruction on its fall-through path.
+    auto effect_of(opcode op)
+      -> int {
+      switch (op) {
+        case opcode::Const:
+        case opcode::Load:
+        case opcode::Dup:
+        case opcode::Call:
+          return 1;
+        case opcode::StoreElem:
+          return -2;
+        case opcode::LoadElem:
+        case opcode::ClearElems:
+        case opcode::Neg:
+        case opcode::BitNot:
+        case opcode::LogNot:
+        case opcode::Bool:
+        case opcode::Jump:
+        case opcode::Loop:
+        case opcode::TailCall:
+        case opcode::Halt:
+          return 0;
+        default:
+          return -1;
+      }
+    }
+
+    auto emit(context& ctx, opcode op, std::initializer_list<code_unit> operands = {})
+      -> std::size_t {
+      auto offset = ctx.out.code.size();
+      ctx.out.code.push_back(static_cast<code_unit>(op));
+      ctx.out.code.insert(ctx.out.code.end(), operands);
+      ctx.depth += static_cast<std::size_t>(effect_of(op));
+      ctx.max_stack = std::max(ctx.max_stack, ctx.depth);
+      return offset;
+    }
+
+    auto emit_const(context& ctx, std::int64_t value)
+      -> void {
+      auto [found, inserted] = ctx.pool.try_emplace(
+        value, static_cast<code_unit>(ctx.out.constants.size())
+      );
+      if (inserted)
+        ctx.out.constants.push_back(value);
+      emit(ctx, opcode::Const, { found->second });
+    }
+
+    auto here(context& ctx)
+      -> code_unit {
+      return static_cast<code_unit>(ctx.out.code.size());
+    }
+
+    auto patch(context& ctx, std::size_t jump, code_unit target)
+      -> void {
+      ctx.out.code[jump + 1] = target;
+    }
+
+    // The slot of a variable in the frame being compiled.
+    auto slot_of(context& ctx, std::size_t slot)
+      -> code_unit {
+      return static_cast<code_unit>(slot - ctx.frame.base);
+    }
+
+    // The line of the token an expression is built around.
+    auto line_of(std::shared_ptr<syntax::expression> const& node)
+      -> std::size_t {
+      switch (node->type()) {
+        case syntax::expr_type::Assign:
+          return std::static_pointer_cast<syntax::expr_assign>(node)->operation().line();
+        case syntax::expr_type::Binary:
+          return std::static_pointer_cast<syntax::expr_binary>(node)->operation().line();
+        case syntax::expr_type::Unary:
+          return std::static_pointer_cast<syntax::expr_unary>(node)->operation().line();
+        case syntax::expr_type::Paren:
+          return line_of(std::static_pointer_cast<syntax::expr_paren>(node)->value());
+        case syntax::expr_type::BaseLit:
+          return std::static_pointer_cast<syntax::expr_base_lit>(node)->target().line();
+        case syntax::expr_type::Id:
+          return std::static_pointer_cast<syntax::expr_id>(node)->target().line();
+        case syntax::expr_type::Index:
+          return std::static_pointer_cast<syntax::expr_index>(node)->bracket().line();
+        case syntax::expr_type::Call:
+          return std::static_pointer_cast<syntax::expr_call>(node)->callee().line();
+        case syntax::expr_type::ArrayType:
+          return std::static_pointer_cast<syntax::expr_array_type>(node)->length().line();
+        default:
+          return std::static_pointer_cast<syntax::expr_data_type>(node)->target().line();
+      }
+    }
+
+    auto width_of(context& ctx, std::shared_ptr<syntax::expression> const& node)
+      -> code_unit {
+      return static_cast<code_unit>(ctx.types.get(ctx.typing.type_of(*node)).width);
+    }
+
+    auto unwrap(std::shared_ptr<syntax::expression> node)
+      -> std::shared_ptr<syntax::expression> {
+      while (node && node->is(syntax::expr_type::Paren))
+        node = std::static_pointer_cast<syntax::expr_paren>(node)->value();
+      return node;
+    }
+
+    // The first slot and the length of the array an index reads.
+    auto array_of(context& ctx, syntax::expr_index const& node)
+      -> std::pair<code_unit, code_unit> {
+      auto target = std::static_pointer_cast<syntax::expr_id>(unwrap(node.target()));
+      auto slot = ctx.names.slot(*target);
+      return {
+        static_cast<code_unit>(ctx.frame.elements[slot]),
+        static_cast<code_unit>(ctx.types.get(ctx.typing.slot_type(slot)).length)
+      };
+    }
+
+    // Combines the old value of an assignment target with the new one.
+    auto emit_update(context& ctx, syntax::token const& token, code_unit width)
+      -> void {
+      switch (sema::binary_of(token.type())) {
+        case syntax::token_type::Plus: emit(ctx, opcode::Add, { width }); break;
+        case syntax::token_type::Minus: emit(ctx, opcode::Sub, { width }); break;
+        case syntax::token_type::Mul: emit(ctx, opcode::Mul, { width }); break;
+        case syntax::token_type::Div:
+          ctx.out.lines.push_back(line_entry { here(ctx), token.line() });
+          emit(ctx, opcode::Div, { width });
+          break;
+        case syntax::token_type::Mod:
+          ctx.out.lines.push_back(line_entry { here(ctx), token.line() });
+          emit(ctx, opcode::Mod, { width });
+          break;
+        case syntax::token_type::LShift: emit(ctx, opcode::Shl, { width }); break;
+        case syntax::token_type::RShift: emit(ctx, opcode::Shr, { width }); break;
+        case syntax::token_type::BitAnd: emit(ctx, opcode::BitAnd); break;
+        case syntax::token_type::BitOr: emit(ctx, opcode::BitOr); break;
+        default: emit(ctx, opcode::Xor); break;
+      }
+    }
+
+    class expr_compiler
+      : public syntax::expr_visitor<context&, void> {
+      public:
+        expr_compiler(std::shared_ptr<syntax::expression> const& node, bool discard = false)
+          : syntax::expr_visitor<context&, void> { node }
+          , _discard { discard } {}
+
+        auto compile(context& ctx) -> void;
+
+      protected:
+        auto visit_expr_assign(context& ctx) -> void override;
+        auto visit_expr_binary(context& ctx) -> void override;
+        auto visit_expr_unary(context& ctx) -> void override;
+        auto visit_expr_paren(context& ctx) -> void override;
+        auto visit_expr_base_lit(context& ctx) -> void override;
+        auto visit_expr_id(context& ctx) -> void override;
+        auto visit_expr_index(context& ctx) -> void override;
+        auto visit_expr_call(context& ctx) -> void override;
+        auto visit_expr_data_type(context&) -> void override {}
+        auto visit_expr_array_type(context&) -> void override {}
+
+      private:
+        auto compile_logical(context& ctx, opcode jump) -> void;
+        auto compile_element_assign(context& ctx) -> void;
+
+      private:
+        bool _discard;
+    };
+
+    class stmt_compiler
+      : public syntax::stmt_visitor<context&, void> {
+      public:
+        stmt_compiler(std::shared_ptr<syntax::statement> const& node)
+          : syntax::stmt_visitor<context&, void> { node } {}
+
+        auto compile(context& ctx) -> void
+          { if (_node) visit_stmt(ctx); }
+
+      protected:
+        auto visit_stmt_block(context& ctx) -> void override;
+        auto visit_stmt_return(context& ctx) -> void override;
+        auto visit_stmt_expr(context& ctx) -> void override;
+        auto visit_stmt_if(context& ctx) -> void override;
+        auto visit_stmt_while(context& ctx) -> void override;
+        auto visit_stmt_local(context& ctx) -> void override;
+        auto visit_stmt_function(context&) -> void override {}
+    };
+
+    extern auto expr_compiler::compile(context& ctx)
+      -> void {
+      if (!_node)
+        return;
+
+      auto folded = ctx.values.value(*_node);
+      if (folded) {
+        if (!_discard)
+          emit_const(ctx, *folded);
+        return;
+      }
+
+      visit_expr(ctx);
+      // Assignments and parentheses drop their own value.
+      if (_discard && !_node->is({ syntax::expr_type::Assign, syntax::expr_type::Paren }))
+        emit(ctx, opcode::Pop);
+    }
+
+    extern auto expr_compiler::visit_expr_assign(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_assign>(_node);
+      if (unwrap(root->target())->is(syntax::expr_type::Index))
+        return compile_element_assign(ctx);
+      auto target = std::static_pointer_cast<syntax::expr_id>(unwrap(root->target()));
+      auto slot = slot_of(ctx, ctx.names.slot(*target));
+
+      if (root->operation().is(syntax::token_type::Assign)) {
+        expr_compiler { root->value() }.compile(ctx);
+      } else {
+        emit(ctx, opcode::Load, { slot });
+        expr_compiler { root->value() }.compile(ctx);
+        emit_update(ctx, root->operation(), width_of(ctx, target));
+      }
+
+      if (!_discard)
+        emit(ctx, opcode::Dup);
+      emit(ctx, opcode::Store, { slot });
+    }
+
+    // The index is evaluated first and checked when the element is accessed:
+    // after the value for a plain assignment, before it for an update.
+    extern auto expr_compiler::compile_element_assign(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_assign>(_node);
+      auto target = std::static_pointer_cast<syntax::expr_index>(unwrap(root->target()));
+      auto [base, length] = array_of(ctx, *target);
+      auto line = target->bracket().line();
+
+      expr_compiler { target->index() }.compile(ctx);
+      if (root->operation().is(syntax::token_type::Assign)) {
+        expr_compiler { root->value() }.compile(ctx);
+      } else {
+        emit(ctx, opcode::Dup);
+        ctx.out.lines.push_back(line_entry { here(ctx), line });
+        emit(ctx, opcode::LoadElem, { base, length });
+        expr_compiler { root->value() }.compile(ctx);
+        emit_update(ctx, root->operation(), width_of(ctx, target));
+      }
+
+      ctx.out.lines.push_back(line_entry { here(ctx), line });
+      emit(ctx, _discard ? opcode::StoreElem : opcode::StoreElemKeep, { base, length });
+    }
+
+    extern auto expr_compiler::compile_logical(context& ctx, opcode jump)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_binary>(_node);
+      expr_compiler { root->lhs() }.compile(ctx);
+      auto skip = emit(ctx, jump, { 0 });
+      expr_compiler { root->rhs() }.compile(ctx);
+      emit(ctx, opcode::Bool);
+      patch(ctx, skip, here(ctx));
+    }
+
+    extern auto expr_compiler::visit_expr_binary(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_binary>(_node);
+      auto operation = root->operation();
+      if (operation.is(syntax::token_type::LogAnd))
+        return compile_logical(ctx, opcode::AndJump);
+      if (operation.is(syntax::token_type::LogOr))
+        return compile_logical(ctx, opcode::OrJump);
+
+      auto width = width_of(ctx, root->lhs());
+      expr_compiler { root->lhs() }.compile(ctx);
+      expr_compiler { root->rhs() }.compile(ctx);
+      switch (operation.type()) {
+        case syntax::token_type::Plus: emit(ctx, opcode::Add, { width }); break;
+        case syntax::token_type::Minus: emit(ctx, opcode::Sub, { width }); break;
+        case syntax::token_type::Mul: emit(ctx, opcode::Mul, { width }); break;
+        case syntax::token_type::Div:
+        case syntax::token_type::Mod:
+          ctx.out.lines.push_back(line_entry { here(ctx), operation.line() });
+          emit(ctx, operation.is(syntax::token_type::Div) ? opcode::Div : opcode::Mod, { width });
+          break;
+        case syntax::token_type::LShift: emit(ctx, opcode::Shl, { width }); break;
+        case syntax::token_type::RShift: emit(ctx, opcode::Shr, { width }); break;
+        case syntax::token_type::BitAnd: emit(ctx, opcode::BitAnd); break;
+        case syntax::token_type::BitOr: emit(ctx, opcode::BitOr); break;
+        case syntax::token_type::Xor: emit(ctx, opcode::Xor); break;
+        case syntax::token_type::Less: emit(ctx, opcode::Less); break;
+        case syntax::token_type::LessEqual: emit(ctx, opcode::LessEqual); break;
+        case syntax::token_type::Grt: emit(ctx, opcode::Grt); break;
+        case syntax::token_type::GrtEqual: emit(ctx, opcode::GrtEqual); break;
+        case syntax::token_type::Equal: emit(ctx, opcode::Equal); break;
+        default: emit(ctx, opcode::NotEqual); break;
+      }
+    }
+
+    extern auto expr_compiler::visit_expr_unary(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_unary>(_node);
+      expr_compiler { root->value() }.compile(ctx);
+      switch (root->operation().type()) {
+        case syntax::token_type::Minus:
+          emit(ctx, opcode::Neg, { width_of(ctx, _node) });
+          break;
+        case syntax::token_type::BitNot:
+          emit(ctx, opcode::BitNot);
+          break;
+        case syntax::token_type::LogNot:
+          emit(ctx, opcode::LogNot);
+          break;
+        default:
+          break;
+      }
+    }
+
+    extern auto expr_compiler::visit_expr_paren(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_paren>(_node);
+      expr_compiler { root->value(), _discard }.compile(ctx);
+    }
+
+    extern auto expr_compiler::visit_expr_base_lit(context& ctx)
+      -> void {
+      // Checked literals are always folded already.
+      auto root = std::static_pointer_cast<syntax::expr_base_lit>(_node);
+      emit_const(ctx, sema::parse_literal(root->target().value(), width_of(ctx, _node)).value);
+    }
+
+    extern auto expr_compiler::visit_expr_id(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_id>(_node);
+      emit(ctx, opcode::Load, { slot_of(ctx, ctx.names.slot(*root)) });
+    }
+
+    extern auto expr_compiler::visit_expr_index(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_index>(_node);
+      auto [base, length] = array_of(ctx, *root);
+      expr_compiler { root->index() }.compile(ctx);
+      ctx.out.lines.push_back(line_entry { here(ctx), root->bracket().line() });
+      emit(ctx, opcode::LoadElem, { base, length });
+    }
+
+    // The arguments are pushed in order; the frame they are popped into may
+    // not fit, so the call has a line.
+    extern auto expr_compiler::visit_expr_call(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::expr_call>(_node);
+      for (auto const& arg: root->args())
+        expr_compiler { arg }.compile(ctx);
+      ctx.depth -= root->args().size();
+      ctx.out.lines.push_back(line_entry { here(ctx), root->callee().line() });
+      emit(ctx, opcode::Call, { static_cast<code_unit>(ctx.names.callee(*root)) });
+    }
+
+    extern auto stmt_compiler::visit_stmt_block(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_block>(_node);
+      for (auto const& node: root->content())
+        stmt_compiler { node }.compile(ctx);
+    }
+
+    // A call a function returns reuses its frame, so a recursion written as
+    // `return f(...)` runs in constant space.
+    extern auto stmt_compiler::visit_stmt_return(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_return>(_node);
+      auto tail = sema::tail_call_of(*root);
+      if (tail && ctx.function != sema::resolution::npos) {
+        for (auto const& arg: tail->args())
+          expr_compiler { arg }.compile(ctx);
+        ctx.depth -= tail->args().size();
+        ctx.out.lines.push_back(line_entry { here(ctx), tail->callee().line() });
+        emit(ctx, opcode::TailCall, { static_cast<code_unit>(ctx.names.callee(*tail)) });
+        return;
+      }
+      if (root->value())
+        expr_compiler { root->value() }.compile(ctx);
+      else emit_const(ctx, 0);
+      emit(ctx, opcode::Return);
+    }
+
+    extern auto stmt_compiler::visit_stmt_expr(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_expr>(_node);
+      expr_compiler { root->value(), true }.compile(ctx);
+    }
+
+    extern auto stmt_compiler::visit_stmt_if(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_if>(_node);
+      auto folded = ctx.values.value(*root->condition());
+      if (folded) {
+        stmt_compiler { *folded ? root->main_body() : root->else_body() }.compile(ctx);
+        return;
+      }
+
+      expr_compiler { root->condition() }.compile(ctx);
+      auto to_else = emit(ctx, opcode::JumpFalse, { 0 });
+      stmt_compiler { root->main_body() }.compile(ctx);
+      if (!root->else_body()) {
+        patch(ctx, to_else, here(ctx));
+        return;
+      }
+
+      auto to_end = emit(ctx, opcode::Jump, { 0 });
+      patch(ctx, to_else, here(ctx));
+      stmt_compiler { root->else_body() }.compile(ctx);
+      patch(ctx, to_end, here(ctx));
+    }
+
+    extern auto stmt_compiler::visit_stmt_while(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_while>(_node);
+      auto folded = ctx.values.value(*root->condition());
+      if (folded && !*folded)
+        return;
+
+      // Registered before the body, so loops are numbered in source order.
+      // Loops of functions run on frames the tier does not see, so they are
+      // neither counted nor registered.
+      auto counted = ctx.function == sema::resolution::npos;
+      auto index = ctx.out.loops.size();
+      if (counted) {
+        ctx.out.loops.push_back(loop_entry { 0, line_of(root->condition()) });
+        ctx.loops.push_back(_node);
+      }
+      auto loop = static_cast<code_unit>(index);
+
+      // The condition is tested at the bottom, so every iteration takes a
+      // single branch. `Loop` starts the test, where the loop is entered.
+      if (folded) {
+        auto body = here(ctx);
+        if (counted)
+          emit(ctx, opcode::Loop, { loop });
+        stmt_compiler { root->body() }.compile(ctx);
+        emit(ctx, opcode::Jump, { body });
+        if (counted)
+          ctx.out.loops[index].exit = here(ctx);
+        return;
+      }
+
+      auto to_test = emit(ctx, opcode::Jump, { 0 });
+      auto body = here(ctx);
+      stmt_compiler { root->body() }.compile(ctx);
+      patch(ctx, to_test, here(ctx));
+      if (counted)
+        emit(ctx, opcode::Loop, { loop });
+      expr_compiler { root->condition() }.compile(ctx);
+      emit(ctx, opcode::JumpTrue, { body });
+      if (counted)
+        ctx.out.loops[index].exit = here(ctx);
+    }
+
+    extern auto stmt_compiler::visit_stmt_local(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_local>(_node);
+      for (auto const& variable: root->content()) {
+        auto slot = ctx.names.slot(variable);
+        auto const& declared = ctx.types.get(ctx.typing.slot_type(slot));
+        if (declared.kind == sema::type_kind::Array) {
+          emit(ctx, opcode::ClearElems, {
+            static_cast<code_unit>(ctx.frame.elements[slot]),
+            static_cast<code_unit>(declared.length)
+          });
+          continue;
+        }
+
+        if (variable.value)
+          expr_compiler { variable.value }.compile(ctx);
+        else emit_const(ctx, 0);
+        emit(ctx, opcode::Store, { slot_of(ctx, slot) });
+      }
+    }
+  }
+
+  extern auto frame_of(
+    sema::type_table const& types,
+    sema::resolution const& names,
+    sema::typing const& typing
+  ) -> frame_layout {
+    auto symbols = names.symbols();
+    auto result = frame_layout { std::vector<std::size_t>(symbols.size(), 0), symbols.size() };
+    for (auto slot = std::size_t { 0 }; slot < symbols.size(); ++slot) {
+      auto const& declared = types.get(typing.slot_type(slot));
+      if (declared.kind != sema::type_kind::Array || symbols[slot].owner != sema::resolution::npos)
+        continue;
+      result.elements[slot] = result.slots;
+      result.slots += declared.length;
+    }
+    return result;
+  }
+
+  extern auto frame_of(
+    sema::type_table const& types,
+    sema::resolution const& names,
+    sema::typing const& typing,
+    std::size_t function
+  ) -> frame_layout {
+    auto const& target = names.functions()[function];
+    auto result = frame_layout {
+      std::vector<std::size_t>(names.symbols().size(), 0), target.count, target.first
+    };
+    for (auto slot = target.first; slot < target.first + target.count; ++slot) {
+      auto const& declared = types.get(typing.slot_type(slot));
+      if (declared.kind != sema::type_kind::Array)
+        continue;
+      result.elements[slot] = result.slots;
+      result.slots += declared.length;
+    }
+    return result;
+  }
+
+  extern auto globals_of(
+    sema::type_table const& types,
+    sema::resolution const& names,
+    sema::typing const& typing
+  ) -> std::vector<global> {
+    auto result = std::vector<global> {};
+    auto symbols = names.symbols();
+    for (auto slot = std::size_t { 0 }; slot < symbols.size(); ++slot) {
+      auto const& symbol = symbols[slot];
+      if (symbol.depth != 0 || symbol.external || !symbol.declaration->mut)
+        continue;
+      if (types.is_array(typing.slot_type(slot)))
+        continue;
+      result.push_back(global {
+        std::string { symbol.declaration->id.value() }, slot,
+        types.get(typing.slot_type(slot)).width
+      });
+    }
+    return result;
+  }
+
+  extern auto compiler::compile(
+    std::span<std::shared_ptr<syntax::statement> const> ast
+  ) -> chunk {
+    auto frame = frame_of(_types, _names, _typing);
+    auto result = chunk {};
+    result.slots = frame.slots;
+    _loops.clear();
+    auto pool = std::unordered_map<std::int64_t, code_unit> {};
+    auto ctx = context {
+      _types, _names, _typing, _values, frame, result, _loops, pool, 0, 0, sema::resolution::npos
+    };
+    for (auto const& node: ast)
+      stmt_compiler { node }.compile(ctx);
+    emit(ctx, opcode::Halt);
+    result.max_stack = ctx.max_stack;
+
+    // A function that falls off its end returns 0.
+    auto functions = _names.functions();
+    for (auto function = std::size_t { 0 }; function < functions.size(); ++function) {
+      auto const& definition = *functions[function].definition;
+      auto layout = frame_of(_types, _names, _typing, function);
+      auto inner = context {
+        _types, _names, _typing, _values, layout, result, _loops, pool, 0, 0, function
+      };
+      auto offset = result.code.size();
+      stmt_compiler { definition.body() }.compile(inner);
+      emit_const(inner, 0);
+      emit(inner, opcode::Return);
+      result.functions.push_back(function_entry {
+        offset, definition.params().size(), layout.slots, inner.max_stack, definition.id().line()
+      });
+    }
+
+    result.globals = globals_of(_types, _names, _typing);
+    return result;
+  }
+}
@@ -0,0 +1,58 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _THALIA_VM_DISPATCH_
+#define _THALIA_VM_DISPATCH_
+
+#include <cstdint>
+
+#include <thalia-sema/arith.hpp>
+#include <thalia-vm/opcode.hpp>
+
+#if defined(__GNUC__)
+#  define THALIA_VM_THREADED 1
+#else
+#  define THALIA_VM_THREADED 0
+#endif
+
+namespace thalia::vm {
+  /**
+   * @brief Wraps the result of an operation to its width.
+   * @param value The two's complement result.
+   * @param width The width of the operation in bits.
+   * @return The sign-extended value.
+   */
+  inline auto wrap(std::int64_t value, code_unit width)
+    -> std::int64_t {
+    return sema::wrap(static_cast<std::uint64_t>(value), width);
+  }
+
+  /**
+   * @brief Reduces a shift amount modulo the width of the operation.
+   * @param amount The shift amount.
+   * @param width The width of the operation in bits.
+   * @return The amount to shift by.
+   */
+  inline auto shift_of(std::int64_t amount, code_unit width)
+    -> std::uint64_t {
+    return static_cast<std::uint64_t>(amount) & (width - 1);
+  }
+}
+
+#endif // _THALIA_VM_DISPATCH_
@@ -0,0 +1,233 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <iomanip>
+#include <optional>
+#include <vector>
+
+#include "thalia-vm/fusion.hpp"
+
+namespace thalia::vm {
+  namespace {
+    auto is_jump(opcode op)
+      -> bool {
+      switch (op) {
+        case opcode::Jump:
+        case opcode::JumpFalse:
+        case opcode::JumpTrue:
+        case opcode::AndJump:
+        case opcode::OrJump:
+          return true;
+        default:
+          return false;
+      }
+    }
+
+    // Maps a comparison to the branch taken when it holds, given whether its
+    // right operand is a constant.
+    auto branch_of(opcode compare, bool constant)
+      -> std::optional<opcode> {
+      auto base = constant ? opcode::JumpLessConst : opcode::JumpLessLocal;
+      auto offset = code_unit { 0 };
+      switch (compare) {
+        case opcode::Less: offset = 0; break;
+        case opcode::LessEqual: offset = 1; break;
+        case opcode::Grt: offset = 2; break;
+        case opcode::GrtEqual: offset = 3; break;
+        case opcode::Equal: offset = 4; break;
+        case opcode::NotEqual: offset = 5; break;
+        default: return std::nullopt;
+      }
+      return static_cast<opcode>(static_cast<code_unit>(base) + offset);
+    }
+
+    auto negate(opcode compare)
+      -> opcode {
+      switch (compare) {
+        case opcode::Less: return opcode::GrtEqual;
+        case opcode::LessEqual: return opcode::Grt;
+        case opcode::Grt: return opcode::LessEqual;
+        case opcode::GrtEqual: return opcode::Less;
+        case opcode::Equal: return opcode::NotEqual;
+        default: return opcode::Equal;
+      }
+    }
+
+    struct instruction {
+      std::size_t offset;
+      opcode op;
+    };
+
+    class fuser {
+      public:
+        fuser(chunk const& program)
+          : _program { program }
+          , _instrs {}
+          , _targets(program.code.size() + 1, false) {
+          for (auto pc = std::size_t { 0 }; pc < program.code.size();) {
+            auto op = static_cast<opcode>(program.code[pc]);
+            _instrs.push_back(instruction { pc, op });
+            if (is_jump(op))
+              _targets[program.code[pc + 1]] = true;
+            pc += 1 + operand_count(op);
+          }
+          for (auto const& entry: program.functions)
+            _targets[entry.offset] = true;
+        }
+
+        // Tries to fuse the four instructions starting at `index`; returns
+        // the superinstruction and its operands.
+        auto match(std::size_t index) const
+          -> std::optional<std::array<code_unit, 4>> {
+          if (index + 4 > _instrs.size())
+            return std::nullopt;
+          for (auto i = index + 1; i < index + 4; ++i)
+            if (_targets[_instrs[i].offset])
+              return std::nullopt;
+
+          auto const& first = _instrs[index];
+          auto const& second = _instrs[index + 1];
+          auto const& third = _instrs[index + 2];
+          auto const& fourth = _instrs[index + 3];
+          if (first.op != opcode::Load)
+            return std::nullopt;
+          if (second.op != opcode::Load && second.op != opcode::Const)
+            return std::nullopt;
+
+          auto constant = second.op == opcode::Const;
+          auto slot = operand(first);
+          auto other = operand(second);
+
+          if (third.op == opcode::Add || third.op == opcode::Sub) {
+            if (fourth.op != opcode::Store || operand(fourth) != slot)
+              return std::nullopt;
+            auto fused = third.op == opcode::Add
+              ? (constant ? opcode::AddConst : opcode::AddLocal)
+              : (constant ? opcode::SubConst : opcode::SubLocal);
+            return std::array { static_cast<code_unit>(fused), slot, other, operand(third) };
+          }
+
+          if (fourth.op != opcode::JumpTrue && fourth.op != opcode::JumpFalse)
+            return std::nullopt;
+          auto compare = fourth.op == opcode::JumpTrue ? third.op : negate(third.op);
+          if (!branch_of(third.op, constant))
+            return std::nullopt;
+          auto fused = *branch_of(compare, constant);
+          return std::array { static_cast<code_unit>(fused), slot, other, operand(fourth) };
+        }
+
+        auto instructions() const -> std::vector<instruction> const&
+          { return _instrs; }
+
+      private:
+        auto operand(instruction const& target) const -> code_unit
+          { return _program.code[target.offset + 1]; }
+
+      private:
+        chunk const& _program;
+        std::vector<instruction> _instrs;
+        std::vector<bool> _targets;
+    };
+  }
+
+  extern auto fuse(chunk& program)
+    -> fusion_report {
+    auto report = fusion_report {};
+    auto const finder = fuser { program };
+    auto const& instrs = finder.instructions();
+
+    // New offsets of every old instruction boundary that can still be reached.
+    auto moved = std::vector<code_unit>(program.code.size() + 1, 0);
+    auto code = std::vector<code_unit> {};
+    code.reserve(program.code.size());
+    for (auto index = std::size_t { 0 }; index < instrs.size();) {
+      auto const& current = instrs[index];
+      moved[current.offset] = static_cast<code_unit>(code.size());
+      if (auto fused = finder.match(index)) {
+        code.insert(code.end(), fused->begin(), fused->end());
+        ++report.sites[(*fused)[0]];
+        index += 4;
+        continue;
+      }
+      auto size = 1 + operand_count(current.op);
+      auto begin = program.code.begin() + static_cast<std::ptrdiff_t>(current.offset);
+      code.insert(code.end(), begin, begin + static_cast<std::ptrdiff_t>(size));
+      ++index;
+    }
+    moved[program.code.size()] = static_cast<code_unit>(code.size());
+
+    for (auto pc = std::size_t { 0 }; pc < code.size();) {
+      auto op = static_cast<opcode>(code[pc]);
+      auto operands = operand_count(op);
+      // Fused branches are the last opcodes and end with their target too.
+      if (is_jump(op) || op >= opcode::JumpLessLocal)
+        code[pc + operands] = moved[code[pc + operands]];
+      pc += 1 + operands;
+    }
+    for (auto& entry: program.lines)
+      entry.offset = moved[entry.offset];
+    for (auto& entry: program.loops)
+      entry.exit = moved[entry.exit];
+    for (auto& entry: program.functions)
+      entry.offset = moved[entry.offset];
+
+    program.code = std::move(code);
+    return report;
+  }
+
+  extern auto print_profile(
+    std::ostream& os,
+    fusion_report const& fused,
+    std::span<std::uint64_t const> executions
+  ) -> std::ostream& {
+    // A superinstruction runs as itself until it is quickened, and as one of
+    // its specialized forms afterwards.
+    auto family = [&](code_unit op) {
+      auto name = name_of(static_cast<opcode>(op));
+      auto total = std::uint64_t { 0 };
+      for (auto other = code_unit { 0 }; other < opcode_count; ++other) {
+        auto candidate = name_of(static_cast<opcode>(other));
+        if (candidate.starts_with(name)
+            && (candidate.size() == name.size() || candidate.substr(name.size()) == "32"
+              || candidate.substr(name.size()) == "64"))
+          total += executions[other];
+      }
+      return total;
+    };
+
+    os << "superinstruction          sites    executions\n";
+    for (auto op = code_unit { 0 }; op < opcode_count; ++op) {
+      if (fused.sites[op] == 0)
+        continue;
+      os << std::left << std::setw(24) << name_of(static_cast<opcode>(op)) << std::right
+        << std::setw(7) << fused.sites[op] << std::setw(14) << family(op) << '\n';
+    }
+
+    os << "quickened                        executions\n";
+    for (auto op = static_cast<code_unit>(opcode::Add32); op < opcode_count; ++op) {
+      auto name = name_of(static_cast<opcode>(op));
+      if (executions[op] == 0 || !(name.ends_with("32") || name.ends_with("64")))
+        continue;
+      os << std::left << std::setw(24) << name << std::right
+        << std::setw(21) << executions[op] << '\n';
+    }
+    return os;
+  }
+}
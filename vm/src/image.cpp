@@ -0,0 +1,312 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "thalia-vm/image.hpp"
+#include "thalia-vm/opcode.hpp"
+
+namespace thalia::vm {
+  namespace {
+    constexpr auto header_size = std::size_t { 48 };
+    constexpr auto section_size = std::size_t { 24 };
+    constexpr char magic[] = "\x7fTHB";
+
+    enum : std::uint32_t { Code = 1, Constants, Lines, Loops, Globals, Functions };
+
+    // The tables are used in place, so their layout must match the file.
+    static_assert(sizeof(line_entry) == 16 && sizeof(loop_entry) == 16);
+    static_assert(sizeof(function_entry) == 40);
+    static_assert(sizeof(code_unit) == 4);
+
+    auto checksum(std::span<std::uint8_t const> bytes)
+      -> std::uint64_t {
+      auto hash = std::uint64_t { 0xcbf29ce484222325 };
+      for (auto byte: bytes)
+        hash = (hash ^ byte) * 0x100000001b3;
+      return hash;
+    }
+
+    // A little-endian image being written.
+    class writer {
+      public:
+        std::vector<std::uint8_t> bytes;
+
+      public:
+        auto put(std::uint64_t value, std::size_t size) -> void {
+          for (auto i = std::size_t { 0 }; i < size; ++i)
+            bytes.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+        }
+
+        auto put(std::string_view data) -> void
+          { bytes.insert(bytes.end(), data.begin(), data.end()); }
+
+        auto align() -> std::uint64_t {
+          while (bytes.size() % 8 != 0)
+            bytes.push_back(0);
+          return bytes.size();
+        }
+
+        auto patch(std::size_t offset, std::uint64_t value, std::size_t size) -> void {
+          for (auto i = std::size_t { 0 }; i < size; ++i)
+            bytes[offset + i] = static_cast<std::uint8_t>(value >> (8 * i));
+        }
+    };
+
+    // A little-endian image being read; every read is bounds-checked.
+    class reader {
+      public:
+        reader(std::span<std::uint8_t const> bytes)
+          : _bytes { bytes } {}
+
+        auto get(std::size_t offset, std::size_t size) const
+          -> std::uint64_t {
+          if (offset > _bytes.size() || size > _bytes.size() - offset)
+            throw image_error { "Truncated image" };
+          auto value = std::uint64_t { 0 };
+          for (auto i = std::size_t { 0 }; i < size; ++i)
+            value |= std::uint64_t { _bytes[offset + i] } << (8 * i);
+          return value;
+        }
+
+        auto bytes() const -> std::span<std::uint8_t const>
+          { return _bytes; }
+
+      private:
+        std::span<std::uint8_t const> _bytes;
+    };
+
+    struct section {
+      std::uint32_t kind;
+      std::span<std::uint8_t const> bytes;
+    };
+
+    template <typename T>
+    auto table_of(std::span<std::uint8_t const> bytes)
+      -> std::span<T const> {
+      if (bytes.size() % sizeof(T) != 0)
+        throw image_error { "Malformed section" };
+      return { reinterpret_cast<T const*>(bytes.data()), bytes.size() / sizeof(T) };
+    }
+
+    auto globals_of(std::span<std::uint8_t const> bytes)
+      -> std::vector<global> {
+      auto in = reader { bytes };
+      auto count = in.get(0, 8);
+      auto result = std::vector<global> {};
+      auto offset = std::size_t { 8 };
+      for (auto i = std::uint64_t { 0 }; i < count; ++i) {
+        auto slot = in.get(offset, 8);
+        auto width = in.get(offset + 8, 8);
+        auto length = in.get(offset + 16, 8);
+        offset += 24;
+        if (length > bytes.size() - std::min(offset, bytes.size()))
+          throw image_error { "Truncated image" };
+        auto name = std::string { reinterpret_cast<char const*>(bytes.data() + offset), length };
+        result.push_back(global { std::move(name), slot, width });
+        offset = (offset + length + 7) / 8 * 8;
+      }
+      return result;
+    }
+  }
+
+  extern auto write_image(std::ostream& os, chunk const& program)
+    -> std::ostream& {
+    constexpr auto sections = std::size_t { 6 };
+    auto out = writer {};
+    out.put(magic);
+    out.put(image_version, 2);
+    out.put(opcode_count, 2);
+    out.put(0, 16); // checksum and size, patched last
+    out.put(program.slots, 8);
+    out.put(program.max_stack, 8);
+    out.put(sections, 4);
+    out.put(0, 4);
+    auto table = out.bytes.size();
+    out.put(0, sections * section_size);
+
+    auto add = [&](std::size_t index, std::uint32_t kind, auto&& body) {
+      auto begin = out.align();
+      body();
+      auto entry = table + index * section_size;
+      out.patch(entry, kind, 4);
+      out.patch(entry + 8, begin, 8);
+      out.patch(entry + 16, out.bytes.size() - begin, 8);
+    };
+    add(0, Code, [&] {
+      for (auto unit: program.code)
+        out.put(unit, sizeof(code_unit));
+    });
+    add(1, Constants, [&] {
+      for (auto value: program.constants)
+        out.put(static_cast<std::uint64_t>(value), 8);
+    });
+    add(2, Lines, [&] {
+      for (auto const& entry: program.lines) {
+        out.put(entry.offset, 8);
+        out.put(entry.line, 8);
+      }
+    });
+    add(3, Loops, [&] {
+      for (auto const& entry: program.loops) {
+        out.put(entry.exit, 8);
+        out.put(entry.line, 8);
+      }
+    });
+    add(4, Globals, [&] {
+      out.put(program.globals.size(), 8);
+      for (auto const& entry: program.globals) {
+        out.put(entry.slot, 8);
+        out.put(entry.width, 8);
+        out.put(entry.name.size(), 8);
+        out.put(entry.name);
+        out.align();
+      }
+    });
+    add(5, Functions, [&] {
+      for (auto const& entry: program.functions) {
+        out.put(entry.offset, 8);
+        out.put(entry.params, 8);
+        out.put(entry.slots, 8);
+        out.put(entry.max_stack, 8);
+        out.put(entry.line, 8);
+      }
+    });
+
+    out.patch(16, out.bytes.size(), 8);
+    out.patch(8, checksum(std::span { out.bytes }.subspan(16)), 8);
+    return os.write(reinterpret_cast<char const*>(out.bytes.data()),
+      static_cast<std::streamsize>(out.bytes.size()));
+  }
+
+#if defined(__unix__) || defined(__APPLE__)
+  mapped_image::mapped_image(std::filesystem::path const& path) {
+    auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      throw image_error { std::string { "Cannot open the image: " }.append(std::strerror(errno)) };
+    struct stat info {};
+    if (::fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(header_size)) {
+      ::close(fd);
+      throw image_error { "Truncated image" };
+    }
+    _size = static_cast<std::size_t>(info.st_size);
+    auto memory = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED)
+      throw image_error { std::string { "Cannot map the image: " }.append(std::strerror(errno)) };
+    _memory = memory;
+
+    try {
+      load({ static_cast<std::uint8_t const*>(_memory), _size });
+    } catch (...) {
+      ::munmap(_memory, _size);
+      throw;
+    }
+  }
+
+  mapped_image::~mapped_image()
+    { ::munmap(_memory, _size); }
+#else
+  // Without mmap the image is read into words, which keeps its tables as
+  // aligned as a mapping would.
+  mapped_image::mapped_image(std::filesystem::path const& path) {
+    auto file = std::ifstream { path, std::ios::binary | std::ios::ate };
+    if (!file)
+      throw image_error { "Cannot open the image" };
+    auto size = static_cast<std::size_t>(file.tellg());
+    if (size < header_size)
+      throw image_error { "Truncated image" };
+    _buffer.resize((size + 7) / 8);
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(_buffer.data()), static_cast<std::streamsize>(size)))
+      throw image_error { "Cannot read the image" };
+    _memory = _buffer.data();
+    _size = size;
+    load({ static_cast<std::uint8_t const*>(_memory), _size });
+  }
+
+  mapped_image::~mapped_image() = default;
+#endif
+
+  extern auto mapped_image::load(std::span<std::uint8_t const> bytes)
+    -> void {
+    if constexpr (std::endian::native != std::endian::little)
+      throw image_error { "Images can only be run on little-endian hosts" };
+
+    auto in = reader { bytes };
+    if (std::memcmp(bytes.data(), magic, 4) != 0)
+      throw image_error { "Not a Thalia bytecode image" };
+    if (in.get(4, 2) != image_version)
+      throw image_error { "Unsupported image version " + std::to_string(in.get(4, 2)) };
+    if (in.get(6, 2) != opcode_count)
+      throw image_error { "The image was compiled for another instruction set" };
+    if (in.get(16, 8) != bytes.size())
+      throw image_error { "Truncated image" };
+    if (in.get(8, 8) != checksum(bytes.subspan(16)))
+      throw image_error { "Checksum mismatch" };
+
+    auto count = in.get(40, 4);
+    auto sections = std::vector<section> {};
+    for (auto i = std::uint64_t { 0 }; i < count; ++i) {
+      auto entry = header_size + i * section_size;
+      auto offset = in.get(entry + 8, 8);
+      auto size = in.get(entry + 16, 8);
+      if (offset % 8 != 0 || offset > bytes.size() || size > bytes.size() - offset)
+        throw image_error { "Malformed section" };
+      sections.push_back(section {
+        static_cast<std::uint32_t>(in.get(entry, 4)), bytes.subspan(offset, size)
+      });
+    }
+    auto find = [&](std::uint32_t kind) {
+      auto found = std::find_if(sections.begin(), sections.end(),
+        [&](section const& entry) { return entry.kind == kind; });
+      if (found == sections.end())
+        throw image_error { "Missing section" };
+      return found->bytes;
+    };
+
+    _view.code = table_of<code_unit>(find(Code));
+    _view.constants = table_of<std::int64_t>(find(Constants));
+    _view.lines = table_of<line_entry>(find(Lines));
+    _view.loops = table_of<loop_entry>(find(Loops));
+    _view.functions = table_of<function_entry>(find(Functions));
+    _view.slots = in.get(24, 8);
+    _view.max_stack = in.get(32, 8);
+    if (_view.slots > call_stack_size || _view.max_stack > call_stack_size)
+      throw image_error { "Frame too large" };
+    _globals = globals_of(find(Globals));
+    for (auto const& entry: _globals) {
+      if (entry.slot >= _view.slots)
+        throw image_error { "Malformed section" };
+    }
+  }
+}
@@ -0,0 +1,522 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "thalia-vm/machine.hpp"
+#include "dispatch.hpp"
+
+namespace thalia::vm {
+  namespace {
+    // Rewrites a generic instruction into its form for a width, if it has one.
+    inline auto quicken(code_unit* pc, code_unit width, opcode narrow, opcode wide)
+      -> void {
+      if (width == 32)
+        *pc = static_cast<code_unit>(narrow);
+      else if (width == 64)
+        *pc = static_cast<code_unit>(wide);
+    }
+
+    inline auto add(std::int64_t lhs, std::int64_t rhs)
+      -> std::int64_t {
+      return static_cast<std::int64_t>(static_cast<std::uint64_t>(lhs) + static_cast<std::uint64_t>(rhs));
+    }
+
+    inline auto sub(std::int64_t lhs, std::int64_t rhs)
+      -> std::int64_t {
+      return static_cast<std::int64_t>(static_cast<std::uint64_t>(lhs) - static_cast<std::uint64_t>(rhs));
+    }
+
+    inline auto mul(std::int64_t lhs, std::int64_t rhs)
+      -> std::int64_t {
+      return static_cast<std::int64_t>(static_cast<std::uint64_t>(lhs) * static_cast<std::uint64_t>(rhs));
+    }
+
+    inline auto narrow(std::int64_t value)
+      -> std::int64_t {
+      return static_cast<std::int32_t>(static_cast<std::uint32_t>(value));
+    }
+  }
+
+#if THALIA_VM_THREADED
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+  template <bool Profile, bool Checked>
+  auto machine::execute()
+    -> outcome {
+    std::fill(_slots.begin(), _slots.end(), 0);
+    std::fill(_iterations.begin(), _iterations.end(), 0);
+    _calls.clear();
+    auto* code = _code.data();
+    auto const* constants = _program.constants.data();
+    auto* slots = _slots.data();
+    auto* sp = _stack.data();
+    auto* pc = code;
+    auto* executions = _executions.data();
+    auto* iterations = _iterations.data();
+    auto const threshold = _threshold;
+    auto running = _program;
+    running.code = _code;
+    auto const* functions = _program.functions.data();
+    auto* const end = _stack.data() + _stack.size();
+    // The operand stack of the frame running, and its function.
+    auto* base = _stack.data();
+    auto function = top_level;
+
+#if THALIA_VM_THREADED
+    static void* const labels[] = {
+#  define THALIA_VM_LABEL(name, operands) &&op_##name,
+      THALIA_VM_OPCODES(THALIA_VM_LABEL)
+#  undef THALIA_VM_LABEL
+    };
+#  define TARGET(name) op_##name:
+#  define DISPATCH() \
+    do { \
+      if constexpr (Checked) \
+        if (!admissible(running, function, static_cast<std::size_t>(pc - code), static_cast<std::size_t>(sp - base))) \
+          return outcome { status::Malformed, pc - code, 0 }; \
+      if constexpr (Profile) ++executions[*pc]; \
+      goto *labels[*pc]; \
+    } while (0)
+    DISPATCH();
+#else
+#  define TARGET(name) case opcode::name:
+#  define DISPATCH() continue
+    for (;;) {
+      if constexpr (Checked)
+        if (!admissible(running, function, static_cast<std::size_t>(pc - code), static_cast<std::size_t>(sp - base)))
+          return outcome { status::Malformed, pc - code, 0 };
+      if constexpr (Profile)
+        ++executions[*pc];
+      switch (static_cast<opcode>(*pc)) {
+#endif
+
+    TARGET(Const) {
+      *sp++ = constants[pc[1]];
+      pc += 2;
+      DISPATCH();
+    }
+    TARGET(Load) {
+      *sp++ = slots[pc[1]];
+      pc += 2;
+      DISPATCH();
+    }
+    TARGET(Store) {
+      slots[pc[1]] = *--sp;
+      pc += 2;
+      DISPATCH();
+    }
+    TARGET(Dup) {
+      *sp = sp[-1];
+      ++sp;
+      pc += 1;
+      DISPATCH();
+    }
+    TARGET(Pop) {
+      --sp;
+      pc += 1;
+      DISPATCH();
+    }
+    TARGET(Add) {
+      quicken(pc, pc[1], opcode::Add32, opcode::Add64);
+      --sp;
+      sp[-1] = wrap(add(sp[-1], *sp), pc[1]);
+      pc += 2;
+      DISPATCH();
+    }
+    TARGET(Sub) {
+      quicken(pc, pc[1], opcode::Sub32, opcode::Sub64);
+      --sp;
+      sp[-1] = wrap(sub(sp[-1], *sp), pc[1]);
+      pc += 2;
+      DISPATCH();
+    }
+    TARGET(Mul) {
+      quicken(pc, pc[1], opcode::Mul32, opcode::Mul64);
+      --sp;
+      sp[-1] = wrap(mul(sp[-1], *sp), pc[1]);
+      pc += 2;
+      DISPATCH();
+    }
+    TARGET(Div) {
+      auto rhs = *--sp;
+      if (rhs == 0)
+        return outcome { status::DivByZero, 0, _program.line_at(static_cast<std::size_t>(pc - code)) };
+      sp[-1] = rhs == -1
+        ? wrap(static_cast<std::int64_t>(0 - static_cast<std::uint64_t>(sp[-1])), pc[1])
+        : sp[-1] / rhs;
+      pc += 2;
+      DISPATCH();
+    }
+    TARGET(Mod) {
+      auto rhs = *--sp;
+      if (rhs == 0)
+        return outcome { status::DivByZero, 0, _program.line_at(static_cast<std::size_t>(pc - code)) };
+      sp[-1] = rhs == -1 ? 0 : sp[-1] % rhs;
+      pc += 2;
+      DISPATCH();
+    }
+    TARGET(Shl) {
+      --sp;
+      sp[-1] = wrap(static_cast<std::int64_t>(
+        static_cast<std::uint64_t>(sp[-1]) << shift_of(*sp, pc[1])
+      ), pc[1]);
+      pc += 2;
+      DISPATCH();
+    }
+    TARGET(Shr) {
+      --sp;
+      sp[-1] >>= shift_of(*sp, pc[1]);
+      pc += 2;
+      DISPATCH();
+    }
+    TARGET(BitAnd) {
+      --sp;
+      sp[-1] &= *sp;
+      pc += 1;
+      DISPATCH();
+    }
+    TARGET(BitOr) {
+      --sp;
+      sp[-1] |= *sp;
+      pc += 1;
+      DISPATCH();
+    }
+    TARGET(Xor) {
+      --sp;
+      sp[-1] ^= *sp;
+      pc += 1;
+      DISPATCH();
+    }
+    TARGET(Less) {
+      --sp;
+      sp[-1] = sp[-1] < *sp;
+      pc += 1;
+      DISPATCH();
+    }
+    TARGET(LessEqual) {
+      --sp;
+      sp[-1] = sp[-1] <= *sp;
+      pc += 1;
+      DISPATCH();
+    }
+    TARGET(Grt) {
+      --sp;
+      sp[-1] = sp[-1] > *sp;
+      pc += 1;
+      DISPATCH();
+    }
+    TARGET(GrtEqual) {
+      --sp;
+      sp[-1] = sp[-1] >= *sp;
+      pc += 1;
+      DISPATCH();
+    }
+    TARGET(Equal) {
+      --sp;
+      sp[-1] = sp[-1] == *sp;
+      pc += 1;
+      DISPATCH();
+    }
+    TARGET(NotEqual) {
+      --sp;
+      sp[-1] = sp[-1] != *sp;
+      pc += 1;
+      DISPATCH();
+    }
+    TARGET(Neg) {
+      sp[-1] = wrap(static_cast<std::int64_t>(0 - static_cast<std::uint64_t>(sp[-1])), pc[1]);
+      pc += 2;
+      DISPATCH();
+    }
+    TARGET(BitNot) {
+      sp[-1] = ~sp[-1];
+      pc += 1;
+      DISPATCH();
+    }
+    TARGET(LogNot) {
+      sp[-1] = !sp[-1];
+      pc += 1;
+      DISPATCH();
+    }
+    TARGET(Bool) {
+      sp[-1] = sp[-1] != 0;
+      pc += 1;
+      DISPATCH();
+    }
+    TARGET(Jump) {
+      pc = code + pc[1];
+      DISPATCH();
+    }
+    TARGET(JumpFalse) {
+      pc = *--sp == 0 ? code + pc[1] : pc + 2;
+      DISPATCH();
+    }
+    TARGET(JumpTrue) {
+      pc = *--sp != 0 ? code + pc[1] : pc + 2;
+      DISPATCH();
+    }
+    TARGET(AndJump) {
+      if (sp[-1] == 0) {
+        pc = code + pc[1];
+      } else {
+        --sp;
+        pc += 2;
+      }
+      DISPATCH();
+    }
+    TARGET(OrJump) {
+      if (sp[-1] != 0) {
+        sp[-1] = 1;
+        pc = code + pc[1];
+      } else {
+        --sp;
+        pc += 2;
+      }
+      DISPATCH();
+    }
+    TARGET(Loop) {
+      if (++iterations[pc[1]] >= threshold) {
+        if (auto result = _tier->enter(pc[1], _slots)) {
+          if (result->state != status::Halted)
+            return *result;
+          pc = code + _program.loops[pc[1]].exit;
+          DISPATCH();
+        }
+        iterations[pc[1]] = 0;
+      }
+      pc += 2;
+      DISPATCH();
+    }
+    TARGET(LoadElem) {
+      auto index = static_cast<std::uint64_t>(sp[-1]);
+      if (index >= pc[2])
+        return outcome { status::IndexOutOfRange, 0, _program.line_at(static_cast<std::size_t>(pc - code)) };
+      sp[-1] = slots[pc[1] + index];
+      pc += 3;
+      DISPATCH();
+    }
+    TARGET(StoreElem) {
+      auto index = static_cast<std::uint64_t>(sp[-2]);
+      if (index >= pc[2])
+        return outcome { status::IndexOutOfRange, 0, _program.line_at(static_cast<std::size_t>(pc - code)) };
+      slots[pc[1] + index] = sp[-1];
+      sp -= 2;
+      pc += 3;
+      DISPATCH();
+    }
+    TARGET(StoreElemKeep) {
+      auto index = static_cast<std::uint64_t>(sp[-2]);
+      if (index >= pc[2])
+        return outcome { status::IndexOutOfRange, 0, _program.line_at(static_cast<std::size_t>(pc - code)) };
+      slots[pc[1] + index] = sp[-1];
+      sp[-2] = sp[-1];
+      --sp;
+      pc += 3;
+      DISPATCH();
+    }
+    TARGET(ClearElems) {
+      std::fill_n(slots + pc[1], pc[2], 0);
+      pc += 3;
+      DISPATCH();
+    }
+    TARGET(Call) {
+      auto const& callee = functions[pc[1]];
+      auto* frame = sp - callee.params;
+      auto room = static_cast<std::size_t>(end - frame);
+      // A function with no slots still takes an activation.
+      if (callee.slots > room || callee.max_stack > room - callee.slots || _calls.size() == call_stack_size)
+        return outcome { status::StackOverflow, 0, _program.line_at(static_cast<std::size_t>(pc - code)) };
+      std::fill(frame + callee.params, frame + callee.slots, 0);
+      _calls.push_back(activation { pc + 2, slots, base, function });
+      function = pc[1];
+      slots = frame;
+      base = frame + callee.slots;
+      sp = base;
+      pc = code + callee.offset;
+      DISPATCH();
+    }
+    TARGET(Return) {
+      if (_calls.empty())
+        return outcome { status::Returned, sp[-1], 0 };
+      auto value = sp[-1];
+      auto const& caller = _calls.back();
+      sp = slots;
+      *sp++ = value;
+      pc = caller.pc;
+      slots = caller.slots;
+      base = caller.base;
+      function = caller.function;
+      _calls.pop_back();
+      DISPATCH();
+    }
+    TARGET(TailCall) {
+      // The arguments move down over the frame, which the callee takes over.
+      auto const& callee = functions[pc[1]];
+      auto room = static_cast<std::size_t>(end - slots);
+      if (callee.slots > room || callee.max_stack > room - callee.slots)
+        return outcome { status::StackOverflow, 0, _program.line_at(static_cast<std::size_t>(pc - code)) };
+      std::copy(sp - callee.params, sp, slots);
+      std::fill(slots + callee.params, slots + callee.slots, 0);
+      function = pc[1];
+      base = slots + callee.slots;
+      sp = base;
+      pc = code + callee.offset;
+      DISPATCH();
+    }
+    TARGET(Halt) {
+      return outcome { status::Halted, 0, 0 };
+    }
+    TARGET(Add32) {
+      --sp;
+      sp[-1] = narrow(add(sp[-1], *sp));
+      pc += 2;
+      DISPATCH();
+    }
+    TARGET(Add64) {
+      --sp;
+      sp[-1] = add(sp[-1], *sp);
+      pc += 2;
+      DISPATCH();
+    }
+    TARGET(Sub32) {
+      --sp;
+      sp[-1] = narrow(sub(sp[-1], *sp));
+      pc += 2;
+      DISPATCH();
+    }
+    TARGET(Sub64) {
+      --sp;
+      sp[-1] = sub(sp[-1], *sp);
+      pc += 2;
+      DISPATCH();
+    }
+    TARGET(Mul32) {
+      --sp;
+      sp[-1] = narrow(mul(sp[-1], *sp));
+      pc += 2;
+      DISPATCH();
+    }
+    TARGET(Mul64) {
+      --sp;
+      sp[-1] = mul(sp[-1], *sp);
+      pc += 2;
+      DISPATCH();
+    }
+    TARGET(AddLocal) {
+      quicken(pc, pc[3], opcode::AddLocal32, opcode::AddLocal64);
+      slots[pc[1]] = wrap(add(slots[pc[1]], slots[pc[2]]), pc[3]);
+      pc += 4;
+      DISPATCH();
+    }
+    TARGET(SubLocal) {
+      quicken(pc, pc[3], opcode::SubLocal32, opcode::SubLocal64);
+      slots[pc[1]] = wrap(sub(slots[pc[1]], slots[pc[2]]), pc[3]);
+      pc += 4;
+      DISPATCH();
+    }
+    TARGET(AddConst) {
+      quicken(pc, pc[3], opcode::AddConst32, opcode::AddConst64);
+      slots[pc[1]] = wrap(add(slots[pc[1]], constants[pc[2]]), pc[3]);
+      pc += 4;
+      DISPATCH();
+    }
+    TARGET(SubConst) {
+      quicken(pc, pc[3], opcode::SubConst32, opcode::SubConst64);
+      slots[pc[1]] = wrap(sub(slots[pc[1]], constants[pc[2]]), pc[3]);
+      pc += 4;
+      DISPATCH();
+    }
+    TARGET(AddLocal32) {
+      slots[pc[1]] = narrow(add(slots[pc[1]], slots[pc[2]]));
+      pc += 4;
+      DISPATCH();
+    }
+    TARGET(AddLocal64) {
+      slots[pc[1]] = add(slots[pc[1]], slots[pc[2]]);
+      pc += 4;
+      DISPATCH();
+    }
+    TARGET(SubLocal32) {
+      slots[pc[1]] = narrow(sub(slots[pc[1]], slots[pc[2]]));
+      pc += 4;
+      DISPATCH();
+    }
+    TARGET(SubLocal64) {
+      slots[pc[1]] = sub(slots[pc[1]], slots[pc[2]]);
+      pc += 4;
+      DISPATCH();
+    }
+    TARGET(AddConst32) {
+      slots[pc[1]] = narrow(add(slots[pc[1]], constants[pc[2]]));
+      pc += 4;
+      DISPATCH();
+    }
+    TARGET(AddConst64) {
+      slots[pc[1]] = add(slots[pc[1]], constants[pc[2]]);
+      pc += 4;
+      DISPATCH();
+    }
+    TARGET(SubConst32) {
+      slots[pc[1]] = narrow(sub(slots[pc[1]], constants[pc[2]]));
+      pc += 4;
+      DISPATCH();
+    }
+    TARGET(SubConst64) {
+      slots[pc[1]] = sub(slots[pc[1]], constants[pc[2]]);
+      pc += 4;
+      DISPATCH();
+    }
+#define THALIA_VM_BRANCH(name, operation, rhs) \
+    TARGET(name) { \
+      pc = slots[pc[1]] operation rhs[pc[2]] ? code + pc[3] : pc + 4; \
+      DISPATCH(); \
+    }
+    THALIA_VM_BRANCH(JumpLessLocal, <, slots)
+    THALIA_VM_BRANCH(JumpLessEqualLocal, <=, slots)
+    THALIA_VM_BRANCH(JumpGrtLocal, >, slots)
+    THALIA_VM_BRANCH(JumpGrtEqualLocal, >=, slots)
+    THALIA_VM_BRANCH(JumpEqualLocal, ==, slots)
+    THALIA_VM_BRANCH(JumpNotEqualLocal, !=, slots)
+    THALIA_VM_BRANCH(JumpLessConst, <, constants)
+    THALIA_VM_BRANCH(JumpLessEqualConst, <=, constants)
+    THALIA_VM_BRANCH(JumpGrtConst, >, constants)
+    THALIA_VM_BRANCH(JumpGrtEqualConst, >=, constants)
+    THALIA_VM_BRANCH(JumpEqualConst, ==, constants)
+    THALIA_VM_BRANCH(JumpNotEqualConst, !=, constants)
+#undef THALIA_VM_BRANCH
+
+#if !THALIA_VM_THREADED
+      }
+    }
+#endif
+#undef TARGET
+#undef DISPATCH
+  }
+
+  template auto machine::execute<false, false>() -> outcome;
+  template auto machine::execute<true, false>() -> outcome;
+  template auto machine::execute<false, true>() -> outcome;
+  template auto machine::execute<true, true>() -> outcome;
+
+#if THALIA_VM_THREADED
+#  pragma GCC diagnostic pop
+#endif
+}
@@ -0,0 +1,71 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "thalia-vm/opcode.hpp"
+
+namespace thalia::vm {
+  extern auto operand_count(opcode op)
+    -> std::size_t {
+    static constexpr std::size_t counts[] = {
+#define THALIA_VM_OPERANDS(name, operands) operands,
+      THALIA_VM_OPCODES(THALIA_VM_OPERANDS)
+#undef THALIA_VM_OPERANDS
+    };
+    return counts[static_cast<code_unit>(op)];
+  }
+
+  extern auto name_of(opcode op)
+    -> std::string_view {
+    static constexpr std::string_view names[] = {
+#define THALIA_VM_NAME(name, operands) #name,
+      THALIA_VM_OPCODES(THALIA_VM_NAME)
+#undef THALIA_VM_NAME
+    };
+    return names[static_cast<code_unit>(op)];
+  }
+
+  extern auto operand_count(reg_opcode op)
+    -> std::size_t {
+    static constexpr std::size_t counts[] = {
+#define THALIA_VM_REG_OPERANDS(name, operands, registers) operands,
+      THALIA_VM_REG_OPCODES(THALIA_VM_REG_OPERANDS)
+#undef THALIA_VM_REG_OPERANDS
+    };
+    return counts[static_cast<code_unit>(op)];
+  }
+
+  extern auto register_count(reg_opcode op)
+    -> std::size_t {
+    static constexpr std::size_t counts[] = {
+#define THALIA_VM_REG_REGISTERS(name, operands, registers) registers,
+      THALIA_VM_REG_OPCODES(THALIA_VM_REG_REGISTERS)
+#undef THALIA_VM_REG_REGISTERS
+    };
+    return counts[static_cast<code_unit>(op)];
+  }
+
+  extern auto name_of(reg_opcode op)
+    -> std::string_view {
+    static constexpr std::string_view names[] = {
+#define THALIA_VM_REG_NAME(name, operands, registers) #name,
+      THALIA_VM_REG_OPCODES(THALIA_VM_REG_NAME)
+#undef THALIA_VM_REG_NAME
+    };
+    return names[static_cast<code_unit>(op)];
+  }
+}
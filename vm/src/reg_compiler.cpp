@@ -0,0 +1,682 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <initializer_list>
+#include <numeric>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <thalia-sema/arith.hpp>
+#include <thalia-sema/tail_calls.hpp>
+
+#include "thalia-vm/compiler.hpp"
+#include "thalia-vm/reg_compiler.hpp"
+
+namespace thalia::vm {
+  namespace {
+    // Operands are frame slots until the temporaries are allocated; the top
+    // bits mark virtual temporaries, entries of the constant pool and the
+    // arguments of a call, which follow the frame.
+    constexpr auto temp_flag = code_unit { 1 } << 31;
+    constexpr auto const_flag = code_unit { 1 } << 30;
+    constexpr auto arg_flag = code_unit { 1 } << 29;
+    constexpr auto no_register = ~code_unit { 0 };
+
+    struct instruction {
+      reg_opcode op;
+      std::array<code_unit, 4> operands;
+    };
+
+    struct context {
+      sema::type_table const& types;
+      sema::resolution const& names;
+      sema::typing const& typing;
+      sema::constants const& values;
+      frame_layout const& frame;
+      std::vector<std::int64_t>& constants;
+      std::vector<instruction> code;
+      std::vector<line_entry> lines;
+      std::unordered_map<std::int64_t, code_unit> pool;
+      code_unit temps;
+      /** The function being compiled, or `npos` at the top level. */
+      std::size_t function;
+    };
+
+    auto emit(context& ctx, reg_opcode op, std::initializer_list<code_unit> operands = {})
+      -> std::size_t {
+      auto index = ctx.code.size();
+      auto& added = ctx.code.emplace_back(instruction { op, {} });
+      std::copy(operands.begin(), operands.end(), added.operands.begin());
+      return index;
+    }
+
+    auto here(context& ctx)
+      -> code_unit {
+      return static_cast<code_unit>(ctx.code.size());
+    }
+
+    auto patch(context& ctx, std::size_t jump, code_unit target)
+      -> void {
+      auto& added = ctx.code[jump];
+      added.operands[operand_count(added.op) - 1] = target;
+    }
+
+    auto temp(context& ctx)
+      -> code_unit {
+      return temp_flag | ctx.temps++;
+    }
+
+    auto constant(context& ctx, std::int64_t value)
+      -> code_unit {
+      auto [found, inserted] = ctx.pool.try_emplace(
+        value, static_cast<code_unit>(ctx.constants.size())
+      );
+      if (inserted)
+        ctx.constants.push_back(value);
+      return const_flag | found->second;
+    }
+
+    auto is_slot(code_unit operand)
+      -> bool {
+      return (operand & (temp_flag | const_flag | arg_flag)) == 0;
+    }
+
+    // The register of a variable in the frame being compiled.
+    auto slot_of(context& ctx, std::size_t slot)
+      -> code_unit {
+      return static_cast<code_unit>(slot - ctx.frame.base);
+    }
+
+    auto width_of(context& ctx, std::shared_ptr<syntax::expression> const& node)
+      -> code_unit {
+      return static_cast<code_unit>(ctx.types.get(ctx.typing.type_of(*node)).width);
+    }
+
+    auto unwrap(std::shared_ptr<syntax::expression> node)
+      -> std::shared_ptr<syntax::expression> {
+      while (node && node->is(syntax::expr_type::Paren))
+        node = std::static_pointer_cast<syntax::expr_paren>(node)->value();
+      return node;
+    }
+
+    // Whether evaluating an expression may change a variable.
+    auto writes(std::shared_ptr<syntax::expression> const& node)
+      -> bool {
+      if (!node)
+        return false;
+      switch (node->type()) {
+        case syntax::expr_type::Assign:
+          return true;
+        case syntax::expr_type::Binary: {
+          auto root = std::static_pointer_cast<syntax::expr_binary>(node);
+          return writes(root->lhs()) || writes(root->rhs());
+        }
+        case syntax::expr_type::Unary:
+          return writes(std::static_pointer_cast<syntax::expr_unary>(node)->value());
+        case syntax::expr_type::Paren:
+          return writes(std::static_pointer_cast<syntax::expr_paren>(node)->value());
+        case syntax::expr_type::Index:
+          return writes(std::static_pointer_cast<syntax::expr_index>(node)->index());
+        case syntax::expr_type::Call: {
+          // A function only sees its own variables, so only its arguments
+          // can write those of the caller.
+          auto args = std::static_pointer_cast<syntax::expr_call>(node)->args();
+          return std::any_of(args.begin(), args.end(),
+            [](auto const& arg) { return writes(arg); });
+        }
+        default:
+          return false;
+      }
+    }
+
+    auto emit_binary(
+      context& ctx,
+      syntax::token const& operation,
+      syntax::token_type type,
+      std::array<code_unit, 3> registers,
+      code_unit width
+    ) -> void {
+      auto [dst, lhs, rhs] = registers;
+      switch (type) {
+        case syntax::token_type::Plus: emit(ctx, reg_opcode::Add, { dst, lhs, rhs, width }); break;
+        case syntax::token_type::Minus: emit(ctx, reg_opcode::Sub, { dst, lhs, rhs, width }); break;
+        case syntax::token_type::Mul: emit(ctx, reg_opcode::Mul, { dst, lhs, rhs, width }); break;
+        case syntax::token_type::Div:
+        case syntax::token_type::Mod:
+          ctx.lines.push_back(line_entry { here(ctx), operation.line() });
+          emit(ctx, type == syntax::token_type::Div ? reg_opcode::Div : reg_opcode::Mod,
+            { dst, lhs, rhs, width });
+          break;
+        case syntax::token_type::LShift: emit(ctx, reg_opcode::Shl, { dst, lhs, rhs, width }); break;
+        case syntax::token_type::RShift: emit(ctx, reg_opcode::Shr, { dst, lhs, rhs, width }); break;
+        case syntax::token_type::BitAnd: emit(ctx, reg_opcode::BitAnd, { dst, lhs, rhs }); break;
+        case syntax::token_type::BitOr: emit(ctx, reg_opcode::BitOr, { dst, lhs, rhs }); break;
+        case syntax::token_type::Xor: emit(ctx, reg_opcode::Xor, { dst, lhs, rhs }); break;
+        case syntax::token_type::Less: emit(ctx, reg_opcode::Less, { dst, lhs, rhs }); break;
+        case syntax::token_type::LessEqual: emit(ctx, reg_opcode::LessEqual, { dst, lhs, rhs }); break;
+        case syntax::token_type::Grt: emit(ctx, reg_opcode::Grt, { dst, lhs, rhs }); break;
+        case syntax::token_type::GrtEqual: emit(ctx, reg_opcode::GrtEqual, { dst, lhs, rhs }); break;
+        case syntax::token_type::Equal: emit(ctx, reg_opcode::Equal, { dst, lhs, rhs }); break;
+        default: emit(ctx, reg_opcode::NotEqual, { dst, lhs, rhs }); break;
+      }
+    }
+
+    // The first slot and the length of the array an index reads.
+    auto array_of(context& ctx, syntax::expr_index const& node)
+      -> std::pair<code_unit, code_unit> {
+      auto target = std::static_pointer_cast<syntax::expr_id>(unwrap(node.target()));
+      auto slot = ctx.names.slot(*target);
+      return {
+        static_cast<code_unit>(ctx.frame.elements[slot]),
+        static_cast<code_unit>(ctx.types.get(ctx.typing.slot_type(slot)).length)
+      };
+    }
+
+    class expr_compiler
+      : public syntax::expr_visitor<context&, code_unit> {
+      public:
+        expr_compiler(
+          std::shared_ptr<syntax::expression> const& node,
+          code_unit into = no_register
+        ) : syntax::expr_visitor<context&, code_unit> { node }
+          , _into { into } {}
+
+        auto compile(context& ctx) -> code_unit;
+
+      protected:
+        auto visit_expr_assign(context& ctx) -> code_unit override;
+        auto visit_expr_binary(context& ctx) -> code_unit override;
+        auto visit_expr_unary(context& ctx) -> code_unit override;
+        auto visit_expr_paren(context& ctx) -> code_unit override;
+        auto visit_expr_base_lit(context& ctx) -> code_unit override;
+        auto visit_expr_id(context& ctx) -> code_unit override;
+        auto visit_expr_index(context& ctx) -> code_unit override;
+        auto visit_expr_call(context& ctx) -> code_unit override;
+        auto visit_expr_data_type(context& ctx) -> code_unit override
+          { return constant(ctx, 0); }
+        auto visit_expr_array_type(context& ctx) -> code_unit override
+          { return constant(ctx, 0); }
+
+      private:
+        auto compile_logical(context& ctx, reg_opcode jump) -> code_unit;
+        auto compile_element_assign(context& ctx) -> code_unit;
+        auto place(context& ctx, code_unit source) -> code_unit;
+        auto target(context& ctx) -> code_unit;
+
+      private:
+        code_unit _into;
+    };
+
+    class stmt_compiler
+      : public syntax::stmt_visitor<context&, void> {
+      public:
+        stmt_compiler(std::shared_ptr<syntax::statement> const& node)
+          : syntax::stmt_visitor<context&, void> { node } {}
+
+        auto compile(context& ctx) -> void
+          { if (_node) visit_stmt(ctx); }
+
+      protected:
+        auto visit_stmt_block(context& ctx) -> void override;
+        auto visit_stmt_return(context& ctx) -> void override;
+        auto visit_stmt_expr(context& ctx) -> void override;
+        auto visit_stmt_if(context& ctx) -> void override;
+        auto visit_stmt_while(context& ctx) -> void override;
+        auto visit_stmt_local(context& ctx) -> void override;
+        auto visit_stmt_function(context&) -> void override {}
+    };
+
+    extern auto expr_compiler::compile(context& ctx)
+      -> code_unit {
+      if (!_node)
+        return place(ctx, constant(ctx, 0));
+      auto folded = ctx.values.value(*_node);
+      if (folded)
+        return place(ctx, constant(ctx, *folded));
+      return visit_expr(ctx);
+    }
+
+    // Moves a result into the requested register, if there is one.
+    extern auto expr_compiler::place(context& ctx, code_unit source)
+      -> code_unit {
+      if (_into == no_register || _into == source)
+        return source;
+      emit(ctx, reg_opcode::Move, { _into, source });
+      return _into;
+    }
+
+    // The register an operation writes its result to. Operands are read
+    // before the result is written, so the requested register is safe even
+    // when it is also an operand.
+    extern auto expr_compiler::target(context& ctx)
+      -> code_unit {
+      return _into == no_register ? temp(ctx) : _into;
+    }
+
+    extern auto expr_compiler::visit_expr_assign(context& ctx)
+      -> code_unit {
+      auto root = std::static_pointer_cast<syntax::expr_assign>(_node);
+      if (unwrap(root->target())->is(syntax::expr_type::Index))
+        return compile_element_assign(ctx);
+      auto variable = std::static_pointer_cast<syntax::expr_id>(unwrap(root->target()));
+      auto slot = slot_of(ctx, ctx.names.slot(*variable));
+
+      auto operation = sema::binary_of(root->operation().type());
+      if (operation == syntax::token_type::Assign) {
+        expr_compiler { root->value(), slot }.compile(ctx);
+        return place(ctx, slot);
+      }
+
+      // The old value is read before the right-hand side runs.
+      auto lhs = slot;
+      if (writes(root->value())) {
+        lhs = temp(ctx);
+        emit(ctx, reg_opcode::Move, { lhs, slot });
+      }
+      auto rhs = expr_compiler { root->value() }.compile(ctx);
+      emit_binary(ctx, root->operation(), operation, { slot, lhs, rhs }, width_of(ctx, variable));
+      return place(ctx, slot);
+    }
+
+    // The index is evaluated first and checked when the element is accessed:
+    // after the value for a plain assignment, before it for an update. A
+    // variable index is copied if the value may assign it.
+    extern auto expr_compiler::compile_element_assign(context& ctx)
+      -> code_unit {
+      auto root = std::static_pointer_cast<syntax::expr_assign>(_node);
+      auto target = std::static_pointer_cast<syntax::expr_index>(unwrap(root->target()));
+      auto [base, length] = array_of(ctx, *target);
+      auto line = target->bracket().line();
+
+      auto index = expr_compiler { target->index() }.compile(ctx);
+      if (is_slot(index) && writes(root->value())) {
+        auto copy = temp(ctx);
+        emit(ctx, reg_opcode::Move, { copy, index });
+        index = copy;
+      }
+
+      auto operation = sema::binary_of(root->operation().type());
+      auto value = code_unit { 0 };
+      if (operation == syntax::token_type::Assign) {
+        value = expr_compiler { root->value() }.compile(ctx);
+      } else {
+        value = temp(ctx);
+        ctx.lines.push_back(line_entry { here(ctx), line });
+        emit(ctx, reg_opcode::LoadElem, { value, index, base, length });
+        auto rhs = expr_compiler { root->value() }.compile(ctx);
+        emit_binary(ctx, root->operation(), operation, { value, value, rhs }, width_of(ctx, target));
+      }
+      ctx.lines.push_back(line_entry { here(ctx), line });
+      emit(ctx, reg_opcode::StoreElem, { value, index, base, length });
+      return place(ctx, value);
+    }
+
+    extern auto expr_compiler::compile_logical(context& ctx, reg_opcode jump)
+      -> code_unit {
+      // The result is written before the right-hand side runs, so it never
+      // goes straight to a variable the right-hand side may read.
+      auto root = std::static_pointer_cast<syntax::expr_binary>(_node);
+      auto result = temp(ctx);
+      auto lhs = expr_compiler { root->lhs() }.compile(ctx);
+      emit(ctx, reg_opcode::Bool, { result, lhs });
+      auto skip = emit(ctx, jump, { result, 0 });
+      auto rhs = expr_compiler { root->rhs() }.compile(ctx);
+      emit(ctx, reg_opcode::Bool, { result, rhs });
+      patch(ctx, skip, here(ctx));
+      return place(ctx, result);
+    }
+
+    extern auto expr_compiler::visit_expr_binary(context& ctx)
+      -> code_unit {
+      auto root = std::static_pointer_cast<syntax::expr_binary>(_node);
+      auto operation = root->operation();
+      if (operation.is(syntax::token_type::LogAnd))
+        return compile_logical(ctx, reg_opcode::JumpFalse);
+      if (operation.is(syntax::token_type::LogOr))
+        return compile_logical(ctx, reg_opcode::JumpTrue);
+
+      // A variable operand is read when the instruction runs, so it is copied
+      // first if the right-hand side may assign it.
+      auto lhs = expr_compiler { root->lhs() }.compile(ctx);
+      if (is_slot(lhs) && writes(root->rhs())) {
+        auto copy = temp(ctx);
+        emit(ctx, reg_opcode::Move, { copy, lhs });
+        lhs = copy;
+      }
+      auto rhs = expr_compiler { root->rhs() }.compile(ctx);
+      auto result = target(ctx);
+      emit_binary(ctx, operation, operation.type(), { result, lhs, rhs }, width_of(ctx, root->lhs()));
+      return result;
+    }
+
+    extern auto expr_compiler::visit_expr_unary(context& ctx)
+      -> code_unit {
+      auto root = std::static_pointer_cast<syntax::expr_unary>(_node);
+      auto type = root->operation().type();
+      if (type == syntax::token_type::Plus)
+        return expr_compiler { root->value(), _into }.compile(ctx);
+
+      auto value = expr_compiler { root->value() }.compile(ctx);
+      auto result = target(ctx);
+      switch (type) {
+        case syntax::token_type::Minus:
+          emit(ctx, reg_opcode::Neg, { result, value, width_of(ctx, _node) });
+          break;
+        case syntax::token_type::BitNot:
+          emit(ctx, reg_opcode::BitNot, { result, value });
+          break;
+        default:
+          emit(ctx, reg_opcode::LogNot, { result, value });
+          break;
+      }
+      return result;
+    }
+
+    extern auto expr_compiler::visit_expr_paren(context& ctx)
+      -> code_unit {
+      auto root = std::static_pointer_cast<syntax::expr_paren>(_node);
+      return expr_compiler { root->value(), _into }.compile(ctx);
+    }
+
+    extern auto expr_compiler::visit_expr_base_lit(context& ctx)
+      -> code_unit {
+      // Checked literals are always folded already.
+      auto root = std::static_pointer_cast<syntax::expr_base_lit>(_node);
+      auto value = sema::parse_literal(root->target().value(), width_of(ctx, _node)).value;
+      return place(ctx, constant(ctx, value));
+    }
+
+    extern auto expr_compiler::visit_expr_id(context& ctx)
+      -> code_unit {
+      auto root = std::static_pointer_cast<syntax::expr_id>(_node);
+      return place(ctx, slot_of(ctx, ctx.names.slot(*root)));
+    }
+
+    extern auto expr_compiler::visit_expr_index(context& ctx)
+      -> code_unit {
+      auto root = std::static_pointer_cast<syntax::expr_index>(_node);
+      auto [base, length] = array_of(ctx, *root);
+      auto index = expr_compiler { root->index() }.compile(ctx);
+      auto result = target(ctx);
+      ctx.lines.push_back(line_entry { here(ctx), root->bracket().line() });
+      emit(ctx, reg_opcode::LoadElem, { result, index, base, length });
+      return result;
+    }
+
+    // The arguments are all evaluated before any of them is moved after the
+    // frame, where a call among them would build its own frame. A variable
+    // argument is copied first if a later one may assign it.
+    auto pass_args(context& ctx, syntax::expr_call const& node)
+      -> void {
+      auto args = node.args();
+      auto values = std::vector<code_unit> {};
+      for (auto i = std::size_t { 0 }; i < args.size(); ++i) {
+        auto value = expr_compiler { args[i] }.compile(ctx);
+        auto later = args.subspan(i + 1);
+        if (is_slot(value) && std::any_of(later.begin(), later.end(),
+            [](auto const& arg) { return writes(arg); })) {
+          auto copy = temp(ctx);
+          emit(ctx, reg_opcode::Move, { copy, value });
+          value = copy;
+        }
+        values.push_back(value);
+      }
+      for (auto i = std::size_t { 0 }; i < values.size(); ++i)
+        emit(ctx, reg_opcode::Move, { arg_flag | static_cast<code_unit>(i), values[i] });
+    }
+
+    extern auto expr_compiler::visit_expr_call(context& ctx)
+      -> code_unit {
+      auto root = std::static_pointer_cast<syntax::expr_call>(_node);
+      pass_args(ctx, *root);
+      auto result = target(ctx);
+      ctx.lines.push_back(line_entry { here(ctx), root->callee().line() });
+      emit(ctx, reg_opcode::Call, { result, static_cast<code_unit>(ctx.names.callee(*root)) });
+      return result;
+    }
+
+    extern auto stmt_compiler::visit_stmt_block(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_block>(_node);
+      for (auto const& node: root->content())
+        stmt_compiler { node }.compile(ctx);
+    }
+
+    extern auto stmt_compiler::visit_stmt_return(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_return>(_node);
+      auto tail = sema::tail_call_of(*root);
+      if (tail && ctx.function != sema::resolution::npos) {
+        // The callee runs in the frame of the function and returns for it.
+        pass_args(ctx, *tail);
+        ctx.lines.push_back(line_entry { here(ctx), tail->callee().line() });
+        emit(ctx, reg_opcode::TailCall, { static_cast<code_unit>(ctx.names.callee(*tail)) });
+        return;
+      }
+      auto value = expr_compiler { root->value() }.compile(ctx);
+      emit(ctx, reg_opcode::Return, { value });
+    }
+
+    extern auto stmt_compiler::visit_stmt_expr(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_expr>(_node);
+      expr_compiler { root->value() }.compile(ctx);
+    }
+
+    extern auto stmt_compiler::visit_stmt_if(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_if>(_node);
+      auto folded = ctx.values.value(*root->condition());
+      if (folded) {
+        stmt_compiler { *folded ? root->main_body() : root->else_body() }.compile(ctx);
+        return;
+      }
+
+      auto condition = expr_compiler { root->condition() }.compile(ctx);
+      auto to_else = emit(ctx, reg_opcode::JumpFalse, { condition, 0 });
+      stmt_compiler { root->main_body() }.compile(ctx);
+      if (!root->else_body()) {
+        patch(ctx, to_else, here(ctx));
+        return;
+      }
+
+      auto to_end = emit(ctx, reg_opcode::Jump, { 0 });
+      patch(ctx, to_else, here(ctx));
+      stmt_compiler { root->else_body() }.compile(ctx);
+      patch(ctx, to_end, here(ctx));
+    }
+
+    extern auto stmt_compiler::visit_stmt_while(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_while>(_node);
+      auto folded = ctx.values.value(*root->condition());
+      if (folded && !*folded)
+        return;
+
+      if (folded) {
+        auto body = here(ctx);
+        stmt_compiler { root->body() }.compile(ctx);
+        emit(ctx, reg_opcode::Jump, { body });
+        return;
+      }
+
+      auto to_test = emit(ctx, reg_opcode::Jump, { 0 });
+      auto body = here(ctx);
+      stmt_compiler { root->body() }.compile(ctx);
+      patch(ctx, to_test, here(ctx));
+      auto condition = expr_compiler { root->condition() }.compile(ctx);
+      emit(ctx, reg_opcode::JumpTrue, { condition, body });
+    }
+
+    extern auto stmt_compiler::visit_stmt_local(context& ctx)
+      -> void {
+      auto root = std::static_pointer_cast<syntax::stmt_local>(_node);
+      for (auto const& variable: root->content()) {
+        auto slot = ctx.names.slot(variable);
+        auto const& declared = ctx.types.get(ctx.typing.slot_type(slot));
+        if (declared.kind == sema::type_kind::Array) {
+          emit(ctx, reg_opcode::ClearElems, {
+            static_cast<code_unit>(ctx.frame.elements[slot]),
+            static_cast<code_unit>(declared.length)
+          });
+          continue;
+        }
+        expr_compiler { variable.value, slot_of(ctx, slot) }.compile(ctx);
+      }
+    }
+
+    // Assigns a frame register to every temporary. Temporaries never live
+    // across statements, so no live range spans a back edge and the range
+    // from the first to the last mention of a temporary, in instruction
+    // order, covers every point where it is live. Ranges are visited by
+    // increasing start; a register is reused as soon as the range holding it
+    // ends, even by a result of the instruction that reads it last.
+    auto allocate(context& ctx)
+      -> std::pair<std::vector<code_unit>, code_unit> {
+      constexpr auto unused = ~std::size_t { 0 };
+      auto first = std::vector<std::size_t>(ctx.temps, unused);
+      auto last = std::vector<std::size_t>(ctx.temps, 0);
+      for (auto index = std::size_t { 0 }; index < ctx.code.size(); ++index) {
+        auto const& current = ctx.code[index];
+        for (auto i = std::size_t { 0 }; i < register_count(current.op); ++i) {
+          auto operand = current.operands[i];
+          if (!(operand & temp_flag))
+            continue;
+          auto id = operand & ~temp_flag;
+          first[id] = std::min(first[id], index);
+          last[id] = index;
+        }
+      }
+
+      auto order = std::vector<code_unit>(ctx.temps);
+      std::iota(order.begin(), order.end(), code_unit { 0 });
+      std::stable_sort(order.begin(), order.end(),
+        [&](code_unit lhs, code_unit rhs) { return first[lhs] < first[rhs]; });
+
+      using range_end = std::pair<std::size_t, code_unit>;
+      auto active = std::priority_queue<range_end, std::vector<range_end>, std::greater<>> {};
+      auto released = std::vector<code_unit> {};
+      auto assigned = std::vector<code_unit>(ctx.temps, 0);
+      auto used = code_unit { 0 };
+      for (auto id: order) {
+        if (first[id] == unused)
+          continue;
+        while (!active.empty() && active.top().first <= first[id]) {
+          released.push_back(active.top().second);
+          active.pop();
+        }
+        if (released.empty()) {
+          assigned[id] = used++;
+        } else {
+          assigned[id] = released.back();
+          released.pop_back();
+        }
+        active.emplace(last[id], assigned[id]);
+      }
+      return { std::move(assigned), used };
+    }
+
+    auto is_jump(reg_opcode op)
+      -> bool {
+      return op == reg_opcode::Jump
+        || op == reg_opcode::JumpFalse
+        || op == reg_opcode::JumpTrue;
+    }
+
+    // Appends the code of a context to a chunk, with its temporaries
+    // allocated after the slots and constants of a frame; returns the number
+    // of registers of the frame.
+    auto encode(context& ctx, std::size_t slots, reg_chunk& out)
+      -> std::size_t {
+      auto [assigned, temps] = allocate(ctx);
+      auto constants = static_cast<code_unit>(slots);
+      auto base = static_cast<code_unit>(slots + ctx.constants.size());
+      auto registers = base + temps;
+
+      auto start = static_cast<code_unit>(out.code.size());
+      auto offsets = std::vector<code_unit> {};
+      offsets.reserve(ctx.code.size() + 1);
+      auto offset = start;
+      for (auto const& current: ctx.code) {
+        offsets.push_back(offset);
+        offset += static_cast<code_unit>(1 + operand_count(current.op));
+      }
+      offsets.push_back(offset);
+
+      out.code.reserve(offset);
+      for (auto const& current: ctx.code) {
+        out.code.push_back(static_cast<code_unit>(current.op));
+        auto operands = operand_count(current.op);
+        for (auto i = std::size_t { 0 }; i < operands; ++i) {
+          auto operand = current.operands[i];
+          if (i < register_count(current.op)) {
+            if (operand & temp_flag)
+              operand = base + assigned[operand & ~temp_flag];
+            else if (operand & const_flag)
+              operand = constants + (operand & ~const_flag);
+            else if (operand & arg_flag)
+              operand = registers + (operand & ~arg_flag);
+          } else if (i + 1 == operands && is_jump(current.op)) {
+            operand = offsets[operand];
+          }
+          out.code.push_back(operand);
+        }
+      }
+      for (auto const& entry: ctx.lines)
+        out.lines.push_back(line_entry { offsets[entry.offset], entry.line });
+      return registers;
+    }
+  }
+
+  extern auto reg_compiler::compile(
+    std::span<std::shared_ptr<syntax::statement> const> ast
+  ) -> reg_chunk {
+    auto frame = frame_of(_types, _names, _typing);
+    auto result = reg_chunk {};
+    result.slots = frame.slots;
+    auto ctx = context { _types, _names, _typing, _values, frame, result.constants, {}, {}, {}, 0, sema::resolution::npos };
+    for (auto const& node: ast)
+      stmt_compiler { node }.compile(ctx);
+    emit(ctx, reg_opcode::Halt);
+    result.registers = encode(ctx, result.slots, result);
+
+    // A function that falls off its end returns 0.
+    auto functions = _names.functions();
+    for (auto function = std::size_t { 0 }; function < functions.size(); ++function) {
+      auto const& definition = *functions[function].definition;
+      auto layout = frame_of(_types, _names, _typing, function);
+      auto entry = reg_function_entry {
+        result.code.size(), definition.params().size(), layout.slots, 0, {}
+      };
+      auto inner = context { _types, _names, _typing, _values, layout, entry.constants, {}, {}, {}, 0, function };
+      stmt_compiler { definition.body() }.compile(inner);
+      emit(inner, reg_opcode::Return, { constant(inner, 0) });
+      entry.registers = encode(inner, layout.slots, result);
+      result.functions.push_back(std::move(entry));
+    }
+
+    result.globals = globals_of(_types, _names, _typing);
+    return result;
+  }
+}
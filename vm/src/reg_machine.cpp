@@ -0,0 +1,282 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+
+#include "thalia-vm/reg_machine.hpp"
+#include "dispatch.hpp"
+
+namespace thalia::vm {
+#if THALIA_VM_THREADED
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+  // The arguments are moved after the frame before the `Call` checks that
+  // the callee fits, so they need room of their own.
+  extern auto reg_machine::frame_size(reg_chunk const& program)
+    -> std::size_t {
+    if (program.functions.empty())
+      return program.registers;
+    auto params = std::size_t { 0 };
+    for (auto const& function: program.functions)
+      params = std::max(params, function.params);
+    return program.registers + call_stack_size + params;
+  }
+
+  extern auto reg_machine::run()
+    -> outcome {
+    auto constants = _frame.begin() + static_cast<std::ptrdiff_t>(_program.slots);
+    std::fill(_frame.begin(), constants, 0);
+    auto temps = std::copy(_program.constants.begin(), _program.constants.end(), constants);
+    std::fill(temps, _frame.end(), 0);
+
+    auto const* code = _program.code.data();
+    auto* r = _frame.data();
+    auto const* pc = code;
+    auto const* functions = _program.functions.data();
+    auto* const end = _frame.data() + _frame.size();
+    auto registers = _program.registers;
+    _calls.clear();
+
+#if THALIA_VM_THREADED
+    static void* const labels[] = {
+#  define THALIA_VM_LABEL(name, operands, registers) &&op_##name,
+      THALIA_VM_REG_OPCODES(THALIA_VM_LABEL)
+#  undef THALIA_VM_LABEL
+    };
+#  define TARGET(name) op_##name:
+#  define DISPATCH() goto *labels[*pc]
+    DISPATCH();
+#else
+#  define TARGET(name) case reg_opcode::name:
+#  define DISPATCH() continue
+    for (;;) {
+      switch (static_cast<reg_opcode>(*pc)) {
+#endif
+
+    TARGET(Move) {
+      r[pc[1]] = r[pc[2]];
+      pc += 3;
+      DISPATCH();
+    }
+    TARGET(Add) {
+      r[pc[1]] = wrap(static_cast<std::int64_t>(
+        static_cast<std::uint64_t>(r[pc[2]]) + static_cast<std::uint64_t>(r[pc[3]])
+      ), pc[4]);
+      pc += 5;
+      DISPATCH();
+    }
+    TARGET(Sub) {
+      r[pc[1]] = wrap(static_cast<std::int64_t>(
+        static_cast<std::uint64_t>(r[pc[2]]) - static_cast<std::uint64_t>(r[pc[3]])
+      ), pc[4]);
+      pc += 5;
+      DISPATCH();
+    }
+    TARGET(Mul) {
+      r[pc[1]] = wrap(static_cast<std::int64_t>(
+        static_cast<std::uint64_t>(r[pc[2]]) * static_cast<std::uint64_t>(r[pc[3]])
+      ), pc[4]);
+      pc += 5;
+      DISPATCH();
+    }
+    TARGET(Div) {
+      auto rhs = r[pc[3]];
+      if (rhs == 0)
+        return outcome { status::DivByZero, 0, _program.line_at(static_cast<std::size_t>(pc - code)) };
+      r[pc[1]] = rhs == -1
+        ? wrap(static_cast<std::int64_t>(0 - static_cast<std::uint64_t>(r[pc[2]])), pc[4])
+        : r[pc[2]] / rhs;
+      pc += 5;
+      DISPATCH();
+    }
+    TARGET(Mod) {
+      auto rhs = r[pc[3]];
+      if (rhs == 0)
+        return outcome { status::DivByZero, 0, _program.line_at(static_cast<std::size_t>(pc - code)) };
+      r[pc[1]] = rhs == -1 ? 0 : r[pc[2]] % rhs;
+      pc += 5;
+      DISPATCH();
+    }
+    TARGET(Shl) {
+      r[pc[1]] = wrap(static_cast<std::int64_t>(
+        static_cast<std::uint64_t>(r[pc[2]]) << shift_of(r[pc[3]], pc[4])
+      ), pc[4]);
+      pc += 5;
+      DISPATCH();
+    }
+    TARGET(Shr) {
+      r[pc[1]] = r[pc[2]] >> shift_of(r[pc[3]], pc[4]);
+      pc += 5;
+      DISPATCH();
+    }
+    TARGET(BitAnd) {
+      r[pc[1]] = r[pc[2]] & r[pc[3]];
+      pc += 4;
+      DISPATCH();
+    }
+    TARGET(BitOr) {
+      r[pc[1]] = r[pc[2]] | r[pc[3]];
+      pc += 4;
+      DISPATCH();
+    }
+    TARGET(Xor) {
+      r[pc[1]] = r[pc[2]] ^ r[pc[3]];
+      pc += 4;
+      DISPATCH();
+    }
+    TARGET(Less) {
+      r[pc[1]] = r[pc[2]] < r[pc[3]];
+      pc += 4;
+      DISPATCH();
+    }
+    TARGET(LessEqual) {
+      r[pc[1]] = r[pc[2]] <= r[pc[3]];
+      pc += 4;
+      DISPATCH();
+    }
+    TARGET(Grt) {
+      r[pc[1]] = r[pc[2]] > r[pc[3]];
+      pc += 4;
+      DISPATCH();
+    }
+    TARGET(GrtEqual) {
+      r[pc[1]] = r[pc[2]] >= r[pc[3]];
+      pc += 4;
+      DISPATCH();
+    }
+    TARGET(Equal) {
+      r[pc[1]] = r[pc[2]] == r[pc[3]];
+      pc += 4;
+      DISPATCH();
+    }
+    TARGET(NotEqual) {
+      r[pc[1]] = r[pc[2]] != r[pc[3]];
+      pc += 4;
+      DISPATCH();
+    }
+    TARGET(Neg) {
+      r[pc[1]] = wrap(static_cast<std::int64_t>(0 - static_cast<std::uint64_t>(r[pc[2]])), pc[3]);
+      pc += 4;
+      DISPATCH();
+    }
+    TARGET(BitNot) {
+      r[pc[1]] = ~r[pc[2]];
+      pc += 3;
+      DISPATCH();
+    }
+    TARGET(LogNot) {
+      r[pc[1]] = !r[pc[2]];
+      pc += 3;
+      DISPATCH();
+    }
+    TARGET(Bool) {
+      r[pc[1]] = r[pc[2]] != 0;
+      pc += 3;
+      DISPATCH();
+    }
+    TARGET(Jump) {
+      pc = code + pc[1];
+      DISPATCH();
+    }
+    TARGET(JumpFalse) {
+      pc = r[pc[1]] == 0 ? code + pc[2] : pc + 3;
+      DISPATCH();
+    }
+    TARGET(JumpTrue) {
+      pc = r[pc[1]] != 0 ? code + pc[2] : pc + 3;
+      DISPATCH();
+    }
+    TARGET(LoadElem) {
+      auto index = static_cast<std::uint64_t>(r[pc[2]]);
+      if (index >= pc[4])
+        return outcome { status::IndexOutOfRange, 0, _program.line_at(static_cast<std::size_t>(pc - code)) };
+      r[pc[1]] = r[pc[3] + index];
+      pc += 5;
+      DISPATCH();
+    }
+    TARGET(StoreElem) {
+      auto index = static_cast<std::uint64_t>(r[pc[2]]);
+      if (index >= pc[4])
+        return outcome { status::IndexOutOfRange, 0, _program.line_at(static_cast<std::size_t>(pc - code)) };
+      r[pc[3] + index] = r[pc[1]];
+      pc += 5;
+      DISPATCH();
+    }
+    TARGET(ClearElems) {
+      std::fill_n(r + pc[1], pc[2], 0);
+      pc += 3;
+      DISPATCH();
+    }
+    TARGET(Call) {
+      auto const& callee = functions[pc[2]];
+      auto* frame = r + registers;
+      if (callee.registers > static_cast<std::size_t>(end - frame))
+        return outcome { status::StackOverflow, 0, _program.line_at(static_cast<std::size_t>(pc - code)) };
+      std::fill(frame + callee.params, frame + callee.slots, 0);
+      std::copy(callee.constants.begin(), callee.constants.end(), frame + callee.slots);
+      _calls.push_back(activation { pc + 3, r, registers });
+      r = frame;
+      registers = callee.registers;
+      pc = code + callee.offset;
+      DISPATCH();
+    }
+    TARGET(Return) {
+      if (_calls.empty())
+        return outcome { status::Returned, r[pc[1]], 0 };
+      auto value = r[pc[1]];
+      auto const& caller = _calls.back();
+      pc = caller.pc;
+      r = caller.frame;
+      registers = caller.registers;
+      _calls.pop_back();
+      // The result goes to the register named by the `Call`.
+      r[pc[-2]] = value;
+      DISPATCH();
+    }
+    TARGET(TailCall) {
+      // The arguments move down to the start of the frame, which the callee
+      // takes over.
+      auto const& callee = functions[pc[1]];
+      if (callee.registers > static_cast<std::size_t>(end - r))
+        return outcome { status::StackOverflow, 0, _program.line_at(static_cast<std::size_t>(pc - code)) };
+      std::copy(r + registers, r + registers + callee.params, r);
+      std::fill(r + callee.params, r + callee.slots, 0);
+      std::copy(callee.constants.begin(), callee.constants.end(), r + callee.slots);
+      registers = callee.registers;
+      pc = code + callee.offset;
+      DISPATCH();
+    }
+    TARGET(Halt) {
+      return outcome { status::Halted, 0, 0 };
+    }
+
+#if !THALIA_VM_THREADED
+      }
+    }
+#endif
+#undef TARGET
+#undef DISPATCH
+  }
+
+#if THALIA_VM_THREADED
+#  pragma GCC diagnostic pop
+#endif
+}
@@ -0,0 +1,367 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "thalia-vm/verifier.hpp"
+
+namespace thalia::vm {
+  namespace {
+    enum class operand_kind: std::uint8_t { None, Slot, Constant, Width, Target, Loop, Base, Length, Function };
+
+    // How an instruction uses the operand stack and its operands. A fixed
+    // width is the one a specialized form implies, or 0. A call pops the
+    // parameters of its function besides, and so does a tail call.
+    struct shape {
+      std::uint8_t pops;
+      std::uint8_t pushes;
+      std::array<operand_kind, 3> operands;
+      code_unit width;
+    };
+
+    auto shape_of(opcode op)
+      -> shape {
+      using enum operand_kind;
+      switch (op) {
+        case opcode::Const: return { 0, 1, { Constant }, 0 };
+        case opcode::Load: return { 0, 1, { Slot }, 0 };
+        case opcode::Store: return { 1, 0, { Slot }, 0 };
+        case opcode::Dup: return { 1, 2, {}, 0 };
+        case opcode::Pop: return { 1, 0, {}, 0 };
+        case opcode::Add:
+        case opcode::Sub:
+        case opcode::Mul:
+        case opcode::Div:
+        case opcode::Mod:
+        case opcode::Shl:
+        case opcode::Shr:
+          return { 2, 1, { Width }, 0 };
+        case opcode::Add32:
+        case opcode::Sub32:
+        case opcode::Mul32:
+          return { 2, 1, { Width }, 32 };
+        case opcode::Add64:
+        case opcode::Sub64:
+        case opcode::Mul64:
+          return { 2, 1, { Width }, 64 };
+        case opcode::BitAnd:
+        case opcode::BitOr:
+        case opcode::Xor:
+        case opcode::Less:
+        case opcode::LessEqual:
+        case opcode::Grt:
+        case opcode::GrtEqual:
+        case opcode::Equal:
+        case opcode::NotEqual:
+          return { 2, 1, {}, 0 };
+        case opcode::Neg: return { 1, 1, { Width }, 0 };
+        case opcode::BitNot:
+        case opcode::LogNot:
+        case opcode::Bool:
+          return { 1, 1, {}, 0 };
+        case opcode::Jump: return { 0, 0, { Target }, 0 };
+        case opcode::JumpFalse:
+        case opcode::JumpTrue:
+        case opcode::AndJump:
+        case opcode::OrJump:
+          return { 1, 0, { Target }, 0 };
+        case opcode::Loop: return { 0, 0, { Loop }, 0 };
+        case opcode::LoadElem: return { 1, 1, { Base, Length }, 0 };
+        case opcode::StoreElem: return { 2, 0, { Base, Length }, 0 };
+        case opcode::StoreElemKeep: return { 2, 1, { Base, Length }, 0 };
+        case opcode::ClearElems: return { 0, 0, { Base, Length }, 0 };
+        case opcode::Call: return { 0, 1, { Function }, 0 };
+        case opcode::Return: return { 1, 0, {}, 0 };
+        case opcode::TailCall: return { 0, 0, { Function }, 0 };
+        case opcode::Halt: return { 0, 0, {}, 0 };
+        case opcode::AddLocal:
+        case opcode::SubLocal:
+          return { 0, 0, { Slot, Slot, Width }, 0 };
+        case opcode::AddConst:
+        case opcode::SubConst:
+          return { 0, 0, { Slot, Constant, Width }, 0 };
+        case opcode::AddLocal32:
+        case opcode::SubLocal32:
+          return { 0, 0, { Slot, Slot, Width }, 32 };
+        case opcode::AddLocal64:
+        case opcode::SubLocal64:
+          return { 0, 0, { Slot, Slot, Width }, 64 };
+        case opcode::AddConst32:
+        case opcode::SubConst32:
+          return { 0, 0, { Slot, Constant, Width }, 32 };
+        case opcode::AddConst64:
+        case opcode::SubConst64:
+          return { 0, 0, { Slot, Constant, Width }, 64 };
+        case opcode::JumpLessLocal:
+        case opcode::JumpLessEqualLocal:
+        case opcode::JumpGrtLocal:
+        case opcode::JumpGrtEqualLocal:
+        case opcode::JumpEqualLocal:
+        case opcode::JumpNotEqualLocal:
+          return { 0, 0, { Slot, Slot, Target }, 0 };
+        case opcode::JumpLessConst:
+        case opcode::JumpLessEqualConst:
+        case opcode::JumpGrtConst:
+        case opcode::JumpGrtEqualConst:
+        case opcode::JumpEqualConst:
+        case opcode::JumpNotEqualConst:
+          return { 0, 0, { Slot, Constant, Target }, 0 };
+      }
+      return { 0, 0, {}, 0 };
+    }
+
+    // The code and the frame of the top level or of a function.
+    struct region {
+      std::size_t begin;
+      std::size_t end;
+      std::size_t slots;
+      std::size_t max_stack;
+    };
+
+    auto region_of(chunk_view const& program, std::size_t function)
+      -> region {
+      auto const& functions = program.functions;
+      if (function == top_level) {
+        auto end = functions.empty() ? program.code.size() : functions.front().offset;
+        return { 0, end, program.slots, program.max_stack };
+      }
+      auto const& entry = functions[function];
+      auto end = function + 1 < functions.size() ? functions[function + 1].offset : program.code.size();
+      return { entry.offset, end, entry.slots, entry.max_stack };
+    }
+
+    // Checks that the entries of the functions can be trusted: the code of
+    // each starts after the previous one and its frame holds its parameters.
+    auto check_function(chunk_view const& program, std::size_t function)
+      -> char const* {
+      auto const& entry = program.functions[function];
+      auto previous = function == 0 ? 0 : program.functions[function - 1].offset;
+      if (entry.offset <= previous || entry.offset >= program.code.size())
+        return "function out of place";
+      if (entry.params > entry.slots)
+        return "parameters out of the frame";
+      return nullptr;
+    }
+
+    // Checks that the instruction at `offset` of a region is complete and
+    // its operands are in range; jump targets and loop exits only need to
+    // be in the code of the region. The elements of an array must all be
+    // slots of the frame. Only the top level counts its loops, and only
+    // functions have a frame to hand over to a tail call.
+    auto check_operands(chunk_view const& program, region const& bounds, std::size_t offset)
+      -> char const* {
+      auto const& code = program.code;
+      if (code[offset] >= opcode_count)
+        return "unknown opcode";
+      auto op = static_cast<opcode>(code[offset]);
+      auto count = operand_count(op);
+      if (count >= code.size() - offset)
+        return "truncated instruction";
+
+      auto form = shape_of(op);
+      for (auto i = std::size_t { 0 }; i < count; ++i) {
+        auto value = code[offset + 1 + i];
+        switch (form.operands[i]) {
+          case operand_kind::Slot:
+            if (value >= bounds.slots)
+              return "slot out of range";
+            break;
+          case operand_kind::Constant:
+            if (value >= program.constants.size())
+              return "constant out of range";
+            break;
+          case operand_kind::Width:
+            if (value != 8 && value != 16 && value != 32 && value != 64)
+              return "invalid width";
+            if (form.width != 0 && value != form.width)
+              return "width does not match the instruction";
+            break;
+          case operand_kind::Target:
+            if (value < bounds.begin || value >= bounds.end)
+              return "jump out of the code";
+            break;
+          case operand_kind::Base:
+            if (value >= bounds.slots)
+              return "slot out of range";
+            break;
+          case operand_kind::Length:
+            if (value == 0 || value > bounds.slots - code[offset + i])
+              return "elements out of range";
+            break;
+          case operand_kind::Loop:
+            if (bounds.begin != 0)
+              return "loop inside a function";
+            if (value >= program.loops.size())
+              return "loop out of range";
+            if (program.loops[value].exit >= bounds.end)
+              return "loop exit out of the code";
+            break;
+          case operand_kind::Function:
+            if (op == opcode::TailCall && bounds.begin == 0)
+              return "tail call at the top level";
+            if (value >= program.functions.size())
+              return "function out of range";
+            if (auto reason = check_function(program, value))
+              return reason;
+            break;
+          case operand_kind::None:
+            break;
+        }
+      }
+      return nullptr;
+    }
+
+    // The number of values an instruction pops.
+    auto pops_of(chunk_view const& program, std::size_t offset)
+      -> std::size_t {
+      auto op = static_cast<opcode>(program.code[offset]);
+      if (op == opcode::Call || op == opcode::TailCall)
+        return program.functions[program.code[offset + 1]].params;
+      return shape_of(op).pops;
+    }
+
+    auto is_terminal(opcode op)
+      -> bool {
+      return op == opcode::Jump || op == opcode::Return || op == opcode::TailCall || op == opcode::Halt;
+    }
+  }
+
+  extern auto verify(chunk_view const& program)
+    -> std::optional<verify_error> {
+    auto const& code = program.code;
+    if (code.empty())
+      return verify_error { 0, "empty code" };
+    if (program.slots > call_stack_size || program.max_stack > call_stack_size)
+      return verify_error { 0, "frame too large" };
+    for (auto function = std::size_t { 0 }; function < program.functions.size(); ++function) {
+      if (auto reason = check_function(program, function))
+        return verify_error { program.functions[function].offset, reason };
+    }
+
+    // The top level, then every function.
+    auto regions = std::vector<region> { region_of(program, top_level) };
+    for (auto function = std::size_t { 0 }; function < program.functions.size(); ++function)
+      regions.push_back(region_of(program, function));
+
+    // Decode every instruction once, marking the boundaries.
+    auto boundary = std::vector<bool>(code.size(), false);
+    for (auto const& bounds: regions) {
+      for (auto pc = bounds.begin; pc < bounds.end;) {
+        if (auto reason = check_operands(program, bounds, pc))
+          return verify_error { pc, reason };
+        boundary[pc] = true;
+        pc += 1 + operand_count(static_cast<opcode>(code[pc]));
+        if (pc > bounds.end)
+          return verify_error { bounds.end, "instruction across the end of a function" };
+      }
+    }
+
+    for (auto pc = std::size_t { 0 }; pc < code.size();) {
+      auto op = static_cast<opcode>(code[pc]);
+      auto form = shape_of(op);
+      auto count = operand_count(op);
+      for (auto i = std::size_t { 0 }; i < count; ++i) {
+        auto value = code[pc + 1 + i];
+        if (form.operands[i] == operand_kind::Target && !boundary[value])
+          return verify_error { pc, "jump into the middle of an instruction" };
+        if (form.operands[i] == operand_kind::Loop && !boundary[program.loops[value].exit])
+          return verify_error { pc, "loop exit in the middle of an instruction" };
+      }
+      pc += 1 + count;
+    }
+
+    // Follow every path of every region from its start, assigning each
+    // reachable instruction the depth of the operand stack before it runs.
+    constexpr auto unknown = std::size_t { static_cast<std::size_t>(-1) };
+    auto depths = std::vector<std::size_t>(code.size(), unknown);
+    for (auto const& bounds: regions) {
+      auto pending = std::vector<std::size_t> { bounds.begin };
+      depths[bounds.begin] = 0;
+      auto reach = [&](std::size_t from, std::size_t target, std::size_t depth)
+        -> std::optional<verify_error> {
+        if (target >= bounds.end)
+          return verify_error { from, "runs past the end of the code" };
+        if (depths[target] == unknown) {
+          depths[target] = depth;
+          pending.push_back(target);
+        } else if (depths[target] != depth) {
+          return verify_error { target, "stack depth differs where paths join" };
+        }
+        return std::nullopt;
+      };
+
+      while (!pending.empty()) {
+        auto pc = pending.back();
+        pending.pop_back();
+        auto op = static_cast<opcode>(code[pc]);
+        auto form = shape_of(op);
+        auto depth = depths[pc];
+        auto pops = pops_of(program, pc);
+        if (depth < pops)
+          return verify_error { pc, "stack underflow" };
+        auto after = depth - pops + form.pushes;
+        if (after > bounds.max_stack)
+          return verify_error { pc, "stack overflow" };
+
+        auto count = operand_count(op);
+        auto next = pc + 1 + count;
+        auto error = std::optional<verify_error> {};
+        if (!is_terminal(op))
+          error = reach(pc, next, after);
+        for (auto i = std::size_t { 0 }; i < count && !error; ++i) {
+          auto value = code[pc + 1 + i];
+          if (form.operands[i] == operand_kind::Target) {
+            // Short-circuit jumps keep the value they test when taken.
+            auto kept = op == opcode::AndJump || op == opcode::OrJump ? depth : after;
+            error = reach(pc, value, kept);
+          }
+          if (form.operands[i] == operand_kind::Loop)
+            error = reach(pc, program.loops[value].exit, after);
+        }
+        if (error)
+          return error;
+      }
+    }
+
+    for (auto i = std::size_t { 0 }; i < program.lines.size(); ++i) {
+      auto const& entry = program.lines[i];
+      if (entry.offset >= code.size() || (i != 0 && entry.offset < program.lines[i - 1].offset))
+        return verify_error { entry.offset, "line table entry out of place" };
+    }
+    return std::nullopt;
+  }
+
+  extern auto admissible(
+    chunk_view const& program,
+    std::size_t function,
+    std::size_t offset,
+    std::size_t depth
+  ) -> bool {
+    if (offset >= program.code.size())
+      return false;
+    auto bounds = region_of(program, function);
+    if (check_operands(program, bounds, offset))
+      return false;
+    auto form = shape_of(static_cast<opcode>(program.code[offset]));
+    auto pops = pops_of(program, offset);
+    return depth >= pops && depth - pops + form.pushes <= bounds.max_stack;
+  }
+}
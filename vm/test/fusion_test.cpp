@@ -0,0 +1,139 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-test/compiled.hpp>
+
+#include "thalia-vm/fusion.hpp"
+#include "thalia-vm/machine.hpp"
+
+using namespace thalia;
+
+namespace {
+  auto count(vm::chunk const& program, vm::opcode op)
+    -> std::size_t {
+    auto result = std::size_t { 0 };
+    for (auto pc = std::size_t { 0 }; pc < program.code.size();) {
+      auto current = static_cast<vm::opcode>(program.code[pc]);
+      result += current == op;
+      pc += 1 + vm::operand_count(current);
+    }
+    return result;
+  }
+
+  auto code_of(vm::opcode op)
+    -> std::size_t {
+    return static_cast<std::size_t>(op);
+  }
+}
+
+TEST_CASE("fuse: loop conditions and compound assignments") {
+  auto source = test::compiled {
+    "def MIN: i32 = 4i32, MAX: i32 = 6i32;\n"
+    "def mut i: i32 = MIN, mut s: i32 = 0i32, mut j: i64 = 10, mut k: i64 = 0;\n"
+    "while i <= MAX { s += i; i += 1i32; }\n"
+    "while j > k { j -= 1; k = k + 1; }\n"
+    "if s < 100i32 { s -= i; }\n"
+  };
+  auto program = source.program;
+  auto report = vm::fuse(program);
+  CHECK(report.sites[code_of(vm::opcode::AddLocal)] == 1);
+  CHECK(report.sites[code_of(vm::opcode::AddConst)] == 2);
+  CHECK(report.sites[code_of(vm::opcode::SubConst)] == 1);
+  CHECK(report.sites[code_of(vm::opcode::SubLocal)] == 1);
+  CHECK(report.sites[code_of(vm::opcode::JumpLessEqualConst)] == 1);
+  CHECK(report.sites[code_of(vm::opcode::JumpGrtLocal)] == 1);
+  // `if` jumps over its body when the condition fails.
+  CHECK(report.sites[code_of(vm::opcode::JumpGrtEqualConst)] == 1);
+  CHECK(count(program, vm::opcode::Load) == 0);
+  CHECK(program.code.size() < source.program.code.size());
+
+  auto plain = vm::machine { source.program };
+  auto fused = vm::machine { program };
+  plain.run();
+  fused.run();
+  for (auto slot = std::size_t { 0 }; slot < program.slots; ++slot)
+    CHECK(fused.slots()[slot] == plain.slots()[slot]);
+}
+
+TEST_CASE("fuse: keeps sequences other code jumps into") {
+  auto source = test::compiled {
+    "def mut a: i64 = 1, mut b: i64 = 0, mut n: i64 = 0;\n"
+    "while 1 { n += 1; if n == 5 { return 7i32; } }\n"
+    "a = a + (b || a);\n"
+  };
+  auto program = source.program;
+  vm::fuse(program);
+  auto vm = vm::machine { program };
+  auto result = vm.run();
+  CHECK(result.state == vm::status::Returned);
+  CHECK(result.value == 7);
+  CHECK(vm.slots()[2] == 5);
+}
+
+TEST_CASE("fuse: relocates the lines of trapping instructions") {
+  auto source = test::compiled {
+    "def mut i: i32 = 0i32, mut zero: i32 = 0i32;\n"
+    "while i < 3i32 { i += 1i32; }\n"
+    "\n"
+    "i = i / zero;\n"
+  };
+  auto program = source.program;
+  vm::fuse(program);
+  auto result = vm::machine { program }.run();
+  CHECK(result.state == vm::status::DivByZero);
+  CHECK(result.line == 4);
+}
+
+TEST_CASE("machine: quickens arithmetic by width") {
+  auto source = test::compiled {
+    "def mut a: i64 = 0, mut b: i8 = 0i8, mut n: i32 = 0i32;\n"
+    "while n < 100i32 { a = a * 3 + 1; b = b * 3i8 + 1i8; n += 1i32; }\n"
+  };
+  auto program = source.program;
+  auto report = vm::fuse(program);
+  auto vm = vm::machine { program, true };
+  vm.run();
+  auto first = std::int64_t { vm.slots()[1] };
+  vm.run();
+  CHECK(vm.slots()[1] == first);
+
+  // Over both runs, the 64-bit multiplication runs generically once and the
+  // 8-bit one always does.
+  auto executions = vm.executions();
+  CHECK(executions[code_of(vm::opcode::Mul)] == 1 + 200);
+  CHECK(executions[code_of(vm::opcode::Mul64)] == 199);
+  CHECK(executions[code_of(vm::opcode::Add64)] == 199);
+  CHECK(executions[code_of(vm::opcode::AddConst)] == 1);
+  CHECK(executions[code_of(vm::opcode::AddConst32)] == 199);
+
+  auto reference = vm::machine { source.program };
+  reference.run();
+  CHECK(vm.slots()[1] == reference.slots()[1]);
+  CHECK(vm.slots()[0] == reference.slots()[0]);
+
+  auto out = std::ostringstream {};
+  vm::print_profile(out, report, executions);
+  CHECK(out.str().find("AddConst                      1           200") != std::string::npos);
+  CHECK(out.str().find("Mul64") != std::string::npos);
+}
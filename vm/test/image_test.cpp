@@ -0,0 +1,138 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-test/compiled.hpp>
+
+#include "thalia-vm/fusion.hpp"
+#include "thalia-vm/image.hpp"
+#include "thalia-vm/machine.hpp"
+
+using namespace thalia;
+
+namespace {
+  auto image_path()
+    -> std::filesystem::path {
+    return std::filesystem::temp_directory_path() / "thalia-image-test.thb";
+  }
+
+  auto write(vm::chunk const& program)
+    -> std::vector<char> {
+    { auto out = std::ofstream { image_path(), std::ios::binary }; vm::write_image(out, program); }
+    auto in = std::ifstream { image_path(), std::ios::binary };
+    return { std::istreambuf_iterator<char> { in }, std::istreambuf_iterator<char> {} };
+  }
+
+  auto overwrite(std::vector<char> const& bytes)
+    -> void {
+    auto out = std::ofstream { image_path(), std::ios::binary | std::ios::trunc };
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+  }
+
+  auto error_of(std::vector<char> const& bytes)
+    -> std::string {
+    overwrite(bytes);
+    try {
+      vm::mapped_image { image_path() };
+    } catch (vm::image_error const& error) {
+      return error.what();
+    }
+    return {};
+  }
+}
+
+TEST_CASE("image: runs like the chunk it was written from") {
+  auto source = test::compiled {
+    "use three(): i64; def mut i: i32 = 0i32, mut total: i64 = 0, mut zero: i64 = 0;\n"
+    "while i < 100i32 { total += three(); i += 1i32; }\n"
+    "if total > 1000000 { total = total / zero; }\n"
+    "global three(): i64 { return 3; }\n"
+    "total = total / zero;\n"
+  };
+  auto program = source.program;
+  vm::fuse(program);
+  auto bytes = write(program);
+  CHECK(bytes.size() % 8 == 0);
+  CHECK(std::string { bytes.begin(), bytes.begin() + 4 } == "\x7fTHB");
+
+  auto image = vm::mapped_image { image_path() };
+  auto view = image.view();
+  CHECK(std::vector<vm::code_unit> { view.code.begin(), view.code.end() } == program.code);
+  CHECK(view.slots == program.slots);
+  CHECK(view.max_stack == program.max_stack);
+  REQUIRE(view.loops.size() == 1);
+  CHECK(view.loops[0].exit == program.loops[0].exit);
+  REQUIRE(view.functions.size() == 1);
+  CHECK(view.functions[0].offset == program.functions[0].offset);
+  CHECK(view.functions[0].max_stack == program.functions[0].max_stack);
+  REQUIRE(image.globals().size() == 3);
+  CHECK(image.globals()[1].name == "total");
+  CHECK(image.globals()[1].width == 64);
+
+  auto loaded = vm::machine { view };
+  auto result = loaded.run();
+  CHECK(result.state == vm::status::DivByZero);
+  CHECK(result.line == 5);
+  CHECK(loaded.slots()[image.globals()[1].slot] == 300);
+  std::filesystem::remove(image_path());
+}
+
+TEST_CASE("image: rejects damaged files") {
+  auto source = test::compiled { "def mut n: i64 = 41;\nn += 1;\n" };
+  auto bytes = write(source.program);
+
+  auto flipped = bytes;
+  flipped.back() ^= 1;
+  CHECK(error_of(flipped) == "Checksum mismatch");
+
+  auto truncated = bytes;
+  truncated.resize(bytes.size() - 8);
+  CHECK(error_of(truncated) == "Truncated image");
+  CHECK(error_of({ bytes.begin(), bytes.begin() + 20 }) == "Truncated image");
+
+  auto foreign = bytes;
+  foreign[1] = 'X';
+  CHECK(error_of(foreign) == "Not a Thalia bytecode image");
+
+  auto newer = bytes;
+  newer[4] = static_cast<char>(vm::image_version + 1);
+  CHECK(error_of(newer) == "Unsupported image version 5");
+
+  // The header sizes the frame the machine allocates before verifying.
+  auto huge = source.program;
+  huge.slots = std::size_t { 1 } << 40;
+  CHECK(error_of(write(huge)) == "Frame too large");
+  huge = source.program;
+  huge.max_stack = std::size_t { 1 } << 62;
+  CHECK(error_of(write(huge)) == "Frame too large");
+
+  overwrite(bytes);
+  auto image = vm::mapped_image { image_path() };
+  auto machine = vm::machine { image.view() };
+  machine.run();
+  CHECK(machine.slots()[image.globals()[0].slot] == 42);
+  std::filesystem::remove(image_path());
+}
@@ -0,0 +1,311 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-test/compiled.hpp>
+
+#include "thalia-vm/fusion.hpp"
+#include "thalia-vm/machine.hpp"
+
+using namespace thalia;
+
+namespace {
+  auto global(test::compiled const& source, vm::machine const& vm, std::string_view name)
+    -> std::int64_t {
+    for (auto const& entry: source.program.globals)
+      if (entry.name == name)
+        return vm.slots()[entry.slot];
+    FAIL("no global named " << name);
+    return 0;
+  }
+
+  auto contains(vm::chunk const& program, vm::opcode op)
+    -> bool {
+    for (auto pc = std::size_t { 0 }; pc < program.code.size();) {
+      auto current = static_cast<vm::opcode>(program.code[pc]);
+      if (current == op)
+        return true;
+      pc += 1 + vm::operand_count(current);
+    }
+    return false;
+  }
+}
+
+TEST_CASE("machine: runs the example program") {
+  auto source = test::compiled {
+    "def MIN: i32 = 4i32,\n"
+    "    MAX: i32 = 6i32;\n"
+    "def mut i: i32 = MIN,\n"
+    "    mut s: i32 = 0i32;\n"
+    "while i <= MAX {\n"
+    "  s += i;\n"
+    "  i += 1i32;\n"
+    "}\n"
+  };
+  auto vm = vm::machine { source.program };
+  auto result = vm.run();
+  CHECK(result.state == vm::status::Halted);
+  CHECK(global(source, vm, "i") == 7);
+  CHECK(global(source, vm, "s") == 15);
+  REQUIRE(source.program.globals.size() == 2);
+  CHECK(source.program.globals[0].width == 32);
+}
+
+TEST_CASE("machine: arithmetic wraps to the width of its type") {
+  auto source = test::compiled {
+    "def mut a: i8 = 127i8, mut b: i16 = 300i16, mut c: i32 = 1i32;\n"
+    "def mut d: i64 = 9223372036854775807, mut e: i8 = -128i8;\n"
+    "a += 1i8;\n"
+    "b *= b;\n"
+    "c <<= 35i8;\n"
+    "d += 1;\n"
+    "e = -e;\n"
+    "def mut f: i16 = -16i16;\n"
+    "f >>= 2i16;\n"
+    "def mut g: i8 = 1i8;\n"
+    "g <<= 7i8;\n"
+  };
+  auto vm = vm::machine { source.program };
+  vm.run();
+  CHECK(global(source, vm, "a") == -128);
+  CHECK(global(source, vm, "b") == 24464);
+  CHECK(global(source, vm, "c") == 8);
+  CHECK(global(source, vm, "d") == std::numeric_limits<std::int64_t>::min());
+  CHECK(global(source, vm, "e") == -128);
+  CHECK(global(source, vm, "f") == -4);
+  CHECK(global(source, vm, "g") == -128);
+}
+
+TEST_CASE("machine: division truncates and traps on zero") {
+  auto source = test::compiled {
+    "def mut q: i32 = -7i32, mut r: i32 = -7i32, mut m: i8 = -128i8;\n"
+    "q /= 2i32;\n"
+    "r %= 2i32;\n"
+    "m /= -1i8;\n"
+    "def mut zero: i32 = 0i32;\n"
+    "q = q / zero;\n"
+  };
+  auto vm = vm::machine { source.program };
+  auto result = vm.run();
+  CHECK(result.state == vm::status::DivByZero);
+  CHECK(result.line == 6);
+  CHECK(global(source, vm, "q") == -3);
+  CHECK(global(source, vm, "r") == -1);
+  CHECK(global(source, vm, "m") == -128);
+}
+
+TEST_CASE("machine: control flow and logical operators") {
+  auto source = test::compiled {
+    "def mut calls: i64 = 0, mut x: i64 = 0, mut y: i64 = 0;\n"
+    "0 && (calls = 1);\n"
+    "1 || (calls = 2);\n"
+    "x = 2 && 3;\n"
+    "y = 0 || (calls += 10) > 5;\n"
+    "def mut n: i32 = 0i32, mut evens: i32 = 0i32, mut odds: i32 = 0i32;\n"
+    "while n < 10i32 {\n"
+    "  if n % 2i32 == 0i32 { evens += 1i32; } else { odds += 1i32; }\n"
+    "  n += 1i32;\n"
+    "}\n"
+    "def mut a: i64 = 0, mut b: i64 = 0;\n"
+    "a = b = 3;\n"
+    "return 42i32;\n"
+    "a = 100;\n"
+  };
+  auto vm = vm::machine { source.program };
+  auto result = vm.run();
+  CHECK(result.state == vm::status::Returned);
+  CHECK(result.value == 42);
+  CHECK(global(source, vm, "calls") == 10);
+  CHECK(global(source, vm, "x") == 1);
+  CHECK(global(source, vm, "y") == 1);
+  CHECK(global(source, vm, "evens") == 5);
+  CHECK(global(source, vm, "odds") == 5);
+  CHECK(global(source, vm, "a") == 3);
+  CHECK(global(source, vm, "b") == 3);
+}
+
+TEST_CASE("compiler: folds constants and keeps locals in slots") {
+  auto source = test::compiled {
+    "def N: i64 = 10;\n"
+    "def mut k: i64 = N * 2 + 1;\n"
+    "if N > 5 { k += 1; } else { k -= 1; }\n"
+    "while 0 { k = 0; }\n"
+    "{ def mut t: i64 = k; k = t * 2; }\n"
+  };
+  CHECK_FALSE(contains(source.program, vm::opcode::Grt));
+  CHECK_FALSE(contains(source.program, vm::opcode::JumpFalse));
+  CHECK(source.program.slots == 3);
+
+  auto vm = vm::machine { source.program };
+  vm.run();
+  CHECK(global(source, vm, "k") == 44);
+  CHECK(source.program.globals.size() == 1);
+}
+
+namespace {
+  // Answers every hot loop offered to it the same way; when it takes the
+  // first loop, it leaves 100 in the first slot.
+  class scripted_tier: public vm::tier {
+    public:
+      scripted_tier(std::uint64_t limit, std::optional<vm::outcome> answer)
+        : _limit { limit }
+        , _answer { answer } {}
+
+      auto threshold() const -> std::uint64_t override
+        { return _limit; }
+
+      auto enter(std::size_t loop, std::span<std::int64_t> slots)
+        -> std::optional<vm::outcome> override {
+        offers.push_back(loop);
+        if (_answer && loop == 0)
+          slots[0] = 100;
+        return _answer;
+      }
+
+    public:
+      std::vector<std::size_t> offers;
+
+    private:
+      std::uint64_t _limit;
+      std::optional<vm::outcome> _answer;
+  };
+}
+
+TEST_CASE("machine: offers hot loops to an attached tier") {
+  auto source = test::compiled {
+    "def mut i: i64 = 0, mut after: i64 = 0;\n"
+    "while i < 10 {\n"
+    "  def mut j: i64 = 0;\n"
+    "  while j < 2 { j += 1; }\n"
+    "  i += 1;\n"
+    "}\n"
+    "after = i + 1;\n"
+  };
+  REQUIRE(source.program.loops.size() == 2);
+  CHECK(source.program.loops[0].line == 2);
+  CHECK(source.program.loops[1].line == 4);
+
+  auto fused = source.program;
+  vm::fuse(fused);
+  for (auto const* program: { &source.program, &fused }) {
+    auto halted = scripted_tier { 4, vm::outcome { vm::status::Halted, 0, 0 } };
+    auto vm = vm::machine { *program };
+    vm.attach(halted);
+    CHECK(vm.run().state == vm::status::Halted);
+    CHECK(halted.offers == std::vector<std::size_t> { 1, 1, 0 });
+    CHECK(global(source, vm, "i") == 100);
+    CHECK(global(source, vm, "after") == 101);
+    CHECK(vm.iterations()[0] == 4);
+
+    auto declined = scripted_tier { 4, std::nullopt };
+    vm.attach(declined);
+    CHECK(vm.run().state == vm::status::Halted);
+    CHECK(global(source, vm, "after") == 11);
+    CHECK(declined.offers.size() == 2 + 7);
+    CHECK(vm.iterations()[0] == 11 - 8);
+  }
+
+  auto returned = scripted_tier { 1, vm::outcome { vm::status::Returned, 9, 0 } };
+  auto vm = vm::machine { source.program };
+  vm.attach(returned);
+  auto result = vm.run();
+  CHECK(result.state == vm::status::Returned);
+  CHECK(result.value == 9);
+  CHECK(global(source, vm, "after") == 0);
+}
+
+TEST_CASE("machine: arrays start zeroed and check their indices") {
+  auto source = test::compiled {
+    "def mut a: [8]i8, mut i: i8 = 0i8, mut s: i8 = 0i8;\n"
+    "while i < 8i8 { a[i] = i * 40i8; i += 1i8; }\n"
+    "i = 0i8;\n"
+    "while i < 8i8 { s += a[i]; i += 1i8; }\n"
+    "while i < 10i8 { def mut b: [2]i8; s += b[1]; b[1] = 5i8; i += 1i8; }\n"
+    "a[s] = 1i8;\n"
+  };
+  auto vm = vm::machine { source.program };
+  auto result = vm.run();
+  CHECK(result.state == vm::status::IndexOutOfRange);
+  CHECK(result.line == 6);
+  CHECK(global(source, vm, "i") == 10);
+  CHECK(global(source, vm, "s") == 96);
+}
+
+TEST_CASE("machine: calls run in frames of their own") {
+  auto source = test::compiled {
+    "global fib(n: i64): i64 { if n < 2 { return n; } return fib(n - 1) + fib(n - 2); }\n"
+    "local sum(n: i32): i64 {\n"
+    "  def mut a: [4]i64, mut i: i32 = 0i32, mut s: i64 = 0;\n"
+    "  while i < n { a[i & 3i32] += 1; s += a[i & 3i32]; i += 1i32; }\n"
+    "  return s;\n"
+    "}\n"
+    "global none(): void { return; }\n"
+    "def mut a: [2]i64, mut x: i64 = fib(15), mut y: i64 = sum(8i32) + sum(4i32);\n"
+    "none();\n"
+    "a[1] = x;\n"
+  };
+  REQUIRE(source.program.functions.size() == 3);
+  auto vm = vm::machine { source.program };
+  CHECK_FALSE(vm.rejection());
+  CHECK(vm.run().state == vm::status::Halted);
+  CHECK(global(source, vm, "x") == 610);
+  CHECK(global(source, vm, "y") == 16);
+
+  auto deep = test::compiled {
+    "global down(n: i64): i64 { return down(n + 1) + 1; }\n"
+    "def x: i64 = 0;\n"
+    "down(x);\n"
+  };
+  auto overflow = vm::machine { deep.program };
+  auto result = overflow.run();
+  CHECK(result.state == vm::status::StackOverflow);
+  CHECK(result.line == 1);
+
+  // A function without slots still takes an activation.
+  auto empty = test::compiled {
+    "global spin(): i64 { return spin() + 1; }\n"
+    "spin();\n"
+  };
+  auto spun = vm::machine { empty.program }.run();
+  CHECK(spun.state == vm::status::StackOverflow);
+  CHECK(spun.line == 1);
+}
+
+TEST_CASE("machine: tail calls reuse the frame of the caller") {
+  auto source = test::compiled {
+    "use odd(n: i64): i64;\n"
+    "global sum(n: i64, acc: i64): i64 { if n == 0 { return acc; } return (sum(n - 1, acc + n)); }\n"
+    "global even(n: i64): i64 { if n == 0 { return 1; } return odd(n - 1); }\n"
+    "global odd(n: i64): i64 { if n == 0 { return 0; } return even(n - 1); }\n"
+    "def mut s: i64 = sum(3000000, 0), mut e: i64 = even(2000001);\n"
+  };
+  CHECK(contains(source.program, vm::opcode::TailCall));
+  auto vm = vm::machine { source.program };
+  CHECK_FALSE(vm.rejection());
+  CHECK(vm.run().state == vm::status::Halted);
+  CHECK(global(source, vm, "s") == 4500001500000);
+  CHECK(global(source, vm, "e") == 0);
+}
@@ -0,0 +1,172 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-test/compiled.hpp>
+
+#include "thalia-vm/machine.hpp"
+#include "thalia-vm/reg_machine.hpp"
+
+using namespace thalia;
+
+namespace {
+  auto global(test::compiled const& source, vm::reg_machine const& vm, std::string_view name)
+    -> std::int64_t {
+    for (auto const& entry: source.registers.globals)
+      if (entry.name == name)
+        return vm.slots()[entry.slot];
+    FAIL("no global named " << name);
+    return 0;
+  }
+
+  auto instructions(vm::reg_chunk const& program)
+    -> std::size_t {
+    auto count = std::size_t { 0 };
+    for (auto pc = std::size_t { 0 }; pc < program.code.size(); ++count)
+      pc += 1 + vm::operand_count(static_cast<vm::reg_opcode>(program.code[pc]));
+    return count;
+  }
+
+  // Runs a program on both machines and checks they end in the same state.
+  auto agree(test::compiled const& source)
+    -> vm::outcome {
+    auto stack = vm::machine { source.program };
+    auto expected = stack.run();
+    auto registers = vm::reg_machine { source.registers };
+    auto actual = registers.run();
+    CHECK(actual.state == expected.state);
+    CHECK(actual.value == expected.value);
+    CHECK(actual.line == expected.line);
+    for (auto slot = std::size_t { 0 }; slot < source.program.slots; ++slot)
+      CHECK(registers.slots()[slot] == stack.slots()[slot]);
+    return actual;
+  }
+}
+
+TEST_CASE("reg_machine: agrees with the stack machine") {
+  agree(test::compiled {
+    "def mut a: i8 = 127i8, mut b: i16 = 300i16, mut c: i32 = 1i32;\n"
+    "a += 1i8;\n"
+    "b *= b;\n"
+    "c <<= 35i8;\n"
+    "def mut d: i64 = -9, mut e: i64 = 4;\n"
+    "d = -(d % e) * ~e ^ (d >> 1) | e & 6;\n"
+    "def mut calls: i64 = 0, mut x: i64 = 0, mut y: i64 = 0;\n"
+    "0 && (calls = 1);\n"
+    "x = 2 && calls;\n"
+    "y = !x || (calls += 10) > 5;\n"
+    "def mut n: i32 = 0i32, mut evens: i32 = 0i32;\n"
+    "while n < 10i32 {\n"
+    "  if n % 2i32 == 0i32 { evens += 1i32; } else { if n != 3i32 { evens -= 0i32; } }\n"
+    "  n += 1i32;\n"
+    "}\n"
+  });
+
+  auto trapped = agree(test::compiled {
+    "def mut q: i32 = -7i32, mut m: i8 = -128i8, mut zero: i32 = 0i32;\n"
+    "q /= 2i32;\n"
+    "m /= -1i8;\n"
+    "q = q / zero;\n"
+  });
+  CHECK(trapped.state == vm::status::DivByZero);
+  CHECK(trapped.line == 4);
+
+  auto returned = agree(test::compiled {
+    "def mut a: i32 = 5i32;\n"
+    "return a * 2i32;\n"
+  });
+  CHECK(returned.value == 10);
+
+  auto called = agree(test::compiled {
+    "global gcd(a: i64, b: i64): i64 { if b == 0 { return a; } return gcd(b, a % b); }\n"
+    "local twice(a: i32): i32 { def b: i32 = a * 2i32; return b; }\n"
+    "def mut x: i64 = 2, mut y: i32 = 3i32;\n"
+    "x = gcd(x * 21, (x = 14) + gcd(x, 4));\n"
+    "y = twice(twice(y) + 1i32) - twice(y);\n"
+    "return y / (y - 8i32);\n"
+  });
+  CHECK(called.state == vm::status::DivByZero);
+  CHECK(called.line == 6);
+
+  // Tail calls run in the frame of their caller, at any depth.
+  auto deep = agree(test::compiled {
+    "use odd(n: i64, k: i8): i64;\n"
+    "global even(n: i64, k: i8): i64 { if n == 0 { return 1; } return odd(n - 1, k); }\n"
+    "global odd(n: i64, k: i8): i64 { if n == 0 { return 0; } return (even(n - 1, k)); }\n"
+    "global down(n: i32): i32 { return down(n + 1i32) + 1i32; }\n"
+    "def mut e: i64 = even(3000001, 1i8);\n"
+    "return down(1i32);\n"
+  });
+  CHECK(deep.state == vm::status::StackOverflow);
+  CHECK(deep.line == 4);
+}
+
+TEST_CASE("reg_machine: operands are read in evaluation order") {
+  auto source = test::compiled {
+    "def mut x: i64 = 1, mut y: i64 = 1, mut z: i64 = 1, mut w: i64 = 0;\n"
+    "x += (x = 10);\n"
+    "y = y + (y = 20);\n"
+    "z = (z = 5) + z;\n"
+    "w = x && (x = 0);\n"
+  };
+  agree(source);
+  auto vm = vm::reg_machine { source.registers };
+  vm.run();
+  CHECK(global(source, vm, "x") == 0);
+  CHECK(global(source, vm, "y") == 21);
+  CHECK(global(source, vm, "z") == 10);
+  CHECK(global(source, vm, "w") == 0);
+}
+
+TEST_CASE("reg_compiler: assignments target variable slots") {
+  auto source = test::compiled {
+    "def MIN: i32 = 4i32, MAX: i32 = 6i32;\n"
+    "def mut i: i32 = MIN, mut s: i32 = 0i32;\n"
+    "while i <= MAX { s += i; i += 1i32; }\n"
+  };
+  // Four initializations, the jump to the test, two additions, the
+  // comparison, the branch and `Halt`.
+  CHECK(instructions(source.registers) == 10);
+  CHECK(source.registers.registers == source.registers.slots + source.registers.constants.size() + 1);
+
+  auto listing = std::ostringstream {};
+  vm::disassemble(listing, source.registers);
+  CHECK(listing.str().find("Add s3 s3 s2 32") != std::string::npos);
+
+  auto vm = vm::reg_machine { source.registers };
+  vm.run();
+  CHECK(global(source, vm, "i") == 7);
+  CHECK(global(source, vm, "s") == 15);
+}
+
+TEST_CASE("reg_compiler: temporaries share registers") {
+  auto code = std::string { "def mut a: i64 = 3, mut b: i64 = 5, mut c: i64 = 7, mut d: i64 = 2;\n" };
+  for (auto i = 0; i < 50; ++i)
+    code += "a = ((a + b) * (c + d)) + ((a - b) * (c - d)) % 1000;\n";
+  auto source = test::compiled { code };
+  auto temps = source.registers.registers
+    - source.registers.slots - source.registers.constants.size();
+  CHECK(temps == 3);
+  agree(source);
+}
@@ -0,0 +1,221 @@
+/* Copyright (C) 2024 Stan Vlad <vstan02@protonmail.com>
+ *
+ * This file is part of Thalia.
+ *
+ * Thalia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thalia-test/compiled.hpp>
+
+#include "thalia-vm/fusion.hpp"
+#include "thalia-vm/machine.hpp"
+#include "thalia-vm/verifier.hpp"
+
+using namespace thalia;
+
+namespace {
+  auto reason_of(vm::chunk const& program)
+    -> std::string {
+    auto error = vm::verify(program.view());
+    return error ? error->reason : "";
+  }
+
+  // Finds the first instruction with an opcode, or the first one with
+  // given operand.
+  auto find(vm::chunk const& program, vm::opcode op, std::optional<vm::code_unit> operand = {})
+    -> std::size_t {
+    for (auto pc = std::size_t { 0 }; pc < program.code.size();) {
+      auto current = static_cast<vm::opcode>(program.code[pc]);
+      if (current == op && (!operand || program.code[pc + 1] == *operand))
+        return pc;
+      pc += 1 + vm::operand_count(current);
+    }
+    FAIL("no such instruction");
+    return 0;
+  }
+
+  auto set_opcode(vm::chunk& program, std::size_t offset, vm::opcode op)
+    -> void {
+    program.code[offset] = static_cast<vm::code_unit>(op);
+  }
+}
+
+TEST_CASE("verify: accepts what the compiler emits") {
+  auto source = test::compiled {
+    "def LIMIT: i64 = 50;\n"
+    "def mut a: i64 = 1, mut b: i8 = 3i8, mut n: i64 = 0, mut x: i32 = 0i32;\n"
+    "while n < LIMIT {\n"
+    "  if n % 3 == 0 && !(n == 9) || n > 40 { a += n; } else { a -= 1; }\n"
+    "  { def mut t: i64 = -a; a = t * 2 / 3; }\n"
+    "  b <<= 1i8;\n"
+    "  x = (x = x + 1i32) * 2i32;\n"
+    "  n += 1;\n"
+    "}\n"
+    "while 1 { n -= 1; if n == 0 { return 3i32; } }\n"
+  };
+  CHECK(reason_of(source.program) == "");
+  auto fused = source.program;
+  vm::fuse(fused);
+  CHECK(reason_of(fused) == "");
+
+  auto vm = vm::machine { fused };
+  CHECK_FALSE(vm.rejection());
+  CHECK(vm.run().value == 3);
+}
+
+TEST_CASE("verify: rejects malformed chunks") {
+  auto source = test::compiled {
+    "def mut i: i32 = 0i32, mut s: i64 = 0;\n"
+    "while i < 10i32 { s = s + 2; i += 1i32; }\n"
+    "s = s / 1;\n"
+  };
+  auto const& base = source.program;
+
+  auto bad = base;
+  bad.code[find(bad, vm::opcode::Store) + 1] = 9;
+  CHECK(reason_of(bad) == "slot out of range");
+
+  bad = base;
+  bad.code[find(bad, vm::opcode::Const) + 1] = 99;
+  CHECK(reason_of(bad) == "constant out of range");
+
+  bad = base;
+  bad.code[find(bad, vm::opcode::Add) + 1] = 12;
+  CHECK(reason_of(bad) == "invalid width");
+
+  bad = base;
+  set_opcode(bad, find(bad, vm::opcode::Add), vm::opcode::Add32);
+  CHECK(reason_of(bad) == "width does not match the instruction");
+
+  bad = base;
+  bad.code[find(bad, vm::opcode::JumpTrue) + 1] += 1;
+  CHECK(reason_of(bad) == "jump into the middle of an instruction");
+
+  bad = base;
+  bad.code.pop_back();
+  CHECK(reason_of(bad) == "runs past the end of the code");
+
+  bad = base;
+  bad.code.push_back(static_cast<vm::code_unit>(vm::opcode::Const));
+  CHECK(reason_of(bad) == "truncated instruction");
+
+  bad = base;
+  auto store = find(bad, vm::opcode::Store);
+  set_opcode(bad, store, vm::opcode::Pop);
+  set_opcode(bad, store + 1, vm::opcode::Pop);
+  CHECK(reason_of(bad) == "stack underflow");
+
+  bad = base;
+  bad.max_stack = 1;
+  CHECK(reason_of(bad) == "stack overflow");
+
+  // The branch leaves nothing on the stack, the fall-through one value.
+  auto join = vm::chunk {};
+  join.code = {
+    static_cast<vm::code_unit>(vm::opcode::Const), 0,
+    static_cast<vm::code_unit>(vm::opcode::JumpTrue), 6,
+    static_cast<vm::code_unit>(vm::opcode::Const), 0,
+    static_cast<vm::code_unit>(vm::opcode::Halt)
+  };
+  join.constants = { 0 };
+  join.max_stack = 1;
+  CHECK(reason_of(join) == "stack depth differs where paths join");
+  CHECK(vm::verify(join.view())->offset == 6);
+}
+
+TEST_CASE("verify: keeps functions to their own code and frames") {
+  auto source = test::compiled {
+    "global f(a: i64, b: i64): i64 { def c: i64 = a * b; return c - f(b, a); }\n"
+    "local g(): i64 { return f(1, 2); }\n"
+    "def mut s: i64 = 0;\n"
+    "while s < 5 { s += g(); }\n"
+  };
+  auto const& base = source.program;
+  REQUIRE(base.functions.size() == 2);
+  CHECK(reason_of(base) == "");
+
+  auto bad = base;
+  bad.code[find(bad, vm::opcode::Call) + 1] = 2;
+  CHECK(reason_of(bad) == "function out of range");
+
+  bad = base;
+  bad.functions[1].offset = bad.functions[0].offset;
+  CHECK(reason_of(bad) == "function out of place");
+
+  bad = base;
+  bad.functions[0].params = 4;
+  CHECK(reason_of(bad) == "parameters out of the frame");
+
+  bad = base;
+  bad.functions[0].slots = 2;
+  CHECK(reason_of(bad) == "slot out of range");
+
+  bad = base;
+  bad.functions[1].max_stack = 1;
+  CHECK(reason_of(bad) == "stack overflow");
+
+  // Only functions have a frame to hand over.
+  bad = base;
+  bad.code[find(bad, vm::opcode::Call)] = static_cast<vm::code_unit>(vm::opcode::TailCall);
+  CHECK(reason_of(bad) == "tail call at the top level");
+
+  // The first function now starts in the middle of the top level.
+  bad = base;
+  bad.functions[0].offset = find(bad, vm::opcode::Halt);
+  CHECK(reason_of(bad) == "loop exit out of the code");
+}
+
+TEST_CASE("machine: runs unverified code on the checked path") {
+  auto source = test::compiled {
+    "def mut s: i64 = 0, mut k: i64 = 0;\n"
+    "if k == 1 { s = 7; }\n"
+    "s += 5;\n"
+  };
+
+  // A dead branch breaks the proof but never runs.
+  auto dead = source.program;
+  auto index = std::find(dead.constants.begin(), dead.constants.end(), 7) - dead.constants.begin();
+  dead.code[find(dead, vm::opcode::Const, static_cast<vm::code_unit>(index)) + 1] = 99;
+  auto machine = vm::machine { dead };
+  REQUIRE(machine.rejection());
+  auto result = machine.run();
+  CHECK(result.state == vm::status::Halted);
+  CHECK(machine.slots()[0] == 5);
+
+  auto wild = source.program;
+  auto store = find(wild, vm::opcode::Store);
+  wild.code[store + 1] = 1000;
+  auto checked = vm::machine { wild };
+  REQUIRE(checked.rejection());
+  CHECK(checked.rejection()->offset == store);
+  result = checked.run();
+  CHECK(result.state == vm::status::Malformed);
+  CHECK(result.value == static_cast<std::int64_t>(store));
+
+  // A frame larger than any the machine allocates does not run at all.
+  auto huge = source.program;
+  huge.slots = std::size_t { 1 } << 40;
+  CHECK(reason_of(huge) == "frame too large");
+  auto refused = vm::machine { huge };
+  CHECK(refused.run().state == vm::status::Malformed);
+  huge = source.program;
+  huge.max_stack = std::size_t { 1 } << 62;
+  CHECK(reason_of(huge) == "frame too large");
+}